@@ -0,0 +1,36 @@
+#pragma once
+
+/**
+ * Counts the heap allocations of a benchmark loop
+ *
+ * The allocations are counted by the operator new of alloc_stats, so the
+ * counter is only reported if polybar was built with ENABLE_ALLOC_STATS.
+ */
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "components/alloc_stats.hpp"
+
+/**
+ * Reports the allocations made during the benchmark loop as a counter
+ * averaged over the iterations, e.g. allocs/frame
+ */
+class allocation_counter {
+ public:
+  explicit allocation_counter(benchmark::State& state, std::string name)
+      : m_state(state), m_name(std::move(name)), m_start(polybar::alloc_stats::allocations()) {}
+
+  ~allocation_counter() {
+    if (!polybar::alloc_stats::enabled()) {
+      return;
+    }
+    auto count = static_cast<double>(polybar::alloc_stats::allocations() - m_start);
+    m_state.counters[m_name] = benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  benchmark::State& m_state;
+  std::string m_name;
+  size_t m_start;
+};
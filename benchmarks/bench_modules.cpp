@@ -0,0 +1,94 @@
+/**
+ * Cost of a single module update
+ *
+ * Every iteration is one update of the module followed by building its
+ * output, the same work the module does on every tick of its interval. The
+ * allocs/update counter is the number of heap allocations per update, it is
+ * only reported with ENABLE_ALLOC_STATS.
+ *
+ * The modules are configured by the sections in fixture_sections(). Their
+ * interval is set so low that every update takes a new reading from the
+ * system (/proc, statvfs, the clock) instead of sharing the last one.
+ *
+ * Only modules that don't need the X server or another service are run.
+ */
+#include <benchmark/benchmark.h>
+
+#include "allocation_counter.hpp"
+#include "components/config.hpp"
+#include "components/types.hpp"
+#include "modules/cpu.hpp"
+#include "modules/date.hpp"
+#include "modules/fs.hpp"
+#include "modules/memory.hpp"
+
+using namespace polybar;
+
+// Fixture {{{
+
+sectionmap_t fixture_sections() {
+  // Makes the data sources take a new reading on every update
+  const string interval{"0.000000001"};
+  // The default of 60s would be a history of 60 billion samples at that interval
+  const string history{"0.000001"};
+
+  sectionmap_t sections;
+  sections["bar/bench"] = {};
+  sections["module/cpu"] = {{"type", "internal/cpu"}, {"interval", interval}, {"history", history},
+      {"format", "<label> <graph-load>"}, {"label", "%percentage%% %percentage-avg%%"}};
+  sections["module/memory"] = {{"type", "internal/memory"}, {"interval", interval}, {"history", history},
+      {"label", "%percentage_used%% %gb_used%/%gb_total% %mb_swap_used%"}};
+  sections["module/fs"] = {{"type", "internal/fs"}, {"interval", interval}, {"mount-0", "/"},
+      {"label-mounted", "%mountpoint% %percentage_used%% %used%/%total%"}};
+  sections["module/date"] = {{"type", "internal/date"}, {"date", "%Y-%m-%d"}, {"time", "%H:%M:%S"}};
+  return sections;
+}
+
+const bar_settings& fixture_bar() {
+  static bar_settings bar{};
+  static bool configured{false};
+
+  if (!configured) {
+    const_cast<config&>(config::make("/dev/null", "bench")).set_sections(fixture_sections());
+    configured = true;
+  }
+
+  return bar;
+}
+
+/**
+ * Gives the benchmark access to the steps of an update
+ */
+template <typename Module>
+class harness : public Module {
+ public:
+  explicit harness(string name) : Module(fixture_bar(), move(name)) {}
+
+  string step() {
+    this->update();
+    return this->get_output();
+  }
+};
+
+// }}}
+// Benchmarks {{{
+
+template <typename Module>
+static void BM_module(benchmark::State& state) {
+  // Named after the type, "internal/cpu" uses the section module/cpu
+  string type{Module::TYPE};
+  harness<Module> module{type.substr(type.find('/') + 1)};
+
+  allocation_counter allocations(state, "allocs/update");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(module.step());
+  }
+}
+BENCHMARK_TEMPLATE(BM_module, modules::cpu_module);
+BENCHMARK_TEMPLATE(BM_module, modules::memory_module);
+BENCHMARK_TEMPLATE(BM_module, modules::fs_module);
+BENCHMARK_TEMPLATE(BM_module, modules::date_module);
+
+// }}}
+
+BENCHMARK_MAIN();
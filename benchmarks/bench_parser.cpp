@@ -0,0 +1,121 @@
+/**
+ * Throughput of tags::parser for real module outputs
+ *
+ * Every iteration parses one module output, the reported time is the time per
+ * output and bytes/s is the parser throughput. The outputs are read from
+ * data/parser/<name>.txt, one output per line.
+ *
+ * data/parser/invalid.txt contains outputs with invalid tags to measure the
+ * error path. The same files are the seed corpus of fuzz_parser.
+ */
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+
+#include "components/logger.hpp"
+#include "errors.hpp"
+#include "tags/dispatch.hpp"
+#include "tags/parser.hpp"
+
+using namespace polybar;
+
+// Corpus {{{
+
+vector<string> load_corpus(const string& name) {
+  string path{BENCH_DATA_DIR "/parser/" + name + ".txt"};
+
+  std::ifstream in(path);
+  if (!in) {
+    throw application_error("Failed to open " + path);
+  }
+
+  vector<string> outputs;
+  string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line[0] != '#') {
+      outputs.emplace_back(move(line));
+    }
+  }
+
+  if (outputs.empty()) {
+    throw application_error("No module outputs in " + path);
+  }
+
+  return outputs;
+}
+
+size_t total_size(const vector<string>& outputs) {
+  size_t size{0};
+  for (const auto& output : outputs) {
+    size += output.size();
+  }
+  return size;
+}
+
+// }}}
+// Benchmarks {{{
+
+/**
+ * All elements at once with parser::parse()
+ */
+static void BM_parse(benchmark::State& state, const char* name) {
+  auto outputs = load_corpus(name);
+  tags::parser p;
+  size_t i{0};
+
+  for (auto _ : state) {
+    p.set_borrowed(outputs[i++ % outputs.size()]);
+    auto elements = p.parse();
+    benchmark::DoNotOptimize(elements);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * total_size(outputs) / outputs.size()));
+}
+BENCHMARK_CAPTURE(BM_parse, i3, "i3");
+BENCHMARK_CAPTURE(BM_parse, bspwm, "bspwm");
+BENCHMARK_CAPTURE(BM_parse, mpd, "mpd");
+BENCHMARK_CAPTURE(BM_parse, script, "script");
+
+/**
+ * Element by element with parser::next_element()
+ */
+static void BM_next_element(benchmark::State& state, const char* name) {
+  auto outputs = load_corpus(name);
+  tags::parser p;
+  size_t i{0};
+
+  for (auto _ : state) {
+    p.set_borrowed(outputs[i++ % outputs.size()]);
+    while (p.has_next_element()) {
+      auto element = p.next_element();
+      benchmark::DoNotOptimize(element);
+    }
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * total_size(outputs) / outputs.size()));
+}
+BENCHMARK_CAPTURE(BM_next_element, i3, "i3");
+BENCHMARK_CAPTURE(BM_next_element, bspwm, "bspwm");
+BENCHMARK_CAPTURE(BM_next_element, mpd, "mpd");
+BENCHMARK_CAPTURE(BM_next_element, script, "script");
+
+/**
+ * tags::tokenize() for outputs with invalid tags, which are logged and skipped
+ */
+static void BM_tokenize_invalid(benchmark::State& state) {
+  auto outputs = load_corpus("invalid");
+  logger log{loglevel::NONE};
+  size_t i{0};
+
+  for (auto _ : state) {
+    auto elements = tags::tokenize(log, outputs[i++ % outputs.size()]);
+    benchmark::DoNotOptimize(elements);
+  }
+
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * total_size(outputs) / outputs.size()));
+}
+BENCHMARK(BM_tokenize_invalid);
+
+// }}}
+
+BENCHMARK_MAIN();
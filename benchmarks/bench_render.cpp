@@ -0,0 +1,149 @@
+/**
+ * Replays recorded bar contents through the render pipeline
+ *
+ * Every iteration is one frame, so the reported time is the time per frame.
+ * The allocs/frame counter is the number of heap allocations per frame, it is
+ * only reported with ENABLE_ALLOC_STATS.
+ *
+ * The contents are read from data/contents.txt or from the file given in the
+ * POLYBAR_BENCH_CONTENTS environment variable. To record your own bar, run
+ * `polybar --stdout <bar> > contents.txt`.
+ */
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <fstream>
+
+#include "allocation_counter.hpp"
+#include "components/logger.hpp"
+#include "components/offscreen_renderer.hpp"
+#include "components/renderer_interface.hpp"
+#include "components/types.hpp"
+#include "settings.hpp"
+#include "tags/dispatch.hpp"
+
+using namespace polybar;
+
+// Recorded contents {{{
+
+vector<string> load_contents() {
+  const char* env = std::getenv("POLYBAR_BENCH_CONTENTS");
+  string path{env != nullptr ? env : BENCH_DATA_DIR "/contents.txt"};
+
+  std::ifstream in(path);
+  if (!in) {
+    throw application_error("Failed to open " + path);
+  }
+
+  vector<string> frames;
+  string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line[0] != '#') {
+      frames.emplace_back(move(line));
+    }
+  }
+
+  if (frames.empty()) {
+    throw application_error("No bar contents in " + path);
+  }
+
+  return frames;
+}
+
+const vector<string>& recorded_contents() {
+  static const vector<string> frames{load_contents()};
+  return frames;
+}
+
+vector<tags::format_string> recorded_elements() {
+  vector<tags::format_string> frames;
+  for (const auto& contents : recorded_contents()) {
+    frames.emplace_back(tags::tokenize(logger::make(), contents));
+  }
+  return frames;
+}
+
+// }}}
+// Benchmarks {{{
+
+/**
+ * tags::parser only
+ */
+static void BM_tokenize(benchmark::State& state) {
+  const auto& frames = recorded_contents();
+  const logger& log = logger::make();
+  size_t i{0};
+
+  allocation_counter allocations(state, "allocs/frame");
+  for (auto _ : state) {
+    auto elements = tags::tokenize(log, frames[i++ % frames.size()]);
+    benchmark::DoNotOptimize(elements);
+  }
+}
+BENCHMARK(BM_tokenize);
+
+/**
+ * Renderer that ignores everything, measures tags::dispatch by itself
+ */
+class null_renderer : public renderer_interface {
+ public:
+  void change_background(const rgba&) override {}
+  void change_foreground(const rgba&) override {}
+  void change_underline(const rgba&) override {}
+  void change_overline(const rgba&) override {}
+  void change_font(int) override {}
+  void change_alignment(alignment) override {}
+  void reverse_colors() override {}
+  void offset_pixel(int) override {}
+  void attribute_set(tags::attribute) override {}
+  void attribute_unset(tags::attribute) override {}
+  void attribute_toggle(tags::attribute) override {}
+  void action_begin(mousebtn, const string&) override {}
+  void action_end(mousebtn) override {}
+  void render_text(const string&) override {}
+  void draw_graph(tags::graph_type, int, const vector<double>&) override {}
+  void control(tags::controltag) override {}
+  void reserve_width(const tags::reserved_width&) override {}
+};
+
+/**
+ * tags::dispatch without drawing anything
+ */
+static void BM_dispatch(benchmark::State& state) {
+  auto frames = recorded_elements();
+  auto dispatch = tags::dispatch::make();
+  bar_settings bar{};
+  null_renderer renderer;
+  size_t i{0};
+
+  allocation_counter allocations(state, "allocs/frame");
+  for (auto _ : state) {
+    dispatch->parse(bar, renderer, frames[i++ % frames.size()]);
+  }
+}
+BENCHMARK(BM_dispatch);
+
+/**
+ * Parsing, dispatching and rendering into an image surface
+ */
+static void BM_render(benchmark::State& state) {
+  const auto& frames = recorded_contents();
+  const logger& log = logger::make();
+  auto dispatch = tags::dispatch::make();
+  bar_settings bar{};
+  const char* font = std::getenv("POLYBAR_BENCH_FONT");
+  offscreen_renderer renderer(log, bar, 1920, 24, {font != nullptr ? font : "monospace:size=10"});
+  size_t i{0};
+
+  allocation_counter allocations(state, "allocs/frame");
+  for (auto _ : state) {
+    renderer.begin();
+    dispatch->parse(bar, renderer, tags::tokenize(log, frames[i++ % frames.size()]));
+    renderer.end();
+  }
+}
+BENCHMARK(BM_render);
+
+// }}}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,40 @@
+/**
+ * libFuzzer target for tags::parser
+ *
+ * Arbitrary input must either be parsed or rejected with a tags::error, any
+ * other exception, crash or out of bounds access is a bug.
+ *
+ * Run with the module outputs of the benchmarks as seed corpus:
+ *
+ *   fuzz_parser -dict=benchmarks/data/parser.dict <corpus-dir> benchmarks/data/parser
+ */
+#include <cstddef>
+#include <cstdint>
+
+#include "tags/parser.hpp"
+
+using namespace polybar;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  const string input(reinterpret_cast<const char*>(data), size);
+
+  tags::parser p;
+  p.set_borrowed(input);
+
+  // Same loop as tags::tokenize, invalid tags are skipped
+  while (p.has_next_element()) {
+    try {
+      p.next_element();
+    } catch (const tags::error&) {
+    }
+  }
+
+  // parse() has to stop at the first invalid tag
+  p.set_borrowed(input);
+  try {
+    p.parse();
+  } catch (const tags::error&) {
+  }
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Runs the benchmarks and compares them with a baseline
+
+Every benchmark is repeated a fixed number of times and the median is
+compared. The check fails if the cpu time of a benchmark exceeds the baseline
+by more than the time tolerance, or if it makes more heap allocations
+(allocs/* counters) than the baseline allows. Allocations are only counted
+in builds with ENABLE_ALLOC_STATS.
+
+Times depend on the machine, so only a baseline recorded with --update holds
+them. The checked-in baseline only has the tolerances and the allocation
+counts that are the same everywhere, times are not compared until a local
+baseline was recorded.
+
+Benchmarks that are missing from the baseline are reported but never fail
+the check. Run with --update to record the current results as the baseline.
+
+--baseline can be given more than once, the first file that exists is
+compared with and --update writes to the first file. This way a baseline
+recorded in the build directory takes precedence over the checked-in one
+without modifying the source tree.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+DEFAULT_TOLERANCE = {"time": 0.15, "allocs": 0.0}
+
+
+def run_benchmark(path, repetitions, min_time):
+    output = subprocess.run(
+        [
+            path,
+            "--benchmark_format=json",
+            "--benchmark_repetitions={}".format(repetitions),
+            "--benchmark_min_time={}".format(min_time),
+            "--benchmark_report_aggregates_only=true",
+        ],
+        check=True,
+        stdout=subprocess.PIPE,
+    ).stdout
+
+    results = {}
+    for run in json.loads(output.decode())["benchmarks"]:
+        if run.get("aggregate_name") != "median":
+            continue
+
+        results[run["run_name"]] = {
+            "cpu_time": run["cpu_time"],
+            "time_unit": run["time_unit"],
+            "allocs": {k: v for k, v in run.items() if k.startswith("allocs/")},
+        }
+
+    return results
+
+
+def compare(name, result, base, tolerance):
+    """
+    Returns a list of regressions of a single benchmark
+    """
+    regressions = []
+
+    # Only baselines recorded on this machine hold times
+    if "cpu_time" in base:
+        if base["time_unit"] != result["time_unit"]:
+            regressions.append("time unit changed from {} to {}".format(base["time_unit"], result["time_unit"]))
+        elif result["cpu_time"] > base["cpu_time"] * (1 + tolerance["time"]):
+            regressions.append(
+                "cpu time {:.1f}{} exceeds baseline {:.1f}{} by more than {:.0%}".format(
+                    result["cpu_time"], result["time_unit"], base["cpu_time"], base["time_unit"], tolerance["time"]
+                )
+            )
+
+    for counter, value in result["allocs"].items():
+        limit = base["allocs"].get(counter)
+        # Averages over iterations are fractional, half an allocation is noise
+        if limit is not None and value > limit * (1 + tolerance["allocs"]) + 0.5:
+            regressions.append("{} {:.1f} exceeds baseline {:.1f}".format(counter, value, limit))
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument(
+        "--baseline", required=True, action="append", help="baseline JSON file, the first one that exists is used"
+    )
+    parser.add_argument("--dir", required=True, help="directory containing the benchmark executables")
+    parser.add_argument("--repetitions", type=int, default=5)
+    parser.add_argument("--min-time", type=float, default=0.2, help="minimum seconds per repetition")
+    parser.add_argument("--update", action="store_true", help="record the results as the new baseline")
+    parser.add_argument("benchmarks", nargs="+", help="names of the benchmark executables")
+    args = parser.parse_args()
+
+    results = {}
+    for benchmark in args.benchmarks:
+        print("Running {}".format(benchmark), flush=True)
+        results.update(run_benchmark(os.path.join(args.dir, benchmark), args.repetitions, args.min_time))
+
+    baseline = {}
+    for path in args.baseline:
+        if os.path.exists(path):
+            with open(path) as f:
+                baseline = json.load(f)
+            print("Comparing with {}".format(path))
+            break
+
+    tolerance = dict(DEFAULT_TOLERANCE, **baseline.get("tolerance", {}))
+
+    if args.update:
+        with open(args.baseline[0], "w") as f:
+            json.dump({"tolerance": tolerance, "benchmarks": results}, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("Recorded {} benchmarks in {}".format(len(results), args.baseline[0]))
+        return 0
+
+    if not any("cpu_time" in base for base in baseline.get("benchmarks", {}).values()):
+        print("The baseline has no times, run with --update (make perfcheck-update) to compare them")
+
+    failed = False
+    for name, result in sorted(results.items()):
+        base = baseline.get("benchmarks", {}).get(name)
+        if base is None:
+            print("  NEW   {} ({:.1f}{})".format(name, result["cpu_time"], result["time_unit"]))
+            continue
+
+        regressions = compare(name, result, base, tolerance)
+        if regressions:
+            failed = True
+            for regression in regressions:
+                print("  FAIL  {}: {}".format(name, regression))
+        elif "cpu_time" in base:
+            change = result["cpu_time"] / base["cpu_time"] - 1 if base["cpu_time"] else 0.0
+            print("  OK    {} ({:+.1%})".format(name, change))
+        else:
+            print("  OK    {} (allocations only)".format(name))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
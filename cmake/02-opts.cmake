@@ -16,7 +16,11 @@ set(SETTING_PATH_CPU_INFO "/proc/stat"
   CACHE STRING "Path to file containing cpu info")
 set(SETTING_PATH_MEMORY_INFO "/proc/meminfo"
   CACHE STRING "Path to file containing memory info")
+set(SETTING_PATH_MEMORY_PRESSURE "/proc/pressure/memory"
+  CACHE STRING "Path to file containing memory pressure info")
 set(SETTING_PATH_MESSAGING_FIFO "/tmp/polybar_mqueue.%pid%"
   CACHE STRING "Path to file containing the current temperature")
+set(SETTING_PATH_MESSAGING_SOCKET "/tmp/polybar_ipc.%pid%"
+  CACHE STRING "Path to the ipc socket")
 set(SETTING_PATH_TEMPERATURE_INFO "/sys/class/thermal/thermal_zone%zone%/temp"
   CACHE STRING "Path to file containing the current temperature")
@@ -24,6 +24,7 @@ message(STATUS " Targets:")
 colored_option("   polybar" BUILD_POLYBAR)
 colored_option("   polybar-msg" BUILD_POLYBAR_MSG)
 colored_option("   testsuite" BUILD_TESTS)
+colored_option("   benchmarks" BUILD_BENCHMARKS)
 colored_option("   documentation" BUILD_DOC)
 colored_option("      html" BUILD_DOC_HTML)
 colored_option("      man" BUILD_DOC_MAN)
@@ -39,6 +40,11 @@ if (BUILD_LIBPOLY)
   colored_option("   network (${WIRELESS_LIB})" ENABLE_NETWORK NETWORK_LIBRARY_VERSION)
   colored_option("   pulseaudio" ENABLE_PULSEAUDIO PULSEAUDIO_VERSION)
   colored_option("   xkeyboard" WITH_XKB Xcb_XKB_VERSION)
+  foreach(type ${MODULES_AVAILABLE})
+    if(NOT type IN_LIST MODULES)
+      message_colored(STATUS "   ${type} left out" "33")
+    endif()
+  endforeach()
 
   message(STATUS " X extensions:")
   colored_option("   xcb-randr" Xcb_RANDR_FOUND Xcb_RANDR_VERSION)
@@ -47,9 +53,18 @@ if (BUILD_LIBPOLY)
   colored_option("   xcb-xkb" WITH_XKB Xcb_XKB_VERSION)
   colored_option("   xcb-xrm" WITH_XRM Xcb_XRM_VERSION)
   colored_option("   xcb-cursor" WITH_XCURSOR Xcb_CURSOR_VERSION)
+  colored_option("   xcb-shm" WITH_XSHM Xcb_SHM_VERSION)
+  colored_option("   xcb-present" WITH_XPRESENT Xcb_PRESENT_VERSION)
+
+  message(STATUS " Text rendering:")
+  colored_option("   harfbuzz" WITH_HARFBUZZ HarfBuzz_VERSION)
+
+  message(STATUS " System interfaces:")
+  colored_option("   io_uring" WITH_IO_URING)
 
   message(STATUS " Log options:")
   colored_option("   Trace logging" DEBUG_LOGGER)
+  colored_option("   Allocation statistics" ENABLE_ALLOC_STATS)
 
   if(CMAKE_BUILD_TYPE_UPPER MATCHES DEBUG)
     message(STATUS " Debug options:")
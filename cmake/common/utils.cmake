@@ -135,6 +135,10 @@ function(checklib flag type pkg)
     elseif(${type} STREQUAL "binary")
       find_program(BIN_${flag} ${pkg})
       set(${flag} ${BIN_${flag}} CACHE BOOL "")
+    elseif(${type} STREQUAL "header")
+      include(CheckIncludeFileCXX)
+      check_include_file_cxx(${pkg} HEADER_${flag})
+      set(${flag} ${HEADER_${flag}} CACHE BOOL "")
     else()
       message(FATAL_ERROR "Invalid lookup type '${type}'")
     endif()
@@ -19,6 +19,10 @@ checklib(WITH_XKB "pkg-config" xcb-xkb)
 checklib(WITH_XRM "pkg-config" xcb-xrm)
 checklib(WITH_XRANDR_MONITORS "pkg-config" "xcb-randr>=1.12")
 checklib(WITH_XCURSOR "pkg-config" "xcb-cursor")
+checklib(WITH_XSHM "pkg-config" "xcb-shm")
+checklib(WITH_XPRESENT "pkg-config" "xcb-present")
+checklib(WITH_HARFBUZZ "pkg-config" harfbuzz)
+checklib(WITH_IO_URING "header" linux/io_uring.h)
 
 option(ENABLE_ALSA "Enable alsa support" ON)
 option(ENABLE_CURL "Enable curl support" ON)
@@ -33,8 +37,42 @@ option(WITH_XRANDR_MONITORS "xcb-randr monitor support" ON)
 option(WITH_XKB "xcb-xkb support" ON)
 option(WITH_XRM "xcb-xrm support" ON)
 option(WITH_XCURSOR "xcb-cursor support" ON)
+option(WITH_XSHM "xcb-shm support" ON)
+option(WITH_XPRESENT "xcb-present support" ON)
+option(WITH_HARFBUZZ "Shape text with HarfBuzz" ON)
+option(WITH_IO_URING "Batch file reads with io_uring" ON)
+
+# Module types that can be built, MODULES picks a subset of them. Config files
+# that use a module that was left out are rejected with an error
+set(MODULES_AVAILABLE
+  internal/alsa internal/backlight internal/battery internal/bspwm internal/counter internal/cpu internal/date
+  internal/fs internal/github internal/i3 internal/memory internal/mpd internal/network internal/pulseaudio
+  internal/temperature internal/xbacklight internal/xkeyboard internal/xwindow internal/xworkspaces
+  custom/ipc custom/menu custom/script custom/text)
+set(MODULES "${MODULES_AVAILABLE}" CACHE STRING "Module types to build")
+
+foreach(type ${MODULES_AVAILABLE})
+  string(REGEX REPLACE ".*/" "" module ${type})
+  string(TOUPPER ${module} module)
+  if(type IN_LIST MODULES)
+    set(ENABLE_MODULE_${module} ON)
+  else()
+    set(ENABLE_MODULE_${module} OFF)
+  endif()
+endforeach()
+
+# The dependencies of modules that were left out aren't needed
+foreach(flag ALSA I3 MPD NETWORK PULSEAUDIO XKEYBOARD)
+  if(NOT ENABLE_MODULE_${flag})
+    set(ENABLE_${flag} OFF)
+  endif()
+endforeach()
+if(NOT ENABLE_MODULE_GITHUB)
+  set(ENABLE_CURL OFF)
+endif()
 
 option(DEBUG_LOGGER "Trace logging" ON)
+option(ENABLE_ALLOC_STATS "Count heap allocations per subsystem" OFF)
 
 if(CMAKE_BUILD_TYPE_UPPER MATCHES DEBUG)
   option(DEBUG_LOGGER_VERBOSE "Trace logging (verbose)" OFF)
@@ -48,6 +86,10 @@ endif()
 find_package(Threads REQUIRED)
 find_package(CairoFC REQUIRED)
 
+if (WITH_HARFBUZZ)
+  find_package(HarfBuzz REQUIRED)
+endif()
+
 if (ENABLE_ALSA)
   find_package(ALSA REQUIRED)
   set(ALSA_VERSION ${ALSA_VERSION_STRING})
@@ -88,6 +130,12 @@ endif()
 if (WITH_XRM)
   list(APPEND XORG_EXTENSIONS XRM)
 endif()
+if (WITH_XSHM)
+  list(APPEND XORG_EXTENSIONS SHM)
+endif()
+if (WITH_XPRESENT)
+  list(APPEND XORG_EXTENSIONS PRESENT)
+endif()
 
 # Set min xrandr version required
 if (WITH_XRANDR_MONITORS)
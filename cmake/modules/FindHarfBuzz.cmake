@@ -0,0 +1,14 @@
+# This module defines an imported target `HarfBuzz::HarfBuzz` if harfbuzz is found
+#
+# Defines the following Variables (see find_package_impl for more info):
+# HarfBuzz_FOUND
+# HarfBuzz_INCLUDE_DIR
+# HarfBuzz_INCLUDE_DIRS
+# HarfBuzz_LIBRARY
+# HarfBuzz_LIBRARIES
+# HarfBuzz_VERSION
+find_package_impl("harfbuzz" "HarfBuzz" "hb-ft.h")
+
+if(HarfBuzz_FOUND AND NOT TARGET HarfBuzz::HarfBuzz)
+  create_imported_target("HarfBuzz::HarfBuzz" "${HarfBuzz_INCLUDE_DIR}" "${HarfBuzz_LIBRARY}")
+endif()
@@ -25,9 +25,9 @@ namespace alsa {
     control& operator=(const control& o) = delete;
 
     int get_numid();
-    bool wait(int timeout = -1);
+    vector<int> get_file_descriptors() const;
     bool test_device_plugged();
-    void process_events();
+    int process_events();
 
    private:
     int m_numid{0};
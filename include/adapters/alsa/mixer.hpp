@@ -27,7 +27,7 @@ namespace alsa {
     const string& get_name();
     const string& get_sound_card();
 
-    bool wait(int timeout = -1);
+    vector<int> get_file_descriptors() const;
     int process_events();
 
     int get_volume();
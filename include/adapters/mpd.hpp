@@ -27,7 +27,7 @@ namespace mpd {
 
   // types details {{{
 
-  enum class connection_state { NONE = 0, CONNECTED, DISCONNECTED };
+  enum class connection_state { NONE = 0, CONNECTED, CONNECTING, DISCONNECTED };
 
   enum class mpdstate {
     UNKNOWN = 1 << 0,
@@ -85,8 +85,12 @@ namespace mpd {
     ~mpdconnection();
 
     void connect();
+    bool connect_async();
+    short connect_events() const;
+    int connect_timeout() const;
     void disconnect();
     bool connected();
+    bool connecting() const;
     bool retry_connection(int interval = 1);
 
     int get_fd();
@@ -126,6 +130,14 @@ namespace mpd {
     bool m_idle = false;
     int m_fd = -1;
 
+    /**
+     * Steps of a connection made by connect_async()
+     */
+    enum class attempt { NONE, CONNECT, WELCOME, PASSWORD };
+    attempt m_attempt{attempt::NONE};
+    chrono::steady_clock::time_point m_attempt_deadline{};
+    string m_welcome;
+
     string m_host;
     unsigned int m_port;
     string m_password;
@@ -153,16 +165,19 @@ namespace mpd {
     int get_queuelen() const;
     unsigned get_total_time() const;
     unsigned get_elapsed_time() const;
+    chrono::milliseconds get_next_second() const;
     unsigned get_elapsed_percentage();
     string get_formatted_elapsed();
     string get_formatted_total();
     int get_seek_position(int percentage);
 
    private:
+    unsigned long extrapolated_ms() const;
+
     mpd_status_t m_status{};
     unique_ptr<mpdsong> m_song{};
     mpdstate m_state{mpdstate::UNKNOWN};
-    chrono::system_clock::time_point m_updated_at{};
+    chrono::steady_clock::time_point m_updated_at{};
 
     bool m_random{false};
     bool m_repeat{false};
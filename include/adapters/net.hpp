@@ -4,7 +4,7 @@
 #include <cstdlib>
 
 #include <arpa/inet.h>
-#include <ifaddrs.h>
+#include <sys/socket.h>
 
 #include "common.hpp"
 #include "settings.hpp"
@@ -12,10 +12,13 @@
 #include "components/logger.hpp"
 #include "utils/math.hpp"
 
+struct nlmsghdr;
+
 #if WITH_LIBNL
 #include <net/if.h>
 
 struct nl_msg;
+struct nl_sock;
 struct nlattr;
 #else
 #include <iwlib.h>
@@ -78,22 +81,35 @@ namespace net {
 
     virtual bool query(bool accumulate = false);
     virtual bool connected() const = 0;
-    virtual bool ping() const;
 
     string ip() const;
     string ip6() const;
     string downspeed(int minwidth = 3, const string& unit = "B/s") const;
     string upspeed(int minwidth = 3, const string& unit = "B/s") const;
+    float downrate() const;
+    float uprate() const;
     void set_unknown_up(bool unknown = true);
 
    protected:
     void check_tuntap_or_bridge();
     bool test_interface() const;
+    float speedrate(float bytes_diff) const;
     string format_speedrate(float bytes_diff, int minwidth, const string& unit) const;
-    void query_ip6();
+
+    bool rtnl_request(unsigned short type, unsigned short flags, const void* payload, size_t size,
+        const function<void(const struct nlmsghdr*)>& handle);
+    bool query_link(bool accumulate);
+    bool query_addresses();
+    bool addresses_changed();
 
     const logger& m_log;
     unique_ptr<file_descriptor> m_socketfd;
+    // Route netlink socket for requests and one that receives link and address changes
+    unique_ptr<file_descriptor> m_netlink;
+    unique_ptr<file_descriptor> m_netlink_events;
+    unsigned int m_ifindex{0};
+    unsigned int m_sequence{0};
+    bool m_addresses_valid{false};
     link_status m_status{};
     string m_interface;
     bool m_tuntap{false};
@@ -101,6 +117,51 @@ namespace net {
     bool m_unknown_up{false};
   };
 
+  // }}}
+  // class : connectivity_probe {{{
+
+  /**
+   * \brief Non-blocking connectivity check over an interface
+   *
+   * The target is either an address that is pinged with an unprivileged ICMP
+   * socket, or an address and port (`1.1.1.1:443`, `[2606:4700::1111]:443`)
+   * that a TCP connection is opened to. A refused connection still proves that
+   * the target could be reached. If the system doesn't allow ICMP sockets for
+   * the user, TCP port 53 of the address is used instead.
+   *
+   * start() sends the probe and poll() collects its result without ever
+   * blocking, so that it can be called on every update.
+   */
+  class connectivity_probe {
+   public:
+    enum class result { PENDING, REACHABLE, UNREACHABLE };
+
+    explicit connectivity_probe(const string& target, string interface);
+
+    void start();
+    result poll();
+    bool running() const;
+
+   protected:
+    bool open_socket();
+    bool send_echo();
+    void finish();
+
+   private:
+    using clock = std::chrono::steady_clock;
+
+    const logger& m_log;
+    string m_interface;
+    struct sockaddr_storage m_address {};
+    socklen_t m_address_size{0};
+    bool m_tcp{false};
+
+    unique_ptr<file_descriptor> m_fd;
+    unsigned short m_sequence{0};
+    clock::time_point m_deadline;
+    clock::time_point m_next_echo;
+  };
+
   // }}}
   // class : wired_network {{{
 
@@ -121,9 +182,16 @@ namespace net {
 #if WITH_LIBNL
   // class : wireless_network {{{
 
+  /**
+   * The access point is only looked up in the scan results again after nl80211
+   * announced a change of the connection or new scan results for the
+   * interface. In between, the signal strength is requested from the station
+   * info of the access point.
+   */
   class wireless_network : public network {
    public:
-    wireless_network(string interface) : network(interface), m_ifid(if_nametoindex(interface.c_str())){};
+    explicit wireless_network(string interface);
+    ~wireless_network() override;
 
     bool query(bool accumulate = false) override;
     bool connected() const override;
@@ -133,15 +201,28 @@ namespace net {
 
    protected:
     static int scan_cb(struct nl_msg* msg, void* instance);
+    static int station_cb(struct nl_msg* msg, void* instance);
+    static int event_cb(struct nl_msg* msg, void* instance);
+
+    bool request(unsigned char command, int (*callback)(struct nl_msg*, void*));
+    bool connection_changed();
 
     bool associated_or_joined(struct nlattr** bss);
     void parse_essid(struct nlattr** bss);
     void parse_frequency(struct nlattr** bss);
     void parse_quality(struct nlattr** bss);
     void parse_signal(struct nlattr** bss);
+    void set_signal(int dbm);
 
    private:
     unsigned int m_ifid{};
+    // Subscribed to the nl80211 connection and scan announcements
+    struct nl_sock* m_events{nullptr};
+    bool m_event_seen{false};
+    bool m_scanned{false};
+    bool m_associated{false};
+    // Set once the scan results reported a signal strength that the station info can refresh
+    bool m_station_signal{false};
     string m_essid{};
     int m_frequency{};
     quality_range m_signalstrength{};
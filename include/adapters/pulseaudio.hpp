@@ -1,12 +1,16 @@
 #pragma once
 
 #include <pulse/pulseaudio.h>
-#include <queue>
+
+#include <atomic>
+#include <map>
+#include <mutex>
 
 #include "common.hpp"
 #include "settings.hpp"
 #include "errors.hpp"
 
+#include "utils/file.hpp"
 #include "utils/math.hpp"
 // fwd
 struct pa_context;
@@ -17,16 +21,81 @@ typedef struct pa_threaded_mainloop pa_threaded_mainloop;
 
 POLYBAR_NS
 class logger;
+class pulseaudio;
 
 DEFINE_ERROR(pulseaudio_error);
 
-class pulseaudio {
-  // events to add to our queue
-  enum class evtype { NEW = 0, CHANGE, REMOVE, SERVER };
-  using queue = std::queue<evtype>;
+/**
+ * Connection to the pulseaudio server that is shared by all modules
+ *
+ * A single subscription keeps a cache of all sinks, sources and the server
+ * defaults up to date. Every change of the cache notifies the pulseaudio
+ * objects using the context, which then look up their device in the cache
+ * instead of asking the server.
+ *
+ * Everything but make() expects the mainloop to be locked.
+ */
+class pulseaudio_context {
+  public:
+    enum class kind { SINK, SOURCE };
+
+    struct device {
+      uint32_t index{PA_INVALID_INDEX};
+      string name;
+      pa_cvolume volume{};
+      bool muted{false};
+    };
+
+    static shared_ptr<pulseaudio_context> make(const logger& logger);
+
+    explicit pulseaudio_context(const logger& logger);
+    ~pulseaudio_context();
+
+    pulseaudio_context(const pulseaudio_context& o) = delete;
+    pulseaudio_context& operator=(const pulseaudio_context& o) = delete;
+
+    pa_context* context() const;
+    pa_threaded_mainloop* mainloop() const;
+
+    void attach(pulseaudio* listener);
+    void detach(pulseaudio* listener);
+
+    const device* find(kind type, const string& name) const;
+    const string& default_name(kind type) const;
 
+  private:
+    static void subscribe_callback(pa_context* context, pa_subscription_event_type_t t, uint32_t idx, void* userdata);
+    static void sink_info_callback(pa_context *context, const pa_sink_info *info, int eol, void *userdata);
+    static void source_info_callback(pa_context *context, const pa_source_info *info, int eol, void *userdata);
+    static void server_info_callback(pa_context *context, const pa_server_info *info, void *userdata);
+    static void context_state_callback(pa_context *context, void *userdata);
+    static void success_callback(pa_context *context, int success, void *userdata);
+
+    void wait_loop(pa_operation *op);
+    void request(pa_operation *op);
+    void changed();
+
+    const logger& m_log;
+
+    pa_context* m_context{nullptr};
+    pa_threaded_mainloop* m_mainloop{nullptr};
+
+    // used for temporary callback results
+    int m_success{0};
+
+    std::map<uint32_t, device> m_sinks;
+    std::map<uint32_t, device> m_sources;
+    string m_default_sink;
+    string m_default_source;
+
+    vector<pulseaudio*> m_listeners;
+};
+
+class pulseaudio {
   public:
-    explicit pulseaudio(const logger& logger, string&& sink_name, bool m_max_volume);
+    using kind = pulseaudio_context::kind;
+
+    explicit pulseaudio(const logger& logger, kind type, string&& device_name, bool m_max_volume);
     ~pulseaudio();
 
     pulseaudio(const pulseaudio& o) = delete;
@@ -34,6 +103,7 @@ class pulseaudio {
 
     const string& get_name();
 
+    int get_event_fd() const;
     bool wait();
     int process_events();
 
@@ -46,34 +116,47 @@ class pulseaudio {
     bool is_muted();
 
   private:
-    void update_volume(pa_operation *o);
-    static void check_mute_callback(pa_context *context, const pa_sink_info *info, int eol, void *userdata);
-    static void get_sink_volume_callback(pa_context *context, const pa_sink_info *info, int is_last, void *userdata);
-    static void subscribe_callback(pa_context* context, pa_subscription_event_type_t t, uint32_t idx, void* userdata);
-    static void simple_callback(pa_context *context, int success, void *userdata);
-    static void sink_info_callback(pa_context *context, const pa_sink_info *info, int eol, void *userdata);
-    static void context_state_callback(pa_context *context, void *userdata);
+    friend class pulseaudio_context;
 
-    inline void wait_loop(pa_operation *op, pa_threaded_mainloop *loop);
+    static void volume_callback(pa_context *context, int success, void *userdata);
+    static void mute_callback(pa_context *context, int success, void *userdata);
 
-    const logger& m_log;
+    void update_device();
+    void notify();
+    bool send_volume();
+    bool send_mute();
 
-    // used for temporary callback results
-    int success{0};
-    pa_cvolume cv;
-    bool muted{false};
-    // default sink name
-    static constexpr auto DEFAULT_SINK = "@DEFAULT_SINK@";
+    const logger& m_log;
 
-    pa_context* m_context{nullptr};
+    shared_ptr<pulseaudio_context> m_shared;
     pa_threaded_mainloop* m_mainloop{nullptr};
 
-    queue m_events;
+    pa_cvolume cv{};
+    bool muted{false};
 
-    // specified sink name
+    // set once the cache changed, only the first change of a burst signals the event fd
+    std::atomic<bool> m_changed{false};
+    // readable while m_changed is set
+    file_descriptor m_eventfd;
+
+    /*
+     * Volume and mute changes are not waited for. cv and muted hold the
+     * target values, they are not overwritten from the cache while a change
+     * is still on its way.
+     *
+     * Only one change of each is sent at a time, changes made in the meantime
+     * are sent together once it is done.
+     */
+    pa_operation* m_volume_op{nullptr};
+    bool m_volume_dirty{false};
+    pa_operation* m_mute_op{nullptr};
+    bool m_mute_dirty{false};
+
+    kind m_kind;
+    // specified device name
     string spec_s_name;
     string s_name;
-    uint32_t m_index{0};
+    uint32_t m_index{PA_INVALID_INDEX};
 
     pa_volume_t m_max_volume{PA_VOLUME_UI_MAX};
 };
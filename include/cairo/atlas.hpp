@@ -0,0 +1,246 @@
+#pragma once
+
+#include <cairo/cairo.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "components/stats.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace cairo {
+  /**
+   * \brief Rasterized glyphs in a single A8 image surface
+   *
+   * Bars show the same few glyphs (workspace names, ramp and animation icons)
+   * in every frame. Instead of rasterizing them each time, every glyph is
+   * rasterized once per subpixel offset and afterwards drawn by masking the
+   * current source with its tile.
+   *
+   * Tiles are packed into shelves. Once the surface is full, it is cleared
+   * and filled again from scratch.
+   *
+   * Only used if the user space of the target is translated, but not scaled
+   * or rotated. The tiles are rasterized in grayscale, so color glyphs must
+   * not be drawn through the atlas.
+   */
+  class glyph_atlas : non_copyable_mixin<glyph_atlas> {
+   public:
+    static constexpr int SIZE{512};
+    static constexpr int SUBPIXEL_STEPS{4};
+    static constexpr int MAX_TILE{64};
+
+    explicit glyph_atlas()
+        : m_surface(cairo_image_surface_create(CAIRO_FORMAT_A8, SIZE, SIZE))
+        , m_cairo(cairo_create(m_surface))
+        , m_stats(stats::make().counter("font.glyph_atlas")) {}
+
+    ~glyph_atlas() {
+      cairo_destroy(m_cairo);
+      cairo_surface_destroy(m_surface);
+    }
+
+    /**
+     * Draw the glyphs onto `cr` with its current source
+     *
+     * \returns false without drawing anything if the glyphs can't be drawn
+     * through the atlas, the caller has to draw them itself
+     */
+    bool show_glyphs(cairo_t* cr, cairo_scaled_font_t* font, const cairo_glyph_t* glyphs, size_t count) {
+      cairo_matrix_t m;
+      cairo_get_matrix(cr, &m);
+      if (m.xx != 1.0 || m.yy != 1.0 || m.xy != 0.0 || m.yx != 0.0) {
+        return false;
+      }
+
+      auto result = resolve(font, glyphs, count, m.x0, m.y0);
+
+      // Clearing invalidates the tiles that were already looked up, so they are all looked up again
+      if (result == status::FULL) {
+        clear();
+        result = resolve(font, glyphs, count, m.x0, m.y0);
+      }
+
+      if (result != status::OK) {
+        return false;
+      }
+
+      for (const auto& p : m_placements) {
+        if (p.t->w == 0) {
+          continue;
+        }
+
+        double x = p.x + p.t->dx;
+        double y = p.y + p.t->dy;
+
+        cairo_save(cr);
+        cairo_identity_matrix(cr);
+        cairo_rectangle(cr, x, y, p.t->w, p.t->h);
+        cairo_clip(cr);
+        cairo_mask_surface(cr, m_surface, x - p.t->x, y - p.t->y);
+        cairo_restore(cr);
+      }
+
+      return true;
+    }
+
+   protected:
+    enum class status { OK, FULL, TOO_LARGE };
+
+    struct key {
+      const void* font;
+      unsigned long index;
+      int subpixel;
+
+      bool operator==(const key& other) const {
+        return font == other.font && index == other.index && subpixel == other.subpixel;
+      }
+    };
+
+    struct key_hash {
+      size_t operator()(const key& k) const {
+        size_t h = std::hash<const void*>{}(k.font);
+        h ^= std::hash<unsigned long>{}(k.index) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h ^ (static_cast<size_t>(k.subpixel) << 1);
+      }
+    };
+
+    /**
+     * Position of a glyph in the atlas
+     *
+     * The tile is drawn at (dx, dy) relative to the pixel the glyph origin
+     * falls into. Empty glyphs (e.g. spaces) have a width of 0, glyphs that
+     * are larger than MAX_TILE have a negative width.
+     */
+    struct tile {
+      int x, y, w, h;
+      int dx, dy;
+    };
+
+    struct placement {
+      const tile* t;
+      int x, y;
+    };
+
+    /**
+     * Find the tiles for all glyphs, rasterizing the missing ones
+     */
+    status resolve(cairo_scaled_font_t* font, const cairo_glyph_t* glyphs, size_t count, double x0, double y0) {
+      m_placements.clear();
+
+      for (size_t i = 0; i < count; i++) {
+        double x = glyphs[i].x + x0;
+        double px = std::floor(x);
+        int subpixel = static_cast<int>((x - px) * SUBPIXEL_STEPS + 0.5);
+        if (subpixel == SUBPIXEL_STEPS) {
+          px += 1.0;
+          subpixel = 0;
+        }
+
+        key k{font, glyphs[i].index, subpixel};
+        auto it = m_tiles.find(k);
+
+        if (it != m_tiles.end()) {
+          m_stats.hit();
+        } else {
+          m_stats.miss();
+          tile t{};
+          if (!rasterize(font, glyphs[i].index, subpixel, t)) {
+            return status::FULL;
+          }
+          it = m_tiles.emplace(k, t).first;
+        }
+
+        if (it->second.w < 0) {
+          return status::TOO_LARGE;
+        }
+
+        int py = static_cast<int>(std::lround(glyphs[i].y + y0));
+        m_placements.emplace_back(placement{&it->second, static_cast<int>(px), py});
+      }
+
+      return status::OK;
+    }
+
+    /**
+     * Rasterize the glyph into a new tile
+     *
+     * \returns false if there is no space left
+     */
+    bool rasterize(cairo_scaled_font_t* font, unsigned long index, int subpixel, tile& t) {
+      double offset = static_cast<double>(subpixel) / SUBPIXEL_STEPS;
+      cairo_glyph_t glyph{index, 0.0, 0.0};
+      cairo_text_extents_t extents{};
+      cairo_scaled_font_glyph_extents(font, &glyph, 1, &extents);
+
+      if (extents.width == 0.0 || extents.height == 0.0) {
+        t = tile{0, 0, 0, 0, 0, 0};
+        return true;
+      }
+
+      // One pixel of padding on every side for antialiasing
+      int left = static_cast<int>(std::floor(extents.x_bearing + offset)) - 1;
+      int top = static_cast<int>(std::floor(extents.y_bearing)) - 1;
+      int right = static_cast<int>(std::ceil(extents.x_bearing + extents.width + offset)) + 1;
+      int bottom = static_cast<int>(std::ceil(extents.y_bearing + extents.height)) + 1;
+      int w = right - left;
+      int h = bottom - top;
+
+      if (w > MAX_TILE || h > MAX_TILE) {
+        t = tile{0, 0, -1, -1, 0, 0};
+        return true;
+      }
+
+      if (m_shelf_x + w > SIZE) {
+        m_shelf_x = 0;
+        m_shelf_y += m_shelf_h;
+        m_shelf_h = 0;
+      }
+
+      if (m_shelf_y + h > SIZE) {
+        return false;
+      }
+
+      t = tile{m_shelf_x, m_shelf_y, w, h, left, top};
+      m_shelf_x += w;
+      m_shelf_h = std::max(m_shelf_h, h);
+
+      glyph.x = t.x - left + offset;
+      glyph.y = t.y - top;
+      cairo_set_scaled_font(m_cairo, font);
+      cairo_show_glyphs(m_cairo, &glyph, 1);
+      return true;
+    }
+
+    void clear() {
+      cairo_save(m_cairo);
+      cairo_set_operator(m_cairo, CAIRO_OPERATOR_CLEAR);
+      cairo_paint(m_cairo);
+      cairo_restore(m_cairo);
+
+      m_tiles.clear();
+      m_placements.clear();
+      m_shelf_x = 0;
+      m_shelf_y = 0;
+      m_shelf_h = 0;
+    }
+
+   private:
+    cairo_surface_t* m_surface;
+    cairo_t* m_cairo;
+    hit_counter& m_stats;
+
+    std::unordered_map<key, tile, key_hash> m_tiles;
+    vector<placement> m_placements;
+
+    int m_shelf_x{0};
+    int m_shelf_y{0};
+    int m_shelf_h{0};
+  };
+}  // namespace cairo
+
+POLYBAR_NS_END
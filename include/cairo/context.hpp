@@ -7,6 +7,7 @@
 #include <deque>
 
 #include "cairo/font.hpp"
+#include "cairo/patterns.hpp"
 #include "cairo/surface.hpp"
 #include "cairo/types.hpp"
 #include "cairo/utils.hpp"
@@ -70,7 +71,7 @@ namespace cairo {
     }
 
     context& operator<<(const rgba& f) {
-      cairo_set_source_rgba(m_c, f.red_d(), f.green_d(), f.blue_d(), f.alpha_d());
+      cairo_set_source(m_c, m_patterns.solid(f));
       return *this;
     }
 
@@ -92,16 +93,61 @@ namespace cairo {
       return *this;
     }
 
+    context& operator<<(const sparkline& s) {
+      if (s.values.empty()) {
+        return *this;
+      }
+
+      // A single value is drawn as a flat line across the whole width
+      double step = s.values.size() > 1 ? s.w / (s.values.size() - 1) : 0.0;
+      auto point_y = [&](double value) { return s.y + s.h * (1.0 - std::max(0.0, std::min(1.0, value))); };
+
+      cairo_new_sub_path(m_c);
+      cairo_move_to(m_c, s.x, point_y(s.values.front()));
+      for (size_t i = 1; i < s.values.size(); i++) {
+        cairo_line_to(m_c, s.x + step * i, point_y(s.values[i]));
+      }
+      if (s.values.size() == 1) {
+        cairo_line_to(m_c, s.x + s.w, point_y(s.values.front()));
+      }
+
+      if (s.closed) {
+        cairo_line_to(m_c, s.x + s.w, s.y + s.h);
+        cairo_line_to(m_c, s.x, s.y + s.h);
+        cairo_close_path(m_c);
+      }
+      return *this;
+    }
+
     context& operator<<(const translate& d) {
       cairo_translate(m_c, d.x, d.y);
       return *this;
     }
 
     context& operator<<(const linear_gradient& l) {
-      auto stops = l.steps.size();
-      if (stops >= 2) {
+      double dx = l.x2 - l.x1;
+      double dy = l.y2 - l.y1;
+      double length = dx * dx + dy * dy;
+      if (l.steps.size() >= 2 && length > 0.0) {
+        /*
+         * The cached gradient runs from (0, 0) to (1, 0), the matrix maps
+         * (x1, y1) onto the start and (x2, y2) onto the end of it.
+         *
+         * Other contexts never share the pattern and the source is always set
+         * again before drawing, so changing the matrix of a pattern that is
+         * still referenced by a saved state doesn't matter.
+         */
+        cairo_matrix_t m;
+        cairo_matrix_init(&m, dx / length, -dy / length, dy / length, dx / length, -(l.x1 * dx + l.y1 * dy) / length,
+            (l.x1 * dy - l.y1 * dx) / length);
+
+        auto pattern = m_patterns.gradient(l.steps);
+        cairo_pattern_set_matrix(pattern, &m);
+        *this << pattern;
+      } else if (l.steps.size() >= 2) {
+        // A gradient without a length can't be mapped onto the unit line
         auto pattern = cairo_pattern_create_linear(l.x1, l.y1, l.x2, l.y2);
-        auto step = 1.0 / (stops - 1);
+        auto step = 1.0 / (l.steps.size() - 1);
         auto offset = 0.0;
         for (auto&& color : l.steps) {
           // clang-format off
@@ -137,85 +183,123 @@ namespace cairo {
         std::iter_swap(fns.begin(), fns.begin() + t.font - 1);
       }
 
-      string utf8 = string(t.contents);
-      utils::unicode_charlist chars;
-      utils::utf8_to_ucs4((const unsigned char*)utf8.c_str(), chars);
+      const string& utf8 = t.contents;
+      m_chars.clear();
+      utils::utf8_to_ucs4(reinterpret_cast<const unsigned char*>(utf8.data()), utf8.size(), m_chars);
+
+      double bg_x = t.bg_rect.x + *t.x_advance;
+      double bg_y = t.bg_rect.y + *t.y_advance;
+      double width{0.0};
 
-      while (!chars.empty()) {
-        auto remaining = chars.size();
+      auto chars = m_chars.cbegin();
+      while (chars != m_chars.cend()) {
+        auto remaining = chars;
         for (auto&& f : fns) {
-          unsigned int matches = 0;
+          size_t matches = 0;
 
           // Match as many glyphs as possible if the default/preferred font
           // is being tested. Otherwise test one glyph at a time against
           // the remaining fonts. Roll back to the top of the font list
           // when a glyph has been found.
-          if (f == fns.front() && (matches = f->match(chars)) == 0) {
+          if (f == fns.front() && (matches = f->match(chars, m_chars.cend())) == 0) {
             continue;
-          } else if (f != fns.front() && (matches = f->match(chars.front())) == 0) {
+          } else if (f != fns.front() && (matches = f->match(*chars)) == 0) {
             continue;
           }
 
-          string subset;
-          auto end = chars.begin();
-          while (matches-- && end != chars.end()) {
-            subset += utf8.substr(end->offset, end->length);
-            end++;
-          }
-
-          // Use the font
-          f->use();
+          // Matched characters are consecutive, so they are a single substring
+          auto end = chars + std::min<size_t>(matches, m_chars.cend() - chars);
+          auto last = end - 1;
+          string subset = utf8.substr(chars->offset, last->offset + last->length - chars->offset);
 
           // Get subset extents
           cairo_text_extents_t extents;
           f->textwidth(subset, &extents);
 
-          // Draw the background
-          if (t.bg_rect.h != 0.0) {
-            save();
-            cairo_set_operator(m_c, t.bg_operator);
-            *this << t.bg;
-            cairo_rectangle(m_c, t.bg_rect.x + *t.x_advance, t.bg_rect.y + *t.y_advance,
-                t.bg_rect.w + extents.x_advance, t.bg_rect.h);
-            cairo_fill(m_c);
-            restore();
+          // Position the subset's glyphs, they are drawn once the whole block is laid out. Runs that start past
+          // the visible area are only measured
+          if (x <= t.max_x) {
+            auto fontextents = f->extents();
+            auto& glyphs = glyphs_for(f);
+            size_t first = glyphs.size();
+            f->layout(subset, x, y - (fontextents.descent / 2 - fontextents.height / 4) + f->offset(), glyphs);
+
+            if (x + extents.x_advance > t.max_x) {
+              glyphs.erase(std::remove_if(glyphs.begin() + first, glyphs.end(),
+                               [&](const cairo_glyph_t& g) { return g.x > t.max_x; }),
+                  glyphs.end());
+            }
           }
 
-          // Render subset
-          auto fontextents = f->extents();
-          f->render(subset, x, y - (fontextents.descent / 2 - fontextents.height / 4) + f->offset());
-
-          // Get updated position
-          position(&x, nullptr);
-
           // Increase position
+          x += extents.x_advance;
+          width += extents.x_advance;
           *t.x_advance += extents.x_advance;
           *t.y_advance += extents.y_advance;
 
-          chars.erase(chars.begin(), end);
+          chars = end;
           break;
         }
 
-        if (chars.empty()) {
+        if (chars == m_chars.cend()) {
           break;
-        } else if (remaining != chars.size()) {
+        } else if (remaining != chars) {
           continue;
         }
 
         char unicode[6]{'\0'};
-        utils::ucs4_to_utf8(unicode, chars.begin()->codepoint);
-        m_log.warn("Dropping unmatched character %s (U+%04x) in '%s'", unicode, chars.begin()->codepoint, t.contents);
-        utf8.erase(chars.begin()->offset, chars.begin()->length);
-        for (auto&& c : chars) {
-          c.offset -= chars.begin()->length;
-        }
-        chars.erase(chars.begin(), ++chars.begin());
+        utils::ucs4_to_utf8(unicode, chars->codepoint);
+        m_log.warn("Dropping unmatched character %s (U+%04x) in '%s'", unicode, chars->codepoint, t.contents);
+        chars++;
+      }
+
+      // The runs are adjacent, so one rectangle covers the background of all of them
+      if (t.bg_rect.h != 0.0 && width > 0.0) {
+        save();
+        cairo_set_operator(m_c, t.bg_operator);
+        *this << t.bg;
+        cairo_rectangle(m_c, bg_x, bg_y, t.bg_rect.w + width, t.bg_rect.h);
+        cairo_fill(m_c);
+        restore();
       }
 
+      // One submission per font instead of one per run
+      for (size_t i = 0; i < m_layout_used; i++) {
+        m_layout[i].first->use();
+        m_layout[i].first->show_glyphs(m_layout[i].second);
+        m_layout[i].second.clear();
+      }
+      m_layout_used = 0;
+
+      cairo_move_to(m_c, x, y);
+
       return *this;
     }
 
+    /**
+     * Width of the text in the given font, without drawing it
+     */
+    double textwidth(const string& text, int font) {
+      double x{0.0};
+      double y{0.0};
+
+      textblock block{};
+      block.align = alignment::NONE;
+      block.contents = text;
+      block.font = font;
+      block.x_advance = &x;
+      block.y_advance = &y;
+      block.bg_rect = rect{0.0, 0.0, 0.0, 0.0};
+      block.max_x = -std::numeric_limits<double>::infinity();
+
+      save();
+      *this << block;
+      restore();
+      return x;
+    }
+
     context& operator<<(shared_ptr<font>&& f) {
+      f->set_atlas(&m_atlas);
       m_fonts.emplace_back(forward<decltype(f)>(f));
       return *this;
     }
@@ -262,6 +346,13 @@ namespace cairo {
       return *this;
     }
 
+    context& stroke(double width) {
+      cairo_set_line_width(m_c, width);
+      cairo_set_line_join(m_c, CAIRO_LINE_JOIN_ROUND);
+      cairo_stroke(m_c);
+      return *this;
+    }
+
     context& mask(cairo_pattern_t* pattern) {
       cairo_mask(m_c, pattern);
       return *this;
@@ -333,10 +424,39 @@ namespace cairo {
     }
 
    protected:
+    /**
+     * Glyph list of the font for the textblock that is being laid out
+     *
+     * The lists are kept between blocks so that their memory is reused.
+     */
+    vector<cairo_glyph_t>& glyphs_for(const shared_ptr<font>& f) {
+      for (size_t i = 0; i < m_layout_used; i++) {
+        if (m_layout[i].first == f.get()) {
+          return m_layout[i].second;
+        }
+      }
+
+      if (m_layout_used == m_layout.size()) {
+        m_layout.emplace_back();
+      }
+
+      m_layout[m_layout_used].first = f.get();
+      return m_layout[m_layout_used++].second;
+    }
+
     cairo_t* m_c;
     const logger& m_log;
+    glyph_atlas m_atlas;
+    pattern_cache m_patterns;
     vector<shared_ptr<font>> m_fonts;
     std::deque<pair<double, double>> m_points;
+    vector<pair<font*, vector<cairo_glyph_t>>> m_layout;
+    size_t m_layout_used{0};
+
+    /**
+     * Decoded characters of the current textblock, kept to reuse the memory
+     */
+    utils::unicode_charlist m_chars;
     int m_activegroups{0};
   };
 }  // namespace cairo
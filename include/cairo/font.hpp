@@ -2,15 +2,25 @@
 
 #include <cairo/cairo-ft.h>
 
+#include <list>
+#include <unordered_map>
+
+#include "cairo/atlas.hpp"
 #include "cairo/types.hpp"
 #include "cairo/utils.hpp"
 #include "common.hpp"
+#include "components/stats.hpp"
 #include "errors.hpp"
 #include "settings.hpp"
 #include "utils/math.hpp"
 #include "utils/scope.hpp"
 #include "utils/string.hpp"
 
+#if WITH_HARFBUZZ
+#include <hb-ft.h>
+#include <hb.h>
+#endif
+
 POLYBAR_NS
 
 namespace cairo {
@@ -38,9 +48,34 @@ namespace cairo {
       cairo_set_font_face(m_cairo, cairo_font_face_reference(m_font_face));
     }
 
-    virtual size_t match(utils::unicode_character& character) = 0;
-    virtual size_t match(utils::unicode_charlist& charlist) = 0;
+    /**
+     * Draw glyphs through the given atlas where possible
+     */
+    void set_atlas(glyph_atlas* atlas) {
+      m_atlas = atlas;
+    }
+
+    virtual size_t match(const utils::unicode_character& character) = 0;
+
+    /**
+     * Number of leading characters in [first, last) this font has glyphs for
+     */
+    virtual size_t match(
+        utils::unicode_charlist::const_iterator first, utils::unicode_charlist::const_iterator last) = 0;
     virtual size_t render(const string& text, double x = 0.0, double y = 0.0) = 0;
+
+    /**
+     * Append the glyphs for the longest prefix of the text this font can
+     * display, with the origin of the first glyph at (x, y)
+     *
+     * \returns Length of that prefix in bytes
+     */
+    virtual size_t layout(const string& text, double x, double y, vector<cairo_glyph_t>& glyphs) = 0;
+
+    /**
+     * Draw glyphs produced by layout() with the current source
+     */
+    virtual void show_glyphs(const vector<cairo_glyph_t>& glyphs) = 0;
     virtual void textwidth(const string& text, cairo_text_extents_t* extents) = 0;
 
    protected:
@@ -48,6 +83,7 @@ namespace cairo {
     cairo_font_face_t* m_font_face{nullptr};
     cairo_font_extents_t m_extents{};
     double m_offset{0.0};
+    glyph_atlas* m_atlas{nullptr};
   };
 
   /**
@@ -55,36 +91,16 @@ namespace cairo {
    */
   class font_fc : public font {
    public:
-    explicit font_fc(cairo_t* cairo, FcPattern* pattern, double offset, double dpi_x, double dpi_y) : font(cairo, offset), m_pattern(pattern) {
-      cairo_matrix_t fm;
-      cairo_matrix_t ctm;
-      cairo_matrix_init_scale(&fm, size(dpi_x), size(dpi_y));
-      cairo_get_matrix(m_cairo, &ctm);
-
-      auto fontface = cairo_ft_font_face_create_for_pattern(m_pattern);
-      auto opts = cairo_font_options_create();
-      m_scaled = cairo_scaled_font_create(fontface, &fm, &ctm, opts);
-      cairo_font_options_destroy(opts);
-      cairo_font_face_destroy(fontface);
-
-      auto status = cairo_scaled_font_status(m_scaled);
-      if (status != CAIRO_STATUS_SUCCESS) {
-        throw application_error(sstream() << "cairo_scaled_font_create(): " << cairo_status_to_string(status));
-      }
-
-      auto lock = make_unique<utils::ft_face_lock>(m_scaled);
-      auto face = static_cast<FT_Face>(*lock);
-
-      if (FT_Select_Charmap(face, FT_ENCODING_UNICODE) == FT_Err_Ok) {
-        return;
-      } else if (FT_Select_Charmap(face, FT_ENCODING_BIG5) == FT_Err_Ok) {
-        return;
-      } else if (FT_Select_Charmap(face, FT_ENCODING_SJIS) == FT_Err_Ok) {
-        return;
-      }
-
-      lock.reset();
-    }
+    /**
+     * The scaled font is only created once the font is actually used, fonts
+     * that are only there as a fallback don't slow down startup.
+     */
+    explicit font_fc(cairo_t* cairo, FcPattern* pattern, double offset, double dpi_x, double dpi_y)
+        : font(cairo, offset)
+        , m_pattern(pattern)
+        , m_dpi_x(dpi_x)
+        , m_dpi_y(dpi_y)
+        , m_cache_stats(stats::make().counter("font.glyph_cache")) {}
 
     ~font_fc() override {
       if (m_scaled != nullptr) {
@@ -96,7 +112,7 @@ namespace cairo {
     }
 
     cairo_font_extents_t extents() override {
-      cairo_scaled_font_extents(m_scaled, &m_extents);
+      cairo_scaled_font_extents(scaled(), &m_extents);
       return m_extents;
     }
 
@@ -184,90 +200,128 @@ namespace cairo {
     }
 
     void use() override {
-      cairo_set_scaled_font(m_cairo, m_scaled);
+      cairo_set_scaled_font(m_cairo, scaled());
     }
 
-    size_t match(utils::unicode_character& character) override {
-      auto lock = make_unique<utils::ft_face_lock>(m_scaled);
-      auto face = static_cast<FT_Face>(*lock);
-      return FT_Get_Char_Index(face, character.codepoint) ? 1 : 0;
+    size_t match(const utils::unicode_character& character) override {
+      unique_ptr<utils::ft_face_lock> lock;
+      return has_glyph(character.codepoint, lock) ? 1 : 0;
     }
 
-    size_t match(utils::unicode_charlist& charlist) override {
-      auto lock = make_unique<utils::ft_face_lock>(m_scaled);
-      auto face = static_cast<FT_Face>(*lock);
+    size_t match(
+        utils::unicode_charlist::const_iterator first, utils::unicode_charlist::const_iterator last) override {
+      unique_ptr<utils::ft_face_lock> lock;
       size_t available_chars = 0;
-      for (auto&& c : charlist) {
-        if (FT_Get_Char_Index(face, c.codepoint)) {
-          available_chars++;
-        } else {
-          break;
-        }
+      for (; first != last && has_glyph(first->codepoint, lock); ++first) {
+        available_chars++;
       }
 
       return available_chars;
     }
 
     size_t render(const string& text, double x = 0.0, double y = 0.0) override {
-      cairo_glyph_t* glyphs{nullptr};
-      cairo_text_cluster_t* clusters{nullptr};
-      cairo_text_cluster_flags_t cf{};
-      int nglyphs = 0, nclusters = 0;
-
-      string utf8 = string(text);
-      auto status = cairo_scaled_font_text_to_glyphs(
-          m_scaled, x, y, utf8.c_str(), utf8.size(), &glyphs, &nglyphs, &clusters, &nclusters, &cf);
-
-      if (status != CAIRO_STATUS_SUCCESS) {
-        throw application_error(sstream() << "cairo_scaled_font_text_to_glyphs()" << cairo_status_to_string(status));
-      }
+      m_positioned.clear();
+      size_t bytes = layout(text, x, y, m_positioned);
 
-      size_t bytes = 0;
-      for (int g = 0; g < nglyphs; g++) {
-        if (glyphs[g].index) {
-          bytes += clusters[g].num_bytes;
-        } else {
-          break;
-        }
+      if (bytes) {
+        show_glyphs(m_positioned);
+        cairo_move_to(m_cairo, x + shape(text).extents.x_advance, 0.0);
       }
 
-      if (bytes && bytes < text.size()) {
-        cairo_glyph_free(glyphs);
-        cairo_text_cluster_free(clusters);
+      return bytes;
+    }
 
-        utf8 = text.substr(0, bytes);
-        auto status = cairo_scaled_font_text_to_glyphs(
-            m_scaled, x, y, utf8.c_str(), utf8.size(), &glyphs, &nglyphs, &clusters, &nclusters, &cf);
+    size_t layout(const string& text, double x, double y, vector<cairo_glyph_t>& glyphs) override {
+      const auto& run = shape(text);
 
-        if (status != CAIRO_STATUS_SUCCESS) {
-          throw application_error(sstream() << "cairo_scaled_font_text_to_glyphs()" << cairo_status_to_string(status));
-        }
+      // Cached glyphs are positioned relative to the origin
+      for (auto glyph : run.glyphs) {
+        glyph.x += x;
+        glyph.y += y;
+        glyphs.emplace_back(glyph);
       }
 
-      if (bytes) {
-        // auto lock = make_unique<utils::device_lock>(cairo_surface_get_device(cairo_get_target(m_cairo)));
-        // if (lock.get()) {
-        //   cairo_glyph_path(m_cairo, glyphs, nglyphs);
-        // }
-
-        cairo_text_extents_t extents{};
-        cairo_scaled_font_glyph_extents(m_scaled, glyphs, nglyphs, &extents);
-        cairo_show_text_glyphs(m_cairo, utf8.c_str(), utf8.size(), glyphs, nglyphs, clusters, nclusters, cf);
-        cairo_fill(m_cairo);
-        cairo_move_to(m_cairo, x + extents.x_advance, 0.0);
+      return run.bytes;
+    }
+
+    void show_glyphs(const vector<cairo_glyph_t>& glyphs) override {
+      if (glyphs.empty()) {
+        return;
       }
 
-      cairo_glyph_free(glyphs);
-      cairo_text_cluster_free(clusters);
+      // m_color is only valid once the font is loaded
+      auto font = scaled();
+      if (m_atlas != nullptr && !m_color && m_atlas->show_glyphs(m_cairo, font, glyphs.data(), glyphs.size())) {
+        return;
+      }
 
-      return bytes;
+      cairo_set_scaled_font(m_cairo, font);
+      cairo_show_glyphs(m_cairo, glyphs.data(), glyphs.size());
     }
 
+    /**
+     * Measure the text, the result is cached together with its shaped run
+     */
     void textwidth(const string& text, cairo_text_extents_t* extents) override {
-      cairo_scaled_font_text_extents(m_scaled, text.c_str(), extents);
+      auto& run = shape(text);
+
+      // The run only covers the prefix this font has glyphs for
+      if (run.bytes == text.size()) {
+        *extents = run.extents;
+        return;
+      }
+
+      if (!run.measured) {
+        cairo_scaled_font_text_extents(scaled(), text.c_str(), &run.text_extents);
+        run.measured = true;
+      }
+      *extents = run.text_extents;
     }
 
    protected:
+    /**
+     * Get the scaled font, creating it on first use
+     */
+    cairo_scaled_font_t* scaled() {
+      if (m_scaled == nullptr) {
+        load();
+      }
+      return m_scaled;
+    }
+
+    void load() {
+      cairo_matrix_t fm;
+      cairo_matrix_t ctm;
+      cairo_matrix_init_scale(&fm, size(m_dpi_x), size(m_dpi_y));
+      // The context may be transformed by now, fonts are created for its untransformed user space
+      cairo_matrix_init_identity(&ctm);
+
+      auto fontface = cairo_ft_font_face_create_for_pattern(m_pattern);
+      auto opts = cairo_font_options_create();
+      auto scaled = cairo_scaled_font_create(fontface, &fm, &ctm, opts);
+      cairo_font_options_destroy(opts);
+      cairo_font_face_destroy(fontface);
+
+      auto status = cairo_scaled_font_status(scaled);
+      if (status != CAIRO_STATUS_SUCCESS) {
+        cairo_scaled_font_destroy(scaled);
+        throw application_error(sstream() << "cairo_scaled_font_create(): " << cairo_status_to_string(status));
+      }
+
+      m_scaled = scaled;
+
+      utils::ft_face_lock lock(m_scaled);
+      auto face = static_cast<FT_Face>(lock);
+
+      // Color glyphs would lose their colors in the grayscale atlas
+      m_color = FT_HAS_COLOR(face);
+
+      if (FT_Select_Charmap(face, FT_ENCODING_UNICODE) != FT_Err_Ok &&
+          FT_Select_Charmap(face, FT_ENCODING_BIG5) != FT_Err_Ok) {
+        FT_Select_Charmap(face, FT_ENCODING_SJIS);
+      }
+    }
+
     string property(string&& property) const {
       FcChar8* file;
       if (FcPatternGetString(m_pattern, property.c_str(), 0, &file) == FcResultMatch) {
@@ -291,15 +345,224 @@ namespace cairo {
       FcPatternGetInteger(m_pattern, property.c_str(), 0, dst);
     }
 
+    /**
+     * Check if the font has a glyph for the codepoint
+     *
+     * The face is only locked (through `lock`, which is kept for the next
+     * call) for codepoints that weren't looked up before.
+     */
+    bool has_glyph(unsigned long codepoint, unique_ptr<utils::ft_face_lock>& lock) {
+      if (m_coverage.known(codepoint)) {
+        return m_coverage.covered(codepoint);
+      }
+
+      if (!lock) {
+        lock = make_unique<utils::ft_face_lock>(scaled());
+      }
+
+      bool covered = FT_Get_Char_Index(static_cast<FT_Face>(*lock), codepoint) != 0;
+      m_coverage.set(codepoint, covered);
+      return covered;
+    }
+
+    /**
+     * Glyphs for the longest prefix of a text that this font can display
+     */
+    struct shaped_run {
+      vector<cairo_glyph_t> glyphs;
+      /**
+       * Length of the prefix in bytes, 0 if the font has no glyph for the first character
+       */
+      size_t bytes{0};
+      cairo_text_extents_t extents{};
+      /**
+       * Extents of the whole text, only set by textwidth() if the run doesn't cover all of it
+       */
+      bool measured{false};
+      cairo_text_extents_t text_extents{};
+    };
+
+    /**
+     * Get the shaped run for the text, shaping it only if it isn't cached
+     *
+     * Bar contents barely change between redraws, so the same texts are
+     * rendered over and over. The least recently used run is evicted once
+     * the cache is full.
+     */
+    shaped_run& shape(const string& text) {
+      auto it = m_cache_index.find(text);
+      if (it != m_cache_index.end()) {
+        m_cache_stats.hit();
+        m_cache.splice(m_cache.begin(), m_cache, it->second);
+        return it->second->second;
+      }
+
+      m_cache_stats.miss();
+
+      shaped_run run{};
+#if WITH_HARFBUZZ
+      shape_harfbuzz(text, run);
+#else
+      shape_cairo(text, run);
+#endif
+
+      m_cache.emplace_front(text, move(run));
+      m_cache_index[text] = m_cache.begin();
+
+      if (m_cache.size() > CACHE_SIZE) {
+        m_cache_index.erase(m_cache.back().first);
+        m_cache.pop_back();
+      }
+
+      return m_cache.front().second;
+    }
+
+    /**
+     * Shape the text with cairo's own text to glyph conversion
+     */
+    void shape_cairo(const string& text, shaped_run& run) {
+      cairo_glyph_t* glyphs{nullptr};
+      cairo_text_cluster_t* clusters{nullptr};
+      cairo_text_cluster_flags_t flags{};
+      int nglyphs = 0, nclusters = 0;
+
+      auto status = cairo_scaled_font_text_to_glyphs(
+          scaled(), 0.0, 0.0, text.c_str(), text.size(), &glyphs, &nglyphs, &clusters, &nclusters, &flags);
+
+      if (status != CAIRO_STATUS_SUCCESS) {
+        throw application_error(sstream() << "cairo_scaled_font_text_to_glyphs()" << cairo_status_to_string(status));
+      }
+
+      for (int g = 0; g < nglyphs; g++) {
+        if (glyphs[g].index) {
+          run.bytes += clusters[g].num_bytes;
+        } else {
+          break;
+        }
+      }
+
+      if (run.bytes && run.bytes < text.size()) {
+        cairo_glyph_free(glyphs);
+        cairo_text_cluster_free(clusters);
+
+        auto status = cairo_scaled_font_text_to_glyphs(
+            scaled(), 0.0, 0.0, text.c_str(), run.bytes, &glyphs, &nglyphs, &clusters, &nclusters, &flags);
+
+        if (status != CAIRO_STATUS_SUCCESS) {
+          throw application_error(sstream() << "cairo_scaled_font_text_to_glyphs()" << cairo_status_to_string(status));
+        }
+      }
+
+      if (run.bytes) {
+        run.glyphs.assign(glyphs, glyphs + nglyphs);
+        cairo_scaled_font_glyph_extents(scaled(), glyphs, nglyphs, &run.extents);
+      }
+
+      cairo_glyph_free(glyphs);
+      cairo_text_cluster_free(clusters);
+    }
+
+#if WITH_HARFBUZZ
+    /**
+     * Shape the text with HarfBuzz
+     *
+     * This applies the font's ligatures and handles complex scripts.
+     */
+    void shape_harfbuzz(const string& text, shaped_run& run) {
+      {
+        utils::ft_face_lock lock(scaled());
+        auto face = static_cast<FT_Face>(lock);
+
+        // Created while the face is locked, so that it picks up the size cairo set on the face
+        hb_font_t* font = hb_ft_font_create_referenced(face);
+        hb_buffer_t* buffer = hb_buffer_create();
+        auto cleanup = scope_util::make_exit_handler([&] {
+          hb_buffer_destroy(buffer);
+          hb_font_destroy(font);
+        });
+
+        auto shape = [&](size_t length) {
+          hb_buffer_clear_contents(buffer);
+          hb_buffer_add_utf8(buffer, text.c_str(), text.size(), 0, length);
+          hb_buffer_guess_segment_properties(buffer);
+          hb_shape(font, buffer, nullptr, 0);
+        };
+
+        shape(text.size());
+
+        unsigned int count{0};
+        hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(buffer, &count);
+        bool backward = HB_DIRECTION_IS_BACKWARD(hb_buffer_get_direction(buffer));
+
+        // Clusters are byte offsets into the text, the first missing glyph ends the prefix
+        run.bytes = text.size();
+        for (unsigned int i = 0; i < count; i++) {
+          const auto& info = infos[backward ? count - 1 - i : i];
+          if (info.codepoint == 0) {
+            run.bytes = info.cluster;
+            break;
+          }
+        }
+
+        if (run.bytes == 0) {
+          return;
+        }
+
+        if (run.bytes < text.size()) {
+          shape(run.bytes);
+          infos = hb_buffer_get_glyph_infos(buffer, &count);
+        }
+
+        hb_glyph_position_t* positions = hb_buffer_get_glyph_positions(buffer, &count);
+
+        // Positions are in 26.6 fixed point and the y axis points up
+        double x{0.0}, y{0.0};
+        run.glyphs.resize(count);
+        for (unsigned int i = 0; i < count; i++) {
+          run.glyphs[i].index = infos[i].codepoint;
+          run.glyphs[i].x = x + positions[i].x_offset / 64.0;
+          run.glyphs[i].y = y - positions[i].y_offset / 64.0;
+          x += positions[i].x_advance / 64.0;
+          y -= positions[i].y_advance / 64.0;
+        }
+      }
+
+      // cairo locks the face itself, so this must happen after the lock is released
+      cairo_scaled_font_glyph_extents(scaled(), run.glyphs.data(), run.glyphs.size(), &run.extents);
+    }
+#endif
+
    private:
+    static constexpr size_t CACHE_SIZE{256};
+
     cairo_scaled_font_t* m_scaled{nullptr};
     FcPattern* m_pattern{nullptr};
+    double m_dpi_x;
+    double m_dpi_y;
+
+    utils::glyph_coverage m_coverage;
+    bool m_color{false};
+
+    /**
+     * Shaped runs by text, most recently used first
+     */
+    std::list<pair<string, shaped_run>> m_cache;
+    std::unordered_map<string, std::list<pair<string, shaped_run>>::iterator> m_cache_index;
+    hit_counter& m_cache_stats;
+
+    /**
+     * Glyphs of the run that is being drawn, moved to the drawing position
+     */
+    vector<cairo_glyph_t> m_positioned;
   };
 
   /**
-   * Match and create font from given fontconfig pattern
+   * Initialize fontconfig and FreeType
+   *
+   * Must be called before fonts are matched, match_font() can be called
+   * from multiple threads afterwards.
    */
-  inline decltype(auto) make_font(cairo_t* cairo, string&& fontname, double offset, double dpi_x, double dpi_y) {
+  inline void init_fonts() {
     static bool fc_init{false};
     if (!fc_init && !(fc_init = FcInit())) {
       throw application_error("Could not load fontconfig");
@@ -311,7 +574,14 @@ namespace cairo {
       FT_Done_FreeType(g_ftlib);
       FcFini();
     });
+  }
 
+  /**
+   * Find the font that fontconfig matches for the given pattern
+   *
+   * The caller owns the returned pattern
+   */
+  inline FcPattern* match_font(const string& fontname) {
     auto pattern = FcNameParse((FcChar8*)fontname.c_str());
 
     if(!pattern) {
@@ -334,7 +604,15 @@ namespace cairo {
     FcPatternPrint(match);
 #endif
 
-    return make_shared<font_fc>(cairo, match, offset, dpi_x, dpi_y);
+    return match;
+  }
+
+  /**
+   * Match and create font from given fontconfig pattern
+   */
+  inline decltype(auto) make_font(cairo_t* cairo, string&& fontname, double offset, double dpi_x, double dpi_y) {
+    init_fonts();
+    return make_shared<font_fc>(cairo, match_font(fontname), offset, dpi_x, dpi_y);
   }
 }
 
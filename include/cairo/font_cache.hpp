@@ -0,0 +1,48 @@
+#pragma once
+
+#include <fontconfig/fontconfig.h>
+
+#include <map>
+#include <mutex>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+class logger;
+
+namespace cairo {
+  /**
+   * \brief Fontconfig matches of font patterns, persisted between runs
+   *
+   * Each entry maps a font string from the config to the pattern fontconfig
+   * matched for it (file, index, size and rendering properties). The whole
+   * cache is dropped once the fontconfig configuration, its caches or any of
+   * the font directories change.
+   *
+   * lookup() and store() can be called from multiple threads.
+   */
+  class font_cache : non_copyable_mixin<font_cache> {
+   public:
+    explicit font_cache(const logger& logger, string path);
+
+    FcPattern* lookup(const string& pattern);
+    void store(const string& pattern, FcPattern* match);
+    void save();
+
+   protected:
+    static string stamp();
+
+   private:
+    const logger& m_log;
+    const string m_path;
+    const string m_stamp;
+
+    std::mutex m_lock;
+    std::map<string, string> m_entries;
+    bool m_dirty{false};
+  };
+}  // namespace cairo
+
+POLYBAR_NS_END
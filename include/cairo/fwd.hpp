@@ -8,8 +8,10 @@ namespace cairo {
   class context;
   class surface;
   class xcb_surface;
+  class image_surface;
   class font;
   class font_fc;
+  class glyph_atlas;
 }
 
 POLYBAR_NS_END
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cairo/cairo.h>
+
+#include <algorithm>
+
+#include "common.hpp"
+#include "components/stats.hpp"
+#include "utils/color.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace cairo {
+  /**
+   * \brief Solid and linear gradient patterns that are reused between frames
+   *
+   * Bars switch between the same few colors in every frame. Instead of
+   * creating a new source for every switch, the patterns are created once and
+   * kept in small most recently used lists.
+   *
+   * Gradients are created along the unit line from (0, 0) to (1, 0) and only
+   * depend on their color stops. The caller moves them into place by setting
+   * the pattern matrix, so the same gradient is reused wherever it is drawn.
+   */
+  class pattern_cache : non_copyable_mixin<pattern_cache> {
+   public:
+    static constexpr size_t MAX_SOLID{32};
+    static constexpr size_t MAX_GRADIENTS{8};
+
+    explicit pattern_cache() : m_stats(stats::make().counter("cairo.patterns")) {}
+
+    ~pattern_cache() {
+      for (auto&& entry : m_solid) {
+        cairo_pattern_destroy(entry.second);
+      }
+      for (auto&& entry : m_gradients) {
+        cairo_pattern_destroy(entry.second);
+      }
+    }
+
+    cairo_pattern_t* solid(const rgba& color) {
+      auto key = color_key(color);
+      return lookup(m_solid, key, MAX_SOLID, [&] {
+        return cairo_pattern_create_rgba(color.red_d(), color.green_d(), color.blue_d(), color.alpha_d());
+      });
+    }
+
+    /**
+     * Gradient along the unit line with evenly spaced stops, at least two are needed
+     */
+    cairo_pattern_t* gradient(const vector<rgba>& steps) {
+      m_key.clear();
+      for (auto&& color : steps) {
+        m_key.emplace_back(color_key(color));
+      }
+
+      return lookup(m_gradients, m_key, MAX_GRADIENTS, [&] {
+        auto pattern = cairo_pattern_create_linear(0.0, 0.0, 1.0, 0.0);
+        auto step = 1.0 / (steps.size() - 1);
+        auto offset = 0.0;
+        for (auto&& color : steps) {
+          // clang-format off
+          cairo_pattern_add_color_stop_rgba(pattern, offset, color.red_d(), color.green_d(), color.blue_d(), color.alpha_d());
+          // clang-format on
+          offset += step;
+        }
+        return pattern;
+      });
+    }
+
+   protected:
+    /**
+     * The color components depend on both the value and the type
+     */
+    static uint64_t color_key(const rgba& color) {
+      return static_cast<uint64_t>(color.type()) << 32 | color.value();
+    }
+
+    /**
+     * Pattern for the key, moved to the front of the list
+     *
+     * On a miss the pattern is created and the least recently used one is
+     * dropped if the list is full.
+     */
+    template <typename Key, typename Create>
+    cairo_pattern_t* lookup(vector<pair<Key, cairo_pattern_t*>>& list, const Key& key, size_t max, Create&& create) {
+      auto it = std::find_if(list.begin(), list.end(), [&](const pair<Key, cairo_pattern_t*>& e) { return e.first == key; });
+
+      if (it != list.end()) {
+        m_stats.hit();
+        std::rotate(list.begin(), it, it + 1);
+        return list.front().second;
+      }
+
+      m_stats.miss();
+      if (list.size() == max) {
+        cairo_pattern_destroy(list.back().second);
+        list.pop_back();
+      }
+      list.emplace(list.begin(), key, create());
+      return list.front().second;
+    }
+
+   private:
+    hit_counter& m_stats;
+    vector<pair<uint64_t, cairo_pattern_t*>> m_solid;
+    vector<pair<vector<uint64_t>, cairo_pattern_t*>> m_gradients;
+    // Reused to look up gradients without allocating
+    vector<uint64_t> m_key;
+  };
+}  // namespace cairo
+
+POLYBAR_NS_END
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <cairo/cairo-xcb.h>
+#include <unistd.h>
+
+#include <cerrno>
 
 #include "cairo/types.hpp"
 #include "common.hpp"
@@ -52,6 +55,30 @@ namespace cairo {
       }
     }
 
+    /**
+     * Write the png to an open file descriptor, which stays open
+     */
+    void write_png(int fd) {
+      const auto write_fd = [](void* closure, const unsigned char* data, unsigned int length) -> cairo_status_t {
+        int fd{*static_cast<int*>(closure)};
+        while (length > 0) {
+          ssize_t bytes = ::write(fd, data, length);
+          if (bytes == -1 && errno != EINTR) {
+            return CAIRO_STATUS_WRITE_ERROR;
+          } else if (bytes > 0) {
+            data += bytes;
+            length -= bytes;
+          }
+        }
+        return CAIRO_STATUS_SUCCESS;
+      };
+
+      auto status = cairo_surface_write_to_png_stream(m_s, write_fd, &fd);
+      if (status != CAIRO_STATUS_SUCCESS) {
+        throw application_error(sstream() << "cairo_surface_write_to_png_stream(): " << cairo_status_to_string(status));
+      }
+    }
+
    protected:
     cairo_surface_t* m_s;
   };
@@ -71,6 +98,33 @@ namespace cairo {
       cairo_xcb_surface_set_drawable(m_s, d, w, h);
     }
   };
+
+  /**
+   * \brief Surface for client side image data
+   *
+   * The data is owned by the caller and has to outlive the surface
+   */
+  class image_surface : public surface {
+   public:
+    explicit image_surface(unsigned char* data, cairo_format_t format, int w, int h, int stride)
+        : surface(cairo_image_surface_create_for_data(data, format, w, h, stride)) {}
+
+    ~image_surface() override {}
+  };
+
+  /**
+   * \brief View of a rectangle of another surface
+   *
+   * Nothing is copied, drawing from it reads the pixels of the other surface,
+   * which has to outlive this one
+   */
+  class sub_surface : public surface {
+   public:
+    explicit sub_surface(const surface& target, double x, double y, double w, double h)
+        : surface(cairo_surface_create_for_rectangle(target, x, y, w, h)) {}
+
+    ~sub_surface() override {}
+  };
 }
 
 POLYBAR_NS_END
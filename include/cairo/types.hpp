@@ -2,6 +2,8 @@
 
 #include <cairo/cairo.h>
 
+#include <limits>
+
 #include "common.hpp"
 #include "components/types.hpp"
 
@@ -36,6 +38,20 @@ namespace cairo {
     double y2;
     double w;
   };
+  /**
+   * Line through values in [0, 1] spread evenly over the rectangle, 1 is at the top
+   *
+   * If closed, the path continues along the bottom of the rectangle so that
+   * the area below the line can be filled.
+   */
+  struct sparkline {
+    double x;
+    double y;
+    double w;
+    double h;
+    const vector<double>& values;
+    bool closed{false};
+  };
   struct translate {
     double x;
     double y;
@@ -63,6 +79,10 @@ namespace cairo {
     rect bg_rect;
     double* x_advance;
     double* y_advance;
+    /**
+     * Glyphs that start right of this position are measured but not drawn
+     */
+    double max_x{std::numeric_limits<double>::infinity()};
   };
 }  // namespace cairo
 
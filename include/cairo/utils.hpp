@@ -1,7 +1,10 @@
 #pragma once
 
 #include <cairo/cairo-ft.h>
-#include <list>
+
+#include <array>
+#include <bitset>
+#include <vector>
 
 #include "common.hpp"
 
@@ -38,6 +41,36 @@ namespace cairo {
       FT_Face m_face;
     };
 
+    /**
+     * \brief Lazily filled record of the codepoints a font has glyphs for
+     *
+     * Codepoints are split into the 17 unicode planes, each plane into pages
+     * of 256 codepoints. Pages are only allocated once one of their
+     * codepoints is recorded, so a font that is only used for a few icons
+     * takes up a few hundred bytes.
+     */
+    class glyph_coverage {
+     public:
+      bool known(unsigned long codepoint) const;
+      bool covered(unsigned long codepoint) const;
+      void set(unsigned long codepoint, bool covered);
+
+     private:
+      static constexpr unsigned long PLANES{17};
+      static constexpr unsigned long PAGES{256};
+      static constexpr unsigned long PAGE_SIZE{256};
+
+      struct page {
+        std::bitset<PAGE_SIZE> known;
+        std::bitset<PAGE_SIZE> covered;
+      };
+      using plane = std::array<unique_ptr<page>, PAGES>;
+
+      const page* find(unsigned long codepoint) const;
+
+      std::array<unique_ptr<plane>, PLANES> m_planes;
+    };
+
     /**
      * \brief Unicode character containing converted codepoint
      * and details on where its position in the source string
@@ -48,7 +81,11 @@ namespace cairo {
       int offset;
       int length;
     };
-    using unicode_charlist = std::list<unicode_character>;
+    /**
+     * \brief Decoded characters, stored contiguously so that reusing the
+     * list for the next string doesn't allocate
+     */
+    using unicode_charlist = std::vector<unicode_character>;
 
     /**
      * \see <cairo/cairo.h>
@@ -59,6 +96,7 @@ namespace cairo {
      * \brief Create a UCS-4 codepoint from a utf-8 encoded string
      */
     bool utf8_to_ucs4(const unsigned char* src, unicode_charlist& result_list);
+    bool utf8_to_ucs4(const unsigned char* src, size_t len, unicode_charlist& result_list);
 
     /**
      * \brief Convert a UCS-4 codepoint to a utf-8 encoded string
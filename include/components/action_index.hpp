@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common.hpp"
+#include "components/types.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Hit-test index over the action blocks of a frame
+ *
+ * The bar is split into segments at every start and end of an action block,
+ * for each segment the blocks covering it are stored innermost first. Looking
+ * up the blocks under the cursor is then a binary search over the segment
+ * boundaries instead of a test against every block.
+ *
+ * Nested blocks are added after their surrounding block, so the innermost
+ * block is the one added last.
+ *
+ * The index is built once per frame and never changed afterwards. It points
+ * into its own copy of the blocks and can therefore not be copied.
+ */
+class action_index : non_copyable_mixin<action_index> {
+ public:
+  using const_iterator = vector<const action_block*>::const_iterator;
+
+  /**
+   * Action blocks covering a point, innermost first
+   */
+  struct range {
+    const_iterator first;
+    const_iterator last;
+
+    const_iterator begin() const {
+      return first;
+    }
+    const_iterator end() const {
+      return last;
+    }
+    bool empty() const {
+      return first == last;
+    }
+  };
+
+  explicit action_index() = default;
+  explicit action_index(vector<action_block> actions);
+
+  const vector<action_block>& actions() const;
+  range at(int point) const;
+  const action_block* find(int point, mousebtn btn) const;
+
+ private:
+  vector<action_block> m_actions;
+
+  /**
+   * Sorted segment boundaries, segment i spans [m_bounds[i], m_bounds[i + 1])
+   */
+  vector<int> m_bounds;
+
+  /**
+   * Blocks of segment i are m_entries[m_offsets[i]] to m_entries[m_offsets[i + 1]]
+   */
+  vector<size_t> m_offsets;
+  vector<const action_block*> m_entries;
+};
+
+POLYBAR_NS_END
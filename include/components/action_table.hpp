@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "utils/actions.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Short ids for the actions of internal modules
+ *
+ * Modules emit the same actions in every output. Instead of the full action
+ * string (`#name.action.data`), the builder puts an id of the form `#<n>` in
+ * the action tag, which keeps the markup short. A click is resolved through
+ * the table without parsing the action string again.
+ *
+ * Ids are handed out by a scope that belongs to the builder of a module and
+ * are dropped together with it, e.g. when the modules are reloaded. They are
+ * never reused, so a click on an output from before that can't reach another
+ * action.
+ *
+ * The table is disabled when the output leaves polybar (`--stdout`, `--json`
+ * or a workload recording), since nothing outside could resolve the ids.
+ */
+class action_table : non_copyable_mixin<action_table> {
+ public:
+  using make_type = action_table&;
+  static make_type make();
+
+  /**
+   * Maximum number of ids a single scope hands out
+   */
+  static constexpr size_t MAX_ENTRIES{4096};
+
+  class scope : non_copyable_mixin<scope> {
+   public:
+    explicit scope(action_table& table);
+    ~scope();
+
+    string intern(const string& module_name, const string& action_name, const string& data);
+
+   private:
+    action_table& m_table;
+    std::unordered_map<string, std::pair<size_t, string>> m_ids;
+    string m_key;
+  };
+
+  void disable();
+  bool enabled() const;
+
+  bool resolve(const string& cmd, actions_util::action& result) const;
+
+ private:
+  size_t add(actions_util::action&& action);
+  void remove(size_t index);
+
+  mutable std::mutex m_lock;
+  std::unordered_map<size_t, actions_util::action> m_entries;
+  size_t m_next{0};
+  std::atomic_bool m_enabled{true};
+};
+
+POLYBAR_NS_END
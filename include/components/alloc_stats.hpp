@@ -0,0 +1,64 @@
+#pragma once
+
+#include "common.hpp"
+#include "settings.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * Subsystem that heap allocations are attributed to, 0 stands for all
+ * allocations made outside of a tagged scope
+ */
+using alloc_tag = unsigned int;
+
+/**
+ * Counts heap allocations per subsystem
+ *
+ * Counting is only done if polybar was built with ENABLE_ALLOC_STATS, which
+ * replaces the global operator new and delete. Otherwise tags are still
+ * handed out, scopes cost nothing and the report is empty.
+ *
+ * Every allocation is attributed to the tag of the innermost scoped_alloc_tag
+ * on the allocating thread. Memory is freed from the tag that allocated it,
+ * no matter which thread frees it.
+ */
+namespace alloc_stats {
+  static constexpr size_t MAX_TAGS{128};
+
+  constexpr bool enabled() {
+    return ENABLE_ALLOC_STATS;
+  }
+
+  alloc_tag tag(const string& name);
+  alloc_tag current();
+  void set_current(alloc_tag tag);
+
+  size_t allocations();
+
+  vector<string> report();
+  void reset();
+}  // namespace alloc_stats
+
+/**
+ * Attributes the allocations of the enclosing scope on this thread to a tag
+ */
+class scoped_alloc_tag : non_copyable_mixin<scoped_alloc_tag> {
+ public:
+#if ENABLE_ALLOC_STATS
+  explicit scoped_alloc_tag(alloc_tag tag) : m_previous(alloc_stats::current()) {
+    alloc_stats::set_current(tag);
+  }
+
+  ~scoped_alloc_tag() {
+    alloc_stats::set_current(m_previous);
+  }
+
+ private:
+  alloc_tag m_previous;
+#else
+  explicit scoped_alloc_tag(alloc_tag) {}
+#endif
+};
+
+POLYBAR_NS_END
@@ -1,15 +1,20 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <mutex>
+#include <thread>
 
 #include "common.hpp"
+#include "components/action_index.hpp"
 #include "components/types.hpp"
 #include "errors.hpp"
 #include "events/signal_fwd.hpp"
 #include "events/signal_receiver.hpp"
 #include "settings.hpp"
+#include "tags/types.hpp"
 #include "utils/math.hpp"
 #include "x11/types.hpp"
 #include "x11/window.hpp"
@@ -53,9 +58,10 @@ inline double geom_format_to_pixels(std::string str, double max) {
 }
 
 class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::property_notify, evt::enter_notify,
-                evt::leave_notify, evt::motion_notify, evt::destroy_notify, evt::client_message, evt::configure_notify>,
-            public signal_receiver<SIGN_PRIORITY_BAR, signals::eventqueue::start, signals::ui::tick,
-                signals::ui::shade_window, signals::ui::unshade_window, signals::ui::dim_window
+                evt::leave_notify, evt::motion_notify, evt::destroy_notify, evt::client_message, evt::configure_notify,
+                evt::visibility_notify>,
+            public signal_receiver<SIGN_PRIORITY_BAR, signals::eventqueue::start, signals::ui::shade_window, signals::ui::unshade_window, signals::ui::dim_window,
+                signals::ui::monitors_changed
 #if WITH_XCURSOR
                 ,
                 signals::ui::cursor_change
@@ -69,14 +75,17 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
       unique_ptr<tray_manager>&&, unique_ptr<tags::dispatch>&&, unique_ptr<taskqueue>&&, bool only_initialize_values);
   ~bar();
 
-  const bar_settings settings() const;
+  const bar_settings& settings() const;
 
-  void parse(string&& data, bool force = false);
+  void parse(tags::format_string&& data, bool force = false);
+  void stop_rendering();
 
   void hide();
   void show();
   void toggle();
 
+  void events_handled();
+
  protected:
   void restack_window();
   void reconfigue_window();
@@ -85,6 +94,15 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
   void reconfigure_struts();
   void reconfigure_wm_hints();
   void broadcast_visibility();
+  void update_suspended();
+  void render_frames();
+  void draw(tags::format_string&& data, bool force);
+  void animate_shade(std::chrono::milliseconds delay);
+  void start_shade(size_t generation);
+  void step_shade();
+#if WITH_XCURSOR
+  void update_cursor();
+#endif
 
   void handle(const evt::client_message& evt);
   void handle(const evt::destroy_notify& evt);
@@ -95,12 +113,13 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
   void handle(const evt::expose& evt);
   void handle(const evt::property_notify& evt);
   void handle(const evt::configure_notify& evt);
+  void handle(const evt::visibility_notify& evt);
 
   bool on(const signals::eventqueue::start&);
   bool on(const signals::ui::unshade_window&);
   bool on(const signals::ui::shade_window&);
-  bool on(const signals::ui::tick&);
   bool on(const signals::ui::dim_window&);
+  bool on(const signals::ui::monitors_changed&);
 #if WITH_XCURSOR
   bool on(const signals::ui::cursor_change&);
 #endif
@@ -118,22 +137,74 @@ class bar : public xpp::event::sink<evt::button_press, evt::expose, evt::propert
 
   bar_settings m_opts{};
 
-  string m_lastinput{};
+  tags::format_string m_lastinput{};
+  bool m_lastinput_drawn{false};
   std::mutex m_mutex{};
-  std::atomic<bool> m_dblclicks{false};
+
+  /**
+   * Frame waiting to be drawn by the render thread, a newer frame replaces it
+   */
+  tags::format_string m_frame{};
+  bool m_frame_pending{false};
+  bool m_frame_force{false};
+  bool m_render_stop{false};
+  std::mutex m_frame_lock{};
+  std::condition_variable m_frame_cond{};
+  std::thread m_render_thread{};
 
   mousebtn m_buttonpress_btn{mousebtn::NONE};
   int m_buttonpress_pos{0};
+  std::chrono::steady_clock::time_point m_buttonpress_time{};
 #if WITH_XCURSOR
+  /**
+   * Guards the cursor state, the cursor is also updated from the taskqueue
+   */
+  std::mutex m_cursor_lock{};
   int m_motion_pos{0};
+  xcb_timestamp_t m_motion_time{0L};
+  event_timer m_motion_throttle{0L, 16L};
+  bool m_motion_pending{false};
+
+  /**
+   * Actions below the pointer when the cursor was last picked
+   */
+  shared_ptr<const action_index> m_cursor_actions{};
+  action_index::range m_cursor_area{};
 #endif
 
   event_timer m_buttonpress{0L, 5L};
   event_timer m_doubleclick{0L, 150L};
 
-  double m_anim_step{0.0};
+  /**
+   * Guards the shading animation and the window geometry, the animation runs on the scheduler
+   */
+  std::mutex m_shade_lock{};
+  // Scheduler task that resizes the window once per frame, 0 if the animation isn't running
+  size_t m_shade_task{0};
+  // Incremented whenever an animation is requested, a pending start of an older one is dropped
+  size_t m_shade_generation{0};
+  std::chrono::steady_clock::time_point m_shade_start{};
+  int m_shade_from_y{0};
+  int m_shade_from_h{0};
+
+  /**
+   * Window position and height as of the last ConfigureNotify event or configure request
+   */
+  int m_geom_y{0};
+  int m_geom_h{0};
 
   bool m_visible{true};
+
+  /**
+   * Set if other windows cover the bar completely, only reported without a compositor
+   */
+  std::atomic<bool> m_obscured{false};
+
+  /**
+   * Suspend the periodic module updates while the bar can't be seen, see update_suspended()
+   */
+  bool m_suspend_hidden{false};
+  std::mutex m_suspend_lock;
 };
 
 POLYBAR_NS_END
@@ -3,6 +3,7 @@
 #include <map>
 
 #include "common.hpp"
+#include "components/action_table.hpp"
 #include "components/types.hpp"
 #include "tags/types.hpp"
 POLYBAR_NS
@@ -21,13 +22,14 @@ class builder {
 
   void reset();
   string flush();
-  void append(string text);
+  void append(const string& text);
   void node(string str);
   void node(string str, int font_index);
   void node(const label_t& label);
   void node_repeat(const string& str, size_t n);
   void node_repeat(const label_t& label, size_t n);
   void offset(int pixels);
+  void graph(tags::graph_type type, int width, const vector<double>& values);
   void space(size_t width);
   void space();
   void remove_trailing_space(size_t len);
@@ -49,6 +51,7 @@ class builder {
   void underline(const rgba& color = rgba{});
   void underline_close();
   void control(tags::controltag tag);
+  void reserve(const tags::reserved_width& width);
   void action(mousebtn index, string action);
   void action(mousebtn btn, const modules::module_interface& module, string action, string data);
   void action(mousebtn index, string action, const label_t& label);
@@ -60,9 +63,10 @@ class builder {
   void tag_open(tags::attribute attr);
   void tag_close(tags::syntaxtag tag);
   void tag_close(tags::attribute attr);
+  void append_tag(char tag, const string& value);
 
  private:
-  const bar_settings m_bar;
+  const bar_settings& m_bar;
   string m_output;
 
   map<tags::syntaxtag, int> m_tags{};
@@ -70,6 +74,8 @@ class builder {
   map<tags::attribute, bool> m_attrs{};
 
   int m_fontindex{0};
+
+  action_table::scope m_actions;
 };
 
 POLYBAR_NS_END
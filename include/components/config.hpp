@@ -1,5 +1,7 @@
 #pragma once
 
+#include <mutex>
+#include <set>
 #include <unordered_map>
 
 #include "common.hpp"
@@ -8,6 +10,7 @@
 #include "settings.hpp"
 #include "utils/env.hpp"
 #include "utils/file.hpp"
+#include "utils/mixins.hpp"
 #include "utils/string.hpp"
 #if WITH_XRM
 #include "x11/xresources.hpp"
@@ -22,15 +25,25 @@ using valuemap_t = std::unordered_map<string, string>;
 using sectionmap_t = std::map<string, valuemap_t>;
 using file_list = vector<string>;
 
-class config {
+/**
+ * Parameters of the config file
+ *
+ * All parameters, their lookup table and the resolved references are kept in
+ * one immutable snapshot. Changing parameters, e.g. when the config is
+ * reloaded in place, publishes a new snapshot. Module and worker threads that
+ * are reading parameters at the same time keep using the snapshot they
+ * started with.
+ */
+class config : non_copyable_mixin<config> {
  public:
   using make_type = const config&;
   static make_type make(string path = "", string bar = "");
 
   explicit config(const logger& logger, string&& path = "", string&& bar = "")
-      : m_log(logger), m_file(move(path)), m_barname(move(bar)){};
+      : m_log(logger), m_file(move(path)), m_barname(move(bar)), m_values(make_shared<values>()){};
 
   const string& filepath() const;
+  const string& barname() const;
   string section() const;
 
   /**
@@ -42,33 +55,22 @@ class config {
 
   void set_included(file_list included);
 
+  void assign(const config& other);
+
+  std::set<string> changed_sections(const config& other) const;
+
   void warn_deprecated(const string& section, const string& key, string replacement) const;
 
   /**
    * Returns true if a given parameter exists
    */
   bool has(const string& section, const string& key) const {
-    auto it = m_sections.find(section);
-    return it != m_sections.end() && it->second.find(key) != it->second.end();
+    return find(section, key) != nullptr;
   }
 
-  /**
-   * Set parameter value
-   */
-  void set(const string& section, const string& key, string&& value) {
-    auto it = m_sections.find(section);
-    if (it == m_sections.end()) {
-      valuemap_t values;
-      values[key] = value;
-      m_sections[section] = move(values);
-    }
-    auto it2 = it->second.find(key);
-    if ((it2 = it->second.find(key)) == it->second.end()) {
-      it2 = it->second.emplace_hint(it2, key, value);
-    } else {
-      it2->second = value;
-    }
-  }
+  const string* find(const string& section, const string& key) const;
+
+  void set(const string& section, const string& key, string&& value);
 
   /**
    * Get parameter for the current bar by name
@@ -83,14 +85,15 @@ class config {
    */
   template <typename T = string>
   T get(const string& section, const string& key) const {
-    auto it = m_sections.find(section);
-    if (it == m_sections.end()) {
-      throw key_error("Missing section \"" + section + "\"");
-    }
-    if (it->second.find(key) == it->second.end()) {
+    auto values = snapshot();
+    const string* value{values->find(section, key)};
+    if (value == nullptr) {
+      if (values->sections.find(section) == values->sections.end()) {
+        throw key_error("Missing section \"" + section + "\"");
+      }
       throw key_error("Missing parameter \"" + section + "." + key + "\"");
     }
-    return dereference<T>(section, key, it->second.at(key), convert<T>(string{it->second.at(key)}));
+    return resolve<T>(*values, section, key, *value);
   }
 
   /**
@@ -99,18 +102,38 @@ class config {
    */
   template <typename T = string>
   T get(const string& section, const string& key, const T& default_value) const {
-    try {
-      string string_value{get<string>(section, key)};
-      T result{convert<T>(string{string_value})};
-      return dereference<T>(move(section), move(key), move(string_value), move(result));
-    } catch (const key_error& err) {
+    // Missing parameters are the common case here, they are not reported through key_error
+    auto values = snapshot();
+    const string* value{values->find(section, key)};
+    if (value == nullptr) {
       return default_value;
+    }
+
+    try {
+      return resolve<T>(*values, section, key, *value);
     } catch (const value_error& err) {
       m_log.err("Invalid value for \"%s.%s\", using default value (reason: %s)", section, key, err.what());
       return default_value;
     }
   }
 
+  /**
+   * Convert the parameter and store it in `result`
+   *
+   * \returns false and leaves `result` untouched if the parameter isn't set
+   * \throws value_error if the value can't be converted
+   */
+  template <typename T>
+  bool get_into(const string& section, const string& key, T& result) const {
+    auto values = snapshot();
+    const string* value{values->find(section, key)};
+    if (value == nullptr) {
+      return false;
+    }
+    result = resolve<T>(*values, section, key, *value);
+    return true;
+  }
+
   /**
    * Get list of values for the current bar by name
    */
@@ -125,20 +148,11 @@ class config {
   template <typename T = string>
   vector<T> get_list(const string& section, const string& key) const {
     vector<T> results;
+    auto values = snapshot();
 
-    while (true) {
-      try {
-        string string_value{get<string>(section, key + "-" + to_string(results.size()))};
-        T value{convert<T>(string{string_value})};
-
-        if (!string_value.empty()) {
-          results.emplace_back(dereference<T>(section, key, move(string_value), move(value)));
-        } else {
-          results.emplace_back(move(value));
-        }
-      } catch (const key_error& err) {
-        break;
-      }
+    const string* string_value;
+    while ((string_value = values->find(section, key + "-" + to_string(results.size()))) != nullptr) {
+      results.emplace_back(resolve<T>(*values, section, key, *string_value));
     }
 
     if (results.empty()) {
@@ -155,19 +169,12 @@ class config {
   template <typename T = string>
   vector<T> get_list(const string& section, const string& key, const vector<T>& default_value) const {
     vector<T> results;
+    auto values = snapshot();
 
-    while (true) {
+    const string* string_value;
+    while ((string_value = values->find(section, key + "-" + to_string(results.size()))) != nullptr) {
       try {
-        string string_value{get<string>(section, key + "-" + to_string(results.size()))};
-        T value{convert<T>(string{string_value})};
-
-        if (!string_value.empty()) {
-          results.emplace_back(dereference<T>(section, key, move(string_value), move(value)));
-        } else {
-          results.emplace_back(move(value));
-        }
-      } catch (const key_error& err) {
-        break;
+        results.emplace_back(resolve<T>(*values, section, key, *string_value));
       } catch (const value_error& err) {
         m_log.err("Invalid value in list \"%s.%s\", using list as-is (reason: %s)", section, key, err.what());
         return default_value;
@@ -176,7 +183,6 @@ class config {
 
     if (!results.empty()) {
       return results;
-      ;
     }
 
     return default_value;
@@ -189,13 +195,13 @@ class config {
    */
   template <typename T = string>
   T deprecated(const string& section, const string& old, const string& newkey, const T& fallback) const {
-    try {
-      T value{get<T>(section, old)};
-      warn_deprecated(section, old, newkey);
-      return value;
-    } catch (const key_error& err) {
+    if (!has(section, old)) {
       return get<T>(section, newkey, fallback);
     }
+
+    T value{get<T>(section, old)};
+    warn_deprecated(section, old, newkey);
+    return value;
   }
 
   /**
@@ -203,26 +209,90 @@ class config {
    */
   template <typename T = string>
   T deprecated_list(const string& section, const string& old, const string& newkey, const vector<T>& fallback) const {
-    try {
-      vector<T> value{get_list<T>(section, old)};
-      warn_deprecated(section, old, newkey);
-      return value;
-    } catch (const key_error& err) {
+    if (!has(section, old + "-0")) {
       return get_list<T>(section, newkey, fallback);
     }
+
+    vector<T> value{get_list<T>(section, old)};
+    warn_deprecated(section, old, newkey);
+    return value;
   }
 
  protected:
-  void copy_inherited();
+  /**
+   * Open addressing table entry for a parameter
+   *
+   * Lookups hash the section and key separately, so callers don't build a
+   * combined key.
+   */
+  struct slot {
+    size_t hash;
+    const string* section;
+    const string* key;
+    const string* value;
+  };
+
+  /**
+   * Snapshot of all parameters, never changed once it is published
+   */
+  struct values {
+    sectionmap_t sections{};
+
+    /**
+     * Open addressing table over all parameters in `sections`
+     *
+     * The entries point into `sections`, which never moves its nodes.
+     */
+    vector<slot> index{};
+
+    /**
+     * Resolved values of the parameters that contain a reference, by the
+     * address of their value in `sections`
+     *
+     * `resolving` holds the references that are currently being resolved to
+     * detect cycles.
+     */
+    mutable std::recursive_mutex resolve_lock;
+    mutable std::unordered_map<const string*, string> resolved;
+    mutable std::set<const string*> resolving;
+
+    const string* find(const string& section, const string& key) const;
+    void build_index();
+  };
+
+  shared_ptr<const values> snapshot() const {
+    return std::atomic_load(&m_values);
+  }
+
+  void publish(shared_ptr<values> next);
+  void copy_inherited(values& next) const;
+  string dereferenced(const values& values, const string& section, const string& key, const string& raw) const;
+  string resolved(const values& values, const string& section, const string& key, const string& raw) const;
 
   template <typename T>
   T convert(string&& value) const;
 
+  /**
+   * Dereference and convert a raw parameter value
+   *
+   * References are resolved to a string before the conversion, not all types
+   * can be converted from the unresolved reference.
+   *
+   * `raw` has to be a value stored in the snapshot, see dereferenced()
+   */
+  template <typename T>
+  T resolve(const values& values, const string& section, const string& key, const string& raw) const {
+    string string_value{dereferenced(values, section, key, raw)};
+    T result{convert<T>(string{string_value})};
+    return dereference<T>(values, section, key, string_value, move(result));
+  }
+
   /**
    * Dereference value reference
    */
   template <typename T>
-  T dereference(const string& section, const string& key, const string& var, const T& fallback) const {
+  T dereference(
+      const values& values, const string& section, const string& key, const string& var, const T& fallback) const {
     if (var.substr(0, 2) != "${" || var.substr(var.length() - 1) != "}") {
       return fallback;
     }
@@ -237,7 +307,7 @@ class config {
     } else if (path.compare(0, 5, "file:") == 0) {
       return dereference_file<T>(path.substr(5));
     } else if ((pos = path.find(".")) != string::npos) {
-      return dereference_local<T>(path.substr(0, pos), path.substr(pos + 1), section);
+      return dereference_local<T>(values, path.substr(0, pos), path.substr(pos + 1), section);
     } else {
       throw value_error("Invalid reference defined at \"" + section + "." + key + "\"");
     }
@@ -253,7 +323,7 @@ class config {
    *  ${section.key:fallback}
    */
   template <typename T>
-  T dereference_local(string section, const string& key, const string& current_section) const {
+  T dereference_local(const values& values, string section, const string& key, const string& current_section) const {
     if (section == "BAR") {
       m_log.warn("${BAR.key} is deprecated. Use ${root.key} instead");
     }
@@ -262,11 +332,10 @@ class config {
     section = string_util::replace(section, "root", this->section(), 0, 4);
     section = string_util::replace(section, "self", current_section, 0, 4);
 
-    try {
-      string string_value{get<string>(section, key)};
-      T result{convert<T>(string{string_value})};
-      return dereference<T>(string(section), move(key), move(string_value), move(result));
-    } catch (const key_error& err) {
+    const string* string_value{values.find(section, key)};
+    if (string_value != nullptr) {
+      return resolve<T>(values, section, key, *string_value);
+    } else {
       size_t pos;
       if ((pos = key.find(':')) != string::npos) {
         string fallback = key.substr(pos + 1);
@@ -384,7 +453,15 @@ class config {
   const logger& m_log;
   string m_file;
   string m_barname;
-  sectionmap_t m_sections{};
+  /**
+   * Current snapshot, only accessed through std::atomic_load and std::atomic_store
+   */
+  shared_ptr<const values> m_values;
+
+  /**
+   * Serializes changes, set() modifies a copy of the current snapshot
+   */
+  std::mutex m_write_lock;
 
   /**
    * Absolute path of all files that were parsed in the process of parsing the
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+
+#include "common.hpp"
+#include "components/config.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+class logger;
+
+/**
+ * \brief Parsed config files, persisted between runs
+ *
+ * Holds the sections of a config tree as they come out of the parser, before
+ * inheritance and references are resolved. References to the environment, X
+ * resources or other files can change between runs without touching the
+ * config files, so they are always resolved again.
+ *
+ * The snapshot is only valid as long as none of the files it was parsed from
+ * and none of the included directories changed.
+ */
+class config_cache : non_copyable_mixin<config_cache> {
+ public:
+  struct snapshot {
+    /**
+     * Parsed files, the main config file first
+     */
+    file_list files;
+
+    /**
+     * Directories listed by include-directory, adding files changes them
+     */
+    file_list directories;
+
+    sectionmap_t sections;
+    bool use_xrm{false};
+
+    /**
+     * When the parser started reading the files, files changed after that are
+     * not cached
+     */
+    std::chrono::system_clock::time_point parsed{};
+  };
+
+  explicit config_cache(const logger& logger, string path);
+
+  static string path_for(const string& cache_dir, const string& config);
+
+  bool load(const string& config, snapshot& result) const;
+  bool save(const snapshot& data) const;
+
+ private:
+  const logger& m_log;
+  const string m_path;
+};
+
+POLYBAR_NS_END
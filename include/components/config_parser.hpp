@@ -99,6 +99,20 @@ class config_parser {
    */
   config::make_type parse();
 
+  /**
+   * \brief Parses the main config file into the given config instance
+   *
+   * \see parse()
+   */
+  void parse(config& conf);
+
+  /**
+   * \brief Reuse the parsed files from the last run if none of them changed
+   *
+   * The cache is stored in polybar's cache directory
+   */
+  void use_cache();
+
  protected:
   /**
    * \brief Converts the `lines` vector to a proper sectionmap
@@ -194,6 +208,11 @@ class config_parser {
    */
   file_list m_files;
 
+  /**
+   * \brief Directories the config includes files from
+   */
+  file_list m_directories;
+
  private:
   /**
    * \brief Checks if the given name doesn't contain any spaces or characters
@@ -208,6 +227,11 @@ class config_parser {
    */
   bool use_xrm{false};
 
+  /**
+   * \brief Path of the config cache, empty if it isn't used
+   */
+  string m_cache;
+
   const logger& m_log;
 
   /**
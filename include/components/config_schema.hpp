@@ -0,0 +1,86 @@
+#pragma once
+
+#include <functional>
+
+#include "common.hpp"
+#include "components/config.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Typed parameters of a section that are converted together
+ *
+ * Each parameter is declared with the variable that receives its value, the
+ * current value of that variable is the default. load() converts all of them
+ * in one pass and, instead of stopping at the first bad parameter, reports
+ * every missing or invalid parameter in a single message.
+ *
+ * Usage:
+ *   config_schema{m_log, m_conf, name()}
+ *       .required("exec", m_exec)
+ *       .optional("interval", m_interval)
+ *       .renamed("maxlen", "label-maxlen", m_maxlen)
+ *       .load();
+ */
+class config_schema {
+ public:
+  explicit config_schema(const logger& logger, const config& conf, string section);
+
+  /**
+   * Parameter that keeps the current value of `target` if it isn't set or invalid
+   */
+  template <typename T>
+  config_schema& optional(string key, T& target) {
+    return add(move(key), "", false, reader_for(target));
+  }
+
+  /**
+   * Parameter that has to be set
+   */
+  template <typename T>
+  config_schema& required(string key, T& target) {
+    return add(move(key), "", true, reader_for(target));
+  }
+
+  /**
+   * Optional parameter that was previously called `old`, which is still read (with a warning) if it is set
+   */
+  template <typename T>
+  config_schema& renamed(string old, string key, T& target) {
+    return add(move(key), move(old), false, reader_for(target));
+  }
+
+  void load() const;
+
+ protected:
+  /**
+   * Converts the parameter with the given key and stores it in the target
+   *
+   * \returns false if the parameter isn't set
+   */
+  using reader = std::function<bool(const config&, const string&, const string&)>;
+
+  template <typename T>
+  static reader reader_for(T& target) {
+    return [&target](const config& conf, const string& section, const string& key) {
+      return conf.get_into(section, key, target);
+    };
+  }
+
+  config_schema& add(string key, string old, bool required, reader read);
+
+ private:
+  struct parameter {
+    string key;
+    string old;
+    bool required;
+    reader read;
+  };
+
+  const logger& m_log;
+  const config& m_conf;
+  const string m_section;
+  vector<parameter> m_parameters;
+};
+
+POLYBAR_NS_END
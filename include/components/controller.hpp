@@ -2,14 +2,23 @@
 
 #include <moodycamel/blockingconcurrentqueue.h>
 
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
 
 #include "common.hpp"
+#include "components/alloc_stats.hpp"
+#include "components/stats.hpp"
 #include "components/types.hpp"
 #include "events/signal_fwd.hpp"
 #include "events/signal_receiver.hpp"
 #include "events/types.hpp"
 #include "settings.hpp"
+#include "tags/types.hpp"
 #include "utils/actions.hpp"
 #include "utils/file.hpp"
 #include "x11/types.hpp"
@@ -24,38 +33,62 @@ class config;
 class connection;
 class inotify_watch;
 class ipc;
+class power_policy;
+class line_writer;
 class logger;
+class reactor;
 class signal_emitter;
 namespace modules {
   struct module_interface;
+  struct event_handler_interface;
 }  // namespace modules
 using module_t = shared_ptr<modules::module_interface>;
 using modulemap_t = std::map<alignment, vector<module_t>>;
 
 // }}}
 
+/**
+ * Format of the output that is written to stdout instead of drawing the bar
+ */
+enum class output_format {
+  NONE = 0,
+  // The formatting string of the whole bar, one line per update
+  RAW,
+  // One JSON object per update, holding the modules whose output changed
+  JSON,
+};
+
 class controller
     : public signal_receiver<SIGN_PRIORITY_CONTROLLER, signals::eventqueue::exit_terminate,
           signals::eventqueue::exit_reload, signals::eventqueue::notify_change, signals::eventqueue::notify_forcechange,
-          signals::eventqueue::check_state, signals::ipc::action, signals::ipc::command, signals::ipc::hook,
-          signals::ui::ready, signals::ui::button_press, signals::ui::update_background> {
+          signals::eventqueue::check_state, signals::eventqueue::module_stopped, signals::ipc::action, signals::ipc::command, signals::ipc::hook,
+          signals::ipc::content, signals::ui::ready, signals::ui::changed, signals::ui::button_press,
+          signals::ui::visibility_change, signals::ui::update_background> {
  public:
   using make_type = unique_ptr<controller>;
   static make_type make(unique_ptr<ipc>&& ipc, unique_ptr<inotify_watch>&& config_watch);
 
-  explicit controller(connection&, signal_emitter&, const logger&, const config&, unique_ptr<bar>&&, unique_ptr<ipc>&&,
-      unique_ptr<inotify_watch>&&);
+  explicit controller(connection&, signal_emitter&, const logger&, const config&, reactor&, unique_ptr<bar>&&,
+      unique_ptr<ipc>&&, unique_ptr<inotify_watch>&&);
   ~controller();
 
-  bool run(bool writeback, string snapshot_dst);
+  static sigset_t handled_signals();
+  static void block_signals();
+  static void unblock_signals();
+
+  bool run(output_format output, string snapshot_dst);
 
   bool enqueue(event&& evt);
-  bool enqueue(string&& input_data);
+  bool enqueue(string&& input_data, std::chrono::steady_clock::time_point received = {});
 
  protected:
   void read_events();
   void process_eventqueue();
+  bool dequeue(event& evt, std::chrono::steady_clock::time_point deadline);
+  bool process_event(const event& evt);
   void process_inputdata();
+  void process_input(const string& cmd, size_t count, std::chrono::steady_clock::time_point received);
+  bool wait_for_frame();
   bool process_update(bool force);
 
   bool on(const signals::eventqueue::notify_change& evt);
@@ -63,28 +96,89 @@ class controller
   bool on(const signals::eventqueue::exit_terminate& evt);
   bool on(const signals::eventqueue::exit_reload& evt);
   bool on(const signals::eventqueue::check_state& evt);
+  bool on(const signals::eventqueue::module_stopped& evt);
   bool on(const signals::ui::ready& evt);
+  bool on(const signals::ui::changed& evt);
   bool on(const signals::ui::button_press& evt);
+  bool on(const signals::ui::visibility_change& evt);
   bool on(const signals::ipc::action& evt);
   bool on(const signals::ipc::command& evt);
   bool on(const signals::ipc::hook& evt);
+  bool on(const signals::ipc::content& evt);
   bool on(const signals::ui::update_background& evt);
 
  private:
-  size_t setup_modules(alignment align);
+  /**
+   * \brief Assembled contents of an alignment block
+   */
+  struct block_cache {
+    /**
+     * Generation of each module in the block at the time the block was assembled
+     */
+    vector<size_t> generations;
+    /**
+     * Formatting string of the block, only assembled in writeback mode
+     */
+    string contents;
+    /**
+     * Buffer the block is assembled into before it is compared with contents
+     */
+    string scratch;
+    /**
+     * Block assembled from the parsed output of its modules, handed to the bar
+     * without being parsed again
+     */
+    tags::format_string elements;
+    tags::format_string element_scratch;
+  };
+
+  size_t setup_modules();
+  module_t create_module(const string& name) const;
+  bool reload_config();
+
+  bool block_changed(const vector<module_t>& modules, const block_cache& cache) const;
+  void record_layout() const;
+  void record_updates(const vector<module_t>& modules, const block_cache& cache) const;
+  size_t append_json(alignment align, const vector<module_t>& modules, bool force, string& json);
+  void assemble_block(alignment align, const vector<module_t>& modules, string& contents) const;
+  void assemble_block(alignment align, const vector<module_t>& modules, tags::format_string& elements) const;
 
-  bool forward_action(const actions_util::action& cmd);
+  void index_modules();
+  bool forward_action(
+      const actions_util::action& cmd, size_t count = 1, std::chrono::steady_clock::time_point received = {});
   bool try_forward_legacy_action(const string& cmd);
 
+  void record_input_latency();
+
+  void publish(const string& event, const string& data);
+  bool query_module(const string& name, string& output, string& text) const;
+  static vector<string> stats_report();
+  void module_command(const string& command);
+  void snapshot_module(modules::module_interface& module, const string& path) const;
+
   connection& m_connection;
   signal_emitter& m_sig;
   const logger& m_log;
   const config& m_conf;
+  reactor& m_reactor;
   unique_ptr<bar> m_bar;
   unique_ptr<ipc> m_ipc;
   unique_ptr<inotify_watch> m_confwatch;
 
-  array<unique_ptr<file_descriptor>, 2> m_queuefd{};
+  /**
+   * \brief Stretches the module intervals while on battery
+   */
+  unique_ptr<power_policy> m_power;
+
+  /**
+   * \brief Wakes up the event loop, written by request_exit()
+   */
+  unique_ptr<file_descriptor> m_wakeupfd;
+
+  /**
+   * \brief Termination and reload signals, they are blocked in every thread
+   */
+  unique_ptr<file_descriptor> m_signalfd;
 
   /**
    * \brief State flag
@@ -100,12 +194,32 @@ class controller
    * \brief Controls weather the output gets printed to stdout
    */
   bool m_writeback{false};
+  output_format m_output{output_format::NONE};
+
+  /**
+   * \brief Writes the output to stdout in writeback mode
+   */
+  unique_ptr<line_writer> m_writer;
+
+  /**
+   * \brief Contents of each module at the time it was last written in the JSON format
+   */
+  std::unordered_map<const modules::module_interface*, string> m_json_contents;
 
   /**
    * \brief Internal event queue
+   *
+   * Updates and checks are queued here. Input and quit events go into
+   * m_urgent and are taken first, they only leave an empty event here to
+   * wake up the event thread.
    */
   moodycamel::BlockingConcurrentQueue<event> m_queue;
 
+  /**
+   * \brief Events that must not wait behind pending updates
+   */
+  moodycamel::ConcurrentQueue<event> m_urgent;
+
   /**
    * \brief Loaded modules
    */
@@ -117,19 +231,99 @@ class controller
   modulemap_t m_blocks;
 
   /**
-   * \brief Maximum number of subsequent events to swallow
+   * \brief Loaded modules by name, to route actions
+   */
+  std::unordered_map<string, vector<module_t>> m_modules_by_name;
+
+  /**
+   * \brief Loaded modules that handle X events, to skip the others after every burst
+   */
+  vector<pair<module_t, modules::event_handler_interface*>> m_event_handlers;
+
+  /**
+   * \brief Guards m_modules, m_blocks, m_modules_by_name and m_event_handlers
+   *
+   * They are only modified by the main thread when the config is reloaded,
+   * so the main thread itself can read them without holding the lock.
+   */
+  mutable std::mutex m_modules_lock;
+
+  /**
+   * \brief Cached contents of each block from the last update
+   */
+  std::map<alignment, block_cache> m_block_cache;
+
+  /**
+   * \brief Separator, module margins and bar padding placed between modules,
+   * rendered once
+   */
+  string m_separator;
+  string m_margin_left;
+  string m_margin_right;
+  string m_padding_left;
+  string m_padding_right;
+  tags::format_string m_separator_elements;
+
+  /**
+   * \brief Minimum time between two redraws
+   */
+  std::chrono::microseconds m_frame_interval{0};
+
+  alloc_tag m_alloc_tag{alloc_stats::tag("controller")};
+
+  /**
+   * \brief Time of the last redraw
+   */
+  std::chrono::steady_clock::time_point m_last_frame{};
+
+  /**
+   * \brief Set while an update event for changed modules is queued
+   *
+   * Each module publishes its latest output together with a generation of
+   * its own, the event only wakes up the eventqueue. So a single queued
+   * update covers all modules that change before it is processed.
+   */
+  std::atomic<bool> m_update_pending{false};
+
+  /**
+   * \brief Input data waiting to be processed
+   */
+  struct pending_input {
+    string data;
+    /**
+     * Number of times the input was repeated
+     */
+    size_t count;
+    /**
+     * When the click that caused the input was received, unset for other input
+     */
+    std::chrono::steady_clock::time_point received;
+  };
+  std::deque<pending_input> m_inputdata;
+
+  /**
+   * \brief Guards m_inputdata
    */
-  size_t m_swallow_limit{5U};
+  std::mutex m_inputdata_lock;
 
   /**
-   * \brief Time to wait for subsequent events
+   * \brief Click delivered to a module, waiting for a frame that shows its effect
    */
-  std::chrono::milliseconds m_swallow_update{10};
+  struct input_latency {
+    module_t module;
+    /**
+     * Generation of the module before the click was delivered
+     */
+    size_t generation;
+    std::chrono::steady_clock::time_point received;
+  };
+  vector<input_latency> m_input_latency;
+  std::mutex m_input_latency_lock;
 
   /**
-   * \brief Input data
+   * \brief Time from receiving a click to the flush of the first frame that reflects it
    */
-  string m_inputdata;
+  histogram& m_input_latency_stats{stats::make().get("input.latency")};
 
   /**
    * \brief Thread for the eventqueue loop
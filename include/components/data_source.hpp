@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "utils/factory.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace chrono = std::chrono;
+
+/**
+ * \brief Latest readings of the data sources that modules sample
+ *
+ * Readings are kept per type and key, where the key holds whatever
+ * parameters the reading depends on (e.g. the file it was read from). A
+ * module that asks for a reading that is younger than `max_age` gets the one
+ * that was already taken, so that modules with different formats on the same
+ * source only sample it once per interval. What a module makes of the reading
+ * stays with the module.
+ *
+ * Readings are immutable once taken and can be used from any thread. Only
+ * readers of the same key wait for each other.
+ */
+template <typename T>
+class data_source : non_copyable_mixin<data_source<T>> {
+ public:
+  using clock = chrono::steady_clock;
+  using reading = shared_ptr<const T>;
+  using make_type = data_source<T>&;
+
+  static make_type make() {
+    return *factory_util::singleton<data_source<T>>();
+  }
+
+  /**
+   * Latest reading of `key`, `read` takes a new one if there is none that is
+   * at most `max_age` old
+   *
+   * Exceptions thrown by `read` are passed on and nothing is stored.
+   */
+  reading get(const string& key, clock::duration max_age, const function<T()>& read) {
+    shared_ptr<entry> source;
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      auto& slot = m_entries[key];
+      if (!slot) {
+        slot = make_shared<entry>();
+      }
+      source = slot;
+    }
+
+    std::lock_guard<std::mutex> guard(source->lock);
+    auto now = clock::now();
+    if (!source->value || now - source->time > max_age) {
+      source->value = make_shared<const T>(read());
+      source->time = now;
+    }
+    return source->value;
+  }
+
+ private:
+  struct entry {
+    std::mutex lock;
+    clock::time_point time;
+    reading value;
+  };
+
+  std::mutex m_lock;
+  std::unordered_map<string, shared_ptr<entry>> m_entries;
+};
+
+POLYBAR_NS_END
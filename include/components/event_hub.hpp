@@ -0,0 +1,127 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include "common.hpp"
+#include "errors.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Hands the events of a single source to any number of subscribers
+ *
+ * The source, e.g. the event socket of a window manager, is read and parsed
+ * once per process and whatever it was parsed into is published as an
+ * immutable model. Every subscriber gets an eventfd that becomes readable
+ * when a model was published since it last took one. A subscriber that falls
+ * behind skips straight to the latest model.
+ *
+ * The source is connected when the first subscriber arrives and disconnected
+ * once the last one is gone.
+ */
+template <typename T>
+class event_hub : non_copyable_mixin<event_hub<T>> {
+ public:
+  using model = shared_ptr<const T>;
+
+  class subscription : non_copyable_mixin<subscription> {
+   public:
+    explicit subscription(event_hub& hub, int fd) : m_hub(hub), m_fd(fd) {}
+
+    ~subscription() {
+      m_hub.unsubscribe(this);
+      close(m_fd);
+    }
+
+    /**
+     * Readable while a model is waiting to be taken
+     */
+    int fd() const {
+      return m_fd;
+    }
+
+    /**
+     * Latest model, the fd stays quiet until the next one is published
+     */
+    model take() {
+      eventfd_t count;
+      eventfd_read(m_fd, &count);
+      return m_hub.latest();
+    }
+
+   private:
+    event_hub& m_hub;
+    int m_fd;
+  };
+
+  virtual ~event_hub() = default;
+
+  /**
+   * Errors while connecting to the source are passed on
+   */
+  unique_ptr<subscription> subscribe() {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_subscribers.empty()) {
+      m_model = connect();
+    }
+
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd == -1) {
+      if (m_subscribers.empty()) {
+        disconnect();
+      }
+      throw system_error("Failed to create eventfd");
+    }
+
+    auto sub = make_unique<subscription>(*this, fd);
+    m_subscribers.emplace_back(sub.get());
+    return sub;
+  }
+
+  model latest() const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_model;
+  }
+
+ protected:
+  /**
+   * Connect to the source, called for the first subscriber
+   *
+   * \returns the initial model, may be empty
+   */
+  virtual model connect() = 0;
+
+  /**
+   * Called once the last subscriber is gone
+   */
+  virtual void disconnect() = 0;
+
+  void publish(model value) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_model = move(value);
+    for (auto&& sub : m_subscribers) {
+      eventfd_write(sub->fd(), 1);
+    }
+  }
+
+ private:
+  void unsubscribe(subscription* sub) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_subscribers.erase(std::remove(m_subscribers.begin(), m_subscribers.end(), sub), m_subscribers.end());
+    if (m_subscribers.empty()) {
+      disconnect();
+      m_model.reset();
+    }
+  }
+
+  mutable std::mutex m_lock;
+  model m_model;
+  vector<subscription*> m_subscribers;
+};
+
+POLYBAR_NS_END
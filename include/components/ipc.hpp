@@ -1,6 +1,11 @@
 #pragma once
 
+#include <map>
+#include <mutex>
+#include <set>
+
 #include "common.hpp"
+#include "components/alloc_stats.hpp"
 #include "settings.hpp"
 #include "utils/concurrency.hpp"
 
@@ -8,6 +13,7 @@ POLYBAR_NS
 
 class file_descriptor;
 class logger;
+class reactor;
 class signal_emitter;
 
 /**
@@ -16,6 +22,12 @@ class signal_emitter;
 static constexpr const char* ipc_command_prefix{"cmd:"};
 static constexpr const char* ipc_hook_prefix{"hook:"};
 static constexpr const char* ipc_action_prefix{"action:"};
+static constexpr const char* ipc_content_prefix{"content:"};
+static constexpr const char* ipc_subscribe_prefix{"subscribe:"};
+static constexpr const char* ipc_get_prefix{"get:"};
+static constexpr const char* ipc_target_prefix{"to:"};
+static constexpr const char* ipc_register_prefix{"register:"};
+static constexpr const char* ipc_stats_query{"get-stats"};
 
 /**
  * Component used for inter-process communication.
@@ -23,24 +35,121 @@ static constexpr const char* ipc_action_prefix{"action:"};
  * A unique messaging channel will be setup for each
  * running process which will allow messages and
  * events to be sent to the process externally.
+ *
+ * Messages are separated by newlines, so a single write can carry many of
+ * them. They are accepted on two channels:
+ *
+ *  - A SOCK_SEQPACKET unix socket. Clients may stay connected and send any
+ *    number of packets, every packet holds one or more complete messages.
+ *  - A FIFO, kept for scripts that write to it directly. Writes of up to
+ *    PIPE_BUF bytes are never interleaved with other writers.
+ *
+ * All descriptors are served by the reactor.
+ *
+ * Socket clients can send `subscribe:<event>,...` to receive the given
+ * events (all events if the list is empty) as `<event> <data>` lines, see
+ * publish().
+ *
+ * `get:<module> [raw|text|json]` returns the current output of a module to
+ * the socket client that asked, as `ok <output>` or `error <reason>`.
+ *
+ * `get-stats` returns the timing statistics and the allocation counts to the
+ * socket client that asked, as `ok <line>...`.
+ *
+ * Commands that write a file, `module:<name> snapshot=<path>`, are only
+ * accepted from socket clients of the same user, never from the fifo.
+ *
+ * The bars of a user also elect one of them as broker, which listens on a
+ * socket in the abstract namespace (see broker_name()). The other bars stay
+ * connected to it and register with `register:<bar> <monitor>`. A
+ * `to:<selector> <message>` message sent to the broker is passed on to every
+ * bar that matches the selector, `all`, `bar:<name>` or `monitor:<name>`, so
+ * clients only need a single connection however many bars are running. When
+ * the broker exits, the remaining bars elect a new one.
  */
 class ipc {
  public:
   using make_type = unique_ptr<ipc>;
   static make_type make();
 
-  explicit ipc(signal_emitter& emitter, const logger& logger);
+  /**
+   * Looks up the current output of a module, with and without formatting tags
+   *
+   * \returns false if there is no such module
+   */
+  using query_handler = function<bool(const string& module, string& output, string& text)>;
+
+  /**
+   * Lines of the statistics report
+   */
+  using stats_handler = function<vector<string>()>;
+
+  explicit ipc(signal_emitter& emitter, const logger& logger, reactor& reactor);
   ~ipc();
 
-  void receive_message();
-  int get_file_descriptor() const;
+  static string broker_name();
+
+  void set_query_handler(query_handler handler);
+  void set_stats_handler(stats_handler handler);
+  void join_broker(const string& bar, const string& monitor, const string& name);
+
+  void process(const string& data, int client = -1);
+  void publish(const string& event, const string& data);
+
+ protected:
+  void subscribe(int client, const string& events);
+  void query(int client, const string& query) const;
+  void query_stats(int client) const;
+  void send_reply(int client, string reply) const;
+  void route(const string& data, int client);
+  bool trusted(int client) const;
+  void enroll(int client, const string& data);
+  void elect(int attempt = 0);
+  bool schedule_election(int attempt);
+  void open_fifo();
+  void receive_fifo();
+  void accept_client(int socket);
+  void receive_client(int fd);
+  void close_client(int fd);
+  void leave_broker();
 
  private:
   signal_emitter& m_sig;
   const logger& m_log;
+  reactor& m_reactor;
+  alloc_tag m_alloc_tag{alloc_stats::tag("ipc")};
 
   string m_path{};
   unique_ptr<file_descriptor> m_fd;
+  // Incomplete line read from the fifo while a writer is still writing
+  string m_fifo_pending{};
+
+  string m_socket_path{};
+  unique_ptr<file_descriptor> m_socket;
+  std::set<int> m_clients;
+  query_handler m_query_handler;
+  stats_handler m_stats_handler;
+
+  string m_broker_name{};
+  string m_bar{};
+  string m_monitor{};
+  // Listening socket while this bar is the broker
+  unique_ptr<file_descriptor> m_broker;
+  // Connection to the broker otherwise, -1 if there is none
+  int m_upstream{-1};
+  // Registered bars with their name and monitor, only known to the broker
+  std::map<int, pair<string, string>> m_followers;
+  // Fires when the election is retried
+  unique_ptr<file_descriptor> m_election_timer;
+  int m_election_attempt{0};
+
+  /**
+   * Subscribed clients and their events, an empty set means all events
+   *
+   * Guarded by m_subscribers_lock, events are published from any thread.
+   */
+  std::mutex m_subscribers_lock;
+  std::map<int, std::set<string>> m_subscribers;
 };
 
 POLYBAR_NS_END
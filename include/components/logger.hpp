@@ -5,6 +5,7 @@
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "common.hpp"
 #include "settings.hpp"
@@ -27,17 +28,27 @@ enum class loglevel {
   TRACE,
 };
 
+/**
+ * Log sink
+ *
+ * Messages are formatted on the calling thread into a thread local buffer
+ * and handed to a writer thread through a lock-free queue, so logging never
+ * blocks on the output channel. Messages of a single thread keep their order.
+ */
 class logger {
  public:
   using make_type = const logger&;
   static make_type make(loglevel level = loglevel::NONE);
 
-  explicit logger(loglevel level);
+  explicit logger(loglevel level, int fd = STDERR_FILENO);
+  ~logger();
 
   static loglevel parse_verbosity(const string& name, loglevel fallback = loglevel::NONE);
 
   void verbosity(loglevel level);
 
+  void flush() const;
+
 #ifdef DEBUG_LOGGER  // {{{
   template <typename... Args>
   void trace(const string& message, Args&&... args) const {
@@ -126,16 +137,32 @@ class logger {
 #pragma GCC diagnostic ignored "-Wformat-security"
 #endif  // }}}
 
-    dprintf(m_fd, (m_prefixes.at(level) + format + m_suffixes.at(level) + "\n").c_str(), convert(values)...);
+    auto& buffer = format_buffer();
+    auto size = snprintf(buffer.data(), buffer.size(), format.c_str(), convert(values)...);
+    if (size >= 0 && static_cast<size_t>(size) >= buffer.size()) {
+      buffer.resize(size + 1);
+      size = snprintf(buffer.data(), buffer.size(), format.c_str(), convert(values)...);
+    }
 
 #if defined(__clang__)  // {{{
 #pragma clang diagnostic pop
 #elif defined(__GNUC__)
 #pragma GCC diagnostic pop
 #endif  // }}}
+
+    if (size >= 0) {
+      enqueue(level, buffer.data(), size);
+    }
   }
 
  private:
+  struct sink;
+
+  static std::vector<char>& format_buffer();
+
+  void enqueue(loglevel level, const char* message, size_t size) const;
+  void write_lines(const string& lines) const;
+
   /**
    * Logger verbosity level
    */
@@ -155,6 +182,11 @@ class logger {
    * Loglevel specific suffixes
    */
   std::map<loglevel, string> m_suffixes;
+
+  /**
+   * Queue and writer thread, the thread is started with the first message
+   */
+  unique_ptr<sink> m_sink;
 };
 
 POLYBAR_NS_END
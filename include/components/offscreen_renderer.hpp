@@ -0,0 +1,93 @@
+#pragma once
+
+#include "cairo/fwd.hpp"
+#include "common.hpp"
+#include "components/renderer_interface.hpp"
+#include "components/types.hpp"
+
+POLYBAR_NS
+
+class config;
+class logger;
+
+/**
+ * \brief Renders bar contents into an image surface, without an X server
+ *
+ * Follows what the renderer does for text, colors, offsets, graphs and
+ * alignment blocks, but has no window to copy the result to. Used to
+ * render snapshots and to benchmark the render pipeline on machines without
+ * a display.
+ *
+ * Every frame is drawn between begin() and end(), the elements are passed
+ * in with tags::dispatch.
+ */
+class offscreen_renderer : public renderer_interface {
+ public:
+  /**
+   * Fonts are fontconfig patterns, optionally followed by ";<vertical offset>"
+   */
+  explicit offscreen_renderer(
+      const logger& log, const bar_settings& bar, int width, int height, const vector<string>& fonts, double dpi = 96);
+  ~offscreen_renderer();
+
+  static unique_ptr<offscreen_renderer> make(
+      const logger& log, const config& conf, const bar_settings& bar, int width, int height);
+
+  int width() const;
+  int height() const;
+  int content_width() const;
+
+  void begin();
+  void end();
+  void write_png(const string& path) const;
+  void write_png(int fd) const;
+  uint32_t pixel(int x, int y) const;
+
+  void change_background(const rgba& color) override;
+  void change_foreground(const rgba& color) override;
+  void change_underline(const rgba& color) override;
+  void change_overline(const rgba& color) override;
+  void change_font(int font) override;
+  void change_alignment(alignment align) override;
+  void reverse_colors() override;
+  void offset_pixel(int offset) override;
+  void attribute_set(tags::attribute attr) override;
+  void attribute_unset(tags::attribute attr) override;
+  void attribute_toggle(tags::attribute attr) override;
+  void action_begin(mousebtn btn, const string& command) override;
+  void action_end(mousebtn btn) override;
+  void render_text(const string& text) override;
+  void draw_graph(tags::graph_type type, int width, const vector<double>& values) override;
+  void control(tags::controltag ctrl) override;
+  void reserve_width(const tags::reserved_width& width) override;
+
+ protected:
+  void close_block();
+  void close_reservation();
+
+ private:
+  const bar_settings& m_bar;
+  int m_width;
+  int m_height;
+
+  int m_stride;
+  vector<unsigned char> m_data;
+  unique_ptr<cairo::surface> m_surface;
+  unique_ptr<cairo::context> m_context;
+
+  rgba m_bg{};
+  rgba m_fg{};
+  int m_font{0};
+  alignment m_align{alignment::NONE};
+  double m_x{0.0};
+  double m_y{0.0};
+
+  /**
+   * End of the reserved width that is open, if any
+   */
+  bool m_reserving{false};
+  bool m_reserved_fixed{false};
+  double m_reserved_end{0.0};
+};
+
+POLYBAR_NS_END
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <mutex>
+
+#include "common.hpp"
+#include "components/scheduler.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+class config;
+class logger;
+
+/**
+ * \brief Stretches the intervals of timer modules while on battery
+ *
+ * Set with `interval-on-battery-multiplier` in the settings section. The
+ * power supplies are checked every POLL_INTERVAL and the scheduler's interval
+ * factor is set to the multiplier while none of them is online. A multiplier
+ * of 1 (the default) disables the policy.
+ *
+ * Low power mode (`polybar-msg cmd low-power`) stretches the intervals by
+ * `interval-low-power-multiplier` (4 by default) until it is turned off
+ * again. The larger factor wins if both apply.
+ */
+class power_policy : non_copyable_mixin<power_policy> {
+ public:
+  using make_type = unique_ptr<power_policy>;
+  static make_type make();
+
+  static constexpr chrono::seconds POLL_INTERVAL{10};
+
+  explicit power_policy(const logger& logger, scheduler& scheduler, double multiplier, double low_power_multiplier,
+      string supplies = "/sys/class/power_supply");
+  ~power_policy();
+
+  static bool on_battery(const string& supplies);
+
+  void update();
+  void set_low_power(bool enabled);
+
+ protected:
+  void apply();
+
+ private:
+  const logger& m_log;
+  scheduler& m_scheduler;
+  const double m_multiplier;
+  const double m_low_power_multiplier;
+  const string m_supplies;
+
+  // update() runs on the workers, set_low_power() on the main thread
+  std::mutex m_lock;
+  bool m_on_battery{false};
+  bool m_low_power{false};
+  scheduler::task_id m_task{0};
+};
+
+POLYBAR_NS_END
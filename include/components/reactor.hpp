@@ -0,0 +1,53 @@
+#pragma once
+
+#include <sys/epoll.h>
+
+#include <mutex>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * Central readiness notifier for file descriptors.
+ *
+ * Components and modules register a callback for a file descriptor and the
+ * controller's event loop invokes it whenever the descriptor becomes ready.
+ * This allows fd driven modules to get by without a dedicated polling thread.
+ *
+ * Callbacks are invoked on the thread running reactor::poll (the main thread)
+ * and should therefore never block for long.
+ */
+class reactor : non_copyable_mixin<reactor> {
+ public:
+  using make_type = reactor&;
+  static make_type make();
+
+  /**
+   * Invoked with the ready file descriptor and the returned epoll event mask
+   */
+  using callback = function<void(int fd, unsigned int events)>;
+
+  explicit reactor();
+  ~reactor();
+
+  void add(int fd, unsigned int events, callback fn);
+  void modify(int fd, unsigned int events);
+  bool remove(int fd);
+  bool has(int fd) const;
+
+  int poll(int timeout_ms = -1);
+
+ protected:
+  static constexpr int MAX_EVENTS{32};
+
+ private:
+  int m_fd{-1};
+
+  mutable std::mutex m_lock;
+  std::unordered_map<int, callback> m_callbacks;
+};
+
+POLYBAR_NS_END
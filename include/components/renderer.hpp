@@ -2,11 +2,16 @@
 
 #include <cairo/cairo.h>
 
+#include <atomic>
 #include <bitset>
+#include <deque>
 #include <memory>
 
 #include "cairo/fwd.hpp"
 #include "common.hpp"
+#include "components/action_index.hpp"
+#include "components/renderer_interface.hpp"
+#include "components/stats.hpp"
 #include "components/types.hpp"
 #include "events/signal_fwd.hpp"
 #include "events/signal_receiver.hpp"
@@ -21,23 +26,108 @@ class config;
 class logger;
 class background_manager;
 class bg_slice;
+class shm_image;
+class present_buffers;
 // }}}
 
 using std::map;
 
+/**
+ * Drawing state that carries over from one element to the next
+ */
+struct render_state {
+  rgba bg{};
+  rgba fg{};
+  rgba ul{};
+  rgba ol{};
+  int font{0};
+  std::bitset<3> attr{};
+
+  bool operator==(const render_state& other) const;
+};
+
+/**
+ * Text element drawn into an alignment block
+ */
+struct text_slot {
+  /**
+   * Position and width relative to the start of the block
+   */
+  double x{0.0};
+  double w{0.0};
+  /**
+   * Set if the text ends a module with a reserved width: the unused rest of
+   * the width that the text can grow into, or negative where the text is cut
+   * off by a fixed width
+   */
+  double room{0.0};
+  render_state state{};
+  string text{};
+};
+
 struct alignment_block {
   cairo_pattern_t* pattern;
   double x;
   double y;
+
+  /**
+   * Set if the block is part of the frame currently being rendered
+   */
+  bool active{false};
+
+  /**
+   * Set if the pattern from the previous frame is used for the current frame
+   */
+  bool reused{false};
+
+  /**
+   * Drawing state before and after the contents of the block were drawn
+   */
+  render_state start{};
+  render_state end{};
+
+  /**
+   * Action blocks inside this block, relative to the start of the block
+   */
+  vector<action_block> actions{};
+
+  /**
+   * Absolute position and width of the block in the last flushed frame
+   */
+  double drawn_x{0.0};
+  double drawn_w{0.0};
+
+  /**
+   * Text elements of the block in the order they were drawn into the pattern
+   */
+  vector<text_slot> slots{};
+
+  /**
+   * Slots whose text changed since the pattern was drawn, mapped to the
+   * rendered replacement that is painted over the pattern (holds a reference)
+   */
+  map<size_t, cairo_pattern_t*> overlays{};
+
+  /**
+   * Slots that were patched in the current frame
+   */
+  vector<size_t> patched{};
 };
 
-class renderer
-    : public signal_receiver<SIGN_PRIORITY_RENDERER, signals::ui::request_snapshot, signals::parser::change_background,
-          signals::parser::change_foreground, signals::parser::change_underline, signals::parser::change_overline,
-          signals::parser::change_font, signals::parser::change_alignment, signals::parser::reverse_colors,
-          signals::parser::offset_pixel, signals::parser::attribute_set, signals::parser::attribute_unset,
-          signals::parser::attribute_toggle, signals::parser::action_begin, signals::parser::action_end,
-          signals::parser::text, signals::parser::control> {
+/**
+ * \brief Draws the bar contents into the bar window
+ *
+ * Alignment blocks are drawn one after the other into groups of a single
+ * context and composited in end(). They are not rasterized in parallel: the
+ * fonts, their shaped-run caches and the glyph atlas are shared by all
+ * blocks and not thread-safe, and cairo locks the FreeType face of a font
+ * for every use, so blocks using the same fonts would wait for each other.
+ * Blocks that didn't change are reused or patched instead of drawn again
+ * (see reuse_block() and patch_block()), so most frames draw a single block.
+ */
+class renderer : public renderer_interface,
+                 public signal_receiver<SIGN_PRIORITY_RENDERER, signals::ui::request_snapshot,
+                     signals::ui::update_background> {
  public:
   using make_type = unique_ptr<renderer>;
   static make_type make(const bar_settings& bar);
@@ -47,9 +137,11 @@ class renderer
   ~renderer();
 
   xcb_window_t window() const;
-  const vector<action_block> actions() const;
+  shared_ptr<const action_index> actions() const;
 
   void begin(xcb_rectangle_t rect);
+  bool reuse_block(alignment a);
+  bool patch_block(alignment a, size_t slot, const string& text);
   void end();
   void flush();
 
@@ -62,31 +154,49 @@ class renderer
   void fill_borders();
   void draw_text(const string& contents);
 
+  void change_background(const rgba& color) override;
+  void change_foreground(const rgba& color) override;
+  void change_underline(const rgba& color) override;
+  void change_overline(const rgba& color) override;
+  void change_font(int font) override;
+  void change_alignment(alignment align) override;
+  void reverse_colors() override;
+  void offset_pixel(int offset) override;
+  void attribute_set(tags::attribute attr) override;
+  void attribute_unset(tags::attribute attr) override;
+  void attribute_toggle(tags::attribute attr) override;
+  void action_begin(mousebtn btn, const string& command) override;
+  void action_end(mousebtn btn) override;
+  void render_text(const string& text) override;
+  void draw_graph(tags::graph_type type, int width, const vector<double>& values) override;
+  void control(tags::controltag ctrl) override;
+  void reserve_width(const tags::reserved_width& width) override;
+
  protected:
   double block_x(alignment a) const;
   double block_y(alignment a) const;
   double block_w(alignment a) const;
   double block_h(alignment a) const;
 
+  bool use_shm() const;
+  bool use_present() const;
+
   void flush(alignment a);
+  void flush(const xcb_rectangle_t& area);
+  void damage(double x, double w);
+  void close_block();
+  void close_reservation();
+  void clear_overlays(alignment_block& block);
+  cairo_pattern_t* rasterize(const text_slot& slot, const string& text);
+  void paint_text(const string& contents, double& x_advance, double& y_advance);
+  void create_background_layer();
+  void discard_blocks();
+  render_state state() const;
+  void restore_state(const render_state& state);
   void highlight_clickable_areas();
 
   bool on(const signals::ui::request_snapshot& evt);
-  bool on(const signals::parser::change_background& evt);
-  bool on(const signals::parser::change_foreground& evt);
-  bool on(const signals::parser::change_underline& evt);
-  bool on(const signals::parser::change_overline& evt);
-  bool on(const signals::parser::change_font& evt);
-  bool on(const signals::parser::change_alignment& evt);
-  bool on(const signals::parser::reverse_colors&);
-  bool on(const signals::parser::offset_pixel& evt);
-  bool on(const signals::parser::attribute_set& evt);
-  bool on(const signals::parser::attribute_unset& evt);
-  bool on(const signals::parser::attribute_toggle& evt);
-  bool on(const signals::parser::action_begin& evt);
-  bool on(const signals::parser::action_end& evt);
-  bool on(const signals::parser::text& evt);
-  bool on(const signals::parser::control& evt);
+  bool on(const signals::ui::update_background& evt);
 
  protected:
   struct reserve_area {
@@ -114,11 +224,81 @@ class renderer
 
   // bool m_autosize{false};
 
+#if WITH_XSHM
+  /**
+   * Shared memory image backing m_surface if render-backend = shm is used
+   *
+   * Declared before the cairo components so that it outlives them
+   */
+  unique_ptr<shm_image> m_shm;
+#endif
+#if WITH_XPRESENT
+  /**
+   * Pixmaps that are drawn into and shown in turns if render-backend = present is used
+   */
+  unique_ptr<present_buffers> m_present;
+#endif
   unique_ptr<cairo::context> m_context;
-  unique_ptr<cairo::xcb_surface> m_surface;
+  unique_ptr<cairo::surface> m_surface;
   map<alignment, alignment_block> m_blocks;
   cairo_pattern_t* m_cornermask{};
 
+  /**
+   * Text rendered on its own by rasterize(), the most recent first
+   */
+  struct rasterized_text {
+    render_state state;
+    string text;
+    double x;
+    double w;
+    // Width of the area the text was rendered into
+    double area;
+    cairo_pattern_t* pattern;
+  };
+  std::deque<rasterized_text> m_rasterized;
+
+  /**
+   * Wallpaper slice and borders, see create_background_layer()
+   */
+  cairo_pattern_t* m_bglayer{};
+  std::atomic<bool> m_bglayer_outdated{false};
+
+  /**
+   * Set while the contents of the current alignment block are drawn into a pushed group
+   */
+  bool m_drawing{false};
+
+  /**
+   * Width reserved for the module that is being drawn, see reserve_width()
+   */
+  struct reservation {
+    bool active{false};
+    bool fixed{false};
+    double x{0.0};
+    double w{0.0};
+    // Number of text slots in the block before the module started
+    size_t slots{0};
+  };
+  reservation m_reserved{};
+
+  /**
+   * Horizontal range of the pixmap that changed since it was last copied to the window
+   */
+  double m_damage_start{0.0};
+  double m_damage_end{0.0};
+
+  /**
+   * Set if the whole pixmap has to be copied on the next flush
+   */
+  std::atomic<bool> m_full_damage{true};
+
+  /**
+   * Time spent between begin() and end() and copying the pixmap
+   */
+  histogram& m_frame_stats{stats::make().get("renderer.frame")};
+  histogram& m_flush_stats{stats::make().get("renderer.flush")};
+  histogram::clock::time_point m_frame_start;
+
   cairo_operator_t m_comp_bg{CAIRO_OPERATOR_SOURCE};
   cairo_operator_t m_comp_fg{CAIRO_OPERATOR_OVER};
   cairo_operator_t m_comp_ol{CAIRO_OPERATOR_OVER};
@@ -135,6 +315,11 @@ class renderer
   rgba m_ul{};
   vector<action_block> m_actions;
 
+  /**
+   * Actions of the last completed frame, read from other threads with std::atomic_load
+   */
+  shared_ptr<const action_index> m_action_index{std::make_shared<action_index>()};
+
   bool m_fixedcenter;
   string m_snapshot_dst;
 };
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common.hpp"
+#include "components/types.hpp"
+#include "tags/types.hpp"
+#include "utils/color.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Target of tags::dispatch
+ *
+ * Receives the formatting and text of the bar contents, one call per parsed
+ * element. The elements of every frame end up here, so they are passed
+ * with direct calls instead of going through the signal_emitter.
+ */
+class renderer_interface {
+ public:
+  virtual ~renderer_interface() = default;
+
+  virtual void change_background(const rgba& color) = 0;
+  virtual void change_foreground(const rgba& color) = 0;
+  virtual void change_underline(const rgba& color) = 0;
+  virtual void change_overline(const rgba& color) = 0;
+  virtual void change_font(int font) = 0;
+  virtual void change_alignment(alignment align) = 0;
+  virtual void reverse_colors() = 0;
+  virtual void offset_pixel(int offset) = 0;
+  virtual void attribute_set(tags::attribute attr) = 0;
+  virtual void attribute_unset(tags::attribute attr) = 0;
+  virtual void attribute_toggle(tags::attribute attr) = 0;
+  virtual void action_begin(mousebtn btn, const string& command) = 0;
+  virtual void action_end(mousebtn btn) = 0;
+  virtual void render_text(const string& text) = 0;
+  /**
+   * Values are fractions in [0, 1], the graph is drawn in the foreground color
+   */
+  virtual void draw_graph(tags::graph_type type, int width, const vector<double>& values) = 0;
+  virtual void control(tags::controltag ctrl) = 0;
+  /**
+   * Reserve space for the contents up to the next reset control tag
+   */
+  virtual void reserve_width(const tags::reserved_width& width) = 0;
+};
+
+POLYBAR_NS_END
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "components/worker_pool.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace chrono = std::chrono;
+
+class logger;
+
+/**
+ * Runs periodic tasks on a small pool of worker threads.
+ *
+ * A single timer thread keeps the deadlines of all tasks in a min-heap and
+ * hands every task that is due over to the worker_pool. Deadlines are aligned to
+ * multiples of the task's interval, so tasks with the same interval become
+ * due at the same time and are handed over in one batch.
+ *
+ * Tasks can also allow their runs to be delayed by up to `slack`. Whenever
+ * the timer thread wakes up, it starts all tasks that are already due, not
+ * just the one it woke up for. Tasks with a deadline inside the slack window
+ * of another task are therefore run together with it.
+ *
+ * A task never runs concurrently with itself. Its next deadline is
+ * calculated once the callback returns.
+ *
+ * While the scheduler is suspended (e.g. while the bar can't be seen),
+ * periodic tasks are parked instead of getting a new deadline. Parked tasks
+ * run again as soon as the scheduler resumes. Single tasks can be paused the
+ * same way.
+ *
+ * The intervals of `STRETCHABLE` tasks are multiplied by the interval factor,
+ * which is raised while the machine runs on battery.
+ */
+class scheduler : non_copyable_mixin<scheduler> {
+ public:
+  using make_type = scheduler&;
+  static make_type make();
+
+  using clock = chrono::system_clock;
+  using duration = clock::duration;
+  using callback = function<void()>;
+
+  /**
+   * Identifies a task, 0 is never used
+   */
+  using task_id = size_t;
+
+  /**
+   * Task flags
+   *
+   * SUSPENDABLE: the task is parked while the scheduler is suspended
+   * STRETCHABLE: the interval is multiplied by the interval factor
+   * BACKGROUND: the task runs with the priority of worker threads, for
+   *             module updates that don't affect what is drawn right away
+   */
+  static constexpr unsigned SUSPENDABLE{1U << 0};
+  static constexpr unsigned STRETCHABLE{1U << 1};
+  static constexpr unsigned BACKGROUND{1U << 2};
+
+  explicit scheduler(const logger& logger, size_t workers);
+  ~scheduler();
+
+  task_id add(const string& name, duration interval, callback fn, duration offset = duration::zero(),
+      duration slack = duration::zero(), unsigned flags = SUSPENDABLE);
+  void remove(task_id id);
+  void trigger(task_id id);
+  void set_interval(task_id id, duration interval);
+  void pause(task_id id, bool paused);
+  void suspend(bool suspended);
+  void set_interval_factor(double factor);
+  void submit(worker_pool::job fn, histogram* latency = nullptr);
+  void defer(duration delay, callback fn);
+
+ protected:
+  enum class state { IDLE, QUEUED, RUNNING };
+
+  struct task {
+    duration interval;
+    duration offset;
+    duration slack;
+    callback fn;
+    /**
+     * Time between the task becoming due and a worker picking it up
+     */
+    histogram* latency{nullptr};
+    state status{state::IDLE};
+    /**
+     * Heap entries with a different deadline are outdated
+     */
+    clock::time_point deadline{};
+    /**
+     * Set if the task was triggered while it was running
+     */
+    bool again{false};
+    /**
+     * Set for deferred jobs, the task is removed after its only run
+     */
+    bool once{false};
+    unsigned flags{SUSPENDABLE};
+    /**
+     * Set if the task has no deadline because the scheduler is suspended or the task is paused
+     */
+    bool parked{false};
+    /**
+     * Set by pause(), the task is parked until it is resumed
+     */
+    bool paused{false};
+    std::thread::id runner{};
+  };
+
+  struct entry {
+    clock::time_point deadline;
+    /**
+     * Deadline including the slack, the heap is ordered by this
+     */
+    clock::time_point latest;
+    task_id id;
+
+    bool operator>(const entry& other) const {
+      return latest > other.latest;
+    }
+  };
+
+  void timer_loop();
+  bool outdated(const entry& e) const;
+  void run(task_id id);
+  void enqueue(task_id id, task& t);
+  void schedule(task_id id, task& t, clock::time_point now);
+
+ private:
+  const logger& m_log;
+
+  std::mutex m_lock;
+  std::condition_variable m_timer_cond;
+  std::condition_variable m_done_cond;
+
+  std::unordered_map<task_id, task> m_tasks;
+  std::priority_queue<entry, vector<entry>, std::greater<entry>> m_deadlines;
+  task_id m_next_id{1};
+  bool m_active{true};
+  bool m_suspended{false};
+  double m_factor{1.0};
+
+  std::thread m_timer;
+
+  /**
+   * Declared last so that running jobs are finished before anything they use is destroyed
+   */
+  worker_pool m_pool;
+};
+
+POLYBAR_NS_END
@@ -32,6 +32,10 @@ class screen : public xpp::event::sink<evt::randr_screen_change_notify> {
     return m_root;
   }
 
+  const vector<monitor_t>& monitors() const {
+    return m_monitors;
+  }
+
  protected:
   void handle(const evt::randr_screen_change_notify& evt);
 
@@ -46,9 +50,8 @@ class screen : public xpp::event::sink<evt::randr_screen_change_notify> {
 
   vector<monitor_t> m_monitors;
   struct size m_size {0U, 0U};
-  bool m_sigraised{false};
 
-  bool have_monitors_changed() const;
+  bool update_monitors();
 };
 
 POLYBAR_NS_END
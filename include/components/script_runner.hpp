@@ -0,0 +1,144 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace chrono = std::chrono;
+
+class logger;
+
+/**
+ * \brief Runs the commands of many script modules from a single thread
+ *
+ * A script that runs its command once per interval would otherwise need a
+ * thread that blocks until the command exits. Here, one thread starts the
+ * commands that are due, collects their output and reaps them once they exit,
+ * waiting for all of them at once with poll(). Exits are noticed through a
+ * pidfd where the kernel supports it (Linux 5.3) and by checking every 50ms
+ * otherwise.
+ *
+ * At most `max_concurrent` commands run at the same time, other scripts wait
+ * until a command finishes. Every script also gets a random phase of up to a
+ * tenth of its interval (at most a second), so that scripts with the same
+ * interval don't keep starting their commands at the same time.
+ *
+ * Callbacks are invoked on the runner's thread and should not block.
+ *
+ * Removed scripts get SIGTERM and are reaped in the background, commands
+ * that are still around after `KILL_TIMEOUT` get SIGKILL.
+ */
+class script_runner : non_copyable_mixin<script_runner> {
+ public:
+  using make_type = script_runner&;
+  static make_type make();
+
+  using clock = chrono::steady_clock;
+  using duration = clock::duration;
+
+  /**
+   * Identifies a script, 0 is never used
+   */
+  using script_id = size_t;
+
+  static constexpr chrono::milliseconds KILL_TIMEOUT{1000};
+
+  struct result {
+    /**
+     * False if the condition failed and the command wasn't run
+     */
+    bool ran{true};
+    int status{0};
+    /**
+     * Everything the command wrote to stdout and stderr
+     */
+    string output;
+  };
+
+  /**
+   * Returns the command line of the next run
+   */
+  using command_fn = function<string()>;
+  /**
+   * Invoked when a run is done, returns the time until the next one
+   */
+  using callback = function<duration(const result&)>;
+
+  explicit script_runner(const logger& logger, size_t max_concurrent);
+  ~script_runner();
+
+  script_id add(string condition, command_fn command, callback done, duration interval,
+      duration condition_interval = duration::zero());
+  void remove(script_id id);
+  void trigger(script_id id);
+
+ protected:
+  struct run {
+    pid_t pid{-1};
+    int output{-1};
+    int pidfd{-1};
+    bool condition{false};
+    bool exited{false};
+    int status{0};
+    string buffer;
+  };
+
+  struct script {
+    string condition;
+    duration condition_interval{};
+    /**
+     * Result of the last run of the condition, valid until `condition_until`
+     */
+    bool condition_met{false};
+    clock::time_point condition_until{};
+    command_fn command;
+    callback done;
+    duration phase{};
+    clock::time_point deadline{};
+    unique_ptr<run> running;
+    bool in_callback{false};
+  };
+
+  struct terminated {
+    pid_t pid;
+    clock::time_point kill_at;
+    bool killed{false};
+  };
+
+  void loop();
+  void start(script& s, bool condition);
+  bool collect(run& r);
+  void finish(script_id id, std::unique_lock<std::mutex>& guard);
+  void terminate(run& r);
+  void reap();
+  void notify();
+
+ private:
+  const logger& m_log;
+  size_t m_max_concurrent;
+
+  std::mutex m_lock;
+  std::condition_variable m_done;
+  std::unordered_map<script_id, script> m_scripts;
+  /**
+   * Processes that were sent SIGTERM and haven't been reaped yet
+   */
+  vector<terminated> m_terminated;
+  script_id m_next_id{1};
+  size_t m_running{0};
+  bool m_active{true};
+
+  int m_wakeup{-1};
+  std::thread m_thread;
+};
+
+POLYBAR_NS_END
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <mutex>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Runs shell commands from a helper process
+ *
+ * Forking the bar once it is running copies a large process with several
+ * threads for every click command. The helper is forked at the very start of
+ * main() instead, before the X connection is opened and before any thread is
+ * started. It receives commands over a socket and runs each of them detached,
+ * so the bar itself never forks for a command.
+ *
+ * The helper exits once the socket is closed. If it can't be started or died,
+ * commands are forked from the bar as before.
+ */
+class spawner : non_copyable_mixin<spawner> {
+ public:
+  using make_type = spawner&;
+  static make_type make();
+
+  explicit spawner() = default;
+  ~spawner();
+
+  bool start();
+  void stop();
+  bool running() const;
+
+  void spawn(const string& cmd);
+
+ protected:
+  [[noreturn]] static void serve(int fd);
+
+ private:
+  mutable std::mutex m_lock;
+  int m_socket{-1};
+  pid_t m_pid{-1};
+};
+
+POLYBAR_NS_END
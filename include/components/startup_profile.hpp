@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace chrono = std::chrono;
+
+/**
+ * \brief Timeline of the startup phases, enabled with --profile-startup
+ *
+ * Phases are recorded with their start and end time, relative to the
+ * creation of the instance at the start of main(). Once the bar shows the
+ * output of every module, the timeline is printed and optionally written as
+ * a Chrome trace (chrome://tracing, Perfetto) and recording stops.
+ *
+ * Recording is a single atomic load while the profile is disabled. Events
+ * can be recorded from any thread.
+ */
+class startup_profile : non_copyable_mixin<startup_profile> {
+ public:
+  using clock = chrono::steady_clock;
+  using make_type = startup_profile&;
+  static make_type make();
+
+  /**
+   * Records the time spent in the enclosing scope as a phase
+   */
+  class phase : non_copyable_mixin<phase> {
+   public:
+    explicit phase(string name);
+    ~phase();
+
+   private:
+    string m_name;
+    clock::time_point m_start;
+    bool m_enabled;
+  };
+
+  explicit startup_profile();
+
+  void enable(string trace_path);
+  bool enabled() const;
+
+  void record(string name, clock::time_point start, clock::time_point end);
+  void mark(string name);
+  void finish();
+
+  vector<string> report() const;
+  string trace() const;
+
+ protected:
+  struct event {
+    string name;
+    clock::duration start;
+    clock::duration duration;
+    size_t thread;
+    bool instant;
+  };
+
+ private:
+  const clock::time_point m_origin;
+  std::atomic_bool m_enabled{false};
+  string m_trace_path;
+
+  mutable std::mutex m_lock;
+  vector<event> m_events;
+};
+
+POLYBAR_NS_END
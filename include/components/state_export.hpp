@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Publishes the token values of all modules in a memory mapped file
+ *
+ * Enabled with the `state-file` key of the bar section. Other programs can map
+ * the file and read the values without any syscalls or IPC.
+ *
+ * The file starts with a header of 32 bytes, followed by the values as a JSON
+ * object of modules, each an object of its tokens without the percent signs:
+ *
+ *     offset  0  char[8]   magic "PLYSTATE"
+ *     offset  8  uint32_t  format version, currently 1
+ *     offset 12  uint32_t  reserved
+ *     offset 16  uint64_t  sequence, odd while the values are written
+ *     offset 24  uint64_t  length of the JSON
+ *
+ * Readers load the sequence, copy the JSON and load the sequence again. The
+ * copy is consistent if both are the same and even. If the length goes past
+ * the end of their mapping, the file has grown and has to be mapped again.
+ *
+ * Values are recorded with capture while a module updates or builds its output,
+ * every token a label replaces in that time is added to the module's values.
+ */
+class state_export : non_copyable_mixin<state_export> {
+ public:
+  using make_type = state_export&;
+  static make_type make();
+
+  using values = vector<pair<string, string>>;
+
+  static constexpr size_t HEADER_SIZE{32};
+  static constexpr size_t INITIAL_SIZE{64 * 1024};
+
+  /**
+   * Collects the tokens that are replaced on the calling thread while it exists
+   */
+  class capture : non_copyable_mixin<capture> {
+   public:
+    explicit capture();
+    ~capture();
+
+    /**
+     * Stops capturing, returns the tokens and their values in the order they were replaced
+     */
+    values take();
+
+   private:
+    bool m_active{false};
+    values m_values;
+    values* m_previous{nullptr};
+  };
+
+  ~state_export();
+
+  static bool enabled() {
+    return s_enabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Called by labels for every replaced token
+   */
+  static void record(const string& token, const string& value) {
+    if (s_capture != nullptr) {
+      s_capture->emplace_back(token, value);
+    }
+  }
+
+  void open(const string& path);
+  void close();
+  void update(const string& module, const std::map<string, string>& values);
+  void remove(const string& module);
+
+ protected:
+  void write();
+  void reserve(size_t size);
+
+ private:
+  static std::atomic<bool> s_enabled;
+  static thread_local values* s_capture;
+
+  std::mutex m_lock;
+  int m_fd{-1};
+  char* m_map{nullptr};
+  size_t m_size{0};
+  std::map<string, std::map<string, string>> m_modules;
+  string m_json;
+};
+
+POLYBAR_NS_END
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace chrono = std::chrono;
+
+/**
+ * Rolling histogram of durations
+ *
+ * Only the most recent WINDOW samples are kept, so the summary always
+ * describes the recent behavior of the bar and not the whole runtime.
+ * Samples can be recorded from any thread.
+ */
+class histogram : non_copyable_mixin<histogram> {
+ public:
+  using clock = chrono::steady_clock;
+
+  static constexpr size_t WINDOW{512};
+
+  /**
+   * Summary of the samples in the window, durations in milliseconds
+   */
+  struct summary {
+    size_t count{0};
+    size_t total{0};
+    double sum{0.0};
+    double avg{0.0};
+    double p50{0.0};
+    double p95{0.0};
+    double max{0.0};
+  };
+
+  void record(clock::duration duration);
+  summary summarize() const;
+  void reset();
+
+ private:
+  mutable std::mutex m_lock;
+  std::array<clock::duration, WINDOW> m_samples{};
+  size_t m_next{0};
+  size_t m_total{0};
+};
+
+/**
+ * Counts hits and misses of a cache
+ */
+class hit_counter : non_copyable_mixin<hit_counter> {
+ public:
+  void hit();
+  void miss();
+  size_t hits() const;
+  size_t misses() const;
+  double rate() const;
+  void reset();
+
+ private:
+  std::atomic<size_t> m_hits{0};
+  std::atomic<size_t> m_misses{0};
+};
+
+/**
+ * Records the time spent in the enclosing scope
+ */
+class scoped_timer : non_copyable_mixin<scoped_timer> {
+ public:
+  explicit scoped_timer(histogram& target) : m_target(target), m_start(histogram::clock::now()) {}
+
+  ~scoped_timer() {
+    m_target.record(histogram::clock::now() - m_start);
+  }
+
+ private:
+  histogram& m_target;
+  histogram::clock::time_point m_start;
+};
+
+/**
+ * Registry of timing histograms for the different stages of a redraw and of
+ * hit counters for the caches involved
+ *
+ * Histograms and counters are created on first use and live as long as the
+ * process, references returned by get() and counter() therefore never dangle.
+ */
+class stats : non_copyable_mixin<stats> {
+ public:
+  using make_type = stats&;
+  static make_type make();
+
+  histogram& get(const string& name);
+  hit_counter& counter(const string& name);
+  vector<string> report() const;
+  void reset();
+
+ private:
+  mutable std::mutex m_lock;
+  std::map<string, unique_ptr<histogram>> m_histograms;
+  std::map<string, unique_ptr<hit_counter>> m_counters;
+};
+
+POLYBAR_NS_END
@@ -3,8 +3,10 @@
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <map>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 
 #include "common.hpp"
 #include "utils/mixins.hpp"
@@ -14,6 +16,13 @@ POLYBAR_NS
 namespace chrono = std::chrono;
 using namespace std::chrono_literals;
 
+/**
+ * \brief Runs callbacks after a delay on a thread of its own
+ *
+ * Tasks are ordered by their deadline, so the next one is found without
+ * looking at the others. An index by id makes purging and looking up tasks
+ * independent of the amount of pending tasks as well.
+ */
 class taskqueue : non_copyable_mixin<taskqueue> {
  public:
   struct deferred {
@@ -48,7 +57,12 @@ class taskqueue : non_copyable_mixin<taskqueue> {
   bool purge(const string& id);
 
  protected:
+  using queue = std::multimap<deferred::timepoint, unique_ptr<deferred>>;
+
   void tick();
+  void insert(unique_ptr<deferred>&& task);
+  unique_ptr<deferred> take(queue::iterator it);
+  bool remove(const string& id);
 
  private:
   std::thread m_thread;
@@ -56,7 +70,15 @@ class taskqueue : non_copyable_mixin<taskqueue> {
   std::condition_variable m_hold;
   std::atomic_bool m_active{true};
 
-  vector<unique_ptr<deferred>> m_deferred;
+  /**
+   * Pending tasks by their next deadline
+   */
+  queue m_deferred;
+
+  /**
+   * Position of the tasks in m_deferred by their id, ids don't have to be unique
+   */
+  std::unordered_multimap<string, queue::iterator> m_index;
 };
 
 POLYBAR_NS_END
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+class config;
+class logger;
+
+/**
+ * \brief Scheduling priority and cpu affinity of the bar's threads
+ *
+ * Every long running thread is started with spawn() and keeps its role
+ * until it exits. UI threads (the event loop, the event queue, the render
+ * thread and deferred clicks) handle input and draw the bar, worker threads
+ * (module threads, scripts) sample data in the background. The scheduler's
+ * threads are NORMAL: they also run animations and rebuild the output of
+ * modules, only the module updates they run are WORKER work, see
+ * scoped_role.
+ *
+ * Set in the settings section:
+ *
+ *   ui-priority = -5          nice value of the UI threads
+ *   worker-priority = idle    nice value of the workers, or `idle` for SCHED_IDLE
+ *   cpu-affinity = 0-3,6      cpus all threads may run on
+ *
+ * Threads that start before the config is loaded are updated once it is.
+ * Without any of the settings, threads are left alone.
+ */
+class thread_policy : non_copyable_mixin<thread_policy> {
+ public:
+  using make_type = thread_policy&;
+  static make_type make();
+
+  enum class role { UI, NORMAL, WORKER };
+
+  /**
+   * Gives the calling thread another role for the lifetime of the object
+   */
+  class scoped_role : non_copyable_mixin<scoped_role> {
+   public:
+    explicit scoped_role(role r);
+    ~scoped_role();
+
+   private:
+    role m_previous;
+  };
+
+  /**
+   * Priority of a role, nice is ignored for idle threads
+   */
+  struct priority {
+    bool idle{false};
+    int nice{0};
+  };
+
+  explicit thread_policy(const logger& logger);
+
+  static priority parse_priority(const string& value);
+  static vector<int> parse_cpus(const string& value);
+
+  /**
+   * Start a thread that runs `fn` in the given role
+   */
+  template <typename Fn>
+  static std::thread spawn(role r, Fn&& fn) {
+    return std::thread([r](typename std::decay<Fn>::type fn) {
+      make().enter(r);
+      fn();
+    }, std::forward<Fn>(fn));
+  }
+
+  void configure(const config& conf);
+  void enter(role r);
+  void leave();
+  role current() const;
+
+ protected:
+  void apply(pid_t tid, role r);
+
+ private:
+  const logger& m_log;
+
+  std::mutex m_lock;
+  bool m_configured{false};
+  priority m_ui{};
+  priority m_worker{};
+  vector<int> m_cpus;
+
+  /**
+   * Threads that entered a role and haven't exited yet
+   */
+  std::unordered_map<pid_t, role> m_threads;
+};
+
+POLYBAR_NS_END
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_set>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace chrono = std::chrono;
+
+/**
+ * \brief Records spans of work on all threads, exported as a Chrome trace
+ *
+ * Started and stopped with `polybar-msg cmd trace-start|trace-stop`, the
+ * spans recorded so far are written with `trace-dump` and can be opened in
+ * chrome://tracing or Perfetto.
+ *
+ * Every thread records into its own ring buffer of the last CAPACITY spans,
+ * so recording takes no lock and threads don't wait for each other. Only a
+ * thread's first span takes a lock to register the buffer. The buffer is
+ * freed when the thread exits, together with its spans. While tracing is
+ * stopped, a span is a single atomic load.
+ *
+ * Span names must outlive the tracer, either string literals or names
+ * returned by intern().
+ */
+class tracer : non_copyable_mixin<tracer> {
+ public:
+  using clock = chrono::steady_clock;
+  using make_type = tracer&;
+  static make_type make();
+
+  static constexpr size_t CAPACITY{4096};
+
+  /**
+   * Records the time spent in the enclosing scope as a span
+   */
+  class span : non_copyable_mixin<span> {
+   public:
+    explicit span(const char* name) : m_name(tracer::enabled() ? name : nullptr) {
+      if (m_name != nullptr) {
+        m_start = clock::now();
+      }
+    }
+
+    ~span() {
+      if (m_name != nullptr) {
+        tracer::make().record(m_name, m_start, clock::now());
+      }
+    }
+
+   private:
+    const char* m_name;
+    clock::time_point m_start;
+  };
+
+  static bool enabled() {
+    return s_enabled.load(std::memory_order_relaxed);
+  }
+
+  void start();
+  void stop();
+
+  const char* intern(const string& name);
+  void record(const char* name, clock::time_point start, clock::time_point end);
+  string dump() const;
+  string write() const;
+
+ protected:
+  struct entry {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<clock::rep> start{0};
+    std::atomic<clock::rep> duration{0};
+  };
+
+  /**
+   * Spans of a single thread, only written by that thread
+   */
+  struct buffer {
+    size_t thread{0};
+    // Number of spans ever recorded, the latest is at (count - 1) % CAPACITY
+    std::atomic<size_t> count{0};
+    entry entries[CAPACITY];
+  };
+
+  /**
+   * Unregisters and frees the buffer of a thread when the thread exits
+   */
+  struct thread_slot {
+    buffer* buf{nullptr};
+    ~thread_slot();
+  };
+
+  buffer& local_buffer();
+  void release(buffer* buf);
+
+ private:
+  static std::atomic<bool> s_enabled;
+  static thread_local thread_slot t_slot;
+
+  mutable std::mutex m_lock;
+  vector<unique_ptr<buffer>> m_buffers;
+  std::unordered_set<string> m_names;
+};
+
+#define POLYBAR_TRACE_CONCAT_(a, b) a##b
+#define POLYBAR_TRACE_CONCAT(a, b) POLYBAR_TRACE_CONCAT_(a, b)
+
+/**
+ * Record the rest of the enclosing scope as a span with the given name
+ */
+#define POLYBAR_TRACE(name) tracer::span POLYBAR_TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+POLYBAR_NS_END
@@ -170,6 +170,12 @@ struct bar_settings {
   bool dimmed{false};
   double dimvalue{1.0};
 
+  /**
+   * Upper limit for redraws per second, the refresh rate of the monitor unless
+   * `settings.max-fps` is set and 60 if the refresh rate is unknown
+   */
+  unsigned int max_fps{60U};
+
   bool shaded{false};
   struct size shade_size {
     1U, 1U
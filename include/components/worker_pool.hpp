@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "common.hpp"
+#include "components/stats.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+class logger;
+
+/**
+ * Fixed number of threads that run submitted jobs.
+ *
+ * Every worker has its own queue. Jobs submitted from a worker go to its
+ * own queue, all other jobs are distributed round-robin. A worker that runs
+ * out of jobs steals from the other queues, so a job stuck behind a slow
+ * one (e.g. a module waiting for a network request) is picked up by the next
+ * idle worker.
+ */
+class worker_pool : non_copyable_mixin<worker_pool> {
+ public:
+  using job = function<void()>;
+
+  explicit worker_pool(const logger& logger, size_t workers);
+  ~worker_pool();
+
+  void submit(job fn, histogram* latency = nullptr);
+  size_t size() const;
+
+ protected:
+  struct task {
+    job fn;
+    /**
+     * Receives the time the job spent in the queue
+     */
+    histogram* latency;
+    histogram::clock::time_point queued;
+  };
+
+  struct worker {
+    std::mutex lock;
+    std::deque<task> tasks;
+    std::thread thread;
+  };
+
+  bool pop(size_t index, task& out);
+  bool steal(size_t index, task& out);
+  void run(size_t index);
+
+ private:
+  const logger& m_log;
+
+  vector<unique_ptr<worker>> m_workers;
+  std::atomic<size_t> m_next{0};
+  std::atomic<size_t> m_pending{0};
+  std::atomic<bool> m_active{true};
+
+  std::mutex m_idle_lock;
+  std::condition_variable m_idle;
+};
+
+POLYBAR_NS_END
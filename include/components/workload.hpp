@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <istream>
+#include <mutex>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+namespace chrono = std::chrono;
+
+/**
+ * \brief Records the output of the modules and the input of the bar, enabled with `--record FILE`
+ *
+ * Every line of the file is one event: the time in microseconds since the
+ * recording started, the type of the event and its data, separated by spaces.
+ *
+ *     <us> layout <left|center|right> <module>...
+ *     <us> update <module> <formatting string>
+ *     <us> input <action>
+ *
+ * Newlines in the data are replaced by spaces. The file is played back with
+ * workload_replay (`--replay FILE`).
+ */
+class workload_recorder : non_copyable_mixin<workload_recorder> {
+ public:
+  using clock = chrono::steady_clock;
+  using make_type = workload_recorder&;
+  static make_type make();
+
+  ~workload_recorder();
+
+  static bool enabled() {
+    return s_enabled.load(std::memory_order_relaxed);
+  }
+
+  void open(const string& path);
+  void close();
+
+  void layout(const string& align, const vector<string>& modules);
+  void update(const string& module, const string& contents);
+  void input(const string& action);
+
+ protected:
+  void write(const char* type, const string& data);
+
+ private:
+  static std::atomic<bool> s_enabled;
+
+  std::mutex m_lock;
+  FILE* m_file{nullptr};
+  clock::time_point m_start;
+};
+
+/**
+ * \brief Plays back a workload recorded by workload_recorder
+ *
+ * The events are applied in the recorded order, scaled by the speed. A
+ * frame is drawn whenever the playback caught up with the recording, the
+ * contents of the modules are joined without the padding, margins and
+ * separators of the bar. Updates that are replaced before a frame shows
+ * them are dropped.
+ *
+ * The latency of an input is the time until a frame shows the next update of
+ * the module the action was for. Since the updates are played back from the
+ * recording, this is the recorded delay divided by the speed plus the time it
+ * takes to draw the frame, the modules themselves aren't measured.
+ *
+ * With a speed of 0 the events are played back as fast as possible and a
+ * frame is drawn after all events that were recorded at the same time.
+ */
+class workload_replay {
+ public:
+  using clock = chrono::steady_clock;
+  using draw_callback = function<void(const string& contents)>;
+
+  struct result {
+    size_t events{0};
+    size_t updates{0};
+    size_t dropped{0};
+    size_t frames{0};
+    size_t inputs{0};
+    clock::duration elapsed{};
+    /**
+     * Input to frame latency in milliseconds, of the inputs that were followed by a frame
+     */
+    size_t latencies{0};
+    double p50{0.0};
+    double p99{0.0};
+  };
+
+  /**
+   * \throws application_error if a line is not an event
+   */
+  explicit workload_replay(std::istream& in);
+
+  size_t size() const;
+  result run(double speed, const draw_callback& draw) const;
+
+ protected:
+  struct entry {
+    chrono::microseconds time;
+    string type;
+    // Alignment of a layout, module of an update and of an input if it was an action
+    string name;
+    string data;
+  };
+
+ private:
+  vector<entry> m_entries;
+};
+
+POLYBAR_NS_END
@@ -2,9 +2,12 @@
 
 #include <atomic>
 #include <chrono>
+#include <map>
+#include <mutex>
 
 #include "common.hpp"
 #include "components/config.hpp"
+#include "components/scheduler.hpp"
 #include "drawtypes/label.hpp"
 #include "utils/mixins.hpp"
 
@@ -42,6 +45,58 @@ namespace drawtypes {
 
   animation_t load_animation(
       const config& conf, const string& section, string name = "animation", bool required = true);
+
+  /**
+   * Advances all animations that are shown
+   *
+   * Animations with the same framerate share a scheduler task. Their frames
+   * are aligned to multiples of the framerate, so animations with compatible
+   * rates (e.g. 250ms and 500ms) change in the same frame and the bar is only
+   * redrawn once for all of them.
+   */
+  class animation_clock : non_copyable_mixin<animation_clock> {
+   public:
+    using make_type = animation_clock&;
+    static make_type make();
+
+    /**
+     * Identifies a registered animation, 0 is never used
+     */
+    using animation_id = size_t;
+    /**
+     * Called on a worker after the animation advanced, it must not call add() or remove()
+     */
+    using callback = function<void()>;
+
+    explicit animation_clock(scheduler& scheduler);
+    ~animation_clock();
+
+    animation_id add(animation_t animation, callback fn);
+    void remove(animation_id id);
+
+   protected:
+    void tick(unsigned int framerate);
+
+   private:
+    struct member {
+      animation_t animation;
+      callback fn;
+    };
+
+    struct group {
+      scheduler::task_id task{0};
+      // The scheduler runs new tasks right away, which is not a frame yet
+      bool started{false};
+      std::map<animation_id, member> members;
+    };
+
+    scheduler& m_scheduler;
+
+    std::mutex m_lock;
+    std::map<unsigned int, group> m_groups;
+    std::map<animation_id, unsigned int> m_framerates;
+    animation_id m_next_id{1};
+  };
 }  // namespace drawtypes
 
 POLYBAR_NS_END
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include "common.hpp"
 #include "drawtypes/label.hpp"
@@ -9,15 +11,29 @@
 POLYBAR_NS
 
 namespace drawtypes {
+  /**
+   * \brief Icons by id, e.g. by workspace name
+   *
+   * The result of fuzzy matching an id is remembered, so the icons are only
+   * searched the first time an id is seen. Adding an icon forgets all results.
+   */
   class iconset : public non_copyable_mixin<iconset> {
    public:
+    static constexpr size_t MAX_FUZZY_RESULTS{256};
+
     void add(string id, label_t&& icon);
     bool has(const string& id);
     label_t get(const string& id, const string& fallback_id = "", bool fuzzy_match = false);
     operator bool();
 
    protected:
+    label_t fuzzy_find(const string& id);
+
     std::map<string, label_t> m_icons;
+
+    std::mutex m_lock;
+    // Icon whose id is contained in the given id, or nullptr if there is none
+    std::unordered_map<string, label_t> m_fuzzy;
   };
 
   using iconset_t = shared_ptr<iconset>;
@@ -40,7 +40,9 @@ namespace drawtypes {
     alignment m_alignment{alignment::LEFT};
     bool m_ellipsis{true};
 
-    explicit label(string text, int font) : m_font(font), m_text(text), m_tokenized(m_text) {}
+    explicit label(string text, int font) : m_font(font), m_template(compile(move(text), {})) {
+      reset_tokens();
+    }
     explicit label(string text, rgba foreground = rgba{}, rgba background = rgba{}, rgba underline = rgba{},
         rgba overline = rgba{}, int font = 0, struct side_values padding = {0U, 0U},
         struct side_values margin = {0U, 0U}, int minlen = 0, size_t maxlen = 0_z,
@@ -56,10 +58,9 @@ namespace drawtypes {
         , m_maxlen(maxlen)
         , m_alignment(label_alignment)
         , m_ellipsis(ellipsis)
-        , m_text(text)
-        , m_tokenized(m_text)
-        , m_tokens(forward<vector<token>>(tokens)) {
+        , m_template(compile(move(text), forward<vector<token>>(tokens))) {
       assert(!m_ellipsis || (m_maxlen == 0 || m_maxlen >= 3));
+      reset_tokens();
     }
 
     string get() const;
@@ -74,9 +75,85 @@ namespace drawtypes {
     void copy_undefined(const label_t& label);
 
    private:
-    string m_text{};
-    string m_tokenized{};
-    const vector<token> m_tokens{};
+    /**
+     * Slot for tokens[token], preceded by the literal text text[start, start + length)
+     */
+    struct slot {
+      size_t start;
+      size_t length;
+      size_t token;
+    };
+
+    /**
+     * The text and tokens of a label, split into literal text and token slots
+     *
+     * It never changes after construction, so clones share it with the label
+     * they were made from and only keep their own replacements
+     */
+    struct text_template {
+      string text;
+      vector<token> tokens;
+      vector<slot> slots;
+      size_t tail;
+    };
+
+    /**
+     * Label with the style of `style` that shares the template `tmpl`, used by clone()
+     */
+    explicit label(const label& style, shared_ptr<const text_template> tmpl)
+        : m_foreground(style.m_foreground)
+        , m_background(style.m_background)
+        , m_underline(style.m_underline)
+        , m_overline(style.m_overline)
+        , m_font(style.m_font)
+        , m_padding(style.m_padding)
+        , m_margin(style.m_margin)
+        , m_minlen(style.m_minlen)
+        , m_maxlen(style.m_maxlen)
+        , m_alignment(style.m_alignment)
+        , m_ellipsis(style.m_ellipsis)
+        , m_template(move(tmpl)) {
+      reset_tokens();
+    }
+
+    static shared_ptr<const text_template> compile(string text, vector<token>&& tokens);
+    const string& tokenized() const;
+    string truncated(const string& text) const;
+
+    shared_ptr<const text_template> m_template;
+
+    /**
+     * Replacement of each slot, slots without one still show their token
+     */
+    vector<string> m_values{};
+    vector<bool> m_filled{};
+
+    /**
+     * Set by clear() and reset_tokens(const string&), the text no longer
+     * follows the slots and tokens are replaced in m_tokenized directly
+     */
+    bool m_detached{false};
+
+    /**
+     * Materialized text, rebuilt by tokenized() after slots were changed
+     */
+    mutable string m_tokenized{};
+    mutable bool m_dirty{false};
+
+    /**
+     * Recent results of the maxlen truncation and the text they were cut from
+     *
+     * Texts that cycle through a few values, like a spinner in a window
+     * title, are only truncated once per value
+     */
+    struct truncation {
+      size_t hash;
+      string source;
+      string text;
+    };
+    static constexpr size_t TRUNCATION_CACHE_SIZE{8_z};
+    mutable vector<truncation> m_truncations{};
+    mutable size_t m_truncation_next{0_z};
   };
 
   label_t load_label(const config& conf, const string& section, string name, bool required = true, string def = ""s);
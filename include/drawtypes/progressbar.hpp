@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+
 #include "common.hpp"
 #include "components/builder.hpp"
 #include "components/config.hpp"
@@ -9,6 +11,11 @@
 POLYBAR_NS
 
 namespace drawtypes {
+  /**
+   * The output only depends on the number of filled segments and the color
+   * of the fill, so a bar of width N has at most N+1 outputs per color. They
+   * are built once and then taken from a cache.
+   */
   class progressbar : public non_copyable_mixin<progressbar> {
    public:
     explicit progressbar(const bar_settings& bar, int width, string format);
@@ -22,7 +29,7 @@ namespace drawtypes {
     string output(float percentage);
 
    protected:
-    void fill(unsigned int perc, unsigned int fill_width);
+    void fill(size_t color, unsigned int fill_width);
 
    private:
     unique_ptr<builder> m_builder;
@@ -35,6 +42,11 @@ namespace drawtypes {
     label_t m_fill;
     label_t m_empty;
     label_t m_indicator;
+
+    /**
+     * Outputs by number of filled segments and fill color (0 if it isn't fixed)
+     */
+    std::map<pair<unsigned int, size_t>, string> m_outputs;
   };
 
   using progressbar_t = shared_ptr<progressbar>;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+
 #include "common.hpp"
 #include "components/ipc.hpp"
 #include "components/types.hpp"
@@ -61,7 +63,8 @@ namespace signals {
     struct exit_reload : public detail::base_signal<exit_reload> {
       using base_type::base_type;
     };
-    struct notify_change : public detail::base_signal<notify_change> {
+    /// emitted by modules whenever their output changed, carries the module name
+    struct notify_change : public detail::value_signal<notify_change, string> {
       using base_type::base_type;
     };
     struct notify_forcechange : public detail::base_signal<notify_forcechange> {
@@ -70,6 +73,10 @@ namespace signals {
     struct check_state : public detail::base_signal<check_state> {
       using base_type::base_type;
     };
+    /// emitted by modules when they stop, carries the module name
+    struct module_stopped : public detail::value_signal<module_stopped, string> {
+      using base_type::base_type;
+    };
   }  // namespace eventqueue
 
   namespace ipc {
@@ -82,6 +89,10 @@ namespace signals {
     struct action : public detail::value_signal<action, string> {
       using base_type::base_type;
     };
+    /// carries the module name and its new content, separated by a space
+    struct content : public detail::value_signal<content, string> {
+      using base_type::base_type;
+    };
   }  // namespace ipc
 
   namespace ui {
@@ -91,10 +102,9 @@ namespace signals {
     struct changed : public detail::base_signal<changed> {
       using base_type::base_type;
     };
-    struct tick : public detail::base_signal<tick> {
-      using base_type::base_type;
-    };
-    struct button_press : public detail::value_signal<button_press, string> {
+    /// carries the command of the clicked area and the time the click was received
+    struct button_press
+        : public detail::value_signal<button_press, pair<string, std::chrono::steady_clock::time_point>> {
       using base_type::base_type;
     };
     struct cursor_change : public detail::value_signal<cursor_change, string> {
@@ -123,6 +133,10 @@ namespace signals {
     struct update_geometry : public detail::base_signal<update_geometry> {
       using base_type::base_type;
     };
+    /// emitted when the RandR monitor configuration changed, see screen::monitors()
+    struct monitors_changed : public detail::base_signal<monitors_changed> {
+      using base_type::base_type;
+    };
   }  // namespace ui
 
   namespace ui_tray {
@@ -130,54 +144,6 @@ namespace signals {
       using base_type::base_type;
     };
   }  // namespace ui_tray
-
-  namespace parser {
-    struct change_background : public detail::value_signal<change_background, rgba> {
-      using base_type::base_type;
-    };
-    struct change_foreground : public detail::value_signal<change_foreground, rgba> {
-      using base_type::base_type;
-    };
-    struct change_underline : public detail::value_signal<change_underline, rgba> {
-      using base_type::base_type;
-    };
-    struct change_overline : public detail::value_signal<change_overline, rgba> {
-      using base_type::base_type;
-    };
-    struct change_font : public detail::value_signal<change_font, int> {
-      using base_type::base_type;
-    };
-    struct change_alignment : public detail::value_signal<change_alignment, alignment> {
-      using base_type::base_type;
-    };
-    struct reverse_colors : public detail::base_signal<reverse_colors> {
-      using base_type::base_type;
-    };
-    struct offset_pixel : public detail::value_signal<offset_pixel, int> {
-      using base_type::base_type;
-    };
-    struct attribute_set : public detail::value_signal<attribute_set, tags::attribute> {
-      using base_type::base_type;
-    };
-    struct attribute_unset : public detail::value_signal<attribute_unset, tags::attribute> {
-      using base_type::base_type;
-    };
-    struct attribute_toggle : public detail::value_signal<attribute_toggle, tags::attribute> {
-      using base_type::base_type;
-    };
-    struct action_begin : public detail::value_signal<action_begin, action> {
-      using base_type::base_type;
-    };
-    struct action_end : public detail::value_signal<action_end, mousebtn> {
-      using base_type::base_type;
-    };
-    struct text : public detail::value_signal<text, string> {
-      using base_type::base_type;
-    };
-    struct control : public detail::value_signal<control, tags::controltag> {
-      using base_type::base_type;
-    };
-  }  // namespace parser
 }  // namespace signals
 
 POLYBAR_NS_END
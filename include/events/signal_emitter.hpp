@@ -1,16 +1,13 @@
 #pragma once
 
+#include <algorithm>
+
 #include "common.hpp"
 #include "components/logger.hpp"
 #include "events/signal_receiver.hpp"
 
 POLYBAR_NS
 
-/**
- * \brief Holds all signal receivers attached to the emitter
- */
-extern signal_receivers_t g_signal_receivers;
-
 /**
  * Wrapper used to delegate emitted signals
  * to attached signal receivers
@@ -24,13 +21,14 @@ class signal_emitter {
   virtual ~signal_emitter() {}
 
   template <typename Signal>
-  bool emit(const Signal& sig) {
+  bool emit(const Signal& sig) const {
+    const auto& receivers = signal_receivers<Signal>::list;
+
     try {
-      if (g_signal_receivers.find(id<Signal>()) != g_signal_receivers.end()) {
-        for (auto&& item : g_signal_receivers.at(id<Signal>())) {
-          if (item.second->on(sig)) {
-            return true;
-          }
+      // Indexed so that a receiver can detach itself while handling the signal
+      for (size_t i = 0; i < receivers.size(); i++) {
+        if (receivers[i].second->on(sig)) {
+          return true;
         }
       }
     } catch (const std::exception& e) {
@@ -56,52 +54,39 @@ class signal_emitter {
   }
 
  protected:
-  template <typename Signal>
-  std::type_index id() const {
-    return typeid(Signal);
-  }
-
   template <typename Receiver, typename Signal>
   void attach(Receiver* s) {
-    attach(s, id<Signal>());
+    using entry = typename signal_receivers<Signal>::entry;
+    auto& receivers = signal_receivers<Signal>::list;
+
+    // Receivers with the same priority are called in the order they were attached
+    auto prio = s->priority();
+    auto pos = std::upper_bound(receivers.begin(), receivers.end(), prio,
+        [](signal_receiver_interface::prio p, const entry& e) { return p < e.first; });
+    receivers.insert(pos, entry{prio, s});
   }
 
   template <typename Receiver, typename Signal, typename Next, typename... Signals>
   void attach(Receiver* s) {
-    attach(s, id<Signal>());
+    attach<Receiver, Signal>(s);
     attach<Receiver, Next, Signals...>(s);
   }
 
-  void attach(signal_receiver_interface* s, std::type_index id) {
-    g_signal_receivers[id].emplace(s->priority(), s);
-  }
-
   template <typename Receiver, typename Signal>
   void detach(Receiver* s) {
-    detach(s, id<Signal>());
+    using entry = typename signal_receivers<Signal>::entry;
+    auto& receivers = signal_receivers<Signal>::list;
+
+    signal_receiver_impl<Signal>* impl = s;
+    receivers.erase(std::remove_if(receivers.begin(), receivers.end(), [&](const entry& e) { return e.second == impl; }),
+        receivers.end());
   }
 
   template <typename Receiver, typename Signal, typename Next, typename... Signals>
   void detach(Receiver* s) {
-    detach(s, id<Signal>());
+    detach<Receiver, Signal>(s);
     detach<Receiver, Next, Signals...>(s);
   }
-
-  void detach(signal_receiver_interface* d, std::type_index id) {
-    try {
-      auto& prio_map = g_signal_receivers.at(id);
-      const auto& prio_sink_pair = prio_map.equal_range(d->priority());
-
-      for (auto it = prio_sink_pair.first; it != prio_sink_pair.second;) {
-        if (d == it->second) {
-          it = prio_map.erase(it);
-        } else {
-          ++it;
-        }
-      }
-    } catch (...) {
-    }
-  }
 };
 
 POLYBAR_NS_END
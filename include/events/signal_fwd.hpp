@@ -21,16 +21,17 @@ namespace signals {
     struct notify_change;
     struct notify_forcechange;
     struct check_state;
+    struct module_stopped;
   }  // namespace eventqueue
   namespace ipc {
     struct command;
     struct hook;
     struct action;
+    struct content;
   }  // namespace ipc
   namespace ui {
     struct ready;
     struct changed;
-    struct tick;
     struct button_press;
     struct cursor_change;
     struct visibility_change;
@@ -40,27 +41,11 @@ namespace signals {
     struct request_snapshot;
     struct update_background;
     struct update_geometry;
+    struct monitors_changed;
   }  // namespace ui
   namespace ui_tray {
     struct mapped_clients;
   }
-  namespace parser {
-    struct change_background;
-    struct change_foreground;
-    struct change_underline;
-    struct change_overline;
-    struct change_font;
-    struct change_alignment;
-    struct reverse_colors;
-    struct offset_pixel;
-    struct attribute_set;
-    struct attribute_unset;
-    struct attribute_toggle;
-    struct action_begin;
-    struct action_end;
-    struct text;
-    struct control;
-  }  // namespace parser
 }  // namespace signals
 
 POLYBAR_NS_END
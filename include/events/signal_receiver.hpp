@@ -2,8 +2,6 @@
 
 #include <map>
 #include <unordered_map>
-#include <typeindex>
-#include <typeinfo>
 
 #include "common.hpp"
 
@@ -12,11 +10,8 @@ POLYBAR_NS
 class signal_receiver_interface {
  public:
   using prio = int;
-  using prio_map = std::multimap<prio, signal_receiver_interface*>;
   virtual ~signal_receiver_interface() {}
   virtual prio priority() const = 0;
-  template <typename Signal>
-  bool on(const Signal& signal);
 };
 
 template <typename Signal>
@@ -26,17 +21,6 @@ class signal_receiver_impl {
   virtual bool on(const Signal&) = 0;
 };
 
-template <typename Signal>
-bool signal_receiver_interface::on(const Signal& s) {
-  auto event_sink = dynamic_cast<signal_receiver_impl<Signal>*>(this);
-
-  if (event_sink != nullptr && event_sink->on(s)) {
-    return true;
-  } else {
-    return false;
-  }
-}
-
 template <int Priority, typename Signal, typename... Signals>
 class signal_receiver : public signal_receiver_interface,
                         public signal_receiver_impl<Signal>,
@@ -47,6 +31,19 @@ class signal_receiver : public signal_receiver_interface,
   }
 };
 
-using signal_receivers_t = std::unordered_map<std::type_index, signal_receiver_interface::prio_map>;
+/**
+ * \brief Receivers attached for a single signal type, ordered by priority
+ *
+ * Every signal type has its own list, so emitting a signal neither looks up
+ * its receivers nor casts them to the handler for the signal.
+ */
+template <typename Signal>
+struct signal_receivers {
+  using entry = pair<signal_receiver_interface::prio, signal_receiver_impl<Signal>*>;
+  static vector<entry> list;
+};
+
+template <typename Signal>
+vector<typename signal_receivers<Signal>::entry> signal_receivers<Signal>::list{};
 
 POLYBAR_NS_END
@@ -23,11 +23,12 @@ namespace modules {
     explicit alsa_module(const bar_settings&, string);
 
     void teardown();
+    vector<int> event_fds() const;
     bool has_event();
     bool update();
     string get_format() const;
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/alsa";
 
@@ -56,6 +57,8 @@ namespace modules {
 
     map<mixer, mixer_t> m_mixer;
     map<control, control_t> m_ctrl;
+    // poll descriptors of all mixers and controls
+    vector<int> m_fds;
     int m_headphoneid{0};
     bool m_mapped{false};
     int m_interval{5};
@@ -1,20 +1,26 @@
 #pragma once
 
+#include <condition_variable>
+
 #include "components/config.hpp"
-#include "modules/meta/inotify_module.hpp"
+#include "modules/meta/event_module.hpp"
 #include "settings.hpp"
+#include "utils/file.hpp"
 
 POLYBAR_NS
 
 namespace modules {
-  class backlight_module : public inotify_module<backlight_module> {
+  class backlight_module : public event_module<backlight_module> {
    public:
+    /**
+     * Sysfs file with a brightness value, the descriptor stays open
+     */
     struct brightness_handle {
       void filepath(const string& path);
       float read() const;
 
      private:
-      string m_path;
+      unique_ptr<reread_file> m_file;
     };
 
     string get_output();
@@ -22,9 +28,12 @@ namespace modules {
    public:
     explicit backlight_module(const bar_settings&, string);
 
+    void teardown();
+    vector<int> event_fds() const;
+    bool has_event();
+    bool update();
     void idle();
-    bool on_event(inotify_event* event);
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/backlight";
 
@@ -35,6 +44,9 @@ namespace modules {
     bool input(const string& action, const string& data);
 
    private:
+    bool receive_uevents();
+    void write_brightness();
+
     static constexpr auto TAG_LABEL = "<label>";
     static constexpr auto TAG_BAR = "<bar>";
     static constexpr auto TAG_RAMP = "<ramp>";
@@ -43,13 +55,29 @@ namespace modules {
     label_t m_label;
     progressbar_t m_progressbar;
     string m_path_backlight;
+    string m_card;
     float m_max_brightness;
     bool m_scroll{false};
 
     brightness_handle m_val;
     brightness_handle m_max;
 
-    int m_percentage = 0;
+    // Kernel uevents of the backlight device, it is polled if they aren't available
+    unique_ptr<file_descriptor> m_uevents;
+
+    // -1 until the first update
+    std::atomic<int> m_percentage{-1};
+
+    /*
+     * Scrolling changes the target percentage, it is written by a worker.
+     * Changes made before the worker gets to it are written at once.
+     */
+    std::mutex m_writelock;
+    std::condition_variable m_written;
+    unique_ptr<file_descriptor> m_brightness;
+    // -1 if the next change is relative to the current percentage
+    int m_target{-1};
+    bool m_write_queued{false};
   };
 }  // namespace modules
 
@@ -1,12 +1,24 @@
 #pragma once
 
 #include "common.hpp"
-#include "modules/meta/inotify_module.hpp"
+#include "modules/meta/event_module.hpp"
+#include "utils/file.hpp"
 
 POLYBAR_NS
 
 namespace modules {
-  class battery_module : public inotify_module<battery_module> {
+  /**
+   * Module that shows the state of one or more batteries
+   *
+   * Several batteries are shown as one: their energy and power are summed
+   * up and they are charging if the adapter is online or any of them is.
+   *
+   * The values are read again whenever the kernel announces a change of
+   * the battery or adapter through a uevent, and at least every
+   * `poll-interval` since not every driver sends them. Animations are driven
+   * by a timer, both descriptors are served by the reactor.
+   */
+  class battery_module : public event_module<battery_module> {
    public:
     enum class state {
       NONE = 0,
@@ -45,25 +57,55 @@ namespace modules {
     using rate_reader = mutex_wrapper<value_reader<unsigned long /* seconds */>>;
     using consumption_reader = mutex_wrapper<value_reader<string /* watts */>>;
 
+    /**
+     * \brief Files of one battery
+     */
+    struct battery_files {
+      string name;
+      unique_ptr<reread_file> status;
+      unique_ptr<reread_file> capacity_now;
+      unique_ptr<reread_file> capacity_full;
+      unique_ptr<reread_file> rate;
+      unique_ptr<reread_file> voltage;
+      // charge_* in µAh instead of energy_* in µWh
+      bool charge{false};
+      // current_now in µA instead of power_now in µW
+      bool current{false};
+    };
+
+    /**
+     * \brief Values of all batteries, read once per update
+     */
+    struct battery_sample {
+      bool charging{false};
+      unsigned long long energy_now{0ULL};   // µWh
+      unsigned long long energy_full{0ULL};  // µWh
+      unsigned long long power{0ULL};        // µW
+    };
+
    public:
     explicit battery_module(const bar_settings&, string);
 
-    void start();
     void teardown();
-    void idle();
-    bool on_event(inotify_event* event);
+
+    vector<int> event_fds() const;
+    bool has_event();
+    bool update();
     string get_format() const;
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/battery";
 
    protected:
+    void sample();
     state current_state();
     int current_percentage();
     int clamp_percentage(int percentage, state state) const;
     string current_time();
     string current_consumption();
-    void subthread();
+    bool receive_uevents();
+    animation_t current_animation() const;
+    void update_animation();
 
    private:
     static constexpr const char* FORMAT_CHARGING{"format-charging"};
@@ -98,11 +140,12 @@ namespace modules {
     progressbar_t m_bar_capacity;
     ramp_t m_ramp_capacity;
 
-    string m_fstate;
-    string m_fcapnow;
-    string m_fcapfull;
-    string m_frate;
-    string m_fvoltage;
+    string m_adapter;
+    unique_ptr<reread_file> m_adapter_online;
+    vector<battery_files> m_batteries;
+    // All files of the adapter and the batteries
+    vector<reread_file*> m_sampled;
+    battery_sample m_sample;
 
     state m_state{state::DISCHARGING};
     int m_percentage{0};
@@ -110,10 +153,17 @@ namespace modules {
     int m_fullat{100};
     int m_lowat{10};
     string m_timeformat;
-    size_t m_unchanged{SKIP_N_UNCHANGED};
+    // The first update always refreshes the labels
+    size_t m_unchanged{0};
     chrono::duration<double> m_interval{};
-    chrono::system_clock::time_point m_lastpoll;
-    thread m_subthread;
+
+    unique_ptr<file_descriptor> m_uevents;
+    unique_ptr<file_descriptor> m_poll_timer;
+    bool m_values_due{true};
+
+    // The animation advanced by the animation clock
+    animation_t m_animated;
+    size_t m_animation_id{0};
   };
 }  // namespace modules
 
@@ -30,9 +30,18 @@ namespace modules {
       NODE_MARKED
     };
 
+    struct bspwm_workspace {
+      unsigned int mask{0U};
+      label_t label;
+      // what the label was made from, a workspace that is reported the same is not rebuilt
+      string name;
+      size_t index{0U};
+      bool dimmed{false};
+    };
+
     struct bspwm_monitor {
-      vector<pair<unsigned int, label_t>> workspaces;
-      vector<label_t> modes;
+      vector<bspwm_workspace> workspaces;
+      vector<pair<mode, label_t>> modes;
       label_t label;
       string name;
       bool focused{false};
@@ -41,11 +50,11 @@ namespace modules {
    public:
     explicit bspwm_module(const bar_settings&, string);
 
-    void stop();
+    int event_fd() const;
     bool has_event();
     bool update();
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/bspwm";
 
@@ -57,7 +66,8 @@ namespace modules {
     bool input(const string& action, const string& data);
 
    private:
-    bool handle_status(string& data);
+    bool handle_status(string data);
+    label_t make_workspace_label(unsigned int mask, const string& name, size_t index, bool dimmed) const;
 
     static constexpr auto DEFAULT_ICON = "ws-icon-default";
     static constexpr auto DEFAULT_LABEL = "%icon% %name%";
@@ -67,7 +77,11 @@ namespace modules {
     static constexpr auto TAG_LABEL_STATE = "<label-state>";
     static constexpr auto TAG_LABEL_MODE = "<label-mode>";
 
-    bspwm_util::connection_t m_subscriber;
+    /**
+     * Reports are read once for all bspwm modules
+     */
+    unique_ptr<bspwm_util::hub::subscription> m_events;
+    bspwm_util::hub::model m_report;
 
     vector<unique_ptr<bspwm_monitor>> m_monitors;
 
@@ -86,7 +100,6 @@ namespace modules {
     bool m_revscroll{true};
     bool m_pinworkspaces{true};
     bool m_inlinemode{false};
-    string_util::hash_type m_hash{0U};
     bool m_fuzzy_match{false};
 
     // used while formatting output
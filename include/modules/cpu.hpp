@@ -2,11 +2,14 @@
 
 #include "modules/meta/timer_module.hpp"
 #include "settings.hpp"
+#include "utils/file.hpp"
+#include "utils/history.hpp"
 
 POLYBAR_NS
 
 namespace modules {
   enum class cpu_state { NORMAL = 0, WARN };
+  enum class coreload_group { CORE = 0, NODE, PACKAGE };
   struct cpu_time {
     unsigned long long user;
     unsigned long long nice;
@@ -14,9 +17,10 @@ namespace modules {
     unsigned long long idle;
     unsigned long long steal;
     unsigned long long total;
+    unsigned int id;
   };
 
-  using cpu_time_t = unique_ptr<cpu_time>;
+  using cpu_times = vector<cpu_time>;
 
   class cpu_module : public timer_module<cpu_module> {
    public:
@@ -24,13 +28,15 @@ namespace modules {
 
     bool update();
     string get_format() const;
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/cpu";
 
    protected:
     bool read_values();
     float get_load(size_t core) const;
+    void read_topology();
+    void update_coreloads();
 
    private:
     static constexpr auto TAG_LABEL = "<label>";
@@ -38,6 +44,7 @@ namespace modules {
     static constexpr auto TAG_BAR_LOAD = "<bar-load>";
     static constexpr auto TAG_RAMP_LOAD = "<ramp-load>";
     static constexpr auto TAG_RAMP_LOAD_PER_CORE = "<ramp-coreload>";
+    static constexpr auto TAG_GRAPH_LOAD = "<graph-load>";
     static constexpr auto FORMAT_WARN = "format-warn";
 
 
@@ -48,12 +55,39 @@ namespace modules {
     ramp_t m_rampload_core;
     int m_ramp_padding;
 
-    vector<cpu_time_t> m_cputimes;
-    vector<cpu_time_t> m_cputimes_prev;
+    coreload_group m_grouping{coreload_group::CORE};
+    size_t m_top{0};
+    size_t m_histogram{0};
+
+    /**
+     * Group index by cpu id, only used when the cores are grouped
+     */
+    vector<size_t> m_cpu_group;
+    size_t m_groups{0};
+    vector<size_t> m_group_cores;
+
+    /**
+     * The values shown by <ramp-coreload>
+     */
+    vector<float> m_coreloads;
+    vector<float> m_buckets;
+
+    unique_ptr<reread_file> m_stat;
+    size_t m_cores{0};
+
+    shared_ptr<const cpu_times> m_cputimes;
+    shared_ptr<const cpu_times> m_cputimes_prev;
 
     float m_totalwarn = 80;
     float m_total = 0;
     vector<float> m_load;
+
+    /**
+     * Total load of the last updates, only kept if <graph-load> or one of
+     * the %percentage-avg|min|max% tokens is used
+     */
+    sample_history<float> m_history;
+    int m_graph_width{60};
   };
 }  // namespace modules
 
@@ -1,20 +1,31 @@
 #pragma once
 
+#include <clocale>
 #include <ctime>
-#include <iomanip>
-#include <iostream>
 
-#include "modules/meta/timer_module.hpp"
+#include "modules/meta/event_module.hpp"
+#include "utils/file.hpp"
 
 POLYBAR_NS
 
 namespace modules {
-  class date_module : public timer_module<date_module> {
+  /**
+   * Module that shows the current date and time
+   *
+   * The formats are checked once for the finest unit of time they show. A
+   * realtime timer wakes the module up when that unit rolls over, so a clock
+   * without seconds updates once a minute. Changes of the system clock cancel
+   * the timer, and the module updates right away.
+   */
+  class date_module : public event_module<date_module> {
    public:
     explicit date_module(const bar_settings&, string);
+    ~date_module();
 
+    int event_fd() const;
+    bool has_event();
     bool update();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/date";
 
@@ -29,6 +40,9 @@ namespace modules {
     // \deprecated: Use <label>
     static constexpr auto TAG_DATE = "<date>";
 
+    const string& format(const string& fmt, const std::tm& tm);
+    void arm(std::time_t deadline);
+
     label_t m_label;
 
     string m_dateformat;
@@ -39,8 +53,25 @@ namespace modules {
     string m_date;
     string m_time;
 
-    // Single stringstream to be used to gather the results of std::put_time
-    std::stringstream datetime_stream;
+    /**
+     * Length in seconds of the finest unit shown by the formats, or 0 for days
+     */
+    std::time_t m_resolution{1};
+    std::time_t m_resolution_alt{1};
+    std::time_t m_interval{1};
+
+    unique_ptr<file_descriptor> m_timer;
+
+    /**
+     * Reused by strftime, grown when a result doesn't fit
+     */
+    vector<char> m_buffer;
+    string m_formatted;
+
+    /**
+     * Locale for the names of days and months, the global one if unset
+     */
+    locale_t m_locale{static_cast<locale_t>(0)};
 
     std::atomic<bool> m_toggled{false};
   };
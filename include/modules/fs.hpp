@@ -1,8 +1,15 @@
 #pragma once
 
+#include <sys/statvfs.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
 #include "components/config.hpp"
 #include "modules/meta/timer_module.hpp"
 #include "settings.hpp"
+#include "utils/file.hpp"
 
 POLYBAR_NS
 
@@ -13,6 +20,7 @@ namespace modules {
   struct fs_mount {
     string mountpoint;
     bool mounted = false;
+    bool responsive = true;
 
     string type;
     string fsname;
@@ -30,6 +38,25 @@ namespace modules {
 
   using fs_mount_t = unique_ptr<fs_mount>;
 
+  /**
+   * statvfs() call that runs on its own thread, so that a hung mount can't block the module
+   */
+  struct fs_query {
+    std::mutex lock;
+    std::condition_variable finished;
+    bool done{false};
+    int error{0};
+    struct statvfs result {};
+  };
+
+  /**
+   * Columns of a line in /proc/self/mountinfo that are used
+   */
+  struct mountinfo_entry {
+    string type;
+    string fsname;
+  };
+
   /**
    * Module used to display filesystem stats.
    */
@@ -40,16 +67,22 @@ namespace modules {
     bool update();
     string get_format() const;
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/fs";
 
+   protected:
+    void update_mountinfo();
+    shared_ptr<fs_query> query(const string& mountpoint);
+
    private:
     static constexpr auto FORMAT_MOUNTED = "format-mounted";
     static constexpr auto FORMAT_WARN = "format-warn";
     static constexpr auto FORMAT_UNMOUNTED = "format-unmounted";
+    static constexpr auto FORMAT_UNRESPONSIVE = "format-unresponsive";
     static constexpr auto TAG_LABEL_MOUNTED = "<label-mounted>";
     static constexpr auto TAG_LABEL_UNMOUNTED = "<label-unmounted>";
+    static constexpr auto TAG_LABEL_UNRESPONSIVE = "<label-unresponsive>";
     static constexpr auto TAG_LABEL_WARN = "<label-warn>";
     static constexpr auto TAG_BAR_USED = "<bar-used>";
     static constexpr auto TAG_BAR_FREE = "<bar-free>";
@@ -57,6 +90,7 @@ namespace modules {
 
     label_t m_labelmounted;
     label_t m_labelunmounted;
+    label_t m_labelunresponsive;
     label_t m_labelwarn;
     progressbar_t m_barused;
     progressbar_t m_barfree;
@@ -64,6 +98,21 @@ namespace modules {
 
     vector<string> m_mountpoints;
     vector<fs_mount_t> m_mounts;
+
+    /**
+     * Configured mountpoints that are mounted, only parsed again when the
+     * mount table changed
+     */
+    std::unordered_map<string, mountinfo_entry> m_mountinfo;
+    unique_ptr<reread_file> m_mountinfo_file;
+    bool m_mountinfo_valid{false};
+
+    /**
+     * Queries that didn't finish in time, no new query is started for their
+     * mountpoint until they do
+     */
+    std::unordered_map<string, shared_ptr<fs_query>> m_queries;
+    chrono::milliseconds m_timeout{1000};
     bool m_fixed{false};
     bool m_remove_unmounted{false};
     int m_spacing{2};
@@ -13,17 +13,17 @@ namespace modules {
   class github_module : public timer_module<github_module> {
    public:
     explicit github_module(const bar_settings&, string);
+    ~github_module();
 
     bool update();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
     string get_format() const;
 
     static constexpr auto TYPE = "internal/github";
 
    private:
     void update_label(int);
-    int get_number_of_notification();
-    string request();
+    void on_response(http_response&& response, size_t notifications);
     static constexpr auto TAG_LABEL = "<label>";
     static constexpr auto TAG_LABEL_OFFLINE = "<label-offline>";
     static constexpr auto FORMAT_OFFLINE = "format-offline";
@@ -33,9 +33,15 @@ namespace modules {
     string m_api_url;
     string m_user;
     string m_accesstoken{};
-    unique_ptr<http_downloader> m_http{};
     bool m_empty_notifications{false};
     std::atomic<bool> m_offline{false};
+
+    // Set while a request is on its way
+    http_client::transfer_id m_transfer{0};
+    // Sent as If-Modified-Since, unchanged notifications are answered with 304
+    string m_last_modified;
+    // Earliest time for the next request, as asked for by X-Poll-Interval
+    chrono::steady_clock::time_point m_next_poll;
   };
 }  // namespace modules
 
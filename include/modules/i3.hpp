@@ -46,10 +46,10 @@ namespace modules {
    public:
     explicit i3_module(const bar_settings&, string);
 
-    void stop();
+    int event_fd() const;
     bool has_event();
     bool update();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/i3";
 
@@ -92,7 +92,11 @@ namespace modules {
     bool m_strip_wsnumbers{false};
     bool m_fuzzy_match{false};
 
-    unique_ptr<i3_util::connection_t> m_ipc;
+    /**
+     * Events are read once for all i3 modules and handed out as states
+     */
+    unique_ptr<i3_util::hub::subscription> m_events;
+    i3_util::hub::model m_state;
   };
 }  // namespace modules
 
@@ -11,6 +11,9 @@ namespace modules {
    * received ipc messages. The hook will execute the defined
    * shell script and the resulting output will be used
    * as the module content.
+   *
+   * The content can also be set directly with `content:` messages, which
+   * doesn't spawn any process.
    */
   class ipc_module : public static_module<ipc_module> {
    public:
@@ -29,8 +32,9 @@ namespace modules {
     void start();
     void update() {}
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
     void on_message(const string& message);
+    void on_content(string content);
 
     static constexpr auto TYPE = "custom/ipc";
 
@@ -40,6 +44,7 @@ namespace modules {
     map<mousebtn, string> m_actions;
     string m_output;
     size_t m_initial;
+    bool m_content_tags;
   };
 }  // namespace modules
 
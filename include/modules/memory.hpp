@@ -2,22 +2,55 @@
 
 #include "modules/meta/timer_module.hpp"
 #include "settings.hpp"
+#include "utils/file.hpp"
+#include "utils/history.hpp"
 
 POLYBAR_NS
 
 namespace modules {
   enum class memtype { NONE = 0, TOTAL, USED, FREE, SHARED, BUFFERS, CACHE, AVAILABLE };
   enum class memory_state { NORMAL = 0, WARN };
+
+  /**
+   * \brief The fields of /proc/meminfo that are used, in KiB
+   */
+  struct meminfo_t {
+    unsigned long long total{0};
+    unsigned long long free{0};
+    unsigned long long available{0};
+    unsigned long long buffers{0};
+    unsigned long long cached{0};
+    unsigned long long sreclaimable{0};
+    unsigned long long shmem{0};
+    unsigned long long swap_total{0};
+    unsigned long long swap_free{0};
+
+    // Whether the kernel reports MemAvailable
+    bool has_available{false};
+  };
+
+  /**
+   * \brief Share of the last 10 seconds in which some or all tasks stalled on memory, in percent
+   */
+  struct mempressure_t {
+    float some{0};
+    float full{0};
+  };
+
   class memory_module : public timer_module<memory_module> {
    public:
     explicit memory_module(const bar_settings&, string);
 
     bool update();
     string get_format() const;
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/memory";
 
+   protected:
+    meminfo_t read_meminfo();
+    mempressure_t read_pressure();
+
    private:
     static constexpr const char* TAG_LABEL{"<label>"};
     static constexpr const char* TAG_LABEL_WARN{"<label-warn>"};
@@ -29,6 +62,7 @@ namespace modules {
     static constexpr const char* TAG_BAR_SWAP_FREE{"<bar-swap-free>"};
     static constexpr const char* TAG_RAMP_SWAP_USED{"<ramp-swap-used>"};
     static constexpr const char* TAG_RAMP_SWAP_FREE{"<ramp-swap-free>"};
+    static constexpr const char* TAG_GRAPH_USED{"<graph-used>"};
     static constexpr const char* FORMAT_WARN{"format-warn"};
 
     label_t m_label;
@@ -46,6 +80,16 @@ namespace modules {
     int m_perc_swap_free{0};
     ramp_t m_ramp_swapused;
     ramp_t m_ramp_swapfree;
+
+    /**
+     * Used memory of the last updates in percent, only kept if <graph-used>
+     * or one of the %percentage_used_avg|min|max% tokens is used
+     */
+    sample_history<int> m_history;
+    int m_graph_width{60};
+
+    unique_ptr<reread_file> m_meminfo;
+    unique_ptr<reread_file> m_pressure;
   };
 }  // namespace modules
 
@@ -19,7 +19,9 @@ namespace modules {
    public:
     explicit menu_module(const bar_settings&, string);
 
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
+    string get_output();
+    shared_ptr<const tags::format_string> parse_output(const string& output);
     void update() {}
 
     static constexpr auto TYPE = "custom/menu";
@@ -44,6 +46,26 @@ namespace modules {
     vector<unique_ptr<menu_tree>> m_levels;
 
     std::atomic<int> m_level{-1};
+
+    struct cached_output {
+      string output;
+      // The output as published, including what the module adds around it
+      string published;
+      shared_ptr<const tags::format_string> elements;
+    };
+
+    /**
+     * Output of every level, the closed menu comes first
+     *
+     * The menus never change, so each one is only built and parsed the first
+     * time it is opened.
+     */
+    vector<cached_output> m_outputs;
+
+    /**
+     * Level that is being built, opening another one in the meantime doesn't affect it
+     */
+    int m_build_level{-1};
   };
 }  // namespace modules
 
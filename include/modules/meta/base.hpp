@@ -3,16 +3,23 @@
 #include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <map>
 #include <mutex>
 
 #include "common.hpp"
+#include "components/alloc_stats.hpp"
+#include "components/state_export.hpp"
+#include "components/stats.hpp"
+#include "components/tracer.hpp"
 #include "components/types.hpp"
 #include "errors.hpp"
+#include "tags/types.hpp"
 #include "utils/concurrency.hpp"
 #include "utils/functional.hpp"
 #include "utils/inotify.hpp"
 #include "utils/string.hpp"
+#include "utils/throttle.hpp"
 POLYBAR_NS
 
 namespace chrono = std::chrono;
@@ -24,6 +31,12 @@ using std::map;
 #define CONST_MOD(name) static_cast<name const&>(*this)
 #define CAST_MOD(name) static_cast<name*>(this)
 
+/**
+ * Id of the given tag name as a compile time constant, for comparing it with
+ * the module_tag passed to build()
+ */
+#define TAG_ID(name) std::integral_constant<modules::tag_id, modules::make_tag_id(name)>::value
+
 // fwd decl {{{
 
 namespace drawtypes {
@@ -51,10 +64,64 @@ namespace modules {
   DEFINE_CHILD_ERROR(undefined_format, module_error);
   DEFINE_CHILD_ERROR(undefined_format_tag, module_error);
 
+  /**
+   * Modules that exceed their budget publish at most once per interval
+   */
+  constexpr chrono::milliseconds THROTTLED_INTERVAL{250};
+
+  // class definition : module_tag {{{
+
+  using tag_id = uint64_t;
+
+  /**
+   * FNV-1a hash of the tag name
+   */
+  constexpr tag_id make_tag_id(const char* name, tag_id hash = 14695981039346656037ULL) {
+    return *name == '\0' ? hash : make_tag_id(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 1099511628211ULL);
+  }
+
+  /**
+   * Tag of a format, e.g. `<label>`
+   *
+   * The id is calculated once when the format is added, so build() can
+   * compare it with TAG_ID(TAG_LABEL) instead of comparing strings.
+   */
+  struct module_tag {
+    tag_id id{0};
+    string name{};
+
+    bool operator==(tag_id other) const {
+      return id == other;
+    }
+
+    operator const string&() const {
+      return name;
+    }
+  };
+
+  // }}}
   // class definition : module_format {{{
 
   struct module_format {
+    /**
+     * Text or tag of the format value, split up once when the format is added
+     */
+    struct segment {
+      bool is_tag{false};
+      module_tag tag{};
+      string value{};
+      /**
+       * Text with leading spaces removed, used while no tag has been built yet
+       */
+      string trimmed{};
+    };
+
     string value{};
+    vector<segment> segments{};
+    /**
+     * Text after the last tag
+     */
+    string trailer{};
     vector<string> tags{};
     label_t prefix{};
     label_t suffix{};
@@ -71,6 +138,7 @@ namespace modules {
     int font{0};
 
     string decorate(builder* builder, string output);
+    void compile();
   };
 
   // }}}
@@ -93,10 +161,13 @@ namespace modules {
     const config& m_conf;
     string m_modname;
     map<string, shared_ptr<module_format>> m_formats;
+    map<tag_id, string> m_tag_ids;
   };
 
   // }}}
 
+  tags::reserved_width load_reserved_width(const config& conf, const string& section);
+
   // class definition : module_interface {{{
 
   struct module_interface {
@@ -115,6 +186,11 @@ namespace modules {
     virtual string name() const = 0;
     virtual bool running() const = 0;
 
+    /**
+     * Counter that is incremented whenever new output is published
+     */
+    virtual size_t generation() const = 0;
+
     /**
      * Handle action, possibly with data attached
      *
@@ -128,7 +204,18 @@ namespace modules {
     virtual void start() = 0;
     virtual void stop() = 0;
     virtual void halt(string error_message) = 0;
+
+    /**
+     * Last published output, never blocks on the module
+     */
     virtual string contents() = 0;
+
+    /**
+     * Last published output in parsed form, never blocks on the module
+     *
+     * The output is parsed once when it is published, not every time it is drawn
+     */
+    virtual shared_ptr<const tags::format_string> elements() = 0;
   };
 
   // }}}
@@ -137,7 +224,7 @@ namespace modules {
   template <class Impl>
   class module : public module_interface {
    public:
-    module(const bar_settings bar, string name);
+    module(const bar_settings& bar, string name);
     ~module() noexcept;
 
     string type() const;
@@ -145,15 +232,19 @@ namespace modules {
     string name_raw() const;
     string name() const;
     bool running() const;
+    size_t generation() const;
     void stop();
     void halt(string error_message);
     void teardown();
     string contents();
+    shared_ptr<const tags::format_string> elements();
 
     bool input(const string& action, const string& data);
 
    protected:
     void broadcast();
+    void rebuild_and_broadcast();
+    void publish();
     void idle();
     void sleep(chrono::duration<double> duration);
     template <class Clock, class Duration>
@@ -161,10 +252,43 @@ namespace modules {
     void wakeup();
     string get_format() const;
     string get_output();
+    shared_ptr<const tags::format_string> parse_output(const string& output);
+    void export_values(state_export::values&& values, bool update);
+    bool watch_fd(int fd, unsigned int events, function<void(int fd)> callback);
+    void unwatch_fd(int fd);
+
+    /**
+     * Records the time spent in an update, it counts towards the stats and the budget
+     *
+     * Heap allocations made during the update are attributed to the module and
+     * the update is recorded as a trace span
+     */
+    class update_timer {
+     public:
+      explicit update_timer(module& m)
+          : m_module(m), m_tag(m.m_alloc_tag), m_span(m.m_trace_update), m_start(histogram::clock::now()) {}
+      update_timer(const update_timer&) = delete;
+      update_timer& operator=(const update_timer&) = delete;
+
+      ~update_timer() {
+        m_module.export_values(m_capture.take(), true);
+        auto elapsed = histogram::clock::now() - m_start;
+        m_module.m_update_stats.record(elapsed);
+        std::lock_guard<std::mutex> guard(m_module.m_budgetlock);
+        m_module.m_budget.spend(elapsed);
+      }
+
+     private:
+      module& m_module;
+      scoped_alloc_tag m_tag;
+      tracer::span m_span;
+      histogram::clock::time_point m_start;
+      state_export::capture m_capture;
+    };
 
    protected:
     signal_emitter& m_sig;
-    const bar_settings m_bar;
+    const bar_settings& m_bar;
     const logger& m_log;
     const config& m_conf;
 
@@ -182,10 +306,94 @@ namespace modules {
 
     bool m_handle_events{true};
 
+    /**
+     * Time spent producing new data and formatting it
+     */
+    histogram& m_update_stats;
+    histogram& m_output_stats;
+
+    /**
+     * Heap allocations of updates and outputs are attributed to this tag
+     */
+    alloc_tag m_alloc_tag;
+
+    /**
+     * Names of the trace spans of updates and outputs
+     */
+    const char* m_trace_update;
+    const char* m_trace_output;
+
    private:
+    bool over_budget();
+
     atomic<bool> m_enabled{true};
-    atomic<bool> m_changed{true};
-    string m_cache;
+    atomic<size_t> m_generation{0};
+
+    /**
+     * Descriptors registered on the reactor, they are removed when the module stops
+     */
+    mutex m_fdlock;
+    vector<int> m_fds;
+
+    /**
+     * Set while a rebuild is queued that hasn't started yet
+     */
+    atomic<bool> m_rebuild_queued{false};
+
+    /**
+     * Rebuilds that were handed to the workers and haven't finished yet
+     */
+    mutex m_rebuildlock;
+    size_t m_rebuilds_pending{0};
+    std::condition_variable m_rebuilt;
+
+    /**
+     * Outputs per second and time spent in updates per second the module may
+     * use. Modules that exceed it are throttled until they are back within it.
+     */
+    mutex m_budgetlock;
+    throttle_util::budget m_budget;
+    bool m_throttled{false};
+
+    /**
+     * Tokens replaced by the last update and the last build, for the state file
+     */
+    mutex m_exportlock;
+    std::map<string, string> m_exported_update;
+    std::map<string, string> m_exported_build;
+
+    /**
+     * Serializes building and publishing so that newer output is never
+     * replaced by older output
+     */
+    mutex m_publishlock;
+
+    /**
+     * Immutable output, swapped atomically so that contents() only loads a pointer
+     */
+    shared_ptr<const string> m_output;
+
+    /**
+     * Parsed m_output, published before it
+     */
+    shared_ptr<const tags::format_string> m_elements;
+
+    /**
+     * Hash of m_output, guarded by m_publishlock
+     */
+    size_t m_output_hash{0};
+
+    /**
+     * Output from the `placeholder` label, shown until the first output is
+     * published. Set during construction and never changed.
+     */
+    shared_ptr<const string> m_placeholder;
+    shared_ptr<const tags::format_string> m_placeholder_elements;
+
+    /**
+     * Space reserved for the output, so that changes of its width don't move other modules
+     */
+    tags::reserved_width m_width;
   };
 
   // }}}
@@ -1,9 +1,14 @@
 #include "components/builder.hpp"
 #include "components/config.hpp"
 #include "components/logger.hpp"
+#include "components/reactor.hpp"
+#include "components/scheduler.hpp"
+#include "components/startup_profile.hpp"
+#include "drawtypes/label.hpp"
 #include "events/signal.hpp"
 #include "events/signal_emitter.hpp"
 #include "modules/meta/base.hpp"
+#include "tags/dispatch.hpp"
 
 POLYBAR_NS
 
@@ -11,7 +16,7 @@ namespace modules {
   // module<Impl> public {{{
 
   template <typename Impl>
-  module<Impl>::module(const bar_settings bar, string name)
+  module<Impl>::module(const bar_settings& bar, string name)
       : m_sig(signal_emitter::make())
       , m_bar(bar)
       , m_log(logger::make())
@@ -20,12 +25,37 @@ namespace modules {
       , m_name_raw(name)
       , m_builder(make_unique<builder>(bar))
       , m_formatter(make_unique<module_formatter>(m_conf, m_name))
-      , m_handle_events(m_conf.get(m_name, "handle-events", true)) {}
+      , m_handle_events(m_conf.get(m_name, "handle-events", true))
+      , m_update_stats(stats::make().get(m_name + ".update"))
+      , m_output_stats(stats::make().get(m_name + ".output"))
+      , m_alloc_tag(alloc_stats::tag(m_name))
+      , m_trace_update(tracer::make().intern(m_name + ".update"))
+      , m_trace_output(tracer::make().intern(m_name + ".output"))
+      , m_budget(m_conf.get(m_name, "throttle-outputs", bar.max_fps),
+            chrono::milliseconds(m_conf.get(m_name, "throttle-update-time", 250)))
+      , m_width(load_reserved_width(m_conf, m_name)) {
+    // Modules whose first update takes a while (scripts, network requests) keep their space in the meantime
+    auto placeholder = drawtypes::load_optional_label(m_conf, m_name, "placeholder");
+    if (!placeholder->get().empty()) {
+      m_builder->reserve(m_width);
+      m_builder->node(placeholder);
+      m_builder->control(tags::controltag::R);
+      auto output = m_builder->flush();
+      m_placeholder_elements = make_shared<const tags::format_string>(tags::tokenize(m_log, output));
+      m_placeholder = make_shared<const string>(move(output));
+    }
+  }
 
   template <typename Impl>
   module<Impl>::~module() noexcept {
     m_log.trace("%s: Deconstructing", name());
 
+    // Queued rebuilds hold a pointer to the module
+    {
+      std::unique_lock<std::mutex> guard(m_rebuildlock);
+      m_rebuilt.wait(guard, [&] { return m_rebuilds_pending == 0; });
+    }
+
     for (auto&& thread_ : m_threads) {
       if (thread_.joinable()) {
         thread_.join();
@@ -56,6 +86,11 @@ namespace modules {
     return static_cast<bool>(m_enabled);
   }
 
+  template <typename Impl>
+  size_t module<Impl>::generation() const {
+    return m_generation;
+  }
+
   template <typename Impl>
   void module<Impl>::stop() {
     if (!static_cast<bool>(m_enabled)) {
@@ -64,6 +99,16 @@ namespace modules {
 
     m_log.info("%s: Stopping", name());
     m_enabled = false;
+    m_generation++;
+
+    {
+      // No callback is registered or invoked for the module once it's stopped
+      std::lock_guard<std::mutex> guard(m_fdlock);
+      for (int fd : m_fds) {
+        reactor::make().remove(fd);
+      }
+      m_fds.clear();
+    }
 
     std::lock(m_buildlock, m_updatelock);
     std::lock_guard<std::mutex> guard_a(m_buildlock, std::adopt_lock);
@@ -72,6 +117,11 @@ namespace modules {
       CAST_MOD(Impl)->wakeup();
       CAST_MOD(Impl)->teardown();
 
+      if (state_export::enabled()) {
+        state_export::make().remove(m_name_raw);
+      }
+
+      m_sig.emit(signals::eventqueue::module_stopped{string{m_name}});
       m_sig.emit(signals::eventqueue::check_state{});
     }
   }
@@ -88,19 +138,20 @@ namespace modules {
 
   template <typename Impl>
   string module<Impl>::contents() {
-    if (m_changed) {
-      m_log.info("%s: Rebuilding cache", name());
-      m_cache = CAST_MOD(Impl)->get_output();
-      // Make sure builder is really empty
-      m_builder->flush();
-      if (!m_cache.empty()) {
-        // Add a reset tag after the module
-        m_builder->control(tags::controltag::R);
-        m_cache += m_builder->flush();
-      }
-      m_changed = false;
+    auto output = std::atomic_load(&m_output);
+    if (!output) {
+      output = m_placeholder;
     }
-    return m_cache;
+    return output ? *output : string{};
+  }
+
+  template <typename Impl>
+  shared_ptr<const tags::format_string> module<Impl>::elements() {
+    auto elements = std::atomic_load(&m_elements);
+    if (!elements) {
+      elements = m_placeholder_elements;
+    }
+    return elements ? elements : make_shared<const tags::format_string>();
   }
 
   template <typename Impl>
@@ -112,10 +163,137 @@ namespace modules {
   // }}}
   // module<Impl> protected {{{
 
+  /**
+   * Rebuild the output on a worker thread and notify the controller once it
+   * is published
+   *
+   * Callers may hold locks that get_output() needs, so the output is never
+   * built on the calling thread. Changes made while a rebuild is queued are
+   * picked up by that rebuild.
+   */
   template <typename Impl>
   void module<Impl>::broadcast() {
-    m_changed = true;
-    m_sig.emit(signals::eventqueue::notify_change{});
+    // Every broadcast counts, so that a throttled module stays throttled while it keeps flooding
+    bool throttled = over_budget();
+
+    if (m_rebuild_queued.exchange(true)) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(m_rebuildlock);
+      m_rebuilds_pending++;
+    }
+
+    auto rebuild = [this] {
+      m_rebuild_queued = false;
+      publish();
+
+      std::lock_guard<std::mutex> guard(m_rebuildlock);
+      m_rebuilds_pending--;
+      m_rebuilt.notify_all();
+    };
+
+    if (throttled) {
+      // Everything that changes until then is part of the delayed rebuild
+      scheduler::make().defer(THROTTLED_INTERVAL, move(rebuild));
+    } else {
+      scheduler::make().submit(move(rebuild));
+    }
+  }
+
+  /**
+   * Same as broadcast(), but the output is rebuilt on the calling thread
+   *
+   * Only for callers that don't hold any of the module's locks
+   */
+  template <typename Impl>
+  void module<Impl>::rebuild_and_broadcast() {
+    publish();
+  }
+
+  /**
+   * Build the output, swap it in and notify the controller
+   *
+   * Nothing is published if the output is the same as the last one
+   */
+  template <typename Impl>
+  void module<Impl>::publish() {
+    {
+      std::lock_guard<std::mutex> guard(m_publishlock);
+      if (!running()) {
+        return;
+      }
+
+      m_log.info("%s: Rebuilding cache", name());
+
+      string output;
+      try {
+        scoped_timer timer{m_output_stats};
+        scoped_alloc_tag tag{m_alloc_tag};
+        POLYBAR_TRACE(m_trace_output);
+        state_export::capture capture;
+        output = CAST_MOD(Impl)->get_output();
+        export_values(capture.take(), false);
+        // Make sure builder is really empty
+        m_builder->flush();
+        if (!output.empty()) {
+          // The reserved space ends with the reset tag after the module
+          if (m_width.width > 0) {
+            m_builder->reserve(m_width);
+            output.insert(0, m_builder->flush());
+          }
+          m_builder->control(tags::controltag::R);
+          output += m_builder->flush();
+        }
+      } catch (const exception& err) {
+        m_log.err("%s: Failed to build output (err: %s)", name(), err.what());
+        return;
+      }
+
+      // Most periodic updates produce the same output, those don't need a redraw
+      size_t hash = std::hash<string>{}(output);
+      auto previous = std::atomic_load(&m_output);
+      if (previous && hash == m_output_hash && *previous == output) {
+        m_log.trace("%s: Output unchanged", name());
+        return;
+      }
+
+      std::atomic_store(&m_elements, CAST_MOD(Impl)->parse_output(output));
+      std::atomic_store(&m_output, shared_ptr<const string>{make_shared<const string>(move(output))});
+      m_output_hash = hash;
+
+      if (m_generation++ == 0) {
+        startup_profile::make().mark(m_name + " first output");
+      }
+    }
+
+    m_sig.emit(signals::eventqueue::notify_change{string{m_name}});
+  }
+
+  /**
+   * Count a broadcast towards the budget
+   *
+   * \returns true if the module exceeds its budget and has to be throttled
+   */
+  template <typename Impl>
+  bool module<Impl>::over_budget() {
+    std::lock_guard<std::mutex> guard(m_budgetlock);
+    m_budget.event();
+
+    bool exceeded = m_budget.exceeded();
+    if (exceeded != m_throttled) {
+      m_throttled = exceeded;
+      if (exceeded) {
+        m_log.warn("%s: Exceeded its budget of %lu outputs or %lims of updates per second, throttling it to %lu outputs per second",
+            name(), m_budget.max_events(), static_cast<long>(m_budget.max_busy().count()),
+            static_cast<size_t>(1s / THROTTLED_INTERVAL));
+      } else {
+        m_log.info("%s: Back within its budget, no longer throttled", name());
+      }
+    }
+
+    return m_throttled;
   }
 
   template <typename Impl>
@@ -153,53 +331,110 @@ namespace modules {
     return DEFAULT_FORMAT;
   }
 
+  /**
+   * Elements of the given output
+   *
+   * Modules that show the same few outputs over and over can keep the
+   * elements instead of parsing the output again.
+   */
+  template <typename Impl>
+  shared_ptr<const tags::format_string> module<Impl>::parse_output(const string& output) {
+    return make_shared<const tags::format_string>(tags::tokenize(m_log, output));
+  }
+
+  /**
+   * Replace the tokens of the last update or build in the state file
+   *
+   * Tokens that the last update and build didn't replace are dropped, the
+   * ones replaced while building win over the ones of the update.
+   */
+  template <typename Impl>
+  void module<Impl>::export_values(state_export::values&& values, bool update) {
+    std::lock_guard<std::mutex> guard(m_exportlock);
+    auto& current = update ? m_exported_update : m_exported_build;
+    if (values.empty() && current.empty()) {
+      return;
+    }
+
+    current.clear();
+    for (auto&& value : values) {
+      current[string_util::trim(move(value.first), '%')] = move(value.second);
+    }
+
+    std::map<string, string> exported{m_exported_update};
+    for (const auto& value : m_exported_build) {
+      exported[value.first] = value.second;
+    }
+    state_export::make().update(m_name_raw, exported);
+  }
+
+  /**
+   * Register a descriptor on the reactor for as long as the module runs
+   *
+   * The callback is not invoked once the module stopped.
+   *
+   * \returns false if the module already stopped
+   */
+  template <typename Impl>
+  bool module<Impl>::watch_fd(int fd, unsigned int events, function<void(int fd)> callback) {
+    std::lock_guard<std::mutex> guard(m_fdlock);
+    if (!running()) {
+      return false;
+    }
+
+    reactor::make().add(fd, events, [this, callback](int ready, unsigned int) {
+      if (running()) {
+        callback(ready);
+      }
+    });
+    if (std::find(m_fds.begin(), m_fds.end(), fd) == m_fds.end()) {
+      m_fds.emplace_back(fd);
+    }
+    return true;
+  }
+
+  template <typename Impl>
+  void module<Impl>::unwatch_fd(int fd) {
+    std::lock_guard<std::mutex> guard(m_fdlock);
+    m_fds.erase(std::remove(m_fds.begin(), m_fds.end(), fd), m_fds.end());
+    reactor::make().remove(fd);
+  }
+
   template <typename Impl>
   string module<Impl>::get_output() {
     std::lock_guard<std::mutex> guard(m_buildlock);
     auto format_name = CONST_MOD(Impl).get_format();
     auto format = m_formatter->get(format_name);
     bool no_tag_built{true};
-    bool fake_no_tag_built{false};
-    bool tag_built{false};
     auto mingap = std::max(1_z, format->spacing);
-    size_t start, end;
-    string value{format->value};
-    while ((start = value.find('<')) != string::npos && (end = value.find('>', start)) != string::npos) {
-      if (start > 0) {
+
+    for (const auto& segment : format->segments) {
+      if (!segment.is_tag) {
         if (no_tag_built) {
           // If no module tag has been built we do not want to add
           // whitespace defined between the format tags, but we do still
           // want to output other non-tag content
-          auto trimmed = string_util::ltrim(value.substr(0, start), ' ');
-          if (!trimmed.empty()) {
-            fake_no_tag_built = false;
-            m_builder->node(move(trimmed));
+          if (!segment.trimmed.empty()) {
+            m_builder->node(segment.trimmed);
           }
         } else {
-          m_builder->node(value.substr(0, start));
+          m_builder->node(segment.value);
         }
-        value.erase(0, start);
-        end -= start;
-        start = 0;
-      }
-      string tag{value.substr(start, end + 1)};
-      if (tag.empty()) {
         continue;
-      } else if (tag[0] == '<' && tag[tag.size() - 1] == '>') {
-        if (!no_tag_built)
-          m_builder->space(format->spacing);
-        else if (fake_no_tag_built)
-          no_tag_built = false;
-        if (!(tag_built = CONST_MOD(Impl).build(m_builder.get(), tag)) && !no_tag_built)
-          m_builder->remove_trailing_space(mingap);
-        if (tag_built)
-          no_tag_built = false;
       }
-      value.erase(0, tag.size());
+
+      if (!no_tag_built) {
+        m_builder->space(format->spacing);
+      }
+      if (CONST_MOD(Impl).build(m_builder.get(), segment.tag)) {
+        no_tag_built = false;
+      } else if (!no_tag_built) {
+        m_builder->remove_trailing_space(mingap);
+      }
     }
 
-    if (!value.empty()) {
-      m_builder->append(value);
+    if (!format->trailer.empty()) {
+      m_builder->append(format->trailer);
     }
 
     return format->decorate(&*m_builder, m_builder->flush());
@@ -13,6 +13,12 @@ namespace modules {
     virtual ~event_handler_interface() {}
     virtual void connect(connection&) {}
     virtual void disconnect(connection&) {}
+
+    /**
+     * Called once all pending X events were dispatched, so that handlers can
+     * do the work for a burst of events only once
+     */
+    virtual void events_handled() {}
   };
 
   template <typename Event, typename... Events>
@@ -21,12 +27,20 @@ namespace modules {
     virtual ~event_handler() {}
 
     virtual void connect(connection& conn) override {
-      conn.attach_sink(this, SINK_PRIORITY_MODULE);
+      conn.attach_sink(this, SINK_PRIORITY_MODULE, property_atoms());
     }
 
     virtual void disconnect(connection& conn) override {
       conn.detach_sink(this, SINK_PRIORITY_MODULE);
     }
+
+   protected:
+    /**
+     * Atoms of the PropertyNotify events the module handles, others are not dispatched for it
+     */
+    virtual vector<xcb_atom_t> property_atoms() const {
+      return {};
+    }
   };
 }
 
@@ -1,32 +1,78 @@
 #pragma once
 
+#include "components/reactor.hpp"
+#include "components/thread_policy.hpp"
 #include "modules/meta/base.hpp"
 
 POLYBAR_NS
 
 namespace modules {
+  /**
+   * Module that updates whenever has_event() signals new data.
+   *
+   * Modules whose events arrive on a file descriptor can expose it through
+   * event_fd(), or through event_fds() if there is more than one. Those
+   * modules are driven by the controller's reactor instead of polling
+   * has_event() from their own thread.
+   */
   template <class Impl>
   class event_module : public module<Impl> {
    public:
     using module<Impl>::module;
 
     void start() {
-      this->m_mainthread = thread(&event_module::runner, this);
+      if (CAST_MOD(Impl)->event_fds().empty()) {
+        this->m_mainthread = thread_policy::spawn(thread_policy::role::WORKER, [this] { runner(); });
+      } else {
+        this->m_mainthread = thread_policy::spawn(thread_policy::role::WORKER, [this] { attach(); });
+      }
+    }
+
+    void stop() {
+      // The event fds are removed from the reactor by the base
+      module<Impl>::stop();
     }
 
    protected:
+    /**
+     * File descriptor that becomes readable when has_event() may return true
+     *
+     * The default of -1 means the module has to be polled
+     */
+    int event_fd() const {
+      return -1;
+    }
+
+    /**
+     * File descriptors that become readable when has_event() may return true
+     *
+     * An empty list means the module has to be polled
+     */
+    vector<int> event_fds() const {
+      int fd = static_cast<const Impl*>(this)->event_fd();
+      return fd == -1 ? vector<int>{} : vector<int>{fd};
+    }
+
     void runner() {
       this->m_log.trace("%s: Thread id = %i", this->name(), concurrency_util::thread_id(this_thread::get_id()));
       try {
         // warm up module output before entering the loop
         std::unique_lock<std::mutex> guard(this->m_updatelock);
-        CAST_MOD(Impl)->update();
+        {
+          typename module<Impl>::update_timer timer{*this};
+          CAST_MOD(Impl)->update();
+        }
         CAST_MOD(Impl)->broadcast();
         guard.unlock();
 
         const auto check = [&]() -> bool {
           std::lock_guard<std::mutex> guard(this->m_updatelock);
-          return CAST_MOD(Impl)->has_event() && CAST_MOD(Impl)->update();
+          if (!CAST_MOD(Impl)->has_event()) {
+            return false;
+          }
+          // has_event() is allowed to block, so only update() is timed
+          typename module<Impl>::update_timer timer{*this};
+          return CAST_MOD(Impl)->update();
         };
 
         while (this->running()) {
@@ -39,7 +85,85 @@ namespace modules {
         CAST_MOD(Impl)->halt(err.what());
       }
     }
+
+    /**
+     * Warm up module output and hand the event fds over to the reactor
+     */
+    void attach() {
+      this->m_log.trace("%s: Thread id = %i", this->name(), concurrency_util::thread_id(this_thread::get_id()));
+      try {
+        std::unique_lock<std::mutex> guard(this->m_updatelock);
+        {
+          typename module<Impl>::update_timer timer{*this};
+          CAST_MOD(Impl)->update();
+        }
+        CAST_MOD(Impl)->broadcast();
+        guard.unlock();
+
+        if (this->running()) {
+          watch(CAST_MOD(Impl)->event_fds());
+        }
+      } catch (const exception& err) {
+        CAST_MOD(Impl)->halt(err.what());
+      }
+    }
+
+    void watch(vector<int> fds) {
+      for (int fd : fds) {
+        this->m_log.trace("%s: Watching event fd %i", this->name(), fd);
+        if (!this->watch_fd(fd, EPOLLIN, [this](int) { on_ready(); })) {
+          return;
+        }
+      }
+      m_watched_fds = move(fds);
+    }
+
+    void detach() {
+      for (int fd : m_watched_fds) {
+        this->unwatch_fd(fd);
+      }
+      m_watched_fds.clear();
+    }
+
+    /**
+     * Called by the reactor whenever one of the event fds is readable
+     */
+    void on_ready() {
+      if (!this->running()) {
+        return;
+      }
+
+      try {
+        bool changed{false};
+        {
+          std::lock_guard<std::mutex> guard(this->m_updatelock);
+          if (CAST_MOD(Impl)->has_event()) {
+            typename module<Impl>::update_timer timer{*this};
+            changed = CAST_MOD(Impl)->update();
+          }
+        }
+
+        if (changed) {
+          CAST_MOD(Impl)->broadcast();
+        }
+
+        // has_event() may have reconnected and thereby replaced the descriptors
+        auto fds = CAST_MOD(Impl)->event_fds();
+        if (this->running() && fds != m_watched_fds) {
+          detach();
+          if (fds.empty()) {
+            throw module_error("Lost connection to the event source");
+          }
+          watch(move(fds));
+        }
+      } catch (const exception& err) {
+        CAST_MOD(Impl)->halt(err.what());
+      }
+    }
+
+   private:
+    vector<int> m_watched_fds;
   };
-}
+}  // namespace modules
 
 POLYBAR_NS_END
@@ -1,26 +1,58 @@
 #pragma once
 
 #include "common.hpp"
+#include "modules/meta/base.hpp"
+#if ENABLE_MODULE_BACKLIGHT
 #include "modules/backlight.hpp"
+#endif
+#if ENABLE_MODULE_BATTERY
 #include "modules/battery.hpp"
+#endif
+#if ENABLE_MODULE_BSPWM
 #include "modules/bspwm.hpp"
+#endif
+#if ENABLE_MODULE_COUNTER
 #include "modules/counter.hpp"
+#endif
+#if ENABLE_MODULE_CPU
 #include "modules/cpu.hpp"
+#endif
+#if ENABLE_MODULE_DATE
 #include "modules/date.hpp"
+#endif
+#if ENABLE_MODULE_FS
 #include "modules/fs.hpp"
+#endif
+#if ENABLE_MODULE_IPC
 #include "modules/ipc.hpp"
+#endif
+#if ENABLE_MODULE_MEMORY
 #include "modules/memory.hpp"
+#endif
+#if ENABLE_MODULE_MENU
 #include "modules/menu.hpp"
-#include "modules/meta/base.hpp"
+#endif
+#if ENABLE_MODULE_SCRIPT
 #include "modules/script.hpp"
+#endif
 #if DEBUG
 #include "modules/systray.hpp"
 #endif
+#if ENABLE_MODULE_TEMPERATURE
 #include "modules/temperature.hpp"
+#endif
+#if ENABLE_MODULE_TEXT
 #include "modules/text.hpp"
+#endif
+#if ENABLE_MODULE_XBACKLIGHT
 #include "modules/xbacklight.hpp"
+#endif
+#if ENABLE_MODULE_XWINDOW
 #include "modules/xwindow.hpp"
+#endif
+#if ENABLE_MODULE_XWORKSPACES
 #include "modules/xworkspaces.hpp"
+#endif
 #if ENABLE_I3
 #include "modules/i3.hpp"
 #endif
@@ -49,63 +81,88 @@ POLYBAR_NS
 using namespace modules;
 
 namespace {
+  template <typename Module>
+  module_interface* create_module(const bar_settings& bar, string&& module_name) {
+    return new Module(bar, move(module_name));
+  }
+
+  /**
+   * \brief Module type that can be used in the config
+   *
+   * Types that were left out of the build are backed by the stubs in
+   * modules/unsupported.hpp, which fail with an error when they are created.
+   */
+  struct module_type {
+    const char* name;
+    module_interface* (*create)(const bar_settings&, string&&);
+    /*
+     * Whether the module uses the X connection while it is constructed
+     *
+     * Those modules share connection state that is not thread-safe, so they
+     * have to be created on the main thread.
+     */
+    bool main_thread;
+  };
+
+#define MODULE_TYPE(module, main_thread) \
+  { module::TYPE, &create_module<module>, main_thread }
+
+  const module_type module_types[]{
+      MODULE_TYPE(counter_module, false),
+      MODULE_TYPE(backlight_module, false),
+      MODULE_TYPE(battery_module, false),
+      MODULE_TYPE(bspwm_module, false),
+      MODULE_TYPE(cpu_module, false),
+      MODULE_TYPE(date_module, false),
+      MODULE_TYPE(github_module, false),
+      MODULE_TYPE(fs_module, false),
+      MODULE_TYPE(memory_module, false),
+      MODULE_TYPE(i3_module, false),
+      MODULE_TYPE(mpd_module, false),
+      MODULE_TYPE(alsa_module, false),
+      MODULE_TYPE(pulseaudio_module, false),
+      MODULE_TYPE(network_module, false),
+#if DEBUG
+      MODULE_TYPE(systray_module, true),
+#endif
+      MODULE_TYPE(temperature_module, false),
+      MODULE_TYPE(xbacklight_module, true),
+      MODULE_TYPE(xkeyboard_module, true),
+      MODULE_TYPE(xwindow_module, true),
+      MODULE_TYPE(xworkspaces_module, true),
+      MODULE_TYPE(text_module, false),
+      MODULE_TYPE(script_module, false),
+      MODULE_TYPE(menu_module, false),
+      MODULE_TYPE(ipc_module, false),
+  };
+
+#undef MODULE_TYPE
+
+  const module_type* find_module_type(const string& name) {
+    for (const auto& type : module_types) {
+      if (name == type.name) {
+        return &type;
+      }
+    }
+    return nullptr;
+  }
+
   module_interface* make_module(string&& name, const bar_settings& bar, string module_name, const logger& m_log) {
-    if (name == counter_module::TYPE) {
-      return new counter_module(bar, move(module_name));
-    } else if (name == backlight_module::TYPE) {
-      return new backlight_module(bar, move(module_name));
-    } else if (name == battery_module::TYPE) {
-      return new battery_module(bar, move(module_name));
-    } else if (name == bspwm_module::TYPE) {
-      return new bspwm_module(bar, move(module_name));
-    } else if (name == cpu_module::TYPE) {
-      return new cpu_module(bar, move(module_name));
-    } else if (name == date_module::TYPE) {
-      return new date_module(bar, move(module_name));
-    } else if (name == github_module::TYPE) {
-      return new github_module(bar, move(module_name));
-    } else if (name == fs_module::TYPE) {
-      return new fs_module(bar, move(module_name));
-    } else if (name == memory_module::TYPE) {
-      return new memory_module(bar, move(module_name));
-    } else if (name == i3_module::TYPE) {
-      return new i3_module(bar, move(module_name));
-    } else if (name == mpd_module::TYPE) {
-      return new mpd_module(bar, move(module_name));
-    } else if (name == "internal/volume") {
+    if (name == "internal/volume") {
       m_log.warn("internal/volume is deprecated, use %s instead", string(alsa_module::TYPE));
-      return new alsa_module(bar, move(module_name));
-    } else if (name == alsa_module::TYPE) {
-      return new alsa_module(bar, move(module_name));
-    } else if (name == pulseaudio_module::TYPE) {
-      return new pulseaudio_module(bar, move(module_name));
-    } else if (name == network_module::TYPE) {
-      return new network_module(bar, move(module_name));
-#if DEBUG
-    } else if (name == systray_module::TYPE) {
-      return new systray_module(bar, move(module_name));
-#endif
-    } else if (name == temperature_module::TYPE) {
-      return new temperature_module(bar, move(module_name));
-    } else if (name == xbacklight_module::TYPE) {
-      return new xbacklight_module(bar, move(module_name));
-    } else if (name == xkeyboard_module::TYPE) {
-      return new xkeyboard_module(bar, move(module_name));
-    } else if (name == xwindow_module::TYPE) {
-      return new xwindow_module(bar, move(module_name));
-    } else if (name == xworkspaces_module::TYPE) {
-      return new xworkspaces_module(bar, move(module_name));
-    } else if (name == text_module::TYPE) {
-      return new text_module(bar, move(module_name));
-    } else if (name == script_module::TYPE) {
-      return new script_module(bar, move(module_name));
-    } else if (name == menu_module::TYPE) {
-      return new menu_module(bar, move(module_name));
-    } else if (name == ipc_module::TYPE) {
-      return new ipc_module(bar, move(module_name));
-    } else {
+      name = alsa_module::TYPE;
+    }
+
+    auto type = find_module_type(name);
+    if (type == nullptr) {
       throw application_error("Unknown module: " + name);
     }
+    return type->create(bar, move(module_name));
+  }
+
+  bool needs_main_thread(const string& name) {
+    auto type = find_module_type(name);
+    return type != nullptr && type->main_thread;
   }
 }  // namespace
 
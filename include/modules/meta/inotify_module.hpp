@@ -1,93 +1,133 @@
 #pragma once
 
 #include "components/builder.hpp"
+#include "components/thread_policy.hpp"
 #include "modules/meta/base.hpp"
+#include "utils/inotify.hpp"
 
 POLYBAR_NS
 
 namespace modules {
+  /**
+   * Module that updates whenever one of the paths added with watch() changes
+   *
+   * The paths are watched through the process wide inotify_multiplexer, so
+   * on_event() runs on the reactor's thread as soon as an event arrives and
+   * the module needs no thread of its own.
+   */
   template <class Impl>
   class inotify_module : public module<Impl> {
    public:
     using module<Impl>::module;
 
     void start() {
-      this->m_mainthread = thread(&inotify_module::runner, this);
+      this->m_mainthread = thread_policy::spawn(thread_policy::role::WORKER, [this] { attach(); });
+    }
+
+    void stop() {
+      // Stopped first, so that attach() no longer adds watches that detach() would miss
+      module<Impl>::stop();
+      detach();
     }
 
    protected:
-    void runner() {
+    void watch(string path, int mask = IN_ALL_EVENTS) {
+      this->m_log.trace("%s: Attach inotify at %s", this->name(), path);
+      m_watchlist.insert(make_pair(path, mask));
+    }
+
+    /**
+     * Warm up module output and start watching the paths
+     */
+    void attach() {
       this->m_log.trace("%s: Thread id = %i", this->name(), concurrency_util::thread_id(this_thread::get_id()));
       try {
-        // Warm up module output before entering the loop
         std::unique_lock<std::mutex> guard(this->m_updatelock);
-        CAST_MOD(Impl)->on_event(nullptr);
+        {
+          typename module<Impl>::update_timer timer{*this};
+          CAST_MOD(Impl)->on_event(nullptr);
+        }
         CAST_MOD(Impl)->broadcast();
         guard.unlock();
 
-        while (this->running()) {
-          std::lock_guard<std::mutex> guard(this->m_updatelock);
-          CAST_MOD(Impl)->poll_events();
+        std::lock_guard<std::mutex> watch_guard(m_watchlock);
+        for (auto&& w : m_watchlist) {
+          if (!this->running()) {
+            break;
+          }
+          add_watch(w.first, w.second);
         }
-      } catch (const module_error& err) {
-        CAST_MOD(Impl)->halt(err.what());
-      } catch (const std::exception& err) {
+      } catch (const exception& err) {
         CAST_MOD(Impl)->halt(err.what());
       }
     }
 
-    void watch(string path, int mask = IN_ALL_EVENTS) {
-      this->m_log.trace("%s: Attach inotify at %s", this->name(), path);
-      m_watchlist.insert(make_pair(path, mask));
-    }
+    void detach() {
+      map<string, inotify_multiplexer::watch_id> ids;
+      {
+        std::lock_guard<std::mutex> guard(m_watchlock);
+        std::swap(ids, m_watch_ids);
+      }
 
-    void idle() {
-      this->sleep(200ms);
+      // Not done while holding m_watchlock, remove() waits for callbacks that may take it
+      for (auto&& id : ids) {
+        inotify_multiplexer::make().remove(id.second);
+      }
     }
 
-    void poll_events() {
-      vector<unique_ptr<inotify_watch>> watches;
+    /**
+     * Must be called with m_watchlock held
+     */
+    void add_watch(const string& path, int mask) {
+      m_watch_ids[path] = inotify_multiplexer::make().add(
+          path, mask, [this, path](const inotify_event& event) { on_watch_event(path, event); });
+    }
 
-      try {
-        for (auto&& w : m_watchlist) {
-          watches.emplace_back(inotify_util::make_watch(w.first));
-          watches.back()->attach(w.second);
-        }
-      } catch (const system_error& e) {
-        watches.clear();
-        this->m_log.err("%s: Error while creating inotify watch (what: %s)", this->name(), e.what());
-        CAST_MOD(Impl)->sleep(0.1s);
+    /**
+     * Called by the multiplexer with the events of a watched path
+     */
+    void on_watch_event(const string& path, const inotify_event& event) {
+      if (!this->running()) {
         return;
       }
 
-      while (this->running()) {
-        for (auto&& w : watches) {
-          this->m_log.trace_x("%s: Poll inotify watch %s", this->name(), w->path());
-
-          if (w->poll(1000 / watches.size())) {
-            auto event = w->get_event();
+      try {
+        bool changed{false};
+        {
+          std::lock_guard<std::mutex> guard(this->m_updatelock);
+          typename module<Impl>::update_timer timer{*this};
+          inotify_event copy{event};
+          changed = CAST_MOD(Impl)->on_event(&copy);
+        }
 
-            for (auto&& w : watches) {
-              w->remove(true);
-            }
+        if (changed) {
+          CAST_MOD(Impl)->broadcast();
+        }
 
-            if (CAST_MOD(Impl)->on_event(event.get())) {
-              CAST_MOD(Impl)->broadcast();
+        // The file was deleted or replaced, e.g. by an editor that saves by renaming
+        if (event.mask & IN_IGNORED) {
+          std::lock_guard<std::mutex> guard(m_watchlock);
+          if (this->running()) {
+            inotify_multiplexer::make().remove(m_watch_ids[path]);
+            m_watch_ids.erase(path);
+            try {
+              add_watch(path, m_watchlist.at(path));
+            } catch (const system_error& err) {
+              this->m_log.err("%s: Error while creating inotify watch (what: %s)", this->name(), err.what());
             }
-            CAST_MOD(Impl)->idle();
-            return;
           }
-
-          if (!this->running())
-            break;
         }
-        CAST_MOD(Impl)->idle();
+      } catch (const exception& err) {
+        CAST_MOD(Impl)->halt(err.what());
       }
     }
 
    private:
     map<string, int> m_watchlist;
+
+    std::mutex m_watchlock;
+    map<string, inotify_multiplexer::watch_id> m_watch_ids;
   };
-}
+}  // namespace modules
 
 POLYBAR_NS_END
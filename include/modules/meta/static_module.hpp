@@ -1,5 +1,6 @@
 #pragma once
 
+#include "components/thread_policy.hpp"
 #include "modules/meta/base.hpp"
 
 POLYBAR_NS
@@ -11,14 +12,17 @@ namespace modules {
     using module<Impl>::module;
 
     void start() {
-      this->m_mainthread = thread([&] {
+      this->m_mainthread = thread_policy::spawn(thread_policy::role::WORKER, [&] {
         this->m_log.trace("%s: Thread id = %i", this->name(), concurrency_util::thread_id(this_thread::get_id()));
-        CAST_MOD(Impl)->update();
+        {
+          typename module<Impl>::update_timer timer{*this};
+          CAST_MOD(Impl)->update();
+        }
         CAST_MOD(Impl)->broadcast();
       });
     }
 
-    bool build(builder*, string) const {
+    bool build(builder*, const module_tag&) const {
       return true;
     }
   };
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "components/scheduler.hpp"
 #include "modules/meta/base.hpp"
 
 POLYBAR_NS
@@ -7,13 +12,83 @@ POLYBAR_NS
 namespace modules {
   using interval_t = chrono::duration<double>;
 
+  /**
+   * \brief Modules that update on an interval, they can be paused and retimed at runtime
+   */
+  struct timer_module_interface {
+    virtual ~timer_module_interface() {}
+
+    /**
+     * Stop updating on the interval, the last output stays
+     *
+     * Actions still update a paused module.
+     */
+    virtual void pause(bool paused) = 0;
+
+    /**
+     * Update on the given interval instead of the configured one, zero goes back to that
+     */
+    virtual void override_interval(interval_t interval) = 0;
+  };
+
   template <class Impl>
-  class timer_module : public module<Impl> {
+  class timer_module : public module<Impl>, public timer_module_interface {
    public:
     using module<Impl>::module;
 
+    /**
+     * Hand the module over to the shared scheduler
+     *
+     * Updates run on the scheduler's workers, so timer modules don't
+     * need a thread of their own. The output is also formatted on the
+     * worker, the controller only picks up the cached result.
+     */
     void start() {
-      this->m_mainthread = thread(&timer_module::runner, this);
+      // The seemingly arbitrary addition of 500ms is due
+      // to the fact that if we wait the exact time our
+      // thread will be woken just a tiny bit prematurely
+      // and therefore the wrong time will be displayed.
+      // It is currently unknown why exactly the thread gets
+      // woken prematurely.
+      m_task = scheduler::make().add(this->name(), chrono::duration_cast<scheduler::duration>(m_interval),
+          [this] { tick(); }, 500ms, chrono::duration_cast<scheduler::duration>(m_slack),
+          scheduler::SUSPENDABLE | scheduler::STRETCHABLE | scheduler::BACKGROUND);
+    }
+
+    void pause(bool paused) override {
+      this->m_log.info("%s: %s", this->name(), paused ? "Paused" : "Resumed");
+      scheduler::make().pause(m_task, paused);
+    }
+
+    void override_interval(interval_t interval) override {
+      m_override = std::max(interval, interval_t::zero());
+      auto base = base_interval();
+      this->m_log.info("%s: Updating every %gs", this->name(), base.count());
+
+      // A backed off interval starts over from the new one
+      m_snap_back = true;
+      scheduler::make().set_interval(m_task, chrono::duration_cast<scheduler::duration>(base));
+    }
+
+    void stop() {
+      if (m_task != 0) {
+        scheduler::make().remove(m_task);
+        m_task = 0;
+      }
+      module<Impl>::stop();
+    }
+
+    /**
+     * Update the module right away instead of waiting for the next interval
+     *
+     * Something is expected to happen, so a backed off interval snaps back.
+     */
+    void wakeup() {
+      m_snap_back = true;
+      if (m_task != 0) {
+        scheduler::make().trigger(m_task);
+      }
+      module<Impl>::wakeup();
     }
 
    protected:
@@ -29,48 +104,120 @@ namespace modules {
         throw module_error(
             this->name() + ": 'interval' must be larger than 0 (got '" + to_string(m_interval.count()) + "s')");
       }
+
+      // Allows the scheduler to delay updates so that they share a wakeup with other modules
+      auto slack = this->m_conf.template get<decltype(m_slack)>("settings", "timer-slack", 0s);
+      m_slack = this->m_conf.template get<decltype(m_slack)>(this->name(), "interval-slack", slack);
+
+      if (m_slack < 0s) {
+        throw module_error(
+            this->name() + ": 'interval-slack' must not be negative (got '" + to_string(m_slack.count()) + "s')");
+      }
+
+      // Doubles the interval after this many updates without a change
+      m_backoff_after = this->m_conf.template get<unsigned>(this->name(), "interval-backoff", 0U);
+      m_interval_max = this->m_conf.template get<decltype(m_interval_max)>(this->name(), "interval-max", m_interval * 8);
+      m_current = m_interval;
+
+      if (m_backoff_after > 0 && m_interval_max < m_interval) {
+        throw module_error(this->name() + ": 'interval-max' must not be smaller than 'interval' (got '" +
+                           to_string(m_interval_max.count()) + "s')");
+      }
     }
 
-    void runner() {
-      this->m_log.trace("%s: Thread id = %i", this->name(), concurrency_util::thread_id(this_thread::get_id()));
+    /**
+     * Number of samples kept for graphs and history tokens
+     *
+     * Covers the `history` setting (in seconds, 60s by default) at the
+     * module's interval, so it has to be called after set_interval().
+     */
+    size_t history_size() const {
+      auto length = this->m_conf.template get<interval_t>(this->name(), "history", 60s);
+
+      if (length <= 0s) {
+        throw module_error(
+            this->name() + ": 'history' must be larger than 0 (got '" + to_string(length.count()) + "s')");
+      }
+
+      return static_cast<size_t>(std::max(1.0, std::ceil(length / m_interval)));
+    }
 
-      const auto check = [&]() -> bool {
-        std::unique_lock<std::mutex> guard(this->m_updatelock);
-        return CAST_MOD(Impl)->update();
-      };
+    /**
+     * Called by the scheduler once per interval
+     */
+    void tick() {
+      if (!this->running()) {
+        return;
+      }
 
       try {
-        // warm up module output before entering the loop
-        check();
-        CAST_MOD(Impl)->broadcast();
-
-        while (this->running()) {
-          if (check()) {
-            CAST_MOD(Impl)->broadcast();
-          }
-          // wait until next full interval to avoid drifting clocks
-          using clock = chrono::system_clock;
-          using sys_duration_t = clock::time_point::duration;
-
-          auto sys_interval = chrono::duration_cast<sys_duration_t>(m_interval);
-          clock::time_point now = clock::now();
-          sys_duration_t adjusted = sys_interval - (now.time_since_epoch() % sys_interval);
-
-          // The seemingly arbitrary addition of 500ms is due
-          // to the fact that if we wait the exact time our
-          // thread will be woken just a tiny bit prematurely
-          // and therefore the wrong time will be displayed.
-          // It is currently unknown why exactly the thread gets
-          // woken prematurely.
-          CAST_MOD(Impl)->sleep_until(now + adjusted + 500ms);
+        bool changed{false};
+        {
+          std::lock_guard<std::mutex> guard(this->m_updatelock);
+          typename module<Impl>::update_timer timer{*this};
+          changed = CAST_MOD(Impl)->update();
+        }
+
+        // The output of the first update is always broadcast to warm up the module
+        if (changed || !m_warm) {
+          m_warm = true;
+          this->rebuild_and_broadcast();
+        }
+
+        if (m_backoff_after > 0) {
+          backoff(changed);
         }
       } catch (const exception& err) {
         CAST_MOD(Impl)->halt(err.what());
       }
     }
 
+    /**
+     * Double the interval after `interval-backoff` updates without a change,
+     * up to `interval-max`, and go back to `interval` once something changes
+     */
+    void backoff(bool changed) {
+      auto current = m_current;
+      auto base = base_interval();
+
+      if (changed || m_snap_back.exchange(false)) {
+        m_unchanged = 0;
+        current = base;
+      } else if (++m_unchanged >= m_backoff_after) {
+        m_unchanged = 0;
+        current = std::min(m_current * 2, std::max(m_interval_max, base));
+      }
+
+      if (current != m_current) {
+        m_current = current;
+        scheduler::make().set_interval(m_task, chrono::duration_cast<scheduler::duration>(m_current));
+      }
+    }
+
+    /**
+     * Interval set over IPC, or the configured one
+     */
+    interval_t base_interval() const {
+      interval_t value = m_override;
+      return value > interval_t::zero() ? value : m_interval;
+    }
+
    protected:
     interval_t m_interval{1.0};
+    interval_t m_slack{0.0};
+
+   private:
+    scheduler::task_id m_task{0};
+    bool m_warm{false};
+
+    unsigned m_backoff_after{0};
+    interval_t m_interval_max{0.0};
+    // Only used by tick(), which never runs concurrently with itself
+    interval_t m_current{1.0};
+    unsigned m_unchanged{0};
+    std::atomic<bool> m_snap_back{false};
+    // Zero unless the interval was overridden over IPC
+    std::atomic<interval_t> m_override{interval_t::zero()};
   };
 }  // namespace modules
 
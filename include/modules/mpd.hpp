@@ -1,10 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 
 #include "adapters/mpd.hpp"
 #include "modules/meta/event_module.hpp"
 #include "utils/env.hpp"
+#include "utils/file.hpp"
 
 POLYBAR_NS
 
@@ -15,6 +17,7 @@ namespace modules {
    public:
     explicit mpd_module(const bar_settings&, string);
 
+    void stop();
     void teardown();
     inline bool connected() const;
     void idle();
@@ -22,7 +25,7 @@ namespace modules {
     bool update();
     string get_format() const;
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/mpd";
 
@@ -39,6 +42,9 @@ namespace modules {
 
    protected:
     bool input(const string& action, const string& data);
+    int wait_timeout() const;
+    bool reconnect();
+    void wait_for(int fd, short events, int timeout);
 
    private:
     static constexpr const char* FORMAT_ONLINE{"format-online"};
@@ -74,6 +80,9 @@ namespace modules {
     static constexpr const char* FORMAT_OFFLINE{"format-offline"};
     static constexpr const char* TAG_LABEL_OFFLINE{"<label-offline>"};
 
+    static constexpr const char* FORMAT_CONNECTING{"format-connecting"};
+    static constexpr const char* TAG_LABEL_CONNECTING{"<label-connecting>"};
+
     unique_ptr<mpdconnection> m_mpd;
 
     /*
@@ -87,20 +96,29 @@ namespace modules {
     string m_pass;
     unsigned int m_port{6600U};
 
-    chrono::system_clock::time_point m_lastsync{};
     float m_synctime{1.0f};
 
-    int m_quick_attempts{0};
+    // Set by has_event() if only the extrapolated elapsed time has to be shown again
+    bool m_elapsed_only{false};
+
+    // Delay after a failed connection attempt, doubles after every failure
+    chrono::milliseconds m_reconnect_delay;
+    chrono::steady_clock::time_point m_next_attempt{};
+    chrono::steady_clock::time_point m_attempt_start{};
+
+    // Becomes readable on stop() to interrupt has_event() while it waits for mpd
+    file_descriptor m_wakeupfd;
 
     // This flag is used to let thru a broadcast once every time
     // the connection state changes
-    connection_state m_statebroadcasted{connection_state::NONE};
+    std::atomic<connection_state> m_statebroadcasted{connection_state::NONE};
 
     progressbar_t m_bar_progress;
     iconset_t m_icons;
     label_t m_label_song;
     label_t m_label_time;
     label_t m_label_offline;
+    label_t m_label_connecting;
 
     rgba m_toggle_on_color;
     rgba m_toggle_off_color;
@@ -3,6 +3,7 @@
 #include "adapters/net.hpp"
 #include "components/config.hpp"
 #include "modules/meta/timer_module.hpp"
+#include "utils/history.hpp"
 
 POLYBAR_NS
 
@@ -16,12 +17,12 @@ namespace modules {
     void teardown();
     bool update();
     string get_format() const;
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/network";
 
    protected:
-    void subthread_routine();
+    void update_animation();
 
    private:
     static constexpr auto FORMAT_CONNECTED = "format-connected";
@@ -33,15 +34,26 @@ namespace modules {
     static constexpr auto TAG_LABEL_DISCONNECTED = "<label-disconnected>";
     static constexpr auto TAG_LABEL_PACKETLOSS = "<label-packetloss>";
     static constexpr auto TAG_ANIMATION_PACKETLOSS = "<animation-packetloss>";
+    static constexpr auto TAG_GRAPH_DOWNSPEED = "<graph-downspeed>";
+    static constexpr auto TAG_GRAPH_UPSPEED = "<graph-upspeed>";
 
     net::wired_t m_wired;
     net::wireless_t m_wireless;
+    unique_ptr<net::connectivity_probe> m_probe;
 
     ramp_t m_ramp_signal;
     ramp_t m_ramp_quality;
     animation_t m_animation_packetloss;
+    // Set while the packetloss animation is advanced by the animation clock
+    size_t m_animation_id{0};
     map<connection_state, label_t> m_label;
 
+    // Speeds of the last updates in bytes per second, only kept for the graphs
+    sample_history<float> m_downspeeds;
+    sample_history<float> m_upspeeds;
+    int m_graph_downspeed_width{60};
+    int m_graph_upspeed_width{60};
+
     atomic<bool> m_connected{false};
     atomic<bool> m_packetloss{false};
 
@@ -51,6 +63,7 @@ namespace modules {
 
     string m_interface;
     int m_ping_nth_update{0};
+    string m_ping_target{CONNECTION_TEST_IP};
     int m_udspeed_minwidth{0};
     bool m_accumulate{false};
     bool m_unknown_up{false};
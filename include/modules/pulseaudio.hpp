@@ -16,11 +16,12 @@ namespace modules {
     explicit pulseaudio_module(const bar_settings&, string);
 
     void teardown();
+    int event_fd() const;
     bool has_event();
     bool update();
     string get_format() const;
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/pulseaudio";
 
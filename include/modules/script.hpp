@@ -1,5 +1,7 @@
 #pragma once
 
+#include "components/scheduler.hpp"
+#include "components/script_runner.hpp"
 #include "modules/meta/base.hpp"
 #include "utils/command.hpp"
 #include "utils/io.hpp"
@@ -16,13 +18,16 @@ namespace modules {
     void stop();
 
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "custom/script";
 
    protected:
     chrono::duration<double> process(const mutex_wrapper<function<chrono::duration<double>()>>& handler) const;
     bool check_condition();
+    script_runner::duration process_result(const script_runner::result& result);
+    void receive_tail(int fd);
+    void tick_persistent();
 
    private:
     static constexpr const char* TAG_LABEL{"<label>"};
@@ -30,11 +35,18 @@ namespace modules {
     mutex_wrapper<function<chrono::duration<double>()>> m_handler;
 
     unique_ptr<command<output_policy::REDIRECTED>> m_command;
+    script_runner::script_id m_script{0};
+    // Used for exec-persistent, that command is kept running and ticked by the scheduler
+    scheduler::task_id m_task{0};
 
     bool m_tail;
+    bool m_persistent{false};
 
     string m_exec;
     string m_exec_if;
+    chrono::duration<double> m_exec_if_interval{0};
+    chrono::steady_clock::time_point m_exec_if_until{};
+    bool m_exec_if_met{false};
 
     chrono::duration<double> m_interval{0};
     map<mousebtn, string> m_actions;
@@ -45,6 +57,12 @@ namespace modules {
     int m_counter{0};
 
     bool m_stopping{false};
+
+    // Output of the tailed command that doesn't end with a newline yet
+    string m_tail_buffer;
+    bool m_tail_closed{false};
+    std::mutex m_taillock;
+    std::condition_variable m_tailhandler;
   };
 }  // namespace modules
 
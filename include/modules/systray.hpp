@@ -17,7 +17,7 @@ namespace modules {
     explicit systray_module(const bar_settings&, string);
 
     void update();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/systray";
 
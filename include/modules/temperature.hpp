@@ -4,6 +4,8 @@
 
 #include "modules/meta/timer_module.hpp"
 #include "settings.hpp"
+#include "utils/file.hpp"
+#include "utils/history.hpp"
 
 POLYBAR_NS
 
@@ -16,7 +18,7 @@ namespace modules {
 
     bool update();
     string get_format() const;
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/temperature";
 
@@ -24,17 +26,26 @@ namespace modules {
     static constexpr auto TAG_LABEL = "<label>";
     static constexpr auto TAG_LABEL_WARN = "<label-warn>";
     static constexpr auto TAG_RAMP = "<ramp>";
+    static constexpr auto TAG_GRAPH = "<graph>";
     static constexpr auto FORMAT_WARN = "format-warn";
 
     map<temp_state, label_t> m_label;
     ramp_t m_ramp;
 
-    string m_path;
-    int m_zone = 0;
+    // Opened once and read from the start on every update
+    vector<unique_ptr<reread_file>> m_sensors;
+    vector<reread_file*> m_sensor_files;
     // Base temperature used for where to start the ramp
     int m_tempbase = 0;
     int m_tempwarn = 0;
+    // Temperature of the first sensor, and the hottest and average of all sensors
     int m_temp = 0;
+    int m_max = 0;
+    int m_avg = 0;
+
+    // Hottest sensor of the last updates relative to the base and warn temperature, only kept for <graph>
+    sample_history<float> m_history;
+    int m_graph_width{60};
 
     // Whether or not to show units with the %temperature-X% tokens
     bool m_units{true};
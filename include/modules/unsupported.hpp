@@ -11,7 +11,7 @@ namespace modules {
 #define DEFINE_UNSUPPORTED_MODULE(MODULE_NAME, MODULE_TYPE)                             \
   class MODULE_NAME : public module_interface {                                         \
    public:                                                                              \
-    MODULE_NAME(const bar_settings, string) {                                           \
+    MODULE_NAME(const bar_settings&, string) {                                          \
       throw application_error("No built-in support for '" + string{MODULE_TYPE} + "'"); \
     }                                                                                   \
     static constexpr auto TYPE = MODULE_TYPE;                                           \
@@ -27,17 +27,71 @@ namespace modules {
     bool running() const {                                                              \
       return false;                                                                     \
     }                                                                                   \
+    size_t generation() const {                                                         \
+      return 0;                                                                         \
+    }                                                                                   \
     void start() {}                                                                     \
     void stop() {}                                                                      \
     void halt(string) {}                                                                \
     string contents() {                                                                 \
       return "";                                                                        \
     }                                                                                   \
+    shared_ptr<const tags::format_string> elements() {                                  \
+      return make_shared<const tags::format_string>();                                  \
+    }                                                                                   \
     bool input(const string&, const string&) {                                          \
       return false;                                                                     \
     }                                                                                   \
   }
 
+#if not ENABLE_MODULE_BACKLIGHT
+  DEFINE_UNSUPPORTED_MODULE(backlight_module, "internal/backlight");
+#endif
+#if not ENABLE_MODULE_BATTERY
+  DEFINE_UNSUPPORTED_MODULE(battery_module, "internal/battery");
+#endif
+#if not ENABLE_MODULE_BSPWM
+  DEFINE_UNSUPPORTED_MODULE(bspwm_module, "internal/bspwm");
+#endif
+#if not ENABLE_MODULE_COUNTER
+  DEFINE_UNSUPPORTED_MODULE(counter_module, "internal/counter");
+#endif
+#if not ENABLE_MODULE_CPU
+  DEFINE_UNSUPPORTED_MODULE(cpu_module, "internal/cpu");
+#endif
+#if not ENABLE_MODULE_DATE
+  DEFINE_UNSUPPORTED_MODULE(date_module, "internal/date");
+#endif
+#if not ENABLE_MODULE_FS
+  DEFINE_UNSUPPORTED_MODULE(fs_module, "internal/fs");
+#endif
+#if not ENABLE_MODULE_MEMORY
+  DEFINE_UNSUPPORTED_MODULE(memory_module, "internal/memory");
+#endif
+#if not ENABLE_MODULE_TEMPERATURE
+  DEFINE_UNSUPPORTED_MODULE(temperature_module, "internal/temperature");
+#endif
+#if not ENABLE_MODULE_XBACKLIGHT
+  DEFINE_UNSUPPORTED_MODULE(xbacklight_module, "internal/xbacklight");
+#endif
+#if not ENABLE_MODULE_XWINDOW
+  DEFINE_UNSUPPORTED_MODULE(xwindow_module, "internal/xwindow");
+#endif
+#if not ENABLE_MODULE_XWORKSPACES
+  DEFINE_UNSUPPORTED_MODULE(xworkspaces_module, "internal/xworkspaces");
+#endif
+#if not ENABLE_MODULE_IPC
+  DEFINE_UNSUPPORTED_MODULE(ipc_module, "custom/ipc");
+#endif
+#if not ENABLE_MODULE_MENU
+  DEFINE_UNSUPPORTED_MODULE(menu_module, "custom/menu");
+#endif
+#if not ENABLE_MODULE_SCRIPT
+  DEFINE_UNSUPPORTED_MODULE(script_module, "custom/script");
+#endif
+#if not ENABLE_MODULE_TEXT
+  DEFINE_UNSUPPORTED_MODULE(text_module, "custom/text");
+#endif
 #if not ENABLE_I3
   DEFINE_UNSUPPORTED_MODULE(i3_module, "internal/i3");
 #endif
@@ -28,7 +28,7 @@ namespace modules {
 
     void update();
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/xbacklight";
 
@@ -18,13 +18,14 @@ namespace modules {
    */
   class xkeyboard_module
       : public static_module<xkeyboard_module>,
-        public event_handler<evt::xkb_new_keyboard_notify, evt::xkb_state_notify, evt::xkb_indicator_state_notify> {
+        public event_handler<evt::xkb_new_keyboard_notify, evt::xkb_names_notify, evt::xkb_state_notify,
+            evt::xkb_indicator_state_notify> {
    public:
     explicit xkeyboard_module(const bar_settings& bar, string name_);
 
     string get_output();
     void update();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/xkeyboard";
 
@@ -35,8 +36,10 @@ namespace modules {
     bool blacklisted(const string& indicator_name);
 
     void handle(const evt::xkb_new_keyboard_notify& evt);
+    void handle(const evt::xkb_names_notify& evt);
     void handle(const evt::xkb_state_notify& evt);
     void handle(const evt::xkb_indicator_state_notify& evt);
+    void events_handled() override;
 
     bool input(const string& action, const string& data);
 
@@ -48,11 +51,19 @@ namespace modules {
     static constexpr const char* DEFAULT_INDICATOR_ICON{"indicator-icon-default"};
 
     connection& m_connection;
-    event_timer m_xkb_newkb_notify{};
-    event_timer m_xkb_state_notify{};
-    event_timer m_xkb_indicator_notify{};
     unique_ptr<keyboard> m_keyboard;
 
+    /**
+     * What changed during the current burst of XKB events
+     *
+     * The layouts and indicator names are only queried again when the
+     * keyboard or its names change, indicator states when an indicator
+     * changed.
+     */
+    bool m_keyboard_changed{false};
+    bool m_indicators_changed{false};
+    bool m_group_changed{false};
+
     label_t m_layout;
     label_t m_indicator_state_on;
     label_t m_indicator_state_off;
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+
 #include "modules/meta/event_handler.hpp"
 #include "modules/meta/static_module.hpp"
 #include "x11/ewmh.hpp"
@@ -13,14 +16,15 @@ class connection;
 namespace modules {
   class active_window {
    public:
-    explicit active_window(xcb_connection_t* conn, xcb_window_t win);
+    explicit active_window(connection& conn, xcb_window_t win);
     ~active_window();
 
     bool match(const xcb_window_t win) const;
+    xcb_window_t window() const;
     string title() const;
 
    private:
-    xcb_connection_t* m_connection{nullptr};
+    connection& m_connection;
     xcb_window_t m_window{XCB_NONE};
   };
 
@@ -33,13 +37,16 @@ namespace modules {
     enum class state { NONE, ACTIVE, EMPTY };
     explicit xwindow_module(const bar_settings&, string);
 
+    void start();
+    void teardown();
     void update(bool force = false);
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/xwindow";
 
    protected:
     void handle(const evt::property_notify& evt);
+    vector<xcb_atom_t> property_atoms() const override;
 
    private:
     static constexpr const char* TAG_LABEL{"<label>"};
@@ -48,6 +55,21 @@ namespace modules {
     unique_ptr<active_window> m_active;
     map<state, label_t> m_statelabels;
     label_t m_label;
+    string m_title;
+
+    /**
+     * Active window, read by the event handler to drop title changes of other windows
+     */
+    std::atomic<xcb_window_t> m_window{XCB_NONE};
+
+    /**
+     * Title changes are applied at most once per frame, the last one wins
+     *
+     * Both are guarded by m_sleeplock
+     */
+    bool m_title_pending{false};
+    std::chrono::steady_clock::time_point m_title_time{};
+    std::chrono::microseconds m_title_interval{0};
   };
 }  // namespace modules
 
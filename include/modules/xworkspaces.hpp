@@ -56,7 +56,7 @@ namespace modules {
 
     void update();
     string get_output();
-    bool build(builder* builder, const string& tag) const;
+    bool build(builder* builder, const module_tag& tag) const;
 
     static constexpr auto TYPE = "internal/xworkspaces";
 
@@ -66,8 +66,13 @@ namespace modules {
 
    protected:
     void handle(const evt::property_notify& evt);
+    void events_handled() override;
+    vector<xcb_atom_t> property_atoms() const override;
 
     void rebuild_clientlist();
+    void update_client_desktops(const std::set<xcb_window_t>& windows);
+    void add_client(xcb_window_t window, unsigned int desktop);
+    void remove_client(xcb_window_t window);
     void rebuild_desktops();
     void rebuild_desktop_states();
     void set_desktop_urgent(xcb_window_t window);
@@ -98,6 +103,10 @@ namespace modules {
      * Maps an xcb window to its desktop number
      */
     map<xcb_window_t, unsigned int> m_clients;
+    /**
+     * Number of clients on each desktop, desktops without clients aren't in it
+     */
+    map<unsigned int, size_t> m_occupancy;
     vector<unique_ptr<viewport>> m_viewports;
     map<desktop_state, label_t> m_labels;
     label_t m_monitorlabel;
@@ -107,6 +116,15 @@ namespace modules {
     bool m_scroll{true};
     size_t m_index{0};
 
+    /**
+     * What changed since the last burst of X events was handled
+     */
+    bool m_names_changed{false};
+    bool m_clients_changed{false};
+    std::set<xcb_window_t> m_desktops_changed;
+    bool m_current_changed{false};
+    std::set<xcb_window_t> m_hints_changed;
+
     // The following mutex is here to protect the data of this modules.
     // This can't be achieved using m_buildlock since we "CRTP override" get_output().
     mutable mutex m_workspace_mutex;
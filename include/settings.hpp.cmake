@@ -20,6 +20,10 @@ extern const char* const APP_VERSION;
 #cmakedefine01 WITH_XKB
 #cmakedefine01 WITH_XRM
 #cmakedefine01 WITH_XCURSOR
+#cmakedefine01 WITH_XSHM
+#cmakedefine01 WITH_XPRESENT
+#cmakedefine01 WITH_HARFBUZZ
+#cmakedefine01 WITH_IO_URING
 
 #if WITH_XRANDR
 #cmakedefine01 WITH_XRANDR_MONITORS
@@ -33,9 +37,27 @@ extern const char* const APP_VERSION;
 #define ENABLE_XKEYBOARD 0
 #endif
 
+#cmakedefine01 ENABLE_MODULE_BACKLIGHT
+#cmakedefine01 ENABLE_MODULE_BATTERY
+#cmakedefine01 ENABLE_MODULE_BSPWM
+#cmakedefine01 ENABLE_MODULE_COUNTER
+#cmakedefine01 ENABLE_MODULE_CPU
+#cmakedefine01 ENABLE_MODULE_DATE
+#cmakedefine01 ENABLE_MODULE_FS
+#cmakedefine01 ENABLE_MODULE_MEMORY
+#cmakedefine01 ENABLE_MODULE_TEMPERATURE
+#cmakedefine01 ENABLE_MODULE_XBACKLIGHT
+#cmakedefine01 ENABLE_MODULE_XWINDOW
+#cmakedefine01 ENABLE_MODULE_XWORKSPACES
+#cmakedefine01 ENABLE_MODULE_IPC
+#cmakedefine01 ENABLE_MODULE_MENU
+#cmakedefine01 ENABLE_MODULE_SCRIPT
+#cmakedefine01 ENABLE_MODULE_TEXT
+
 #cmakedefine XPP_EXTENSION_LIST @XPP_EXTENSION_LIST@
 
 #cmakedefine DEBUG_LOGGER
+#cmakedefine01 ENABLE_ALLOC_STATS
 
 #if DEBUG
 #cmakedefine DEBUG_LOGGER_VERBOSE
@@ -65,7 +87,9 @@ extern const char* const PATH_BACKLIGHT;
 extern const char* const PATH_BATTERY;
 extern const char* const PATH_CPU_INFO;
 extern const char* const PATH_MEMORY_INFO;
+extern const char* const PATH_MEMORY_PRESSURE;
 extern const char* const PATH_MESSAGING_FIFO;
+extern const char* const PATH_MESSAGING_SOCKET;
 extern const char* const PATH_TEMPERATURE_INFO;
 extern const char* const WIRELESS_LIB;
 
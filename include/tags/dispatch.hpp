@@ -2,38 +2,59 @@
 
 #include "common.hpp"
 #include "errors.hpp"
+#include "tags/types.hpp"
 
 POLYBAR_NS
 
-class signal_emitter;
-
 enum class mousebtn;
 struct bar_settings;
 class logger;
+class renderer_interface;
 
 namespace tags {
-  enum class attribute;
-  enum class controltag;
+  /**
+   * Parse the given formatting string into its elements
+   *
+   * Invalid tags are logged and skipped. The string is parsed in place, only
+   * the text and action commands are copied into the elements.
+   */
+  format_string tokenize(const logger& log, const string& data);
 
   /**
-   * Calls into the tag parser to parse the given formatting string and then
-   * sends the right signals for each tag.
+   * Calls the renderer for each element of an already parsed formatting
+   * string.
+   *
+   * Formatting strings can also be passed as text, in which case they are
+   * parsed first.
    */
   class dispatch {
    public:
     using make_type = unique_ptr<dispatch>;
     static make_type make();
 
-    explicit dispatch(signal_emitter& emitter, const logger& logger);
-    void parse(const bar_settings& bar, string data);
+    explicit dispatch(const logger& logger);
+    /**
+     * Called with the elements of an alignment block, starting at its
+     * alignment tag. If it returns true, the block is not dispatched.
+     */
+    using block_filter = function<bool(format_string::const_iterator begin, format_string::const_iterator end)>;
+
+    void parse(const bar_settings& bar, renderer_interface& renderer, string data);
+    void parse(const bar_settings& bar, renderer_interface& renderer, const format_string& elements,
+        const block_filter& skip_block = nullptr);
 
    protected:
-    void text(string&& data);
-    void handle_action(mousebtn btn, bool closing, const string&& cmd);
+    void text(renderer_interface& renderer, const string& data);
+    void handle_action(renderer_interface& renderer, mousebtn btn, bool closing, const string& cmd);
+    void graph(renderer_interface& renderer, const graph_value& graph, const string& values);
+    void control(renderer_interface& renderer, controltag ctrl, const string& data);
 
    private:
-    signal_emitter& m_sig;
     vector<mousebtn> m_actions;
+    /**
+     * Values of the graph currently being drawn, kept to reuse the allocation
+     */
+    vector<double> m_graph_values;
     const logger& m_log;
   };
 }  // namespace tags
@@ -45,6 +45,7 @@ namespace tags {
   DEFINE_INVALID_ERROR(control_error, "control tag");
   DEFINE_INVALID_ERROR(offset_error, "offset");
   DEFINE_INVALID_ERROR(btn_error, "button id");
+  DEFINE_INVALID_ERROR(graph_error, "graph");
 #undef DEFINE_INVALID_ERROR
 
   class token_error : public error {
@@ -91,7 +92,15 @@ namespace tags {
     /**
      * Resets the parser state and sets the new string to parse
      */
-    void set(const string&& input);
+    void set(string&& input);
+    void set(const string& input);
+
+    /**
+     * Like set(), but parses the caller's buffer without copying it
+     *
+     * The buffer must not be modified or destroyed while elements are parsed.
+     */
+    void set_borrowed(const string& input);
 
     /**
      * Whether a call to next_element() suceeds.
@@ -112,10 +121,10 @@ namespace tags {
    protected:
     void parse_step();
 
+    size_t find_tag(size_t from) const;
     bool has_next() const;
     char next();
     char peek() const;
-    void revert();
 
     void consume(char c);
     void consume_space();
@@ -127,19 +136,30 @@ namespace tags {
     color_value parse_color();
     int parse_fontindex();
     int parse_offset();
-    controltag parse_control();
+    std::pair<controltag, string> parse_control();
     std::pair<action_value, string> parse_action();
     mousebtn parse_action_btn();
     string parse_action_cmd();
     attribute parse_attribute();
+    std::pair<graph_value, string> parse_graph();
 
-    void push_char(char c);
-    void push_text(string&& text);
+    void push_text(size_t start, size_t length);
+    string slice(size_t start, size_t end) const;
 
     string get_tag_value();
+    void skip_tag_value();
 
    private:
-    string input;
+    /**
+     * Storage for strings passed to set(), empty when parsing a borrowed buffer
+     */
+    string owned;
+
+    /**
+     * The string that is parsed, either owned or borrowed from the caller
+     */
+    const char* input = "";
+    size_t size = 0;
     size_t pos = 0;
 
     /**
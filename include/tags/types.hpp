@@ -25,6 +25,7 @@ namespace tags {
     l,  // Left alignment
     r,  // Right alignment
     c,  // Center alignment
+    G,  // Graph
   };
 
   /**
@@ -36,6 +37,20 @@ namespace tags {
   enum class controltag {
     NONE = 0,
     R,  // Reset all open tags (B, F, T, o, u). Used at module edges
+    W,  // Reserve at least the given width until the next R. Used at the start of modules
+    F,  // Reserve exactly the given width until the next R, contents past it are cut off
+  };
+
+  /**
+   * Width reserved by the W and F control tags
+   *
+   * The width is stored in element.data, followed by `c` if it is in characters
+   * instead of pixels (e.g. `%{PW60}`, `%{PF4c}`)
+   */
+  struct reserved_width {
+    int width{0};
+    bool chars{false};
+    bool fixed{false};
   };
 
   enum class color_type { RESET = 0, COLOR };
@@ -63,6 +78,24 @@ namespace tags {
     bool closing;
   };
 
+  enum class graph_type {
+    BAR,        // A single value filling the graph from the left
+    SPARKLINE,  // A line through a series of values, the area below it is shaded
+  };
+
+  /**
+   * Stores information about a graph
+   *
+   * The comma separated values (percentages) are stored in element.data
+   */
+  struct graph_value {
+    graph_type type;
+    /**
+     * Width in pixels
+     */
+    int width;
+  };
+
   enum class tag_type { ATTR, FORMAT };
 
   union tag_subtype {
@@ -75,7 +108,7 @@ namespace tags {
     tag_subtype subtype;
     union {
       /**
-       * Used for 'F', 'G', 'o', 'u' formatting tags.
+       * Used for 'B', 'F', 'o', 'u' formatting tags.
        */
       color_value color;
       /**
@@ -94,6 +127,10 @@ namespace tags {
        * For for 'P' tags
        */
       controltag ctrl;
+      /**
+       * For 'G' tags
+       */
+      graph_value graph;
 
       /**
        * For attribute activations ((-|+|!)(o|u))
@@ -104,7 +141,7 @@ namespace tags {
 
   struct element {
     element(){};
-    element(const string&& text) : data{std::move(text)}, is_tag{false} {};
+    element(string&& text) : data{std::move(text)}, is_tag{false} {};
 
     string data{};
     tag tag_data{};
@@ -113,6 +150,18 @@ namespace tags {
 
   using format_string = vector<element>;
 
+  bool operator==(const color_value& a, const color_value& b);
+  bool operator==(const tag& a, const tag& b);
+  bool operator==(const element& a, const element& b);
+  bool operator!=(const element& a, const element& b);
+
+  bool is_alignment(const element& el);
+  alignment get_alignment(const element& el);
+
+  void append(format_string& dst, element el);
+  void append(format_string& dst, const format_string& src);
+  string compact(const string& contents);
+
 }  // namespace tags
 
 POLYBAR_NS_END
@@ -3,7 +3,10 @@
 #include <xcb/xcb.h>
 #include <xcb/xcb_icccm.h>
 
+#include <mutex>
+
 #include "common.hpp"
+#include "components/event_hub.hpp"
 #include "settings.hpp"
 #include "utils/socket.hpp"
 #include "utils/string.hpp"
@@ -32,6 +35,36 @@ namespace bspwm_util {
   payload_t make_payload(const string& cmd);
   connection_t make_connection();
   connection_t make_subscriber();
+
+  /**
+   * \brief Subscription to the bspwm reports that all bspwm modules share
+   *
+   * The latest complete report is published as it is, since what a module
+   * makes of it depends on the module's settings. Reports that are the same
+   * as the previous one aren't published.
+   */
+  class hub : public event_hub<string> {
+   public:
+    using make_type = hub&;
+    static make_type make();
+
+   protected:
+    model connect() override;
+    void disconnect() override;
+
+   private:
+    void watch();
+    void on_event();
+
+    // Guards the subscriber against being closed while a report is read
+    std::mutex m_subscriber_lock;
+    connection_t m_subscriber;
+    int m_fd{-1};
+
+    // Start of a report that wasn't received completely yet
+    string m_partial;
+    shared_ptr<const string> m_report;
+  };
 }
 
 POLYBAR_NS_END
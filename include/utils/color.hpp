@@ -16,6 +16,7 @@ class rgba {
   explicit rgba();
   explicit rgba(uint32_t value, type type = type::ARGB);
   explicit rgba(string hex);
+  explicit rgba(const char* hex, size_t len);
 
   operator string() const;
   operator uint32_t() const;
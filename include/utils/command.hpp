@@ -8,6 +8,7 @@
 #include "errors.hpp"
 #include "utils/factory.hpp"
 #include "utils/functional.hpp"
+#include "utils/line_reader.hpp"
 
 POLYBAR_NS
 
@@ -100,6 +101,7 @@ class command<output_policy::REDIRECTED> : private command<output_policy::IGNORE
   void tail(callback<string> cb);
   int writeline(string data);
   string readline();
+  bool drain_lines(callback<string> cb);
 
   int get_stdout(int c);
   int get_stdin(int c);
@@ -108,6 +110,11 @@ class command<output_policy::REDIRECTED> : private command<output_policy::IGNORE
   int m_stdout[2]{};
   int m_stdin[2]{};
 
+  /**
+   * Reads the output, output after the last line that was read stays buffered
+   */
+  unique_ptr<line_reader> m_reader;
+
   std::mutex m_pipelock{};
 };
 
@@ -49,6 +49,33 @@ class file_descriptor {
   bool m_autoclose{true};
 };
 
+/**
+ * \brief Reads a file that is read over and over again, e.g. in /proc
+ *
+ * The descriptor stays open and the whole file is read from the start into
+ * the same buffer every time, which only grows if the file did. Files in
+ * /proc are generated anew whenever they are read from the start.
+ */
+class reread_file {
+ public:
+  explicit reread_file(const string& path);
+
+  static void read_all(const vector<reread_file*>& files);
+
+  const char* read();
+  const char* contents() const;
+  size_t size() const;
+  int get_file_descriptor() const;
+
+ protected:
+  void complete(int result);
+
+ private:
+  file_descriptor m_fd;
+  string m_buffer;
+  size_t m_size{0};
+};
+
 class fd_streambuf : public std::streambuf {
  public:
   using traits_type = std::streambuf::traits_type;
@@ -110,6 +137,8 @@ namespace file_util {
   vector<string> glob(string pattern);
   const string expand(const string& path);
   string get_config_path();
+  string get_cache_path();
+  void create_directories(const string& path);
   vector<string> list_files(const string& dirname);
 
   template <typename... Args>
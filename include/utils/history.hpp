@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+
+#include "common.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief The last samples of a value, up to a fixed capacity
+ *
+ * Samples are kept in a flat ring buffer, pushing one overwrites the oldest
+ * once the history is full. The minimum, maximum and mean are maintained as
+ * samples come and go, so reading them doesn't walk the history. Only
+ * evicting the current minimum or maximum rescans it.
+ */
+template <typename T>
+class sample_history {
+ public:
+  explicit sample_history(size_t capacity = 0) {
+    resize(capacity);
+  }
+
+  /**
+   * Drop all samples and change the capacity
+   */
+  void resize(size_t capacity) {
+    m_samples.assign(capacity, T{});
+    clear();
+  }
+
+  void clear() {
+    m_next = 0;
+    m_size = 0;
+    m_sum = 0.0;
+    m_min = T{};
+    m_max = T{};
+  }
+
+  void push(T value) {
+    if (m_samples.empty()) {
+      return;
+    }
+
+    bool full = m_size == m_samples.size();
+    T evicted = m_samples[m_next];
+
+    m_samples[m_next] = value;
+    m_next = (m_next + 1) % m_samples.size();
+
+    if (full) {
+      m_sum += static_cast<double>(value) - static_cast<double>(evicted);
+    } else {
+      m_size++;
+      m_sum += static_cast<double>(value);
+    }
+
+    if (m_size == 1) {
+      m_min = m_max = value;
+    } else if (full && (evicted <= m_min || evicted >= m_max)) {
+      rescan();
+    } else {
+      m_min = std::min(m_min, value);
+      m_max = std::max(m_max, value);
+    }
+  }
+
+  size_t size() const {
+    return m_size;
+  }
+
+  size_t capacity() const {
+    return m_samples.size();
+  }
+
+  bool empty() const {
+    return m_size == 0;
+  }
+
+  /**
+   * Sample at the given index, 0 is the oldest
+   */
+  T operator[](size_t index) const {
+    return m_samples[(m_next + m_samples.size() - m_size + index) % m_samples.size()];
+  }
+
+  /**
+   * Latest sample
+   */
+  T back() const {
+    return (*this)[m_size - 1];
+  }
+
+  T min() const {
+    return m_min;
+  }
+
+  T max() const {
+    return m_max;
+  }
+
+  double mean() const {
+    return m_size ? m_sum / static_cast<double>(m_size) : 0.0;
+  }
+
+  /**
+   * Mean of the latest `count` samples
+   */
+  double mean(size_t count) const {
+    count = std::min(count, m_size);
+    if (count == 0) {
+      return 0.0;
+    } else if (count == m_size) {
+      return mean();
+    }
+
+    double sum{0.0};
+    for (size_t i = m_size - count; i < m_size; i++) {
+      sum += static_cast<double>((*this)[i]);
+    }
+    return sum / static_cast<double>(count);
+  }
+
+  /**
+   * All samples from the oldest to the latest, scaled by `factor`
+   *
+   * Until the history is full, the oldest sample is repeated in front so
+   * that there is always one value per slot.
+   */
+  vector<double> values(double factor = 1.0) const {
+    vector<double> result;
+    if (m_size == 0) {
+      return result;
+    }
+
+    result.reserve(m_samples.size());
+    result.resize(m_samples.size() - m_size, static_cast<double>((*this)[0]) * factor);
+    for (size_t i = 0; i < m_size; i++) {
+      result.push_back(static_cast<double>((*this)[i]) * factor);
+    }
+    return result;
+  }
+
+ protected:
+  /**
+   * Recompute the minimum and maximum and the sum, which also drops the
+   * rounding errors that the sum picked up
+   */
+  void rescan() {
+    m_min = m_max = (*this)[0];
+    m_sum = 0.0;
+    for (size_t i = 0; i < m_size; i++) {
+      T value = (*this)[i];
+      m_min = std::min(m_min, value);
+      m_max = std::max(m_max, value);
+      m_sum += static_cast<double>(value);
+    }
+  }
+
+ private:
+  vector<T> m_samples;
+  // Slot that the next sample is written to
+  size_t m_next{0};
+  size_t m_size{0};
+
+  double m_sum{0.0};
+  T m_min{};
+  T m_max{};
+};
+
+POLYBAR_NS_END
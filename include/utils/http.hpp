@@ -1,23 +1,115 @@
 #pragma once
 
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+
 #include "common.hpp"
 #include "utils/factory.hpp"
+#include "utils/file.hpp"
+#include "utils/mixins.hpp"
 
 POLYBAR_NS
 
+/**
+ * Result of a transfer
+ */
+struct http_response {
+  // Empty if the transfer succeeded, the response code is only set then
+  string error;
+  long code{0};
+  string body;
+  // Headers of the last response (redirects are followed), names are lowercase
+  std::map<string, string> headers;
+
+  string header(const string& name) const;
+};
+
+/**
+ * Request for the http client and downloader
+ */
+struct http_request {
+  using body_handler = function<void(const char* data, size_t size)>;
+
+  string url;
+  string user{};
+  string password{};
+  // Additional headers, e.g. "If-Modified-Since: ..."
+  vector<string> headers{};
+  // Maximum duration of the whole transfer in seconds, 0 means no limit
+  long timeout{0};
+  // If set, the body is handed over in chunks as it arrives instead of being collected
+  body_handler on_body{};
+};
+
+/**
+ * Blocking downloader
+ *
+ * The connection is kept alive and reused between requests to the same host.
+ */
 class http_downloader {
  public:
   http_downloader(int connection_timeout = 5);
   ~http_downloader();
 
   string get(const string& url, const string& user = "", const string& password = "");
+  string get(const http_request& request);
   long response_code();
-
- protected:
-  static size_t write(void* p, size_t size, size_t bytes, void* stream);
+  string response_header(const string& name) const;
 
  private:
   void* m_curl;
+  http_response m_response;
+};
+
+/**
+ * Non-blocking http client shared by all modules
+ *
+ * Transfers are driven by the reactor, so a slow server neither blocks the
+ * calling thread nor any other transfer. Connections are cached and reused
+ * between transfers to the same host.
+ *
+ * Callbacks run on the reactor's thread and should never block for long.
+ */
+class http_client : non_copyable_mixin<http_client> {
+ public:
+  using make_type = http_client&;
+  static make_type make();
+
+  /**
+   * Identifies a transfer, 0 is never used
+   */
+  using transfer_id = unsigned int;
+  using callback = function<void(http_response&& response)>;
+
+  explicit http_client(int connection_timeout = 5);
+  ~http_client();
+
+  transfer_id get(const http_request& request, callback fn);
+  void cancel(transfer_id id);
+
+ private:
+  struct transfer;
+
+  static int socket_callback(void* easy, int fd, int what, void* userp, void* socketp);
+  static int timer_callback(void* multi, long timeout_ms, void* userp);
+
+  void on_ready(int fd, unsigned int events);
+  void on_timeout();
+  void dispatch();
+
+  int m_connection_timeout;
+
+  std::mutex m_lock;
+  void* m_multi{nullptr};
+  unique_ptr<file_descriptor> m_timer;
+  std::map<transfer_id, unique_ptr<transfer>> m_transfers;
+  transfer_id m_next_id{1};
+
+  // Held while callbacks run, so that cancel() can wait for them to return
+  std::mutex m_dispatchlock;
+  std::atomic<std::thread::id> m_dispatcher{std::thread::id{}};
 };
 
 namespace http_util {
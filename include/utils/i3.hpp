@@ -2,7 +2,10 @@
 
 #include <i3ipc++/ipc.hpp>
 
+#include <mutex>
+
 #include "common.hpp"
+#include "components/event_hub.hpp"
 #include "x11/extensions/randr.hpp"
 
 POLYBAR_NS
@@ -13,13 +16,53 @@ namespace i3_util {
   using connection_t = i3ipc::connection;
   using workspace_t = i3ipc::workspace_t;
 
-  const auto ws_numsort = [](shared_ptr<workspace_t> a, shared_ptr<workspace_t> b) { return a->num < b->num; };
+  const auto ws_numsort = [](const shared_ptr<const workspace_t>& a, const shared_ptr<const workspace_t>& b) {
+    return a->num < b->num;
+  };
 
   vector<shared_ptr<workspace_t>> workspaces(const connection_t& conn, const string& output = "");
   shared_ptr<workspace_t> focused_workspace(const connection_t&);
 
   vector<xcb_window_t> root_windows(connection& conn, const string& output_name = "");
   bool restack_to_root(connection& conn, const xcb_window_t win);
+
+  /**
+   * Workspaces and binding mode as last reported by i3
+   */
+  struct state {
+    vector<shared_ptr<const workspace_t>> workspaces;
+    string mode{"default"};
+  };
+
+  /**
+   * \brief Connection to the i3 event socket that all i3 modules share
+   *
+   * Workspace and mode events are read and applied to the state once, no
+   * matter how many modules show them.
+   */
+  class hub : public event_hub<state> {
+   public:
+    using make_type = hub&;
+    static make_type make();
+
+   protected:
+    model connect() override;
+    void disconnect() override;
+
+   private:
+    void watch();
+    void on_event();
+    static bool apply(const i3ipc::workspace_event_t& event, state& next);
+
+    // Guards the connection against being closed while an event is read
+    std::mutex m_ipc_lock;
+    unique_ptr<connection_t> m_ipc;
+    int m_fd{-1};
+
+    // Only used while handling events
+    shared_ptr<const state> m_state;
+    bool m_stale{false};
+  };
 }
 
 namespace {
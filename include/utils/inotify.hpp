@@ -2,13 +2,21 @@
 
 #include <poll.h>
 #include <sys/inotify.h>
+#include <atomic>
 #include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
 
 #include "common.hpp"
 #include "utils/factory.hpp"
+#include "utils/file.hpp"
+#include "utils/mixins.hpp"
 
 POLYBAR_NS
 
+class reactor;
+
 struct inotify_event {
   string filename;
   bool is_dir;
@@ -37,6 +45,62 @@ class inotify_watch {
   int m_mask{0};
 };
 
+/**
+ * Single inotify instance shared by all watchers of the process
+ *
+ * The inotify fd is registered with the reactor, so events are handed to the
+ * callbacks as soon as they arrive. Watch descriptors persist until the watch
+ * is removed, watches of the same path share one.
+ *
+ * Callbacks run on the reactor's thread and should never block for long.
+ */
+class inotify_multiplexer : non_copyable_mixin<inotify_multiplexer> {
+ public:
+  using make_type = inotify_multiplexer&;
+  static make_type make();
+
+  /**
+   * Identifies a watch, 0 is never used
+   */
+  using watch_id = unsigned int;
+
+  /**
+   * Invoked with the events of one read, merged like inotify_watch::get_event
+   *
+   * IN_IGNORED means that the watched file is gone, e.g. because it was
+   * replaced. The watch then no longer receives events and has to be added
+   * again.
+   */
+  using callback = function<void(const inotify_event& event)>;
+
+  explicit inotify_multiplexer(reactor& reactor);
+  ~inotify_multiplexer();
+
+  watch_id add(const string& path, int mask, callback fn);
+  void remove(watch_id id);
+
+ private:
+  struct watch {
+    string path;
+    int wd;
+    int mask;
+    callback fn;
+  };
+
+  void on_ready();
+
+  reactor& m_reactor;
+  unique_ptr<file_descriptor> m_fd;
+
+  std::mutex m_lock;
+  std::map<watch_id, watch> m_watches;
+  watch_id m_next_id{1};
+
+  // Held while callbacks run, so that remove() can wait for them to return
+  std::mutex m_dispatchlock;
+  std::atomic<std::thread::id> m_dispatcher{std::thread::id{}};
+};
+
 namespace inotify_util {
   template <typename... Args>
   decltype(auto) make_watch(Args&&... args) {
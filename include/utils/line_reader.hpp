@@ -0,0 +1,46 @@
+#pragma once
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Reads lines from a file descriptor through a buffer that lives as
+ * long as the reader
+ *
+ * The descriptor is read in chunks of up to CHUNK bytes. Whatever comes after
+ * the last complete line stays in the buffer for the next call, so no output
+ * is lost between calls and a chatty producer is read with few syscalls.
+ *
+ * A last line that isn't terminated is returned once the stream is closed.
+ */
+class line_reader : non_copyable_mixin<line_reader> {
+ public:
+  static constexpr size_t CHUNK{16384};
+
+  explicit line_reader(int fd);
+
+  bool readline(string& line);
+  bool drain_lines(const function<void(string&&)>& callback);
+
+  bool eof() const;
+  size_t buffered() const;
+
+ protected:
+  ssize_t fill();
+  bool take_line(string& line);
+
+ private:
+  int m_fd;
+  bool m_eof{false};
+
+  /**
+   * Data that wasn't returned yet starts at m_begin, the consumed part in
+   * front of it is only dropped once it makes up most of the buffer
+   */
+  string m_buffer;
+  size_t m_begin{0};
+};
+
+POLYBAR_NS_END
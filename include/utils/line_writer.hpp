@@ -0,0 +1,56 @@
+#pragma once
+
+#include <mutex>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+class reactor;
+
+/**
+ * \brief Writes whole lines to a file descriptor without blocking the caller
+ *
+ * If the descriptor is a pipe or a socket, only as much is written as it
+ * takes without blocking and the rest is kept and written by the reactor once
+ * the descriptor is writable again. Other descriptors (files, terminals) are
+ * written to directly.
+ *
+ * The descriptor itself is not made non-blocking, that flag would be shared
+ * with every other process that has the same stdout. Sockets are written to
+ * with MSG_DONTWAIT, pipes in chunks of at most PIPE_BUF bytes once poll()
+ * reports them writable, which never blocks.
+ *
+ * If the reader falls behind by more than `max_pending` bytes, the queued
+ * lines that were not started yet are dropped. A line is never cut off.
+ */
+class line_writer : non_copyable_mixin<line_writer> {
+ public:
+  explicit line_writer(reactor& r, int fd, size_t max_pending = 1024 * 1024);
+  ~line_writer();
+
+  bool write(const string& line);
+  size_t pending() const;
+
+ protected:
+  ssize_t write_some(const char* data, size_t len);
+  void flush();
+  void on_ready(int fd, unsigned int events);
+
+ private:
+  reactor& m_reactor;
+  int m_fd;
+  size_t m_max_pending;
+  bool m_pipe{false};
+  bool m_socket{false};
+
+  mutable std::mutex m_lock;
+  // Everything that was queued but not written yet
+  string m_buffer;
+  // Whether the front of m_buffer is the rest of a line that was partially written
+  bool m_partial{false};
+  bool m_watching{false};
+};
+
+POLYBAR_NS_END
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdlib>
+#include <new>
 
 #include "common.hpp"
 
@@ -27,6 +28,85 @@ namespace memory_util {
   }
 #pragma GCC diagnostic pop
 
+  /**
+   * Deleter for memory that was allocated with malloc, e.g. by xcb
+   */
+  struct free_deleter {
+    void operator()(void* p) const {
+      std::free(p);
+    }
+  };
+
+  /**
+   * Allocator that keeps up to `Keep` freed blocks per thread for reuse
+   *
+   * Meant for small objects that are created and destroyed at a high rate,
+   * e.g. the control blocks of shared pointers. A block may be freed on
+   * another thread than it was allocated on, it then goes to that thread's
+   * list.
+   */
+  template <typename T, size_t Keep = 64>
+  class pool_allocator {
+   public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+      using other = pool_allocator<U, Keep>;
+    };
+
+    pool_allocator() = default;
+    template <typename U>
+    pool_allocator(const pool_allocator<U, Keep>&) noexcept {}
+
+    T* allocate(size_t n) {
+      auto& list = free_list();
+      if (n == 1 && list.count > 0) {
+        return static_cast<T*>(list.blocks[--list.count]);
+      }
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+      auto& list = free_list();
+      if (n == 1 && list.count < Keep) {
+        list.blocks[list.count++] = p;
+      } else {
+        ::operator delete(p);
+      }
+    }
+
+    template <typename U>
+    bool operator==(const pool_allocator<U, Keep>&) const noexcept {
+      return true;
+    }
+
+    template <typename U>
+    bool operator!=(const pool_allocator<U, Keep>&) const noexcept {
+      return false;
+    }
+
+   private:
+    struct free_blocks {
+      void* blocks[Keep];
+      size_t count{0};
+
+      ~free_blocks() {
+        while (count > 0) {
+          ::operator delete(blocks[--count]);
+        }
+      }
+    };
+
+    /**
+     * Blocks of sizeof(T) bytes, one list per type and thread
+     */
+    static free_blocks& free_list() {
+      static thread_local free_blocks list;
+      return list;
+    }
+  };
+
   /**
    * Get the number of elements in T
    */
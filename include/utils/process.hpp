@@ -15,6 +15,10 @@ namespace process_util {
   pid_t spawn_async(std::function<void()> const& lambda);
   void fork_detached(std::function<void()> const& lambda);
 
+  pid_t spawn_sh(const string& cmd, int in = -1, int out = -1, int err = -1, bool new_session = true);
+  void spawn_detached(const string& cmd);
+  pid_t spawn(const char* const* argv, int in, int out, int err, bool new_session);
+
   void exec(char* cmd, char** args);
   void exec_sh(const char* cmd);
 
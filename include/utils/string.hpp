@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <sstream>
 
 #include "common.hpp"
@@ -63,7 +64,9 @@ namespace string_util {
 
   bool contains(const string& haystack, const string& needle);
   string upper(const string& s);
+  string upper(string&& s);
   string lower(const string& s);
+  string lower(string&& s);
   bool compare(const string& s1, const string& s2);
 
   string replace(const string& haystack, const string& needle, const string& replacement, size_t start = 0,
@@ -71,14 +74,41 @@ namespace string_util {
   string replace_all(const string& haystack, const string& needle, const string& replacement, size_t start = 0,
       size_t end = string::npos);
 
+  bool replace_inplace(string& haystack, const string& needle, const string& replacement, size_t start = 0,
+      size_t end = string::npos);
+  size_t replace_all_inplace(string& haystack, const string& needle, const string& replacement, size_t start = 0,
+      size_t end = string::npos);
+
   string squeeze(const string& haystack, char needle);
 
   string strip(const string& haystack, char needle);
   string strip_trailing_newline(const string& haystack);
 
-  string ltrim(string value, function<bool(char)> pred);
-  string rtrim(string value, function<bool(char)> pred);
-  string trim(string value, function<bool(char)> pred);
+  /**
+   * Trims all characters that match pred from the left
+   */
+  template <typename Pred>
+  string ltrim(string value, Pred pred) {
+    value.erase(value.begin(), std::find_if(value.begin(), value.end(), [&](char c) { return !pred(c); }));
+    return value;
+  }
+
+  /**
+   * Trims all characters that match pred from the right
+   */
+  template <typename Pred>
+  string rtrim(string value, Pred pred) {
+    value.erase(std::find_if(value.rbegin(), value.rend(), [&](char c) { return !pred(c); }).base(), value.end());
+    return value;
+  }
+
+  /**
+   * Trims all characters that match pred from both sides
+   */
+  template <typename Pred>
+  string trim(string value, Pred pred) {
+    return ltrim(rtrim(move(value), pred), pred);
+  }
 
   string ltrim(string&& value, const char& needle = ' ');
   string rtrim(string&& value, const char& needle = ' ');
@@ -88,6 +118,7 @@ namespace string_util {
   string utf8_truncate(string&& value, size_t len);
 
   string join(const vector<string>& strs, const string& delim);
+  void append_json(string& dst, const string& value);
   vector<string> split(const string& s, char delim);
   std::vector<std::string> tokenize(const string& str, char delimiters);
 
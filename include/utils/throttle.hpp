@@ -81,6 +81,35 @@ namespace throttle_util {
     timewindow m_timewindow{};
   };
 
+  /**
+   * Budget for the rate of events and the time spent on them
+   *
+   * Both are counted within a sliding window, a limit of zero disables the
+   * respective check. Not thread safe.
+   */
+  class budget {
+   public:
+    explicit budget(limit max_events, timewindow max_busy, timewindow window = chrono::seconds(1));
+
+    void event();
+    void spend(timewindow busy);
+    bool exceeded();
+
+    limit max_events() const;
+    timewindow max_busy() const;
+
+   private:
+    void expire(timepoint now);
+
+    limit m_max_events;
+    timewindow m_max_busy;
+    timewindow m_window;
+
+    queue m_events{};
+    std::deque<std::pair<timepoint, timewindow>> m_busy{};
+    timewindow m_busy_sum{};
+  };
+
   using throttle_t = unique_ptr<event_throttler>;
 
   template <typename... Args>
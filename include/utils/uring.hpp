@@ -0,0 +1,65 @@
+#pragma once
+
+#include "common.hpp"
+#include "settings.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+/**
+ * \brief Minimal io_uring instance that reads several files with one syscall
+ *
+ * Only what reread_file::read_all() needs: every read starts at offset 0 and
+ * all of them are submitted and waited for with a single io_uring_enter().
+ * Built without io_uring support, or if the kernel doesn't allow it, make()
+ * returns nullptr and the caller falls back to pread.
+ *
+ * An instance must only be used by one thread at a time.
+ */
+class uring : non_copyable_mixin<uring> {
+ public:
+  struct request {
+    int fd;
+    char* buffer;
+    size_t size;
+    // Bytes read or -errno
+    int result;
+  };
+
+  static constexpr unsigned ENTRIES{32};
+
+  static uring* local();
+  static void discard();
+
+  explicit uring();
+  ~uring();
+
+  void read(vector<request>& requests);
+
+ protected:
+  void submit(request* requests, size_t count);
+  size_t reap(request* requests, size_t count, size_t& pending);
+  void release();
+
+ private:
+  int m_fd{-1};
+
+  void* m_sq_ring{nullptr};
+  size_t m_sq_ring_size{0};
+  void* m_cq_ring{nullptr};
+  size_t m_cq_ring_size{0};
+  void* m_sqes{nullptr};
+  size_t m_sqes_size{0};
+
+  unsigned* m_sq_head{nullptr};
+  unsigned* m_sq_tail{nullptr};
+  unsigned* m_sq_mask{nullptr};
+  unsigned* m_sq_array{nullptr};
+  unsigned* m_cq_head{nullptr};
+  unsigned* m_cq_tail{nullptr};
+  unsigned* m_cq_mask{nullptr};
+  void* m_cqes{nullptr};
+  unsigned m_entries{0};
+};
+
+POLYBAR_NS_END
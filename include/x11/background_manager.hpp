@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -12,11 +13,13 @@
 
 POLYBAR_NS
 
+class config;
+class file_descriptor;
 class logger;
+class reactor;
 
 namespace cairo {
   class surface;
-  class xcb_surface;
 }
 
 class bg_slice {
@@ -38,6 +41,7 @@ class bg_slice {
 
  private:
   bg_slice(connection& conn, const logger& log, xcb_rectangle_t rect, xcb_window_t window, xcb_visualtype_t* visual);
+  bg_slice(connection& conn, xcb_rectangle_t rect, xcb_window_t window, std::shared_ptr<bg_slice> source, int x, int y);
 
   // standard components
   connection& m_connection;
@@ -48,9 +52,12 @@ class bg_slice {
 
   // cache for the root window background at this slice's position
   xcb_pixmap_t m_pixmap{XCB_NONE};
-  unique_ptr<cairo::xcb_surface> m_surface;
+  unique_ptr<cairo::surface> m_surface;
   xcb_gcontext_t m_gcontext{XCB_NONE};
 
+  // slice that covers this one, if set this slice has no cache of its own and shows part of the source's
+  std::shared_ptr<bg_slice> m_source;
+
   void allocate_resources(const logger& log, xcb_visualtype_t* visual);
   void free_resources();
 
@@ -76,7 +83,8 @@ class background_manager : public signal_receiver<SIGN_PRIORITY_SCREEN, signals:
    *
    * To observe a slice of the background you need to call background_manager::activate.
    */
-  explicit background_manager(connection& conn, signal_emitter& sig, const logger& log);
+  explicit background_manager(
+      connection& conn, signal_emitter& sig, const config& conf, const logger& log, reactor& reactor);
   ~background_manager();
 
   /**
@@ -91,6 +99,9 @@ class background_manager : public signal_receiver<SIGN_PRIORITY_SCREEN, signals:
    * caches the background. If you don't need the background anymore, destroy the shared_ptr to free up
    * resources.
    *
+   * If an observed slice already covers the given area (e.g. the tray inside the bar), the returned slice
+   * shows that part of it instead of keeping another copy of the background.
+   *
    * \param rect Slice of the background to observe (coordinates relative to window).
    * \param window Coordinates are interpreted relative to this window
    */
@@ -116,9 +127,26 @@ class background_manager : public signal_receiver<SIGN_PRIORITY_SCREEN, signals:
   // true if we are currently attached as a listener for desktop background changes
   bool m_attached{false};
 
+  // root pixmap the slices were last filled from
+  xcb_pixmap_t m_root_pixmap{XCB_NONE};
+  int m_root_depth{0};
+  xcb_rectangle_t m_root_geom{0, 0, 0U, 0U};
+
+  // changes of the root pixmap that follow the last copy closer than this are delayed, 0 disables it
+  std::chrono::milliseconds m_debounce{0};
+  std::chrono::steady_clock::time_point m_last_copy{};
+  reactor& m_reactor;
+  unique_ptr<file_descriptor> m_timer;
+  bool m_timer_armed{false};
+
   void allocate_resources();
   void free_resources();
+  bool update_root_pixmap();
+  void copy_root_pixmap(const std::vector<std::shared_ptr<bg_slice>>& slices);
+  std::vector<std::shared_ptr<bg_slice>> live_slices();
   void fetch_root_pixmap();
+  void schedule_fetch(std::chrono::milliseconds delay);
+  std::shared_ptr<bg_slice> find_covering_slice(xcb_rectangle_t rect, xcb_window_t window, int& x, int& y);
 
 };
 
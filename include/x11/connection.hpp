@@ -2,12 +2,19 @@
 
 #include <xcb/xcb.h>
 #include <cstdlib>
+#include <map>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <unordered_map>
 #include <xpp/core.hpp>
 #include <xpp/generic/factory.hpp>
 #include <xpp/proto/x.hpp>
 
 #include "common.hpp"
 #include "components/screen.hpp"
+#include "utils/memory.hpp"
+#include "utils/mixins.hpp"
 #include "x11/extensions/all.hpp"
 #include "x11/registry.hpp"
 #include "x11/types.hpp"
@@ -102,6 +109,22 @@ class connection : public detail::connection_base<connection&, XPP_EXTENSION_LIS
   using make_type = connection&;
   static make_type make(xcb_connection_t* conn = nullptr, int default_screen = 0);
 
+  /**
+   * \brief Batches the flushes of the current thread
+   *
+   * While a frame is open, request_flush() only notes that there is output
+   * to send and the output buffer is flushed once when the outermost frame of
+   * the thread ends. Frames of other threads are not affected.
+   */
+  class frame : non_copyable_mixin<frame> {
+   public:
+    explicit frame(connection& conn);
+    ~frame();
+
+   private:
+    connection& m_connection;
+  };
+
   explicit connection(xcb_connection_t* c, int default_screen);
   ~connection();
 
@@ -116,11 +139,18 @@ class connection : public detail::connection_base<connection&, XPP_EXTENSION_LIS
 
   xcb_screen_t* screen(bool realloc = false);
 
+  void request_flush();
+
   string id(xcb_window_t w) const;
 
   void ensure_event_mask(xcb_window_t win, unsigned int event);
+  void ensure_event_mask(const vector<xcb_window_t>& windows, unsigned int event);
   void clear_event_mask(xcb_window_t win);
 
+  using property_t = shared_ptr<xcb_get_property_reply_t>;
+  property_t cached_property(xcb_window_t win, xcb_atom_t atom, xcb_atom_t type) const;
+  vector<property_t> cached_properties(const vector<xcb_window_t>& windows, xcb_atom_t atom, xcb_atom_t type) const;
+
   shared_ptr<xcb_client_message_event_t> make_client_message(xcb_atom_t type, xcb_window_t target) const;
   void send_client_message(const shared_ptr<xcb_client_message_event_t>& message, xcb_window_t target,
       unsigned int event_mask = 0xFFFFFF, bool propagate = false) const;
@@ -132,12 +162,18 @@ class connection : public detail::connection_base<connection&, XPP_EXTENSION_LIS
 
   static string error_str(int error_code);
 
-  void dispatch_event(const shared_ptr<xcb_generic_event_t>& evt) const;
+  /**
+   * Event as returned by xcb
+   */
+  using event_ptr = unique_ptr<xcb_generic_event_t, memory_util::free_deleter>;
+
+  event_ptr poll_event() const;
+  void dispatch_event(event_ptr&& evt) const;
 
   template <typename Event, unsigned int ResponseType>
   void wait_for_response(function<bool(const Event*)> check_event) {
     int fd = get_file_descriptor();
-    shared_ptr<xcb_generic_event_t> evt{};
+    event_ptr evt{};
     while (!connection_has_error()) {
       fd_set fds;
       FD_ZERO(&fds);
@@ -145,29 +181,93 @@ class connection : public detail::connection_base<connection&, XPP_EXTENSION_LIS
 
       if (!select(fd + 1, &fds, nullptr, nullptr, nullptr)) {
         continue;
-      } else if ((evt = shared_ptr<xcb_generic_event_t>(xcb_poll_for_event(*this), free)) == nullptr) {
+      } else if (!(evt = poll_event())) {
         continue;
-      } else if (evt->response_type != ResponseType) {
+      }
+
+      // Skipped events still have to invalidate the cached properties
+      invalidate_properties(*evt);
+
+      if (evt->response_type != ResponseType) {
         continue;
-      } else if (check_event(reinterpret_cast<const Event*>(&*evt))) {
+      } else if (check_event(reinterpret_cast<const Event*>(evt.get()))) {
         break;
       }
     }
   }
 
+  /**
+   * Attach the sink to the event registry
+   *
+   * PropertyNotify events are only dispatched if at least one sink listed
+   * their atom in `atoms`, so sinks that handle them have to list every atom
+   * they look at.
+   */
   template <typename Sink>
-  void attach_sink(Sink&& sink, registry::priority prio = 0) {
+  void attach_sink(Sink&& sink, registry::priority prio = 0, vector<xcb_atom_t> atoms = {}) {
+    watch_atoms(static_cast<const void*>(sink), move(atoms));
     m_registry.attach(prio, forward<Sink>(sink));
   }
 
   template <typename Sink>
   void detach_sink(Sink&& sink, registry::priority prio = 0) {
     m_registry.detach(prio, forward<Sink>(sink));
+    watch_atoms(static_cast<const void*>(sink), {});
   }
 
  protected:
+  static constexpr size_t MAX_CACHED_PROPERTIES{4096};
+
+  void watch_properties(xcb_window_t win);
+  void invalidate_properties(const xcb_generic_event_t& evt) const;
+
+  void watch_atoms(const void* sink, vector<xcb_atom_t> atoms);
+  bool wanted(const xcb_generic_event_t& evt) const;
+
   registry m_registry{*this};
   xcb_screen_t* m_screen{nullptr};
+
+  /**
+   * \brief Cached properties by window, atom and type
+   *
+   * Only properties of windows whose changes are reported to us are cached,
+   * each entry is dropped as soon as the PropertyNotify for it arrives and
+   * all entries of a window when it is unmapped or destroyed.
+   */
+  mutable std::map<std::tuple<xcb_window_t, xcb_atom_t, xcb_atom_t>, property_t> m_properties;
+
+  /**
+   * \brief Windows that have XCB_EVENT_MASK_PROPERTY_CHANGE set
+   */
+  mutable std::set<xcb_window_t> m_property_windows;
+
+  /**
+   * \brief Incremented whenever cached properties are dropped
+   *
+   * A reply that was requested before a change can arrive after the
+   * PropertyNotify was handled, it is not cached if this changed in between.
+   */
+  mutable size_t m_property_generation{0};
+
+  /**
+   * \brief Guards m_properties, m_property_windows and m_property_generation
+   */
+  mutable std::mutex m_property_lock;
+
+  /**
+   * \brief Property atoms each sink handles
+   */
+  std::unordered_map<const void*, vector<xcb_atom_t>> m_sink_atoms;
+
+  /**
+   * \brief Number of sinks that handle each property atom
+   */
+  std::unordered_map<xcb_atom_t, size_t> m_watched_atoms;
+
+  /**
+   * \brief Guards m_sink_atoms and m_watched_atoms
+   */
+  mutable std::mutex m_atoms_lock;
 };
 
 POLYBAR_NS_END
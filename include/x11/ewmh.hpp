@@ -12,6 +12,7 @@ struct position;
 using ewmh_connection_t = malloc_ptr_t<xcb_ewmh_connection_t>;
 
 namespace ewmh_util {
+  void request_atoms(xcb_connection_t* conn);
   ewmh_connection_t initialize();
 
   bool supports(xcb_atom_t atom, int screen = 0);
@@ -21,14 +22,24 @@ namespace ewmh_util {
   string get_icon_name(xcb_window_t win);
   string get_reply_string(xcb_ewmh_get_utf8_strings_reply_t* reply);
 
+  /**
+   * Desktop names and the number of desktops, which may not match
+   */
+  struct desktop_list {
+    vector<string> names;
+    unsigned int count;
+  };
+
   vector<position> get_desktop_viewports(int screen = 0);
   vector<string> get_desktop_names(int screen = 0);
   unsigned int get_current_desktop(int screen = 0);
   unsigned int get_number_of_desktops(int screen = 0);
+  desktop_list get_desktop_list(int screen = 0);
   xcb_window_t get_active_window(int screen = 0);
 
   void change_current_desktop(unsigned int desktop);
   unsigned int get_desktop_from_window(xcb_window_t window);
+  vector<unsigned int> get_desktops_from_windows(const vector<xcb_window_t>& windows);
 
   void set_wm_window_type(xcb_window_t win, vector<xcb_atom_t> types);
 
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "settings.hpp"
+
+#if not WITH_XPRESENT
+#error "X Present extension is disabled..."
+#endif
+
+#include <xcb/present.h>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+// fwd
+class connection;
+
+namespace present_util {
+  bool query_extension(connection& conn);
+}
+
+/**
+ * Two pixmaps that are shown on a window in turns with PresentPixmap
+ *
+ * The X server (or a compositor) may keep reading from a pixmap after it was
+ * presented. The server reports with an IdleNotify event once it is done with
+ * it, and a pixmap is only handed out for drawing again after that.
+ */
+class present_buffers : non_copyable_mixin<present_buffers> {
+ public:
+  explicit present_buffers(connection& conn, xcb_window_t window, uint8_t depth, uint16_t width, uint16_t height);
+  ~present_buffers();
+
+  xcb_pixmap_t acquire();
+  void present();
+
+ protected:
+  void process_events(bool wait);
+
+ private:
+  connection& m_connection;
+  xcb_window_t m_window;
+
+  xcb_pixmap_t m_pixmaps[2]{XCB_NONE, XCB_NONE};
+
+  /**
+   * Number of presents of each pixmap the server hasn't reported as idle yet
+   */
+  unsigned int m_busy[2]{0U, 0U};
+
+  /**
+   * Pixmap that is drawn into and that present() shows
+   */
+  size_t m_current{0};
+
+  /**
+   * Pixmap that was shown last
+   */
+  size_t m_shown{1};
+
+  uint32_t m_serial{0};
+  xcb_present_event_t m_eid{XCB_NONE};
+  xcb_special_event_t* m_events{nullptr};
+};
+
+POLYBAR_NS_END
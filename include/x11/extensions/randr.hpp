@@ -61,6 +61,8 @@ namespace randr_util {
       connection& conn, xcb_window_t root, bool connected_only = false, bool purge_clones = true);
   monitor_t match_monitor(vector<monitor_t> monitors, const string& name, bool exact_match);
 
+  double get_refresh_rate(connection& conn, const monitor_t& mon);
+
   void get_backlight_range(connection& conn, const monitor_t& mon, backlight_values& dst);
   void get_backlight_value(connection& conn, const monitor_t& mon, backlight_values& dst);
 }  // namespace randr_util
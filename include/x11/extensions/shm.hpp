@@ -0,0 +1,57 @@
+#pragma once
+
+#include "settings.hpp"
+
+#if not WITH_XSHM
+#error "X MIT-SHM extension is disabled..."
+#endif
+
+#include <xcb/shm.h>
+
+#include "common.hpp"
+#include "utils/mixins.hpp"
+
+POLYBAR_NS
+
+// fwd
+class connection;
+
+namespace shm_util {
+  bool query_extension(connection& conn);
+}
+
+/**
+ * Client side image stored in a shared memory segment that is attached to
+ * the X server, so that it can be put onto drawables without sending the
+ * pixel data over the connection.
+ *
+ * Uses 32 bits per pixel, which matches cairo's image formats.
+ */
+class shm_image : non_copyable_mixin<shm_image> {
+ public:
+  explicit shm_image(connection& conn, uint8_t depth, uint16_t width, uint16_t height);
+  ~shm_image();
+
+  unsigned char* data() const;
+  int stride() const;
+
+  void put(xcb_drawable_t dst, xcb_gcontext_t gc, const xcb_rectangle_t& area);
+  void sync();
+
+ private:
+  connection& m_connection;
+  uint8_t m_depth;
+  uint16_t m_width;
+  uint16_t m_height;
+
+  int m_shmid{-1};
+  xcb_shm_seg_t m_seg{XCB_NONE};
+  unsigned char* m_data{nullptr};
+
+  /**
+   * Set while the server may still read from the segment
+   */
+  bool m_pending{false};
+};
+
+POLYBAR_NS_END
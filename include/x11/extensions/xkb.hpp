@@ -67,7 +67,7 @@ class keyboard {
       , current_group(group) {}
 
   const indicator& get(const indicator::type& i) const;
-  void set(unsigned int state);
+  bool set(unsigned int state);
   bool on(const indicator::type&) const;
   void current(unsigned char group);
   unsigned char current() const;
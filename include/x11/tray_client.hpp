@@ -30,8 +30,8 @@ class tray_client {
   xcb_window_t window() const;
   xembed_data* xembed() const;
 
-  void ensure_state() const;
-  void reconfigure(int x, int y) const;
+  void ensure_state(vector<xcb_void_cookie_t>& requests) const;
+  bool reconfigure(int x, int y, vector<xcb_void_cookie_t>& requests);
   void configure_notify(int x, int y) const;
 
  protected:
@@ -43,6 +43,10 @@ class tray_client {
 
   unsigned int m_width;
   unsigned int m_height;
+
+  bool m_configured{false};
+  int m_x{0};
+  int m_y{0};
 };
 
 POLYBAR_NS_END
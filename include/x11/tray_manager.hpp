@@ -91,14 +91,16 @@ class tray_manager : public xpp::event::sink<evt::expose, evt::visibility_notify
   const tray_settings settings() const;
 
   void setup(const bar_settings& bar_opts);
+  void move(int dx, int dy);
   void activate();
   void activate_delayed(chrono::duration<double, std::milli> delay = 1s);
   void deactivate(bool clear_selection = true);
   void reconfigure();
+  void events_handled();
 
  protected:
-  void reconfigure_window();
-  void reconfigure_clients();
+  bool reconfigure_window();
+  vector<shared_ptr<tray_client>> reconfigure_clients();
   void reconfigure_bg(bool realloc = false);
   void refresh_window();
   void redraw_window(bool realloc_bg = false);
@@ -115,7 +117,8 @@ class tray_manager : public xpp::event::sink<evt::expose, evt::visibility_notify
   void notify_clients_delayed();
 
   void track_selection_owner(xcb_window_t owner);
-  void process_docking_request(xcb_window_t win);
+  void process_docking_requests();
+  bool check_requests(const vector<xcb_void_cookie_t>& requests);
 
   int calculate_x(unsigned width, bool abspos = true) const;
   int calculate_y(bool abspos = true) const;
@@ -157,6 +160,11 @@ class tray_manager : public xpp::event::sink<evt::expose, evt::visibility_notify
   std::shared_ptr<bg_slice> m_bg_slice;
   vector<shared_ptr<tray_client>> m_clients;
 
+  /**
+   * Windows that requested to be docked during the current burst of events
+   */
+  vector<xcb_window_t> m_pending_docks;
+
   tray_settings m_opts{};
 
   xcb_gcontext_t m_gc{0};
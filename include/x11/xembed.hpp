@@ -31,6 +31,7 @@ struct xembed_data {
 
 namespace xembed {
   xembed_data* query(connection& conn, xcb_window_t win, xembed_data* data);
+  bool parse_info(const xcb_get_property_reply_t* reply, xembed_data* data);
   void send_message(connection& conn, xcb_window_t target, long message, long d1, long d2, long d3);
   void send_focus_event(connection& conn, xcb_window_t target);
   void notify_embedded(connection& conn, xcb_window_t win, xcb_window_t embedder, long version);
@@ -8,6 +8,9 @@
 
 #include <xcb/xcb_xrm.h>
 
+#include <mutex>
+#include <unordered_map>
+
 #include "common.hpp"
 #include "errors.hpp"
 #include "utils/string.hpp"
@@ -35,13 +38,7 @@ class xresource_manager {
 
   template <typename T>
   T require(const char* name) const {
-    char* result{nullptr};
-    if (xcb_xrm_resource_get_string(m_xrm, string_util::replace(name, "*", ".").c_str(), nullptr, &result) == -1) {
-      throw xresource_error(sstream() << "X resource \"" << name << "\" not found");
-    } else if (result == nullptr) {
-      throw xresource_error(sstream() << "X resource \"" << name << "\" not found");
-    }
-    return convert<T>(string(result));
+    return convert<T>(lookup(name));
   }
 
   template <typename T>
@@ -57,8 +54,25 @@ class xresource_manager {
   template <typename T>
   T convert(string&& value) const;
 
+  string lookup(const string& name) const;
+
  private:
   xcb_xrm_database_t* m_xrm;
+
+  /**
+   * Result of every name that was looked up, resources that weren't found
+   * are kept as well
+   *
+   * The database is loaded once, so the results don't change. Configs refer
+   * to the same few resources over and over, this way each of them is only
+   * matched against the database once.
+   */
+  struct result {
+    bool found;
+    string value;
+  };
+  mutable std::mutex m_lock;
+  mutable std::unordered_map<string, result> m_results;
 };
 
 POLYBAR_NS_END
@@ -67,29 +67,24 @@ namespace alsa {
   }
 
   /**
-   * Wait for events
+   * Get the descriptors that become readable when there are control events
    */
-  bool control::wait(int timeout) {
+  vector<int> control::get_file_descriptors() const {
     assert(m_ctl);
 
-    int err{0};
-
-    if ((err = snd_ctl_wait(m_ctl, timeout)) == -1) {
-      throw_exception<control_error>("Failed to wait for events", err);
+    int count = snd_ctl_poll_descriptors_count(m_ctl);
+    if (count < 0) {
+      throw_exception<control_error>("Failed to get poll descriptors", count);
     }
 
-    snd_ctl_event_t* event{nullptr};
-    snd_ctl_event_alloca(&event);
+    vector<struct pollfd> pfds(count);
+    snd_ctl_poll_descriptors(m_ctl, pfds.data(), pfds.size());
 
-    if ((err = snd_ctl_read(m_ctl, event)) == -1) {
-      return false;
+    vector<int> fds;
+    for (auto&& pfd : pfds) {
+      fds.emplace_back(pfd.fd);
     }
-
-    if (snd_ctl_event_get_type(event) == SND_CTL_EVENT_ELEM) {
-      return snd_ctl_event_elem_get_mask(event) & SND_CTL_EVENT_MASK_VALUE;
-    }
-
-    return false;
+    return fds;
   }
 
   /**
@@ -111,10 +106,31 @@ namespace alsa {
   }
 
   /**
-   * Process queued events
+   * Process queued events without blocking
+   *
+   * Returns the number of value changes
    */
-  void control::process_events() {
-    wait(0);
+  int control::process_events() {
+    assert(m_ctl);
+
+    snd_ctl_event_t* event{nullptr};
+    snd_ctl_event_alloca(&event);
+
+    int err{0};
+    int changes{0};
+
+    while ((err = snd_ctl_read(m_ctl, event)) > 0) {
+      if (snd_ctl_event_get_type(event) == SND_CTL_EVENT_ELEM &&
+          (snd_ctl_event_elem_get_mask(event) & SND_CTL_EVENT_MASK_VALUE)) {
+        changes++;
+      }
+    }
+
+    if (err < 0 && err != -EAGAIN) {
+      throw_exception<control_error>("Failed to read events", err);
+    }
+
+    return changes;
   }
 }
 
@@ -66,22 +66,31 @@ namespace alsa {
   }
 
   /**
-   * Wait for events
+   * Get the descriptors that become readable when there are mixer events
    */
-  bool mixer::wait(int timeout) {
+  vector<int> mixer::get_file_descriptors() const {
     assert(m_mixer);
 
-    int err = 0;
-
-    if ((err = snd_mixer_wait(m_mixer, timeout)) == -1) {
-      throw_exception<mixer_error>("Failed to wait for events", err);
+    int count = snd_mixer_poll_descriptors_count(m_mixer);
+    if (count < 0) {
+      throw_exception<mixer_error>("Failed to get poll descriptors", count);
     }
 
-    return process_events() > 0;
+    vector<struct pollfd> pfds(count);
+    snd_mixer_poll_descriptors(m_mixer, pfds.data(), pfds.size());
+
+    vector<int> fds;
+    for (auto&& pfd : pfds) {
+      fds.emplace_back(pfd.fd);
+    }
+    return fds;
   }
 
   /**
    * Process queued mixer events
+   *
+   * The mixer's controls are non-blocking, so this returns 0 right away when
+   * there are no events
    */
   int mixer::process_events() {
     int num_events{0};
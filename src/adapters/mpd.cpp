@@ -1,5 +1,13 @@
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
 #include <csignal>
+#include <cstddef>
 #include <thread>
 #include <utility>
 
@@ -125,6 +133,63 @@ namespace mpd {
   // }}}
   // class: mpdconnection {{{
 
+  namespace {
+    /**
+     * Open a non-blocking socket and start connecting it to the host
+     *
+     * Like libmpdclient, hosts starting with '/' are unix sockets and hosts
+     * starting with '@' are abstract unix sockets
+     */
+    int open_socket(const string& host, unsigned int port) {
+      int fd{-1};
+
+      if (!host.empty() && (host[0] == '/' || host[0] == '@')) {
+        struct sockaddr_un addr {};
+        addr.sun_family = AF_UNIX;
+        if (host.size() >= sizeof(addr.sun_path)) {
+          throw client_error("Socket path is too long", MPD_ERROR_ARGUMENT);
+        }
+        memcpy(addr.sun_path, host.data(), host.size());
+        if (host[0] == '@') {
+          addr.sun_path[0] = '\0';
+        }
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        auto len = host[0] == '@' ? offsetof(sockaddr_un, sun_path) + host.size() : sizeof(addr);
+        if (fd != -1 && ::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), len) == -1 && errno != EINPROGRESS &&
+            errno != EAGAIN) {
+          int error = errno;
+          ::close(fd);
+          throw client_error("Failed to connect: "s + strerror(error), MPD_ERROR_SYSTEM);
+        }
+      } else {
+        struct addrinfo hints {};
+        hints.ai_flags = AI_ADDRCONFIG | AI_NUMERICSERV;
+        hints.ai_socktype = SOCK_STREAM;
+        struct addrinfo* info{nullptr};
+
+        int err = getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &info);
+        if (err != 0 || info == nullptr) {
+          throw client_error("Failed to resolve host \"" + host + "\": " + gai_strerror(err), MPD_ERROR_RESOLVER);
+        }
+
+        fd = socket(info->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd != -1 && ::connect(fd, info->ai_addr, info->ai_addrlen) == -1 && errno != EINPROGRESS) {
+          int error = errno;
+          ::close(fd);
+          freeaddrinfo(info);
+          throw client_error("Failed to connect: "s + strerror(error), MPD_ERROR_SYSTEM);
+        }
+        freeaddrinfo(info);
+      }
+
+      if (fd == -1) {
+        throw client_error("Failed to open socket: "s + strerror(errno), MPD_ERROR_SYSTEM);
+      }
+      return fd;
+    }
+  }  // namespace
+
   mpdconnection::mpdconnection(
       const logger& logger, string host, unsigned int port, string password, unsigned int timeout)
       : m_log(logger), m_host(move(host)), m_port(port), m_password(move(password)), m_timeout(timeout) {
@@ -136,11 +201,14 @@ namespace mpd {
   }
 
   mpdconnection::~mpdconnection() {
+    disconnect();
     m_signal_action.sa_handler = SIG_DFL;
     sigaction(SIGPIPE, &m_signal_action, nullptr);
   }
 
   void mpdconnection::connect() {
+    disconnect();
+
     try {
       m_log.trace("mpdconnection.connect: %s, %i, \"%s\", timeout: %i", m_host, m_port, m_password, m_timeout);
       m_connection.reset(mpd_connection_new(m_host.c_str(), m_port, m_timeout * 1000));
@@ -161,14 +229,140 @@ namespace mpd {
     }
   }
 
+  /**
+   * Start or continue connecting without blocking
+   *
+   * The socket is non-blocking and every call only does what is possible
+   * right away. Wait for connect_events() on get_fd() or for
+   * connect_timeout() before calling it again.
+   *
+   * Only resolving a host name may block, addresses and sockets don't.
+   *
+   * \returns true once the connection is ready
+   */
+  bool mpdconnection::connect_async() {
+    if (connected()) {
+      return true;
+    }
+
+    try {
+      if (m_attempt == attempt::NONE) {
+        m_log.trace("mpdconnection.connect_async: %s, %i, timeout: %i", m_host, m_port, m_timeout);
+        m_attempt_deadline = chrono::steady_clock::now() + chrono::seconds{m_timeout};
+        m_welcome.clear();
+        m_fd = open_socket(m_host, m_port);
+        m_attempt = attempt::CONNECT;
+      }
+
+      if (chrono::steady_clock::now() >= m_attempt_deadline) {
+        throw client_error("Timeout while connecting", MPD_ERROR_TIMEOUT);
+      }
+
+      struct pollfd pfd {};
+      pfd.fd = m_fd;
+      pfd.events = connect_events();
+      if (::poll(&pfd, 1, 0) <= 0) {
+        return false;
+      }
+
+      if (m_attempt == attempt::CONNECT) {
+        int error{0};
+        socklen_t size{sizeof(error)};
+        getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &size);
+        if (error != 0) {
+          throw client_error("Failed to connect: "s + strerror(error), MPD_ERROR_SYSTEM);
+        }
+        m_attempt = attempt::WELCOME;
+        return false;
+      }
+
+      if (m_attempt == attempt::WELCOME) {
+        char buffer[256];
+        ssize_t bytes = ::read(m_fd, buffer, sizeof(buffer));
+        if (bytes == -1 && (errno == EAGAIN || errno == EINTR)) {
+          return false;
+        } else if (bytes <= 0) {
+          throw client_error("Connection closed before the welcome message", MPD_ERROR_CLOSED);
+        }
+
+        m_welcome.append(buffer, bytes);
+        auto end = m_welcome.find('\n');
+        if (end == string::npos) {
+          return false;
+        }
+        m_welcome.erase(end);
+
+        // The connection takes over the socket
+        auto async = mpd_async_new(m_fd);
+        if (async == nullptr) {
+          throw client_error("Out of memory", MPD_ERROR_OOM);
+        }
+        m_connection.reset(mpd_connection_new_async(async, m_welcome.c_str()));
+        if (!m_connection) {
+          mpd_async_free(async);
+          m_fd = -1;
+          throw client_error("Out of memory", MPD_ERROR_OOM);
+        }
+        check_errors(m_connection.get());
+        mpd_connection_set_timeout(m_connection.get(), m_timeout * 1000);
+
+        if (m_password.empty()) {
+          m_attempt = attempt::NONE;
+          return true;
+        }
+
+        mpd_send_password(m_connection.get(), m_password.c_str());
+        check_errors(m_connection.get());
+        m_attempt = attempt::PASSWORD;
+        return false;
+      }
+
+      mpd_response_finish(m_connection.get());
+      check_errors(m_connection.get());
+      m_attempt = attempt::NONE;
+      return true;
+    } catch (const mpd_exception& e) {
+      disconnect();
+      throw;
+    }
+  }
+
+  /**
+   * Events on get_fd() the running attempt of connect_async() waits for
+   */
+  short mpdconnection::connect_events() const {
+    return m_attempt == attempt::CONNECT ? POLLOUT : POLLIN;
+  }
+
+  /**
+   * Milliseconds until the running attempt of connect_async() times out
+   */
+  int mpdconnection::connect_timeout() const {
+    auto remaining = m_attempt_deadline - chrono::steady_clock::now();
+    return std::max<int>(chrono::duration_cast<chrono::milliseconds>(remaining).count() + 1, 0);
+  }
+
   void mpdconnection::disconnect() {
+    if (!m_connection && m_fd != -1) {
+      // A socket that wasn't handed over to a connection yet
+      ::close(m_fd);
+    }
     m_connection.reset();
+    m_fd = -1;
+    m_attempt = attempt::NONE;
     m_idle = false;
     m_listactive = false;
   }
 
   bool mpdconnection::connected() {
-    return m_connection && m_connection != nullptr;
+    return m_connection && m_connection != nullptr && m_attempt == attempt::NONE;
+  }
+
+  /**
+   * Whether connect_async() has an attempt running
+   */
+  bool mpdconnection::connecting() const {
+    return m_attempt != attempt::NONE;
   }
 
   bool mpdconnection::retry_connection(int interval) {
@@ -382,7 +576,7 @@ namespace mpd {
 
   void mpdstatus::fetch_data(mpdconnection* conn) {
     m_status.reset(mpd_run_status(*conn));
-    m_updated_at = chrono::system_clock::now();
+    m_updated_at = chrono::steady_clock::now();
     m_songid = mpd_status_get_song_id(m_status.get());
     m_queuelen = mpd_status_get_queue_length(m_status.get());
     m_random = mpd_status_get_random(m_status.get());
@@ -390,6 +584,7 @@ namespace mpd {
     m_single = mpd_status_get_single(m_status.get());
     m_consume = mpd_status_get_consume(m_status.get());
     m_elapsed_time = mpd_status_get_elapsed_time(m_status.get());
+    m_elapsed_time_ms = mpd_status_get_elapsed_ms(m_status.get());
     m_total_time = mpd_status_get_total_time(m_status.get());
   }
 
@@ -404,8 +599,6 @@ namespace mpd {
 
     fetch_data(connection);
 
-    m_elapsed_time_ms = m_elapsed_time * 1000;
-
     auto state = mpd_status_get_state(m_status.get());
 
     switch (state) {
@@ -455,20 +648,42 @@ namespace mpd {
     return m_total_time;
   }
 
+  /**
+   * Elapsed time of the song in seconds
+   *
+   * While playing, the time since the status was fetched is added, so the
+   * status doesn't have to be fetched again for every second
+   */
   unsigned mpdstatus::get_elapsed_time() const {
-    return m_elapsed_time;
+    if (m_state != mpdstate::PLAYING) {
+      return m_elapsed_time;
+    }
+
+    auto elapsed = (m_elapsed_time_ms + extrapolated_ms()) / 1000;
+    if (m_total_time != 0 && elapsed > m_total_time) {
+      return m_total_time;
+    }
+    return elapsed;
+  }
+
+  /**
+   * Time until the elapsed time reaches the next full second
+   */
+  chrono::milliseconds mpdstatus::get_next_second() const {
+    return chrono::milliseconds{1000 - (m_elapsed_time_ms + extrapolated_ms()) % 1000};
   }
 
   unsigned mpdstatus::get_elapsed_percentage() {
     if (m_total_time == 0) {
       return 0;
     }
-    return static_cast<int>(float(m_elapsed_time) / float(m_total_time) * 100.0 + 0.5f);
+    return static_cast<int>(float(get_elapsed_time()) / float(m_total_time) * 100.0 + 0.5f);
   }
 
   string mpdstatus::get_formatted_elapsed() {
     char buffer[32];
-    snprintf(buffer, sizeof(buffer), "%lu:%02lu", m_elapsed_time / 60, m_elapsed_time % 60);
+    auto elapsed = get_elapsed_time();
+    snprintf(buffer, sizeof(buffer), "%u:%02u", elapsed / 60, elapsed % 60);
     return {buffer};
   }
 
@@ -478,6 +693,16 @@ namespace mpd {
     return {buffer};
   }
 
+  /**
+   * Milliseconds played since the status was fetched, 0 unless playing
+   */
+  unsigned long mpdstatus::extrapolated_ms() const {
+    if (m_state != mpdstate::PLAYING) {
+      return 0UL;
+    }
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - m_updated_at).count();
+  }
+
   int mpdstatus::get_seek_position(int percentage) {
     if (m_total_time == 0) {
       return 0;
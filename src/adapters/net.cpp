@@ -2,19 +2,25 @@
 
 #include <arpa/inet.h>
 #include <linux/ethtool.h>
+#include <linux/if_addr.h>
 #include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
 #include <linux/sockios.h>
 #include <net/if.h>
 #include <netdb.h>
+#include <netinet/icmp6.h>
 #include <netinet/in.h>
+#include <netinet/ip_icmp.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 
+#include <cstring>
 #include <iomanip>
 
 #include "common.hpp"
 #include "settings.hpp"
-#include "utils/command.hpp"
 #include "utils/file.hpp"
 #include "utils/string.hpp"
 
@@ -36,15 +42,39 @@ namespace net {
    * Construct network interface
    */
   network::network(string interface) : m_log(logger::make()), m_interface(move(interface)) {
-    if (if_nametoindex(m_interface.c_str()) == 0) {
+    if ((m_ifindex = if_nametoindex(m_interface.c_str())) == 0) {
       throw network_error("Invalid network interface \"" + m_interface + "\"");
     }
 
-    m_socketfd = file_util::make_file_descriptor(socket(AF_INET, SOCK_DGRAM, 0));
+    m_socketfd = file_util::make_file_descriptor(socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0));
     if (!*m_socketfd) {
       throw network_error("Failed to open socket");
     }
 
+    m_netlink = file_util::make_file_descriptor(socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE));
+    if (!*m_netlink) {
+      throw network_error("Failed to open netlink socket");
+    }
+
+    /*
+     * Addresses rarely change, they are only requested again after the kernel
+     * announced a change. Without the announcements they are requested on
+     * every query.
+     */
+    struct sockaddr_nl addr {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+
+    int fd{socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE)};
+    if (fd != -1 && bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+      m_netlink_events = file_util::make_file_descriptor(fd);
+    } else {
+      m_log.warn("Failed to listen for address changes of %s (err: %s)", m_interface, strerror(errno));
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+
     check_tuntap_or_bridge();
   }
 
@@ -53,86 +83,208 @@ namespace net {
    */
   bool network::query(bool accumulate) {
     m_status.previous = m_status.current;
-    m_status.current.transmitted = 0;
-    m_status.current.received = 0;
     m_status.current.time = std::chrono::system_clock::now();
-    m_status.ip = NO_IP;
-    m_status.ip6 = NO_IP;
 
-    struct ifaddrs* ifaddr;
-    if (getifaddrs(&ifaddr) == -1 || ifaddr == nullptr) {
+    if (!query_link(accumulate)) {
+      // The interface might have been created again under a new index
+      unsigned int ifindex{if_nametoindex(m_interface.c_str())};
+      if (ifindex == 0 || ifindex == m_ifindex) {
+        m_status.current.transmitted = 0;
+        m_status.current.received = 0;
+        return false;
+      }
+      m_ifindex = ifindex;
+      m_addresses_valid = false;
+      if (!query_link(accumulate)) {
+        return false;
+      }
+    }
+
+    if (addresses_changed() || !m_addresses_valid) {
+      m_addresses_valid = query_addresses();
+    }
+
+    return true;
+  }
+
+  /**
+   * Send a request over the route netlink socket and pass every message of
+   * the answer to `handle`
+   *
+   * \returns false if the request failed or the kernel answered with an error
+   */
+  bool network::rtnl_request(unsigned short type, unsigned short flags, const void* payload, size_t size,
+      const function<void(const struct nlmsghdr*)>& handle) {
+    struct {
+      struct nlmsghdr header;
+      char payload[64];
+    } request{};
+
+    if (size > sizeof(request.payload)) {
+      return false;
+    }
+
+    request.header.nlmsg_len = NLMSG_LENGTH(size);
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | flags;
+    request.header.nlmsg_seq = ++m_sequence;
+    memcpy(NLMSG_DATA(&request.header), payload, size);
+
+    if (send(*m_netlink, &request, request.header.nlmsg_len, 0) == -1) {
       return false;
     }
 
-    for (auto ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
-      if (ifa->ifa_addr == nullptr) {
+    alignas(struct nlmsghdr) char buffer[16384];
+
+    while (true) {
+      ssize_t bytes = recv(*m_netlink, buffer, sizeof(buffer), 0);
+      if (bytes == -1 && errno == EINTR) {
         continue;
+      } else if (bytes <= 0) {
+        return false;
       }
 
-      if (m_interface.compare(0, m_interface.length(), ifa->ifa_name) != 0) {
-        if (!accumulate || (ifa->ifa_data == nullptr && ifa->ifa_addr->sa_family != AF_PACKET)) {
+      auto len = static_cast<unsigned int>(bytes);
+      for (auto msg = reinterpret_cast<struct nlmsghdr*>(buffer); NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+        if (msg->nlmsg_seq != m_sequence) {
+          // Left over from an earlier request
           continue;
+        } else if (msg->nlmsg_type == NLMSG_DONE) {
+          return true;
+        } else if (msg->nlmsg_type == NLMSG_ERROR) {
+          return reinterpret_cast<struct nlmsgerr*>(NLMSG_DATA(msg))->error == 0;
+        }
+
+        handle(msg);
+
+        if (!(msg->nlmsg_flags & NLM_F_MULTI)) {
+          return true;
         }
       }
+    }
+  }
 
-      struct sockaddr_in6* sa6;
+  /**
+   * Read the byte counters of the interface, or of all interfaces if `accumulate` is set
+   */
+  bool network::query_link(bool accumulate) {
+    struct ifinfomsg info {};
+    info.ifi_family = AF_UNSPEC;
+    info.ifi_index = accumulate ? 0 : static_cast<int>(m_ifindex);
 
-      switch (ifa->ifa_addr->sa_family) {
-        case AF_INET:
-          char ip_buffer[NI_MAXHOST];
-          getnameinfo(ifa->ifa_addr, sizeof(sockaddr_in), ip_buffer, NI_MAXHOST, nullptr, 0, NI_NUMERICHOST);
-          m_status.ip = string{ip_buffer};
-          break;
+    link_activity current{};
+    current.time = m_status.current.time;
 
-        case AF_INET6:
-          char ip6_buffer[INET6_ADDRSTRLEN];
-          sa6 = reinterpret_cast<decltype(sa6)>(ifa->ifa_addr);
-          if (IN6_IS_ADDR_LINKLOCAL(&sa6->sin6_addr)) {
-            continue;
-          }
-          if (IN6_IS_ADDR_SITELOCAL(&sa6->sin6_addr)) {
-            continue;
-          }
-          if ((((unsigned char*)sa6->sin6_addr.s6_addr)[0] & 0xFE) == 0xFC) {
-            /* Skip Unique Local Addresses (fc00::/7) */
-            continue;
-          }
-          if (inet_ntop(AF_INET6, &sa6->sin6_addr, ip6_buffer, INET6_ADDRSTRLEN) == 0) {
-            m_log.warn("inet_ntop() " + string(strerror(errno)));
-            continue;
-          }
-          m_status.ip6 = string{ip6_buffer};
-          break;
+    auto handle = [&](const struct nlmsghdr* msg) {
+      if (msg->nlmsg_type != RTM_NEWLINK) {
+        return;
+      }
 
-        case AF_PACKET:
-          if (ifa->ifa_data == nullptr) {
-            continue;
-          }
-          struct rtnl_link_stats* link_state = reinterpret_cast<decltype(link_state)>(ifa->ifa_data);
-          if (link_state == nullptr) {
-            continue;
-          }
-          m_status.current.transmitted += link_state->tx_bytes;
-          m_status.current.received += link_state->rx_bytes;
+      auto ifi = reinterpret_cast<const struct ifinfomsg*>(NLMSG_DATA(msg));
+      auto len = static_cast<int>(IFLA_PAYLOAD(msg));
+      for (auto rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_STATS64 && RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats64)) {
+          struct rtnl_link_stats64 stats {};
+          memcpy(&stats, RTA_DATA(rta), sizeof(stats));
+          current.transmitted += stats.tx_bytes;
+          current.received += stats.rx_bytes;
           break;
+        } else if (rta->rta_type == IFLA_STATS && RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats)) {
+          struct rtnl_link_stats stats {};
+          memcpy(&stats, RTA_DATA(rta), sizeof(stats));
+          current.transmitted += stats.tx_bytes;
+          current.received += stats.rx_bytes;
+        }
       }
-    }
+    };
 
-    freeifaddrs(ifaddr);
+    if (!rtnl_request(RTM_GETLINK, accumulate ? NLM_F_DUMP : 0, &info, sizeof(info), handle)) {
+      return false;
+    }
 
+    m_status.current = current;
     return true;
   }
 
   /**
-   * Run ping command to test internet connectivity
+   * Read the addresses of the interface
    */
-  bool network::ping() const {
-    try {
-      auto exec = "ping -c 2 -W 2 -I " + m_interface + " " + string(CONNECTION_TEST_IP);
-      auto ping = command_util::make_command<output_policy::IGNORED>(exec);
-      return ping && ping->exec(true) == EXIT_SUCCESS;
-    } catch (const std::exception& err) {
-      return false;
+  bool network::query_addresses() {
+    m_status.ip = NO_IP;
+    m_status.ip6 = NO_IP;
+
+    struct ifaddrmsg request {};
+    request.ifa_family = AF_UNSPEC;
+
+    auto handle = [&](const struct nlmsghdr* msg) {
+      auto ifa = reinterpret_cast<const struct ifaddrmsg*>(NLMSG_DATA(msg));
+      if (msg->nlmsg_type != RTM_NEWADDR || ifa->ifa_index != m_ifindex) {
+        return;
+      }
+
+      const void* address{nullptr};
+      auto len = static_cast<int>(IFA_PAYLOAD(msg));
+      for (auto rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        // The local address differs from IFA_ADDRESS on point-to-point links
+        if (rta->rta_type == IFA_LOCAL || (rta->rta_type == IFA_ADDRESS && address == nullptr)) {
+          address = RTA_DATA(rta);
+        }
+      }
+
+      if (address == nullptr) {
+        return;
+      }
+
+      if (ifa->ifa_family == AF_INET) {
+        char ip_buffer[INET_ADDRSTRLEN];
+        if (inet_ntop(AF_INET, address, ip_buffer, sizeof(ip_buffer)) != nullptr) {
+          m_status.ip = string{ip_buffer};
+        }
+      } else if (ifa->ifa_family == AF_INET6) {
+        struct in6_addr addr6 {};
+        memcpy(&addr6, address, sizeof(addr6));
+        if (IN6_IS_ADDR_LINKLOCAL(&addr6) || IN6_IS_ADDR_SITELOCAL(&addr6)) {
+          return;
+        }
+        if ((addr6.s6_addr[0] & 0xFE) == 0xFC) {
+          /* Skip Unique Local Addresses (fc00::/7) */
+          return;
+        }
+        char ip6_buffer[INET6_ADDRSTRLEN];
+        if (inet_ntop(AF_INET6, &addr6, ip6_buffer, sizeof(ip6_buffer)) == nullptr) {
+          m_log.warn("inet_ntop() " + string(strerror(errno)));
+          return;
+        }
+        m_status.ip6 = string{ip6_buffer};
+      }
+    };
+
+    return rtnl_request(RTM_GETADDR, NLM_F_DUMP, &request, sizeof(request), handle);
+  }
+
+  /**
+   * Drain the announcements of the kernel
+   *
+   * \returns true if any link or address changed since the last call or if
+   * changes can't be detected
+   */
+  bool network::addresses_changed() {
+    if (!m_netlink_events) {
+      return true;
+    }
+
+    bool changed{false};
+    char buffer[8192];
+    while (true) {
+      ssize_t bytes = recv(*m_netlink_events, buffer, sizeof(buffer), MSG_DONTWAIT);
+      if (bytes > 0) {
+        changed = true;
+      } else if (bytes == -1 && errno == ENOBUFS) {
+        // Announcements were dropped, anything might have changed
+        changed = true;
+      } else if (bytes != -1 || errno != EINTR) {
+        return changed;
+      }
     }
   }
 
@@ -166,6 +318,20 @@ namespace net {
     return format_speedrate(bytes_diff, minwidth, unit);
   }
 
+  /**
+   * Get download speed rate in bytes per second
+   */
+  float network::downrate() const {
+    return speedrate(m_status.current.received - m_status.previous.received);
+  }
+
+  /**
+   * Get upload speed rate in bytes per second
+   */
+  float network::uprate() const {
+    return speedrate(m_status.current.transmitted - m_status.previous.transmitted);
+  }
+
   /**
    * Set if unknown counts as up
    */
@@ -223,11 +389,14 @@ namespace net {
   /**
    * Format up- and download speed
    */
-  string network::format_speedrate(float bytes_diff, int minwidth, const string& unit) const {
+  float network::speedrate(float bytes_diff) const {
     // Get time difference in seconds as a float
     const std::chrono::duration<float> duration = m_status.current.time - m_status.previous.time;
-    float time_diff = duration.count();
-    float speedrate = bytes_diff / time_diff;
+    return bytes_diff / duration.count();
+  }
+
+  string network::format_speedrate(float bytes_diff, int minwidth, const string& unit) const {
+    float speedrate = this->speedrate(bytes_diff);
 
     vector<pair<string,int>> units{make_pair("G", 2), make_pair("M", 1)};
     string suffix{"K"};
@@ -243,6 +412,179 @@ namespace net {
                      << " " << suffix << unit;
   }
 
+  // }}}
+  // class : connectivity_probe {{{
+
+  /**
+   * Parse the target, throws if it is not a numeric address
+   */
+  connectivity_probe::connectivity_probe(const string& target, string interface)
+      : m_log(logger::make()), m_interface(move(interface)) {
+    string host{target};
+    string port{"53"};
+
+    auto colon = target.rfind(':');
+    if (!target.empty() && target[0] == '[') {
+      auto bracket = target.find(']');
+      if (bracket == string::npos || (bracket + 1 < target.size() && target[bracket + 1] != ':')) {
+        throw network_error("Invalid ping target \"" + target + "\"");
+      }
+      host = target.substr(1, bracket - 1);
+      if (bracket + 1 < target.size()) {
+        port = target.substr(bracket + 2);
+        m_tcp = true;
+      }
+    } else if (colon != string::npos && target.find(':') == colon) {
+      host = target.substr(0, colon);
+      port = target.substr(colon + 1);
+      m_tcp = true;
+    }
+
+    struct addrinfo hints {};
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* info{nullptr};
+
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0 || info == nullptr) {
+      throw network_error("Invalid ping target \"" + target + "\", expected an address with an optional port");
+    }
+
+    memcpy(&m_address, info->ai_addr, info->ai_addrlen);
+    m_address_size = info->ai_addrlen;
+    freeaddrinfo(info);
+  }
+
+  /**
+   * Send a new probe, a probe that is still running is dropped
+   */
+  void connectivity_probe::start() {
+    finish();
+
+    auto now = clock::now();
+    m_deadline = now + std::chrono::seconds(3);
+    m_next_echo = now;
+
+    if (!open_socket()) {
+      return;
+    }
+
+    if (m_tcp) {
+      if (connect(*m_fd, reinterpret_cast<struct sockaddr*>(&m_address), m_address_size) == -1 &&
+          errno != EINPROGRESS) {
+        finish();
+      }
+    } else if (!send_echo()) {
+      finish();
+    }
+  }
+
+  /**
+   * Collect the result of the running probe
+   *
+   * Like `ping -c 2 -W 2` the echo is sent twice, a second apart, and the
+   * target has three seconds to answer.
+   */
+  connectivity_probe::result connectivity_probe::poll() {
+    if (!running()) {
+      return result::UNREACHABLE;
+    }
+
+    if (m_tcp) {
+      struct pollfd pfd {};
+      pfd.fd = *m_fd;
+      pfd.events = POLLOUT;
+      if (::poll(&pfd, 1, 0) > 0) {
+        int error{0};
+        socklen_t size{sizeof(error)};
+        getsockopt(*m_fd, SOL_SOCKET, SO_ERROR, &error, &size);
+        finish();
+        return error == 0 || error == ECONNREFUSED ? result::REACHABLE : result::UNREACHABLE;
+      }
+    } else {
+      unsigned char reply[64];
+      unsigned char expected = m_address.ss_family == AF_INET6 ? ICMP6_ECHO_REPLY : ICMP_ECHOREPLY;
+      ssize_t bytes;
+      while ((bytes = recv(*m_fd, reply, sizeof(reply), MSG_DONTWAIT)) > 0 || (bytes == -1 && errno == EINTR)) {
+        if (bytes > 0 && reply[0] == expected) {
+          finish();
+          return result::REACHABLE;
+        }
+      }
+      if (bytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        // An ICMP error such as host unreachable
+        finish();
+        return result::UNREACHABLE;
+      }
+    }
+
+    auto now = clock::now();
+    if (now >= m_deadline) {
+      finish();
+      return result::UNREACHABLE;
+    } else if (!m_tcp && now >= m_next_echo && m_sequence < 2 && !send_echo()) {
+      finish();
+      return result::UNREACHABLE;
+    }
+
+    return result::PENDING;
+  }
+
+  bool connectivity_probe::running() const {
+    return m_fd && *m_fd;
+  }
+
+  /**
+   * Open a non-blocking socket that is bound to the interface
+   */
+  bool connectivity_probe::open_socket() {
+    auto family = m_address.ss_family;
+    int fd{-1};
+
+    if (!m_tcp) {
+      int protocol = family == AF_INET6 ? static_cast<int>(IPPROTO_ICMPV6) : static_cast<int>(IPPROTO_ICMP);
+      fd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+      if (fd == -1 && (errno == EACCES || errno == EPERM || errno == EPROTONOSUPPORT)) {
+        m_log.info("ICMP sockets are not permitted (net.ipv4.ping_group_range), testing connectivity over TCP instead");
+        m_tcp = true;
+      }
+    }
+    if (m_tcp) {
+      // Without a port in the target the address was parsed with port 53
+      fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    }
+
+    if (fd == -1) {
+      m_log.warn("Failed to open socket to test connectivity (err: %s)", strerror(errno));
+      return false;
+    }
+
+    // Allowed without privileges since Linux 5.7, the probe still works unbound otherwise
+    setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, m_interface.c_str(), m_interface.size());
+
+    m_fd = file_util::make_file_descriptor(fd);
+    m_sequence = 0;
+    return true;
+  }
+
+  /**
+   * Send an ICMP echo request, the kernel fills in the identifier and checksum
+   */
+  bool connectivity_probe::send_echo() {
+    unsigned char request[8]{};
+    request[0] = m_address.ss_family == AF_INET6 ? ICMP6_ECHO_REQUEST : ICMP_ECHO;
+    m_sequence++;
+    request[6] = m_sequence >> 8;
+    request[7] = m_sequence & 0xff;
+
+    m_next_echo = clock::now() + std::chrono::seconds(1);
+    return sendto(*m_fd, request, sizeof(request), MSG_NOSIGNAL, reinterpret_cast<struct sockaddr*>(&m_address),
+               m_address_size) == sizeof(request);
+  }
+
+  void connectivity_probe::finish() {
+    m_fd.reset();
+  }
+
   // }}}
   // class : wired_network {{{
 
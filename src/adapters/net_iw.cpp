@@ -16,14 +16,9 @@ namespace net {
       return false;
     }
 
-    auto socket_fd = file_util::make_file_descriptor(iw_sockets_open());
-    if (!*socket_fd) {
-      return false;
-    }
-
     struct iwreq req {};
 
-    if (iw_get_ext(*socket_fd, m_interface.c_str(), SIOCGIWMODE, &req) == -1) {
+    if (iw_get_ext(*m_socketfd, m_interface.c_str(), SIOCGIWMODE, &req) == -1) {
       return false;
     }
 
@@ -32,8 +27,8 @@ namespace net {
       return false;
     }
 
-    query_essid(*socket_fd);
-    query_quality(*socket_fd);
+    query_essid(*m_socketfd);
+    query_quality(*m_socketfd);
 
     return true;
   }
@@ -4,13 +4,108 @@
 #include <netlink/genl/ctrl.h>
 #include <netlink/genl/genl.h>
 
+#include <mutex>
+
 #include "utils/file.hpp"
 
 POLYBAR_NS
 
 namespace net {
+  namespace {
+    /**
+     * Generic netlink socket shared by the wireless networks of the process
+     *
+     * Connected and the nl80211 family resolved on first use, and again after
+     * a request failed.
+     */
+    struct nl80211_socket {
+      ~nl80211_socket() {
+        reset();
+      }
+
+      bool connect() {
+        if (sock != nullptr) {
+          return true;
+        }
+
+        if ((sock = nl_socket_alloc()) == nullptr) {
+          return false;
+        }
+
+        if (genl_connect(sock) < 0 || (family = genl_ctrl_resolve(sock, "nl80211")) < 0) {
+          reset();
+          return false;
+        }
+
+        return true;
+      }
+
+      void reset() {
+        if (sock != nullptr) {
+          nl_socket_free(sock);
+          sock = nullptr;
+        }
+      }
+
+      std::mutex lock;
+      struct nl_sock* sock{nullptr};
+      int family{-1};
+    };
+
+    nl80211_socket& shared_socket() {
+      static nl80211_socket instance;
+      return instance;
+    }
+
+    /**
+     * Open a non-blocking socket that receives the given nl80211 multicast groups
+     */
+    struct nl_sock* subscribe(const vector<const char*>& groups) {
+      struct nl_sock* sk = nl_socket_alloc();
+      if (sk == nullptr) {
+        return nullptr;
+      }
+
+      if (genl_connect(sk) < 0) {
+        nl_socket_free(sk);
+        return nullptr;
+      }
+
+      for (const auto& name : groups) {
+        int group = genl_ctrl_resolve_grp(sk, "nl80211", name);
+        if (group < 0 || nl_socket_add_membership(sk, group) < 0) {
+          nl_socket_free(sk);
+          return nullptr;
+        }
+      }
+
+      // Announcements are not answers to requests
+      nl_socket_disable_seq_check(sk);
+      nl_socket_set_nonblocking(sk);
+
+      return sk;
+    }
+  }  // namespace
+
   // class : wireless_network {{{
 
+  wireless_network::wireless_network(string interface) : network(interface), m_ifid(if_nametoindex(interface.c_str())) {
+    m_events = subscribe({"mlme", "scan"});
+    if (m_events == nullptr || nl_socket_modify_cb(m_events, NL_CB_VALID, NL_CB_CUSTOM, event_cb, this) != 0) {
+      m_log.warn("Failed to listen for wireless events of %s, scanning on every update", m_interface);
+      if (m_events != nullptr) {
+        nl_socket_free(m_events);
+        m_events = nullptr;
+      }
+    }
+  }
+
+  wireless_network::~wireless_network() {
+    if (m_events != nullptr) {
+      nl_socket_free(m_events);
+    }
+  }
+
   /**
    * Query the wireless device for information
    * about the current connection
@@ -20,50 +115,82 @@ namespace net {
       return false;
     }
 
-    struct nl_sock* sk = nl_socket_alloc();
-    if (sk == nullptr) {
-      return false;
-    }
+    if (connection_changed() || !m_scanned || (m_associated && !m_station_signal)) {
+      m_associated = false;
+      m_station_signal = false;
 
-    if (genl_connect(sk) < 0) {
-      return false;
+      if (!(m_scanned = request(NL80211_CMD_GET_SCAN, scan_cb))) {
+        return false;
+      }
+
+      if (!m_associated) {
+        m_essid.clear();
+      }
+    } else if (m_associated) {
+      return request(NL80211_CMD_GET_STATION, station_cb);
     }
 
-    int driver_id = genl_ctrl_resolve(sk, "nl80211");
-    if (driver_id < 0) {
-      nl_socket_free(sk);
+    return true;
+  }
+
+  /**
+   * Send a dump request for the interface over the shared socket, every
+   * message of the reply is passed to the callback
+   */
+  bool wireless_network::request(unsigned char command, int (*callback)(struct nl_msg*, void*)) {
+    auto& shared = shared_socket();
+    std::lock_guard<std::mutex> guard(shared.lock);
+
+    if (!shared.connect()) {
       return false;
     }
 
-    if (nl_socket_modify_cb(sk, NL_CB_VALID, NL_CB_CUSTOM, scan_cb, this) != 0) {
-      nl_socket_free(sk);
+    if (nl_socket_modify_cb(shared.sock, NL_CB_VALID, NL_CB_CUSTOM, callback, this) != 0) {
       return false;
     }
 
     struct nl_msg* msg = nlmsg_alloc();
     if (msg == nullptr) {
-      nl_socket_free(sk);
       return false;
     }
 
-    if ((genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, driver_id, 0, NLM_F_DUMP, NL80211_CMD_GET_SCAN, 0) == nullptr) ||
+    if ((genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, shared.family, 0, NLM_F_DUMP, command, 0) == nullptr) ||
         nla_put_u32(msg, NL80211_ATTR_IFINDEX, m_ifid) < 0) {
       nlmsg_free(msg);
-      nl_socket_free(sk);
       return false;
     }
 
     // nl_send_sync always frees msg
-    if (nl_send_sync(sk, msg) < 0) {
-      nl_socket_free(sk);
+    if (nl_send_sync(shared.sock, msg) < 0) {
+      // Whatever is left of the reply must not be taken for the answer to the next request
+      shared.reset();
       return false;
     }
 
-    nl_socket_free(sk);
-
     return true;
   }
 
+  /**
+   * Drain the nl80211 announcements
+   *
+   * \returns true if the connection of the interface or its scan results
+   * changed since the last call, or if changes can't be detected
+   */
+  bool wireless_network::connection_changed() {
+    if (m_events == nullptr) {
+      return true;
+    }
+
+    m_event_seen = false;
+
+    int err;
+    while ((err = nl_recvmsgs_default(m_events)) >= 0) {
+    }
+
+    // Anything else than running out of messages may have lost announcements
+    return m_event_seen || err != -NLE_AGAIN;
+  }
+
   /**
    * Check current connection state
    */
@@ -131,6 +258,7 @@ namespace net {
       return NL_SKIP;
     }
 
+    wn->m_associated = true;
     wn->parse_essid(bss);
     wn->parse_frequency(bss);
     wn->parse_signal(bss);
@@ -139,6 +267,54 @@ namespace net {
     return NL_SKIP;
   }
 
+  /**
+   * Callback to parse the station info of the access point
+   */
+  int wireless_network::station_cb(struct nl_msg* msg, void* instance) {
+    auto wn = static_cast<wireless_network*>(instance);
+    auto gnlh = static_cast<genlmsghdr*>(nlmsg_data(nlmsg_hdr(msg)));
+    struct nlattr* tb[NL80211_ATTR_MAX + 1];
+    struct nlattr* sinfo[NL80211_STA_INFO_MAX + 1];
+
+    struct nla_policy sinfo_policy[NL80211_STA_INFO_MAX + 1]{};
+    sinfo_policy[NL80211_STA_INFO_SIGNAL].type = NLA_U8;
+
+    if (nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), nullptr) < 0) {
+      return NL_SKIP;
+    }
+
+    if (tb[NL80211_ATTR_STA_INFO] == nullptr ||
+        nla_parse_nested(sinfo, NL80211_STA_INFO_MAX, tb[NL80211_ATTR_STA_INFO], sinfo_policy) != 0) {
+      return NL_SKIP;
+    }
+
+    if (sinfo[NL80211_STA_INFO_SIGNAL] != nullptr) {
+      // in dBm
+      wn->set_signal(static_cast<int8_t>(nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL])));
+    }
+
+    return NL_SKIP;
+  }
+
+  /**
+   * Callback for nl80211 announcements, only notes those about the interface
+   */
+  int wireless_network::event_cb(struct nl_msg* msg, void* instance) {
+    auto wn = static_cast<wireless_network*>(instance);
+    auto gnlh = static_cast<genlmsghdr*>(nlmsg_data(nlmsg_hdr(msg)));
+    struct nlattr* tb[NL80211_ATTR_MAX + 1];
+
+    if (nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0), genlmsg_attrlen(gnlh, 0), nullptr) < 0) {
+      return NL_SKIP;
+    }
+
+    if (tb[NL80211_ATTR_IFINDEX] != nullptr && nla_get_u32(tb[NL80211_ATTR_IFINDEX]) == wn->m_ifid) {
+      wn->m_event_seen = true;
+    }
+
+    return NL_SKIP;
+  }
+
   /**
    * Check for a connection to a AP
    */
@@ -213,19 +389,25 @@ namespace net {
    */
   void wireless_network::parse_signal(struct nlattr** bss) {
     if (bss[NL80211_BSS_SIGNAL_MBM] != nullptr) {
-      // signalstrength in dBm
-      int signalstrength = static_cast<int>(nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM])) / 100;
-
-      // WiFi-hardware usually operates in the range -90 to -20dBm.
-      const int hardware_max = -20;
-      const int hardware_min = -90;
-      signalstrength = std::max(hardware_min, std::min(signalstrength, hardware_max));
-
-      // Shift for positive values
-      m_signalstrength.val = signalstrength - hardware_min;
-      m_signalstrength.max = hardware_max - hardware_min;
+      // signalstrength in mBm
+      set_signal(static_cast<int>(nla_get_u32(bss[NL80211_BSS_SIGNAL_MBM])) / 100);
+      m_station_signal = true;
     }
   }
+
+  /**
+   * Set the signalstrength from a value in dBm
+   */
+  void wireless_network::set_signal(int dbm) {
+    // WiFi-hardware usually operates in the range -90 to -20dBm.
+    const int hardware_max = -20;
+    const int hardware_min = -90;
+    dbm = std::max(hardware_min, std::min(dbm, hardware_max));
+
+    // Shift for positive values
+    m_signalstrength.val = dbm - hardware_min;
+    m_signalstrength.max = hardware_max - hardware_min;
+  }
 }  // namespace net
 
 POLYBAR_NS_END
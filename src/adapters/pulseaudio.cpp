@@ -1,12 +1,36 @@
 #include "adapters/pulseaudio.hpp"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
 #include "components/logger.hpp"
 
 POLYBAR_NS
 
 /**
- * Construct pulseaudio object
+ * Get the context, it is created by the first module that needs it
+ * and destroyed with the last one
  */
-pulseaudio::pulseaudio(const logger& logger, string&& sink_name, bool max_volume) : m_log(logger), spec_s_name(sink_name) {
+shared_ptr<pulseaudio_context> pulseaudio_context::make(const logger& logger) {
+  static std::mutex lock;
+  static std::weak_ptr<pulseaudio_context> instance;
+
+  std::lock_guard<std::mutex> guard(lock);
+  auto shared = instance.lock();
+  if (!shared) {
+    shared = std::make_shared<pulseaudio_context>(logger);
+    instance = shared;
+  }
+  return shared;
+}
+
+/**
+ * Connect to the server and fill the cache
+ */
+pulseaudio_context::pulseaudio_context(const logger& logger) : m_log(logger) {
   m_mainloop = pa_threaded_mainloop_new();
   if (!m_mainloop) {
     throw pulseaudio_error("Could not create pulseaudio threaded mainloop.");
@@ -50,44 +74,243 @@ pulseaudio::pulseaudio(const logger& logger, string&& sink_name, bool max_volume
     throw pulseaudio_error("Could not connect to pulseaudio server.");
   }
 
-  pa_operation *op{nullptr};
-  if (!sink_name.empty()) {
-    op = pa_context_get_sink_info_by_name(m_context, sink_name.c_str(), sink_info_callback, this);
-    wait_loop(op, m_mainloop);
-  }
-  if (s_name.empty()) {
-    // get the sink index
-    op = pa_context_get_sink_info_by_name(m_context, DEFAULT_SINK, sink_info_callback, this);
-    wait_loop(op, m_mainloop);
-    m_log.notice("pulseaudio: using default sink %s", s_name);
-  } else {
-    m_log.trace("pulseaudio: using sink %s", s_name);
-  }
-
-  m_max_volume = max_volume ? PA_VOLUME_UI_MAX : PA_VOLUME_NORM;
-
-  auto event_types = static_cast<pa_subscription_mask_t>(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SERVER);
-  op = pa_context_subscribe(m_context, event_types, simple_callback, this);
-  wait_loop(op, m_mainloop);
-  if (!success)
-    throw pulseaudio_error("Failed to subscribe to sink.");
+  // subscribe first, so that no change between filling the cache and subscribing is lost
+  auto event_types = static_cast<pa_subscription_mask_t>(
+      PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE | PA_SUBSCRIPTION_MASK_SERVER);
   pa_context_set_subscribe_callback(m_context, subscribe_callback, this);
+  wait_loop(pa_context_subscribe(m_context, event_types, success_callback, this));
+  if (!m_success) {
+    pa_threaded_mainloop_unlock(m_mainloop);
+    pa_threaded_mainloop_stop(m_mainloop);
+    pa_context_disconnect(m_context);
+    pa_context_unref(m_context);
+    pa_threaded_mainloop_free(m_mainloop);
+    throw pulseaudio_error("Failed to subscribe to sink.");
+  }
 
-  update_volume(op);
+  wait_loop(pa_context_get_server_info(m_context, server_info_callback, this));
+  wait_loop(pa_context_get_sink_info_list(m_context, sink_info_callback, this));
+  wait_loop(pa_context_get_source_info_list(m_context, source_info_callback, this));
 
   pa_threaded_mainloop_unlock(m_mainloop);
-
 }
 
 /**
- * Deconstruct pulseaudio
+ * Deconstruct context
  */
-pulseaudio::~pulseaudio() {
+pulseaudio_context::~pulseaudio_context() {
   pa_threaded_mainloop_stop(m_mainloop);
   pa_context_disconnect(m_context);
   pa_context_unref(m_context);
   pa_threaded_mainloop_free(m_mainloop);
+}
+
+pa_context* pulseaudio_context::context() const {
+  return m_context;
+}
+
+pa_threaded_mainloop* pulseaudio_context::mainloop() const {
+  return m_mainloop;
+}
+
+/**
+ * Notify the listener whenever the cache changes
+ */
+void pulseaudio_context::attach(pulseaudio* listener) {
+  m_listeners.emplace_back(listener);
+}
+
+void pulseaudio_context::detach(pulseaudio* listener) {
+  m_listeners.erase(std::remove(m_listeners.begin(), m_listeners.end(), listener), m_listeners.end());
+}
+
+/**
+ * Find a cached sink or source by name
+ */
+const pulseaudio_context::device* pulseaudio_context::find(kind type, const string& name) const {
+  for (const auto& entry : type == kind::SINK ? m_sinks : m_sources) {
+    if (entry.second.name == name) {
+      return &entry.second;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Name of the default sink or source of the server
+ */
+const string& pulseaudio_context::default_name(kind type) const {
+  return type == kind::SINK ? m_default_sink : m_default_source;
+}
+
+/**
+ * Callback when subscribing to changes
+ *
+ * Changed devices are queried by index, only the device that changed is sent
+ */
+void pulseaudio_context::subscribe_callback(pa_context *context, pa_subscription_event_type_t t, uint32_t idx, void* userdata) {
+  pulseaudio_context *This = static_cast<pulseaudio_context *>(userdata);
+  auto type = t & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+  switch(t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) {
+    case PA_SUBSCRIPTION_EVENT_SERVER:
+      if (type == PA_SUBSCRIPTION_EVENT_CHANGE)
+        This->request(pa_context_get_server_info(context, server_info_callback, This));
+      break;
+    case PA_SUBSCRIPTION_EVENT_SINK:
+      if (type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+        if (This->m_sinks.erase(idx) != 0)
+          This->changed();
+      } else {
+        This->request(pa_context_get_sink_info_by_index(context, idx, sink_info_callback, This));
+      }
+      break;
+    case PA_SUBSCRIPTION_EVENT_SOURCE:
+      if (type == PA_SUBSCRIPTION_EVENT_REMOVE) {
+        if (This->m_sources.erase(idx) != 0)
+          This->changed();
+      } else {
+        This->request(pa_context_get_source_info_by_index(context, idx, source_info_callback, This));
+      }
+      break;
+  }
+}
+
+/**
+ * Callback when getting sink info, the listeners are notified once all sinks were sent
+ */
+void pulseaudio_context::sink_info_callback(pa_context *, const pa_sink_info *info, int eol, void *userdata) {
+  pulseaudio_context *This = static_cast<pulseaudio_context *>(userdata);
+  if (!eol && info) {
+    auto& dev = This->m_sinks[info->index];
+    dev.index = info->index;
+    dev.name = info->name;
+    dev.volume = info->volume;
+    dev.muted = info->mute;
+  } else if (eol > 0) {
+    This->changed();
+  }
+  pa_threaded_mainloop_signal(This->m_mainloop, 0);
+}
+
+/**
+ * Callback when getting source info, the listeners are notified once all sources were sent
+ */
+void pulseaudio_context::source_info_callback(pa_context *, const pa_source_info *info, int eol, void *userdata) {
+  pulseaudio_context *This = static_cast<pulseaudio_context *>(userdata);
+  if (!eol && info) {
+    auto& dev = This->m_sources[info->index];
+    dev.index = info->index;
+    dev.name = info->name;
+    dev.volume = info->volume;
+    dev.muted = info->mute;
+  } else if (eol > 0) {
+    This->changed();
+  }
+  pa_threaded_mainloop_signal(This->m_mainloop, 0);
+}
+
+/**
+ * Callback when getting the server defaults
+ */
+void pulseaudio_context::server_info_callback(pa_context *, const pa_server_info *info, void *userdata) {
+  pulseaudio_context *This = static_cast<pulseaudio_context *>(userdata);
+  if (info) {
+    This->m_default_sink = info->default_sink_name ? info->default_sink_name : "";
+    This->m_default_source = info->default_source_name ? info->default_source_name : "";
+    This->changed();
+  }
+  pa_threaded_mainloop_signal(This->m_mainloop, 0);
+}
+
+/**
+ * Callback when context state changes
+ */
+void pulseaudio_context::context_state_callback(pa_context *context, void *userdata) {
+  pulseaudio_context* This = static_cast<pulseaudio_context *>(userdata);
+  switch (pa_context_get_state(context)) {
+    case PA_CONTEXT_READY:
+    case PA_CONTEXT_TERMINATED:
+    case PA_CONTEXT_FAILED:
+      pa_threaded_mainloop_signal(This->m_mainloop, 0);
+      break;
+
+    case PA_CONTEXT_UNCONNECTED:
+    case PA_CONTEXT_CONNECTING:
+    case PA_CONTEXT_AUTHORIZING:
+    case PA_CONTEXT_SETTING_NAME:
+      break;
+  }
+}
 
+/**
+ * Simple callback to check for success
+ */
+void pulseaudio_context::success_callback(pa_context *, int success, void *userdata) {
+  pulseaudio_context *This = static_cast<pulseaudio_context *>(userdata);
+  This->m_success = success;
+  pa_threaded_mainloop_signal(This->m_mainloop, 0);
+}
+
+void pulseaudio_context::wait_loop(pa_operation *op) {
+  if (!op)
+    return;
+  while (pa_operation_get_state(op) == PA_OPERATION_RUNNING)
+    pa_threaded_mainloop_wait(m_mainloop);
+  pa_operation_unref(op);
+}
+
+/**
+ * Send a request whose result only ends up in the cache
+ */
+void pulseaudio_context::request(pa_operation *op) {
+  if (op)
+    pa_operation_unref(op);
+}
+
+/**
+ * Let all listeners know that the cache changed
+ */
+void pulseaudio_context::changed() {
+  for (auto* listener : m_listeners) {
+    listener->notify();
+  }
+}
+
+/**
+ * Construct pulseaudio object for a sink or source
+ */
+pulseaudio::pulseaudio(const logger& logger, kind type, string&& device_name, bool max_volume)
+    : m_log(logger)
+    , m_shared(pulseaudio_context::make(logger))
+    , m_mainloop(m_shared->mainloop())
+    , m_eventfd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_kind(type)
+    , spec_s_name(device_name) {
+  if (!m_eventfd) {
+    throw pulseaudio_error("Could not create event fd.");
+  }
+
+  m_max_volume = max_volume ? PA_VOLUME_UI_MAX : PA_VOLUME_NORM;
+
+  pa_threaded_mainloop_lock(m_mainloop);
+  m_shared->attach(this);
+  update_device();
+  pa_threaded_mainloop_unlock(m_mainloop);
+}
+
+/**
+ * Deconstruct pulseaudio, changes that are on their way are not reported back
+ */
+pulseaudio::~pulseaudio() {
+  pa_threaded_mainloop_lock(m_mainloop);
+  m_shared->detach(this);
+  for (auto* op : {m_volume_op, m_mute_op}) {
+    if (op) {
+      pa_operation_cancel(op);
+      pa_operation_unref(op);
+    }
+  }
+  pa_threaded_mainloop_unlock(m_mainloop);
 }
 
 /**
@@ -97,51 +320,35 @@ const string& pulseaudio::get_name() {
   return s_name;
 }
 
+/**
+ * Get the descriptor that becomes readable when there are queued events
+ */
+int pulseaudio::get_event_fd() const {
+  return m_eventfd;
+}
+
 /**
  * Wait for events
  */
 bool pulseaudio::wait() {
-  return m_events.size() > 0;
+  return m_changed;
 }
 
 /**
  * Process queued pulseaudio events
+ *
+ * The device is looked up in the shared cache, this needs no round-trip
+ * to the server
  */
 int pulseaudio::process_events() {
-  int ret = m_events.size();
   pa_threaded_mainloop_lock(m_mainloop);
-  pa_operation *o{nullptr};
-  // clear the queue
-  while (!m_events.empty()) {
-    switch (m_events.front()) {
-      // try to get specified sink
-      case evtype::NEW:
-        // redundant if already using specified sink
-        if (!spec_s_name.empty()) {
-          o = pa_context_get_sink_info_by_name(m_context, spec_s_name.c_str(), sink_info_callback, this);
-          wait_loop(o, m_mainloop);
-          break;
-        }
-        // FALLTHRU
-      case evtype::SERVER:
-        // don't fallthrough only if always using default sink
-        if (!spec_s_name.empty()) {
-          break;
-        }
-        // FALLTHRU
-      // get default sink
-      case evtype::REMOVE:
-        o = pa_context_get_sink_info_by_name(m_context, DEFAULT_SINK, sink_info_callback, this);
-        wait_loop(o, m_mainloop);
-        if (spec_s_name != s_name)
-          m_log.notice("pulseaudio: using default sink %s", s_name);
-        break;
-      default:
-        break;
-    }
-    update_volume(o);
-    m_events.pop();
+  // reset the event fd, new events are signaled again by notify()
+  uint64_t count{0};
+  if (read(m_eventfd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+    m_log.err("pulseaudio: Failed to reset event fd (%s)", strerror(errno));
   }
+  int ret = m_changed.exchange(false) ? 1 : 0;
+  update_device();
   pa_threaded_mainloop_unlock(m_mainloop);
   return ret;
 }
@@ -168,15 +375,16 @@ void pulseaudio::set_volume(float percentage) {
   pa_threaded_mainloop_lock(m_mainloop);
   pa_volume_t vol = math_util::percentage_to_value<pa_volume_t>(percentage, PA_VOLUME_MUTED, PA_VOLUME_NORM);
   pa_cvolume_scale(&cv, vol);
-  pa_operation *op = pa_context_set_sink_volume_by_index(m_context, m_index, &cv, simple_callback, this);
-  wait_loop(op, m_mainloop);
-  if (!success)
-    throw pulseaudio_error("Failed to set sink volume.");
+  bool sent = send_volume();
   pa_threaded_mainloop_unlock(m_mainloop);
+  if (!sent)
+    throw pulseaudio_error("Failed to set sink volume.");
 }
 
 /**
  * Increment or decrement volume by given percentage (prevents accumulation of rounding errors from get_volume)
+ *
+ * The change is made to the target volume, so quick successive changes add up
  */
 void pulseaudio::inc_volume(int delta_perc) {
   pa_threaded_mainloop_lock(m_mainloop);
@@ -193,11 +401,10 @@ void pulseaudio::inc_volume(int delta_perc) {
     }
   } else
     pa_cvolume_dec(&cv, vol);
-  pa_operation *op = pa_context_set_sink_volume_by_index(m_context, m_index, &cv, simple_callback, this);
-  wait_loop(op, m_mainloop);
-  if (!success)
-    throw pulseaudio_error("Failed to set sink volume.");
+  bool sent = send_volume();
   pa_threaded_mainloop_unlock(m_mainloop);
+  if (!sent)
+    throw pulseaudio_error("Failed to set sink volume.");
 }
 
 /**
@@ -205,11 +412,11 @@ void pulseaudio::inc_volume(int delta_perc) {
  */
 void pulseaudio::set_mute(bool mode) {
   pa_threaded_mainloop_lock(m_mainloop);
-  pa_operation *op = pa_context_set_sink_mute_by_index(m_context, m_index, mode, simple_callback, this);
-  wait_loop(op, m_mainloop);
-  if (!success)
-    throw pulseaudio_error("Failed to mute sink.");
+  muted = mode;
+  bool sent = send_mute();
   pa_threaded_mainloop_unlock(m_mainloop);
+  if (!sent)
+    throw pulseaudio_error("Failed to mute sink.");
 }
 
 /**
@@ -227,103 +434,119 @@ bool pulseaudio::is_muted() {
 }
 
 /**
- * Update local volume cache
+ * Pick the specified device, or the default one if it doesn't exist, from the cache
+ *
+ * Expects the mainloop to be locked
  */
-void pulseaudio::update_volume(pa_operation *o) {
-  o = pa_context_get_sink_info_by_index(m_context, m_index, get_sink_volume_callback, this);
-  wait_loop(o, m_mainloop);
-}
+void pulseaudio::update_device() {
+  const char* type = m_kind == kind::SINK ? "sink" : "source";
+  const pulseaudio_context::device* dev{nullptr};
+  if (!spec_s_name.empty()) {
+    dev = m_shared->find(m_kind, spec_s_name);
+  }
+  if (!dev) {
+    dev = m_shared->find(m_kind, m_shared->default_name(m_kind));
+  }
+  if (!dev) {
+    return;
+  }
 
-/**
- * Callback when getting volume
- */
-void pulseaudio::get_sink_volume_callback(pa_context *, const pa_sink_info *info, int, void *userdata) {
-  pulseaudio* This = static_cast<pulseaudio *>(userdata);
-  if (info) {
-    This->cv = info->volume;
-    This->muted = info->mute;
+  if (dev->name != s_name) {
+    if (dev->name != spec_s_name)
+      m_log.notice("pulseaudio: using default %s %s", type, dev->name);
+    else
+      m_log.trace("pulseaudio: using %s %s", type, dev->name);
   }
-  pa_threaded_mainloop_signal(This->m_mainloop, 0);
+
+  s_name = dev->name;
+  m_index = dev->index;
+  if (!m_volume_op && !m_volume_dirty)
+    cv = dev->volume;
+  if (!m_mute_op && !m_mute_dirty)
+    muted = dev->muted;
 }
 
 /**
- * Callback when subscribing to changes
+ * Callback when a volume change is done, sends the changes made in the meantime
  */
-void pulseaudio::subscribe_callback(pa_context *, pa_subscription_event_type_t t, uint32_t idx, void* userdata) {
+void pulseaudio::volume_callback(pa_context *, int success, void *userdata) {
   pulseaudio *This = static_cast<pulseaudio *>(userdata);
-  switch(t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) {
-    case PA_SUBSCRIPTION_EVENT_SERVER:
-      switch(t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) {
-        case PA_SUBSCRIPTION_EVENT_CHANGE:
-          This->m_events.emplace(evtype::SERVER);
-        break;
-      }
-      break;
-    case PA_SUBSCRIPTION_EVENT_SINK:
-      switch(t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) {
-        case PA_SUBSCRIPTION_EVENT_NEW:
-            This->m_events.emplace(evtype::NEW);
-          break;
-        case PA_SUBSCRIPTION_EVENT_CHANGE:
-          if (idx == This->m_index)
-            This->m_events.emplace(evtype::CHANGE);
-          break;
-        case PA_SUBSCRIPTION_EVENT_REMOVE:
-          if (idx == This->m_index)
-            This->m_events.emplace(evtype::REMOVE);
-          break;
-      }
-      break;
+  if (!success)
+    This->m_log.err("pulseaudio: Failed to set volume");
+  pa_operation_unref(This->m_volume_op);
+  This->m_volume_op = nullptr;
+  if (This->m_volume_dirty) {
+    This->m_volume_dirty = false;
+    if (!This->send_volume())
+      This->m_log.err("pulseaudio: Failed to set volume");
   }
-  pa_threaded_mainloop_signal(This->m_mainloop, 0);
 }
 
 /**
- * Simple callback to check for success
+ * Callback when a mute change is done, sends the changes made in the meantime
  */
-void pulseaudio::simple_callback(pa_context *, int success, void *userdata) {
+void pulseaudio::mute_callback(pa_context *, int success, void *userdata) {
   pulseaudio *This = static_cast<pulseaudio *>(userdata);
-  This->success = success;
-  pa_threaded_mainloop_signal(This->m_mainloop, 0);
+  if (!success)
+    This->m_log.err("pulseaudio: Failed to mute");
+  pa_operation_unref(This->m_mute_op);
+  This->m_mute_op = nullptr;
+  if (This->m_mute_dirty) {
+    This->m_mute_dirty = false;
+    if (!This->send_mute())
+      This->m_log.err("pulseaudio: Failed to mute");
+  }
 }
 
-
 /**
- * Callback when getting sink info & existence
+ * Send the target volume without waiting for it to be set
+ *
+ * While a change is on its way, the volume is sent again once it is done.
+ * Expects the mainloop to be locked.
  */
-void pulseaudio::sink_info_callback(pa_context *, const pa_sink_info *info, int eol, void *userdata) {
-  pulseaudio *This = static_cast<pulseaudio *>(userdata);
-  if (!eol && info) {
-    This->m_index = info->index;
-    This->s_name = info->name;
+bool pulseaudio::send_volume() {
+  if (m_volume_op) {
+    m_volume_dirty = true;
+    return true;
   }
-  pa_threaded_mainloop_signal(This->m_mainloop, 0);
+
+  if (m_kind == kind::SINK) {
+    m_volume_op = pa_context_set_sink_volume_by_index(m_shared->context(), m_index, &cv, volume_callback, this);
+  } else {
+    m_volume_op = pa_context_set_source_volume_by_index(m_shared->context(), m_index, &cv, volume_callback, this);
+  }
+  return m_volume_op != nullptr;
 }
 
 /**
- * Callback when context state changes
+ * Send the target mute state, like send_volume()
  */
-void pulseaudio::context_state_callback(pa_context *context, void *userdata) {
-  pulseaudio* This = static_cast<pulseaudio *>(userdata);
-  switch (pa_context_get_state(context)) {
-    case PA_CONTEXT_READY:
-    case PA_CONTEXT_TERMINATED:
-    case PA_CONTEXT_FAILED:
-      pa_threaded_mainloop_signal(This->m_mainloop, 0);
-      break;
+bool pulseaudio::send_mute() {
+  if (m_mute_op) {
+    m_mute_dirty = true;
+    return true;
+  }
 
-    case PA_CONTEXT_UNCONNECTED:
-    case PA_CONTEXT_CONNECTING:
-    case PA_CONTEXT_AUTHORIZING:
-    case PA_CONTEXT_SETTING_NAME:
-      break;
+  if (m_kind == kind::SINK) {
+    m_mute_op = pa_context_set_sink_mute_by_index(m_shared->context(), m_index, muted, mute_callback, this);
+  } else {
+    m_mute_op = pa_context_set_source_mute_by_index(m_shared->context(), m_index, muted, mute_callback, this);
   }
+  return m_mute_op != nullptr;
 }
 
-inline void pulseaudio::wait_loop(pa_operation *op, pa_threaded_mainloop *loop) {
-  while (pa_operation_get_state(op) != PA_OPERATION_DONE)
-    pa_threaded_mainloop_wait(loop);
-  pa_operation_unref(op);
+/**
+ * Make the event fd readable, only the first change since the last process_events() does
+ */
+void pulseaudio::notify() {
+  if (m_changed.exchange(true)) {
+    return;
+  }
+
+  uint64_t one{1};
+  if (write(m_eventfd, &one, sizeof(one)) == -1) {
+    m_log.err("pulseaudio: Failed to signal event fd (%s)", strerror(errno));
+  }
 }
 
 POLYBAR_NS_END
@@ -0,0 +1,194 @@
+#include "cairo/font_cache.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "components/logger.hpp"
+#include "errors.hpp"
+#include "utils/file.hpp"
+
+POLYBAR_NS
+
+namespace cairo {
+  namespace {
+    constexpr const char* HEADER{"polybar-font-cache"};
+    constexpr int VERSION{1};
+
+    /**
+     * Latest modification time of all paths in the list, the list is consumed
+     */
+    long newest(FcStrList* list) {
+      long result{0};
+      if (list == nullptr) {
+        return result;
+      }
+
+      FcChar8* path;
+      while ((path = FcStrListNext(list)) != nullptr) {
+        struct stat buffer {};
+        if (stat(reinterpret_cast<const char*>(path), &buffer) == 0) {
+          result = std::max<long>(result, buffer.st_mtime);
+        }
+      }
+
+      FcStrListDone(list);
+      return result;
+    }
+  }  // namespace
+
+  /**
+   * Load the cache file, a missing, broken or outdated file results in an empty cache
+   *
+   * Expects fontconfig to be initialized
+   */
+  font_cache::font_cache(const logger& logger, string path) : m_log(logger), m_path(move(path)), m_stamp(stamp()) {
+    std::ifstream in(m_path);
+    if (!in) {
+      return;
+    }
+
+    string header;
+    int version{0};
+    string stamp;
+    string line;
+
+    if (!std::getline(in, line)) {
+      return;
+    }
+
+    std::istringstream(line) >> header >> version >> stamp;
+    if (header != HEADER || version != VERSION || stamp != m_stamp) {
+      m_log.info("Font cache %s is outdated", m_path);
+      m_dirty = true;
+      return;
+    }
+
+    while (std::getline(in, line)) {
+      auto tab = line.find('\t');
+      if (tab != string::npos) {
+        m_entries.emplace(line.substr(0, tab), line.substr(tab + 1));
+      }
+    }
+
+    m_log.trace("Loaded %lu font matches from %s", m_entries.size(), m_path);
+  }
+
+  /**
+   * Get the cached match for the pattern, nullptr if there is none
+   *
+   * The caller owns the returned pattern
+   */
+  FcPattern* font_cache::lookup(const string& pattern) {
+    string match;
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      auto it = m_entries.find(pattern);
+      if (it == m_entries.end()) {
+        return nullptr;
+      }
+      match = it->second;
+    }
+
+    FcPattern* result = FcNameParse(reinterpret_cast<const FcChar8*>(match.c_str()));
+    FcChar8* file{nullptr};
+
+    // The font file may have been removed without touching the font directories
+    if (result == nullptr || FcPatternGetString(result, FC_FILE, 0, &file) != FcResultMatch ||
+        !file_util::exists(reinterpret_cast<const char*>(file))) {
+      if (result != nullptr) {
+        FcPatternDestroy(result);
+      }
+
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_entries.erase(pattern);
+      m_dirty = true;
+      return nullptr;
+    }
+
+    return result;
+  }
+
+  /**
+   * Remember the match for the pattern
+   *
+   * The charset and languages are left out, they are large and not needed to
+   * load the font.
+   */
+  void font_cache::store(const string& pattern, FcPattern* match) {
+    if (pattern.find_first_of("\t\n") != string::npos) {
+      return;
+    }
+
+    FcPattern* copy = FcPatternDuplicate(match);
+    FcPatternDel(copy, FC_CHARSET);
+    FcPatternDel(copy, FC_LANG);
+    FcChar8* unparsed = FcNameUnparse(copy);
+    FcPatternDestroy(copy);
+
+    if (unparsed == nullptr) {
+      return;
+    }
+
+    string value{reinterpret_cast<const char*>(unparsed)};
+    std::free(unparsed);
+
+    if (value.find('\n') != string::npos) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_entries[pattern] = move(value);
+    m_dirty = true;
+  }
+
+  /**
+   * Write the cache file if anything changed
+   */
+  void font_cache::save() {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!m_dirty) {
+      return;
+    }
+
+    auto dir = m_path.substr(0, m_path.rfind('/'));
+    if (!dir.empty()) {
+      file_util::create_directories(dir);
+    }
+
+    std::ostringstream out;
+    out << HEADER << " " << VERSION << " " << m_stamp << "\n";
+    for (const auto& entry : m_entries) {
+      out << entry.first << "\t" << entry.second << "\n";
+    }
+
+    // Written to a temporary file first so that concurrently starting bars never read a partial file
+    string tmp{m_path + ".tmp." + to_string(getpid())};
+    file_util::write_contents(tmp, out.str());
+    if (rename(tmp.c_str(), m_path.c_str()) == -1) {
+      unlink(tmp.c_str());
+      throw system_error("Failed to write " + m_path);
+    }
+
+    m_dirty = false;
+  }
+
+  /**
+   * Fontconfig version and latest modification of anything that can change the result of a match
+   */
+  string font_cache::stamp() {
+    long mtime{0};
+    mtime = std::max(mtime, newest(FcConfigGetConfigFiles(nullptr)));
+    mtime = std::max(mtime, newest(FcConfigGetConfigDirs(nullptr)));
+    mtime = std::max(mtime, newest(FcConfigGetFontDirs(nullptr)));
+    mtime = std::max(mtime, newest(FcConfigGetCacheDirs(nullptr)));
+    return to_string(FcGetVersion()) + ":" + to_string(mtime);
+  }
+}  // namespace cairo
+
+POLYBAR_NS_END
@@ -1,11 +1,45 @@
+#include <cstring>
 #include <map>
 
 #include "cairo/utils.hpp"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 POLYBAR_NS
 
 namespace cairo {
   namespace utils {
+    namespace {
+      /**
+       * Number of ASCII bytes at the start of `src`, scanning 16 bytes at a time where possible
+       */
+      size_t ascii_prefix(const unsigned char* src, size_t len) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 16 <= len; i += 16) {
+          auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+          int mask = _mm_movemask_epi8(chunk);
+          if (mask != 0) {
+            return i + __builtin_ctz(mask);
+          }
+        }
+#elif defined(__ARM_NEON)
+        for (; i + 16 <= len; i += 16) {
+          if (vmaxvq_u8(vld1q_u8(src + i)) >= 0x80) {
+            break;
+          }
+        }
+#endif
+        while (i < len && src[i] < 0x80) {
+          i++;
+        }
+        return i;
+      }
+    }  // namespace
 
     // implementation : device_lock {{{
 
@@ -38,6 +72,60 @@ namespace cairo {
       return m_face;
     }
 
+    // }}}
+    // implementation : glyph_coverage {{{
+
+    constexpr unsigned long glyph_coverage::PLANES;
+    constexpr unsigned long glyph_coverage::PAGES;
+    constexpr unsigned long glyph_coverage::PAGE_SIZE;
+
+    /**
+     * Check if the codepoint was already looked up
+     */
+    bool glyph_coverage::known(unsigned long codepoint) const {
+      const page* p = find(codepoint);
+      return p != nullptr && p->known[codepoint % PAGE_SIZE];
+    }
+
+    /**
+     * Check if the font has a glyph for the codepoint, only valid if known() is true
+     */
+    bool glyph_coverage::covered(unsigned long codepoint) const {
+      const page* p = find(codepoint);
+      return p != nullptr && p->covered[codepoint % PAGE_SIZE];
+    }
+
+    /**
+     * Record the result of a lookup, codepoints outside of unicode are ignored
+     */
+    void glyph_coverage::set(unsigned long codepoint, bool covered) {
+      unsigned long index = codepoint / PAGE_SIZE;
+      if (index / PAGES >= PLANES) {
+        return;
+      }
+
+      auto& pl = m_planes[index / PAGES];
+      if (!pl) {
+        pl = make_unique<plane>();
+      }
+
+      auto& p = (*pl)[index % PAGES];
+      if (!p) {
+        p = make_unique<page>();
+      }
+
+      p->known[codepoint % PAGE_SIZE] = true;
+      p->covered[codepoint % PAGE_SIZE] = covered;
+    }
+
+    const glyph_coverage::page* glyph_coverage::find(unsigned long codepoint) const {
+      unsigned long index = codepoint / PAGE_SIZE;
+      if (index / PAGES >= PLANES || !m_planes[index / PAGES]) {
+        return nullptr;
+      }
+      return (*m_planes[index / PAGES])[index % PAGES].get();
+    }
+
     // }}}
     // implementation : unicode_character {{{
 
@@ -95,36 +183,65 @@ namespace cairo {
       if (!src) {
         return false;
       }
-      const unsigned char* first = src;
-      while (*first) {
-        int len = 0;
+      return utf8_to_ucs4(src, strlen(reinterpret_cast<const char*>(src)), result_list);
+    }
+
+    /**
+     * \brief Create UCS-4 codepoints from the first `len` bytes of a utf-8 encoded string
+     *
+     * The characters are appended to `result_list`. Runs of ASCII characters
+     * are found in bulk and copied without decoding them byte by byte.
+     *
+     * \returns false if an invalid leading byte was found, the characters
+     * before it are still appended
+     */
+    bool utf8_to_ucs4(const unsigned char* src, size_t len, unicode_charlist& result_list) {
+      if (!src) {
+        return false;
+      }
+      result_list.reserve(result_list.size() + len);
+
+      size_t pos = 0;
+      while (pos < len) {
+        size_t ascii = pos + ascii_prefix(src + pos, len - pos);
+        for (; pos < ascii; pos++) {
+          unicode_character uc_char;
+          uc_char.codepoint = src[pos];
+          uc_char.offset = pos;
+          uc_char.length = 1;
+          result_list.push_back(uc_char);
+        }
+
+        if (pos == len) {
+          break;
+        }
+
+        const unsigned char* first = src + pos;
+        int length = 0;
         unsigned long result = 0;
-        if ((*first >> 7) == 0) {
-          len = 1;
-          result = *first;
-        } else if ((*first >> 5) == 6) {
-          len = 2;
+        if ((*first >> 5) == 6) {
+          length = 2;
           result = *first & 31;
         } else if ((*first >> 4) == 14) {
-          len = 3;
+          length = 3;
           result = *first & 15;
         } else if ((*first >> 3) == 30) {
-          len = 4;
+          length = 4;
           result = *first & 7;
         } else {
           return false;
         }
         const unsigned char* next;
-        for (next = first + 1; *next && ((*next >> 6) == 2) && (next - first < len); next++) {
+        for (next = first + 1; next < src + len && ((*next >> 6) == 2) && (next - first < length); next++) {
           result = result << 6;
           result |= *next & 63;
         }
         unicode_character uc_char;
         uc_char.codepoint = result;
-        uc_char.offset = first - src;
+        uc_char.offset = pos;
         uc_char.length = next - first;
         result_list.push_back(uc_char);
-        first = next;
+        pos = next - src;
       }
       return true;
     }
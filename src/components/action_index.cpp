@@ -0,0 +1,108 @@
+#include "components/action_index.hpp"
+
+#include <algorithm>
+
+POLYBAR_NS
+
+namespace {
+  /**
+   * Same rounding as action_block::test
+   */
+  int first_pixel(const action_block& a) {
+    return static_cast<int>(a.start_x);
+  }
+
+  int last_pixel(const action_block& a) {
+    return static_cast<int>(a.end_x);
+  }
+}  // namespace
+
+/**
+ * Build the index for the given blocks
+ *
+ * The blocks have to use absolute positions
+ */
+action_index::action_index(vector<action_block> actions) : m_actions(move(actions)) {
+  for (const auto& a : m_actions) {
+    if (first_pixel(a) < last_pixel(a)) {
+      m_bounds.emplace_back(first_pixel(a));
+      m_bounds.emplace_back(last_pixel(a));
+    }
+  }
+
+  std::sort(m_bounds.begin(), m_bounds.end());
+  m_bounds.erase(std::unique(m_bounds.begin(), m_bounds.end()), m_bounds.end());
+
+  if (m_bounds.size() < 2) {
+    m_bounds.clear();
+    return;
+  }
+
+  const auto segment = [&](int bound) {
+    return static_cast<size_t>(std::lower_bound(m_bounds.begin(), m_bounds.end(), bound) - m_bounds.begin());
+  };
+
+  // Count the blocks of every segment first, so that all entries fit into a single vector
+  size_t segments = m_bounds.size() - 1;
+  m_offsets.assign(segments + 1, 0);
+
+  for (const auto& a : m_actions) {
+    if (first_pixel(a) < last_pixel(a)) {
+      for (size_t i = segment(first_pixel(a)); i < segment(last_pixel(a)); i++) {
+        m_offsets[i + 1]++;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < segments; i++) {
+    m_offsets[i + 1] += m_offsets[i];
+  }
+
+  m_entries.resize(m_offsets.back());
+  vector<size_t> fill(m_offsets.begin(), m_offsets.end() - 1);
+
+  for (auto a = m_actions.rbegin(); a != m_actions.rend(); a++) {
+    if (first_pixel(*a) < last_pixel(*a)) {
+      for (size_t i = segment(first_pixel(*a)); i < segment(last_pixel(*a)); i++) {
+        m_entries[fill[i]++] = &*a;
+      }
+    }
+  }
+}
+
+/**
+ * All blocks in the order they were added
+ */
+const vector<action_block>& action_index::actions() const {
+  return m_actions;
+}
+
+/**
+ * Blocks covering the given point, innermost first
+ */
+action_index::range action_index::at(int point) const {
+  auto bound = std::upper_bound(m_bounds.begin(), m_bounds.end(), point);
+  if (bound == m_bounds.begin() || bound == m_bounds.end()) {
+    return range{m_entries.end(), m_entries.end()};
+  }
+
+  size_t i = static_cast<size_t>(bound - m_bounds.begin()) - 1;
+  return range{m_entries.begin() + m_offsets[i], m_entries.begin() + m_offsets[i + 1]};
+}
+
+/**
+ * Innermost completed block at the given point that handles the button
+ *
+ * \returns nullptr if there is none
+ */
+const action_block* action_index::find(int point, mousebtn btn) const {
+  for (const auto* a : at(point)) {
+    if (a->button == btn && !a->active) {
+      return a;
+    }
+  }
+
+  return nullptr;
+}
+
+POLYBAR_NS_END
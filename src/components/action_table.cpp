@@ -0,0 +1,113 @@
+#include "components/action_table.hpp"
+
+#include <cstdlib>
+
+#include "utils/factory.hpp"
+
+POLYBAR_NS
+
+constexpr size_t action_table::MAX_ENTRIES;
+
+/**
+ * Create instance
+ */
+action_table::make_type action_table::make() {
+  return static_cast<action_table&>(*factory_util::singleton<action_table>());
+}
+
+action_table::scope::scope(action_table& table) : m_table(table) {}
+
+/**
+ * Drop the ids of this scope from the table
+ */
+action_table::scope::~scope() {
+  for (auto&& id : m_ids) {
+    m_table.remove(id.second.first);
+  }
+}
+
+/**
+ * Id for the given action of the module
+ *
+ * Only actions that aren't known to the scope yet touch the table.
+ *
+ * \returns the full action string if the table is disabled, the scope is full
+ *          or the action is malformed
+ */
+string action_table::scope::intern(const string& module_name, const string& action_name, const string& data) {
+  if (!m_table.enabled()) {
+    return "#" + module_name + "." + action_name + (data.empty() ? "" : "." + data);
+  }
+
+  m_key.assign(action_name).push_back('\0');
+  m_key.append(data);
+
+  auto it = m_ids.find(m_key);
+  if (it != m_ids.end()) {
+    return it->second.second;
+  }
+
+  string action_str{"#" + module_name + "." + action_name + (data.empty() ? "" : "." + data)};
+  if (m_ids.size() == MAX_ENTRIES) {
+    return action_str;
+  }
+
+  actions_util::action action;
+  try {
+    action = actions_util::parse_action_string(action_str);
+  } catch (const std::runtime_error&) {
+    // Reported when it is clicked
+    return action_str;
+  }
+
+  auto index = m_table.add(move(action));
+  return m_ids.emplace(m_key, std::make_pair(index, "#" + to_string(index))).first->second.second;
+}
+
+/**
+ * Emit full action strings from now on
+ *
+ * Has to be called before any module builds its output.
+ */
+void action_table::disable() {
+  m_enabled = false;
+}
+
+bool action_table::enabled() const {
+  return m_enabled;
+}
+
+/**
+ * Look up the action of an id returned by a scope
+ *
+ * \returns false if `cmd` isn't an id or its scope is gone
+ */
+bool action_table::resolve(const string& cmd, actions_util::action& result) const {
+  if (cmd.size() < 2 || cmd.front() != '#' || cmd.find_first_not_of("0123456789", 1) != string::npos) {
+    return false;
+  }
+
+  auto index = std::strtoul(cmd.c_str() + 1, nullptr, 10);
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto it = m_entries.find(index);
+  if (it == m_entries.end()) {
+    return false;
+  }
+
+  result = it->second;
+  return true;
+}
+
+size_t action_table::add(actions_util::action&& action) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_entries.emplace(m_next, move(action));
+  return m_next++;
+}
+
+void action_table::remove(size_t index) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_entries.erase(index);
+}
+
+POLYBAR_NS_END
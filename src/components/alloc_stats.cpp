@@ -0,0 +1,249 @@
+#include "components/alloc_stats.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+POLYBAR_NS
+
+namespace chrono = std::chrono;
+
+namespace {
+  /**
+   * Counters of a single tag
+   *
+   * They are updated from operator new and delete, so they are plain
+   * atomics that are usable before any constructor ran.
+   */
+  struct counters {
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> frees{0};
+    std::atomic<size_t> allocated_bytes{0};
+    std::atomic<size_t> live_bytes{0};
+  };
+
+  counters g_counters[alloc_stats::MAX_TAGS];
+  thread_local alloc_tag t_current{0};
+
+  /**
+   * Names of the tags, the index is the tag
+   */
+  struct registry {
+    std::mutex lock;
+    vector<string> names{"other"};
+    chrono::steady_clock::time_point since{chrono::steady_clock::now()};
+  };
+
+  registry& get_registry() {
+    static registry instance;
+    return instance;
+  }
+}  // namespace
+
+namespace alloc_stats {
+  /**
+   * Get the tag with the given name, registering it if necessary
+   *
+   * Once all tags are taken, further names share tag 0.
+   */
+  alloc_tag tag(const string& name) {
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    for (size_t i = 0; i < reg.names.size(); i++) {
+      if (reg.names[i] == name) {
+        return i;
+      }
+    }
+    if (reg.names.size() == MAX_TAGS) {
+      return 0;
+    }
+    reg.names.emplace_back(name);
+    return reg.names.size() - 1;
+  }
+
+  alloc_tag current() {
+    return t_current;
+  }
+
+  void set_current(alloc_tag tag) {
+    t_current = tag;
+  }
+
+  /**
+   * Number of allocations of all tags since the last reset
+   */
+  size_t allocations() {
+    size_t total{0};
+    for (const auto& c : g_counters) {
+      total += c.allocations.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /**
+   * Produce one line per tag that allocated since the last reset or still
+   * holds memory, ordered by tag
+   */
+  vector<string> report() {
+    vector<string> lines;
+    if (!enabled()) {
+      return lines;
+    }
+
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - reg.since).count();
+
+    for (size_t i = 0; i < reg.names.size(); i++) {
+      const auto& c = g_counters[i];
+      size_t allocations = c.allocations;
+      size_t live = c.live_bytes;
+
+      if (allocations == 0 && live == 0) {
+        continue;
+      }
+
+      std::ostringstream line;
+      line << std::left << std::setw(32) << reg.names[i] << std::right << std::fixed << std::setprecision(1);
+      line << " allocs=" << allocations;
+      line << " rate=" << (seconds > 0.0 ? allocations / seconds : 0.0) << "/s";
+      line << " frees=" << c.frees;
+      line << " allocated=" << c.allocated_bytes << "B";
+      line << " live=" << live << "B";
+      lines.emplace_back(line.str());
+    }
+
+    return lines;
+  }
+
+  /**
+   * Zero the counters of all tags, live bytes are kept as they are still
+   * held
+   */
+  void reset() {
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    for (auto&& c : g_counters) {
+      c.allocations = 0;
+      c.frees = 0;
+      c.allocated_bytes = 0;
+    }
+    reg.since = chrono::steady_clock::now();
+  }
+}  // namespace alloc_stats
+
+POLYBAR_NS_END
+
+#if ENABLE_ALLOC_STATS
+POLYBAR_NS
+
+namespace {
+  /**
+   * Stored in front of every allocation, so that it is freed from the tag
+   * that allocated it
+   */
+  struct block_header {
+    size_t size;
+    alloc_tag tag;
+  };
+
+  // Keeps the memory handed out aligned like malloc's
+  constexpr size_t HEADER_SIZE{alignof(std::max_align_t)};
+  static_assert(sizeof(block_header) <= HEADER_SIZE, "block header doesn't fit");
+
+  void* allocate(size_t size) noexcept {
+    auto* block = static_cast<char*>(std::malloc(HEADER_SIZE + size));
+    if (block == nullptr) {
+      return nullptr;
+    }
+
+    alloc_tag tag = t_current;
+    *reinterpret_cast<block_header*>(block) = block_header{size, tag};
+
+    auto& c = g_counters[tag];
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    c.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    c.live_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    return block + HEADER_SIZE;
+  }
+
+  /**
+   * Allocate like the default operator new, calling the new handler until it
+   * succeeds
+   */
+  void* allocate_or_throw(size_t size) {
+    void* ptr;
+    while ((ptr = allocate(size)) == nullptr) {
+      auto handler = std::get_new_handler();
+      if (handler == nullptr) {
+        throw std::bad_alloc();
+      }
+      handler();
+    }
+    return ptr;
+  }
+
+  void deallocate(void* ptr) noexcept {
+    if (ptr == nullptr) {
+      return;
+    }
+
+    auto* block = static_cast<char*>(ptr) - HEADER_SIZE;
+    auto header = *reinterpret_cast<block_header*>(block);
+
+    auto& c = g_counters[header.tag];
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    c.live_bytes.fetch_sub(header.size, std::memory_order_relaxed);
+
+    std::free(block);
+  }
+}  // namespace
+
+POLYBAR_NS_END
+
+void* operator new(std::size_t size) {
+  return polybar::allocate_or_throw(size);
+}
+
+void* operator new[](std::size_t size) {
+  return polybar::allocate_or_throw(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return polybar::allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return polybar::allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  polybar::deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  polybar::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  polybar::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+  polybar::deallocate(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  polybar::deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  polybar::deallocate(ptr);
+}
+#endif
@@ -2,10 +2,16 @@
 
 #include <algorithm>
 
+#include "components/alloc_stats.hpp"
 #include "components/config.hpp"
 #include "components/renderer.hpp"
+#include "components/scheduler.hpp"
 #include "components/screen.hpp"
+#include "components/startup_profile.hpp"
+#include "components/stats.hpp"
+#include "components/tracer.hpp"
 #include "components/taskqueue.hpp"
+#include "components/thread_policy.hpp"
 #include "components/types.hpp"
 #include "drawtypes/label.hpp"
 #include "events/signal.hpp"
@@ -39,6 +45,8 @@ using namespace signals::ui;
  * Create instance
  */
 bar::make_type bar::make(bool only_initialize_values) {
+  startup_profile::phase profile{"bar"};
+
   // clang-format off
   return factory_util::unique<bar>(
         connection::make(),
@@ -127,6 +135,22 @@ bar::bar(connection& conn, signal_emitter& emitter, const config& config, const
   m_log.info("Loaded monitor %s (%ix%i+%i+%i)", m_opts.monitor->name, m_opts.monitor->w, m_opts.monitor->h,
       m_opts.monitor->x, m_opts.monitor->y);
 
+  auto max_fps = m_conf.get("settings", "max-fps", 0U);
+
+  if (max_fps == 0U && !only_initialize_values) {
+    // Don't redraw more often than the monitor can show
+    auto rate = randr_util::get_refresh_rate(m_connection, m_opts.monitor);
+    max_fps = static_cast<unsigned int>(rate + 0.5);
+  }
+
+  if (max_fps != 0U) {
+    m_opts.max_fps = max_fps;
+  }
+
+#if WITH_XCURSOR
+  m_motion_throttle.offset = std::max(1U, 1000U / m_opts.max_fps);
+#endif
+
   try {
     m_opts.override_redirect = m_conf.get<bool>(bs, "dock");
     m_conf.warn_deprecated(bs, "dock", "override-redirect");
@@ -137,6 +161,8 @@ bar::bar(connection& conn, signal_emitter& emitter, const config& config, const
   m_opts.dimvalue = m_conf.get(bs, "dim-value", 1.0);
   m_opts.dimvalue = math_util::cap(m_opts.dimvalue, 0.0, 1.0);
 
+  m_suspend_hidden = m_conf.get(bs, "suspend-when-hidden", m_suspend_hidden);
+
   m_opts.cursor_click = m_conf.get(bs, "cursor-click", ""s);
   m_opts.cursor_scroll = m_conf.get(bs, "cursor-scroll", ""s);
 #if WITH_XCURSOR
@@ -295,16 +321,30 @@ bar::bar(connection& conn, signal_emitter& emitter, const config& config, const
       m_opts.borders[edge::LEFT].size);
 
   m_log.trace("bar: Attach X event sink");
-  m_connection.attach_sink(this, SINK_PRIORITY_BAR);
+  m_connection.attach_sink(this, SINK_PRIORITY_BAR, {WM_STATE});
 
   m_log.trace("bar: Attach signal receiver");
   m_sig.attach(this);
+
+  m_render_thread = thread_policy::spawn(thread_policy::role::UI, [this] { render_frames(); });
 }
 
 /**
  * Cleanup signal handlers and destroy the bar window
  */
 bar::~bar() {
+  stop_rendering();
+
+  size_t shade_task{0};
+  {
+    std::lock_guard<std::mutex> guard(m_shade_lock);
+    std::swap(shade_task, m_shade_task);
+    m_shade_generation++;
+  }
+  if (shade_task != 0) {
+    scheduler::make().remove(shade_task);
+  }
+
   std::lock_guard<std::mutex> guard(m_mutex);
   m_connection.detach_sink(this, SINK_PRIORITY_BAR);
   m_sig.detach(this);
@@ -312,27 +352,122 @@ bar::~bar() {
 
 /**
  * Get the bar settings container
+ *
+ * Modules, builders and the renderer keep this reference instead of a copy,
+ * it stays valid for as long as the bar exists.
  */
-const bar_settings bar::settings() const {
+const bar_settings& bar::settings() const {
   return m_opts;
 }
 
 /**
- * Parse input string and redraw the bar window
+ * Split parsed input into its alignment blocks
  *
- * \param data Input string
- * \param force Unless true, do not parse unchanged data
+ * Each block starts at its alignment tag. Returns an empty map if the input
+ * cannot be split cleanly, i.e. if there is content before the first
+ * alignment tag or if an alignment occurs more than once.
  */
-void bar::parse(string&& data, bool force) {
-  if (!m_mutex.try_lock()) {
-    return;
+static std::map<alignment, pair<tags::format_string::const_iterator, tags::format_string::const_iterator>> find_blocks(
+    const tags::format_string& input) {
+  std::map<alignment, pair<tags::format_string::const_iterator, tags::format_string::const_iterator>> blocks;
+
+  if (input.empty() || !tags::is_alignment(input.front())) {
+    return blocks;
+  }
+
+  for (auto it = input.begin(); it != input.end();) {
+    auto next = std::find_if(std::next(it), input.end(), tags::is_alignment);
+    if (!blocks.emplace(tags::get_alignment(*it), make_pair(it, next)).second) {
+      return {};
+    }
+    it = next;
+  }
+
+  return blocks;
+}
+
+/**
+ * Hand the parsed input to the render thread
+ *
+ * Returns right away. If the render thread is still busy with an earlier
+ * frame, only the latest input is drawn once it is done. The caller is
+ * responsible for not passing unchanged data.
+ *
+ * \param data Parsed bar contents
+ * \param force Draw even if the bar is currently not visible
+ */
+void bar::parse(tags::format_string&& data, bool force) {
+  {
+    std::lock_guard<std::mutex> guard(m_frame_lock);
+    m_frame = move(data);
+    m_frame_force = m_frame_force || force;
+    m_frame_pending = true;
+  }
+  m_frame_cond.notify_one();
+}
+
+/**
+ * Stop and join the render thread, frames passed to parse() afterwards are
+ * not drawn anymore
+ *
+ * Drawing emits signals, so this has to be called before their receivers go
+ * away.
+ */
+void bar::stop_rendering() {
+  if (m_render_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(m_frame_lock);
+      m_render_stop = true;
+    }
+    m_frame_cond.notify_one();
+    m_render_thread.join();
+  }
+}
+
+/**
+ * Render thread, draws the latest frame passed to parse() until the bar is destroyed
+ */
+void bar::render_frames() {
+  std::unique_lock<std::mutex> lock(m_frame_lock);
+
+  while (true) {
+    m_frame_cond.wait(lock, [&] { return m_frame_pending || m_render_stop; });
+    if (m_render_stop) {
+      return;
+    }
+
+    tags::format_string frame;
+    frame.swap(m_frame);
+    bool force{m_frame_force};
+    m_frame_pending = false;
+    m_frame_force = false;
+
+    lock.unlock();
+    try {
+      draw(move(frame), force);
+    } catch (const exception& err) {
+      m_log.err("Failed to draw bar contents (reason: %s)", err.what());
+    }
+    lock.lock();
   }
+}
 
-  std::lock_guard<std::mutex> guard(m_mutex, std::adopt_lock);
+/**
+ * Draw the parsed input and redraw the bar window
+ *
+ * Only called on the render thread
+ */
+void bar::draw(tags::format_string&& data, bool force) {
+  std::lock_guard<std::mutex> guard(m_mutex);
 
-  bool unchanged = data == m_lastinput;
+  // Blocks of the previously drawn input can be compared against the new input
+  tags::format_string previous;
+  if (m_lastinput_drawn) {
+    previous = move(m_lastinput);
+  }
 
-  m_lastinput = data;
+  m_lastinput = move(data);
+  m_lastinput_drawn = false;
 
   if (force) {
     m_log.trace("bar: Force update");
@@ -340,8 +475,6 @@ void bar::parse(string&& data, bool force) {
     return m_log.trace("bar: Ignoring update (invisible)");
   } else if (m_opts.shaded) {
     return m_log.trace("bar: Ignoring update (shaded)");
-  } else if (unchanged) {
-    return m_log.trace("bar: Ignoring update (unchanged)");
   }
 
   auto rect = m_opts.inner_area();
@@ -357,31 +490,50 @@ void bar::parse(string&& data, bool force) {
     }
   }
 
+  static const alloc_tag renderer_tag{alloc_stats::tag("renderer")};
+  scoped_alloc_tag tag{renderer_tag};
+
   m_log.info("Redrawing bar window");
   m_renderer->begin(rect);
 
+  auto previous_blocks = find_blocks(previous);
+
+  // Blocks that are identical to the previous frame are not drawn again, neither are blocks
+  // in which only a single text changed (e.g. the frame of an animation)
+  const auto reuse = [&](tags::format_string::const_iterator begin, tags::format_string::const_iterator end) {
+    auto block = previous_blocks.find(tags::get_alignment(*begin));
+    if (block == previous_blocks.end() ||
+        std::distance(begin, end) != std::distance(block->second.first, block->second.second)) {
+      return false;
+    }
+
+    auto changed = std::mismatch(begin, end, block->second.first);
+    if (changed.first == end) {
+      return m_renderer->reuse_block(block->first);
+    } else if (changed.first->is_tag || changed.second->is_tag ||
+               !std::equal(std::next(changed.first), end, std::next(changed.second))) {
+      return false;
+    }
+
+    auto slot = std::count_if(begin, changed.first, [](const tags::element& el) { return !el.is_tag; });
+    return m_renderer->patch_block(block->first, slot, changed.first->data);
+  };
+
   try {
-    m_dispatch->parse(settings(), data);
+    scoped_timer timer{stats::make().get("dispatch.parse")};
+    POLYBAR_TRACE("bar.draw");
+
+    if (!previous_blocks.empty() && !find_blocks(m_lastinput).empty()) {
+      m_dispatch->parse(settings(), *m_renderer, m_lastinput, reuse);
+    } else {
+      m_dispatch->parse(settings(), *m_renderer, m_lastinput);
+    }
   } catch (const exception& err) {
     m_log.err("Failed to parse contents (reason: %s)", err.what());
   }
 
   m_renderer->end();
-
-  const auto check_dblclicks = [&]() -> bool {
-    for (auto&& action : m_renderer->actions()) {
-      if (static_cast<int>(action.button) >= static_cast<int>(mousebtn::DOUBLE_LEFT)) {
-        return true;
-      }
-    }
-    for (auto&& action : m_opts.actions) {
-      if (static_cast<int>(action.button) >= static_cast<int>(mousebtn::DOUBLE_LEFT)) {
-        return true;
-      }
-    }
-    return false;
-  };
-  m_dblclicks = check_dblclicks();
+  m_lastinput_drawn = true;
 }
 
 /**
@@ -396,8 +548,9 @@ void bar::hide() {
     m_log.info("Hiding bar window");
     m_sig.emit(visibility_change{false});
     m_connection.unmap_window_checked(m_opts.window);
-    m_connection.flush();
+    m_connection.request_flush();
     m_visible = false;
+    update_suspended();
   } catch (const exception& err) {
     m_log.err("Failed to unmap bar window (err=%s", err.what());
   }
@@ -421,9 +574,21 @@ void bar::show() {
      */
     reconfigue_window();
     m_connection.map_window_checked(m_opts.window);
-    m_connection.flush();
+    m_connection.request_flush();
     m_visible = true;
-    parse(string{m_lastinput}, true);
+    update_suspended();
+
+    // Draws the last input again, unless newer input is waiting anyway
+    {
+      std::lock_guard<std::mutex> guard(m_frame_lock);
+      if (!m_frame_pending) {
+        std::lock_guard<std::mutex> input_guard(m_mutex);
+        m_frame = m_lastinput;
+      }
+      m_frame_force = true;
+      m_frame_pending = true;
+    }
+    m_frame_cond.notify_one();
   } catch (const exception& err) {
     m_log.err("Failed to map bar window (err=%s", err.what());
   }
@@ -440,6 +605,15 @@ void bar::toggle() {
   }
 }
 
+/**
+ * Finish work that was deferred until a burst of X events was handled
+ */
+void bar::events_handled() {
+  if (m_tray) {
+    m_tray->events_handled();
+  }
+}
+
 /**
  * Move the bar window above defined sibling
  * in the X window stack
@@ -632,17 +806,52 @@ void bar::handle(const evt::leave_notify&) {
  * Event handler for XCB_MOTION_NOTIFY events
  *
  * Used to change the cursor depending on the module
+ *
+ * The cursor is picked at most once per frame, motion in between is
+ * coalesced and the last position is picked up once the frame is over.
  */
 void bar::handle(const evt::motion_notify& evt) {
-  if (!m_mutex.try_lock()) {
+  m_log.trace("bar: Detected motion: %i at pos(%i, %i)", evt->detail, evt->event_x, evt->event_y);
+#if WITH_XCURSOR
+  std::lock_guard<std::mutex> guard(m_cursor_lock);
+  m_motion_pos = evt->event_x;
+  m_motion_time = evt->time;
+
+  if (m_motion_time >= m_motion_throttle.event + m_motion_throttle.offset) {
+    update_cursor();
+  } else if (!m_motion_pending) {
+    m_motion_pending = true;
+    m_taskqueue->defer("motion-notify", taskqueue::deferred::duration{m_motion_throttle.offset}, [&](size_t) {
+      std::lock_guard<std::mutex> lock(m_cursor_lock);
+      m_motion_pending = false;
+      update_cursor();
+    });
+  }
+#endif
+}
+
+#if WITH_XCURSOR
+/**
+ * Pick the cursor for the actions below the last pointer position
+ *
+ * The cursor is only changed if the pointer moved to different actions or the
+ * actions were redrawn.
+ *
+ * Expects m_cursor_lock to be held
+ */
+void bar::update_cursor() {
+  m_motion_throttle.event = m_motion_time;
+
+  auto actions = m_renderer->actions();
+  auto area = actions->at(m_motion_pos);
+
+  if (actions == m_cursor_actions && area.first == m_cursor_area.first && area.last == m_cursor_area.last) {
     return;
   }
 
-  std::lock_guard<std::mutex> guard(m_mutex, std::adopt_lock);
+  m_cursor_actions = actions;
+  m_cursor_area = area;
 
-  m_log.trace("bar: Detected motion: %i at pos(%i, %i)", evt->detail, evt->event_x, evt->event_y);
-#if WITH_XCURSOR
-  m_motion_pos = evt->event_x;
   // scroll cursor is less important than click cursor, so we shouldn't return until we are sure there is no click
   // action
   bool found_scroll = false;
@@ -664,12 +873,10 @@ void bar::handle(const evt::motion_notify& evt) {
     return false;
   };
 
-  for (auto&& action : m_renderer->actions()) {
-    if (action.test(m_motion_pos)) {
-      m_log.trace("Found matching input area");
-      if (find_click_area(action))
-        return;
-    }
+  for (auto&& action : area) {
+    m_log.trace("Found matching input area");
+    if (find_click_area(*action))
+      return;
   }
   if (found_scroll) {
     if (!string_util::compare(m_opts.cursor, m_opts.cursor_scroll)) {
@@ -698,8 +905,8 @@ void bar::handle(const evt::motion_notify& evt) {
     m_sig.emit(cursor_change{string{m_opts.cursor}});
     return;
   }
-#endif
 }
+#endif
 
 /**
  * Event handler for XCB_BUTTON_PRESS events
@@ -707,11 +914,8 @@ void bar::handle(const evt::motion_notify& evt) {
  * Used to map mouse clicks to bar actions
  */
 void bar::handle(const evt::button_press& evt) {
-  if (!m_mutex.try_lock()) {
-    return;
-  }
-
-  std::lock_guard<std::mutex> guard(m_mutex, std::adopt_lock);
+  // Waits for a frame that is being drawn instead of dropping the click
+  std::lock_guard<std::mutex> guard(m_mutex);
 
   if (m_buttonpress.deny(evt->time)) {
     return m_log.trace_x("bar: Ignoring button press (throttled)...");
@@ -721,26 +925,22 @@ void bar::handle(const evt::button_press& evt) {
 
   m_buttonpress_btn = static_cast<mousebtn>(evt->detail);
   m_buttonpress_pos = evt->event_x;
+  m_buttonpress_time = chrono::steady_clock::now();
 
   const auto deferred_fn = [&](size_t) {
-    /*
-     * Iterate over all defined actions in reverse order until matching action is found
-     * To properly handle nested actions we iterate in reverse because nested actions are added later than their
-     * surrounding action block
-     */
+    // The index returns the innermost action, nested actions are added later than their surrounding action block
     auto actions = m_renderer->actions();
-    for (auto action = actions.rbegin(); action != actions.rend(); action++) {
-      if (action->button == m_buttonpress_btn && !action->active && action->test(m_buttonpress_pos)) {
-        m_log.trace("Found matching input area");
-        m_sig.emit(button_press{string{action->command}});
-        return;
-      }
+    const auto* match = actions->find(m_buttonpress_pos, m_buttonpress_btn);
+    if (match != nullptr) {
+      m_log.trace("Found matching input area");
+      m_sig.emit(button_press{make_pair(string{match->command}, m_buttonpress_time)});
+      return;
     }
 
     for (auto&& action : m_opts.actions) {
       if (action.button == m_buttonpress_btn && !action.command.empty()) {
         m_log.trace("Found matching fallback handler");
-        m_sig.emit(button_press{string{action.command}});
+        m_sig.emit(button_press{make_pair(string{action.command}, m_buttonpress_time)});
         return;
       }
     }
@@ -758,15 +958,21 @@ void bar::handle(const evt::button_press& evt) {
     }
   };
 
-  // If there are no double click handlers defined we can
-  // just by-pass the click timer handling
-  if (!m_dblclicks) {
-    deferred_fn(0);
-  } else if (evt->detail == static_cast<int>(mousebtn::LEFT)) {
+  // Only a click that a double click handler could be found for at its position has to wait for a second
+  // click, all other clicks are handled right away
+  const auto has_double = [&](mousebtn btn) {
+    if (m_renderer->actions()->find(m_buttonpress_pos, btn) != nullptr) {
+      return true;
+    }
+    return std::any_of(m_opts.actions.begin(), m_opts.actions.end(),
+        [&](const action& a) { return a.button == btn && !a.command.empty(); });
+  };
+
+  if (evt->detail == static_cast<int>(mousebtn::LEFT) && has_double(mousebtn::DOUBLE_LEFT)) {
     check_double("buttonpress-left", mousebtn::DOUBLE_LEFT);
-  } else if (evt->detail == static_cast<int>(mousebtn::MIDDLE)) {
+  } else if (evt->detail == static_cast<int>(mousebtn::MIDDLE) && has_double(mousebtn::DOUBLE_MIDDLE)) {
     check_double("buttonpress-middle", mousebtn::DOUBLE_MIDDLE);
-  } else if (evt->detail == static_cast<int>(mousebtn::RIGHT)) {
+  } else if (evt->detail == static_cast<int>(mousebtn::RIGHT) && has_double(mousebtn::DOUBLE_RIGHT)) {
     check_double("buttonpress-right", mousebtn::DOUBLE_RIGHT);
   } else {
     deferred_fn(0);
@@ -789,6 +995,35 @@ void bar::handle(const evt::expose& evt) {
   }
 }
 
+/**
+ * Event handler for XCB_VISIBILITY_NOTIFY events
+ *
+ * Compositors redirect all windows, so with a compositor the bar is never
+ * reported as obscured
+ */
+void bar::handle(const evt::visibility_notify& evt) {
+  if (evt->window == m_opts.window) {
+    m_obscured = evt->state == XCB_VISIBILITY_FULLY_OBSCURED;
+    update_suspended();
+  }
+}
+
+/**
+ * Suspend the periodic module updates while the bar can't be seen
+ *
+ * That is while it is hidden, shaded or completely covered by other windows.
+ * Nothing would be drawn anyway, and the modules update right away once the
+ * bar can be seen again. Modules that wait for events keep running.
+ */
+void bar::update_suspended() {
+  if (!m_suspend_hidden) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(m_suspend_lock);
+  scheduler::make().suspend(!m_visible || m_opts.shaded || m_obscured);
+}
+
 /**
  * Event handler for XCB_PROPERTY_NOTIFY events
  *
@@ -809,7 +1044,13 @@ void bar::handle(const evt::property_notify& evt) {
   }
 }
 
-void bar::handle(const evt::configure_notify&) {
+void bar::handle(const evt::configure_notify& evt) {
+  if (evt->window == m_opts.window) {
+    std::lock_guard<std::mutex> guard(m_shade_lock);
+    m_geom_y = evt->y;
+    m_geom_h = evt->height;
+  }
+
   // The absolute position of the window in the root may be different after configuration is done
   // (for example, because the parent is not positioned at 0/0 in the root window).
   // Notify components that the geometry may have changed (used by the background manager for example).
@@ -818,7 +1059,10 @@ void bar::handle(const evt::configure_notify&) {
 
 bool bar::on(const signals::eventqueue::start&) {
   m_log.trace("bar: Create renderer");
-  m_renderer = renderer::make(m_opts);
+  {
+    startup_profile::phase profile{"renderer"};
+    m_renderer = renderer::make(m_opts);
+  }
   m_opts.window = m_renderer->window();
 
   // Subscribe to window enter and leave events
@@ -830,6 +1074,9 @@ bool bar::on(const signals::eventqueue::start&) {
     m_connection.ensure_event_mask(m_opts.window, XCB_EVENT_MASK_POINTER_MOTION);
   }
   m_connection.ensure_event_mask(m_opts.window, XCB_EVENT_MASK_STRUCTURE_NOTIFY);
+  if (m_suspend_hidden) {
+    m_connection.ensure_event_mask(m_opts.window, XCB_EVENT_MASK_VISIBILITY_CHANGE);
+  }
 
   m_log.info("Bar window: %s", m_connection.id(m_opts.window));
   reconfigue_window();
@@ -844,6 +1091,12 @@ bool bar::on(const signals::eventqueue::start&) {
   // Reconfigure window position after mapping (required by Openbox)
   reconfigure_pos();
 
+  {
+    std::lock_guard<std::mutex> guard(m_shade_lock);
+    m_geom_y = m_opts.pos.y;
+    m_geom_h = m_opts.size.h;
+  }
+
   m_log.trace("bar: Draw empty bar");
   m_renderer->begin(m_opts.inner_area());
   m_renderer->end();
@@ -852,7 +1105,10 @@ bool bar::on(const signals::eventqueue::start&) {
 
   // TODO: tray manager could run this internally on ready event
   m_log.trace("bar: Setup tray manager");
-  m_tray->setup(static_cast<const bar_settings&>(m_opts));
+  {
+    startup_profile::phase profile{"tray"};
+    m_tray->setup(static_cast<const bar_settings&>(m_opts));
+  }
 
   broadcast_visibility();
 
@@ -865,35 +1121,17 @@ bool bar::on(const signals::ui::unshade_window&) {
   m_opts.shade_size.h = m_opts.size.h;
   m_opts.shade_pos.x = m_opts.pos.x;
   m_opts.shade_pos.y = m_opts.pos.y;
+  update_suspended();
 
-  double distance{static_cast<double>(m_opts.shade_size.h - m_connection.get_geometry(m_opts.window)->height)};
-  double steptime{25.0 / 2.0};
-  m_anim_step = distance / steptime / 2.0;
-
-  m_taskqueue->defer_unique(
-      "window-shade", 25ms,
-      [&](size_t remaining) {
-        if (!m_opts.shaded) {
-          m_sig.emit(signals::ui::tick{});
-        }
-        if (!remaining) {
-          m_renderer->flush();
-        }
-        if (m_opts.dimmed) {
-          m_opts.dimmed = false;
-          m_sig.emit(dim_window{1.0});
-        }
-      },
-      taskqueue::deferred::duration{25ms}, 10U);
-
+  animate_shade(0ms);
   return true;
 }
 
 bool bar::on(const signals::ui::shade_window&) {
-  taskqueue::deferred::duration offset{2000ms};
+  chrono::milliseconds delay{2000ms};
 
   if (!m_opts.shaded && m_opts.shade_size.h != m_opts.size.h) {
-    offset = taskqueue::deferred::duration{25ms};
+    delay = 0ms;
   }
 
   m_opts.shaded = true;
@@ -905,62 +1143,102 @@ bool bar::on(const signals::ui::shade_window&) {
   if (m_opts.origin == edge::BOTTOM) {
     m_opts.shade_pos.y = m_opts.pos.y + m_opts.size.h - m_opts.shade_size.h;
   }
+  update_suspended();
 
-  double distance{static_cast<double>(m_connection.get_geometry(m_opts.window)->height - m_opts.shade_size.h)};
-  double steptime{25.0 / 2.0};
-  m_anim_step = distance / steptime / 2.0;
-
-  m_taskqueue->defer_unique(
-      "window-shade", 25ms,
-      [&](size_t remaining) {
-        if (m_opts.shaded) {
-          m_sig.emit(signals::ui::tick{});
-        }
-        if (!remaining) {
-          m_renderer->flush();
-        }
-        if (!m_opts.dimmed) {
-          m_opts.dimmed = true;
-          m_sig.emit(dim_window{double{m_opts.dimvalue}});
-        }
-      },
-      move(offset), 10U);
-
+  animate_shade(delay);
   return true;
 }
 
-bool bar::on(const signals::ui::tick&) {
-  auto geom = m_connection.get_geometry(m_opts.window);
-  if (geom->y == m_opts.shade_pos.y && geom->height == m_opts.shade_size.h) {
-    return false;
+/**
+ * Move the window towards m_opts.shade_pos and m_opts.shade_size after the delay
+ *
+ * An animation that is still running is stopped where it is, the new one
+ * starts from there.
+ */
+void bar::animate_shade(chrono::milliseconds delay) {
+  size_t running{0};
+  size_t generation{0};
+  {
+    std::lock_guard<std::mutex> guard(m_shade_lock);
+    std::swap(running, m_shade_task);
+    generation = ++m_shade_generation;
   }
 
-  unsigned int mask{0};
-  unsigned int values[7]{0};
-  xcb_params_configure_window_t params{};
+  // Waits for a step that is in progress, which takes m_shade_lock
+  if (running != 0) {
+    scheduler::make().remove(running);
+  }
+
+  scheduler::make().defer(
+      chrono::duration_cast<scheduler::duration>(delay), [this, generation] { start_shade(generation); });
+}
 
-  if (m_opts.shade_size.h > geom->height) {
-    XCB_AUX_ADD_PARAM(&mask, &params, height, static_cast<unsigned int>(geom->height + m_anim_step));
-    params.height = std::max(1U, std::min(params.height, static_cast<unsigned int>(m_opts.shade_size.h)));
-  } else if (m_opts.shade_size.h < geom->height) {
-    XCB_AUX_ADD_PARAM(&mask, &params, height, static_cast<unsigned int>(geom->height - m_anim_step));
-    params.height = std::max(1U, std::max(params.height, static_cast<unsigned int>(m_opts.shade_size.h)));
+void bar::start_shade(size_t generation) {
+  {
+    std::lock_guard<std::mutex> guard(m_shade_lock);
+    if (generation != m_shade_generation || m_shade_task != 0) {
+      return;
+    }
+
+    m_shade_start = chrono::steady_clock::now();
+    m_shade_from_y = m_geom_y;
+    m_shade_from_h = m_geom_h;
+
+    auto interval = chrono::duration_cast<scheduler::duration>(1s) / m_opts.max_fps;
+    // Shading suspends the scheduler, the animation has to keep running anyway
+    auto zero = scheduler::duration::zero();
+    m_shade_task = scheduler::make().add("bar.shade", interval, [this] { step_shade(); }, zero, zero, 0);
   }
 
-  if (m_opts.shade_pos.y > geom->y) {
-    XCB_AUX_ADD_PARAM(&mask, &params, y, static_cast<int>(geom->y + m_anim_step));
-    params.y = std::min(params.y, static_cast<int>(m_opts.shade_pos.y));
-  } else if (m_opts.shade_pos.y < geom->y) {
-    XCB_AUX_ADD_PARAM(&mask, &params, y, static_cast<int>(geom->y - m_anim_step));
-    params.y = std::max(params.y, static_cast<int>(m_opts.shade_pos.y));
+  if (m_opts.shaded != m_opts.dimmed) {
+    m_opts.dimmed = m_opts.shaded;
+    m_sig.emit(dim_window{m_opts.shaded ? double{m_opts.dimvalue} : 1.0});
   }
+}
 
-  connection::pack_values(mask, &params, values);
+/**
+ * Resize the window for the current frame of the shading animation
+ *
+ * The geometry is interpolated by the time since the animation started, so
+ * late frames don't slow it down. It is tracked locally instead of being
+ * queried from the X server for every frame.
+ */
+void bar::step_shade() {
+  std::unique_lock<std::mutex> guard(m_shade_lock);
+  if (m_shade_task == 0) {
+    return;
+  }
 
-  m_connection.configure_window(m_opts.window, mask, values);
-  m_connection.flush();
+  static constexpr chrono::duration<double, std::milli> duration{250.0};
+  double progress = std::min(1.0, (chrono::steady_clock::now() - m_shade_start) / duration);
 
-  return false;
+  int y = m_shade_from_y + static_cast<int>(std::lround((m_opts.shade_pos.y - m_shade_from_y) * progress));
+  int h = m_shade_from_h + static_cast<int>(std::lround((m_opts.shade_size.h - m_shade_from_h) * progress));
+  h = std::max(1, h);
+
+  if (y != m_geom_y || h != m_geom_h) {
+    unsigned int mask{0};
+    unsigned int values[7]{0};
+    xcb_params_configure_window_t params{};
+    XCB_AUX_ADD_PARAM(&mask, &params, y, y);
+    XCB_AUX_ADD_PARAM(&mask, &params, height, static_cast<unsigned int>(h));
+    connection::pack_values(mask, &params, values);
+
+    m_connection.configure_window(m_opts.window, mask, values);
+    m_connection.request_flush();
+
+    m_geom_y = y;
+    m_geom_h = h;
+  }
+
+  if (progress >= 1.0) {
+    auto task = m_shade_task;
+    m_shade_task = 0;
+    guard.unlock();
+
+    scheduler::make().remove(task);
+    m_renderer->flush();
+  }
 }
 
 bool bar::on(const signals::ui::dim_window& sig) {
@@ -969,12 +1247,54 @@ bool bar::on(const signals::ui::dim_window& sig) {
   return false;
 }
 
+/**
+ * Follow the monitor of the bar to its new position
+ *
+ * The geometry of the bar only depends on the size of its monitor, so the
+ * window is just moved if that stayed the same. Otherwise, or if the monitor is
+ * gone, the bar is reloaded.
+ */
+bool bar::on(const signals::ui::monitors_changed&) {
+  auto mon = randr_util::match_monitor(m_screen->monitors(), m_opts.monitor->name, m_opts.monitor_exact);
+
+  if (!mon || mon->w != m_opts.monitor->w || mon->h != m_opts.monitor->h) {
+    m_log.notice("Monitor %s was removed or resized... reloading", m_opts.monitor->name);
+    m_sig.emit(signals::eventqueue::exit_reload{});
+    return true;
+  }
+
+  int dx = mon->x - m_opts.monitor->x;
+  int dy = mon->y - m_opts.monitor->y;
+
+  if (dx != 0 || dy != 0) {
+    m_log.info("Monitor %s moved to %+i%+i, moving bar", mon->name, mon->x, mon->y);
+    m_opts.monitor->x = mon->x;
+    m_opts.monitor->y = mon->y;
+    m_opts.pos.x += dx;
+    m_opts.pos.y += dy;
+    reconfigure_pos();
+    if (m_tray) {
+      m_tray->move(dx, dy);
+    }
+  }
+
+  // The struts are relative to the edges of the screen, which may have been resized
+  reconfigure_struts();
+  m_connection.request_flush();
+
+  if (dx != 0 || dy != 0) {
+    m_sig.emit(signals::ui::update_geometry{});
+  }
+
+  return true;
+}
+
 #if WITH_XCURSOR
 bool bar::on(const signals::ui::cursor_change& sig) {
   if (!cursor_util::set_cursor(m_connection, m_connection.screen(), m_opts.window, sig.cast())) {
     m_log.warn("Failed to create cursor context");
   }
-  m_connection.flush();
+  m_connection.request_flush();
   return false;
 }
 #endif
@@ -1,9 +1,11 @@
 #include "components/builder.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <utility>
 
 #include "drawtypes/label.hpp"
-#include "utils/actions.hpp"
+#include "modules/meta/base.hpp"
 #include "utils/color.hpp"
 #include "utils/string.hpp"
 #include "utils/time.hpp"
@@ -11,34 +13,40 @@ POLYBAR_NS
 
 using namespace tags;
 
-builder::builder(const bar_settings& bar) : m_bar(bar) {
+builder::builder(const bar_settings& bar) : m_bar(bar), m_actions(action_table::make()) {
+  /* Add all values as keys so that we never have to check if a key exists in
+   * the map
+   */
+  for (auto tag : {syntaxtag::A, syntaxtag::B, syntaxtag::F, syntaxtag::T, syntaxtag::R, syntaxtag::o, syntaxtag::u,
+           syntaxtag::P}) {
+    m_tags[tag] = 0;
+  }
+  for (auto tag : {syntaxtag::B, syntaxtag::F, syntaxtag::o, syntaxtag::u}) {
+    m_colors[tag] = string();
+  }
+  for (auto attr : {attribute::NONE, attribute::UNDERLINE, attribute::OVERLINE}) {
+    m_attrs[attr] = false;
+  }
+
   reset();
 }
 
+/**
+ * Clear the builder state
+ *
+ * The maps and the output buffer are reset in place so that they keep their
+ * storage across flushes
+ */
 void builder::reset() {
-  /* Add all values as keys so that we never have to check if a key exists in
-   * the map
-   */
-  m_tags.clear();
-  m_tags[syntaxtag::A] = 0;
-  m_tags[syntaxtag::B] = 0;
-  m_tags[syntaxtag::F] = 0;
-  m_tags[syntaxtag::T] = 0;
-  m_tags[syntaxtag::R] = 0;
-  m_tags[syntaxtag::o] = 0;
-  m_tags[syntaxtag::u] = 0;
-  m_tags[syntaxtag::P] = 0;
-
-  m_colors.clear();
-  m_colors[syntaxtag::B] = string();
-  m_colors[syntaxtag::F] = string();
-  m_colors[syntaxtag::o] = string();
-  m_colors[syntaxtag::u] = string();
-
-  m_attrs.clear();
-  m_attrs[attribute::NONE] = false;
-  m_attrs[attribute::UNDERLINE] = false;
-  m_attrs[attribute::OVERLINE] = false;
+  for (auto&& tag : m_tags) {
+    tag.second = 0;
+  }
+  for (auto&& color : m_colors) {
+    color.second.clear();
+  }
+  for (auto&& attr : m_attrs) {
+    attr.second = false;
+  }
 
   m_output.clear();
   m_fontindex = 1;
@@ -76,6 +84,7 @@ string builder::flush() {
     action_close();
   }
 
+  // Copied so that m_output keeps its capacity for the next build
   string output{m_output};
 
   reset();
@@ -86,9 +95,8 @@ string builder::flush() {
 /**
  * Insert raw text string
  */
-void builder::append(string text) {
-  m_output.reserve(text.size());
-  m_output += move(text);
+void builder::append(const string& text) {
+  m_output += text;
 }
 
 /**
@@ -101,7 +109,7 @@ void builder::node(string str) {
     return;
   }
 
-  append(move(str));
+  append(str);
 }
 
 /**
@@ -209,6 +217,31 @@ void builder::offset(int pixels) {
   tag_open(syntaxtag::O, to_string(pixels));
 }
 
+/**
+ * Insert a graph of the given width in pixels, drawn by the renderer
+ *
+ * Values are percentages, a bar only uses the last one.
+ */
+void builder::graph(graph_type type, int width, const vector<double>& values) {
+  if (width <= 0 || values.empty()) {
+    return;
+  }
+
+  string tag{type == graph_type::BAR ? "b" : "s"};
+  tag += to_string(width);
+  tag += ':';
+
+  auto first = type == graph_type::BAR ? std::prev(values.end()) : values.begin();
+  for (auto it = first; it != values.end(); ++it) {
+    if (it != first) {
+      tag += ',';
+    }
+    tag += to_string(static_cast<int>(std::round(std::max(0.0, std::min(100.0, *it)))));
+  }
+
+  tag_open(syntaxtag::G, tag);
+}
+
 /**
  * Insert spaces
  */
@@ -229,7 +262,7 @@ void builder::space() {
 void builder::remove_trailing_space(size_t len) {
   if (len == 0_z || len > m_output.size()) {
     return;
-  } else if (m_output.substr(m_output.size() - len) == string(len, ' ')) {
+  } else if (m_output.find_first_not_of(' ', m_output.size() - len) == string::npos) {
     m_output.erase(m_output.size() - len);
   }
 }
@@ -400,6 +433,22 @@ void builder::control(controltag tag) {
   }
 }
 
+/**
+ * Reserve space for everything up to the next reset control tag
+ */
+void builder::reserve(const reserved_width& width) {
+  if (width.width <= 0) {
+    return;
+  }
+
+  string tag{width.fixed ? "F" : "W"};
+  tag += to_string(width.width);
+  if (width.chars) {
+    tag += 'c';
+  }
+  tag_open(syntaxtag::P, tag);
+}
+
 /**
  * Open action tag with the given action string
  *
@@ -407,16 +456,18 @@ void builder::control(controltag tag) {
  */
 void builder::action(mousebtn index, string action) {
   if (!action.empty()) {
-    action = string_util::replace_all(action, ":", "\\:");
+    string_util::replace_all_inplace(action, ":", "\\:");
     tag_open(syntaxtag::A, to_string(static_cast<int>(index)) + ":" + action + ":");
   }
 }
 
 /**
  * Open action tag for the action of the given module
+ *
+ * The tag holds the id of the action in the action table, if it is enabled
  */
 void builder::action(mousebtn btn, const modules::module_interface& module, string action_name, string data) {
-  action(btn, actions_util::get_action_string(module, action_name, data));
+  action(btn, m_actions.intern(module.name_raw(), action_name, data));
 }
 
 /**
@@ -435,7 +486,7 @@ void builder::action(mousebtn index, string action_name, const label_t& label) {
  */
 void builder::action(
     mousebtn btn, const modules::module_interface& module, string action_name, string data, const label_t& label) {
-  action(btn, actions_util::get_action_string(module, action_name, data), label);
+  action(btn, m_actions.intern(module.name_raw(), action_name, data), label);
 }
 
 /**
@@ -453,31 +504,31 @@ void builder::tag_open(syntaxtag tag, const string& value) {
 
   switch (tag) {
     case syntaxtag::A:
-      append("%{A" + value + "}");
+      append_tag('A', value);
       break;
     case syntaxtag::F:
-      append("%{F" + value + "}");
+      append_tag('F', value);
       break;
     case syntaxtag::B:
-      append("%{B" + value + "}");
+      append_tag('B', value);
       break;
     case syntaxtag::T:
-      append("%{T" + value + "}");
+      append_tag('T', value);
       break;
     case syntaxtag::u:
-      append("%{u" + value + "}");
+      append_tag('u', value);
       break;
     case syntaxtag::o:
-      append("%{o" + value + "}");
+      append_tag('o', value);
       break;
     case syntaxtag::R:
       append("%{R}");
       break;
     case syntaxtag::O:
-      append("%{O" + value + "}");
+      append_tag('O', value);
       break;
     case syntaxtag::P:
-      append("%{P" + value + "}");
+      append_tag('P', value);
       break;
     case syntaxtag::l:
       append("%{l}");
@@ -488,9 +539,22 @@ void builder::tag_open(syntaxtag tag, const string& value) {
     case syntaxtag::r:
       append("%{r}");
       break;
+    case syntaxtag::G:
+      append_tag('G', value);
+      break;
   }
 }
 
+/**
+ * Write `%{<tag><value>}` without building a temporary string
+ */
+void builder::append_tag(char tag, const string& value) {
+  m_output += "%{";
+  m_output += tag;
+  m_output += value;
+  m_output += '}';
+}
+
 /**
  * Insert directive to use given attribute unless already set
  */
@@ -548,6 +612,7 @@ void builder::tag_close(syntaxtag tag) {
     case syntaxtag::l:
     case syntaxtag::c:
     case syntaxtag::r:
+    case syntaxtag::G:
       break;
   }
 }
@@ -1,6 +1,7 @@
 #include "components/config.hpp"
 
 #include <climits>
+#include <deque>
 #include <fstream>
 
 #include "cairo/utils.hpp"
@@ -13,6 +14,77 @@ POLYBAR_NS
 
 namespace chrono = std::chrono;
 
+namespace {
+  using parameter = pair<string, string>;
+
+  size_t parameter_hash(const string& section, const string& key) {
+    size_t h{std::hash<string>{}(section)};
+    return h ^ (std::hash<string>{}(key) + 0x9e3779b9 + (h << 6) + (h >> 2));
+  }
+
+  /**
+   * Collect which parameters reference which other parameter
+   *
+   * `refs` maps each referenced parameter to the parameters referencing it.
+   */
+  void collect_references(
+      const sectionmap_t& sections, const string& bar, std::map<parameter, std::set<parameter>>& refs) {
+    for (const auto& section : sections) {
+      for (const auto& param : section.second) {
+        const auto& value = param.second;
+
+        for (auto pos = value.find("${"); pos != string::npos; pos = value.find("${", pos + 2)) {
+          auto dot = value.find('.', pos);
+          auto end = value.find_first_of(":}", dot);
+          if (dot == string::npos || end == string::npos) {
+            break;
+          }
+
+          auto target = value.substr(pos + 2, dot - pos - 2);
+          if (target == "root" || target == "BAR") {
+            target = bar;
+          } else if (target == "self") {
+            target = section.first;
+          }
+
+          refs[{target, value.substr(dot + 1, end - dot - 1)}].emplace(section.first, param.first);
+        }
+      }
+    }
+  }
+
+  /**
+   * Check if the value references something outside of the config file
+   */
+  bool external_reference(const string& value) {
+    return value.compare(0, 6, "${env:") == 0 || value.compare(0, 7, "${file:") == 0 ||
+           value.compare(0, 7, "${xrdb:") == 0;
+  }
+
+  /**
+   * Add all parameters of `section` that are missing or different in `other`
+   */
+  void collect_changes(const sectionmap_t::value_type& section, const sectionmap_t& other, std::deque<parameter>& out) {
+    auto it = other.find(section.first);
+    for (const auto& param : section.second) {
+      if (it == other.end()) {
+        out.emplace_back(section.first, param.first);
+        continue;
+      }
+
+      auto value = it->second.find(param.first);
+      if (value == it->second.end() || value->second != param.second) {
+        out.emplace_back(section.first, param.first);
+      }
+    }
+
+    // Sections without parameters still count
+    if (section.second.empty() && it == other.end()) {
+      out.emplace_back(section.first, "");
+    }
+  }
+}  // namespace
+
 /**
  * Create instance
  */
@@ -27,6 +99,13 @@ const string& config::filepath() const {
   return m_file;
 }
 
+/**
+ * Get the name of the bar in use
+ */
+const string& config::barname() const {
+  return m_barname;
+}
+
 /**
  * Get the section name of the bar in use
  */
@@ -48,23 +127,143 @@ void config::use_xrm() {
 }
 
 void config::set_sections(sectionmap_t sections) {
-  m_sections = move(sections);
-  copy_inherited();
+  auto next = make_shared<values>();
+  next->sections = move(sections);
+  copy_inherited(*next);
+
+  std::lock_guard<std::mutex> guard(m_write_lock);
+  publish(move(next));
 }
 
 void config::set_included(file_list included) {
   m_included = move(included);
 }
 
+/**
+ * Take over the parameters of another instance parsed from the same file
+ */
+void config::assign(const config& other) {
+  auto next = make_shared<values>();
+  next->sections = other.snapshot()->sections;
+
+  std::lock_guard<std::mutex> guard(m_write_lock);
+  m_included = other.m_included;
+  publish(move(next));
+#if WITH_XRM
+  if (other.m_xrm) {
+    use_xrm();
+  }
+#endif
+}
+
+/**
+ * Set parameter value
+ */
+void config::set(const string& section, const string& key, string&& value) {
+  std::lock_guard<std::mutex> guard(m_write_lock);
+  auto next = make_shared<values>();
+  next->sections = snapshot()->sections;
+  next->sections[section][key] = move(value);
+  publish(move(next));
+}
+
+/**
+ * Raw value of a parameter without dereferencing or conversion
+ *
+ * The value stays valid until the parameters change.
+ *
+ * \returns nullptr if the section or parameter doesn't exist
+ */
+const string* config::find(const string& section, const string& key) const {
+  return snapshot()->find(section, key);
+}
+
+const string* config::values::find(const string& section, const string& key) const {
+  if (index.empty()) {
+    return nullptr;
+  }
+
+  size_t hash{parameter_hash(section, key)};
+  size_t mask{index.size() - 1};
+
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    const auto& s = index[i];
+    if (s.value == nullptr) {
+      return nullptr;
+    } else if (s.hash == hash && *s.key == key && *s.section == section) {
+      return s.value;
+    }
+  }
+}
+
+/**
+ * Get the sections that have different values in `other`
+ *
+ * Besides the sections with added, removed or modified parameters, this
+ * includes every section with a parameter that references such a parameter,
+ * directly or through other references.
+ */
+std::set<string> config::changed_sections(const config& other) const {
+  std::deque<parameter> pending;
+  auto current = snapshot();
+  auto next = other.snapshot();
+
+  for (const auto& section : current->sections) {
+    collect_changes(section, next->sections, pending);
+  }
+
+  for (const auto& section : next->sections) {
+    collect_changes(section, current->sections, pending);
+  }
+
+  // The environment, files and X resources can change without any change in the file
+  for (const auto& section : next->sections) {
+    for (const auto& param : section.second) {
+      const string* raw{current->find(section.first, param.first)};
+      if (raw == nullptr || *raw != param.second || !external_reference(*raw)) {
+        continue;
+      }
+
+      if (resolved(*current, section.first, param.first, *raw) !=
+          resolved(*next, section.first, param.first, param.second)) {
+        pending.emplace_back(section.first, param.first);
+      }
+    }
+  }
+
+  // References that were removed still changed the value of the referencing parameter
+  std::map<parameter, std::set<parameter>> refs;
+  collect_references(current->sections, section(), refs);
+  collect_references(next->sections, other.section(), refs);
+
+  std::set<parameter> visited;
+  std::set<string> result;
+  while (!pending.empty()) {
+    auto param = move(pending.front());
+    pending.pop_front();
+
+    if (!visited.emplace(param).second) {
+      continue;
+    }
+
+    result.emplace(param.first);
+
+    auto it = refs.find(param);
+    if (it != refs.end()) {
+      pending.insert(pending.end(), it->second.begin(), it->second.end());
+    }
+  }
+
+  return result;
+}
+
 /**
  * Print a deprecation warning if the given parameter is set
  */
 void config::warn_deprecated(const string& section, const string& key, string replacement) const {
-  try {
-    auto value = get<string>(section, key);
+  if (has(section, key)) {
     m_log.warn(
         "The config parameter `%s.%s` is deprecated, use `%s.%s` instead.", section, key, section, move(replacement));
-  } catch (const key_error& err) {
   }
 }
 
@@ -77,8 +276,8 @@ void config::warn_deprecated(const string& section, const string& key, string re
  *   [sub/section]
  *   inherit = section1 section2
  */
-void config::copy_inherited() {
-  for (auto&& section : m_sections) {
+void config::copy_inherited(values& next) const {
+  for (auto&& section : next.sections) {
     std::vector<string> inherit_sections;
 
     // Collect all sections to be inherited
@@ -86,7 +285,7 @@ void config::copy_inherited() {
       string key_name = param.first;
       if (key_name == "inherit") {
         auto inherit = param.second;
-        inherit = dereference<string>(section.first, key_name, inherit, inherit);
+        inherit = dereference<string>(next, section.first, key_name, inherit, inherit);
 
         std::vector<string> sections = string_util::split(std::move(inherit), ' ');
 
@@ -100,8 +299,8 @@ void config::copy_inherited() {
             section.first, key_name);
 
         auto inherit = param.second;
-        inherit = dereference<string>(section.first, key_name, inherit, inherit);
-        if (inherit.empty() || m_sections.find(inherit) == m_sections.end()) {
+        inherit = dereference<string>(next, section.first, key_name, inherit, inherit);
+        if (inherit.empty() || next.sections.find(inherit) == next.sections.end()) {
           throw value_error(
               "Invalid section \"" + inherit + "\" defined for \"" + section.first + "." + key_name + "\"");
         }
@@ -111,8 +310,8 @@ void config::copy_inherited() {
     }
 
     for (const auto& base_name : inherit_sections) {
-      const auto base_section = m_sections.find(base_name);
-      if (base_section == m_sections.end()) {
+      const auto base_section = next.sections.find(base_name);
+      if (base_section == next.sections.end()) {
         throw value_error("Invalid section \"" + base_name + "\" defined for \"" + section.first + ".inherit\"");
       }
 
@@ -129,6 +328,96 @@ void config::copy_inherited() {
   }
 }
 
+/**
+ * Make the snapshot the current one
+ *
+ * Expects m_write_lock to be held
+ */
+void config::publish(shared_ptr<values> next) {
+  next->build_index();
+  std::atomic_store(&m_values, shared_ptr<const values>(move(next)));
+}
+
+/**
+ * Build the lookup table, before the snapshot is published
+ *
+ * The table is kept at most half full so that probe sequences stay short
+ */
+void config::values::build_index() {
+  size_t count{0};
+  for (const auto& section : sections) {
+    count += section.second.size();
+  }
+
+  size_t size{16};
+  while (size < count * 2) {
+    size <<= 1;
+  }
+
+  index.assign(size, slot{0, nullptr, nullptr, nullptr});
+  size_t mask{size - 1};
+
+  for (const auto& section : sections) {
+    for (const auto& param : section.second) {
+      size_t hash{parameter_hash(section.first, param.first)};
+      size_t i{hash & mask};
+      while (index[i].value != nullptr) {
+        i = (i + 1) & mask;
+      }
+      index[i] = slot{hash, &section.first, &param.first, &param.second};
+    }
+  }
+}
+
+/**
+ * Resolve the references in a parameter value
+ *
+ * Every value is resolved only once per snapshot, later lookups of the same
+ * parameter and references to it use the stored result. Failed lookups are
+ * not stored.
+ *
+ * \throws value_error if the value references itself, directly or through
+ * other references
+ */
+string config::dereferenced(const values& values, const string& section, const string& key, const string& raw) const {
+  if (raw.compare(0, 2, "${") != 0) {
+    return raw;
+  }
+
+  std::lock_guard<std::recursive_mutex> guard(values.resolve_lock);
+  auto it = values.resolved.find(&raw);
+  if (it != values.resolved.end()) {
+    return it->second;
+  }
+
+  if (!values.resolving.emplace(&raw).second) {
+    throw value_error("Circular reference defined at \"" + section + "." + key + "\"");
+  }
+
+  string value;
+  try {
+    value = dereference<string>(values, section, key, raw, raw);
+  } catch (...) {
+    values.resolving.erase(&raw);
+    throw;
+  }
+
+  values.resolving.erase(&raw);
+  values.resolved.emplace(&raw, value);
+  return value;
+}
+
+/**
+ * Resolved value of a parameter, or its raw value if it can't be resolved
+ */
+string config::resolved(const values& values, const string& section, const string& key, const string& raw) const {
+  try {
+    return dereferenced(values, section, key, raw);
+  } catch (const exception&) {
+    return raw;
+  }
+}
+
 template <>
 string config::convert(string&& value) const {
   return forward<string>(value);
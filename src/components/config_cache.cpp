@@ -0,0 +1,287 @@
+#include "components/config_cache.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "components/logger.hpp"
+#include "errors.hpp"
+#include "utils/file.hpp"
+
+POLYBAR_NS
+
+namespace {
+  constexpr const char HEADER[]{"polybar-config-cache"};
+  constexpr uint32_t VERSION{1};
+
+  /**
+   * Modification time and size of a file or directory
+   */
+  struct stamp {
+    int64_t sec;
+    int64_t nsec;
+    int64_t size;
+
+    bool operator==(const stamp& other) const {
+      return sec == other.sec && nsec == other.nsec && size == other.size;
+    }
+  };
+
+  bool get_stamp(const string& path, stamp& result) {
+    struct stat buffer {};
+    if (stat(path.c_str(), &buffer) == -1) {
+      return false;
+    }
+
+    result = stamp{buffer.st_mtim.tv_sec, buffer.st_mtim.tv_nsec, S_ISDIR(buffer.st_mode) ? 0 : buffer.st_size};
+    return true;
+  }
+
+  /**
+   * Values are stored in host byte order, the cache never leaves the machine
+   */
+  class writer {
+   public:
+    template <typename T>
+    void put(T value) {
+      m_data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void put(const string& value) {
+      put(static_cast<uint32_t>(value.size()));
+      m_data.append(value);
+    }
+
+    const string& data() const {
+      return m_data;
+    }
+
+   private:
+    string m_data;
+  };
+
+  /**
+   * Reads the values written by writer, any read past the end fails all following reads
+   */
+  class reader {
+   public:
+    explicit reader(const string& data) : m_data(data) {}
+
+    template <typename T>
+    bool get(T& value) {
+      if (!m_ok || m_data.size() - m_pos < sizeof(value)) {
+        return m_ok = false;
+      }
+
+      std::memcpy(&value, m_data.data() + m_pos, sizeof(value));
+      m_pos += sizeof(value);
+      return true;
+    }
+
+    bool get(string& value) {
+      uint32_t size{0};
+      if (!get(size) || m_data.size() - m_pos < size) {
+        return m_ok = false;
+      }
+
+      value.assign(m_data, m_pos, size);
+      m_pos += size;
+      return true;
+    }
+
+    bool done() const {
+      return m_ok && m_pos == m_data.size();
+    }
+
+   private:
+    const string& m_data;
+    size_t m_pos{0};
+    bool m_ok{true};
+  };
+
+  /**
+   * Write a list of paths
+   *
+   * \returns false if any of them was modified at or after `since`
+   */
+  bool put_paths(writer& out, const file_list& paths, int64_t since) {
+    out.put(static_cast<uint32_t>(paths.size()));
+    for (const auto& path : paths) {
+      stamp s{};
+      if (!get_stamp(path, s)) {
+        throw system_error("Failed to stat " + path);
+      }
+
+      if (s.sec * 1000000000 + s.nsec >= since) {
+        return false;
+      }
+
+      out.put(path);
+      out.put(s.sec);
+      out.put(s.nsec);
+      out.put(s.size);
+    }
+
+    return true;
+  }
+
+  /**
+   * Read a list of paths, fails if any of them changed since they were written
+   */
+  bool get_paths(reader& in, file_list& paths) {
+    uint32_t count{0};
+    if (!in.get(count)) {
+      return false;
+    }
+
+    paths.clear();
+    for (uint32_t i = 0; i < count; i++) {
+      string path;
+      stamp stored{};
+      stamp current{};
+
+      if (!in.get(path) || !in.get(stored.sec) || !in.get(stored.nsec) || !in.get(stored.size)) {
+        return false;
+      }
+
+      if (!get_stamp(path, current) || !(current == stored)) {
+        return false;
+      }
+
+      paths.emplace_back(move(path));
+    }
+
+    return true;
+  }
+}  // namespace
+
+config_cache::config_cache(const logger& logger, string path) : m_log(logger), m_path(move(path)) {}
+
+/**
+ * Cache file for the given config file in the cache directory
+ *
+ * Each config file gets its own cache, bars from the same file share it.
+ */
+string config_cache::path_for(const string& cache_dir, const string& config) {
+  char name[32];
+  snprintf(name, sizeof(name), "config-%016zx.cache", std::hash<string>{}(config));
+  return cache_dir + "/" + name;
+}
+
+/**
+ * Load the snapshot of the given config file
+ *
+ * \returns false if there is no snapshot or it is broken or outdated
+ */
+bool config_cache::load(const string& config, snapshot& result) const {
+  std::ifstream file(m_path, std::ifstream::binary);
+  if (!file) {
+    return false;
+  }
+
+  string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  reader in{data};
+
+  string header;
+  uint32_t version{0};
+  if (!in.get(header) || !in.get(version) || header != HEADER || version != VERSION) {
+    m_log.info("Config cache %s has an unknown format", m_path);
+    return false;
+  }
+
+  snapshot loaded;
+  if (!get_paths(in, loaded.files) || !get_paths(in, loaded.directories) || loaded.files.empty() ||
+      loaded.files.front() != config) {
+    m_log.info("Config cache %s is outdated", m_path);
+    return false;
+  }
+
+  uint8_t use_xrm{0};
+  uint32_t sections{0};
+  if (!in.get(use_xrm) || !in.get(sections)) {
+    return false;
+  }
+  loaded.use_xrm = use_xrm != 0;
+
+  for (uint32_t i = 0; i < sections; i++) {
+    string name;
+    uint32_t params{0};
+    if (!in.get(name) || !in.get(params)) {
+      return false;
+    }
+
+    auto& values = loaded.sections[move(name)];
+    values.reserve(params);
+
+    for (uint32_t j = 0; j < params; j++) {
+      string key;
+      string value;
+      if (!in.get(key) || !in.get(value)) {
+        return false;
+      }
+      values.emplace(move(key), move(value));
+    }
+  }
+
+  if (!in.done()) {
+    return false;
+  }
+
+  m_log.trace("Loaded %lu config sections from %s", loaded.sections.size(), m_path);
+  result = move(loaded);
+  return true;
+}
+
+/**
+ * Write the snapshot, replacing the previous one
+ *
+ * \returns false without writing anything if one of the files was modified
+ * while it was parsed, the snapshot may not match its contents
+ */
+bool config_cache::save(const snapshot& data) const {
+  // File timestamps come from a coarser clock that can lag behind a bit
+  auto since = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      (data.parsed - std::chrono::seconds{1}).time_since_epoch())
+                   .count();
+
+  writer out;
+  out.put(string{HEADER});
+  out.put(VERSION);
+  if (!put_paths(out, data.files, since) || !put_paths(out, data.directories, since)) {
+    m_log.info("Config changed while it was parsed, not updating %s", m_path);
+    return false;
+  }
+  out.put(static_cast<uint8_t>(data.use_xrm));
+
+  out.put(static_cast<uint32_t>(data.sections.size()));
+  for (const auto& section : data.sections) {
+    out.put(section.first);
+    out.put(static_cast<uint32_t>(section.second.size()));
+    for (const auto& param : section.second) {
+      out.put(param.first);
+      out.put(param.second);
+    }
+  }
+
+  auto dir = m_path.substr(0, m_path.rfind('/'));
+  if (!dir.empty()) {
+    file_util::create_directories(dir);
+  }
+
+  // Written to a temporary file first so that concurrently starting bars never read a partial file
+  string tmp{m_path + ".tmp." + to_string(getpid())};
+  file_util::write_contents(tmp, out.data());
+  if (rename(tmp.c_str(), m_path.c_str()) == -1) {
+    unlink(tmp.c_str());
+    throw system_error("Failed to write " + m_path);
+  }
+
+  return true;
+}
+
+POLYBAR_NS_END
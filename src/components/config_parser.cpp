@@ -4,7 +4,9 @@
 #include <cerrno>
 #include <cstring>
 #include <fstream>
+#include <iterator>
 
+#include "components/config_cache.hpp"
 #include "utils/file.hpp"
 #include "utils/string.hpp"
 
@@ -14,11 +16,46 @@ config_parser::config_parser(const logger& logger, string&& file, string&& bar)
     : m_log(logger), m_config(file_util::expand(file)), m_barname(move(bar)) {}
 
 config::make_type config_parser::parse() {
-  m_log.notice("Parsing config file: %s", m_config);
+  config::make_type result = config::make(m_config, m_barname);
+
+  // Cast to non-const to set sections, included and xrm
+  parse(const_cast<config&>(result));
+
+  return result;
+}
+
+void config_parser::parse(config& conf) {
+  config_cache::snapshot snapshot;
+  unique_ptr<config_cache> cache;
+  if (!m_cache.empty()) {
+    cache = make_unique<config_cache>(m_log, m_cache);
+  }
+
+  if (cache && cache->load(m_config, snapshot)) {
+    m_log.notice("Loaded config file from cache: %s", m_config);
+    m_files = move(snapshot.files);
+    use_xrm = snapshot.use_xrm;
+  } else {
+    m_log.notice("Parsing config file: %s", m_config);
+    snapshot.parsed = std::chrono::system_clock::now();
+
+    parse_file(m_config, {});
+    snapshot.sections = create_sectionmap();
 
-  parse_file(m_config, {});
+    if (cache) {
+      snapshot.files = m_files;
+      snapshot.directories = m_directories;
+      snapshot.use_xrm = use_xrm;
 
-  sectionmap_t sections = create_sectionmap();
+      try {
+        cache->save(snapshot);
+      } catch (const exception& err) {
+        m_log.warn("Failed to save config cache (reason: %s)", err.what());
+      }
+    }
+  }
+
+  sectionmap_t sections = move(snapshot.sections);
 
   if (sections.find("bar/" + m_barname) == sections.end()) {
     throw application_error("Undefined bar: " + m_barname);
@@ -30,48 +67,45 @@ config::make_type config_parser::parse() {
    * second element onwards for the included list
    */
   file_list included(m_files.begin() + 1, m_files.end());
-  config::make_type result = config::make(m_config, m_barname);
-
-  // Cast to non-const to set sections, included and xrm
-  config& m_conf = const_cast<config&>(result);
 
-  m_conf.set_sections(move(sections));
-  m_conf.set_included(move(included));
+  conf.set_sections(move(sections));
+  conf.set_included(move(included));
   if (use_xrm) {
-    m_conf.use_xrm();
+    conf.use_xrm();
   }
+}
 
-  return result;
+void config_parser::use_cache() {
+  auto cache_dir = file_util::get_cache_path();
+  if (!cache_dir.empty()) {
+    m_cache = config_cache::path_for(cache_dir, m_config);
+  }
 }
 
 sectionmap_t config_parser::create_sectionmap() {
   sectionmap_t sections{};
 
   string current_section{};
+  valuemap_t* valuemap{nullptr};
 
-  for (const line_t& line : m_lines) {
+  for (line_t& line : m_lines) {
     if (!line.useful) {
       continue;
     }
 
     if (line.is_header) {
       current_section = line.header;
+      valuemap = &sections[current_section];
     } else {
       // The first valid line in the config is not a section definition
-      if (current_section.empty()) {
+      if (valuemap == nullptr) {
         throw syntax_error("First valid line in config must be section header", m_files[line.file_index], line.line_no);
       }
 
-      const string& key = line.key;
-      const string& value = line.value;
-
-      valuemap_t& valuemap = sections[current_section];
-
-      if (valuemap.find(key) == valuemap.end()) {
-        valuemap.emplace(key, value);
-      } else {
+      // The lines are not used after this, so the values are moved into the map
+      if (!valuemap->emplace(line.key, move(line.value)).second) {
         // Key already exists in this section
-        throw syntax_error("Duplicate key name \"" + key + "\" defined in section \"" + current_section + "\"",
+        throw syntax_error("Duplicate key name \"" + line.key + "\" defined in section \"" + current_section + "\"",
             m_files[line.file_index], line.line_no);
       }
     }
@@ -127,13 +161,23 @@ void config_parser::parse_file(const string& file, file_list path) {
 
   string line_str{};
 
-  std::ifstream in(file);
+  std::ifstream in(file, std::ifstream::binary);
 
   if (!in) {
     throw application_error("Failed to open config file " + file + ": " + strerror(errno));
   }
 
-  while (std::getline(in, line_str)) {
+  // The whole file is read at once and split in memory instead of reading it line by line
+  string contents{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+  for (size_t start = 0; start < contents.size();) {
+    size_t end = contents.find('\n', start);
+    if (end == string::npos) {
+      end = contents.size();
+    }
+
+    line_str.assign(contents, start, end - start);
+    start = end + 1;
     line_no++;
     line_t line;
     try {
@@ -159,13 +203,14 @@ void config_parser::parse_file(const string& file, file_list path) {
       parse_file(file_util::expand(line.value), path);
     } else if (!line.is_header && line.key == "include-directory") {
       const string expanded_path = file_util::expand(line.value);
+      m_directories.push_back(expanded_path);
       vector<string> file_list = file_util::list_files(expanded_path);
       sort(file_list.begin(), file_list.end());
       for (const auto& filename : file_list) {
         parse_file(expanded_path + "/" + filename, path);
       }
     } else {
-      m_lines.push_back(line);
+      m_lines.push_back(move(line));
     }
   }
 }
@@ -0,0 +1,57 @@
+#include "components/config_schema.hpp"
+
+#include "utils/string.hpp"
+
+POLYBAR_NS
+
+config_schema::config_schema(const logger& logger, const config& conf, string section)
+    : m_log(logger), m_conf(conf), m_section(move(section)) {}
+
+config_schema& config_schema::add(string key, string old, bool required, reader read) {
+  m_parameters.emplace_back(parameter{move(key), move(old), required, move(read)});
+  return *this;
+}
+
+/**
+ * Convert all parameters into their targets
+ *
+ * Invalid optional parameters keep their default and are logged together.
+ *
+ * \throws value_error listing all bad parameters if any required parameter
+ * is missing or invalid
+ */
+void config_schema::load() const {
+  vector<string> errors;
+  bool fatal{false};
+
+  for (const auto& param : m_parameters) {
+    const string* key{&param.key};
+    if (!param.old.empty() && m_conf.has(m_section, param.old)) {
+      m_conf.warn_deprecated(m_section, param.old, param.key);
+      key = &param.old;
+    }
+
+    try {
+      if (!param.read(m_conf, m_section, *key) && param.required) {
+        errors.emplace_back("\"" + *key + "\" is missing");
+        fatal = true;
+      }
+    } catch (const value_error& err) {
+      errors.emplace_back("\"" + *key + "\" is invalid (" + string{err.what()} + ")");
+      fatal = fatal || param.required;
+    }
+  }
+
+  if (errors.empty()) {
+    return;
+  }
+
+  string message{"Bad parameters in section \"" + m_section + "\": " + string_util::join(errors, ", ")};
+  if (fatal) {
+    throw value_error(message);
+  }
+
+  m_log.err("%s, using default values", message);
+}
+
+POLYBAR_NS_END
@@ -1,23 +1,49 @@
 #include "components/controller.hpp"
 
+#include <algorithm>
+#include <condition_variable>
 #include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <utility>
 
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include "components/action_table.hpp"
 #include "components/bar.hpp"
 #include "components/builder.hpp"
 #include "components/config.hpp"
+#include "components/config_parser.hpp"
 #include "components/ipc.hpp"
 #include "components/logger.hpp"
+#include "components/offscreen_renderer.hpp"
+#include "components/power_policy.hpp"
+#include "components/reactor.hpp"
+#include "components/scheduler.hpp"
+#include "components/spawner.hpp"
+#include "components/startup_profile.hpp"
+#include "components/state_export.hpp"
+#include "components/stats.hpp"
+#include "components/thread_policy.hpp"
+#include "components/tracer.hpp"
 #include "components/types.hpp"
+#include "components/workload.hpp"
 #include "events/signal.hpp"
 #include "events/signal_emitter.hpp"
 #include "modules/meta/base.hpp"
 #include "modules/meta/event_handler.hpp"
 #include "modules/meta/factory.hpp"
+#include "modules/meta/timer_module.hpp"
+#include "tags/dispatch.hpp"
 #include "utils/actions.hpp"
 #include "utils/factory.hpp"
+#include "utils/file.hpp"
 #include "utils/inotify.hpp"
-#include "utils/process.hpp"
+#include "utils/line_writer.hpp"
 #include "utils/string.hpp"
 #include "utils/time.hpp"
 #include "x11/connection.hpp"
@@ -25,20 +51,76 @@
 
 POLYBAR_NS
 
-array<int, 2> g_eventpipe{{-1, -1}};
-sig_atomic_t g_reload{0};
-sig_atomic_t g_terminate{0};
+int g_wakeupfd{-1};
+// Only set by the event loop since signals are read from a signalfd
+std::atomic<bool> g_reload{false};
+std::atomic<bool> g_terminate{false};
+
+namespace {
+  /**
+   * Inputs that arrive while this many different inputs are waiting are dropped
+   */
+  constexpr size_t max_pending_input{64};
+
+  /**
+   * Clicks that don't change their module's output within this time are not measured
+   */
+  constexpr chrono::seconds input_latency_timeout{5};
+}  // namespace
 
-void interrupt_handler(int signum) {
+/**
+ * Stop the event loop, the application is restarted if `reload` is set
+ */
+void request_exit(bool reload) {
   if (g_reload || g_terminate) {
     return;
   }
 
-  g_terminate = 1;
-  g_reload = (signum == SIGUSR1);
-  if (write(g_eventpipe[PIPE_WRITE], &g_terminate, 1) == -1) {
-    throw system_error("Failed to write to eventpipe");
+  g_reload = reload;
+  g_terminate = true;
+
+  // Only fails if the counter is full, the event loop is woken up anyway
+  uint64_t one{1};
+  ssize_t written = write(g_wakeupfd, &one, sizeof(one));
+  (void)written;
+}
+
+/**
+ * Signals that are read from the controller's signalfd
+ *
+ * SIGUSR1 first tries to apply the config in place, see
+ * controller::reload_config, the others terminate the bar.
+ */
+sigset_t controller::handled_signals() {
+  sigset_t mask;
+  sigemptyset(&mask);
+  for (int sig : {SIGINT, SIGQUIT, SIGTERM, SIGALRM, SIGUSR1}) {
+    sigaddset(&mask, sig);
   }
+  return mask;
+}
+
+/**
+ * Block the handled signals in the calling thread
+ *
+ * Has to be called before any other thread is started, threads inherit the
+ * mask. Signals that arrive before the controller runs stay pending and are
+ * read from the signalfd later.
+ */
+void controller::block_signals() {
+  auto mask = handled_signals();
+  pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+}
+
+/**
+ * Give the handled signals their default effect in the calling thread again
+ *
+ * For code paths that never create a controller, nothing would read the
+ * blocked signals otherwise.
+ */
+void controller::unblock_signals() {
+  auto mask = handled_signals();
+  pthread_sigmask(SIG_UNBLOCK, &mask, nullptr);
 }
 
 /**
@@ -46,18 +128,19 @@ void interrupt_handler(int signum) {
  */
 controller::make_type controller::make(unique_ptr<ipc>&& ipc, unique_ptr<inotify_watch>&& config_watch) {
   return factory_util::unique<controller>(connection::make(), signal_emitter::make(), logger::make(), config::make(),
-      bar::make(), forward<decltype(ipc)>(ipc), forward<decltype(config_watch)>(config_watch));
+      reactor::make(), bar::make(), forward<decltype(ipc)>(ipc), forward<decltype(config_watch)>(config_watch));
 }
 
 /**
  * Construct controller
  */
 controller::controller(connection& conn, signal_emitter& emitter, const logger& logger, const config& config,
-    unique_ptr<bar>&& bar, unique_ptr<ipc>&& ipc, unique_ptr<inotify_watch>&& confwatch)
+    reactor& reactor, unique_ptr<bar>&& bar, unique_ptr<ipc>&& ipc, unique_ptr<inotify_watch>&& confwatch)
     : m_connection(conn)
     , m_sig(emitter)
     , m_log(logger)
     , m_conf(config)
+    , m_reactor(reactor)
     , m_bar(forward<decltype(bar)>(bar))
     , m_ipc(forward<decltype(ipc)>(ipc))
     , m_confwatch(forward<decltype(confwatch)>(confwatch)) {
@@ -67,55 +150,94 @@ controller::controller(connection& conn, signal_emitter& emitter, const logger&
         "remove it from your config");
   }
 
-  m_swallow_limit = m_conf.deprecated("settings", "eventqueue-swallow", "throttle-output", m_swallow_limit);
-  m_swallow_update = m_conf.deprecated("settings", "eventqueue-swallow-time", "throttle-output-for", m_swallow_update);
+  for (auto&& key : {"throttle-output", "throttle-output-for", "eventqueue-swallow", "eventqueue-swallow-time"}) {
+    if (m_conf.has("settings", key)) {
+      m_log.warn(
+          "The config parameter 'settings.%s' is deprecated and has no effect, use 'settings.max-fps' to limit the "
+          "number of redraws instead",
+          key);
+    }
+  }
+
+  auto max_fps = m_bar->settings().max_fps;
+  m_frame_interval = chrono::duration_cast<chrono::microseconds>(chrono::seconds{1}) / max_fps;
+  m_log.info("controller: Redrawing the bar at most %u times per second", max_fps);
 
-  if (pipe(g_eventpipe.data()) == 0) {
-    m_queuefd[PIPE_READ] = make_unique<file_descriptor>(g_eventpipe[PIPE_READ]);
-    m_queuefd[PIPE_WRITE] = make_unique<file_descriptor>(g_eventpipe[PIPE_WRITE]);
-  } else {
-    throw system_error("Failed to create event channel pipes");
+  if ((g_wakeupfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1) {
+    throw system_error("Failed to create wakeup eventfd");
   }
+  m_wakeupfd = make_unique<file_descriptor>(g_wakeupfd);
 
-  m_log.trace("controller: Install signal handler");
-  struct sigaction act {};
-  memset(&act, 0, sizeof(act));
-  act.sa_handler = &interrupt_handler;
-  sigaction(SIGINT, &act, nullptr);
-  sigaction(SIGQUIT, &act, nullptr);
-  sigaction(SIGTERM, &act, nullptr);
-  sigaction(SIGUSR1, &act, nullptr);
-  sigaction(SIGALRM, &act, nullptr);
+  // Opened before the modules are created, so that their first values are published
+  auto state_file = m_conf.get(m_conf.section(), "state-file", ""s);
+  if (!state_file.empty()) {
+    try {
+      state_export::make().open(file_util::expand(state_file));
+      m_log.info("controller: Publishing module values in %s", state_file);
+    } catch (const system_error& err) {
+      m_log.err("controller: %s", err.what());
+    }
+  }
 
-  m_log.trace("controller: Setup user-defined modules");
-  size_t created_modules{0};
-  created_modules += setup_modules(alignment::LEFT);
-  created_modules += setup_modules(alignment::CENTER);
-  created_modules += setup_modules(alignment::RIGHT);
+  if (m_ipc) {
+    m_ipc->set_query_handler(
+        [this](const string& name, string& output, string& text) { return query_module(name, output, text); });
+    m_ipc->set_stats_handler([] { return stats_report(); });
 
-  if (!created_modules) {
+    const auto& monitor = m_bar->settings().monitor;
+    m_ipc->join_broker(m_conf.section().substr(4), monitor ? monitor->name : ""s, ipc::broker_name());
+  }
+
+  m_log.trace("controller: Create signalfd");
+  auto mask = handled_signals();
+  int fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+  if (fd == -1) {
+    throw system_error("Failed to create signalfd");
+  }
+  m_signalfd = make_unique<file_descriptor>(fd);
+  // A previous instance ignores SIGUSR1 while it reloads, ignored signals never reach the signalfd
+  signal(SIGUSR1, SIG_DFL);
+
+  m_log.trace("controller: Setup user-defined modules");
+  if (!setup_modules()) {
     throw application_error("No modules created");
   }
+  const bar_settings& bar{m_bar->settings()};
+  builder build{bar};
+  build.node(bar.separator);
+  m_separator = build.flush();
+  m_separator_elements = tags::tokenize(m_log, m_separator);
+  m_margin_left = string(bar.module_margin.left, ' ');
+  m_margin_right = string(bar.module_margin.right, ' ');
+  m_padding_left = string(bar.padding.left, ' ');
+  m_padding_right = string(bar.padding.right, ' ');
 }
 
 /**
  * Deconstruct controller
  */
 controller::~controller() {
-  m_log.trace("controller: Uninstall sighandler");
-  signal(SIGINT, SIG_DFL);
-  signal(SIGQUIT, SIG_DFL);
-  signal(SIGTERM, SIG_DFL);
-  signal(SIGALRM, SIG_DFL);
-
   if (g_reload) {
-    // Cause SIGUSR1 to be ignored until registered in the new polybar process
+    // Cause SIGUSR1 to be ignored until the signalfd exists in the new polybar process
     signal(SIGUSR1, SIG_IGN);
   }
 
+  m_log.trace("controller: Unblock signals");
+  // Signals during the shutdown have their default effect again
+  m_signalfd.reset();
+  unblock_signals();
+
+  if (m_bar) {
+    m_log.trace("controller: Stop rendering");
+    m_bar->stop_rendering();
+  }
+
   m_log.trace("controller: Detach signal receiver");
   m_sig.detach(this);
 
+  // The profile is printed even if some modules never produced any output
+  startup_profile::make().finish();
+
   m_log.trace("controller: Stop modules");
   for (auto&& module : m_modules) {
     auto module_name = module->name();
@@ -134,15 +256,25 @@ controller::~controller() {
 /**
  * Run the main loop
  */
-bool controller::run(bool writeback, string snapshot_dst) {
+bool controller::run(output_format output, string snapshot_dst) {
   m_log.info("Starting application");
   m_log.trace("controller: Main thread id = %i", concurrency_util::thread_id(this_thread::get_id()));
 
   assert(!m_connection.connection_has_error());
 
-  m_writeback = writeback;
+  m_output = output;
+  m_writeback = output != output_format::NONE;
   m_snapshot_dst = move(snapshot_dst);
 
+  // Nothing outside of polybar can resolve action ids
+  if (m_writeback || workload_recorder::enabled()) {
+    action_table::make().disable();
+  }
+
+  if (m_writeback) {
+    m_writer = make_unique<line_writer>(m_reactor, STDOUT_FILENO);
+  }
+
   m_sig.attach(this);
 
   size_t started_modules{0};
@@ -155,8 +287,10 @@ bool controller::run(bool writeback, string snapshot_dst) {
 
     try {
       m_log.info("Starting %s", module->name());
+      startup_profile::phase profile{"start " + module->name()};
       module->start();
       started_modules++;
+      publish("module-start", module->name());
     } catch (const application_error& err) {
       m_log.err("Failed to start '%s' (reason: %s)", module->name(), err.what());
     }
@@ -166,8 +300,14 @@ bool controller::run(bool writeback, string snapshot_dst) {
     throw application_error("No modules started");
   }
 
+  m_power = power_policy::make();
+
+  if (workload_recorder::enabled()) {
+    record_layout();
+  }
+
   m_connection.flush();
-  m_event_thread = thread(&controller::process_eventqueue, this);
+  m_event_thread = thread_policy::spawn(thread_policy::role::UI, [this] { process_eventqueue(); });
 
   read_events();
 
@@ -183,99 +323,132 @@ bool controller::run(bool writeback, string snapshot_dst) {
 
 /**
  * Enqueue event
+ *
+ * Input and quit events skip the updates that are already queued
  */
 bool controller::enqueue(event&& evt) {
   if (!m_process_events && evt.type != event_type::QUIT) {
     return false;
   }
-  if (!m_queue.enqueue(forward<decltype(evt)>(evt))) {
+
+  bool urgent = evt.type == event_type::INPUT || evt.type == event_type::QUIT;
+  if (urgent && !m_urgent.enqueue(evt)) {
+    m_log.warn("Failed to enqueue event");
+    return false;
+  }
+
+  if (!m_queue.enqueue(urgent ? event{} : forward<decltype(evt)>(evt))) {
     m_log.warn("Failed to enqueue event");
     return false;
   }
-  // if (write(g_eventpipe[PIPE_WRITE], " ", 1) == -1) {
-  //   m_log.err("Failed to write to eventpipe (reason: %s)", strerror(errno));
-  // }
   return true;
 }
 
 /**
  * Enqueue input data
  */
-bool controller::enqueue(string&& input_data) {
-  if (!m_inputdata.empty()) {
-    m_log.trace("controller: Swallowing input event (pending data)");
-  } else {
-    m_inputdata = forward<string>(input_data);
-    return enqueue(make_input_evt());
+bool controller::enqueue(string&& input_data, chrono::steady_clock::time_point received) {
+  if (workload_recorder::enabled()) {
+    workload_recorder::make().input(input_data);
   }
-  return false;
+
+  std::lock_guard<std::mutex> guard(m_inputdata_lock);
+
+  if (!m_inputdata.empty() && m_inputdata.back().data == input_data) {
+    // Repeated input, e.g. from scrolling, is routed once and handled in one go
+    m_inputdata.back().count++;
+    return true;
+  } else if (m_inputdata.size() >= max_pending_input) {
+    m_log.warn("controller: Dropping input event (%lu inputs pending)", m_inputdata.size());
+    return false;
+  }
+
+  m_inputdata.emplace_back(pending_input{forward<string>(input_data), 1, received});
+
+  // A single queued event processes all pending input
+  if (m_inputdata.size() == 1 && !enqueue(make_input_evt())) {
+    m_inputdata.clear();
+    return false;
+  }
+
+  return true;
 }
 
 /**
  * Read events from configured file descriptors
+ *
+ * The controller's own descriptors are registered with the reactor next to
+ * the ones registered by modules, so all of them are served by this loop.
  */
 void controller::read_events() {
   m_log.info("Entering event loop (thread-id=%lu)", this_thread::get_id());
 
-  int fd_connection{-1};
+  int fd_wakeup{*m_wakeupfd};
+  int fd_signal{*m_signalfd};
+  int fd_connection{m_connection.get_file_descriptor()};
   int fd_confwatch{-1};
-  int fd_ipc{-1};
-
-  vector<int> fds;
-  fds.emplace_back(*m_queuefd[PIPE_READ]);
-  fds.emplace_back((fd_connection = m_connection.get_file_descriptor()));
-
-  if (m_confwatch) {
-    m_log.trace("controller: Attach config watch");
-    m_confwatch->attach(IN_MODIFY | IN_IGNORED);
-    fds.emplace_back((fd_confwatch = m_confwatch->get_file_descriptor()));
-  }
-
-  if (m_ipc) {
-    fds.emplace_back((fd_ipc = m_ipc->get_file_descriptor()));
-  }
 
-  while (!g_terminate) {
-    fd_set readfds{};
-    FD_ZERO(&readfds);
-
-    int maxfd{0};
-    for (auto&& fd : fds) {
-      FD_SET(fd, &readfds);
-      maxfd = std::max(maxfd, fd);
-    }
-
-    // Wait until event is ready on one of the configured streams
-    int events = select(maxfd + 1, &readfds, nullptr, nullptr, nullptr);
-
-    // Check for errors
-    if (events == -1) {
-      /*
-       * The Interrupt errno is generated when polybar is stopped, so it
-       * shouldn't generate an error message
-       */
-      if (errno != EINTR) {
-        m_log.err("select failed in event loop: %s", strerror(errno));
+  // Only wakes up the loop, which then checks g_terminate
+  m_reactor.add(fd_wakeup, EPOLLIN, [&](int fd, unsigned int) {
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+      m_log.err("Failed to read from wakeup eventfd (err: %s)", strerror(errno));
+    }
+  });
+
+  m_reactor.add(fd_signal, EPOLLIN, [&](int fd, unsigned int) {
+    signalfd_siginfo info;
+    while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+      if (info.ssi_signo != SIGUSR1) {
+        m_log.info("Received %s", strsignal(info.ssi_signo));
+        request_exit(false);
+      } else if (!g_terminate) {
+        m_log.info("Received SIGUSR1, reloading config");
+        if (!reload_config()) {
+          request_exit(true);
+        }
       }
-
-      break;
     }
+  });
 
-    if (g_terminate || m_connection.connection_has_error()) {
-      break;
+  // Process event on the xcb connection fd
+  m_reactor.add(fd_connection, EPOLLIN, [&](int, unsigned int) {
+    POLYBAR_TRACE("controller.x-events");
+    connection::event_ptr evt{};
+    while ((evt = m_connection.poll_event())) {
+      try {
+        m_connection.dispatch_event(move(evt));
+      } catch (xpp::connection_error& err) {
+        m_log.err("X connection error, terminating... (what: %s)", m_connection.error_str(err.code()));
+      } catch (const exception& err) {
+        m_log.err("Error in X event loop: %s", err.what());
+      }
     }
 
-    // Process event on the internal fd
-    if (m_queuefd[PIPE_READ] && FD_ISSET(static_cast<int>(*m_queuefd[PIPE_READ]), &readfds)) {
-      char buffer[BUFSIZ];
-      if (read(static_cast<int>(*m_queuefd[PIPE_READ]), &buffer, BUFSIZ) == -1) {
-        m_log.err("Failed to read from eventpipe (err: %s)", strerror(errno));
+    // Modules that deferred their work until the whole burst was handled
+    for (const auto& handler : m_event_handlers) {
+      if (!handler.first->running()) {
+        continue;
+      }
+
+      try {
+        handler.second->events_handled();
+      } catch (const exception& err) {
+        m_log.err("%s: Error while handling X events: %s", handler.first->name(), err.what());
       }
     }
 
-    // Process event on the config inotify watch fd
+    try {
+      m_bar->events_handled();
+    } catch (const exception& err) {
+      m_log.err("Error while handling X events: %s", err.what());
+    }
+  });
+
+  // Process event on the config inotify watch fd
+  function<void(int, unsigned int)> on_confwatch = [&](int, unsigned int) {
     unique_ptr<inotify_event> confevent;
-    if (fd_confwatch > -1 && FD_ISSET(fd_confwatch, &readfds) && (confevent = m_confwatch->await_match())) {
+    if ((confevent = m_confwatch->await_match())) {
       if (confevent->mask & IN_IGNORED) {
         // IN_IGNORED: file was deleted or filesystem was unmounted
         //
@@ -285,38 +458,55 @@ void controller::read_events() {
         // file to a different location (and subsequently deleting it).
         //
         // We need to re-attach the watch to the new file in this case.
-        fds.erase(
-            std::remove_if(fds.begin(), fds.end(), [fd_confwatch](int fd) { return fd == fd_confwatch; }), fds.end());
+        m_reactor.remove(fd_confwatch);
         m_confwatch = inotify_util::make_watch(m_confwatch->path());
         m_confwatch->attach(IN_MODIFY | IN_IGNORED);
-        fds.emplace_back((fd_confwatch = m_confwatch->get_file_descriptor()));
+        m_reactor.add((fd_confwatch = m_confwatch->get_file_descriptor()), EPOLLIN, on_confwatch);
       }
       m_log.info("Configuration file changed");
-      g_terminate = 1;
-      g_reload = 1;
-    }
-
-    // Process event on the xcb connection fd
-    if (fd_connection > -1 && FD_ISSET(fd_connection, &readfds)) {
-      shared_ptr<xcb_generic_event_t> evt{};
-      while ((evt = shared_ptr<xcb_generic_event_t>(xcb_poll_for_event(m_connection), free)) != nullptr) {
-        try {
-          m_connection.dispatch_event(evt);
-        } catch (xpp::connection_error& err) {
-          m_log.err("X connection error, terminating... (what: %s)", m_connection.error_str(err.code()));
-        } catch (const exception& err) {
-          m_log.err("Error in X event loop: %s", err.what());
-        }
+      if (!reload_config()) {
+        request_exit(true);
+      }
+    }
+  };
+
+  if (m_confwatch) {
+    m_log.trace("controller: Attach config watch");
+    m_confwatch->attach(IN_MODIFY | IN_IGNORED);
+    m_reactor.add((fd_confwatch = m_confwatch->get_file_descriptor()), EPOLLIN, on_confwatch);
+  }
+
+  while (!g_terminate) {
+    int ready;
+    {
+      // All requests made by the callbacks of one iteration are flushed together
+      connection::frame frame{m_connection};
+
+      // Wait until event is ready on one of the registered streams
+      ready = m_reactor.poll();
+    }
+
+    if (ready == -1) {
+      // Signals are read from the signalfd, other signals (e.g. SIGWINCH) may still interrupt the wait
+      if (errno == EINTR) {
+        continue;
       }
+
+      m_log.err("epoll_wait failed in event loop: %s", strerror(errno));
+      break;
     }
 
-    // Process event on the ipc fd
-    if (fd_ipc > -1 && FD_ISSET(fd_ipc, &readfds)) {
-      m_ipc->receive_message();
-      fds.erase(std::remove_if(fds.begin(), fds.end(), [fd_ipc](int fd) { return fd == fd_ipc; }), fds.end());
-      fds.emplace_back((fd_ipc = m_ipc->get_file_descriptor()));
+    if (g_terminate || m_connection.connection_has_error()) {
+      break;
     }
   }
+
+  m_reactor.remove(fd_wakeup);
+  m_reactor.remove(fd_signal);
+  m_reactor.remove(fd_connection);
+  if (fd_confwatch > -1) {
+    m_reactor.remove(fd_confwatch);
+  }
 }
 
 /**
@@ -333,56 +523,110 @@ void controller::process_eventqueue() {
 
   while (!g_terminate) {
     event evt{};
-    m_queue.wait_dequeue(evt);
+    dequeue(evt, chrono::steady_clock::time_point::max());
 
     if (g_terminate) {
       break;
-    } else if (evt.type == event_type::QUIT) {
-      if (evt.flag) {
-        on(signals::eventqueue::exit_reload{});
-      } else {
-        on(signals::eventqueue::exit_terminate{});
-      }
-    } else if (evt.type == event_type::INPUT) {
-      process_inputdata();
-    } else if (evt.type == event_type::UPDATE && evt.flag) {
-      process_update(true);
+    }
+
+    process_event(evt);
+  }
+}
+
+/**
+ * Take the next event, input and quit events come first
+ *
+ * Empty events only wake up the event thread for an urgent event, they are
+ * skipped if that event was already taken.
+ *
+ * \returns false if no event arrived before the deadline
+ */
+bool controller::dequeue(event& evt, chrono::steady_clock::time_point deadline) {
+  while (!m_urgent.try_dequeue(evt)) {
+    if (deadline == chrono::steady_clock::time_point::max()) {
+      m_queue.wait_dequeue(evt);
     } else {
-      event next{};
-      size_t swallowed{0};
-      while (swallowed++ < m_swallow_limit && m_queue.wait_dequeue_timed(next, m_swallow_update)) {
-        if (next.type == event_type::QUIT) {
-          evt = next;
-          break;
-        } else if (next.type == event_type::INPUT) {
-          evt = next;
-          break;
-        } else if (evt.type != next.type) {
-          enqueue(move(next));
-          break;
-        } else {
-          m_log.trace_x("controller: Swallowing event within timeframe");
-          evt = next;
-        }
+      auto now = chrono::steady_clock::now();
+      if (now >= deadline ||
+          !m_queue.wait_dequeue_timed(evt, chrono::duration_cast<chrono::microseconds>(deadline - now))) {
+        return false;
       }
+    }
 
-      if (evt.type == event_type::UPDATE) {
-        process_update(evt.flag);
-      } else if (evt.type == event_type::INPUT) {
-        process_inputdata();
-      } else if (evt.type == event_type::QUIT) {
-        if (evt.flag) {
-          on(signals::eventqueue::exit_reload{});
-        } else {
-          on(signals::eventqueue::exit_terminate{});
-        }
-      } else if (evt.type == event_type::CHECK) {
-        on(signals::eventqueue::check_state{});
-      } else {
-        m_log.warn("Unknown event type for enqueued event (%d)", evt.type);
+    if (evt.type != event_type::NONE) {
+      return true;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Handle a single event taken from the eventqueue
+ *
+ * Regular update events are deferred until the current frame is over, so
+ * that changes arriving in quick succession are drawn together
+ */
+bool controller::process_event(const event& evt) {
+  if (evt.type == event_type::QUIT) {
+    if (evt.flag) {
+      on(signals::eventqueue::exit_reload{});
+    } else {
+      on(signals::eventqueue::exit_terminate{});
+    }
+  } else if (evt.type == event_type::INPUT) {
+    connection::frame frame{m_connection};
+    process_inputdata();
+  } else if (evt.type == event_type::UPDATE) {
+    bool force = evt.flag || wait_for_frame();
+
+    if (g_terminate) {
+      return true;
+    }
+
+    // Modules that change from now on queue another update
+    m_update_pending = false;
+
+    // The frame only starts after the wait, events handled while waiting are flushed right away
+    connection::frame frame{m_connection};
+    m_log.trace_x("controller: Redrawing bar (force=%i)", force);
+    process_update(force);
+  } else if (evt.type == event_type::CHECK) {
+    on(signals::eventqueue::check_state{});
+  } else {
+    m_log.warn("Unknown event type for enqueued event (%d)", evt.type);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Block until the frame budget since the last redraw is used up
+ *
+ * Events other than updates are still handled while waiting.
+ *
+ * \returns true if a forced update was requested in the meantime
+ */
+bool controller::wait_for_frame() {
+  auto deadline = m_last_frame + m_frame_interval;
+
+  while (!g_terminate) {
+    event next{};
+
+    if (!dequeue(next, deadline)) {
+      break;
+    } else if (next.type == event_type::UPDATE) {
+      if (next.flag) {
+        return true;
       }
+      // Any other update is part of the frame we are waiting for
+    } else {
+      process_event(next);
     }
   }
+
+  return false;
 }
 
 /**
@@ -408,7 +652,9 @@ bool controller::try_forward_legacy_action(const string& cmd) {
 #define A_MAP(old, module_name, event) {old, {string(module_name::TYPE), string(module_name::event)}}
 
   static const std::unordered_map<string, std::pair<string, const string>> legacy_actions{
+#if ENABLE_MODULE_DATE
     A_MAP("datetoggle", date_module, EVENT_TOGGLE),
+#endif
 #if ENABLE_ALSA
     A_MAP("volup", alsa_module, EVENT_INC),
     A_MAP("voldown", alsa_module, EVENT_DEC),
@@ -419,10 +665,14 @@ bool controller::try_forward_legacy_action(const string& cmd) {
     A_MAP("pa_voldown", pulseaudio_module, EVENT_DEC),
     A_MAP("pa_volmute", pulseaudio_module, EVENT_TOGGLE),
 #endif
+#if ENABLE_MODULE_XBACKLIGHT
     A_MAP("xbacklight+", xbacklight_module, EVENT_INC),
     A_MAP("xbacklight-", xbacklight_module, EVENT_DEC),
+#endif
+#if ENABLE_MODULE_BACKLIGHT
     A_MAP("backlight+", backlight_module, EVENT_INC),
     A_MAP("backlight-", backlight_module, EVENT_DEC),
+#endif
 #if ENABLE_XKEYBOARD
     A_MAP("xkeyboard/switch", xkeyboard_module, EVENT_SWITCH),
 #endif
@@ -439,23 +689,29 @@ bool controller::try_forward_legacy_action(const string& cmd) {
     // Has data
     A_MAP("mpdseek", mpd_module, EVENT_SEEK),
 #endif
+#if ENABLE_MODULE_XWORKSPACES
     // Has data
     A_MAP("xworkspaces-focus=", xworkspaces_module, EVENT_FOCUS),
     A_MAP("xworkspaces-next", xworkspaces_module, EVENT_NEXT),
     A_MAP("xworkspaces-prev", xworkspaces_module, EVENT_PREV),
+#endif
+#if ENABLE_MODULE_BSPWM
     // Has data
     A_MAP("bspwm-deskfocus", bspwm_module, EVENT_FOCUS),
     A_MAP("bspwm-desknext", bspwm_module, EVENT_NEXT),
     A_MAP("bspwm-deskprev", bspwm_module, EVENT_PREV),
+#endif
 #if ENABLE_I3
     // Has data
     A_MAP("i3wm-wsfocus-", i3_module, EVENT_FOCUS),
     A_MAP("i3wm-wsnext", i3_module, EVENT_NEXT),
     A_MAP("i3wm-wsprev", i3_module, EVENT_PREV),
 #endif
+#if ENABLE_MODULE_MENU
     // Has data
     A_MAP("menu-open-", menu_module, EVENT_OPEN),
     A_MAP("menu-close", menu_module, EVENT_CLOSE),
+#endif
   };
 #undef A_MAP
   // clang-format on
@@ -468,8 +724,14 @@ bool controller::try_forward_legacy_action(const string& cmd) {
       auto data = cmd.substr(key.length());
       string action = entry.second.second;
 
+      vector<module_t> modules;
+      {
+        std::lock_guard<std::mutex> guard(m_modules_lock);
+        modules = m_modules;
+      }
+
       // Search for the first module that matches the type for this legacy action
-      for (auto&& module : m_modules) {
+      for (auto&& module : modules) {
         if (module->type() == type) {
           auto module_name = module->name_raw();
           // TODO make this message more descriptive and maybe link to some documentation
@@ -501,24 +763,65 @@ bool controller::try_forward_legacy_action(const string& cmd) {
   return false;
 }
 
-bool controller::forward_action(const actions_util::action& action_triple) {
+/**
+ * Group the loaded modules by name and find those that handle X events
+ *
+ * Has to be called with m_modules_lock held whenever m_modules changes
+ */
+void controller::index_modules() {
+  m_modules_by_name.clear();
+  m_event_handlers.clear();
+  for (const auto& module : m_modules) {
+    m_modules_by_name[module->name_raw()].push_back(module);
+
+    auto evt_handler = dynamic_cast<event_handler_interface*>(&*module);
+    if (evt_handler != nullptr) {
+      m_event_handlers.emplace_back(module, evt_handler);
+    }
+  }
+}
+
+/**
+ * Forward an action `count` times to all modules that match its name
+ */
+bool controller::forward_action(
+    const actions_util::action& action_triple, size_t count, chrono::steady_clock::time_point received) {
   string module_name = std::get<0>(action_triple);
   string action = std::get<1>(action_triple);
   string data = std::get<2>(action_triple);
+  POLYBAR_TRACE("controller.action");
 
-  m_log.info("Forwarding action to modules (module: '%s', action: '%s', data: '%s')", module_name, action, data);
+  m_log.info("Forwarding action to modules (module: '%s', action: '%s', data: '%s', count: %lu)", module_name, action,
+      data, count);
 
   int num_delivered = 0;
 
-  // Forwards the action to all modules that match the name
-  for (auto&& module : m_modules) {
-    if (module->name_raw() == module_name) {
+  // Copied so that the list can be reloaded while a module handles the action
+  vector<module_t> modules;
+  {
+    std::lock_guard<std::mutex> guard(m_modules_lock);
+    auto it = m_modules_by_name.find(module_name);
+    if (it != m_modules_by_name.end()) {
+      modules = it->second;
+    }
+  }
+
+  for (auto&& module : modules) {
+    if (received != chrono::steady_clock::time_point{}) {
+      std::lock_guard<std::mutex> guard(m_input_latency_lock);
+      if (m_input_latency.size() < max_pending_input) {
+        m_input_latency.emplace_back(input_latency{module, module->generation(), received});
+      }
+    }
+
+    for (size_t i = 0; i < count; i++) {
       if (!module->input(action, data)) {
         m_log.err("The '%s' module does not support the '%s' action.", module_name, action);
+        break;
       }
-
-      num_delivered++;
     }
+
+    num_delivered++;
   }
 
   if (num_delivered == 0) {
@@ -531,209 +834,826 @@ bool controller::forward_action(const actions_util::action& action_triple) {
 }
 
 /**
- * Process stored input data
+ * Send an event to the ipc clients that subscribed to it
  */
-void controller::process_inputdata() {
-  if (m_inputdata.empty()) {
-    return;
+void controller::publish(const string& event, const string& data) {
+  if (m_ipc) {
+    m_ipc->publish(event, data);
   }
+}
+
+/**
+ * Current output of the module with the given name, for ipc queries
+ *
+ * `text` is the output without any formatting tags
+ */
+bool controller::query_module(const string& name, string& output, string& text) const {
+  std::lock_guard<std::mutex> guard(m_modules_lock);
+  for (const auto& module : m_modules) {
+    if (module->name_raw() != name && module->name() != name) {
+      continue;
+    }
 
-  const string cmd = std::move(m_inputdata);
-  m_inputdata = string{};
+    output = module->contents();
+    text.clear();
+    for (const auto& element : *module->elements()) {
+      if (!element.is_tag) {
+        text += element.data;
+      }
+    }
+    return true;
+  }
 
-  m_log.trace("controller: Processing inputdata: %s", cmd);
+  return false;
+}
 
-  // Every command that starts with '#' is considered an action string.
-  if (cmd.front() == '#') {
-    try {
-      this->forward_action(actions_util::parse_action_string(cmd));
-    } catch (runtime_error& e) {
-      m_log.err("Invalid action string (action: %s, reason: %s)", cmd, e.what());
+/**
+ * Timing statistics, cache hit rates and allocation counts, for `stats` and `get-stats`
+ */
+vector<string> controller::stats_report() {
+  vector<string> lines;
+  lines.emplace_back("Redraw timings (" + to_string(histogram::WINDOW) + " samples per stage) and cache hit rates:");
+  for (const auto& line : stats::make().report()) {
+    lines.emplace_back("  " + line);
+  }
+
+  if (alloc_stats::enabled()) {
+    lines.emplace_back("Heap allocations per subsystem since the last reset:");
+    for (const auto& line : alloc_stats::report()) {
+      lines.emplace_back("  " + line);
     }
+  }
+  return lines;
+}
+
+/**
+ * Pause, resume or retime the modules with the given name
+ *
+ * The command is the module name, with or without the "module/" prefix,
+ * followed by a space and `pause`, `resume` or `interval=<seconds>`. An
+ * interval of 0 goes back to the configured one. Only modules that update on
+ * an interval support this.
+ */
+void controller::module_command(const string& command) {
+  auto pos = command.find(' ');
+  string name{command.substr(0, pos)};
+  string op{pos == string::npos ? "" : command.substr(pos + 1)};
 
+  if (name.compare(0, 7, "module/") == 0) {
+    name.erase(0, 7);
+  }
+
+  auto modules = m_modules_by_name.find(name);
+  if (modules == m_modules_by_name.end()) {
+    m_log.warn("No module \"%s\" for ipc command \"%s\"", name, op);
     return;
   }
 
-  if (this->try_forward_legacy_action(cmd)) {
+  if (op.compare(0, 9, "snapshot=") == 0 && op.size() > 9) {
+    snapshot_module(*modules->second.front(), file_util::expand(op.substr(9)));
     return;
   }
 
-  try {
-    // Run input as command if it's not an input for a module
-    m_log.info("Forwarding command to shell... (input: %s)", cmd);
-    m_log.info("Executing shell command: %s", cmd);
-    process_util::fork_detached([cmd] { process_util::exec_sh(cmd.c_str()); });
-    process_update(true);
-  } catch (const application_error& err) {
-    m_log.err("controller: Error while forwarding input to shell -> %s", err.what());
+  double interval{0.0};
+  if (op.compare(0, 9, "interval=") == 0) {
+    char* end{nullptr};
+    interval = std::strtod(op.c_str() + 9, &end);
+    if (end == op.c_str() + 9 || *end != '\0' || interval < 0.0) {
+      m_log.warn("\"%s\" is not a valid interval", op.substr(9));
+      return;
+    }
+  } else if (op != "pause" && op != "resume") {
+    m_log.warn("\"%s\" is not a valid module command, use pause, resume, interval=<seconds> or snapshot=<path>", op);
+    return;
+  }
+
+  for (const auto& module : modules->second) {
+    auto timer = dynamic_cast<timer_module_interface*>(&*module);
+    if (timer == nullptr) {
+      m_log.warn("%s: Doesn't update on an interval, ignoring \"%s\"", module->name(), op);
+    } else if (op == "pause" || op == "resume") {
+      timer->pause(op == "pause");
+    } else {
+      timer->override_interval(interval_t{interval});
+    }
   }
 }
 
 /**
- * Process eventqueue update event
+ * Write the current output of the module to a png, as wide as the module
+ *
+ * The output is drawn offscreen on the bar background, so neither the other
+ * modules nor the position of the module on the bar change the image. The
+ * file must not exist yet, it is created only readable by the user.
  */
-bool controller::process_update(bool force) {
-  const bar_settings& bar{m_bar->settings()};
-  string contents;
-  string padding_left(bar.padding.left, ' ');
-  string padding_right(bar.padding.right, ' ');
-  string margin_left(bar.module_margin.left, ' ');
-  string margin_right(bar.module_margin.right, ' ');
+void controller::snapshot_module(modules::module_interface& module, const string& path) const {
+  shared_ptr<const tags::format_string> elements;
+  try {
+    elements = module.elements();
+  } catch (const exception& err) {
+    m_log.err("Failed to get contents for \"%s\" (err: %s)", module.name(), err.what());
+  }
 
-  builder build{bar};
-  build.node(bar.separator);
-  string separator{build.flush()};
+  if (!module.running() || !elements || elements->empty()) {
+    m_log.warn("%s: Nothing to take a snapshot of", module.name());
+    return;
+  }
 
-  for (const auto& block : m_blocks) {
-    string block_contents;
-    bool is_left = false;
-    bool is_center = false;
-    bool is_right = false;
-    bool is_first = true;
+  const auto& bar = m_bar->settings();
+  auto dispatch = tags::dispatch::make();
+  const auto render = [&](int width) {
+    auto renderer = offscreen_renderer::make(m_log, m_conf, bar, width, static_cast<int>(bar.size.h));
+    renderer->begin();
+    renderer->change_alignment(alignment::LEFT);
+    dispatch->parse(bar, *renderer, *elements);
+    renderer->end();
+    return renderer;
+  };
 
-    if (block.first == alignment::LEFT) {
-      is_left = true;
-    } else if (block.first == alignment::CENTER) {
-      is_center = true;
-    } else if (block.first == alignment::RIGHT) {
-      is_right = true;
+  try {
+    // Measured at the width of the bar, then drawn again at the width of the module
+    int width{render(static_cast<int>(bar.size.w))->content_width()};
+    auto renderer = render(std::max(1, width));
+
+    // Never follow a link or replace a file someone else put there
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd == -1) {
+      throw system_error("Failed to create " + path);
     }
-
+    file_descriptor out(fd);
+    renderer->write_png(fd);
+    m_log.info("%s: Wrote snapshot to %s", module.name(), path);
+  } catch (const exception& err) {
+    m_log.err("%s: Failed to write snapshot (err: %s)", module.name(), err.what());
+  }
+}
+
+/**
+ * Process stored input data
+ */
+void controller::process_inputdata() {
+  std::deque<pending_input> pending;
+  {
+    std::lock_guard<std::mutex> guard(m_inputdata_lock);
+    pending.swap(m_inputdata);
+  }
+
+  for (const auto& input : pending) {
+    process_input(input.data, input.count, input.received);
+  }
+}
+
+/**
+ * Process a single input that was repeated `count` times
+ */
+void controller::process_input(const string& cmd, size_t count, chrono::steady_clock::time_point received) {
+  m_log.trace("controller: Processing inputdata: %s (count: %lu)", cmd, count);
+
+  // Every command that starts with '#' is considered an action string.
+  if (cmd.front() == '#') {
+    actions_util::action interned;
+    if (action_table::make().resolve(cmd, interned)) {
+      this->forward_action(interned, count, received);
+      return;
+    }
+
+    try {
+      this->forward_action(actions_util::parse_action_string(cmd), count, received);
+    } catch (runtime_error& e) {
+      m_log.err("Invalid action string (action: %s, reason: %s)", cmd, e.what());
+    }
+
+    return;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (this->try_forward_legacy_action(cmd)) {
+      continue;
+    }
+
+    // Commands for subscribed ipc clients, there is no need to start a shell
+    if (cmd.compare(0, 4, "ipc:") == 0) {
+      publish("command", cmd.substr(4));
+      continue;
+    }
+
+    publish("command", cmd);
+
+    try {
+      // Run input as command if it's not an input for a module
+      m_log.info("Forwarding command to shell... (input: %s)", cmd);
+      m_log.info("Executing shell command: %s", cmd);
+      spawner::make().spawn(cmd);
+    } catch (const application_error& err) {
+      m_log.err("controller: Error while forwarding input to shell -> %s", err.what());
+    }
+  }
+}
+
+/**
+ * Process eventqueue update event
+ *
+ * Only blocks containing a module that changed since the last update are
+ * assembled and parsed again, all other blocks are taken from the cache.
+ */
+bool controller::process_update(bool force) {
+  auto start = chrono::steady_clock::now();
+  scoped_alloc_tag tag{m_alloc_tag};
+
+  auto& registry = stats::make();
+  scoped_timer timer{registry.get("controller.update")};
+  POLYBAR_TRACE("controller.update");
+
+  bool changed{force};
+  size_t element_count{0};
+  string json;
+
+  std::unique_lock<std::mutex> modules_guard(m_modules_lock);
+  for (const auto& block : m_blocks) {
+    auto& cache = m_block_cache[block.first];
+
+    if (force || block_changed(block.second, cache)) {
+      if (workload_recorder::enabled()) {
+        record_updates(block.second, cache);
+      }
+
+      cache.generations.clear();
+      for (const auto& module : block.second) {
+        // Sampled before fetching the contents so that a concurrent change is not missed
+        cache.generations.emplace_back(module->generation());
+      }
+
+      scoped_timer timer{registry.get("controller.assemble")};
+
+      // Swapped instead of moved so that both buffers keep their capacity
+      if (m_output == output_format::JSON) {
+        if (append_json(block.first, block.second, force, json) > 0) {
+          changed = true;
+        }
+      } else if (m_writeback) {
+        assemble_block(block.first, block.second, cache.scratch);
+        if (force || cache.scratch != cache.contents) {
+          cache.contents.swap(cache.scratch);
+          changed = true;
+        }
+      } else {
+        assemble_block(block.first, block.second, cache.element_scratch);
+        if (force || cache.element_scratch != cache.elements) {
+          cache.elements.swap(cache.element_scratch);
+          changed = true;
+        }
+      }
+    }
+
+    element_count += cache.elements.size();
+  }
+  modules_guard.unlock();
+
+  if (!changed) {
+    // Everything was already drawn, e.g. by a forced update in the meantime
+    m_log.trace("controller: Ignoring update (unchanged)");
+    return true;
+  }
+
+  m_last_frame = start;
+
+  try {
+    if (!m_writeback) {
+      tags::format_string elements;
+      elements.reserve(element_count);
+      for (const auto& block : m_block_cache) {
+        elements.insert(elements.end(), block.second.elements.begin(), block.second.elements.end());
+      }
+      m_bar->parse(move(elements), force);
+    } else if (m_output == output_format::JSON) {
+      string line{"{\"modules\":["};
+      line += json;
+      line += "]}";
+      if (!m_writer->write(line)) {
+        // Changes were dropped before they reached the reader, send all modules again
+        m_json_contents.clear();
+        enqueue(make_update_evt(true));
+      }
+    } else {
+      string contents;
+      for (const auto& block : m_block_cache) {
+        contents += block.second.contents;
+      }
+      m_writer->write(contents);
+    }
+  } catch (const exception& err) {
+    m_log.err("Failed to update bar contents (reason: %s)", err.what());
+  }
+
+  auto duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - m_last_frame);
+  publish("redraw", to_string(duration.count()));
+
+  auto& profile = startup_profile::make();
+  if (profile.enabled()) {
+    profile.mark("frame");
+
+    // Finished once every running module is shown
+    std::lock_guard<std::mutex> guard(m_modules_lock);
+    if (std::all_of(m_modules.begin(), m_modules.end(),
+            [](const module_t& m) { return !m->running() || m->generation() > 0; })) {
+      profile.finish();
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Measure the clicks whose module changed since the click was delivered
+ *
+ * Called by the render thread once a frame is flushed, the changed module
+ * is part of that frame.
+ */
+void controller::record_input_latency() {
+  std::lock_guard<std::mutex> guard(m_input_latency_lock);
+  if (m_input_latency.empty()) {
+    return;
+  }
+
+  auto now = chrono::steady_clock::now();
+  auto done = std::remove_if(m_input_latency.begin(), m_input_latency.end(), [&](const input_latency& input) {
+    if (input.module->generation() > input.generation) {
+      m_input_latency_stats.record(now - input.received);
+      return true;
+    }
+    return now - input.received > input_latency_timeout;
+  });
+  m_input_latency.erase(done, m_input_latency.end());
+}
+
+/**
+ * Check if any module in the block changed since the block was cached
+ */
+bool controller::block_changed(const vector<module_t>& modules, const block_cache& cache) const {
+  if (cache.generations.size() != modules.size()) {
+    return true;
+  }
+
+  for (size_t i = 0; i < modules.size(); i++) {
+    if (modules[i]->generation() != cache.generations[i]) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Record the modules of every block in the order they are shown
+ */
+void controller::record_layout() const {
+  static const std::map<alignment, string> names{
+      {alignment::LEFT, "left"}, {alignment::CENTER, "center"}, {alignment::RIGHT, "right"}};
+  for (const auto& block : m_blocks) {
+    vector<string> modules;
     for (const auto& module : block.second) {
-      if (!module->running()) {
-        continue;
+      modules.emplace_back(module->name_raw());
+    }
+    workload_recorder::make().layout(names.at(block.first), modules);
+  }
+}
+
+/**
+ * Record the contents of the modules in the block that changed since the block was cached
+ */
+void controller::record_updates(const vector<module_t>& modules, const block_cache& cache) const {
+  for (size_t i = 0; i < modules.size(); i++) {
+    const auto& module = modules[i];
+    if (i < cache.generations.size() && module->generation() == cache.generations[i]) {
+      continue;
+    }
+
+    string contents;
+    try {
+      if (module->running()) {
+        contents = module->contents();
       }
+    } catch (const exception& err) {
+      m_log.err("Failed to get contents for \"%s\" (err: %s)", module->name(), err.what());
+    }
+    workload_recorder::make().update(module->name_raw(), contents);
+  }
+}
+
+/**
+ * Append the modules of the given block whose contents changed since they were
+ * last written to `json`, as comma separated JSON objects
+ *
+ * Stopped modules are written once with empty contents, so that the reader
+ * clears them.
+ *
+ * \returns The number of appended modules
+ */
+size_t controller::append_json(alignment align, const vector<module_t>& modules, bool force, string& json) {
+  const char* align_name = align == alignment::LEFT ? "left" : align == alignment::CENTER ? "center" : "right";
+  size_t appended{0};
 
-      string module_contents;
+  for (const auto& module : modules) {
+    string contents;
+    shared_ptr<const tags::format_string> elements;
 
+    if (module->running()) {
       try {
-        module_contents = module->contents();
+        contents = module->contents();
+        elements = module->elements();
       } catch (const exception& err) {
         m_log.err("Failed to get contents for \"%s\" (err: %s)", module->name(), err.what());
       }
+    }
 
-      if (module_contents.empty()) {
-        continue;
-      }
+    auto it = m_json_contents.find(module.get());
+    if (!force && it != m_json_contents.end() && it->second == contents) {
+      continue;
+    }
 
-      if (!block_contents.empty() && !margin_right.empty()) {
-        block_contents += margin_right;
+    string text;
+    if (elements) {
+      for (const auto& element : *elements) {
+        if (!element.is_tag) {
+          text += element.data;
+        }
       }
+    }
 
-      if (!block_contents.empty() && !separator.empty()) {
-        block_contents += separator;
-      }
+    if (!json.empty()) {
+      json += ',';
+    }
+    json += "{\"name\":";
+    string_util::append_json(json, module->name());
+    json += ",\"alignment\":\"";
+    json += align_name;
+    json += "\",\"contents\":";
+    string_util::append_json(json, contents);
+    json += ",\"text\":";
+    string_util::append_json(json, text);
+    json += '}';
+
+    m_json_contents[module.get()] = move(contents);
+    appended++;
+  }
 
-      if (!block_contents.empty() && !margin_left.empty() && !(is_left && is_first)) {
-        block_contents += margin_left;
-      }
+  return appended;
+}
 
-      block_contents.reserve(module_contents.size());
-      block_contents += module_contents;
+/**
+ * Join the contents of all modules in the given block into `contents`
+ *
+ * Only used in writeback mode, the bar gets the parsed block from the other overload
+ */
+void controller::assemble_block(alignment align, const vector<module_t>& modules, string& contents) const {
+  string block_contents;
+  contents.clear();
+  bool is_first = true;
+
+  for (const auto& module : modules) {
+    if (!module->running()) {
+      continue;
+    }
+
+    string module_contents;
 
-      is_first = false;
+    try {
+      module_contents = module->contents();
+    } catch (const exception& err) {
+      m_log.err("Failed to get contents for \"%s\" (err: %s)", module->name(), err.what());
     }
 
-    if (block_contents.empty()) {
+    if (module_contents.empty()) {
       continue;
-    } else if (is_left) {
-      contents += "%{l}";
-      contents += padding_left;
-    } else if (is_center) {
-      contents += "%{c}";
-    } else if (is_right) {
-      contents += "%{r}";
-      block_contents += padding_right;
     }
 
-    // Strip unnecessary reset tags
-    block_contents = string_util::replace_all(block_contents, "T-}%{T", "T");
-    block_contents = string_util::replace_all(block_contents, "B-}%{B#", "B#");
-    block_contents = string_util::replace_all(block_contents, "F-}%{F#", "F#");
-    block_contents = string_util::replace_all(block_contents, "U-}%{U#", "U#");
-    block_contents = string_util::replace_all(block_contents, "u-}%{u#", "u#");
-    block_contents = string_util::replace_all(block_contents, "o-}%{o#", "o#");
+    if (!block_contents.empty() && !m_margin_right.empty()) {
+      block_contents += m_margin_right;
+    }
+
+    if (!block_contents.empty() && !m_separator.empty()) {
+      block_contents += m_separator;
+    }
+
+    if (!block_contents.empty() && !m_margin_left.empty() && !(align == alignment::LEFT && is_first)) {
+      block_contents += m_margin_left;
+    }
+
+    block_contents += module_contents;
 
-    // Join consecutive tags
-    contents += string_util::replace_all(block_contents, "}%{", " ");
+    is_first = false;
   }
 
-  try {
-    if (!m_writeback) {
-      m_bar->parse(move(contents), force);
+  if (block_contents.empty()) {
+    return;
+  }
+
+  if (align == alignment::LEFT) {
+    contents += "%{l}";
+    contents += m_padding_left;
+  } else if (align == alignment::CENTER) {
+    contents += "%{c}";
+  } else if (align == alignment::RIGHT) {
+    contents += "%{r}";
+    block_contents += m_padding_right;
+  }
+
+  contents += tags::compact(block_contents);
+}
+
+/**
+ * Alignment tag that starts a block
+ */
+static tags::element alignment_tag(alignment align) {
+  tags::element el{};
+  el.is_tag = true;
+  el.tag_data.type = tags::tag_type::FORMAT;
+  el.tag_data.subtype.format =
+      align == alignment::LEFT ? tags::syntaxtag::l : align == alignment::CENTER ? tags::syntaxtag::c : tags::syntaxtag::r;
+  return el;
+}
+
+/**
+ * Join the parsed output of all modules in the given block into `elements`
+ *
+ * Same as parsing the formatting string assembled by the other overload, but
+ * without parsing anything. The output of each module was already parsed when
+ * the module published it.
+ */
+void controller::assemble_block(
+    alignment align, const vector<module_t>& modules, tags::format_string& elements) const {
+  elements.clear();
+  bool is_first = true;
+
+  for (const auto& module : modules) {
+    if (!module->running()) {
+      continue;
+    }
+
+    shared_ptr<const tags::format_string> module_elements;
+
+    try {
+      module_elements = module->elements();
+    } catch (const exception& err) {
+      m_log.err("Failed to get contents for \"%s\" (err: %s)", module->name(), err.what());
+    }
+
+    if (!module_elements || module_elements->empty()) {
+      continue;
+    }
+
+    if (elements.empty()) {
+      elements.emplace_back(alignment_tag(align));
+      if (align == alignment::LEFT && !m_padding_left.empty()) {
+        elements.emplace_back(string{m_padding_left});
+      }
     } else {
-      std::cout << contents << std::endl;
+      if (!m_margin_right.empty()) {
+        tags::append(elements, tags::element{string{m_margin_right}});
+      }
+
+      tags::append(elements, m_separator_elements);
+
+      if (!m_margin_left.empty() && !(align == alignment::LEFT && is_first)) {
+        tags::append(elements, tags::element{string{m_margin_left}});
+      }
     }
-  } catch (const exception& err) {
-    m_log.err("Failed to update bar contents (reason: %s)", err.what());
+
+    tags::append(elements, *module_elements);
+
+    is_first = false;
   }
 
-  return true;
+  if (!elements.empty() && align == alignment::RIGHT && !m_padding_right.empty()) {
+    tags::append(elements, tags::element{string{m_padding_right}});
+  }
 }
 
 /**
- * Creates module instances for all the modules in the given alignment block
+ * Creates module instances for the modules of all alignment blocks
+ *
+ * Some modules connect to other processes or probe the system while they are
+ * constructed, so they are created concurrently on the scheduler's workers.
+ * Modules that talk to the X server are created on this thread, see
+ * needs_main_thread(). The modules are added in the configured order, no
+ * matter in which order they are done.
  */
-size_t controller::setup_modules(alignment align) {
+size_t controller::setup_modules() {
+  struct pending {
+    alignment align;
+    string name;
+    bool main_thread;
+    module_t module;
+    string error;
+    std::exception_ptr failure;
+  };
+
+  vector<pending> modules;
+
+  const std::pair<alignment, string> blocks[]{
+      {alignment::LEFT, "modules-left"}, {alignment::CENTER, "modules-center"}, {alignment::RIGHT, "modules-right"}};
+
+  for (const auto& block : blocks) {
+    for (auto& module_name : string_util::split(m_conf.get(m_conf.section(), block.second, ""s), ' ')) {
+      if (!module_name.empty()) {
+        bool main_thread = needs_main_thread(m_conf.get("module/" + module_name, "type", ""s));
+        modules.emplace_back(pending{block.first, move(module_name), main_thread, nullptr, "", nullptr});
+      }
+    }
+  }
+
+  const auto create = [this](pending& p) {
+    try {
+      startup_profile::phase profile{"create module/" + p.name};
+      p.module = create_module(p.name);
+    } catch (const runtime_error& err) {
+      p.error = err.what();
+    } catch (...) {
+      p.failure = std::current_exception();
+    }
+  };
+
+  std::mutex lock;
+  std::condition_variable created;
+  size_t remaining{0};
+
+  for (auto& p : modules) {
+    if (!p.main_thread) {
+      remaining++;
+      scheduler::make().submit([&] {
+        create(p);
+
+        std::lock_guard<std::mutex> guard(lock);
+        remaining--;
+        created.notify_all();
+      });
+    }
+  }
+
+  for (auto& p : modules) {
+    if (p.main_thread) {
+      create(p);
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    created.wait(guard, [&] { return remaining == 0; });
+  }
+
   size_t count{0};
 
-  string key;
+  for (auto& p : modules) {
+    if (p.failure) {
+      std::rethrow_exception(p.failure);
+    } else if (!p.error.empty()) {
+      m_log.err("Disabling module \"%s\" (reason: %s)", p.name, p.error);
+    } else {
+      m_modules.push_back(p.module);
+      m_blocks[p.align].push_back(move(p.module));
+      count++;
+    }
+  }
+
+  index_modules();
 
-  switch (align) {
-    case alignment::LEFT:
-      key = "modules-left";
-      break;
+  return count;
+}
 
-    case alignment::CENTER:
-      key = "modules-center";
-      break;
+/**
+ * Create the module defined in the section `module/<name>`
+ *
+ * \throws runtime_error If the module can't be created
+ */
+module_t controller::create_module(const string& name) const {
+  auto type = m_conf.get("module/" + name, "type");
 
-    case alignment::RIGHT:
-      key = "modules-right";
-      break;
+  if (type == ipc_module::TYPE && !m_ipc) {
+    throw application_error("Inter-process messaging needs to be enabled");
+  }
 
-    case alignment::NONE:
-      m_log.err("controller: Tried to setup modules for alignment NONE");
-      break;
+  auto ptr = make_module(move(type), m_bar->settings(), name, m_log);
+  module_t module = shared_ptr<modules::module_interface>(ptr);
+  ptr = nullptr;
+
+  return module;
+}
+
+/**
+ * Apply the modified config file without restarting
+ *
+ * Only the modules whose section changed, or references a changed section,
+ * are recreated. The bar window, fonts and colors are set up from the bar
+ * section and the global settings, so any change there needs a restart.
+ *
+ * Called on the main thread.
+ *
+ * \returns false if polybar has to be restarted instead
+ */
+bool controller::reload_config() {
+  config parsed{m_log, string{m_conf.filepath()}, string{m_conf.barname()}};
+
+  try {
+    config_parser parser{m_log, string{m_conf.filepath()}, string{m_conf.barname()}};
+    parser.use_cache();
+    parser.parse(parsed);
+  } catch (const exception& err) {
+    m_log.err("Failed to reload config, keeping the current one (reason: %s)", err.what());
+    return true;
   }
 
-  string configured_modules;
-  if (!key.empty()) {
-    configured_modules = m_conf.get(m_conf.section(), key, ""s);
+  auto changed = m_conf.changed_sections(parsed);
+
+  for (const auto& section : {m_conf.section(), "settings"s, "global/wm"s}) {
+    if (changed.find(section) != changed.end()) {
+      m_log.info("Section \"%s\" changed, restarting", section);
+      return false;
+    }
   }
 
-  for (auto& module_name : string_util::split(configured_modules, ' ')) {
-    if (module_name.empty()) {
+  // Modules only read their parameters while they are created, so the ones that keep running are not affected
+  const_cast<config&>(m_conf).assign(parsed);
+
+  // Pairs of the running module and the module replacing it, which is empty if it couldn't be created
+  vector<pair<module_t, module_t>> replaced;
+
+  for (const auto& module : m_modules) {
+    string name{module->name_raw()};
+    if (changed.find("module/" + name) == changed.end()) {
       continue;
     }
 
     try {
-      auto type = m_conf.get("module/" + module_name, "type");
+      replaced.emplace_back(module, create_module(name));
+    } catch (const runtime_error& err) {
+      m_log.err("Disabling module \"%s\" (reason: %s)", name, err.what());
+      replaced.emplace_back(module, nullptr);
+    }
+  }
 
-      if (type == ipc_module::TYPE && !m_ipc) {
-        throw application_error("Inter-process messaging needs to be enabled");
+  if (replaced.empty()) {
+    m_log.info("No modules affected by the config change");
+    return true;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_modules_lock);
+    for (const auto& r : replaced) {
+      if (r.second) {
+        std::replace(m_modules.begin(), m_modules.end(), r.first, r.second);
+        for (auto&& block : m_blocks) {
+          std::replace(block.second.begin(), block.second.end(), r.first, r.second);
+        }
       }
+    }
+    index_modules();
 
-      auto ptr = make_module(move(type), m_bar->settings(), module_name, m_log);
-      module_t module = shared_ptr<modules::module_interface>(ptr);
-      ptr = nullptr;
+    // Keep the recorded layout in sync with the blocks
+    if (workload_recorder::enabled()) {
+      record_layout();
+    }
+  }
 
-      m_modules.push_back(module);
-      m_blocks[align].push_back(module);
-      count++;
-    } catch (const runtime_error& err) {
-      m_log.err("Disabling module \"%s\" (reason: %s)", module_name, err.what());
+  // The replacements are already listed, so stopping the old modules doesn't count as all modules being stopped
+  for (const auto& r : replaced) {
+    auto old_handler = dynamic_cast<event_handler_interface*>(&*r.first);
+    if (old_handler != nullptr) {
+      old_handler->disconnect(m_connection);
+    }
+    r.first->stop();
+
+    if (!r.second) {
+      continue;
+    }
+
+    auto evt_handler = dynamic_cast<event_handler_interface*>(&*r.second);
+    if (evt_handler != nullptr) {
+      evt_handler->connect(m_connection);
+    }
+
+    try {
+      m_log.info("Starting %s", r.second->name());
+      r.second->start();
+    } catch (const application_error& err) {
+      m_log.err("Failed to start '%s' (reason: %s)", r.second->name(), err.what());
     }
   }
 
-  return count;
+  m_log.notice("Reloaded %lu module%s", replaced.size(), replaced.size() > 1 ? "s" : "");
+  enqueue(make_update_evt(true));
+  return true;
 }
 
 /**
  * Process broadcast events
  */
 bool controller::on(const signals::eventqueue::notify_change&) {
-  return enqueue(make_update_evt(false));
+  // A single queued update covers all modules that change before it is processed
+  if (!m_update_pending.exchange(true) && !enqueue(make_update_evt(false))) {
+    m_update_pending = false;
+  }
+
+  return true;
 }
 
 /**
@@ -747,15 +1667,18 @@ bool controller::on(const signals::eventqueue::notify_forcechange&) {
  * Process eventqueue terminate event
  */
 bool controller::on(const signals::eventqueue::exit_terminate&) {
-  raise(SIGALRM);
+  request_exit(false);
   return true;
 }
 
 /**
  * Process eventqueue reload event
+ *
+ * Always restarts the application, unlike SIGUSR1, since it is used when
+ * the bar settings can't be applied in place (e.g. monitor changes)
  */
 bool controller::on(const signals::eventqueue::exit_reload&) {
-  raise(SIGUSR1);
+  request_exit(true);
   return true;
 }
 
@@ -763,9 +1686,12 @@ bool controller::on(const signals::eventqueue::exit_reload&) {
  * Process eventqueue check event
  */
 bool controller::on(const signals::eventqueue::check_state&) {
-  for (const auto& module : m_modules) {
-    if (module->running()) {
-      return true;
+  {
+    std::lock_guard<std::mutex> guard(m_modules_lock);
+    for (const auto& module : m_modules) {
+      if (module->running()) {
+        return true;
+      }
     }
   }
   m_log.warn("No running modules...");
@@ -773,6 +1699,14 @@ bool controller::on(const signals::eventqueue::check_state&) {
   return true;
 }
 
+/**
+ * Process module stopped event
+ */
+bool controller::on(const signals::eventqueue::module_stopped& evt) {
+  publish("module-stop", evt.cast());
+  return true;
+}
+
 /**
  * Process ui ready event
  */
@@ -792,21 +1726,41 @@ bool controller::on(const signals::ui::ready&) {
   return false;
 }
 
+/**
+ * Process ui changed event, emitted after a frame was flushed
+ */
+bool controller::on(const signals::ui::changed&) {
+  record_input_latency();
+
+  // let the event bubble
+  return false;
+}
+
 /**
  * Process ui button press event
  */
 bool controller::on(const signals::ui::button_press& evt) {
-  string input{evt.cast()};
+  auto input = evt.cast();
 
-  if (input.empty()) {
+  if (input.first.empty()) {
     m_log.err("Cannot enqueue empty input");
     return false;
   }
 
-  enqueue(move(input));
+  enqueue(move(input.first), input.second);
   return true;
 }
 
+/**
+ * Process ui visibility change event
+ */
+bool controller::on(const signals::ui::visibility_change& evt) {
+  publish("visibility", evt.cast() ? "1" : "0");
+
+  // let the event bubble
+  return false;
+}
+
 /**
  * Process ipc action messages
  */
@@ -843,6 +1797,31 @@ bool controller::on(const signals::ipc::command& evt) {
     m_bar->show();
   } else if (command == "toggle") {
     m_bar->toggle();
+  } else if (command == "stats") {
+    for (const auto& line : stats_report()) {
+      m_log.notice("%s", line);
+    }
+  } else if (command == "stats-reset") {
+    stats::make().reset();
+    alloc_stats::reset();
+  } else if (command == "trace-start") {
+    tracer::make().start();
+    m_log.notice("Started tracing");
+  } else if (command == "trace-stop") {
+    tracer::make().stop();
+    m_log.notice("Stopped tracing");
+  } else if (command == "low-power" || command == "low-power-off") {
+    if (m_power) {
+      m_power->set_low_power(command == "low-power");
+    }
+  } else if (command.compare(0, 7, "module:") == 0) {
+    module_command(command.substr(7));
+  } else if (command == "trace-dump") {
+    try {
+      m_log.notice("Wrote trace to %s", tracer::make().write());
+    } catch (const exception& err) {
+      m_log.err("Failed to write trace (err: %s)", err.what());
+    }
   } else {
     m_log.warn("\"%s\" is not a valid ipc command", command);
   }
@@ -869,6 +1848,37 @@ bool controller::on(const signals::ipc::hook& evt) {
   return true;
 }
 
+/**
+ * Process ipc content messages
+ *
+ * The module name is followed by a space and the new content, the
+ * "module/" prefix of the name is optional.
+ */
+bool controller::on(const signals::ipc::content& evt) {
+  string message{evt.cast()};
+  auto pos = message.find(' ');
+  string name{message.substr(0, pos)};
+  string content{pos == string::npos ? "" : message.substr(pos + 1)};
+
+  if (name.compare(0, 7, "module/") != 0) {
+    name.insert(0, "module/");
+  }
+
+  for (const auto& module : m_modules) {
+    if (!module->running() || module->name() != name) {
+      continue;
+    }
+    auto ipc = std::dynamic_pointer_cast<ipc_module>(module);
+    if (ipc != nullptr) {
+      ipc->on_content(move(content));
+      return true;
+    }
+  }
+
+  m_log.warn("No running custom/ipc module \"%s\" for ipc content", name);
+  return true;
+}
+
 bool controller::on(const signals::ui::update_background&) {
   enqueue(make_update_evt(true));
 
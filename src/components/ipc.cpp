@@ -1,8 +1,17 @@
 #include <fcntl.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
 
 #include "components/ipc.hpp"
 #include "components/logger.hpp"
+#include "components/reactor.hpp"
 #include "events/signal.hpp"
 #include "events/signal_emitter.hpp"
 #include "utils/factory.hpp"
@@ -11,17 +20,86 @@
 
 POLYBAR_NS
 
+namespace {
+  /**
+   * Quote a string for JSON
+   */
+  string quote(const string& value) {
+    string result{"\""};
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        result += '\\';
+        result += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        result += escaped;
+      } else {
+        result += c;
+      }
+    }
+    return result + "\"";
+  }
+
+  /**
+   * Address of the broker socket in the abstract namespace
+   *
+   * The kernel releases the name when the broker exits, so it never goes
+   * stale and binding it decides the election.
+   */
+  socklen_t broker_address(const string& name, struct sockaddr_un& addr) {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    size_t size{std::min(name.size(), sizeof(addr.sun_path) - 1)};
+    memcpy(addr.sun_path + 1, name.data(), size);
+    return offsetof(struct sockaddr_un, sun_path) + 1 + size;
+  }
+
+  /**
+   * Abstract sockets have no permissions, only peers of the same user are trusted
+   */
+  bool same_user(int fd) {
+    struct ucred cred {};
+    socklen_t size{sizeof(cred)};
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 && cred.uid == getuid();
+  }
+
+  /**
+   * Commands that make the bar write to a path the sender chose
+   */
+  bool writes_file(const string& payload) {
+    return payload.compare(0, 11, "cmd:module:") == 0 && payload.find(" snapshot=") != string::npos;
+  }
+
+  bool selected(const string& selector, const string& bar, const string& monitor) {
+    if (selector == "all") {
+      return true;
+    } else if (selector.compare(0, 4, "bar:") == 0) {
+      return selector.compare(4, string::npos, bar) == 0;
+    } else if (selector.compare(0, 8, "monitor:") == 0) {
+      return selector.compare(8, string::npos, monitor) == 0;
+    }
+    return false;
+  }
+
+  // A bar that just won the election may not listen yet, the election is
+  // retried after a while
+  constexpr int ELECTION_ATTEMPTS{5};
+  constexpr auto ELECTION_RETRY = std::chrono::milliseconds(10);
+}  // namespace
+
 /**
  * Create instance
  */
 ipc::make_type ipc::make() {
-  return factory_util::unique<ipc>(signal_emitter::make(), logger::make());
+  return factory_util::unique<ipc>(signal_emitter::make(), logger::make(), reactor::make());
 }
 
 /**
  * Construct ipc handler
  */
-ipc::ipc(signal_emitter& emitter, const logger& logger) : m_sig(emitter), m_log(logger) {
+ipc::ipc(signal_emitter& emitter, const logger& logger, reactor& reactor)
+    : m_sig(emitter), m_log(logger), m_reactor(reactor) {
   m_path = string_util::replace(PATH_MESSAGING_FIFO, "%pid%", to_string(getpid()));
 
   if (file_util::exists(m_path) && unlink(m_path.c_str()) == -1) {
@@ -32,13 +110,67 @@ ipc::ipc(signal_emitter& emitter, const logger& logger) : m_sig(emitter), m_log(
   }
 
   m_log.info("Created ipc channel at: %s", m_path);
-  m_fd = file_util::make_file_descriptor(m_path, O_RDONLY | O_NONBLOCK);
+
+  open_fifo();
+
+  m_socket_path = string_util::replace(PATH_MESSAGING_SOCKET, "%pid%", to_string(getpid()));
+
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (m_socket_path.size() >= sizeof(addr.sun_path)) {
+    throw application_error("Path of ipc socket is too long: " + m_socket_path);
+  }
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", m_socket_path.c_str());
+
+  if (file_util::exists(m_socket_path) && unlink(m_socket_path.c_str()) == -1) {
+    throw system_error("Failed to remove ipc socket");
+  }
+
+  int fd{socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+  if (fd == -1) {
+    throw system_error("Failed to create ipc socket");
+  }
+  m_socket = file_util::make_file_descriptor(fd);
+  if (bind(*m_socket, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1 ||
+      listen(*m_socket, SOMAXCONN) == -1) {
+    throw system_error("Failed to listen on ipc socket");
+  }
+
+  m_log.info("Created ipc socket at: %s", m_socket_path);
+  m_reactor.add(*m_socket, EPOLLIN, [this](int fd, unsigned int) { accept_client(fd); });
 }
 
 /**
  * Deconstruct ipc handler
  */
 ipc::~ipc() {
+  leave_broker();
+
+  if (m_election_timer) {
+    m_reactor.remove(*m_election_timer);
+  }
+
+  while (!m_clients.empty()) {
+    close_client(*m_clients.begin());
+  }
+
+  if (m_broker) {
+    m_reactor.remove(*m_broker);
+  }
+  m_broker.reset();
+
+  if (m_socket) {
+    m_reactor.remove(*m_socket);
+  }
+  m_socket.reset();
+
+  if (!m_socket_path.empty()) {
+    unlink(m_socket_path.c_str());
+  }
+
+  if (m_fd) {
+    m_reactor.remove(*m_fd);
+  }
   m_fd.reset();
 
   if (!m_path.empty()) {
@@ -48,38 +180,458 @@ ipc::~ipc() {
 }
 
 /**
- * Receive available ipc messages and delegate valid events
+ * Delegate all messages in the given data, one message per line
+ *
+ * `client` is the socket the data was received on, -1 for the fifo
  */
-void ipc::receive_message() {
-  m_log.info("Receiving ipc message");
-
-  char buffer[BUFSIZ]{'\0'};
-  ssize_t bytes_read{0};
+void ipc::process(const string& data, int client) {
+  size_t start{0};
+  while (start < data.size()) {
+    auto end = data.find('\n', start);
+    if (end == string::npos) {
+      end = data.size();
+    }
 
-  if ((bytes_read = read(*m_fd, &buffer, BUFSIZ)) == -1) {
-    m_log.err("Failed to read from ipc channel (err: %s)", strerror(errno));
-  } else if (bytes_read > 0) {
-    string payload{string_util::trim(string{buffer}, '\n')};
+    string payload{string_util::trim(data.substr(start, end - start), '\r')};
+    start = end + 1;
 
-    if (payload.find(ipc_command_prefix) == 0) {
+    if (payload.find(ipc_command_prefix) == 0 && writes_file(payload) && !trusted(client)) {
+      m_log.warn("ipc: Ignoring \"%s\", files are only written for socket clients of the same user", payload);
+    } else if (payload.find(ipc_command_prefix) == 0) {
       m_sig.emit(signals::ipc::command{payload.substr(strlen(ipc_command_prefix))});
     } else if (payload.find(ipc_hook_prefix) == 0) {
       m_sig.emit(signals::ipc::hook{payload.substr(strlen(ipc_hook_prefix))});
     } else if (payload.find(ipc_action_prefix) == 0) {
       m_sig.emit(signals::ipc::action{payload.substr(strlen(ipc_action_prefix))});
+    } else if (payload.find(ipc_content_prefix) == 0) {
+      m_sig.emit(signals::ipc::content{payload.substr(strlen(ipc_content_prefix))});
+    } else if (payload.find(ipc_subscribe_prefix) == 0) {
+      subscribe(client, payload.substr(strlen(ipc_subscribe_prefix)));
+    } else if (payload == ipc_stats_query) {
+      query_stats(client);
+    } else if (payload.find(ipc_get_prefix) == 0) {
+      query(client, payload.substr(strlen(ipc_get_prefix)));
+    } else if (payload.find(ipc_target_prefix) == 0) {
+      route(payload.substr(strlen(ipc_target_prefix)), client);
+    } else if (payload.find(ipc_register_prefix) == 0) {
+      enroll(client, payload.substr(strlen(ipc_register_prefix)));
     } else if (!payload.empty()) {
       m_log.warn("Received unknown ipc message: (payload=%s)", payload);
     }
   }
+}
+
+/**
+ * Pass a `to:<selector> <message>` message on to the bars it selects
+ *
+ * Only the broker knows the other bars, any other bar just handles the
+ * message if it selects the bar itself.
+ */
+void ipc::route(const string& data, int client) {
+  auto pos = data.find(' ');
+  string selector{data.substr(0, pos)};
+  string message{pos == string::npos ? "" : string_util::trim(data.substr(pos + 1))};
+
+  if (selector != "all" && selector.compare(0, 4, "bar:") != 0 && selector.compare(0, 8, "monitor:") != 0) {
+    m_log.warn("ipc: Unknown target \"%s\"", selector);
+    return;
+  } else if (message.empty() || message.find(ipc_subscribe_prefix) == 0 || message.find(ipc_get_prefix) == 0 || message == ipc_stats_query ||
+             message.find(ipc_target_prefix) == 0 || message.find(ipc_register_prefix) == 0) {
+    m_log.warn("ipc: Cannot pass on message \"%s\"", message);
+    return;
+  }
+
+  if (m_broker) {
+    string packet{message + '\n'};
+    for (const auto& follower : m_followers) {
+      if (!selected(selector, follower.second.first, follower.second.second)) {
+        continue;
+      }
+      if (send(follower.first, packet.c_str(), packet.size(), MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+        m_log.warn("ipc: Failed to pass message on to bar \"%s\" (err: %s)", follower.second.first, strerror(errno));
+      }
+    }
+  }
+
+  if (selected(selector, m_bar, m_monitor)) {
+    process(message, client);
+  }
+}
+
+/**
+ * Whether the message came from a socket client of the same user
+ *
+ * Anyone can write to the fifo. Messages passed on by the broker keep the
+ * client they came from.
+ */
+bool ipc::trusted(int client) const {
+  return client != -1 && same_user(client);
+}
+
+/**
+ * Register a bar with the broker, `data` holds its name and monitor
+ */
+void ipc::enroll(int client, const string& data) {
+  if (!m_broker || client == -1) {
+    m_log.warn("ipc: Only the broker accepts bars");
+    return;
+  }
+
+  auto pos = data.find(' ');
+  string bar{data.substr(0, pos)};
+  string monitor{pos == string::npos ? "" : data.substr(pos + 1)};
+  m_log.info("ipc: Bar \"%s\" on monitor \"%s\" joined the broker", bar, monitor);
+  m_followers[client] = make_pair(move(bar), move(monitor));
+}
+
+/**
+ * Name of the broker socket of the current user
+ */
+string ipc::broker_name() {
+  return "polybar_broker." + to_string(getuid());
+}
 
-  m_fd = file_util::make_file_descriptor(m_path, O_RDONLY | O_NONBLOCK);
+/**
+ * Become the broker of the bars of the user or register with the current one
+ */
+void ipc::join_broker(const string& bar, const string& monitor, const string& name) {
+  m_bar = bar;
+  m_monitor = monitor;
+  m_broker_name = name;
+  elect();
 }
 
 /**
- * Get the file descriptor to the ipc channel
+ * The first bar to bind the broker socket becomes the broker, everyone else
+ * connects to it
+ *
+ * The bars are only missing for messages that go through the broker if this
+ * fails, they can still be reached on their own channels.
  */
-int ipc::get_file_descriptor() const {
-  return *m_fd;
+void ipc::elect(int attempt) {
+  struct sockaddr_un addr;
+  auto size = broker_address(m_broker_name, addr);
+  auto address = reinterpret_cast<struct sockaddr*>(&addr);
+
+  int fd{socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+  if (fd == -1) {
+    m_log.err("ipc: Failed to join broker (err: %s)", strerror(errno));
+    return;
+  }
+
+  if (bind(fd, address, size) == 0) {
+    if (listen(fd, SOMAXCONN) == -1) {
+      m_log.err("ipc: Failed to join broker (err: %s)", strerror(errno));
+      close(fd);
+      return;
+    }
+    m_broker = file_util::make_file_descriptor(fd);
+    m_reactor.add(fd, EPOLLIN, [this](int socket, unsigned int) { accept_client(socket); });
+    m_log.info("ipc: Elected as broker");
+    return;
+  }
+
+  if (errno == EADDRINUSE && connect(fd, address, size) == 0) {
+    if (!same_user(fd)) {
+      close(fd);
+      m_log.err("ipc: Broker socket belongs to another user");
+      return;
+    }
+
+    string registration{ipc_register_prefix + m_bar + ' ' + m_monitor + '\n'};
+    if (send(fd, registration.c_str(), registration.size(), MSG_NOSIGNAL) != -1) {
+      m_upstream = fd;
+      m_reactor.add(fd, EPOLLIN, [this](int upstream, unsigned int) { receive_client(upstream); });
+      m_log.info("ipc: Joined broker");
+      return;
+    }
+  }
+
+  int err{errno};
+  close(fd);
+
+  if (attempt + 1 < ELECTION_ATTEMPTS && schedule_election(attempt + 1)) {
+    m_log.trace("ipc: Broker not ready, retrying (err: %s)", strerror(err));
+    return;
+  }
+
+  m_log.err("ipc: Failed to join broker (err: %s)", strerror(err));
+}
+
+/**
+ * Run the given attempt of the election once ELECTION_RETRY passed
+ *
+ * The retry is driven by the reactor, so the event loop isn't blocked while
+ * the bar that won the election starts listening.
+ *
+ * \returns false if the timer could not be armed
+ */
+bool ipc::schedule_election(int attempt) {
+  if (!m_election_timer) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+      return false;
+    }
+
+    m_election_timer = file_util::make_file_descriptor(fd);
+    m_reactor.add(fd, EPOLLIN, [this](int timer, unsigned int) {
+      uint64_t expirations;
+      if (read(timer, &expirations, sizeof(expirations)) != -1) {
+        elect(m_election_attempt);
+      }
+    });
+  }
+
+  m_election_attempt = attempt;
+  itimerspec spec{};
+  spec.it_value.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(ELECTION_RETRY).count();
+  return timerfd_settime(*m_election_timer, 0, &spec, nullptr) == 0;
+}
+
+/**
+ * Drop the connection to the broker without electing a new one
+ */
+void ipc::leave_broker() {
+  if (m_upstream != -1) {
+    m_reactor.remove(m_upstream);
+    close(m_upstream);
+    m_upstream = -1;
+  }
+}
+
+/**
+ * Read everything that was written to the fifo
+ */
+void ipc::receive_fifo() {
+  scoped_alloc_tag tag{m_alloc_tag};
+  m_log.info("Receiving ipc message");
+
+  string data{move(m_fifo_pending)};
+  m_fifo_pending.clear();
+  char buffer[BUFSIZ];
+  ssize_t bytes_read{0};
+
+  while ((bytes_read = read(*m_fd, buffer, sizeof(buffer))) > 0) {
+    data.append(buffer, bytes_read);
+  }
+
+  if (bytes_read == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+    m_log.err("Failed to read from ipc channel (err: %s)", strerror(errno));
+  }
+
+  if (bytes_read == 0) {
+    // Every writer is done, so is a message without a trailing newline
+    process(data);
+    open_fifo();
+    return;
+  }
+
+  // The rest of an incomplete line is still being written
+  auto end = data.rfind('\n');
+  if (end == string::npos) {
+    m_fifo_pending = move(data);
+    return;
+  }
+
+  m_fifo_pending = data.substr(end + 1);
+  data.erase(end + 1);
+  process(data);
+}
+
+/**
+ * Open the fifo for reading, again once every writer closed it
+ *
+ * The fifo keeps reporting EOF after the last writer is gone until it is
+ * reopened. Messages are therefore split at EOF, not only at newlines.
+ */
+void ipc::open_fifo() {
+  if (m_fd) {
+    m_reactor.remove(*m_fd);
+  }
+
+  m_fd = file_util::make_file_descriptor(m_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  m_reactor.add(*m_fd, EPOLLIN, [this](int, unsigned int) { receive_fifo(); });
+}
+
+/**
+ * Accept all pending connections on the given socket
+ */
+void ipc::accept_client(int socket) {
+  int fd;
+  while ((fd = accept4(socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+    if (m_broker && socket == *m_broker && !same_user(fd)) {
+      m_log.warn("ipc: Rejected broker client of another user");
+      close(fd);
+      continue;
+    }
+    m_log.trace("ipc: Accepted client (fd=%i)", fd);
+    m_clients.emplace(fd);
+    m_reactor.add(fd, EPOLLIN, [this](int client, unsigned int) { receive_client(client); });
+  }
+
+  if (errno != EAGAIN && errno != EWOULDBLOCK) {
+    m_log.err("Failed to accept ipc client (err: %s)", strerror(errno));
+  }
+}
+
+/**
+ * Read all pending packets of a client, the connection is closed once the
+ * client is done
+ */
+void ipc::receive_client(int fd) {
+  scoped_alloc_tag tag{m_alloc_tag};
+
+  while (true) {
+    // Returns the size of the next packet, whatever the size of the buffer
+    ssize_t size = recv(fd, nullptr, 0, MSG_PEEK | MSG_TRUNC);
+
+    if (size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    } else if (size <= 0) {
+      if (size == -1) {
+        m_log.err("Failed to read from ipc client (err: %s)", strerror(errno));
+      }
+      close_client(fd);
+      return;
+    }
+
+    string data(size, '\0');
+    if (recv(fd, &data[0], data.size(), 0) != size) {
+      m_log.err("Failed to read from ipc client (err: %s)", strerror(errno));
+      close_client(fd);
+      return;
+    }
+
+    process(data, fd);
+  }
+}
+
+void ipc::close_client(int fd) {
+  if (fd == m_upstream) {
+    m_log.info("ipc: Lost connection to broker");
+    leave_broker();
+    elect();
+    return;
+  }
+
+  m_log.trace("ipc: Closing client (fd=%i)", fd);
+  m_reactor.remove(fd);
+  m_clients.erase(fd);
+  m_followers.erase(fd);
+  {
+    std::lock_guard<std::mutex> guard(m_subscribers_lock);
+    m_subscribers.erase(fd);
+  }
+  close(fd);
+}
+
+void ipc::set_query_handler(query_handler handler) {
+  m_query_handler = move(handler);
+}
+
+void ipc::set_stats_handler(stats_handler handler) {
+  m_stats_handler = move(handler);
+}
+
+/**
+ * Answer a `get:` query with the output of the module
+ */
+void ipc::query(int client, const string& query) const {
+  if (client == -1) {
+    m_log.warn("Queries are only possible over the ipc socket");
+    return;
+  }
+
+  auto pos = query.find(' ');
+  string module{query.substr(0, pos)};
+  string format{pos == string::npos ? "raw" : string_util::trim(query.substr(pos + 1))};
+  string output;
+  string text;
+  string reply;
+
+  if (format != "raw" && format != "text" && format != "json") {
+    reply = "error Unknown format \"" + format + "\"";
+  } else if (!m_query_handler || !m_query_handler(module, output, text)) {
+    reply = "error No module named \"" + module + "\"";
+  } else if (format == "json") {
+    reply = "ok {\"module\":" + quote(module) + ",\"output\":" + quote(output) + ",\"text\":" + quote(text) + "}";
+  } else {
+    reply = "ok " + string_util::replace_all(format == "raw" ? output : text, "\n", " ");
+  }
+
+  send_reply(client, move(reply));
+}
+
+/**
+ * Answer a `get-stats` query with one line per statistic
+ */
+void ipc::query_stats(int client) const {
+  if (client == -1) {
+    m_log.warn("Queries are only possible over the ipc socket");
+    return;
+  }
+
+  if (!m_stats_handler) {
+    send_reply(client, "error No statistics");
+    return;
+  }
+
+  send_reply(client, "ok " + string_util::join(m_stats_handler(), "\n"));
+}
+
+/**
+ * Send the answer to a query as a single packet
+ */
+void ipc::send_reply(int client, string reply) const {
+  reply += '\n';
+  if (send(client, reply.c_str(), reply.size(), MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+    m_log.err("Failed to answer ipc query (err: %s)", strerror(errno));
+  }
+}
+
+/**
+ * Send the given events to the client from now on, replaces its previous subscription
+ */
+void ipc::subscribe(int client, const string& events) {
+  if (client == -1) {
+    m_log.warn("Subscriptions are only possible over the ipc socket");
+    return;
+  }
+
+  std::set<string> subscribed;
+  for (auto&& event : string_util::split(events, ',')) {
+    auto name = string_util::trim(move(event));
+    if (!name.empty()) {
+      subscribed.emplace(move(name));
+    }
+  }
+
+  m_log.info("ipc: Client subscribed to %s", events.empty() ? "all events" : events);
+  std::lock_guard<std::mutex> guard(m_subscribers_lock);
+  m_subscribers[client] = move(subscribed);
+}
+
+/**
+ * Send an event to all clients that subscribed to it
+ *
+ * Clients that don't read their events fast enough miss the ones that don't
+ * fit into the socket buffer, publishing never blocks.
+ */
+void ipc::publish(const string& event, const string& data) {
+  std::lock_guard<std::mutex> guard(m_subscribers_lock);
+  if (m_subscribers.empty()) {
+    return;
+  }
+
+  string message{event + ' ' + string_util::replace_all(data, "\n", " ") + '\n'};
+  for (const auto& subscriber : m_subscribers) {
+    if (!subscriber.second.empty() && subscriber.second.find(event) == subscriber.second.end()) {
+      continue;
+    }
+    if (send(subscriber.first, message.c_str(), message.size(), MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+      m_log.trace("ipc: Dropped event for client (fd=%i, err: %s)", subscriber.first, strerror(errno));
+    }
+  }
 }
 
 POLYBAR_NS_END
@@ -1,7 +1,13 @@
 #include "components/logger.hpp"
 
+#include <moodycamel/blockingconcurrentqueue.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <mutex>
+
 #include "errors.hpp"
 #include "settings.hpp"
 #include "utils/concurrency.hpp"
@@ -10,6 +16,27 @@
 
 POLYBAR_NS
 
+namespace {
+  /**
+   * Maximum number of lines written at once
+   */
+  constexpr size_t BATCH_SIZE{64};
+}  // namespace
+
+struct logger::sink {
+  // An empty line tells the writer to stop
+  moodycamel::BlockingConcurrentQueue<string> queue;
+  std::once_flag started;
+  std::thread writer;
+  // Forked children have no writer thread and write directly
+  pid_t pid{getpid()};
+
+  std::atomic<size_t> pushed{0};
+  std::mutex lock;
+  std::condition_variable done;
+  size_t written{0};
+};
+
 /**
  * Convert string
  */
@@ -38,7 +65,7 @@ logger::make_type logger::make(loglevel level) {
 /**
  * Construct logger
  */
-logger::logger(loglevel level) : m_level(level) {
+logger::logger(loglevel level, int fd) : m_level(level), m_fd(fd), m_sink(make_unique<sink>()) {
   // clang-format off
   if (isatty(m_fd)) {
     m_prefixes[loglevel::TRACE]   = "\r\033[0;32m- \033[0m";
@@ -66,6 +93,103 @@ logger::logger(loglevel level) : m_level(level) {
   // clang-format on
 }
 
+/**
+ * Deconstruct logger, the queued messages are written before it returns
+ */
+logger::~logger() {
+  if (m_sink->writer.joinable()) {
+    m_sink->queue.enqueue(string{});
+    m_sink->writer.join();
+  }
+}
+
+/**
+ * Wait until all messages logged so far are written
+ */
+void logger::flush() const {
+  auto target = m_sink->pushed.load();
+  if (target == 0) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> guard(m_sink->lock);
+  m_sink->done.wait(guard, [&] { return m_sink->written >= target; });
+}
+
+/**
+ * Buffer used to format messages on the calling thread
+ */
+std::vector<char>& logger::format_buffer() {
+  thread_local std::vector<char> buffer(256);
+  return buffer;
+}
+
+/**
+ * Hand a formatted message to the writer thread
+ */
+void logger::enqueue(loglevel level, const char* message, size_t size) const {
+  string line;
+  line.reserve(m_prefixes.at(level).size() + size + m_suffixes.at(level).size() + 1);
+  line.append(m_prefixes.at(level)).append(message, size).append(m_suffixes.at(level)).append(1, '\n');
+
+  if (getpid() != m_sink->pid) {
+    write_lines(line);
+    return;
+  }
+
+  std::call_once(m_sink->started, [this] {
+    m_sink->writer = std::thread([this] {
+      string batch[BATCH_SIZE];
+      string lines;
+      bool stopping{false};
+
+      while (true) {
+        size_t count;
+        if (stopping) {
+          count = m_sink->queue.try_dequeue_bulk(batch, BATCH_SIZE);
+          if (count == 0) {
+            break;
+          }
+        } else {
+          count = m_sink->queue.wait_dequeue_bulk(batch, BATCH_SIZE);
+        }
+
+        lines.clear();
+        for (size_t i = 0; i < count; i++) {
+          stopping = stopping || batch[i].empty();
+          lines += batch[i];
+        }
+        write_lines(lines);
+
+        {
+          std::lock_guard<std::mutex> guard(m_sink->lock);
+          m_sink->written += count;
+        }
+        m_sink->done.notify_all();
+      }
+    });
+  });
+
+  m_sink->queue.enqueue(move(line));
+  m_sink->pushed++;
+}
+
+/**
+ * Write to the output channel, retrying on partial writes
+ */
+void logger::write_lines(const string& lines) const {
+  size_t offset{0};
+  while (offset < lines.size()) {
+    auto bytes = ::write(m_fd, lines.data() + offset, lines.size() - offset);
+    if (bytes == -1 && errno == EINTR) {
+      continue;
+    } else if (bytes <= 0) {
+      break;
+    }
+    offset += bytes;
+  }
+}
+
 /**
  * Set output verbosity
  */
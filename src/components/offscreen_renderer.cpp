@@ -0,0 +1,278 @@
+#include "components/offscreen_renderer.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+#include "cairo/context.hpp"
+#include "cairo/font.hpp"
+#include "cairo/surface.hpp"
+#include "components/config.hpp"
+#include "components/logger.hpp"
+
+POLYBAR_NS
+
+/**
+ * Construct renderer and load the fonts
+ */
+offscreen_renderer::offscreen_renderer(
+    const logger& log, const bar_settings& bar, int width, int height, const vector<string>& fonts, double dpi)
+    : m_bar(bar)
+    , m_width(width)
+    , m_height(height)
+    , m_stride(cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width))
+    , m_data(m_stride * height) {
+  m_surface = make_unique<cairo::image_surface>(m_data.data(), CAIRO_FORMAT_ARGB32, m_width, m_height, m_stride);
+  m_context = make_unique<cairo::context>(*m_surface, log);
+
+  for (auto pattern : fonts) {
+    int offset{0};
+    size_t pos = pattern.rfind(';');
+    if (pos != string::npos) {
+      offset = std::strtol(pattern.substr(pos + 1).c_str(), nullptr, 10);
+      pattern.erase(pos);
+    }
+    *m_context << cairo::make_font(*m_context, move(pattern), offset, dpi, dpi);
+  }
+}
+
+offscreen_renderer::~offscreen_renderer() = default;
+
+/**
+ * Renderer with the fonts and dpi of the bar section of the config
+ */
+unique_ptr<offscreen_renderer> offscreen_renderer::make(
+    const logger& log, const config& conf, const bar_settings& bar, int width, int height) {
+  const auto& bs = conf.section();
+
+  double dpi = conf.get(bs, "dpi", 96.0);
+  if (dpi <= 0) {
+    dpi = 96.0;
+  }
+
+  auto fonts = conf.get_list<string>(bs, "font", {});
+  if (fonts.empty()) {
+    fonts.emplace_back("fixed");
+  }
+
+  return make_unique<offscreen_renderer>(log, bar, width, height, fonts, dpi);
+}
+
+int offscreen_renderer::width() const {
+  return m_width;
+}
+
+int offscreen_renderer::height() const {
+  return m_height;
+}
+
+/**
+ * Width of the contents of the last alignment block that was drawn
+ */
+int offscreen_renderer::content_width() const {
+  return static_cast<int>(std::ceil(m_x));
+}
+
+/**
+ * Start a frame, clears the surface to the bar background
+ */
+void offscreen_renderer::begin() {
+  m_context->save();
+  m_context->clear();
+  *m_context << m_bar.background;
+  m_context->paint();
+
+  m_bg = m_bar.background;
+  m_fg = m_bar.foreground;
+  m_font = 0;
+  m_align = alignment::NONE;
+  m_x = 0.0;
+  m_y = 0.0;
+}
+
+/**
+ * Finish the frame, the surface holds the complete bar afterwards
+ */
+void offscreen_renderer::end() {
+  close_reservation();
+  close_block();
+  m_context->restore();
+  m_surface->flush();
+}
+
+/**
+ * Save the last frame as png
+ */
+void offscreen_renderer::write_png(const string& path) const {
+  m_surface->write_png(path);
+}
+
+/**
+ * Save the last frame as png to an open file
+ */
+void offscreen_renderer::write_png(int fd) const {
+  m_surface->write_png(fd);
+}
+
+/**
+ * Color of a pixel in the last frame as premultiplied ARGB
+ */
+uint32_t offscreen_renderer::pixel(int x, int y) const {
+  return *reinterpret_cast<const uint32_t*>(m_data.data() + y * m_stride + x * 4);
+}
+
+void offscreen_renderer::change_background(const rgba& color) {
+  m_bg = color;
+}
+
+void offscreen_renderer::change_foreground(const rgba& color) {
+  m_fg = color;
+}
+
+void offscreen_renderer::change_underline(const rgba&) {}
+void offscreen_renderer::change_overline(const rgba&) {}
+
+void offscreen_renderer::change_font(int font) {
+  m_font = font;
+}
+
+/**
+ * Start a new alignment block, it is composited once the next one starts
+ */
+void offscreen_renderer::change_alignment(alignment align) {
+  close_reservation();
+  close_block();
+  m_align = align;
+  m_x = 0.0;
+  m_y = 0.0;
+  m_context->push();
+}
+
+void offscreen_renderer::reverse_colors() {
+  std::swap(m_bg, m_fg);
+}
+
+void offscreen_renderer::offset_pixel(int offset) {
+  m_x += offset;
+}
+
+void offscreen_renderer::attribute_set(tags::attribute) {}
+void offscreen_renderer::attribute_unset(tags::attribute) {}
+void offscreen_renderer::attribute_toggle(tags::attribute) {}
+void offscreen_renderer::action_begin(mousebtn, const string&) {}
+void offscreen_renderer::action_end(mousebtn) {}
+
+void offscreen_renderer::render_text(const string& text) {
+  cairo::textblock block{};
+  block.align = m_align;
+  block.contents = text;
+  block.font = m_font;
+  block.x_advance = &m_x;
+  block.y_advance = &m_y;
+  block.bg_rect = cairo::rect{0.0, 0.0, 0.0, 0.0};
+  // Same as the renderer, text past the width can't be visible
+  block.max_x = m_width;
+
+  if (m_bg != m_bar.background) {
+    block.bg = m_bg;
+    block.bg_operator = CAIRO_OPERATOR_SOURCE;
+    block.bg_rect.h = m_height;
+  }
+
+  m_context->save();
+  *m_context << cairo::abspos{m_x, m_height / 2.0};
+  *m_context << m_fg;
+  *m_context << block;
+  m_context->restore();
+}
+
+void offscreen_renderer::draw_graph(tags::graph_type type, int width, const vector<double>& values) {
+  cairo::rect area{m_x, m_height / 4.0, static_cast<double>(width), m_height / 2.0};
+
+  m_context->save();
+  *m_context << m_fg;
+  if (type == tags::graph_type::BAR) {
+    *m_context << cairo::rect{area.x, area.y, area.w * (values.empty() ? 0.0 : values.front()), area.h};
+    m_context->fill();
+  } else {
+    *m_context << cairo::sparkline{area.x, area.y, area.w, area.h, values};
+    m_context->stroke(1.0);
+  }
+  m_context->restore();
+
+  m_x += width;
+}
+
+void offscreen_renderer::control(tags::controltag ctrl) {
+  if (ctrl == tags::controltag::R) {
+    close_reservation();
+    m_bg = m_bar.background;
+    m_fg = m_bar.foreground;
+    m_font = 0;
+  }
+}
+
+/**
+ * Same as the renderer, without keeping anything for later frames
+ */
+void offscreen_renderer::reserve_width(const tags::reserved_width& width) {
+  close_reservation();
+
+  double w = width.chars ? width.width * m_context->textwidth("0", m_font) : width.width;
+  m_reserving = true;
+  m_reserved_end = m_x + w;
+  m_reserved_fixed = width.fixed;
+
+  if (m_reserved_fixed) {
+    m_context->save();
+    m_context->clip(cairo::rect{m_x, 0.0, w, static_cast<double>(m_height)});
+  }
+}
+
+/**
+ * Advance to the end of the reserved width
+ */
+void offscreen_renderer::close_reservation() {
+  if (!m_reserving) {
+    return;
+  }
+
+  if (m_reserved_fixed) {
+    m_context->restore();
+  }
+
+  if (m_x < m_reserved_end || m_reserved_fixed) {
+    m_x = m_reserved_end;
+  }
+  m_reserving = false;
+}
+
+/**
+ * Composite the current alignment block at its position
+ */
+void offscreen_renderer::close_block() {
+  if (m_align == alignment::NONE) {
+    return;
+  }
+
+  cairo_pattern_t* contents{};
+  m_context->pop(&contents);
+
+  double x{0.0};
+  if (m_align == alignment::CENTER) {
+    x = (m_width - m_x) / 2.0;
+  } else if (m_align == alignment::RIGHT) {
+    x = m_width - m_x;
+  }
+
+  m_context->save();
+  *m_context << cairo::translate{x, 0.0};
+  *m_context << contents;
+  m_context->paint();
+  m_context->restore();
+  m_context->destroy(&contents);
+
+  m_align = alignment::NONE;
+}
+
+POLYBAR_NS_END
@@ -0,0 +1,118 @@
+#include "components/power_policy.hpp"
+
+#include "components/config.hpp"
+#include "components/logger.hpp"
+#include "utils/factory.hpp"
+#include "utils/file.hpp"
+#include "utils/string.hpp"
+
+POLYBAR_NS
+
+constexpr chrono::seconds power_policy::POLL_INTERVAL;
+
+/**
+ * Create instance
+ */
+power_policy::make_type power_policy::make() {
+  auto multiplier = config::make().get("settings", "interval-on-battery-multiplier", 1.0);
+  if (multiplier < 1.0) {
+    throw value_error("settings.interval-on-battery-multiplier has to be at least 1");
+  }
+  auto low_power = config::make().get("settings", "interval-low-power-multiplier", 4.0);
+  if (low_power < 1.0) {
+    throw value_error("settings.interval-low-power-multiplier has to be at least 1");
+  }
+  return factory_util::unique<power_policy>(logger::make(), scheduler::make(), multiplier, low_power);
+}
+
+/**
+ * Construct power policy
+ *
+ * Nothing is polled if the multiplier doesn't change any interval.
+ */
+power_policy::power_policy(
+    const logger& logger, scheduler& scheduler, double multiplier, double low_power_multiplier, string supplies)
+    : m_log(logger)
+    , m_scheduler(scheduler)
+    , m_multiplier(multiplier)
+    , m_low_power_multiplier(low_power_multiplier)
+    , m_supplies(move(supplies)) {
+  if (m_multiplier > 1.0) {
+    m_log.info("power_policy: Multiplying timer intervals by %g while on battery", m_multiplier);
+    m_task = m_scheduler.add("power_policy", POLL_INTERVAL, [this] { update(); }, scheduler::duration::zero(),
+        scheduler::duration::zero(), 0);
+  }
+}
+
+power_policy::~power_policy() {
+  if (m_task != 0) {
+    m_scheduler.remove(m_task);
+  }
+  if (m_task != 0 || m_low_power) {
+    m_scheduler.set_interval_factor(1.0);
+  }
+}
+
+/**
+ * Whether the machine runs on battery
+ *
+ * That is the case if there are power supplies that report whether they are
+ * online (mains, usb), but none of them is. Without any such supply (e.g. on
+ * desktops), the machine is never on battery.
+ */
+bool power_policy::on_battery(const string& supplies) {
+  auto online = file_util::glob(supplies + "/*/online");
+  for (auto&& path : online) {
+    if (string_util::trim(file_util::contents(path), '\n') == "1") {
+      return false;
+    }
+  }
+  return !online.empty();
+}
+
+/**
+ * Check the power supplies and set the interval factor if that changed
+ */
+void power_policy::update() {
+  bool battery = on_battery(m_supplies);
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (battery == m_on_battery) {
+    return;
+  }
+
+  m_on_battery = battery;
+  m_log.info("power_policy: Running on %s", battery ? "battery" : "external power");
+  apply();
+}
+
+/**
+ * Turn low power mode on or off
+ */
+void power_policy::set_low_power(bool enabled) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (enabled == m_low_power) {
+    return;
+  }
+
+  m_low_power = enabled;
+  m_log.info("power_policy: Low power mode %s", enabled ? "on" : "off");
+  apply();
+}
+
+/**
+ * Set the interval factor of everything that applies
+ *
+ * Has to be called with m_lock held
+ */
+void power_policy::apply() {
+  double factor{1.0};
+  if (m_on_battery) {
+    factor = std::max(factor, m_multiplier);
+  }
+  if (m_low_power) {
+    factor = std::max(factor, m_low_power_multiplier);
+  }
+  m_scheduler.set_interval_factor(factor);
+}
+
+POLYBAR_NS_END
@@ -0,0 +1,133 @@
+#include "components/reactor.hpp"
+
+#include <unistd.h>
+
+#include "errors.hpp"
+#include "utils/factory.hpp"
+
+POLYBAR_NS
+
+/**
+ * Create instance
+ */
+reactor::make_type reactor::make() {
+  return static_cast<reactor&>(*factory_util::singleton<reactor>());
+}
+
+/**
+ * Construct reactor
+ */
+reactor::reactor() {
+  if ((m_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+    throw system_error("Failed to create epoll instance");
+  }
+}
+
+/**
+ * Deconstruct reactor
+ */
+reactor::~reactor() {
+  if (m_fd != -1) {
+    close(m_fd);
+  }
+}
+
+/**
+ * Register callback for the given file descriptor
+ *
+ * Replaces any callback that was previously registered for the descriptor
+ */
+void reactor::add(int fd, unsigned int events, callback fn) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  struct epoll_event ev {};
+  ev.events = events;
+  ev.data.fd = fd;
+
+  int op = m_callbacks.find(fd) == m_callbacks.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+
+  if (epoll_ctl(m_fd, op, fd, &ev) == -1) {
+    throw system_error("Failed to watch file descriptor " + to_string(fd));
+  }
+
+  m_callbacks[fd] = move(fn);
+}
+
+/**
+ * Change the events watched for an already registered file descriptor
+ */
+void reactor::modify(int fd, unsigned int events) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  struct epoll_event ev {};
+  ev.events = events;
+  ev.data.fd = fd;
+
+  if (epoll_ctl(m_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+    throw system_error("Failed to modify watch for file descriptor " + to_string(fd));
+  }
+}
+
+/**
+ * Stop watching the given file descriptor
+ *
+ * Safe to call from within a callback and for descriptors
+ * that have already been closed.
+ *
+ * \returns true if the descriptor was registered
+ */
+bool reactor::remove(int fd) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  if (m_callbacks.erase(fd) == 0) {
+    return false;
+  }
+
+  // Closed descriptors are removed from the epoll set by the kernel, so EBADF is fine here
+  epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, nullptr);
+  return true;
+}
+
+/**
+ * Check if a callback is registered for the given file descriptor
+ */
+bool reactor::has(int fd) const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_callbacks.find(fd) != m_callbacks.end();
+}
+
+/**
+ * Wait until at least one registered descriptor is ready and run its callback
+ *
+ * \param timeout_ms A value of -1 blocks until an event arrives
+ * \returns Number of ready descriptors or -1 on error (errno is kept)
+ */
+int reactor::poll(int timeout_ms) {
+  struct epoll_event events[MAX_EVENTS];
+
+  int count = epoll_wait(m_fd, events, MAX_EVENTS, timeout_ms);
+
+  if (count == -1) {
+    return -1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    callback fn;
+
+    {
+      // A previous callback in this batch may have removed the descriptor
+      std::lock_guard<std::mutex> guard(m_lock);
+      auto it = m_callbacks.find(events[i].data.fd);
+      if (it == m_callbacks.end()) {
+        continue;
+      }
+      fn = it->second;
+    }
+
+    fn(events[i].data.fd, events[i].events);
+  }
+
+  return count;
+}
+
+POLYBAR_NS_END
@@ -1,21 +1,50 @@
 #include "components/renderer.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+
 #include "cairo/context.hpp"
+#include "cairo/font_cache.hpp"
+#include "cairo/surface.hpp"
 #include "components/config.hpp"
+#include "components/scheduler.hpp"
+#include "components/startup_profile.hpp"
+#include "components/tracer.hpp"
 #include "events/signal.hpp"
 #include "events/signal_emitter.hpp"
 #include "events/signal_receiver.hpp"
 #include "utils/factory.hpp"
+#include "utils/file.hpp"
 #include "utils/math.hpp"
+#include "utils/scope.hpp"
 #include "x11/atoms.hpp"
 #include "x11/background_manager.hpp"
 #include "x11/connection.hpp"
 #include "x11/winspec.hpp"
 
+#if WITH_XSHM
+#include "x11/extensions/shm.hpp"
+#endif
+#if WITH_XPRESENT
+#include "x11/extensions/present.hpp"
+#endif
+
 POLYBAR_NS
 
 static constexpr double BLOCK_GAP{20.0};
 
+/**
+ * Number of texts rendered by rasterize() that are kept for later frames
+ */
+static constexpr size_t RASTERIZED_TEXT_LIMIT{32};
+
+bool render_state::operator==(const render_state& other) const {
+  return bg == other.bg && fg == other.fg && ul == other.ul && ol == other.ol && font == other.font &&
+         attr == other.attr;
+}
+
 /**
  * Create instance
  */
@@ -86,8 +115,45 @@ renderer::renderer(connection& conn, signal_emitter& sig, const config& conf, co
     // clang-format on
   }
 
-  m_log.trace("renderer: Allocate window pixmaps");
-  {
+  auto backend = m_conf.get(m_conf.section(), "render-backend", "xcb"s);
+
+  if (backend == "shm") {
+#if WITH_XSHM
+    m_log.trace("renderer: Allocate shared memory image");
+    if (!shm_util::query_extension(m_connection)) {
+      m_log.warn("The X server does not support MIT-SHM, falling back to render-backend = xcb");
+    } else {
+      try {
+        m_shm = make_unique<shm_image>(m_connection, m_depth, m_bar.size.w, m_bar.size.h);
+      } catch (const application_error& err) {
+        m_log.warn("%s, falling back to render-backend = xcb", err.what());
+      }
+    }
+#else
+    m_log.warn("Not built with MIT-SHM support, falling back to render-backend = xcb");
+#endif
+  } else if (backend == "present") {
+#if WITH_XPRESENT
+    m_log.trace("renderer: Allocate presentable pixmaps");
+    if (!present_util::query_extension(m_connection)) {
+      m_log.warn("The X server does not support Present, falling back to render-backend = xcb");
+    } else {
+      try {
+        m_present = make_unique<present_buffers>(m_connection, m_window, m_depth, m_bar.size.w, m_bar.size.h);
+        m_pixmap = m_present->acquire();
+      } catch (const application_error& err) {
+        m_log.warn("%s, falling back to render-backend = xcb", err.what());
+      }
+    }
+#else
+    m_log.warn("Not built with Present support, falling back to render-backend = xcb");
+#endif
+  } else if (backend != "xcb") {
+    throw value_error("Invalid render-backend '" + backend + "', expected 'xcb', 'shm' or 'present'");
+  }
+
+  if (!use_shm() && !use_present()) {
+    m_log.trace("renderer: Allocate window pixmaps");
     m_pixmap = m_connection.generate_id();
     m_connection.create_pixmap(m_depth, m_pixmap, m_window, m_bar.size.w, m_bar.size.h);
   }
@@ -101,7 +167,7 @@ renderer::renderer(connection& conn, signal_emitter& sig, const config& conf, co
     XCB_AUX_ADD_PARAM(&mask, &params, graphics_exposures, 0);
     connection::pack_values(mask, &params, value_list);
     m_gcontext = m_connection.generate_id();
-    m_connection.create_gc(m_gcontext, m_pixmap, mask, value_list);
+    m_connection.create_gc(m_gcontext, m_window, mask, value_list);
   }
 
   m_log.trace("renderer: Allocate alignment blocks");
@@ -113,12 +179,26 @@ renderer::renderer(connection& conn, signal_emitter& sig, const config& conf, co
 
   m_log.trace("renderer: Allocate cairo components");
   {
-    m_surface = make_unique<cairo::xcb_surface>(m_connection, m_pixmap, m_visual, m_bar.size.w, m_bar.size.h);
+#if WITH_XSHM
+    if (m_shm) {
+      auto format = m_depth == 32 ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24;
+      m_surface = make_unique<cairo::image_surface>(
+          m_shm->data(), format, m_bar.size.w, m_bar.size.h, m_shm->stride());
+      m_log.info("Rendering into shared memory image");
+    }
+#endif
+    if (!m_surface) {
+      m_surface = make_unique<cairo::xcb_surface>(m_connection, m_pixmap, m_visual, m_bar.size.w, m_bar.size.h);
+    }
+    if (use_present()) {
+      m_log.info("Presenting double buffered pixmaps");
+    }
     m_context = make_unique<cairo::context>(*m_surface, m_log);
   }
 
   m_log.trace("renderer: Load fonts");
   {
+    startup_profile::phase profile{"fonts"};
     double dpi_x = 96, dpi_y = 96;
     if (m_conf.has(m_conf.section(), "dpi")) {
       dpi_x = dpi_y = m_conf.get<double>("dpi");
@@ -150,16 +230,91 @@ renderer::renderer(connection& conn, signal_emitter& sig, const config& conf, co
       fonts.emplace_back("fixed");
     }
 
-    for (const auto& f : fonts) {
+    struct font_match {
+      string pattern;
       int offset{0};
-      string pattern{f};
-      size_t pos = pattern.rfind(';');
+      FcPattern* match{nullptr};
+      string error;
+    };
+
+    vector<font_match> matches(fonts.size());
+    for (size_t i = 0; i < fonts.size(); i++) {
+      matches[i].pattern = fonts[i];
+      size_t pos = matches[i].pattern.rfind(';');
       if (pos != string::npos) {
-        offset = std::strtol(pattern.substr(pos + 1).c_str(), nullptr, 10);
-        pattern.erase(pos);
+        matches[i].offset = std::strtol(matches[i].pattern.substr(pos + 1).c_str(), nullptr, 10);
+        matches[i].pattern.erase(pos);
       }
-      auto font = cairo::make_font(*m_context, string{pattern}, offset, dpi_x, dpi_y);
-      m_log.notice("Loaded font \"%s\" (name=%s, offset=%i, file=%s)", pattern, font->name(), offset, font->file());
+    }
+
+    // Matching takes a while for every font, so all fonts are matched at the same time
+    cairo::init_fonts();
+
+    // Matches from earlier runs only need to be checked, not repeated
+    unique_ptr<cairo::font_cache> cache;
+    auto cache_dir = file_util::get_cache_path();
+    if (!cache_dir.empty()) {
+      cache = make_unique<cairo::font_cache>(m_log, cache_dir + "/fonts.cache");
+    }
+
+    std::mutex lock;
+    std::condition_variable matched;
+    size_t remaining{matches.size()};
+
+    for (auto&& m : matches) {
+      scheduler::make().submit([&] {
+        try {
+          if (cache) {
+            m.match = cache->lookup(m.pattern);
+          }
+          if (m.match == nullptr) {
+            m.match = cairo::match_font(m.pattern);
+            if (cache) {
+              cache->store(m.pattern, m.match);
+            }
+          }
+        } catch (const exception& err) {
+          m.error = err.what();
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        remaining--;
+        matched.notify_all();
+      });
+    }
+
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      matched.wait(guard, [&] { return remaining == 0; });
+    }
+
+    auto cleanup = scope_util::make_exit_handler([&] {
+      for (auto&& m : matches) {
+        if (m.match != nullptr) {
+          FcPatternDestroy(m.match);
+        }
+      }
+    });
+
+    for (auto&& m : matches) {
+      if (!m.error.empty()) {
+        throw application_error(m.error);
+      }
+    }
+
+    if (cache) {
+      try {
+        cache->save();
+      } catch (const exception& err) {
+        m_log.warn("Failed to save font cache (reason: %s)", err.what());
+      }
+    }
+
+    // The scaled fonts are only created once a font is first used
+    for (auto&& m : matches) {
+      auto font = make_shared<cairo::font_fc>(*m_context, m.match, m.offset, dpi_x, dpi_y);
+      m.match = nullptr;
+      m_log.notice("Loaded font \"%s\" (name=%s, offset=%i, file=%s)", m.pattern, font->name(), m.offset, font->file());
       *m_context << move(font);
     }
   }
@@ -184,6 +339,14 @@ renderer::renderer(connection& conn, signal_emitter& sig, const config& conf, co
  */
 renderer::~renderer() {
   m_sig.detach(this);
+  discard_blocks();
+
+  if (m_bglayer != nullptr) {
+    m_context->destroy(&m_bglayer);
+  }
+  if (m_cornermask != nullptr) {
+    m_context->destroy(&m_cornermask);
+  }
 }
 
 /**
@@ -194,10 +357,10 @@ xcb_window_t renderer::window() const {
 }
 
 /**
- * Get completed action blocks
+ * Get the action blocks of the last completed frame
  */
-const vector<action_block> renderer::actions() const {
-  return m_actions;
+shared_ptr<const action_index> renderer::actions() const {
+  return std::atomic_load(&m_action_index);
 }
 
 /**
@@ -205,12 +368,46 @@ const vector<action_block> renderer::actions() const {
  */
 void renderer::begin(xcb_rectangle_t rect) {
   m_log.trace_x("renderer: begin (geom=%ix%i+%i+%i)", rect.width, rect.height, rect.x, rect.y);
+  m_frame_start = histogram::clock::now();
+
+#if WITH_XSHM
+  // The server may still be reading the last frame from the shared image
+  if (m_shm) {
+    m_shm->sync();
+  }
+#endif
+#if WITH_XPRESENT
+  // Draw into the pixmap that isn't shown, once the server is done reading from it
+  if (m_present) {
+    m_pixmap = m_present->acquire();
+    static_cast<cairo::xcb_surface&>(*m_surface).set_drawable(m_pixmap, m_bar.size.w, m_bar.size.h);
+  }
+#endif
+
+  // Blocks from the previous frame can only be reused if the geometry stayed the same
+  if (rect.x != m_rect.x || rect.y != m_rect.y || rect.width != m_rect.width || rect.height != m_rect.height) {
+    discard_blocks();
+
+    if (m_cornermask != nullptr) {
+      m_context->destroy(&m_cornermask);
+    }
+
+    m_bglayer_outdated = true;
+  }
 
   // Reset state
   m_rect = rect;
   m_actions.clear();
   m_attr.reset();
+  m_font = 0;
   m_align = alignment::NONE;
+  m_drawing = false;
+
+  for (auto&& b : m_blocks) {
+    b.second.active = false;
+    b.second.reused = false;
+    b.second.patched.clear();
+  }
 
   // Reset colors
   m_bg = m_bar.background;
@@ -222,12 +419,17 @@ void renderer::begin(xcb_rectangle_t rect) {
   m_context->save();
   m_context->clear();
 
-  // when pseudo-transparency is requested, render the bar into a new layer
-  // that will later be composited against the desktop background
-  if (m_pseudo_transparency) {
-    m_context->push();
+  if (m_bglayer_outdated.exchange(false) && m_bglayer != nullptr) {
+    m_context->destroy(&m_bglayer);
   }
 
+  if (m_bglayer == nullptr) {
+    create_background_layer();
+  }
+
+  *m_context << m_bglayer;
+  m_context->paint();
+
   // Create corner mask
   if (m_bar.radius && m_cornermask == nullptr) {
     m_context->save();
@@ -245,8 +447,6 @@ void renderer::begin(xcb_rectangle_t rect) {
     m_context->restore();
   }
 
-  fill_borders();
-
   // clang-format off
   m_context->clip(cairo::rect{
       static_cast<double>(m_rect.x),
@@ -262,15 +462,28 @@ void renderer::begin(xcb_rectangle_t rect) {
 void renderer::end() {
   m_log.trace_x("renderer: end");
 
+  close_block();
+
+  // Remember the actions of newly drawn blocks in case the blocks are reused
+  for (auto&& b : m_blocks) {
+    if (b.second.active && !b.second.reused) {
+      b.second.actions.clear();
+      for (auto&& a : m_actions) {
+        if (a.align == b.first) {
+          b.second.actions.emplace_back(a);
+        }
+      }
+    }
+  }
+
   for (auto&& a : m_actions) {
     a.start_x += block_x(a.align) + m_rect.x;
     a.end_x += block_x(a.align) + m_rect.x;
   }
 
-  if (m_align != alignment::NONE) {
-    m_log.trace_x("renderer: pop(%i)", static_cast<int>(m_align));
-    m_context->pop(&m_blocks[m_align].pattern);
+  std::atomic_store(&m_action_index, shared_ptr<const action_index>{std::make_shared<action_index>(m_actions)});
 
+  if (m_align != alignment::NONE) {
     // Capture the concatenated block contents
     // so that it can be masked with the corner pattern
     m_context->push();
@@ -280,6 +493,26 @@ void renderer::end() {
     fill_background();
 
     for (auto&& b : m_blocks) {
+      if (b.first == alignment::NONE) {
+        continue;
+      }
+
+      double x = b.second.active ? block_x(b.first) + m_rect.x : 0.0;
+      double w = block_w(b.first);
+
+      // Blocks that were reused at the same position look exactly like in the previous frame
+      if (!b.second.reused || x != b.second.drawn_x || w != b.second.drawn_w) {
+        damage(b.second.drawn_x, b.second.drawn_w);
+        damage(x, w);
+      } else {
+        for (auto&& slot : b.second.patched) {
+          damage(x + b.second.slots[slot].x, b.second.slots[slot].w + b.second.slots[slot].room);
+        }
+      }
+
+      b.second.drawn_x = x;
+      b.second.drawn_w = w;
+
       flush(b.first);
     }
 
@@ -296,41 +529,315 @@ void renderer::end() {
 
     m_context->destroy(&blockcontents);
   } else {
+    // Painted onto the background layer like the block contents
+    // so that pseudo-transparency still shows the wallpaper
+    cairo_pattern_t* background{};
+    m_context->push();
     fill_background();
+    m_context->pop(&background);
+    *m_context << background;
+    m_context->paint();
+    m_context->destroy(&background);
+
+    m_full_damage = true;
   }
 
-  // For pseudo-transparency, capture the contents of the rendered bar and
-  // composite it against the desktop wallpaper. This way transparent parts of
-  // the bar will be filled by the wallpaper creating illusion of transparency.
-  if (m_pseudo_transparency) {
-    cairo_pattern_t* barcontents{};
-    m_context->pop(&barcontents);  // corresponding push is in renderer::begin
+  m_context->restore();
+  m_surface->flush();
+
+  if (m_full_damage) {
+    flush();
+  } else if (m_damage_end > m_damage_start) {
+    auto x = static_cast<int16_t>(std::max(0.0, std::floor(m_damage_start) - 1.0));
+    auto end = static_cast<int16_t>(std::min<double>(m_bar.size.w, std::ceil(m_damage_end) + 1.0));
+    flush(xcb_rectangle_t{x, 0, static_cast<uint16_t>(end - x), static_cast<uint16_t>(m_bar.size.h)});
+  } else {
+    m_log.trace_x("renderer: Nothing changed, skipping copy");
+  }
+
+  m_frame_stats.record(histogram::clock::now() - m_frame_start);
+  m_sig.emit(signals::ui::changed{});
+}
+
+/**
+ * Check if the bar is rendered into a shared memory image instead of a pixmap
+ */
+bool renderer::use_shm() const {
+#if WITH_XSHM
+  return m_shm != nullptr;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Check if the pixmaps are shown with the Present extension instead of being copied
+ */
+bool renderer::use_present() const {
+#if WITH_XPRESENT
+  return m_present != nullptr;
+#else
+  return false;
+#endif
+}
+
+/**
+ * Mark the horizontal range of the pixmap as changed
+ */
+void renderer::damage(double x, double w) {
+  if (w <= 0.0) {
+    return;
+  }
+
+  if (m_damage_end <= m_damage_start) {
+    m_damage_start = x;
+    m_damage_end = x + w;
+  } else {
+    m_damage_start = std::min(m_damage_start, x);
+    m_damage_end = std::max(m_damage_end, x + w);
+  }
+}
+
+/**
+ * Reuse the rendered contents of the block from the previous frame
+ *
+ * This is only possible if the state the block starts with is the same as
+ * in the previous frame. The caller has to make sure that the contents of the
+ * block did not change.
+ *
+ * \returns false if the block has to be drawn again
+ */
+bool renderer::reuse_block(alignment a) {
+  auto& block = m_blocks[a];
 
+  if (a == m_align || block.active || block.pattern == nullptr || !(block.start == state())) {
+    return false;
+  }
+
+  m_log.trace_x("renderer: reuse(%i)", static_cast<int>(a));
+
+  close_block();
+
+  m_align = a;
+  block.active = true;
+  block.reused = true;
+  m_actions.insert(m_actions.end(), block.actions.begin(), block.actions.end());
+  restore_state(block.end);
+
+  return true;
+}
+
+/**
+ * Reuse the block from the previous frame with the text of a single slot replaced
+ *
+ * The new text is rendered on its own and painted over the slot, which is only
+ * possible if it has exactly the same width as the text it replaces. Animations
+ * usually change a single glyph of the same width, so their frames don't
+ * require the whole block to be drawn again. The rendered texts are kept, so
+ * repeating frames are not rendered again either.
+ *
+ * The caller has to make sure that nothing else in the block changed.
+ *
+ * \returns false if the block has to be drawn again
+ */
+bool renderer::patch_block(alignment a, size_t slot, const string& text) {
+  auto& block = m_blocks[a];
+
+  if (a == m_align || block.active || block.pattern == nullptr || !(block.start == state()) ||
+      slot >= block.slots.size()) {
+    return false;
+  }
+
+  close_block();
+
+  cairo_pattern_t* overlay{nullptr};
+  if (text != block.slots[slot].text && (overlay = rasterize(block.slots[slot], text)) == nullptr) {
+    return false;
+  }
+
+  if (!reuse_block(a)) {
+    return false;
+  }
+
+  m_log.trace_x("renderer: patch(%i, slot=%lu)", static_cast<int>(a), slot);
+
+  auto it = block.overlays.find(slot);
+  if (it != block.overlays.end()) {
+    cairo_pattern_destroy(it->second);
+    block.overlays.erase(it);
+  }
+  if (overlay != nullptr) {
+    block.overlays.emplace(slot, cairo_pattern_reference(overlay));
+  }
+
+  block.patched.emplace_back(slot);
+  return true;
+}
+
+/**
+ * Finish drawing the current alignment block
+ */
+void renderer::close_block() {
+  close_reservation();
+
+  if (!m_drawing) {
+    return;
+  }
+
+  m_log.trace_x("renderer: pop(%i)", static_cast<int>(m_align));
+  auto& block = m_blocks[m_align];
+
+  if (block.pattern != nullptr) {
+    m_context->destroy(&block.pattern);
+  }
+
+  m_context->pop(&block.pattern);
+  block.end = state();
+  m_drawing = false;
+}
+
+/**
+ * Drop the texts painted over the pattern of the block
+ */
+void renderer::clear_overlays(alignment_block& block) {
+  for (auto&& overlay : block.overlays) {
+    cairo_pattern_destroy(overlay.second);
+  }
+  block.overlays.clear();
+}
+
+/**
+ * Render the text in the state and at the position of the slot, exactly as it
+ * would be drawn into the block
+ *
+ * The result includes the bar background, so it can be painted over the slot
+ * like the block pattern.
+ *
+ * Text at the end of a reserved width may also take up more or less of the
+ * reserved space than the text of the slot, see text_slot::room.
+ *
+ * \returns nullptr if the text doesn't fit into the place of the slot
+ */
+cairo_pattern_t* renderer::rasterize(const text_slot& slot, const string& text) {
+  double area = slot.w + slot.room;
+  auto cached = std::find_if(m_rasterized.begin(), m_rasterized.end(), [&](const rasterized_text& r) {
+    return r.text == text && r.x == slot.x && r.area == area && r.state == slot.state;
+  });
+
+  if (cached == m_rasterized.end()) {
+    m_log.trace_x("renderer: rasterize(%s)", text);
+    auto current = state();
+    restore_state(slot.state);
+
+    m_context->save();
+    *m_context << cairo::abspos{0.0, 0.0};
+    m_context->clip(cairo::rect{m_rect.x + slot.x, static_cast<double>(m_rect.y), area,
+        static_cast<double>(m_rect.height)});
+    m_context->push();
+    fill_background();
+
+    double x{slot.x};
+    double y{0.0};
+    paint_text(text, x, y);
+
+    cairo_pattern_t* pattern{};
+    m_context->pop(&pattern);
+    m_context->restore();
+    restore_state(current);
+
+    m_rasterized.emplace_front(rasterized_text{slot.state, text, slot.x, x - slot.x, area, pattern});
+    if (m_rasterized.size() > RASTERIZED_TEXT_LIMIT) {
+      m_context->destroy(&m_rasterized.back().pattern);
+      m_rasterized.pop_back();
+    }
+    cached = m_rasterized.begin();
+  }
+
+  // Text that is cut off has to stay cut off, otherwise the texts after it would show up
+  bool fits = slot.room > 0.0 ? cached->w <= area : slot.room < 0.0 ? cached->w >= area : cached->w == slot.w;
+  return fits ? cached->pattern : nullptr;
+}
+
+/**
+ * Render the parts of the bar that don't depend on its contents
+ *
+ * For pseudo-transparency this is the slice of the desktop wallpaper with
+ * the borders composited on top of it, otherwise just the borders. The
+ * contents of each frame are then painted over this layer, which is
+ * equivalent to compositing the whole bar against the wallpaper.
+ *
+ * The layer is only created again if the geometry or the wallpaper changes.
+ */
+void renderer::create_background_layer() {
+  m_log.trace_x("renderer: Create background layer");
+  m_context->save();
+  m_context->push();
+
+  if (m_pseudo_transparency) {
     auto root_bg = m_background->get_surface();
     if (root_bg != nullptr) {
       m_log.trace_x("renderer: root background");
       *m_context << *root_bg;
       m_context->paint();
-      *m_context << CAIRO_OPERATOR_OVER;
     }
-    *m_context << barcontents;
-    m_context->paint();
-    m_context->destroy(&barcontents);
   }
 
+  cairo_pattern_t* borders{};
+  m_context->push();
+  fill_borders();
+  m_context->pop(&borders);
+
+  *m_context << CAIRO_OPERATOR_OVER << borders;
+  m_context->paint();
+  m_context->destroy(&borders);
+
+  m_context->pop(&m_bglayer);
   m_context->restore();
-  m_surface->flush();
+}
+
+/**
+ * Drop all blocks kept from previous frames
+ */
+void renderer::discard_blocks() {
+  for (auto&& b : m_blocks) {
+    if (b.second.pattern != nullptr) {
+      m_context->destroy(&b.second.pattern);
+    }
+    b.second.actions.clear();
+    b.second.slots.clear();
+    clear_overlays(b.second);
+  }
 
-  flush();
+  // Rendered for a geometry that may have changed
+  for (auto&& r : m_rasterized) {
+    m_context->destroy(&r.pattern);
+  }
+  m_rasterized.clear();
 
-  m_sig.emit(signals::ui::changed{});
+  m_full_damage = true;
+}
+
+/**
+ * Current drawing state
+ */
+render_state renderer::state() const {
+  return render_state{m_bg, m_fg, m_ul, m_ol, m_font, m_attr};
+}
+
+void renderer::restore_state(const render_state& state) {
+  m_bg = state.bg;
+  m_fg = state.fg;
+  m_ul = state.ul;
+  m_ol = state.ol;
+  m_font = state.font;
+  m_attr = state.attr;
 }
 
 /**
  * Flush contents of given alignment block
  */
 void renderer::flush(alignment a) {
-  if (m_blocks[a].pattern == nullptr) {
+  if (!m_blocks[a].active || m_blocks[a].pattern == nullptr) {
     return;
   }
 
@@ -359,8 +866,18 @@ void renderer::flush(alignment a) {
   *m_context << m_blocks[a].pattern;
   m_context->paint();
 
+  for (auto&& overlay : m_blocks[a].overlays) {
+    const auto& slot = m_blocks[a].slots[overlay.first];
+    m_context->save();
+    *m_context << cairo::abspos{0.0, 0.0};
+    m_context->clip(cairo::rect{m_rect.x + slot.x, m_rect.y + y, slot.w + slot.room, h});
+    m_context->clear();
+    *m_context << overlay.second;
+    m_context->paint();
+    m_context->restore();
+  }
+
   *m_context << cairo::abspos{0.0, 0.0};
-  m_context->destroy(&m_blocks[a].pattern);
   m_context->restore();
 
   if (!fits) {
@@ -394,7 +911,16 @@ void renderer::flush(alignment a) {
  * Flush pixmap contents onto the target window
  */
 void renderer::flush() {
-  m_log.trace_x("renderer: flush");
+  flush(xcb_rectangle_t{0, 0, static_cast<uint16_t>(m_bar.size.w), static_cast<uint16_t>(m_bar.size.h)});
+}
+
+/**
+ * Flush the given area of the pixmap onto the target window
+ */
+void renderer::flush(const xcb_rectangle_t& area) {
+  m_log.trace_x("renderer: flush (geom=%ix%i+%i+%i)", area.width, area.height, area.x, area.y);
+  scoped_timer timer{m_flush_stats};
+  POLYBAR_TRACE("renderer.flush");
 
   highlight_clickable_areas();
 
@@ -418,8 +944,25 @@ void renderer::flush() {
 #endif
 
   m_surface->flush();
-  m_connection.copy_area(m_pixmap, m_window, m_gcontext, 0, 0, 0, 0, m_bar.size.w, m_bar.size.h);
-  m_connection.flush();
+
+#if WITH_XSHM
+  if (m_shm) {
+    m_shm->put(m_window, m_gcontext, area);
+  }
+#endif
+#if WITH_XPRESENT
+  // The whole pixmap is drawn for every frame, so it can be shown as a whole
+  if (m_present) {
+    m_present->present();
+  }
+#endif
+  if (!use_shm() && !use_present()) {
+    m_connection.copy_area(m_pixmap, m_window, m_gcontext, area.x, area.y, area.x, area.y, area.width, area.height);
+  }
+  m_connection.request_flush();
+
+  m_damage_start = m_damage_end = 0.0;
+  m_full_damage = false;
 
   if (!m_snapshot_dst.empty()) {
     try {
@@ -527,7 +1070,8 @@ double renderer::block_y(alignment) const {
  * Get block width for given alignment
  */
 double renderer::block_w(alignment a) const {
-  return m_blocks.at(a).x;
+  const auto& block = m_blocks.at(a);
+  return block.active ? block.x : 0.0;
 }
 
 /**
@@ -673,17 +1217,40 @@ void renderer::fill_borders() {
 void renderer::draw_text(const string& contents) {
   m_log.trace_x("renderer: text(%s)", contents.c_str());
 
+  if (m_align == alignment::NONE) {
+    // Not part of any block, so block based damage tracking doesn't cover it
+    m_full_damage = true;
+  }
+
+  auto& current = m_blocks[m_align];
+  text_slot slot{current.x, 0.0, 0.0, state(), contents};
+
+  paint_text(contents, current.x, current.y);
+
+  // Remembered so that a later frame can replace just this text, see patch_block()
+  if (m_drawing) {
+    slot.w = current.x - slot.x;
+    current.slots.emplace_back(move(slot));
+  }
+}
+
+/**
+ * Draw text at the given position, relative to the start of the bar, and advance it
+ */
+void renderer::paint_text(const string& contents, double& x_advance, double& y_advance) {
   cairo::abspos origin{};
-  origin.x = m_rect.x + m_blocks[m_align].x;
+  origin.x = m_rect.x + x_advance;
   origin.y = m_rect.y + m_rect.height / 2.0;
 
   cairo::textblock block{};
   block.align = m_align;
   block.contents = contents;
   block.font = m_font;
-  block.x_advance = &m_blocks[m_align].x;
-  block.y_advance = &m_blocks[m_align].y;
+  block.x_advance = &x_advance;
+  block.y_advance = &y_advance;
   block.bg_rect = cairo::rect{0.0, 0.0, 0.0, 0.0};
+  // Blocks never start left of the bar, so text past its width stays hidden wherever the block is placed
+  block.max_x = m_rect.x + m_rect.width;
 
   // Only draw text background if the color differs from
   // the background color of the bar itself
@@ -704,13 +1271,67 @@ void renderer::draw_text(const string& contents) {
   *m_context << block;
   m_context->restore();
 
-  double dx = m_rect.x + m_blocks[m_align].x - origin.x;
+  double dx = m_rect.x + x_advance - origin.x;
   if (dx > 0.0) {
     fill_underline(origin.x, dx);
     fill_overline(origin.x, dx);
   }
 }
 
+/**
+ * Draw a graph with cairo paths, it takes up the middle half of the bar's height
+ *
+ * The part of a bar that isn't filled and the area below a sparkline are
+ * shaded with a translucent foreground color.
+ */
+void renderer::draw_graph(tags::graph_type type, int width, const vector<double>& values) {
+  m_log.trace_x("renderer: graph(w=%i, values=%lu)", width, values.size());
+
+  if (m_align == alignment::NONE) {
+    m_full_damage = true;
+  }
+
+  auto& current = m_blocks[m_align];
+  double x = m_rect.x + current.x;
+  double inset = std::floor(m_rect.height / 4.0);
+  cairo::rect area{x, m_rect.y + inset, static_cast<double>(width), m_rect.height - 2.0 * inset};
+
+  rgba shade{(m_fg.value() & 0x00FFFFFF) | (static_cast<uint32_t>(m_fg.alpha_i() / 3) << 24)};
+
+  m_context->save();
+
+  // Same as for text, see paint_text()
+  if (m_bg != m_bar.background) {
+    *m_context << m_comp_bg << m_bg;
+    *m_context << cairo::rect{x, static_cast<double>(m_rect.y), area.w, static_cast<double>(m_rect.height)};
+    m_context->fill();
+  }
+
+  *m_context << m_comp_fg;
+
+  if (type == tags::graph_type::BAR) {
+    double filled = values.empty() ? 0.0 : std::round(area.w * std::max(0.0, std::min(1.0, values.front())));
+    *m_context << shade << cairo::rect{area.x + filled, area.y, area.w - filled, area.h};
+    m_context->fill();
+    *m_context << m_fg << cairo::rect{area.x, area.y, filled, area.h};
+    m_context->fill();
+  } else {
+    rgba clear{m_fg.value() & 0x00FFFFFF};
+    *m_context << cairo::sparkline{area.x, area.y, area.w, area.h, values, true};
+    *m_context << cairo::linear_gradient{0.0, area.y, 0.0, area.y + area.h, {shade, clear}};
+    m_context->fill();
+    *m_context << cairo::sparkline{area.x, area.y, area.w, area.h, values};
+    *m_context << m_fg;
+    m_context->stroke(1.0);
+  }
+
+  m_context->restore();
+
+  current.x += width;
+  fill_underline(x, width);
+  fill_overline(x, width);
+}
+
 /**
  * Colorize the bounding box of created action blocks
  */
@@ -741,118 +1362,100 @@ bool renderer::on(const signals::ui::request_snapshot& evt) {
   return true;
 }
 
-bool renderer::on(const signals::parser::change_background& evt) {
-  const rgba color{evt.cast()};
+void renderer::change_background(const rgba& color) {
   if (color != m_bg) {
     m_log.trace_x("renderer: change_background(#%08x)", color);
     m_bg = color;
   }
-  return true;
 }
 
-bool renderer::on(const signals::parser::change_foreground& evt) {
-  const rgba color{evt.cast()};
+void renderer::change_foreground(const rgba& color) {
   if (color != m_fg) {
     m_log.trace_x("renderer: change_foreground(#%08x)", color);
     m_fg = color;
   }
-  return true;
 }
 
-bool renderer::on(const signals::parser::change_underline& evt) {
-  const rgba color{evt.cast()};
+void renderer::change_underline(const rgba& color) {
   if (color != m_ul) {
     m_log.trace_x("renderer: change_underline(#%08x)", color);
     m_ul = color;
   }
-  return true;
 }
 
-bool renderer::on(const signals::parser::change_overline& evt) {
-  const rgba color{evt.cast()};
+void renderer::change_overline(const rgba& color) {
   if (color != m_ol) {
     m_log.trace_x("renderer: change_overline(#%08x)", color);
     m_ol = color;
   }
-  return true;
 }
 
-bool renderer::on(const signals::parser::change_font& evt) {
-  const int font{evt.cast()};
+void renderer::change_font(int font) {
   if (font != m_font) {
     m_log.trace_x("renderer: change_font(%i)", font);
     m_font = font;
   }
-  return true;
 }
 
-bool renderer::on(const signals::parser::change_alignment& evt) {
-  auto align = static_cast<const alignment&>(evt.cast());
+void renderer::change_alignment(alignment align) {
   if (align != m_align) {
     m_log.trace_x("renderer: change_alignment(%i)", static_cast<int>(align));
 
-    if (m_align != alignment::NONE) {
-      m_log.trace_x("renderer: pop(%i)", static_cast<int>(m_align));
-      m_context->pop(&m_blocks[m_align].pattern);
-    }
+    close_block();
 
     m_align = align;
     m_blocks[m_align].x = 0.0;
     m_blocks[m_align].y = 0.0;
+    m_blocks[m_align].active = true;
+    m_blocks[m_align].reused = false;
+    m_blocks[m_align].start = state();
+    m_blocks[m_align].slots.clear();
+    clear_overlays(m_blocks[m_align]);
     m_context->push();
+    m_drawing = true;
     m_log.trace_x("renderer: push(%i)", static_cast<int>(m_align));
 
     fill_background();
   }
-  return true;
 }
 
-bool renderer::on(const signals::parser::reverse_colors&) {
+void renderer::reverse_colors() {
   m_log.trace_x("renderer: reverse_colors");
   std::swap(m_fg, m_bg);
-  return true;
 }
 
-bool renderer::on(const signals::parser::offset_pixel& evt) {
-  m_log.trace_x("renderer: offset_pixel(%f)", evt.cast());
-  m_blocks[m_align].x += evt.cast();
-  return true;
+void renderer::offset_pixel(int offset) {
+  m_log.trace_x("renderer: offset_pixel(%i)", offset);
+  m_blocks[m_align].x += offset;
 }
 
-bool renderer::on(const signals::parser::attribute_set& evt) {
-  m_log.trace_x("renderer: attribute_set(%i)", static_cast<int>(evt.cast()));
-  m_attr.set(static_cast<int>(evt.cast()), true);
-  return true;
+void renderer::attribute_set(tags::attribute attr) {
+  m_log.trace_x("renderer: attribute_set(%i)", static_cast<int>(attr));
+  m_attr.set(static_cast<int>(attr), true);
 }
 
-bool renderer::on(const signals::parser::attribute_unset& evt) {
-  m_log.trace_x("renderer: attribute_unset(%i)", static_cast<int>(evt.cast()));
-  m_attr.set(static_cast<int>(evt.cast()), false);
-  return true;
+void renderer::attribute_unset(tags::attribute attr) {
+  m_log.trace_x("renderer: attribute_unset(%i)", static_cast<int>(attr));
+  m_attr.set(static_cast<int>(attr), false);
 }
 
-bool renderer::on(const signals::parser::attribute_toggle& evt) {
-  m_log.trace_x("renderer: attribute_toggle(%i)", static_cast<int>(evt.cast()));
-  m_attr.flip(static_cast<int>(evt.cast()));
-  return true;
+void renderer::attribute_toggle(tags::attribute attr) {
+  m_log.trace_x("renderer: attribute_toggle(%i)", static_cast<int>(attr));
+  m_attr.flip(static_cast<int>(attr));
 }
 
-bool renderer::on(const signals::parser::action_begin& evt) {
-  auto a = evt.cast();
-  m_log.trace_x("renderer: action_begin(btn=%i, command=%s)", static_cast<int>(a.button), a.command);
+void renderer::action_begin(mousebtn btn, const string& command) {
+  m_log.trace_x("renderer: action_begin(btn=%i, command=%s)", static_cast<int>(btn), command);
   action_block action{};
-  action.button = a.button == mousebtn::NONE ? mousebtn::LEFT : a.button;
+  action.button = btn == mousebtn::NONE ? mousebtn::LEFT : btn;
   action.align = m_align;
   action.start_x = m_blocks.at(m_align).x;
-  action.command = a.command;
+  action.command = command;
   action.active = true;
   m_actions.emplace_back(action);
-  return true;
 }
 
-bool renderer::on(const signals::parser::action_end& evt) {
-  auto btn = evt.cast();
-
+void renderer::action_end(mousebtn btn) {
   /*
    * Iterate actions in reverse and find the FIRST active action that matches
    */
@@ -864,20 +1467,16 @@ bool renderer::on(const signals::parser::action_end& evt) {
       break;
     }
   }
-  return true;
 }
 
-bool renderer::on(const signals::parser::text& evt) {
-  auto text = evt.cast();
+void renderer::render_text(const string& text) {
   draw_text(text);
-  return true;
 }
 
-bool renderer::on(const signals::parser::control& evt) {
-  auto ctrl = evt.cast();
-
+void renderer::control(tags::controltag ctrl) {
   switch (ctrl) {
     case tags::controltag::R:
+      close_reservation();
       m_bg = m_bar.background;
       m_fg = m_bar.foreground;
       m_ul = m_bar.underline.color;
@@ -886,11 +1485,89 @@ bool renderer::on(const signals::parser::control& evt) {
       m_attr.reset();
       break;
 
+    case tags::controltag::W:
+    case tags::controltag::F:
     case tags::controltag::NONE:
       break;
   }
+}
 
-  return true;
+/**
+ * Reserve space for the module that starts here, up to the next reset tag
+ *
+ * The module takes up at least the reserved width, with a fixed width
+ * everything past it is cut off. Changes of its contents then don't move the
+ * other modules of the block, and if only the last text of the module
+ * changes, the text can be patched without drawing the block again (see
+ * patch_block()).
+ */
+void renderer::reserve_width(const tags::reserved_width& width) {
+  m_log.trace_x("renderer: reserve_width(%i%s, fixed=%i)", width.width, width.chars ? "ch" : "",
+      static_cast<int>(width.fixed));
+  close_reservation();
+
+  auto& current = m_blocks[m_align];
+  m_reserved.active = true;
+  m_reserved.fixed = width.fixed;
+  m_reserved.x = current.x;
+  m_reserved.w = width.chars ? width.width * m_context->textwidth("0", m_font) : width.width;
+  m_reserved.slots = current.slots.size();
+
+  if (m_reserved.fixed) {
+    m_context->save();
+    m_context->clip(cairo::rect{m_rect.x + current.x, static_cast<double>(m_rect.y), m_reserved.w,
+        static_cast<double>(m_rect.height)});
+  }
+}
+
+/**
+ * End the reserved width and continue after it
+ */
+void renderer::close_reservation() {
+  if (!m_reserved.active) {
+    return;
+  }
+
+  m_reserved.active = false;
+  if (m_reserved.fixed) {
+    m_context->restore();
+  }
+
+  auto& current = m_blocks[m_align];
+  double end = m_reserved.x + m_reserved.w;
+
+  if (current.x < end) {
+    // Only the last text of the module can grow without moving anything else
+    if (current.slots.size() > m_reserved.slots && current.slots.back().x + current.slots.back().w == current.x) {
+      current.slots.back().room = end - current.x;
+    }
+  } else if (m_reserved.fixed) {
+    for (size_t i = m_reserved.slots; i < current.slots.size(); i++) {
+      auto& slot = current.slots[i];
+      if (slot.x + slot.w > end) {
+        slot.room = std::max(-slot.w, end - slot.x - slot.w);
+      }
+    }
+  } else {
+    return;
+  }
+
+  // Actions that reach to the end of the contents reach to the end of the reserved width
+  for (auto&& action : m_actions) {
+    if (!action.active && action.align == m_align && action.start_x >= m_reserved.x &&
+        (action.end_x == current.x || action.end_x > end)) {
+      action.end_x = end;
+    }
+  }
+
+  current.x = end;
+}
+
+bool renderer::on(const signals::ui::update_background&) {
+  // Emitted outside of the render thread, the layer is recreated with the next frame
+  m_bglayer_outdated = true;
+  m_full_damage = true;
+  return false;
 }
 
 POLYBAR_NS_END
@@ -0,0 +1,389 @@
+#include "components/scheduler.hpp"
+
+#include <algorithm>
+
+#include "components/logger.hpp"
+#include "errors.hpp"
+#include "components/stats.hpp"
+#include "components/thread_policy.hpp"
+#include "utils/factory.hpp"
+
+POLYBAR_NS
+
+constexpr unsigned scheduler::SUSPENDABLE;
+constexpr unsigned scheduler::STRETCHABLE;
+constexpr unsigned scheduler::BACKGROUND;
+
+/**
+ * Create instance
+ *
+ * Uses one worker per core, but no more than MAX_WORKERS
+ */
+scheduler::make_type scheduler::make() {
+  static constexpr size_t MAX_WORKERS{4};
+  size_t workers = std::min<size_t>(std::max(1U, std::thread::hardware_concurrency()), MAX_WORKERS);
+  return static_cast<scheduler&>(*factory_util::singleton<scheduler>(logger::make(), workers));
+}
+
+/**
+ * Construct scheduler and start its threads
+ */
+scheduler::scheduler(const logger& logger, size_t workers) : m_log(logger), m_pool(logger, workers) {
+  m_timer = thread_policy::spawn(thread_policy::role::NORMAL, [this] { timer_loop(); });
+  m_log.trace("scheduler: Started %lu workers", m_pool.size());
+}
+
+/**
+ * Deconstruct scheduler
+ *
+ * Running tasks are finished by the worker pool, tasks that are due are dropped
+ */
+scheduler::~scheduler() {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_active = false;
+  }
+
+  m_timer_cond.notify_all();
+
+  if (m_timer.joinable()) {
+    m_timer.join();
+  }
+}
+
+/**
+ * Add a task that is run every `interval`
+ *
+ * The first run happens right away, all following runs happen `offset`
+ * after the next multiple of `interval` (counted from the epoch).
+ *
+ * A run may be delayed by up to `slack` to batch it with other tasks.
+ * Tasks without the SUSPENDABLE flag keep running while the scheduler is
+ * suspended, e.g. animations of the bar window itself. The interval of
+ * STRETCHABLE tasks is scaled by the interval factor.
+ *
+ * The queueing latency of the task is recorded as `<name>.wait`.
+ */
+scheduler::task_id scheduler::add(
+    const string& name, duration interval, callback fn, duration offset, duration slack, unsigned flags) {
+  auto& latency = stats::make().get(name + ".wait");
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  task_id id = m_next_id++;
+  auto& t = m_tasks[id];
+  t.interval = interval;
+  t.offset = offset;
+  t.slack = std::max(slack, duration::zero());
+  t.fn = move(fn);
+  t.latency = &latency;
+  t.flags = flags;
+
+  enqueue(id, t);
+  return id;
+}
+
+/**
+ * Remove a task
+ *
+ * If the task is currently running, this blocks until the callback returns,
+ * unless it is called from within that callback.
+ */
+void scheduler::remove(task_id id) {
+  std::unique_lock<std::mutex> guard(m_lock);
+
+  auto it = m_tasks.find(id);
+  if (it == m_tasks.end()) {
+    return;
+  }
+
+  if (it->second.status == state::RUNNING && it->second.runner != std::this_thread::get_id()) {
+    m_done_cond.wait(guard, [&] {
+      it = m_tasks.find(id);
+      return it == m_tasks.end() || it->second.status != state::RUNNING;
+    });
+
+    if (it == m_tasks.end()) {
+      return;
+    }
+  }
+
+  // Outdated heap entries and queued ids are skipped once they come up
+  m_tasks.erase(it);
+}
+
+/**
+ * Run the task as soon as possible, independent of its deadline
+ */
+void scheduler::trigger(task_id id) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  auto it = m_tasks.find(id);
+  if (it == m_tasks.end()) {
+    return;
+  }
+
+  if (it->second.status == state::IDLE) {
+    it->second.parked = false;
+    enqueue(id, it->second);
+  } else if (it->second.status == state::RUNNING) {
+    it->second.again = true;
+  }
+}
+
+/**
+ * Change the interval of a task
+ *
+ * A task that is waiting for its next run is rescheduled with the new
+ * interval, a running task uses it for its next deadline.
+ */
+void scheduler::set_interval(task_id id, duration interval) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto it = m_tasks.find(id);
+  if (it == m_tasks.end() || it->second.interval == interval) {
+    return;
+  }
+
+  auto& t = it->second;
+  t.interval = interval;
+  if (t.status == state::IDLE && !t.parked && !t.once) {
+    schedule(id, t, clock::now());
+  }
+}
+
+/**
+ * Park a periodic task until it is resumed, or run it and continue as usual
+ *
+ * Like suspend(), a task that is waiting for its next run is parked right
+ * away and a running task is parked once it returns. Triggering a paused task
+ * still runs it once.
+ */
+void scheduler::pause(task_id id, bool paused) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto it = m_tasks.find(id);
+  if (it == m_tasks.end() || it->second.once || it->second.paused == paused) {
+    return;
+  }
+
+  auto& t = it->second;
+  t.paused = paused;
+  if (t.status != state::IDLE) {
+    return;
+  }
+
+  if (paused) {
+    t.deadline = clock::time_point::max();
+    t.parked = true;
+  } else if (t.parked && !(m_suspended && (t.flags & SUSPENDABLE))) {
+    t.parked = false;
+    enqueue(id, t);
+  }
+}
+
+/**
+ * Park periodic tasks instead of running them, or run the parked tasks and
+ * continue as usual
+ *
+ * Tasks keep their current deadline, so each of them runs once more before
+ * it is parked. One-off jobs and triggered tasks still run while suspended.
+ */
+void scheduler::suspend(bool suspended) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (suspended == m_suspended) {
+    return;
+  }
+
+  m_suspended = suspended;
+  m_log.info("scheduler: %s periodic tasks", suspended ? "Suspending" : "Resuming");
+
+  if (!suspended) {
+    for (auto&& t : m_tasks) {
+      if (t.second.parked && !t.second.paused) {
+        t.second.parked = false;
+        enqueue(t.first, t.second);
+      }
+    }
+  }
+}
+
+/**
+ * Multiply the intervals of all stretchable tasks by `factor`
+ *
+ * Tasks that are waiting for their next run get a new deadline right away.
+ */
+void scheduler::set_interval_factor(double factor) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  factor = std::max(factor, 1.0);
+  if (factor == m_factor) {
+    return;
+  }
+
+  m_factor = factor;
+  m_log.info("scheduler: Stretching intervals by %g", factor);
+
+  auto now = clock::now();
+  for (auto&& t : m_tasks) {
+    auto& task = t.second;
+    if ((task.flags & STRETCHABLE) && task.status == state::IDLE && !task.parked && !task.once) {
+      schedule(t.first, task, now);
+    }
+  }
+}
+
+/**
+ * Run a one-off job on the workers
+ */
+void scheduler::submit(worker_pool::job fn, histogram* latency) {
+  m_pool.submit(move(fn), latency);
+}
+
+/**
+ * Run a one-off job on the workers once `delay` has passed
+ *
+ * Deferred jobs are dropped if the scheduler is destroyed before they are due.
+ */
+void scheduler::defer(duration delay, callback fn) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  task_id id = m_next_id++;
+  auto& t = m_tasks[id];
+  t.offset = std::max(delay, duration::zero());
+  t.fn = move(fn);
+  t.once = true;
+
+  schedule(id, t, clock::now());
+}
+
+/**
+ * Wait until the slack of the most urgent task is used up and hand all
+ * tasks that are due by then to the workers
+ */
+void scheduler::timer_loop() {
+  std::unique_lock<std::mutex> guard(m_lock);
+
+  while (m_active) {
+    // Drop outdated entries so that they don't cause extra wakeups
+    while (!m_deadlines.empty() && outdated(m_deadlines.top())) {
+      m_deadlines.pop();
+    }
+
+    if (m_deadlines.empty()) {
+      m_timer_cond.wait(guard);
+      continue;
+    }
+
+    auto now = clock::now();
+    auto next = m_deadlines.top().latest;
+
+    // The heap can change while waiting, so the deadline must not be taken by reference
+    if (next > now) {
+      m_timer_cond.wait_until(guard, next);
+      continue;
+    }
+
+    // Everything that is due anyway joins this wakeup
+    for (auto&& t : m_tasks) {
+      if (t.second.status == state::IDLE && t.second.deadline <= now) {
+        enqueue(t.first, t.second);
+      }
+    }
+  }
+}
+
+/**
+ * Check if the heap entry belongs to a removed task or an earlier deadline
+ *
+ * Expects m_lock to be held
+ */
+bool scheduler::outdated(const entry& e) const {
+  auto it = m_tasks.find(e.id);
+  return it == m_tasks.end() || it->second.status != state::IDLE || it->second.deadline != e.deadline;
+}
+
+/**
+ * Run the task on the current worker and schedule its next run
+ */
+void scheduler::run(task_id id) {
+  std::unique_lock<std::mutex> guard(m_lock);
+
+  auto it = m_tasks.find(id);
+  if (it == m_tasks.end()) {
+    return;
+  }
+
+  it->second.status = state::RUNNING;
+  it->second.runner = std::this_thread::get_id();
+  callback fn = it->second.fn;
+  bool background = it->second.flags & BACKGROUND;
+
+  guard.unlock();
+  try {
+    if (background) {
+      thread_policy::scoped_role role(thread_policy::role::WORKER);
+      fn();
+    } else {
+      fn();
+    }
+  } catch (const exception& err) {
+    m_log.err("scheduler: Uncaught exception in task %lu (what: %s)", id, err.what());
+  }
+  guard.lock();
+
+  // The task may have removed itself
+  it = m_tasks.find(id);
+  if (it != m_tasks.end()) {
+    it->second.runner = std::thread::id{};
+
+    if (it->second.once) {
+      m_tasks.erase(it);
+    } else if (it->second.again) {
+      it->second.again = false;
+      enqueue(id, it->second);
+    } else {
+      schedule(id, it->second, clock::now());
+    }
+  }
+
+  m_done_cond.notify_all();
+}
+
+/**
+ * Hand the task to the workers
+ *
+ * Expects m_lock to be held
+ */
+void scheduler::enqueue(task_id id, task& t) {
+  t.status = state::QUEUED;
+  t.deadline = clock::time_point{};
+  m_pool.submit([this, id] { run(id); }, t.latency);
+}
+
+/**
+ * Calculate the next deadline of the task
+ *
+ * Expects m_lock to be held
+ */
+void scheduler::schedule(task_id id, task& t, clock::time_point now) {
+  t.status = state::IDLE;
+
+  if ((t.paused || (m_suspended && (t.flags & SUSPENDABLE))) && !t.once) {
+    t.deadline = clock::time_point::max();
+    t.parked = true;
+    return;
+  }
+
+  t.deadline = now + t.offset;
+
+  auto interval = t.interval;
+  if (t.flags & STRETCHABLE) {
+    interval = chrono::duration_cast<duration>(interval * m_factor);
+  }
+
+  if (interval > duration::zero()) {
+    t.deadline += interval - (now.time_since_epoch() % interval);
+  }
+
+  m_deadlines.push(entry{t.deadline, t.deadline + t.slack, id});
+  m_timer_cond.notify_one();
+}
+
+POLYBAR_NS_END
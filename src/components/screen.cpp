@@ -89,37 +89,34 @@ screen::~screen() {
 /**
  * Handle XCB_RANDR_SCREEN_CHANGE_NOTIFY events
  *
- * If any of the monitors have changed we raise USR1 to trigger a reload
+ * If the screen size or any of the monitors have changed, the bar is told
+ * about the new monitors. It decides whether it can follow the change in place
+ * or has to be reloaded.
  */
 void screen::handle(const evt::randr_screen_change_notify& evt) {
-  if (m_sigraised || evt->request_window != m_proxy) {
+  if (evt->request_window != m_proxy) {
     return;
   }
 
   auto screen = m_connection.screen(true);
-  auto changed = false;
+  bool resized{screen->width_in_pixels != m_size.w || screen->height_in_pixels != m_size.h};
+  m_size = {screen->width_in_pixels, screen->height_in_pixels};
 
-  // We need to reload if the screen size changed as well
-  if (screen->width_in_pixels != m_size.w || screen->height_in_pixels != m_size.h) {
-    changed = true;
-  } else {
-    changed = have_monitors_changed();
-  }
-
-  if (changed) {
-    m_log.notice("randr_screen_change_notify (%ux%u)... reloading", evt->width, evt->height);
-    m_sig.emit(exit_reload{});
-    m_sigraised = true;
+  // The monitor list is always updated, so that it is in sync with the new screen size
+  if (update_monitors() || resized) {
+    m_log.notice("randr_screen_change_notify (%ux%u)... monitors changed", evt->width, evt->height);
+    m_sig.emit(signals::ui::monitors_changed{});
   }
 }
 
 /**
- * Checks if the stored monitor list is different from a newly fetched one
+ * Fetch the monitor list and replace the stored one
  *
- * Fetches the monitor list and compares it with the one stored
+ * \returns true if the new list is different from the stored one
  */
-bool screen::have_monitors_changed() const {
+bool screen::update_monitors() {
   auto monitors = randr_util::get_monitors(m_connection, m_root, true, false);
+  std::swap(monitors, m_monitors);
 
   if(monitors.size() != m_monitors.size()) {
     return true;
@@ -132,9 +129,9 @@ bool screen::have_monitors_changed() const {
         });
 
     /*
-     * Every monitor in the stored list should also exist in the newly fetched
-     * list. If this holds then the two lists are equivalent since they have
-     * the same size
+     * Every monitor in the new list should also exist in the previous list.
+     * If this holds then the two lists are equivalent since they have the same
+     * size
      */
     if(it == monitors.end()) {
       return true;
@@ -0,0 +1,456 @@
+#include "components/script_runner.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <csignal>
+#include <random>
+
+#include "components/config.hpp"
+#include "components/logger.hpp"
+#include "components/thread_policy.hpp"
+#include "errors.hpp"
+#include "utils/factory.hpp"
+#include "utils/process.hpp"
+
+POLYBAR_NS
+
+constexpr chrono::milliseconds script_runner::KILL_TIMEOUT;
+
+namespace {
+  int pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+
+  /**
+   * Random phase of up to a tenth of the interval, but at most a second
+   */
+  script_runner::duration random_phase(script_runner::duration interval) {
+    static std::mt19937 generator{std::random_device{}()};
+    auto limit = std::min<script_runner::duration>(interval / 10, chrono::seconds(1));
+    if (limit <= script_runner::duration::zero()) {
+      return script_runner::duration::zero();
+    }
+    std::uniform_int_distribution<script_runner::duration::rep> distribution(0, limit.count());
+    return script_runner::duration(distribution(generator));
+  }
+}  // namespace
+
+/**
+ * Create instance
+ */
+script_runner::make_type script_runner::make() {
+  size_t max_concurrent{config::make().get("settings", "max-concurrent-scripts", 4U)};
+  return static_cast<script_runner&>(*factory_util::singleton<script_runner>(logger::make(), max_concurrent));
+}
+
+/**
+ * Construct runner and start its thread
+ */
+script_runner::script_runner(const logger& logger, size_t max_concurrent)
+    : m_log(logger), m_max_concurrent(std::max<size_t>(max_concurrent, 1)) {
+  if ((m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+    throw system_error("Failed to create eventfd for the script runner");
+  }
+  m_thread = thread_policy::spawn(thread_policy::role::WORKER, [this] { loop(); });
+}
+
+/**
+ * Deconstruct runner, running commands are terminated
+ */
+script_runner::~script_runner() {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_active = false;
+  }
+  notify();
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+
+  for (auto&& p : m_scripts) {
+    if (p.second.running) {
+      terminate(*p.second.running);
+    }
+  }
+
+  while (!m_terminated.empty()) {
+    reap();
+    std::this_thread::sleep_for(chrono::milliseconds(10));
+  }
+
+  close(m_wakeup);
+}
+
+/**
+ * Add a script, its first run happens right away
+ *
+ * `condition` is run before every run of the command unless it is empty, the
+ * command only runs if it exits with 0. Its result is reused for
+ * `condition_interval` before the condition is run again.
+ */
+script_runner::script_id script_runner::add(
+    string condition, command_fn command, callback done, duration interval, duration condition_interval) {
+  script_id id;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    id = m_next_id++;
+    auto& s = m_scripts[id];
+    s.condition = move(condition);
+    s.condition_interval = condition_interval;
+    s.command = move(command);
+    s.done = move(done);
+    s.phase = random_phase(interval);
+    s.deadline = clock::now();
+  }
+  notify();
+  return id;
+}
+
+/**
+ * Remove a script and terminate its running command
+ *
+ * If the callback of the script is running, this blocks until it returns,
+ * unless it is called from within that callback.
+ */
+void script_runner::remove(script_id id) {
+  std::unique_lock<std::mutex> guard(m_lock);
+  auto it = m_scripts.find(id);
+  if (it == m_scripts.end()) {
+    return;
+  }
+
+  if (std::this_thread::get_id() != m_thread.get_id()) {
+    m_done.wait(guard, [&] {
+      it = m_scripts.find(id);
+      return it == m_scripts.end() || !it->second.in_callback;
+    });
+    if (it == m_scripts.end()) {
+      return;
+    }
+  }
+
+  if (it->second.running) {
+    m_log.trace("script_runner: Terminating running command (%d)", it->second.running->pid);
+    terminate(*it->second.running);
+    m_running--;
+  }
+
+  m_scripts.erase(it);
+  guard.unlock();
+  notify();
+}
+
+/**
+ * Run the script right away instead of waiting for its next run
+ */
+void script_runner::trigger(script_id id) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_scripts.find(id);
+    if (it == m_scripts.end()) {
+      return;
+    }
+    it->second.deadline = clock::now();
+  }
+  notify();
+}
+
+/**
+ * Send SIGTERM to the process group of the run
+ *
+ * The process is reaped by `reap()`, so that nothing waits for it with the
+ * lock held.
+ */
+void script_runner::terminate(run& r) {
+  if (!r.exited && r.pid > 0) {
+    killpg(r.pid, SIGTERM);
+    m_terminated.push_back({r.pid, clock::now() + KILL_TIMEOUT});
+    r.exited = true;
+  }
+  if (r.output != -1) {
+    close(r.output);
+    r.output = -1;
+  }
+  if (r.pidfd != -1) {
+    close(r.pidfd);
+    r.pidfd = -1;
+  }
+}
+
+/**
+ * Reap terminated processes that exited, SIGKILL those that outlived
+ * `KILL_TIMEOUT`
+ */
+void script_runner::reap() {
+  auto now = clock::now();
+  m_terminated.erase(std::remove_if(m_terminated.begin(), m_terminated.end(),
+                         [&](terminated& t) {
+                           int status{0};
+                           if (process_util::wait_for_completion_nohang(t.pid, &status) == t.pid) {
+                             return true;
+                           }
+                           if (!t.killed && now >= t.kill_at) {
+                             m_log.warn("script_runner: Command ignored SIGTERM, killing it (%d)", t.pid);
+                             killpg(t.pid, SIGKILL);
+                             t.killed = true;
+                           }
+                           return false;
+                         }),
+      m_terminated.end());
+}
+
+void script_runner::notify() {
+  uint64_t one{1};
+  if (write(m_wakeup, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+    m_log.err("script_runner: Failed to wake up (err: %s)", strerror(errno));
+  }
+}
+
+void script_runner::loop() {
+  std::unique_lock<std::mutex> guard(m_lock);
+
+  while (m_active) {
+    auto now = clock::now();
+
+    // Start due scripts in the order they became due
+    vector<pair<clock::time_point, script_id>> due;
+    for (auto&& p : m_scripts) {
+      if (!p.second.running && !p.second.in_callback && p.second.deadline <= now) {
+        due.emplace_back(p.second.deadline, p.first);
+      }
+    }
+    std::sort(due.begin(), due.end());
+    for (auto&& d : due) {
+      if (m_running >= m_max_concurrent) {
+        break;
+      }
+      auto& s = m_scripts[d.second];
+      start(s, !s.condition.empty());
+    }
+
+    vector<struct pollfd> fds{{m_wakeup, POLLIN, 0}};
+    int timeout{-1};
+    const auto wake_within = [&](clock::duration within) {
+      // Rounded up, so that the script is due once poll() returns
+      auto ms = std::max<long long>(chrono::duration_cast<chrono::milliseconds>(within).count() + 1, 0);
+      timeout = static_cast<int>(timeout == -1 ? ms : std::min<long long>(timeout, ms));
+    };
+
+    if (!m_terminated.empty()) {
+      wake_within(chrono::milliseconds(50));
+    }
+
+    for (auto&& p : m_scripts) {
+      auto& s = p.second;
+      if (s.running) {
+        if (s.running->output != -1) {
+          fds.push_back({s.running->output, POLLIN, 0});
+        }
+        if (s.running->pidfd != -1) {
+          fds.push_back({s.running->pidfd, POLLIN, 0});
+        } else {
+          wake_within(chrono::milliseconds(50));
+        }
+      } else if (!s.in_callback && m_running < m_max_concurrent) {
+        wake_within(s.deadline - now);
+      }
+    }
+
+    guard.unlock();
+    if (::poll(fds.data(), fds.size(), timeout) == -1 && errno != EINTR) {
+      m_log.err("script_runner: Failed to poll (err: %s)", strerror(errno));
+    }
+    uint64_t count;
+    while (read(m_wakeup, &count, sizeof(count)) > 0) {
+    }
+    guard.lock();
+
+    reap();
+
+    vector<script_id> exited;
+    for (auto&& p : m_scripts) {
+      if (p.second.running && collect(*p.second.running)) {
+        exited.emplace_back(p.first);
+      }
+    }
+
+    for (auto id : exited) {
+      finish(id, guard);
+    }
+  }
+}
+
+/**
+ * Start the condition or the command of the script
+ *
+ * Called with the lock held
+ */
+void script_runner::start(script& s, bool condition) {
+  auto r = make_unique<run>();
+  r->condition = condition;
+
+  bool memoized{condition && clock::now() < s.condition_until};
+  if (memoized && s.condition_met) {
+    return start(s, false);
+  }
+
+  try {
+    if (memoized) {
+      // Reported like a failed run of the condition, without running it
+      r->exited = true;
+      r->status = 1;
+    } else if (condition) {
+      r->pid = process_util::spawn_sh(s.condition);
+    } else {
+      string cmd{s.command()};
+      m_log.info("script_runner: Invoking shell command: \"%s\"", cmd);
+
+      int fds[2];
+      if (pipe2(fds, O_CLOEXEC) == -1) {
+        throw system_error("Failed to allocate output stream");
+      }
+      fcntl(fds[PIPE_READ], F_SETFL, O_NONBLOCK);
+
+      try {
+        r->pid = process_util::spawn_sh(cmd, -1, fds[PIPE_WRITE], fds[PIPE_WRITE], false);
+      } catch (...) {
+        close(fds[PIPE_READ]);
+        close(fds[PIPE_WRITE]);
+        throw;
+      }
+
+      close(fds[PIPE_WRITE]);
+      r->output = fds[PIPE_READ];
+    }
+  } catch (const exception& err) {
+    m_log.err("script_runner: %s", err.what());
+    // Reported like a command that failed, the script tries again after its interval
+    r->exited = true;
+    r->status = 127;
+  }
+
+  if (!r->exited) {
+    r->pidfd = pidfd_open(r->pid);
+  }
+
+  if (!s.running) {
+    m_running++;
+  }
+  s.running = move(r);
+}
+
+/**
+ * Read the output of a run and check whether the process exited
+ *
+ * \returns true if the process exited
+ */
+bool script_runner::collect(run& r) {
+  const auto drain = [&] {
+    char buffer[BUFSIZ];
+    while (r.output != -1) {
+      ssize_t bytes = read(r.output, buffer, sizeof(buffer));
+      if (bytes > 0) {
+        r.buffer.append(buffer, bytes);
+      } else if (bytes == -1 && errno == EINTR) {
+        continue;
+      } else {
+        if (bytes == 0 || errno != EAGAIN) {
+          close(r.output);
+          r.output = -1;
+        }
+        return;
+      }
+    }
+  };
+
+  drain();
+
+  if (!r.exited) {
+    int status{0};
+    if (process_util::wait_for_completion_nohang(r.pid, &status) == r.pid &&
+        (WIFEXITED(status) || WIFSIGNALED(status))) {
+      r.exited = true;
+      r.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+  }
+
+  if (r.exited) {
+    // Whatever was written before the exit is in the pipe now, processes started in the background may keep it open
+    drain();
+    if (r.output != -1) {
+      close(r.output);
+      r.output = -1;
+    }
+    if (r.pidfd != -1) {
+      close(r.pidfd);
+      r.pidfd = -1;
+    }
+  }
+
+  return r.exited;
+}
+
+/**
+ * Continue with the command if the condition succeeded, otherwise pass the
+ * result to the callback and schedule the next run
+ */
+void script_runner::finish(script_id id, std::unique_lock<std::mutex>& guard) {
+  auto it = m_scripts.find(id);
+  if (it == m_scripts.end() || !it->second.running) {
+    return;
+  }
+
+  auto& s = it->second;
+  auto r = move(s.running);
+
+  if (r->condition && r->pid > 0) {
+    s.condition_met = r->status == 0;
+    s.condition_until = clock::now() + s.condition_interval;
+  }
+
+  if (r->condition && r->status == 0) {
+    start(s, false);
+    return;
+  }
+
+  m_running--;
+
+  result res;
+  res.ran = !r->condition;
+  res.status = r->status;
+  res.output = move(r->buffer);
+
+  auto done = s.done;
+  s.in_callback = true;
+  guard.unlock();
+
+  duration delay{chrono::seconds(1)};
+  try {
+    delay = done(res);
+  } catch (const exception& err) {
+    m_log.err("script_runner: %s", err.what());
+  }
+
+  guard.lock();
+  it = m_scripts.find(id);
+  if (it != m_scripts.end()) {
+    it->second.in_callback = false;
+    it->second.deadline = clock::now() + delay + it->second.phase;
+  }
+  m_done.notify_all();
+}
+
+POLYBAR_NS_END
@@ -0,0 +1,142 @@
+#include "components/spawner.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+
+#include "errors.hpp"
+#include "utils/factory.hpp"
+#include "utils/process.hpp"
+
+POLYBAR_NS
+
+/**
+ * Create instance
+ */
+spawner::make_type spawner::make() {
+  return static_cast<spawner&>(*factory_util::singleton<spawner>());
+}
+
+spawner::~spawner() {
+  stop();
+}
+
+/**
+ * Fork the helper process
+ *
+ * Has to be called before any thread is started and before any file
+ * descriptor is opened that commands shouldn't inherit.
+ *
+ * \returns false if the helper couldn't be started
+ */
+bool spawner::start() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_pid != -1) {
+    return true;
+  }
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == -1) {
+    return false;
+  }
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    int err{errno};
+    close(fds[0]);
+    close(fds[1]);
+    errno = err;
+    return false;
+  } else if (pid == 0) {
+    close(fds[0]);
+    serve(fds[1]);
+  }
+
+  close(fds[1]);
+  m_socket = fds[0];
+  m_pid = pid;
+  return true;
+}
+
+/**
+ * Stop the helper and wait for it to exit, commands that were already
+ * started keep running
+ */
+void spawner::stop() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_socket != -1) {
+    close(m_socket);
+    m_socket = -1;
+  }
+  if (m_pid != -1) {
+    process_util::wait(m_pid);
+    m_pid = -1;
+  }
+}
+
+bool spawner::running() const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_socket != -1;
+}
+
+/**
+ * Run the given command detached through the shell
+ */
+void spawner::spawn(const string& cmd) {
+  if (cmd.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_socket != -1) {
+      if (send(m_socket, cmd.c_str(), cmd.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(cmd.size())) {
+        return;
+      }
+
+      // The helper is gone, it is collected by stop()
+      close(m_socket);
+      m_socket = -1;
+    }
+  }
+
+  process_util::spawn_detached(cmd);
+}
+
+/**
+ * Main loop of the helper, runs every command that is received until the
+ * socket is closed
+ */
+void spawner::serve(int fd) {
+  while (true) {
+    // Returns the size of the next packet, whatever the size of the buffer
+    ssize_t size = recv(fd, nullptr, 0, MSG_PEEK | MSG_TRUNC);
+    if (size == -1 && errno == EINTR) {
+      continue;
+    } else if (size <= 0) {
+      _Exit(0);
+    }
+
+    string cmd(size, '\0');
+    if (recv(fd, &cmd[0], cmd.size(), 0) != size) {
+      _Exit(1);
+    }
+
+    try {
+      process_util::fork_detached([&cmd] {
+        try {
+          process_util::exec_sh(cmd.c_str());
+        } catch (...) {
+        }
+        // Never return into this loop from the command's process
+        _Exit(127);
+      });
+    } catch (const exception& err) {
+      fprintf(stderr, "Failed to run command \"%s\" (reason: %s)\n", cmd.c_str(), err.what());
+    }
+  }
+}
+
+POLYBAR_NS_END
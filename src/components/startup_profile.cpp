@@ -0,0 +1,190 @@
+#include "components/startup_profile.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#include "errors.hpp"
+#include "utils/concurrency.hpp"
+#include "utils/factory.hpp"
+#include "utils/file.hpp"
+
+POLYBAR_NS
+
+namespace {
+  double to_ms(startup_profile::clock::duration duration) {
+    return chrono::duration<double, std::milli>(duration).count();
+  }
+
+  long long to_us(startup_profile::clock::duration duration) {
+    return chrono::duration_cast<chrono::microseconds>(duration).count();
+  }
+
+  /**
+   * Quote a string for JSON
+   */
+  string quote(const string& value) {
+    string result{"\""};
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        result += '\\';
+        result += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        result += escaped;
+      } else {
+        result += c;
+      }
+    }
+    return result + "\"";
+  }
+}  // namespace
+
+/**
+ * Create instance
+ */
+startup_profile::make_type startup_profile::make() {
+  return static_cast<startup_profile&>(*factory_util::singleton<startup_profile>());
+}
+
+startup_profile::phase::phase(string name)
+    : m_name(move(name)), m_start(clock::now()), m_enabled(startup_profile::make().enabled()) {}
+
+startup_profile::phase::~phase() {
+  if (m_enabled) {
+    startup_profile::make().record(move(m_name), m_start, clock::now());
+  }
+}
+
+startup_profile::startup_profile() : m_origin(clock::now()) {}
+
+/**
+ * Start recording, the trace is written to `trace_path` unless it is empty
+ */
+void startup_profile::enable(string trace_path) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_trace_path = move(trace_path);
+  m_enabled = true;
+}
+
+bool startup_profile::enabled() const {
+  return m_enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Add a phase that ran from `start` to `end`
+ */
+void startup_profile::record(string name, clock::time_point start, clock::time_point end) {
+  if (!enabled()) {
+    return;
+  }
+
+  auto thread = concurrency_util::thread_id(this_thread::get_id());
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_events.emplace_back(event{move(name), start - m_origin, end - start, thread, false});
+}
+
+/**
+ * Add an event without duration at the current time
+ */
+void startup_profile::mark(string name) {
+  if (!enabled()) {
+    return;
+  }
+
+  auto now = clock::now();
+  auto thread = concurrency_util::thread_id(this_thread::get_id());
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_events.emplace_back(event{move(name), now - m_origin, clock::duration::zero(), thread, true});
+}
+
+/**
+ * Stop recording, print the timeline and write the trace
+ *
+ * Only the first call has an effect
+ */
+void startup_profile::finish() {
+  if (!m_enabled.exchange(false)) {
+    return;
+  }
+
+  fprintf(stderr, "Startup profile (start and duration in ms):\n");
+  for (const auto& line : report()) {
+    fprintf(stderr, "  %s\n", line.c_str());
+  }
+
+  string path;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    path = m_trace_path;
+  }
+
+  if (!path.empty()) {
+    try {
+      file_util::write_contents(path, trace());
+      fprintf(stderr, "Startup trace written to %s\n", path.c_str());
+    } catch (const exception& err) {
+      fprintf(stderr, "Failed to write startup trace (reason: %s)\n", err.what());
+    }
+  }
+}
+
+/**
+ * One line per event ordered by start time
+ */
+vector<string> startup_profile::report() const {
+  vector<event> events;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    events = m_events;
+  }
+
+  std::stable_sort(
+      events.begin(), events.end(), [](const event& a, const event& b) { return a.start < b.start; });
+
+  vector<string> lines;
+  for (const auto& e : events) {
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1) << std::setw(8) << to_ms(e.start);
+    if (e.instant) {
+      line << std::setw(11) << "";
+    } else {
+      line << " +" << std::setw(8) << to_ms(e.duration);
+    }
+    line << "  [" << e.thread << "] " << e.name;
+    lines.emplace_back(line.str());
+  }
+
+  return lines;
+}
+
+/**
+ * All events in the Chrome trace event format
+ */
+string startup_profile::trace() const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  std::ostringstream out;
+  auto pid = getpid();
+
+  out << "{\"traceEvents\":[";
+  for (size_t i = 0; i < m_events.size(); i++) {
+    const auto& e = m_events[i];
+    out << (i == 0 ? "\n" : ",\n");
+    out << "{\"name\":" << quote(e.name) << ",\"cat\":\"startup\",\"pid\":" << pid << ",\"tid\":" << e.thread;
+    out << ",\"ts\":" << to_us(e.start);
+    if (e.instant) {
+      out << ",\"ph\":\"i\",\"s\":\"p\"}";
+    } else {
+      out << ",\"ph\":\"X\",\"dur\":" << to_us(e.duration) << "}";
+    }
+  }
+  out << "\n]}\n";
+
+  return out.str();
+}
+
+POLYBAR_NS_END
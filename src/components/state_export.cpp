@@ -0,0 +1,205 @@
+#include "components/state_export.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "errors.hpp"
+#include "utils/factory.hpp"
+#include "utils/string.hpp"
+
+POLYBAR_NS
+
+constexpr size_t state_export::HEADER_SIZE;
+constexpr size_t state_export::INITIAL_SIZE;
+std::atomic<bool> state_export::s_enabled{false};
+thread_local state_export::values* state_export::s_capture{nullptr};
+
+namespace {
+  constexpr char MAGIC[8]{'P', 'L', 'Y', 'S', 'T', 'A', 'T', 'E'};
+  constexpr uint32_t VERSION{1};
+  constexpr size_t SEQUENCE_OFFSET{16};
+  constexpr size_t LENGTH_OFFSET{24};
+}  // namespace
+
+/**
+ * Create instance
+ */
+state_export::make_type state_export::make() {
+  return static_cast<state_export&>(*factory_util::singleton<state_export>());
+}
+
+state_export::capture::capture() : m_active(state_export::enabled()) {
+  if (m_active) {
+    m_previous = s_capture;
+    s_capture = &m_values;
+  }
+}
+
+state_export::capture::~capture() {
+  take();
+}
+
+state_export::values state_export::capture::take() {
+  if (m_active) {
+    s_capture = m_previous;
+    m_active = false;
+  }
+  return move(m_values);
+}
+
+state_export::~state_export() {
+  close();
+}
+
+/**
+ * Create or truncate the file and start publishing to it
+ *
+ * \throws system_error if the file can't be created or mapped
+ */
+void state_export::open(const string& path) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd == -1) {
+    throw system_error("Failed to open state file " + path);
+  }
+  m_fd = fd;
+
+  try {
+    reserve(INITIAL_SIZE);
+  } catch (const system_error&) {
+    ::close(m_fd);
+    m_fd = -1;
+    throw;
+  }
+  std::memcpy(m_map, MAGIC, sizeof(MAGIC));
+  std::memcpy(m_map + sizeof(MAGIC), &VERSION, sizeof(VERSION));
+  write();
+
+  s_enabled = true;
+}
+
+void state_export::close() {
+  s_enabled = false;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_map != nullptr) {
+    munmap(m_map, m_size);
+    m_map = nullptr;
+    m_size = 0;
+  }
+  if (m_fd != -1) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+  m_modules.clear();
+}
+
+/**
+ * Replace the values of a module, the file is only written if they changed
+ */
+void state_export::update(const string& module, const std::map<string, string>& values) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_map == nullptr) {
+    return;
+  }
+
+  auto& current = m_modules[module];
+  if (current != values) {
+    current = values;
+    write();
+  }
+}
+
+/**
+ * Drop the values of a module that was stopped
+ */
+void state_export::remove(const string& module) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_map != nullptr && m_modules.erase(module) > 0) {
+    write();
+  }
+}
+
+/**
+ * Serialize all values and write them between two increments of the sequence
+ *
+ * Has to be called with m_lock held
+ */
+void state_export::write() {
+  m_json = "{";
+  bool first_module{true};
+  for (const auto& module : m_modules) {
+    m_json += first_module ? "" : ",";
+    first_module = false;
+    string_util::append_json(m_json, module.first);
+    m_json += ":{";
+
+    bool first_value{true};
+    for (const auto& value : module.second) {
+      m_json += first_value ? "" : ",";
+      first_value = false;
+      string_util::append_json(m_json, value.first);
+      m_json += ":";
+      string_util::append_json(m_json, value.second);
+    }
+    m_json += "}";
+  }
+  m_json += "}";
+
+  try {
+    reserve(HEADER_SIZE + m_json.size());
+  } catch (const system_error&) {
+    // The old values stay in place
+    return;
+  }
+
+  auto sequence = reinterpret_cast<uint64_t*>(m_map + SEQUENCE_OFFSET);
+  auto length = reinterpret_cast<uint64_t*>(m_map + LENGTH_OFFSET);
+
+  uint64_t seq = __atomic_load_n(sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(sequence, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  std::memcpy(m_map + HEADER_SIZE, m_json.data(), m_json.size());
+  __atomic_store_n(length, m_json.size(), __ATOMIC_RELAXED);
+
+  __atomic_store_n(sequence, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Grow the file and the mapping to hold at least size bytes
+ *
+ * Has to be called with m_lock held
+ */
+void state_export::reserve(size_t size) {
+  if (size <= m_size) {
+    return;
+  }
+
+  size_t new_size = std::max(m_size, INITIAL_SIZE);
+  while (new_size < size) {
+    new_size *= 2;
+  }
+
+  if (ftruncate(m_fd, new_size) == -1) {
+    throw system_error("Failed to grow state file");
+  }
+
+  void* map;
+  if (m_map == nullptr) {
+    map = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  } else {
+    map = mremap(m_map, m_size, new_size, MREMAP_MAYMOVE);
+  }
+  if (map == MAP_FAILED) {
+    throw system_error("Failed to map state file");
+  }
+
+  m_map = static_cast<char*>(map);
+  m_size = new_size;
+}
+
+POLYBAR_NS_END
@@ -0,0 +1,189 @@
+#include "components/stats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "utils/factory.hpp"
+
+POLYBAR_NS
+
+namespace {
+  double to_ms(histogram::clock::duration duration) {
+    return chrono::duration<double, std::milli>(duration).count();
+  }
+}  // namespace
+
+constexpr size_t histogram::WINDOW;
+
+/**
+ * Add a sample, replacing the oldest one once the window is full
+ */
+void histogram::record(clock::duration duration) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_samples[m_next] = duration;
+  m_next = (m_next + 1) % WINDOW;
+  m_total++;
+}
+
+/**
+ * Summarize the samples currently in the window
+ */
+histogram::summary histogram::summarize() const {
+  vector<clock::duration> samples;
+  summary result{};
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    result.total = m_total;
+    result.count = std::min(m_total, WINDOW);
+    samples.assign(m_samples.begin(), m_samples.begin() + result.count);
+  }
+
+  if (samples.empty()) {
+    return result;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  for (const auto& sample : samples) {
+    result.sum += to_ms(sample);
+  }
+
+  result.avg = result.sum / samples.size();
+  result.p50 = to_ms(samples[(samples.size() - 1) * 50 / 100]);
+  result.p95 = to_ms(samples[(samples.size() - 1) * 95 / 100]);
+  result.max = to_ms(samples.back());
+
+  return result;
+}
+
+/**
+ * Drop all samples
+ */
+void histogram::reset() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_next = 0;
+  m_total = 0;
+}
+
+void hit_counter::hit() {
+  m_hits.fetch_add(1, std::memory_order_relaxed);
+}
+
+void hit_counter::miss() {
+  m_misses.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t hit_counter::hits() const {
+  return m_hits;
+}
+
+size_t hit_counter::misses() const {
+  return m_misses;
+}
+
+/**
+ * Fraction of lookups that were hits, 0 if there were none
+ */
+double hit_counter::rate() const {
+  size_t hits = m_hits;
+  size_t total = hits + m_misses;
+  return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+}
+
+void hit_counter::reset() {
+  m_hits = 0;
+  m_misses = 0;
+}
+
+/**
+ * Create instance
+ */
+stats::make_type stats::make() {
+  return static_cast<stats&>(*factory_util::singleton<stats>());
+}
+
+/**
+ * Get the histogram with the given name, creating it if necessary
+ */
+histogram& stats::get(const string& name) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto& entry = m_histograms[name];
+  if (!entry) {
+    entry = make_unique<histogram>();
+  }
+  return *entry;
+}
+
+/**
+ * Get the hit counter with the given name, creating it if necessary
+ */
+hit_counter& stats::counter(const string& name) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto& entry = m_counters[name];
+  if (!entry) {
+    entry = make_unique<hit_counter>();
+  }
+  return *entry;
+}
+
+/**
+ * Produce one line per histogram that has samples, followed by one line per
+ * counter that was used, each ordered by name
+ */
+vector<string> stats::report() const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  vector<string> lines;
+
+  for (const auto& entry : m_histograms) {
+    auto summary = entry.second->summarize();
+
+    if (summary.count == 0) {
+      continue;
+    }
+
+    std::ostringstream line;
+    line << std::left << std::setw(32) << entry.first << std::right << std::fixed << std::setprecision(3);
+    line << " n=" << summary.count << "/" << summary.total;
+    line << " sum=" << summary.sum << "ms";
+    line << " avg=" << summary.avg << "ms";
+    line << " p50=" << summary.p50 << "ms";
+    line << " p95=" << summary.p95 << "ms";
+    line << " max=" << summary.max << "ms";
+    lines.emplace_back(line.str());
+  }
+
+  for (const auto& entry : m_counters) {
+    size_t hits = entry.second->hits();
+    size_t misses = entry.second->misses();
+
+    if (hits + misses == 0) {
+      continue;
+    }
+
+    std::ostringstream line;
+    line << std::left << std::setw(32) << entry.first << std::right << std::fixed << std::setprecision(1);
+    line << " hits=" << hits;
+    line << " misses=" << misses;
+    line << " rate=" << entry.second->rate() * 100.0 << "%";
+    lines.emplace_back(line.str());
+  }
+
+  return lines;
+}
+
+/**
+ * Drop the samples of all histograms and zero all counters
+ */
+void stats::reset() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  for (auto&& entry : m_histograms) {
+    entry.second->reset();
+  }
+  for (auto&& entry : m_counters) {
+    entry.second->reset();
+  }
+}
+
+POLYBAR_NS_END
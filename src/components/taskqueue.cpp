@@ -1,6 +1,6 @@
-#include <algorithm>
-
 #include "components/taskqueue.hpp"
+
+#include "components/thread_policy.hpp"
 #include "utils/factory.hpp"
 
 POLYBAR_NS
@@ -10,36 +10,36 @@ taskqueue::make_type taskqueue::make() {
 }
 
 taskqueue::taskqueue() {
-  m_thread = std::thread([&] {
+  // Deferred tasks handle clicks
+  m_thread = thread_policy::spawn(thread_policy::role::UI, [&] {
     while (m_active) {
       std::unique_lock<std::mutex> guard(m_lock);
 
-      if (m_deferred.empty()) {
+      if (!m_active) {
+        break;
+      } else if (m_deferred.empty()) {
         m_hold.wait(guard);
       } else {
         auto now = deferred::clock::now();
-        auto wait = m_deferred.front()->now + m_deferred.front()->wait;
-        for (auto&& task : m_deferred) {
-          auto when = task->now + task->wait;
-          if (when < wait) {
-            wait = move(when);
-          }
-        }
+        auto wait = m_deferred.begin()->first;
         if (wait > now) {
           m_hold.wait_for(guard, wait - now);
         }
       }
-      if (!m_deferred.empty()) {
-        guard.unlock();
-        tick();
-      }
+
+      guard.unlock();
+      tick();
     }
   });
 }
 
 taskqueue::~taskqueue() {
   if (m_active && m_thread.joinable()) {
-    m_active = false;
+    {
+      // Taken so that the notification can't get lost before the thread waits
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_active = false;
+    }
     m_hold.notify_all();
     m_thread.join();
   }
@@ -49,62 +49,110 @@ void taskqueue::defer(
     string id, deferred::duration ms, deferred::callback fn, deferred::duration offset, size_t count) {
   std::unique_lock<std::mutex> guard(m_lock);
   deferred::timepoint now{chrono::time_point_cast<deferred::duration>(deferred::clock::now() + move(offset))};
-  m_deferred.emplace_back(make_unique<deferred>(move(id), move(now), move(ms), move(fn), move(count)));
+  insert(make_unique<deferred>(move(id), move(now), move(ms), move(fn), move(count)));
   guard.unlock();
   m_hold.notify_one();
 }
 
 void taskqueue::defer_unique(
     string id, deferred::duration ms, deferred::callback fn, deferred::duration offset, size_t count) {
-  purge(id);
   std::unique_lock<std::mutex> guard(m_lock);
+  remove(id);
   deferred::timepoint now{chrono::time_point_cast<deferred::duration>(deferred::clock::now() + move(offset))};
-  m_deferred.emplace_back(make_unique<deferred>(move(id), move(now), move(ms), move(fn), move(count)));
+  insert(make_unique<deferred>(move(id), move(now), move(ms), move(fn), move(count)));
   guard.unlock();
   m_hold.notify_one();
 }
 
+/**
+ * Run the callbacks of all tasks that are due
+ *
+ * Once a task has used up its count, it is dropped the next time it is due.
+ * The callbacks are called without holding the lock, so they can defer new
+ * tasks.
+ */
 void taskqueue::tick() {
-  if (!m_lock.try_lock()) {
-    return;
-  }
-  std::unique_lock<std::mutex> guard(m_lock, std::adopt_lock);
+  std::unique_lock<std::mutex> guard(m_lock);
   auto now = chrono::time_point_cast<deferred::duration>(deferred::clock::now());
   vector<pair<deferred::callback, size_t>> cbs;
-  for (auto it = m_deferred.rbegin(); it != m_deferred.rend(); ++it) {
-    auto& task = *it;
-    if (task->now + task->wait > now) {
-      continue;
-    } else if (task->count--) {
+  vector<unique_ptr<deferred>> repeat;
+
+  while (!m_deferred.empty() && m_deferred.begin()->first <= now) {
+    auto task = take(m_deferred.begin());
+    if (task->count--) {
       cbs.emplace_back(make_pair(task->func, task->count));
       task->now = now;
-    } else {
-      m_deferred.erase(std::remove_if(m_deferred.begin(), m_deferred.end(),
-                           [&](const unique_ptr<deferred>& d) { return d == task; }),
-          m_deferred.end());
+      repeat.emplace_back(move(task));
     }
   }
+
+  // Requeued after the loop, a wait of 0 would otherwise be due again right away
+  for (auto&& task : repeat) {
+    insert(move(task));
+  }
+
   guard.unlock();
   for (auto&& p : cbs) {
     p.first(p.second);
   }
 }
 
+/**
+ * Remove all tasks with the given id
+ *
+ * \returns true if there were any
+ */
 bool taskqueue::purge(const string& id) {
   std::lock_guard<std::mutex> guard(m_lock);
-  return m_deferred.erase(std::remove_if(m_deferred.begin(), m_deferred.end(),
-                              [id](const unique_ptr<deferred>& d) { return d->id == id; }),
-             m_deferred.end()) == m_deferred.end();
+  return remove(id);
 }
 
 bool taskqueue::exist(const string& id) {
   std::lock_guard<std::mutex> guard(m_lock);
-  for (const auto& task : m_deferred) {
-    if (task->id == id) {
-      return true;
+  return m_index.find(id) != m_index.end();
+}
+
+/**
+ * Queue a task by its next deadline, m_lock has to be held
+ */
+void taskqueue::insert(unique_ptr<deferred>&& task) {
+  auto deadline = task->now + task->wait;
+  string id{task->id};
+  auto it = m_deferred.emplace(deadline, move(task));
+  m_index.emplace(move(id), it);
+}
+
+/**
+ * Take a task out of the queue and the index, m_lock has to be held
+ */
+unique_ptr<taskqueue::deferred> taskqueue::take(queue::iterator it) {
+  auto range = m_index.equal_range(it->second->id);
+  for (auto entry = range.first; entry != range.second; ++entry) {
+    if (entry->second == it) {
+      m_index.erase(entry);
+      break;
     }
   }
-  return false;
+
+  auto task = move(it->second);
+  m_deferred.erase(it);
+  return task;
+}
+
+/**
+ * Drop all tasks with the given id, m_lock has to be held
+ */
+bool taskqueue::remove(const string& id) {
+  auto range = m_index.equal_range(id);
+  if (range.first == range.second) {
+    return false;
+  }
+
+  for (auto entry = range.first; entry != range.second; ++entry) {
+    m_deferred.erase(entry->second);
+  }
+  m_index.erase(range.first, range.second);
+  return true;
 }
 
 POLYBAR_NS_END
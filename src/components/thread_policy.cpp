@@ -0,0 +1,208 @@
+#include "components/thread_policy.hpp"
+
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "components/config.hpp"
+#include "components/logger.hpp"
+#include "utils/factory.hpp"
+#include "utils/string.hpp"
+
+POLYBAR_NS
+
+namespace {
+  pid_t current_tid() {
+    return static_cast<pid_t>(syscall(SYS_gettid));
+  }
+
+  /**
+   * Whole string as a number, throws value_error otherwise
+   */
+  int parse_int(const string& value, const string& what) {
+    char* end{nullptr};
+    errno = 0;
+    long result = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno != 0 || result < INT32_MIN || result > INT32_MAX) {
+      throw value_error("Invalid " + what + " '" + value + "'");
+    }
+    return static_cast<int>(result);
+  }
+
+  /**
+   * Role of the thread, which it leaves when it exits
+   */
+  struct registration {
+    thread_policy* policy{nullptr};
+    thread_policy::role role{thread_policy::role::NORMAL};
+
+    ~registration() {
+      if (policy != nullptr) {
+        policy->leave();
+      }
+    }
+  };
+
+  thread_local registration t_registration;
+}  // namespace
+
+/**
+ * Create instance
+ */
+thread_policy::make_type thread_policy::make() {
+  return static_cast<thread_policy&>(*factory_util::singleton<thread_policy>(logger::make()));
+}
+
+thread_policy::thread_policy(const logger& logger) : m_log(logger) {}
+
+/**
+ * A nice value from -20 to 19 or `idle`
+ */
+thread_policy::priority thread_policy::parse_priority(const string& value) {
+  if (value == "idle") {
+    return priority{true, 0};
+  }
+
+  int nice = parse_int(value, "priority");
+  if (nice < -20 || nice > 19) {
+    throw value_error("Priority " + value + " is not a nice value between -20 and 19");
+  }
+  return priority{false, nice};
+}
+
+/**
+ * Comma separated cpus and ranges of cpus, e.g. `0-3,6`
+ */
+vector<int> thread_policy::parse_cpus(const string& value) {
+  vector<int> cpus;
+
+  for (auto&& item : string_util::split(value, ',')) {
+    auto range = string_util::trim(string{item});
+    auto dash = range.find('-');
+    int first = parse_int(range.substr(0, dash), "cpu");
+    int last = dash == string::npos ? first : parse_int(range.substr(dash + 1), "cpu");
+
+    if (first < 0 || last < first || last >= CPU_SETSIZE) {
+      throw value_error("Invalid cpu range '" + range + "'");
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus.emplace_back(cpu);
+    }
+  }
+
+  if (cpus.empty()) {
+    throw value_error("No cpus in '" + value + "'");
+  }
+  return cpus;
+}
+
+/**
+ * Load the settings and apply them to the threads that already entered a role
+ */
+void thread_policy::configure(const config& conf) {
+  auto ui = conf.get("settings", "ui-priority", string{});
+  auto worker = conf.get("settings", "worker-priority", string{});
+  auto cpus = conf.get("settings", "cpu-affinity", string{});
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_configured = !ui.empty() || !worker.empty() || !cpus.empty();
+  if (!m_configured) {
+    return;
+  }
+
+  try {
+    m_ui = ui.empty() ? priority{} : parse_priority(ui);
+    m_worker = worker.empty() ? priority{} : parse_priority(worker);
+    m_cpus = cpus.empty() ? vector<int>{} : parse_cpus(cpus);
+  } catch (const value_error& err) {
+    m_configured = false;
+    throw value_error("settings: " + string{err.what()});
+  }
+
+  for (auto&& t : m_threads) {
+    apply(t.first, t.second);
+  }
+}
+
+/**
+ * Give the calling thread the priority and affinity of `r`
+ *
+ * The thread keeps its role until it exits or enters another one.
+ */
+void thread_policy::enter(role r) {
+  if (t_registration.policy == this && t_registration.role == r) {
+    return;
+  }
+
+  auto tid = current_tid();
+  t_registration.policy = this;
+  t_registration.role = r;
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_threads[tid] = r;
+  if (m_configured) {
+    apply(tid, r);
+  }
+}
+
+/**
+ * Role of the calling thread, NORMAL if it never entered one
+ */
+thread_policy::role thread_policy::current() const {
+  return t_registration.policy == this ? t_registration.role : role::NORMAL;
+}
+
+/**
+ * Forget the calling thread, called when it exits
+ */
+void thread_policy::leave() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_threads.erase(current_tid());
+}
+
+/**
+ * Set scheduling class, nice value and affinity of a thread
+ *
+ * Raising the priority of the UI threads needs CAP_SYS_NICE or a matching
+ * RLIMIT_NICE, failures are only logged.
+ *
+ * Expects m_lock to be held
+ */
+void thread_policy::apply(pid_t tid, role r) {
+  const priority normal{};
+  const auto& prio = r == role::UI ? m_ui : r == role::WORKER ? m_worker : normal;
+  const char* name = r == role::UI ? "ui" : r == role::WORKER ? "worker" : "normal";
+
+  sched_param param{};
+  if (sched_setscheduler(tid, prio.idle ? SCHED_IDLE : SCHED_OTHER, &param) == -1) {
+    m_log.warn("thread_policy: Failed to set scheduling class of %s thread %i (%s)", name, tid, strerror(errno));
+  } else if (!prio.idle && setpriority(PRIO_PROCESS, static_cast<id_t>(tid), prio.nice) == -1) {
+    m_log.warn("thread_policy: Failed to set nice value %i of %s thread %i (%s)", prio.nice, name, tid, strerror(errno));
+  }
+
+  if (!m_cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : m_cpus) {
+      CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(tid, sizeof(set), &set) == -1) {
+      m_log.warn("thread_policy: Failed to set cpu affinity of %s thread %i (%s)", name, tid, strerror(errno));
+    }
+  }
+}
+
+thread_policy::scoped_role::scoped_role(role r) : m_previous(thread_policy::make().current()) {
+  thread_policy::make().enter(r);
+}
+
+thread_policy::scoped_role::~scoped_role() {
+  thread_policy::make().enter(m_previous);
+}
+
+POLYBAR_NS_END
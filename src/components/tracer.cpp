@@ -0,0 +1,179 @@
+#include "components/tracer.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "errors.hpp"
+#include "utils/concurrency.hpp"
+#include "utils/env.hpp"
+#include "utils/factory.hpp"
+#include "utils/file.hpp"
+#include "utils/string.hpp"
+
+POLYBAR_NS
+
+constexpr size_t tracer::CAPACITY;
+std::atomic<bool> tracer::s_enabled{false};
+thread_local tracer::thread_slot tracer::t_slot;
+
+namespace {
+  // Spans that started before this were recorded before the last start()
+  std::atomic<tracer::clock::rep> g_since{0};
+}  // namespace
+
+/**
+ * Create instance
+ */
+tracer::make_type tracer::make() {
+  return static_cast<tracer&>(*factory_util::singleton<tracer>());
+}
+
+/**
+ * Start recording, spans recorded before are dropped
+ */
+void tracer::start() {
+  g_since = clock::now().time_since_epoch().count();
+  s_enabled = true;
+}
+
+void tracer::stop() {
+  s_enabled = false;
+}
+
+/**
+ * Stable copy of the given span name
+ */
+const char* tracer::intern(const string& name) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_names.emplace(name).first->c_str();
+}
+
+/**
+ * Add a span to the buffer of the calling thread
+ */
+void tracer::record(const char* name, clock::time_point start, clock::time_point end) {
+  auto& buf = local_buffer();
+  size_t index = buf.count.load(std::memory_order_relaxed);
+
+  auto& e = buf.entries[index % CAPACITY];
+  e.name.store(name, std::memory_order_relaxed);
+  e.start.store(start.time_since_epoch().count(), std::memory_order_relaxed);
+  e.duration.store((end - start).count(), std::memory_order_relaxed);
+
+  buf.count.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * All spans recorded since the last start() in the Chrome trace event format
+ *
+ * Spans that a thread overwrites while they are dumped may come out mixed
+ * up, the dump is only meant for looking at.
+ */
+string tracer::dump() const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  auto since = g_since.load();
+  auto pid = to_string(getpid());
+
+  string out{"{\"traceEvents\":["};
+  bool first{true};
+
+  for (const auto& buf : m_buffers) {
+    size_t count = buf->count.load(std::memory_order_acquire);
+    size_t begin = count > CAPACITY ? count - CAPACITY : 0;
+    auto tid = to_string(buf->thread);
+
+    for (size_t i = begin; i < count; i++) {
+      const auto& e = buf->entries[i % CAPACITY];
+      const char* name = e.name.load(std::memory_order_relaxed);
+      auto start = e.start.load(std::memory_order_relaxed);
+      auto duration = e.duration.load(std::memory_order_relaxed);
+
+      if (name == nullptr || start < since) {
+        continue;
+      }
+
+      out += first ? "\n" : ",\n";
+      first = false;
+
+      out += "{\"name\":";
+      string_util::append_json(out, name);
+      out += ",\"cat\":\"polybar\",\"ph\":\"X\",\"pid\":" + pid + ",\"tid\":" + tid;
+      out += ",\"ts\":" + to_string(chrono::duration_cast<chrono::microseconds>(clock::duration{start}).count());
+      out += ",\"dur\":" + to_string(chrono::duration_cast<chrono::microseconds>(clock::duration{duration}).count());
+      out += "}";
+    }
+  }
+
+  out += "\n]}\n";
+  return out;
+}
+
+/**
+ * Write dump() to a new file that only the user can read
+ *
+ * The file is created in $XDG_RUNTIME_DIR, or in /tmp if it isn't set, and
+ * never replaces an existing file.
+ *
+ * \returns the path of the file
+ * \throws system_error if the file can't be written
+ */
+string tracer::write() const {
+  string dir{env_util::get("XDG_RUNTIME_DIR", "/tmp")};
+  string prefix{dir + "/polybar-trace-" + to_string(getpid())};
+
+  for (size_t i = 0;; i++) {
+    string path{prefix + (i == 0 ? "" : "-" + to_string(i)) + ".json"};
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd == -1 && errno == EEXIST) {
+      continue;
+    } else if (fd == -1) {
+      throw system_error("Failed to create " + path);
+    }
+
+    file_descriptor out(fd);
+    string contents{dump()};
+    for (size_t written = 0; written < contents.size();) {
+      ssize_t bytes = ::write(fd, contents.data() + written, contents.size() - written);
+      if (bytes == -1 && errno != EINTR) {
+        throw system_error("Failed to write " + path);
+      }
+      written += std::max<ssize_t>(bytes, 0);
+    }
+    return path;
+  }
+}
+
+/**
+ * Buffer of the calling thread, registered on first use
+ */
+tracer::buffer& tracer::local_buffer() {
+  if (t_slot.buf == nullptr) {
+    auto buf = make_unique<buffer>();
+    buf->thread = concurrency_util::thread_id(this_thread::get_id());
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    t_slot.buf = buf.get();
+    m_buffers.emplace_back(move(buf));
+  }
+  return *t_slot.buf;
+}
+
+/**
+ * Unregister and free the buffer of a thread that exits
+ */
+void tracer::release(buffer* buf) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+                      [&](const unique_ptr<buffer>& b) { return b.get() == buf; }),
+      m_buffers.end());
+}
+
+tracer::thread_slot::~thread_slot() {
+  if (buf != nullptr) {
+    tracer::make().release(buf);
+  }
+}
+
+POLYBAR_NS_END
@@ -0,0 +1,162 @@
+#include "components/worker_pool.hpp"
+
+#include <algorithm>
+
+#include "components/logger.hpp"
+#include "components/thread_policy.hpp"
+#include "errors.hpp"
+
+POLYBAR_NS
+
+namespace {
+  /**
+   * Pool and queue index of the worker running on the current thread
+   */
+  thread_local const worker_pool* t_pool{nullptr};
+  thread_local size_t t_index{0};
+}  // namespace
+
+/**
+ * Construct pool and start its workers
+ */
+worker_pool::worker_pool(const logger& logger, size_t workers) : m_log(logger) {
+  for (size_t i = 0; i < std::max<size_t>(workers, 1); i++) {
+    m_workers.emplace_back(make_unique<worker>());
+  }
+
+  // Only start the threads once all queues exist, they steal from each other
+  for (size_t i = 0; i < m_workers.size(); i++) {
+    m_workers[i]->thread = thread_policy::spawn(thread_policy::role::NORMAL, [this, i] { run(i); });
+  }
+}
+
+/**
+ * Deconstruct pool
+ *
+ * Waits for running jobs to finish, queued jobs are dropped
+ */
+worker_pool::~worker_pool() {
+  {
+    std::lock_guard<std::mutex> guard(m_idle_lock);
+    m_active = false;
+  }
+  m_idle.notify_all();
+
+  for (auto&& w : m_workers) {
+    if (w->thread.joinable()) {
+      w->thread.join();
+    }
+  }
+}
+
+/**
+ * Queue a job
+ */
+void worker_pool::submit(job fn, histogram* latency) {
+  size_t index;
+  if (t_pool == this) {
+    index = t_index;
+  } else {
+    index = m_next++ % m_workers.size();
+  }
+
+  {
+    // Counted under the queue lock so that m_pending never exceeds the number of queued jobs
+    std::lock_guard<std::mutex> guard(m_workers[index]->lock);
+    m_workers[index]->tasks.emplace_back(task{move(fn), latency, histogram::clock::now()});
+    m_pending++;
+  }
+
+  // Taking the lock makes sure a worker that is about to sleep sees the new job
+  { std::lock_guard<std::mutex> guard(m_idle_lock); }
+  m_idle.notify_one();
+}
+
+/**
+ * Number of workers
+ */
+size_t worker_pool::size() const {
+  return m_workers.size();
+}
+
+/**
+ * Take the oldest job from the worker's own queue
+ */
+bool worker_pool::pop(size_t index, task& out) {
+  auto& w = *m_workers[index];
+  std::lock_guard<std::mutex> guard(w.lock);
+
+  if (w.tasks.empty()) {
+    return false;
+  }
+
+  out = move(w.tasks.front());
+  w.tasks.pop_front();
+  m_pending--;
+  return true;
+}
+
+/**
+ * Take the newest job from the queue of another worker
+ *
+ * Queues that are busy are skipped at first. If nothing was found they are
+ * waited for, otherwise a worker that was woken for a job in a busy queue
+ * would spin until the queue is free.
+ */
+bool worker_pool::steal(size_t index, task& out) {
+  for (bool wait : {false, true}) {
+    bool contended{false};
+
+    for (size_t i = 1; i < m_workers.size(); i++) {
+      auto& w = *m_workers[(index + i) % m_workers.size()];
+      std::unique_lock<std::mutex> guard(w.lock, std::defer_lock);
+
+      if (wait) {
+        guard.lock();
+      } else if (!guard.try_lock()) {
+        contended = true;
+        continue;
+      }
+
+      if (!w.tasks.empty()) {
+        out = move(w.tasks.back());
+        w.tasks.pop_back();
+        m_pending--;
+        return true;
+      }
+    }
+
+    if (!contended) {
+      break;
+    }
+  }
+
+  return false;
+}
+
+void worker_pool::run(size_t index) {
+  t_pool = this;
+  t_index = index;
+
+  while (m_active) {
+    task t;
+
+    if (pop(index, t) || steal(index, t)) {
+      if (t.latency != nullptr) {
+        t.latency->record(histogram::clock::now() - t.queued);
+      }
+
+      try {
+        t.fn();
+      } catch (const exception& err) {
+        m_log.err("worker_pool: Uncaught exception in job (what: %s)", err.what());
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> guard(m_idle_lock);
+    m_idle.wait(guard, [&] { return !m_active || m_pending > 0; });
+  }
+}
+
+POLYBAR_NS_END
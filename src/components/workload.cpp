@@ -0,0 +1,264 @@
+#include "components/workload.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "components/action_table.hpp"
+#include "errors.hpp"
+#include "utils/concurrency.hpp"
+#include "utils/factory.hpp"
+#include "utils/string.hpp"
+
+POLYBAR_NS
+
+std::atomic<bool> workload_recorder::s_enabled{false};
+
+namespace {
+  const char* const ALIGNMENTS[]{"left", "center", "right"};
+  const char* const ALIGNMENT_TAGS[]{"%{l}", "%{c}", "%{r}"};
+
+  /**
+   * Value at the given quantile of sorted values, by nearest rank
+   */
+  double quantile(const vector<double>& sorted, double q) {
+    if (sorted.empty()) {
+      return 0.0;
+    }
+    auto rank = static_cast<size_t>(std::ceil(q * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+  }
+}  // namespace
+
+/**
+ * Create instance
+ */
+workload_recorder::make_type workload_recorder::make() {
+  return static_cast<workload_recorder&>(*factory_util::singleton<workload_recorder>());
+}
+
+workload_recorder::~workload_recorder() {
+  close();
+}
+
+/**
+ * Start recording into the file, it is replaced if it exists
+ *
+ * \throws system_error if the file can't be created
+ */
+void workload_recorder::open(const string& path) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  FILE* file = fopen(path.c_str(), "we");
+  if (file == nullptr) {
+    throw system_error("Failed to open workload file " + path);
+  }
+
+  if (m_file != nullptr) {
+    fclose(m_file);
+  }
+  m_file = file;
+  m_start = clock::now();
+  s_enabled = true;
+}
+
+void workload_recorder::close() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  s_enabled = false;
+  if (m_file != nullptr) {
+    fclose(m_file);
+    m_file = nullptr;
+  }
+}
+
+/**
+ * Record the modules of an alignment block in the order they are shown
+ */
+void workload_recorder::layout(const string& align, const vector<string>& modules) {
+  write("layout", align + ' ' + string_util::join(modules, " "));
+}
+
+void workload_recorder::update(const string& module, const string& contents) {
+  write("update", module + ' ' + contents);
+}
+
+/**
+ * Record an input, interned action ids are recorded as the full action string
+ */
+void workload_recorder::input(const string& action) {
+  actions_util::action resolved;
+  if (!action_table::make().resolve(action, resolved)) {
+    write("input", action);
+    return;
+  }
+
+  string action_str{"#" + std::get<0>(resolved) + "." + std::get<1>(resolved)};
+  if (!std::get<2>(resolved).empty()) {
+    action_str += "." + std::get<2>(resolved);
+  }
+  write("input", action_str);
+}
+
+void workload_recorder::write(const char* type, const string& data) {
+  string line{string_util::replace_all(data, "\n", " ")};
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_file == nullptr) {
+    return;
+  }
+
+  auto time = chrono::duration_cast<chrono::microseconds>(clock::now() - m_start).count();
+  fprintf(m_file, "%lld %s %s\n", static_cast<long long>(time), type, line.c_str());
+}
+
+/**
+ * Read all events of a recording
+ */
+workload_replay::workload_replay(std::istream& in) {
+  string line;
+  size_t number{0};
+
+  while (std::getline(in, line)) {
+    number++;
+    if (line.empty()) {
+      continue;
+    }
+
+    char* end{nullptr};
+    long long time{std::strtoll(line.c_str(), &end, 10)};
+    if (end == line.c_str() || *end != ' ' || time < 0) {
+      throw application_error("Invalid workload event in line " + to_string(number));
+    }
+
+    entry e{chrono::microseconds{time}, "", "", ""};
+    string rest{end + 1};
+    auto pos = rest.find(' ');
+    e.type = rest.substr(0, pos);
+    rest = pos == string::npos ? "" : rest.substr(pos + 1);
+
+    if (e.type == "layout" || e.type == "update") {
+      pos = rest.find(' ');
+      e.name = rest.substr(0, pos);
+      e.data = pos == string::npos ? "" : rest.substr(pos + 1);
+    } else if (e.type == "input") {
+      // Actions have the form #<module>.<action>[.<data>]
+      if (!rest.empty() && rest[0] == '#') {
+        e.name = rest.substr(1, rest.find('.') - 1);
+      }
+      e.data = move(rest);
+    } else {
+      throw application_error("Unknown workload event \"" + e.type + "\" in line " + to_string(number));
+    }
+
+    m_entries.emplace_back(move(e));
+  }
+}
+
+size_t workload_replay::size() const {
+  return m_entries.size();
+}
+
+/**
+ * Play back the events at the given speed, 0 for as fast as possible
+ *
+ * `draw` is called with the formatting string of every frame.
+ */
+workload_replay::result workload_replay::run(double speed, const draw_callback& draw) const {
+  result res{};
+  res.events = m_entries.size();
+
+  vector<string> blocks[3];
+  std::unordered_map<string, string> contents;
+  // Modules that were updated since the last frame
+  std::unordered_set<string> pending;
+  // Inputs waiting for the next update of their module
+  std::unordered_map<string, vector<clock::time_point>> waiting;
+  // Inputs whose module was updated, they are done with the next frame
+  vector<clock::time_point> updated;
+  vector<double> latencies;
+
+  auto start = clock::now();
+  const auto due = [&](const entry& e) {
+    return start + chrono::duration_cast<clock::duration>(chrono::duration<double, std::micro>(e.time.count() / speed));
+  };
+
+  for (size_t i = 0; i < m_entries.size(); i++) {
+    const auto& e = m_entries[i];
+    if (speed > 0.0) {
+      this_thread::sleep_until(due(e));
+    }
+
+    if (e.type == "layout") {
+      auto align = std::find(std::begin(ALIGNMENTS), std::end(ALIGNMENTS), e.name);
+      if (align != std::end(ALIGNMENTS)) {
+        blocks[align - std::begin(ALIGNMENTS)] = string_util::split(e.data, ' ');
+      }
+    } else if (e.type == "update") {
+      res.updates++;
+      if (!pending.emplace(e.name).second) {
+        res.dropped++;
+      }
+      contents[e.name] = e.data;
+
+      auto it = waiting.find(e.name);
+      if (it != waiting.end()) {
+        updated.insert(updated.end(), it->second.begin(), it->second.end());
+        waiting.erase(it);
+      }
+    } else {
+      res.inputs++;
+      if (!e.name.empty()) {
+        waiting[e.name].emplace_back(clock::now());
+      }
+    }
+
+    // Frames are only drawn once the playback caught up, the updates until then are combined
+    bool caught_up{i + 1 == m_entries.size()};
+    if (!caught_up && speed > 0.0) {
+      caught_up = clock::now() < due(m_entries[i + 1]);
+    } else if (!caught_up) {
+      caught_up = m_entries[i + 1].time != e.time;
+    }
+
+    if (pending.empty() || !caught_up) {
+      continue;
+    }
+
+    string frame;
+    for (size_t align = 0; align < 3; align++) {
+      string block;
+      for (const auto& module : blocks[align]) {
+        auto it = contents.find(module);
+        if (it != contents.end()) {
+          block += it->second;
+        }
+      }
+      if (!block.empty()) {
+        frame += ALIGNMENT_TAGS[align];
+        frame += block;
+      }
+    }
+
+    draw(frame);
+    res.frames++;
+    pending.clear();
+
+    auto now = clock::now();
+    for (auto received : updated) {
+      latencies.emplace_back(chrono::duration<double, std::milli>(now - received).count());
+    }
+    updated.clear();
+  }
+
+  res.elapsed = clock::now() - start;
+
+  std::sort(latencies.begin(), latencies.end());
+  res.latencies = latencies.size();
+  res.p50 = quantile(latencies, 0.5);
+  res.p99 = quantile(latencies, 0.99);
+
+  return res;
+}
+
+POLYBAR_NS_END
@@ -1,10 +1,20 @@
 #include "drawtypes/animation.hpp"
+
+#include <algorithm>
+
 #include "drawtypes/label.hpp"
 #include "utils/factory.hpp"
 
 POLYBAR_NS
 
 namespace drawtypes {
+  namespace {
+    /**
+     * Frames of different framerates that are this close are shown together
+     */
+    constexpr chrono::milliseconds ANIMATION_SLACK{10};
+  }  // namespace
+
   void animation::add(label_t&& frame) {
     m_frames.emplace_back(forward<decltype(frame)>(frame));
     m_framecount = m_frames.size();
@@ -58,6 +68,111 @@ namespace drawtypes {
 
     return factory_util::shared<animation>(move(vec), framerate);
   }
+
+  /**
+   * Create instance
+   */
+  animation_clock::make_type animation_clock::make() {
+    return static_cast<animation_clock&>(*factory_util::singleton<animation_clock>(scheduler::make()));
+  }
+
+  animation_clock::animation_clock(scheduler& scheduler) : m_scheduler(scheduler) {}
+
+  /**
+   * Deconstruct clock, animations that are still registered stop advancing
+   */
+  animation_clock::~animation_clock() {
+    vector<scheduler::task_id> tasks;
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      for (auto&& g : m_groups) {
+        tasks.emplace_back(g.second.task);
+      }
+      m_groups.clear();
+      m_framerates.clear();
+    }
+
+    for (auto&& task : tasks) {
+      m_scheduler.remove(task);
+    }
+  }
+
+  /**
+   * Advance the animation on its framerate until it is removed
+   *
+   * The callback is invoked after every frame, usually to redraw the module.
+   */
+  animation_clock::animation_id animation_clock::add(animation_t animation, callback fn) {
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    auto framerate = std::max(animation->framerate(), 1U);
+    auto id = m_next_id++;
+    auto& g = m_groups[framerate];
+    g.members.emplace(id, member{move(animation), move(fn)});
+    m_framerates.emplace(id, framerate);
+
+    if (g.task == 0) {
+      g.task = m_scheduler.add("animation-" + to_string(framerate), chrono::milliseconds{framerate},
+          [this, framerate] { tick(framerate); }, chrono::milliseconds::zero(), ANIMATION_SLACK);
+    }
+
+    return id;
+  }
+
+  /**
+   * Stop advancing the animation
+   *
+   * Once this returns, its callback is not invoked anymore.
+   */
+  void animation_clock::remove(animation_id id) {
+    scheduler::task_id task{0};
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      auto it = m_framerates.find(id);
+      if (it == m_framerates.end()) {
+        return;
+      }
+
+      auto g = m_groups.find(it->second);
+      g->second.members.erase(id);
+      if (g->second.members.empty()) {
+        task = g->second.task;
+        m_groups.erase(g);
+      }
+      m_framerates.erase(it);
+    }
+
+    // Not under m_lock, the scheduler waits for a running tick which needs the lock
+    if (task != 0) {
+      m_scheduler.remove(task);
+    }
+  }
+
+  /**
+   * Advance all animations with the given framerate
+   *
+   * The lock is held while the callbacks run, so that remove() can wait for
+   * them to return.
+   */
+  void animation_clock::tick(unsigned int framerate) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto g = m_groups.find(framerate);
+    if (g == m_groups.end()) {
+      return;
+    } else if (!g->second.started) {
+      g->second.started = true;
+      return;
+    }
+
+    for (auto&& m : g->second.members) {
+      if (*m.second.animation) {
+        m.second.animation->increment();
+      }
+    }
+    for (auto&& m : g->second.members) {
+      m.second.fn();
+    }
+  }
 }  // namespace drawtypes
 
 POLYBAR_NS_END
@@ -3,8 +3,12 @@
 POLYBAR_NS
 
 namespace drawtypes {
+  constexpr size_t iconset::MAX_FUZZY_RESULTS;
+
   void iconset::add(string id, label_t&& icon) {
     m_icons.emplace(id, forward<decltype(icon)>(icon));
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_fuzzy.clear();
   }
 
   bool iconset::has(const string& id) {
@@ -20,16 +24,41 @@ namespace drawtypes {
 
     // If fuzzy matching is turned on, try that first before returning the fallback.
     if (fuzzy_match) {
-      for (auto const& icon : m_icons) {
-        if (id.find(icon.first) != std::string::npos) {
-          return icon.second;
-        }
+      auto match = fuzzy_find(id);
+      if (match) {
+        return match;
       }
     }
 
     return m_icons.find(fallback_id)->second;
   }
 
+  /**
+   * First icon, in order of their ids, whose id is part of the given id
+   */
+  label_t iconset::fuzzy_find(const string& id) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto cached = m_fuzzy.find(id);
+    if (cached != m_fuzzy.end()) {
+      return cached->second;
+    }
+
+    label_t match;
+    for (auto const& icon : m_icons) {
+      if (id.find(icon.first) != std::string::npos) {
+        match = icon.second;
+        break;
+      }
+    }
+
+    // Ids that keep changing, e.g. window titles, must not grow it forever
+    if (m_fuzzy.size() == MAX_FUZZY_RESULTS) {
+      m_fuzzy.clear();
+    }
+    m_fuzzy.emplace(id, match);
+    return match;
+  }
+
   iconset::operator bool() {
     return !m_icons.empty();
   }
@@ -1,8 +1,10 @@
 #include "drawtypes/label.hpp"
 
 #include <cmath>
+#include <functional>
 #include <utility>
 
+#include "components/state_export.hpp"
 #include "utils/factory.hpp"
 #include "utils/string.hpp"
 
@@ -15,17 +17,13 @@ namespace drawtypes {
    * Here tokens are replaced with values and minlen and maxlen properties are applied
    */
   string label::get() const {
-    const size_t len = string_util::char_len(m_tokenized);
+    const string& tokenized = this->tokenized();
+    const size_t len = string_util::char_len(tokenized);
     if (len >= m_minlen) {
-      string text = m_tokenized;
       if (m_maxlen > 0 && len > m_maxlen) {
-        if (m_ellipsis) {
-          text = string_util::utf8_truncate(std::move(text), m_maxlen - 3) + "...";
-        } else {
-          text = string_util::utf8_truncate(std::move(text), m_maxlen);
-        }
+        return truncated(tokenized);
       }
-      return text;
+      return tokenized;
     }
 
     const size_t num_fill_chars = m_minlen - len;
@@ -43,61 +41,171 @@ namespace drawtypes {
         --left_fill_len;
       }
     }
-    return string(left_fill_len, ' ') + m_tokenized + string(right_fill_len, ' ');
+    return string(left_fill_len, ' ') + tokenized + string(right_fill_len, ' ');
+  }
+
+  /**
+   * Text cut to maxlen characters, with the ellipsis if enabled
+   *
+   * Cached results are looked up by the hash of the text, the text itself is
+   * compared as well so that a collision can't return another text
+   */
+  string label::truncated(const string& text) const {
+    const size_t hash = std::hash<string>{}(text);
+    for (const auto& entry : m_truncations) {
+      if (entry.hash == hash && entry.source == text) {
+        return entry.text;
+      }
+    }
+
+    string result;
+    if (m_ellipsis) {
+      result = string_util::utf8_truncate(string{text}, m_maxlen - 3) + "...";
+    } else {
+      result = string_util::utf8_truncate(string{text}, m_maxlen);
+    }
+
+    if (m_truncations.size() < TRUNCATION_CACHE_SIZE) {
+      m_truncations.emplace_back(truncation{hash, text, result});
+    } else {
+      m_truncations[m_truncation_next] = truncation{hash, text, result};
+      m_truncation_next = (m_truncation_next + 1) % TRUNCATION_CACHE_SIZE;
+    }
+    return result;
   }
 
   label::operator bool() {
-    return !m_tokenized.empty();
+    return !tokenized().empty();
   }
 
+  /**
+   * Copy of the label with the same template and without any replacements
+   */
   label_t label::clone() {
-    vector<token> tokens;
-    if (!m_tokens.empty()) {
-      std::back_insert_iterator<decltype(tokens)> back_it(tokens);
-      std::copy(m_tokens.begin(), m_tokens.end(), back_it);
-    }
-    return factory_util::shared<label>(m_text, m_foreground, m_background, m_underline, m_overline, m_font, m_padding,
-        m_margin, m_minlen, m_maxlen, m_alignment, m_ellipsis, move(tokens));
+    // The constructor is private, so make_shared can't be used
+    return label_t{new label(*this, m_template)};
   }
 
   void label::clear() {
     m_tokenized.clear();
+    m_detached = true;
+    m_dirty = false;
   }
 
   void label::reset_tokens() {
-    m_tokenized = m_text;
+    m_values.assign(m_template->slots.size(), string{});
+    m_filled.assign(m_template->slots.size(), false);
+    m_detached = false;
+    m_dirty = false;
+    m_tokenized = m_template->text;
   }
 
   void label::reset_tokens(const string& tokenized) {
     m_tokenized = tokenized;
+    m_detached = true;
+    m_dirty = false;
   }
 
   bool label::has_token(const string& token) const {
-    return m_tokenized.find(token) != string::npos;
+    return tokenized().find(token) != string::npos;
   }
 
   void label::replace_token(const string& token, string replacement) {
-    if (!has_token(token)) {
-      return;
-    }
+    state_export::record(token, replacement);
 
-    for (auto&& tok : m_tokens) {
+    const auto format = [&](const struct token& tok) {
       string repl{replacement};
-      if (token == tok.token) {
-        if (tok.max != 0_z && string_util::char_len(repl) > tok.max) {
-          repl = string_util::utf8_truncate(std::move(repl), tok.max) + tok.suffix;
-        } else if (tok.min != 0_z && repl.length() < tok.min) {
-          repl.insert(0_z, tok.min - repl.length(), tok.zpad ? '0' : ' ');
+      if (tok.max != 0_z && string_util::char_len(repl) > tok.max) {
+        repl = string_util::utf8_truncate(std::move(repl), tok.max) + tok.suffix;
+      } else if (tok.min != 0_z && repl.length() < tok.min) {
+        repl.insert(0_z, tok.min - repl.length(), tok.zpad ? '0' : ' ');
+      }
+      return repl;
+    };
+
+    if (m_detached) {
+      if (!has_token(token)) {
+        return;
+      }
+
+      for (auto&& tok : m_template->tokens) {
+        if (token == tok.token) {
+          /*
+           * Only replace first occurence, so that the proper token objects can be used
+           */
+          string_util::replace_inplace(m_tokenized, token, format(tok));
         }
+      }
+      return;
+    }
 
-        /*
-         * Only replace first occurence, so that the proper token objects can be used
-         */
-        m_tokenized = string_util::replace(m_tokenized, token, move(repl));
+    const auto& slots = m_template->slots;
+    for (size_t i = 0; i < slots.size(); i++) {
+      const auto& tok = m_template->tokens[slots[i].token];
+      if (!m_filled[i] && token == tok.token) {
+        m_values[i] = format(tok);
+        m_filled[i] = true;
+        m_dirty = true;
       }
     }
   }
 
+  /**
+   * Split the text into literal text and one slot per token
+   *
+   * Tokens are matched in the order they appear, which is the order
+   * load_label() creates them in
+   */
+  shared_ptr<const label::text_template> label::compile(string text, vector<token>&& tokens) {
+    auto result = make_shared<text_template>();
+    result->text = move(text);
+    result->tokens = move(tokens);
+
+    size_t pos{0_z};
+    for (size_t i = 0; i < result->tokens.size(); i++) {
+      size_t start = result->text.find(result->tokens[i].token, pos);
+      if (start == string::npos) {
+        continue;
+      }
+      result->slots.emplace_back(slot{pos, start - pos, i});
+      pos = start + result->tokens[i].token.size();
+    }
+
+    result->tail = pos;
+    return result;
+  }
+
+  /**
+   * Text with all replacements applied
+   *
+   * Materializes the slots in a single pass if they have changed
+   */
+  const string& label::tokenized() const {
+    if (!m_dirty) {
+      return m_tokenized;
+    }
+
+    const auto& text = m_template->text;
+    const auto& tokens = m_template->tokens;
+    const auto& slots = m_template->slots;
+
+    size_t size{text.size() - m_template->tail};
+    for (size_t i = 0; i < slots.size(); i++) {
+      size += slots[i].length + (m_filled[i] ? m_values[i].size() : tokens[slots[i].token].token.size());
+    }
+
+    m_tokenized.clear();
+    m_tokenized.reserve(size);
+    for (size_t i = 0; i < slots.size(); i++) {
+      m_tokenized.append(text, slots[i].start, slots[i].length);
+      m_tokenized.append(m_filled[i] ? m_values[i] : tokens[slots[i].token].token);
+    }
+    m_tokenized.append(text, m_template->tail, string::npos);
+
+    m_dirty = false;
+    return m_tokenized;
+  }
+
   void label::replace_defined_values(const label_t& label) {
     if (label->m_foreground.has_color()) {
       m_foreground = label->m_foreground;
@@ -129,6 +237,8 @@ namespace drawtypes {
     if (label->m_maxlen != 0_z) {
       m_maxlen = label->m_maxlen;
       m_ellipsis = label->m_ellipsis;
+      m_truncations.clear();
+      m_truncation_next = 0_z;
     }
   }
 
@@ -163,6 +273,8 @@ namespace drawtypes {
     if (m_maxlen == 0_z && label->m_maxlen != 0_z) {
       m_maxlen = label->m_maxlen;
       m_ellipsis = label->m_ellipsis;
+      m_truncations.clear();
+      m_truncation_next = 0_z;
     }
   }
 
@@ -220,7 +332,7 @@ namespace drawtypes {
 
       // strip min/max specifiers from the label string token
       token.token = token_str.substr(0, pos) + '%';
-      text = string_util::replace(text, token_str, token.token);
+      string_util::replace_inplace(text, token_str, token.token);
 
       try {
         token.min = std::stoul(&token_str[pos + 1], nullptr, 10);
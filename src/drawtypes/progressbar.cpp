@@ -15,10 +15,12 @@ namespace drawtypes {
 
   void progressbar::set_fill(label_t&& fill) {
     m_fill = forward<decltype(fill)>(fill);
+    m_outputs.clear();
   }
 
   void progressbar::set_empty(label_t&& empty) {
     m_empty = forward<decltype(empty)>(empty);
+    m_outputs.clear();
   }
 
   void progressbar::set_indicator(label_t&& indicator) {
@@ -26,42 +28,57 @@ namespace drawtypes {
       m_width--;
     }
     m_indicator = forward<decltype(indicator)>(indicator);
+    m_outputs.clear();
   }
 
   void progressbar::set_gradient(bool mode) {
     m_gradient = mode;
+    m_outputs.clear();
   }
 
   void progressbar::set_colors(vector<rgba>&& colors) {
     m_colors = forward<decltype(colors)>(colors);
 
     m_colorstep = m_colors.empty() ? 1 : m_width / m_colors.size();
+    m_outputs.clear();
   }
 
   string progressbar::output(float percentage) {
-    string output{m_format};
-
     // Get fill/empty widths based on percentage
     unsigned int perc = math_util::cap(percentage, 0.0f, 100.0f);
     unsigned int fill_width = math_util::percentage_to_value(perc, m_width);
     unsigned int empty_width = m_width - fill_width;
 
+    // Without a gradient, the whole fill has the color for the percentage
+    size_t color{0};
+    if (!m_colors.empty() && !m_gradient) {
+      color = math_util::percentage_to_value<size_t>(perc, m_colors.size() - 1);
+    }
+
+    auto cached = m_outputs.find(make_pair(fill_width, color));
+    if (cached != m_outputs.end()) {
+      return cached->second;
+    }
+
+    string output{m_format};
+
     // Output fill icons
-    fill(perc, fill_width);
-    output = string_util::replace_all(output, "%fill%", m_builder->flush());
+    fill(color, fill_width);
+    string_util::replace_all_inplace(output, "%fill%", m_builder->flush());
 
     // Output indicator icon
     m_builder->node(m_indicator);
-    output = string_util::replace_all(output, "%indicator%", m_builder->flush());
+    string_util::replace_all_inplace(output, "%indicator%", m_builder->flush());
 
     // Output empty icons
     m_builder->node_repeat(m_empty, empty_width);
-    output = string_util::replace_all(output, "%empty%", m_builder->flush());
+    string_util::replace_all_inplace(output, "%empty%", m_builder->flush());
 
+    m_outputs.emplace(make_pair(fill_width, color), output);
     return output;
   }
 
-  void progressbar::fill(unsigned int perc, unsigned int fill_width) {
+  void progressbar::fill(size_t color, unsigned int fill_width) {
     if (m_colors.empty()) {
       m_builder->node_repeat(m_fill, fill_width);
     } else if (m_gradient) {
@@ -73,7 +90,6 @@ namespace drawtypes {
         m_builder->node(m_fill);
       }
     } else {
-      size_t color = math_util::percentage_to_value<size_t>(perc, m_colors.size() - 1);
       m_fill->m_foreground = m_colors[color];
       m_builder->node_repeat(m_fill, fill_width);
     }
@@ -1,11 +1,19 @@
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <csignal>
+#include <cstddef>
 #include <cstdlib>
 #include <cstring>
 #include <vector>
 
 #include "common.hpp"
 #include "utils/file.hpp"
+#include "utils/string.hpp"
 
 using namespace polybar;
 using namespace std;
@@ -13,6 +21,20 @@ using namespace std;
 #ifndef IPC_CHANNEL_PREFIX
 #define IPC_CHANNEL_PREFIX "/tmp/polybar_mqueue."
 #endif
+#ifndef IPC_SOCKET_PREFIX
+#define IPC_SOCKET_PREFIX "/tmp/polybar_ipc."
+#endif
+#ifndef IPC_BROKER_PREFIX
+#define IPC_BROKER_PREFIX "polybar_broker."
+#endif
+
+const int E_NO_CHANNELS{2};
+const int E_MESSAGE_TYPE{3};
+const int E_INVALID_PID{4};
+const int E_INVALID_CHANNEL{5};
+const int E_WRITE{6};
+const int E_QUERY{7};
+const int E_INVALID_TARGET{8};
 
 void display(const string& msg) {
   fprintf(stdout, "%s\n", msg.c_str());
@@ -24,7 +46,7 @@ void log(int exit_code, const string& msg) {
 }
 
 void usage(const string& parameters) {
-  fprintf(stderr, "Usage: polybar-msg [-p pid] %s\n", parameters.c_str());
+  fprintf(stderr, "Usage: polybar-msg [-p pid | -t target] %s\n", parameters.c_str());
   exit(127);
 }
 
@@ -37,19 +59,196 @@ void remove_pipe(const string& handle) {
 }
 
 bool validate_type(const string& type) {
-  return (type == "action" || type == "cmd" || type == "hook");
+  return (type == "action" || type == "cmd" || type == "content" || type == "get" || type == "hook");
 }
 
-int main(int argc, char** argv) {
-  const int E_NO_CHANNELS{2};
-  const int E_MESSAGE_TYPE{3};
-  const int E_INVALID_PID{4};
-  const int E_INVALID_CHANNEL{5};
-  const int E_WRITE{6};
+/**
+ * Connect to the socket of the polybar process with the given pid
+ *
+ * \returns -1 if the process has no socket (e.g. older versions)
+ */
+int connect_socket(const string& pid) {
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", (IPC_SOCKET_PREFIX + pid).c_str());
+
+  int fd{socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)};
+  if (fd != -1 && connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+}
+
+/**
+ * Connect to the broker the bars of the current user elected
+ *
+ * \returns -1 if there is no broker (e.g. older versions) or it belongs to
+ *          another user
+ */
+int connect_broker() {
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  string name{IPC_BROKER_PREFIX + to_string(getuid())};
+  memcpy(addr.sun_path + 1, name.data(), name.size());
+  socklen_t size = offsetof(struct sockaddr_un, sun_path) + 1 + name.size();
+
+  int fd{socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0)};
+  if (fd == -1) {
+    return -1;
+  }
+
+  struct ucred cred {};
+  socklen_t cred_size{sizeof(cred)};
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), size) == -1 ||
+      getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_size) == -1 || cred.uid != getuid()) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+bool validate_target(const string& target) {
+  return target == "all" || (target.compare(0, 4, "bar:") == 0 && target.size() > 4) ||
+         (target.compare(0, 8, "monitor:") == 0 && target.size() > 8);
+}
+
+/**
+ * Send one or more newline separated messages, over the socket if there is
+ * one and to the fifo otherwise
+ */
+bool send_messages(int socket_fd, const string& channel, const string& data) {
+  if (socket_fd != -1) {
+    return send(socket_fd, data.c_str(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+  }
+
+  file_descriptor fd(channel, O_WRONLY | O_NONBLOCK);
+  return write(fd, data.c_str(), data.size()) == static_cast<ssize_t>(data.size());
+}
+
+/**
+ * Open every channel for writing, over the socket if there is one
+ */
+vector<int> open_channels(const vector<string>& channels) {
+  vector<int> fds;
+  for (auto&& channel : channels) {
+    int fd{connect_socket(channel.substr(channel.rfind('.') + 1))};
+    if (fd == -1) {
+      fd = open(channel.c_str(), O_WRONLY | O_CLOEXEC);
+    }
+    fds.emplace_back(fd);
+  }
+  return fds;
+}
+
+/**
+ * Forward messages read from stdin, one per line, until stdin is closed
+ *
+ * The connections stay open and all complete lines that are read at once
+ * are sent together, each one starting with `prefix`. Channels that can't be
+ * written to anymore, e.g. because the bar exited, are dropped.
+ */
+int stream(vector<string> channels, vector<int> fds, const string& prefix) {
+  // Writing to a fifo without a reader would terminate us
+  signal(SIGPIPE, SIG_IGN);
+
+  string pending;
+  char buffer[BUFSIZ];
+  ssize_t bytes_read;
+
+  while ((bytes_read = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0 || !pending.empty()) {
+    if (bytes_read > 0) {
+      pending.append(buffer, bytes_read);
+    } else {
+      pending += '\n';
+    }
+
+    auto end = pending.rfind('\n');
+    if (end == string::npos) {
+      continue;
+    }
+
+    string data;
+    size_t start{0};
+    for (size_t pos; start <= end; start = pos + 1) {
+      pos = pending.find('\n', start);
+      string message{pending.substr(start, pos - start)};
+      auto colon = message.find(':');
+      if (message.empty()) {
+        continue;
+      } else if (colon == string::npos || !validate_type(message.substr(0, colon))) {
+        fprintf(stderr, "polybar-msg: Ignoring invalid message \"%s\"\n", message.c_str());
+        continue;
+      }
+      data += prefix + message + '\n';
+    }
+    pending.erase(0, end + 1);
+
+    for (size_t i = 0; i < channels.size() && !data.empty(); i++) {
+      if (fds[i] == -1 || write(fds[i], data.c_str(), data.size()) != static_cast<ssize_t>(data.size())) {
+        fprintf(stderr, "polybar-msg: Failed to write to \"%s\" (err: %s)\n", channels[i].c_str(), strerror(errno));
+        close(fds[i]);
+        fds.erase(fds.begin() + i);
+        channels.erase(channels.begin() + i--);
+      }
+    }
 
+    if (channels.empty()) {
+      log(E_WRITE, "No ipc channels left");
+    }
+  }
+
+  for (int fd : fds) {
+    close(fd);
+  }
+
+  return 0;
+}
+
+/**
+ * Send a query to every bar and print their answers
+ */
+int query(const vector<string>& channels, const string& query) {
+  int exit_status{0};
+  string message{query + '\n'};
+
+  for (auto&& channel : channels) {
+    int fd{connect_socket(channel.substr(channel.rfind('.') + 1))};
+    if (fd == -1) {
+      fprintf(stderr, "polybar-msg: \"%s\" does not answer queries\n", channel.c_str());
+      exit_status = E_QUERY;
+      continue;
+    }
+
+    string reply;
+    struct pollfd fds[1]{{fd, POLLIN, 0}};
+    if (send(fd, message.c_str(), message.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(message.size()) &&
+        poll(fds, 1, 1000) == 1) {
+      ssize_t size{recv(fd, nullptr, 0, MSG_PEEK | MSG_TRUNC)};
+      if (size > 0) {
+        reply.resize(size);
+        reply.resize(std::max<ssize_t>(0, recv(fd, &reply[0], reply.size(), 0)));
+      }
+    }
+    close(fd);
+
+    reply = string_util::rtrim(move(reply), '\n');
+    if (reply.compare(0, 3, "ok ") == 0) {
+      display(reply.substr(3));
+    } else {
+      fprintf(stderr, "polybar-msg: %s\n", reply.empty() ? "No answer" : reply.substr(reply.find(' ') + 1).c_str());
+      exit_status = E_QUERY;
+    }
+  }
+
+  return exit_status;
+}
+
+int main(int argc, char** argv) {
   vector<string> args{argv + 1, argv + argc};
   string::size_type p;
   int pid{0};
+  string target{"all"};
 
   // If -p <pid> is passed, check if the process is running and that
   // a valid channel pipe is available
@@ -63,20 +262,68 @@ int main(int argc, char** argv) {
     pid = strtol(args[1].c_str(), nullptr, 10);
     args.erase(args.begin());
     args.erase(args.begin());
+  } else if (args.size() >= 2 && args[0] == "-t") {
+    // If -t <target> is passed, only the bars the broker selects get the message
+    if (!validate_target(args[1])) {
+      log(E_INVALID_TARGET, "\"" + args[1] + "\" is not a valid target (all, bar:<name> or monitor:<name>)");
+    }
+
+    target = args[1];
+    args.erase(args.begin());
+    args.erase(args.begin());
   }
 
   // Validate args
   auto help = find_if(args.begin(), args.end(), [](string a) { return a == "-h" || a == "--help"; }) != args.end();
-  if (help || args.size() < 2) {
-    usage("<command=(action|cmd|hook)> <payload> [...]");
-  } else if (!validate_type(args[0])) {
+  bool from_stdin{args.size() == 1 && (args[0] == "--stream" || args[0] == "-")};
+  bool stats{args.size() == 1 && args[0] == "stats"};
+  if (help || (args.size() < 2 && !from_stdin && !stats)) {
+    usage("<command=(action|cmd|content|get|hook)> <payload> [...]\n       polybar-msg [-p pid] --stream\n"
+          "       polybar-msg [-p pid] stats");
+  } else if (!from_stdin && !stats && !validate_type(args[0])) {
     log(E_MESSAGE_TYPE, "\"" + args[0] + "\" is not a valid type.");
   }
 
-  string ipc_type{args[0]};
-  args.erase(args.begin());
-  string ipc_payload{args[0]};
-  args.erase(args.begin());
+  string ipc_type{from_stdin ? "" : args[0]};
+  string ipc_payload{from_stdin || stats ? "" : args[1]};
+  args.erase(args.begin(), args.begin() + (from_stdin || stats ? 1 : 2));
+
+  // Check content specific args
+  if (ipc_type == "content") {
+    if (args.size() != 1) {
+      usage("content <module-name> <content>");
+    }
+    ipc_payload += ' ' + args[0];
+    args.erase(args.begin());
+  }
+
+  // Check module command specific args
+  if (ipc_type == "cmd" && ipc_payload.compare(0, 7, "module:") == 0) {
+    if (args.size() > 1) {
+      usage("cmd module:<module-name> <pause|resume|interval=<seconds>|snapshot=<file>>");
+    } else if (!args.empty()) {
+      // The bar has its own working directory
+      if (args[0].compare(0, 9, "snapshot=") == 0 && args[0].size() > 9 && args[0][9] != '/' && args[0][9] != '~') {
+        char* cwd{getcwd(nullptr, 0)};
+        if (cwd != nullptr) {
+          args[0].insert(9, string{cwd} + '/');
+          free(cwd);
+        }
+      }
+      ipc_payload += ' ' + args[0];
+      args.erase(args.begin());
+    }
+  }
+
+  // Check query specific args
+  if (ipc_type == "get") {
+    if (args.size() > 1) {
+      usage("get <module-name> [raw|text|json]");
+    } else if (!args.empty()) {
+      ipc_payload += ' ' + args[0];
+      args.erase(args.begin());
+    }
+  }
 
   // Check hook specific args
   if (ipc_type == "hook") {
@@ -91,6 +338,28 @@ int main(int argc, char** argv) {
     }
   }
 
+  // A single write to the broker reaches all bars, queries need an answer from every bar though
+  if (!pid && ipc_type != "get" && !stats) {
+    int broker_fd{connect_broker()};
+    if (broker_fd != -1 && from_stdin) {
+      return stream({"broker"}, {broker_fd}, "to:" + target + ' ');
+    } else if (broker_fd != -1) {
+      string payload{ipc_type + ':' + ipc_payload};
+      string message{"to:" + target + ' ' + payload + '\n'};
+      bool sent{send(broker_fd, message.c_str(), message.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(message.size())};
+      close(broker_fd);
+      if (!sent) {
+        log(E_WRITE, "Failed to write \"" + payload + "\" to broker (err: " + strerror(errno) + ")");
+      }
+      display("Successfully wrote \"" + payload + "\" to the broker for \"" + target + "\"");
+      return 0;
+    } else if (target != "all") {
+      log(E_NO_CHANNELS, "No ipc broker to reach \"" + target + "\"");
+    }
+  } else if (target != "all") {
+    log(E_INVALID_TARGET, "Targets can't be used with -p, get or stats");
+  }
+
   // Get availble channel pipes
   auto pipes = file_util::glob(IPC_CHANNEL_PREFIX + "*"s);
 
@@ -110,15 +379,24 @@ int main(int argc, char** argv) {
     log(E_NO_CHANNELS, "No active ipc channels");
   }
 
+  if (from_stdin) {
+    auto fds = open_channels(pipes);
+    return stream(move(pipes), move(fds), "");
+  } else if (ipc_type == "get") {
+    return query(pipes, "get:" + ipc_payload);
+  } else if (stats) {
+    return query(pipes, "get-stats");
+  }
+
   int exit_status = 127;
 
   // Write message to each available channel or match
   // against pid if one was defined
   for (auto&& channel : pipes) {
+    string payload{ipc_type + ':' + ipc_payload};
+    int socket_fd{connect_socket(channel.substr(channel.rfind('.') + 1))};
     try {
-      file_descriptor fd(channel, O_WRONLY | O_NONBLOCK);
-      string payload{ipc_type + ':' + ipc_payload};
-      if (write(fd, payload.c_str(), payload.size()) != -1) {
+      if (send_messages(socket_fd, channel, payload + '\n')) {
         display("Successfully wrote \"" + payload + "\" to \"" + channel + "\"");
         exit_status = 0;
       } else {
@@ -127,6 +405,9 @@ int main(int argc, char** argv) {
     } catch (const exception& err) {
       remove_pipe(channel);
     }
+    if (socket_fd != -1) {
+      close(socket_fd);
+    }
   }
 
   return exit_status;
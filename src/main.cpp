@@ -1,9 +1,23 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
 #include "components/bar.hpp"
 #include "components/command_line.hpp"
 #include "components/config.hpp"
 #include "components/config_parser.hpp"
 #include "components/controller.hpp"
 #include "components/ipc.hpp"
+#include "components/logger.hpp"
+#include "components/offscreen_renderer.hpp"
+#include "components/spawner.hpp"
+#include "components/startup_profile.hpp"
+#include "components/thread_policy.hpp"
+#include "components/workload.hpp"
+#include "tags/dispatch.hpp"
 #include "utils/env.hpp"
 #include "utils/inotify.hpp"
 #include "utils/process.hpp"
@@ -11,7 +25,105 @@
 
 using namespace polybar;
 
+namespace chrono = std::chrono;
+
+/**
+ * Render the formatting strings read from stdin into numbered png files in
+ * `dir`, without connecting to an X server
+ *
+ * The bar is sized as if it was on a 1920x1080 monitor.
+ */
+static void render_offscreen(const logger& log, const config& conf, const string& dir) {
+  const auto& bs = conf.section();
+
+  bar_settings bar{};
+  bar.background = conf.get(bs, "background", bar.background);
+  bar.foreground = conf.get(bs, "foreground", bar.foreground);
+
+  int width = geom_format_to_pixels(conf.get(bs, "width", "100%"s), 1920);
+  int height = geom_format_to_pixels(conf.get(bs, "height", "24"s), 1080);
+
+  auto renderer = offscreen_renderer::make(log, conf, bar, width, height);
+  auto dispatch = tags::dispatch::make();
+
+  size_t frames{0};
+  chrono::steady_clock::duration elapsed{};
+  string line;
+
+  while (std::getline(std::cin, line)) {
+    if (line.empty()) {
+      continue;
+    }
+
+    auto start = chrono::steady_clock::now();
+    renderer->begin();
+    dispatch->parse(bar, *renderer, tags::tokenize(log, line));
+    renderer->end();
+    elapsed += chrono::steady_clock::now() - start;
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%06zu.png", frames++);
+    renderer->write_png(dir + name);
+  }
+
+  auto us = chrono::duration_cast<chrono::microseconds>(elapsed).count();
+  log.notice("Rendered %zu frames of %ix%i in %lims (%.1fus per frame)", frames, width, height, us / 1000,
+      frames ? static_cast<double>(us) / frames : 0.0);
+}
+
+/**
+ * Play back a workload recorded with `--record` and draw its frames offscreen
+ *
+ * `speed` scales the recorded timing, `max` plays it back without waiting.
+ *
+ * The modules and the event loop aren't involved, the reported latency is the
+ * scaled delay between an input and the next update of its module that was
+ * recorded, plus the time it takes to draw the frame offscreen.
+ */
+static void replay_workload(const logger& log, const config& conf, const string& path, const string& speed) {
+  double factor{0.0};
+  if (speed != "max") {
+    char* end{nullptr};
+    factor = std::strtod(speed.c_str(), &end);
+    if (end == speed.c_str() || *end != '\0' || factor <= 0.0) {
+      throw application_error("Invalid replay speed \"" + speed + "\", expected a factor or max");
+    }
+  }
+
+  std::ifstream in{path};
+  if (!in) {
+    throw application_error("Failed to open workload file " + path);
+  }
+  workload_replay replay{in};
+
+  const auto& bs = conf.section();
+
+  bar_settings bar{};
+  bar.background = conf.get(bs, "background", bar.background);
+  bar.foreground = conf.get(bs, "foreground", bar.foreground);
+
+  int width = geom_format_to_pixels(conf.get(bs, "width", "100%"s), 1920);
+  int height = geom_format_to_pixels(conf.get(bs, "height", "24"s), 1080);
+
+  auto renderer = offscreen_renderer::make(log, conf, bar, width, height);
+  auto dispatch = tags::dispatch::make();
+
+  auto result = replay.run(factor, [&](const string& frame) {
+    renderer->begin();
+    dispatch->parse(bar, *renderer, tags::tokenize(log, frame));
+    renderer->end();
+  });
+
+  auto ms = chrono::duration_cast<chrono::milliseconds>(result.elapsed).count();
+  log.notice("Replayed %zu events in %lims: %zu frames, %zu of %zu updates dropped, %zu inputs", result.events, ms,
+      result.frames, result.dropped, result.updates, result.inputs);
+  log.notice("Input to frame latency of %zu inputs: p50 %.3fms, p99 %.3fms", result.latencies, result.p50, result.p99);
+}
+
 int main(int argc, char** argv) {
+  startup_profile& profile{startup_profile::make()};
+  auto phase_start = startup_profile::clock::now();
+
   // clang-format off
   const command_line::options opts{
       command_line::option{"-h", "--help", "Display this help and exit"},
@@ -25,7 +137,14 @@ int main(int argc, char** argv) {
       command_line::option{"-M", "--list-all-monitors", "Print list of all available monitors (Including cloned monitors) and exit"},
       command_line::option{"-w", "--print-wmname", "Print the generated WM_NAME and exit"},
       command_line::option{"-s", "--stdout", "Output data to stdout instead of drawing it to the X window"},
+      command_line::option{"-o", "--output-format", "Same as --stdout, but output data in the given format", "FORMAT", {"raw", "json"}},
       command_line::option{"-p", "--png", "Save png snapshot to FILE after running for 3 seconds", "FILE"},
+      command_line::option{"-R", "--render", "Render the formatting strings read from stdin into DIR without an X server", "DIR"},
+      command_line::option{"-e", "--record", "Record the output of the modules and the input of the bar into FILE", "FILE"},
+      command_line::option{"-E", "--replay", "Play back a workload recorded with --record without an X server, only the drawing is timed", "FILE"},
+      command_line::option{"-S", "--speed", "Speed factor of --replay, max plays it back without waiting (default: max)", "SPEED"},
+      command_line::option{"-P", "--profile-startup", "Print a timeline of the startup once all modules are shown"},
+      command_line::option{"-T", "--profile-trace", "Same as --profile-startup, also write a Chrome trace to FILE", "FILE"},
   };
   // clang-format on
 
@@ -58,38 +177,60 @@ int main(int argc, char** argv) {
       return EXIT_SUCCESS;
     }
 
+    if (cli->has("profile-startup") || cli->has("profile-trace")) {
+      profile.enable(cli->has("profile-trace") ? cli->get("profile-trace") : "");
+    }
+    profile.record("command line", phase_start, startup_profile::clock::now());
+    phase_start = startup_profile::clock::now();
+
     //==================================================
-    // Connect to X server
+    // Start the helper for shell commands while the
+    // process is small and has no threads
     //==================================================
-    auto xcb_error = 0;
-    auto xcb_screen = 0;
-    auto xcb_connection = xcb_connect(nullptr, &xcb_screen);
-
-    if (xcb_connection == nullptr) {
-      throw application_error("A connection to X could not be established...");
-    } else if ((xcb_error = xcb_connection_has_error(xcb_connection))) {
-      throw application_error("X connection error... (what: " + connection::error_str(xcb_error) + ")");
+    if (!spawner::make().start()) {
+      logger.warn("Failed to start the command helper, commands are run by the bar (reason: %s)", strerror(errno));
     }
 
-    connection& conn{connection::make(xcb_connection, xcb_screen)};
-    conn.ensure_event_mask(conn.root(), XCB_EVENT_MASK_PROPERTY_CHANGE);
+    // Termination and reload signals are read from a signalfd by the
+    // controller, all threads started from now on inherit the blocked mask
+    controller::block_signals();
 
-    //==================================================
-    // List available XRandR entries
-    //==================================================
-    if (cli->has("list-monitors") || cli->has("list-all-monitors")) {
-      bool purge_clones = !cli->has("list-all-monitors");
-      auto monitors = randr_util::get_monitors(conn, conn.root(), true, purge_clones);
-      for (auto&& mon : monitors) {
-        if (WITH_XRANDR_MONITORS && mon->output == XCB_NONE) {
-          printf("%s: %ix%i+%i+%i (XRandR monitor%s)\n", mon->name.c_str(), mon->w, mon->h, mon->x, mon->y,
-              mon->primary ? ", primary" : "");
-        } else {
-          printf("%s: %ix%i+%i+%i%s\n", mon->name.c_str(), mon->w, mon->h, mon->x, mon->y,
-              mon->primary ? " (primary)" : "");
+    // Offscreen rendering and replays don't need an X server
+    if (!cli->has("render") && !cli->has("replay")) {
+      //==================================================
+      // Connect to X server
+      //==================================================
+      auto xcb_error = 0;
+      auto xcb_screen = 0;
+      auto xcb_connection = xcb_connect(nullptr, &xcb_screen);
+
+      if (xcb_connection == nullptr) {
+        throw application_error("A connection to X could not be established...");
+      } else if ((xcb_error = xcb_connection_has_error(xcb_connection))) {
+        throw application_error("X connection error... (what: " + connection::error_str(xcb_error) + ")");
+      }
+
+      connection& conn{connection::make(xcb_connection, xcb_screen)};
+      conn.ensure_event_mask(conn.root(), XCB_EVENT_MASK_PROPERTY_CHANGE);
+      profile.record("X connection", phase_start, startup_profile::clock::now());
+
+      //==================================================
+      // List available XRandR entries
+      //==================================================
+      if (cli->has("list-monitors") || cli->has("list-all-monitors")) {
+        bool purge_clones = !cli->has("list-all-monitors");
+        auto monitors = randr_util::get_monitors(conn, conn.root(), true, purge_clones);
+        for (auto&& mon : monitors) {
+          if (WITH_XRANDR_MONITORS && mon->output == XCB_NONE) {
+            printf("%s: %ix%i+%i+%i (XRandR monitor%s)\n", mon->name.c_str(), mon->w, mon->h, mon->x, mon->y,
+                mon->primary ? ", primary" : "");
+          } else {
+            printf("%s: %ix%i+%i+%i%s\n", mon->name.c_str(), mon->w, mon->h, mon->x, mon->y,
+                mon->primary ? " (primary)" : "");
+          }
         }
+        return EXIT_SUCCESS;
       }
-      return EXIT_SUCCESS;
     }
 
     //==================================================
@@ -116,8 +257,15 @@ int main(int argc, char** argv) {
       throw application_error("Define configuration using --config=PATH");
     }
 
+    phase_start = startup_profile::clock::now();
     config_parser parser{logger, move(confpath), cli->get(0)};
+    parser.use_cache();
     config::make_type conf = parser.parse();
+    profile.record("config", phase_start, startup_profile::clock::now());
+
+    // The main thread runs the event loop
+    thread_policy::make().enter(thread_policy::role::UI);
+    thread_policy::make().configure(conf);
 
     //==================================================
     // Dump requested data
@@ -131,6 +279,22 @@ int main(int argc, char** argv) {
       return EXIT_SUCCESS;
     }
 
+    //==================================================
+    // Render offscreen
+    //==================================================
+    if (cli->has("render") || cli->has("replay")) {
+      // There is no controller to read the signalfd, Ctrl-C has to work
+      controller::unblock_signals();
+    }
+    if (cli->has("render")) {
+      render_offscreen(logger, conf, cli->get("render"));
+      return EXIT_SUCCESS;
+    }
+    if (cli->has("replay")) {
+      replay_workload(logger, conf, cli->get("replay"), cli->has("speed") ? cli->get("speed") : "max");
+      return EXIT_SUCCESS;
+    }
+
     //==================================================
     // Create controller and run application
     //==================================================
@@ -144,9 +308,22 @@ int main(int argc, char** argv) {
       config_watch = inotify_util::make_watch(conf.filepath());
     }
 
+    if (cli->has("record")) {
+      workload_recorder::make().open(cli->get("record"));
+    }
+
+    phase_start = startup_profile::clock::now();
     auto ctrl = controller::make(move(ipc), move(config_watch));
+    profile.record("controller", phase_start, startup_profile::clock::now());
 
-    if (!ctrl->run(cli->has("stdout"), cli->get("png"))) {
+    output_format output{output_format::NONE};
+    if (cli->has("output-format")) {
+      output = cli->compare("output-format", "json") ? output_format::JSON : output_format::RAW;
+    } else if (cli->has("stdout")) {
+      output = output_format::RAW;
+    }
+
+    if (!ctrl->run(output, cli->get("png"))) {
       reload = true;
     }
   } catch (const exception& err) {
@@ -154,6 +331,8 @@ int main(int argc, char** argv) {
     exit_code = EXIT_FAILURE;
   }
 
+  spawner::make().stop();
+
   logger.info("Waiting for spawned processes to end");
   while (process_util::notify_childprocess()) {
     ;
@@ -161,6 +340,7 @@ int main(int argc, char** argv) {
 
   if (reload) {
     logger.info("Re-launching application...");
+    logger.flush();
     process_util::exec(move(argv[0]), move(argv));
   }
 
@@ -68,6 +68,24 @@ namespace modules {
       throw module_error(err.what());
     }
 
+    // The descriptors stay the same for the lifetime of the mixers and controls
+    try {
+      for (auto&& m : m_mixer) {
+        if (m.second) {
+          auto fds = m.second->get_file_descriptors();
+          m_fds.insert(m_fds.end(), fds.begin(), fds.end());
+        }
+      }
+      for (auto&& c : m_ctrl) {
+        if (c.second) {
+          auto fds = c.second->get_file_descriptors();
+          m_fds.insert(m_fds.end(), fds.begin(), fds.end());
+        }
+      }
+    } catch (const alsa_exception& err) {
+      throw module_error(err.what());
+    }
+
     // Add formats and elements
     m_formatter->add(FORMAT_VOLUME, TAG_LABEL_VOLUME, {TAG_RAMP_VOLUME, TAG_LABEL_VOLUME, TAG_BAR_VOLUME});
     m_formatter->add(FORMAT_MUTED, TAG_LABEL_MUTED, {TAG_RAMP_VOLUME, TAG_LABEL_MUTED, TAG_BAR_VOLUME});
@@ -88,48 +106,48 @@ namespace modules {
   }
 
   void alsa_module::teardown() {
+    m_fds.clear();
     m_mixer.clear();
     m_ctrl.clear();
     snd_config_update_free_global();
   }
 
+  /**
+   * Poll descriptors of all mixers and controls, so that the module is only
+   * woken up once there are events to process
+   */
+  vector<int> alsa_module::event_fds() const {
+    return m_fds;
+  }
+
+  /**
+   * Drain the pending events of all mixers and controls
+   *
+   * The reactor only calls this once one of the descriptors is readable. All
+   * of them are handled at once without blocking, so a single wakeup services
+   * every mixer and the headphone control.
+   */
   bool alsa_module::has_event() {
-    // Poll for mixer and control events
+    bool changed{false};
     try {
-      if (m_mixer[mixer::MASTER] && m_mixer[mixer::MASTER]->wait(25)) {
-        return true;
-      }
-      if (m_mixer[mixer::SPEAKER] && m_mixer[mixer::SPEAKER]->wait(25)) {
-        return true;
-      }
-      if (m_mixer[mixer::HEADPHONE] && m_mixer[mixer::HEADPHONE]->wait(25)) {
-        return true;
+      for (auto&& m : m_mixer) {
+        if (m.second && m.second->process_events() > 0) {
+          changed = true;
+        }
       }
-      if (m_ctrl[control::HEADPHONE] && m_ctrl[control::HEADPHONE]->wait(25)) {
-        return true;
+      for (auto&& c : m_ctrl) {
+        if (c.second && c.second->process_events() > 0) {
+          changed = true;
+        }
       }
     } catch (const alsa_exception& e) {
       m_log.err("%s: %s", name(), e.what());
     }
 
-    return false;
+    return changed;
   }
 
   bool alsa_module::update() {
-    // Consume pending events
-    if (m_mixer[mixer::MASTER]) {
-      m_mixer[mixer::MASTER]->process_events();
-    }
-    if (m_mixer[mixer::SPEAKER]) {
-      m_mixer[mixer::SPEAKER]->process_events();
-    }
-    if (m_mixer[mixer::HEADPHONE]) {
-      m_mixer[mixer::HEADPHONE]->process_events();
-    }
-    if (m_ctrl[control::HEADPHONE]) {
-      m_ctrl[control::HEADPHONE]->process_events();
-    }
-
     // Get volume, mute and headphone state
     m_volume = 100;
     m_muted = false;
@@ -201,16 +219,16 @@ namespace modules {
     return m_builder->flush();
   }
 
-  bool alsa_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_BAR_VOLUME) {
+  bool alsa_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_BAR_VOLUME)) {
       builder->node(m_bar_volume->output(m_volume));
-    } else if (tag == TAG_RAMP_VOLUME && (!m_headphones || !*m_ramp_headphones)) {
+    } else if (tag == TAG_ID(TAG_RAMP_VOLUME) && (!m_headphones || !*m_ramp_headphones)) {
       builder->node(m_ramp_volume->get_by_percentage(m_volume));
-    } else if (tag == TAG_RAMP_VOLUME && m_headphones && *m_ramp_headphones) {
+    } else if (tag == TAG_ID(TAG_RAMP_VOLUME) && m_headphones && *m_ramp_headphones) {
       builder->node(m_ramp_headphones->get_by_percentage(m_volume));
-    } else if (tag == TAG_LABEL_VOLUME) {
+    } else if (tag == TAG_ID(TAG_LABEL_VOLUME)) {
       builder->node(m_label_volume);
-    } else if (tag == TAG_LABEL_MUTED) {
+    } else if (tag == TAG_ID(TAG_LABEL_MUTED)) {
       builder->node(m_label_muted);
     } else {
       return false;
@@ -259,12 +277,6 @@ namespace modules {
       } else {
         return false;
       }
-
-      for (auto&& mixer : mixers) {
-        if (mixer->wait(0)) {
-          mixer->process_events();
-        }
-      }
     } catch (const exception& err) {
       m_log.err("%s: Failed to handle command (%s)", name(), err.what());
     }
@@ -1,5 +1,13 @@
 #include "modules/backlight.hpp"
 
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "components/scheduler.hpp"
 #include "drawtypes/label.hpp"
 #include "drawtypes/progressbar.hpp"
 #include "drawtypes/ramp.hpp"
@@ -16,16 +24,16 @@ namespace modules {
     if (!file_util::exists(path)) {
       throw module_error("The file '" + path + "' does not exist");
     }
-    m_path = path;
+    m_file = make_unique<reread_file>(path);
   }
 
   float backlight_module::brightness_handle::read() const {
-    return std::strtof(file_util::contents(m_path).c_str(), nullptr);
+    return std::strtof(m_file->read(), nullptr);
   }
 
   backlight_module::backlight_module(const bar_settings& bar, string name_)
-      : inotify_module<backlight_module>(bar, move(name_)) {
-    auto card = m_conf.get(name(), "card");
+      : event_module<backlight_module>(bar, move(name_)) {
+    m_card = m_conf.get(name(), "card");
 
     // Get flag to check if we should add scroll handlers for changing value
     m_scroll = m_conf.get(name(), "enable-scroll", m_scroll);
@@ -44,34 +52,76 @@ namespace modules {
     }
 
     // Build path to the sysfs folder the current/maximum brightness values are located
-    m_path_backlight = string_util::replace(PATH_BACKLIGHT, "%card%", card);
+    m_path_backlight = string_util::replace(PATH_BACKLIGHT, "%card%", m_card);
 
     /*
      * amdgpu drivers set the actual_brightness in a different scale than [0, max_brightness]
      * The only sensible way is to use the 'brightness' file instead
      * Ref: https://github.com/Alexays/Waybar/issues/335
      */
-    std::string brightness_type = ((card.substr(0, 9) == "amdgpu_bl") ? "brightness" : "actual_brightness");
+    std::string brightness_type = ((m_card.substr(0, 9) == "amdgpu_bl") ? "brightness" : "actual_brightness");
     auto path_backlight_val = m_path_backlight + "/" + brightness_type;
 
     m_val.filepath(path_backlight_val);
     m_max.filepath(m_path_backlight + "/max_brightness");
 
-    // Add inotify watch
-    watch(path_backlight_val);
+    /*
+     * Many drivers never notify inotify watches about actual_brightness, but
+     * the backlight class sends a uevent for every change, including writes
+     * to the brightness file.
+     */
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    struct sockaddr_nl addr {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;
+    if (fd == -1) {
+      m_log.warn("%s: Failed to listen for uevents, only polling (err: %s)", name(), strerror(errno));
+    } else if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+      m_log.warn("%s: Failed to listen for uevents, only polling (err: %s)", name(), strerror(errno));
+      close(fd);
+    } else {
+      m_uevents = file_util::make_file_descriptor(fd);
+    }
+  }
+
+  /**
+   * Wait for the brightness write that is still queued
+   */
+  void backlight_module::teardown() {
+    std::unique_lock<std::mutex> guard(m_writelock);
+    m_written.wait(guard, [&] { return !m_write_queued; });
+  }
+
+  vector<int> backlight_module::event_fds() const {
+    return m_uevents ? vector<int>{*m_uevents} : vector<int>{};
+  }
+
+  bool backlight_module::has_event() {
+    // Without uevents the values are polled, update() only reports actual changes
+    return !m_uevents || receive_uevents();
   }
 
   void backlight_module::idle() {
-    sleep(75ms);
+    sleep(1s);
   }
 
-  bool backlight_module::on_event(inotify_event* event) {
-    if (event != nullptr) {
-      m_log.trace("%s: %s", name(), event->filename);
+  bool backlight_module::update() {
+    float max_brightness = m_max.read();
+    int percentage = static_cast<int>(m_val.read() / max_brightness * 100.0f + 0.5f);
+
+    {
+      std::lock_guard<std::mutex> guard(m_writelock);
+      m_max_brightness = max_brightness;
+      // Changes made from now on are relative to the new value
+      if (!m_write_queued) {
+        m_target = -1;
+      }
     }
 
-    m_max_brightness = m_max.read();
-    m_percentage = static_cast<int>(m_val.read() / m_max_brightness * 100.0f + 0.5f);
+    if (percentage == m_percentage) {
+      return false;
+    }
+    m_percentage = percentage;
 
     if (m_label) {
       m_label->reset_tokens();
@@ -81,6 +131,41 @@ namespace modules {
     return true;
   }
 
+  /**
+   * Read all pending uevents
+   *
+   * \returns true if one of them is about the backlight device
+   */
+  bool backlight_module::receive_uevents() {
+    bool relevant{false};
+    char buffer[BUFSIZ];
+    ssize_t size;
+    const string suffix = "/" + m_card;
+    while ((size = recv(*m_uevents, buffer, sizeof(buffer) - 1, MSG_DONTWAIT)) > 0) {
+      buffer[size] = '\0';
+
+      // "ACTION@DEVPATH" followed by null separated KEY=VALUE pairs
+      bool backlight{false};
+      bool ours{false};
+      for (const char* field = buffer; field < buffer + size; field += strlen(field) + 1) {
+        if (strcmp(field, "SUBSYSTEM=backlight") == 0) {
+          backlight = true;
+        } else if (strncmp(field, "DEVPATH=", 8) == 0) {
+          string devpath{field + 8};
+          ours = devpath.size() >= suffix.size() &&
+                 devpath.compare(devpath.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+      }
+      relevant |= backlight && ours;
+    }
+
+    if (size == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      m_log.err("%s: Failed to receive uevents (err: %s)", name(), strerror(errno));
+    }
+
+    return relevant;
+  }
+
   string backlight_module::get_output() {
     // Get the module output early so that
     // the format prefix/suffix also gets wrapped
@@ -100,12 +185,12 @@ namespace modules {
     return m_builder->flush();
   }
 
-  bool backlight_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_BAR) {
+  bool backlight_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_BAR)) {
       builder->node(m_progressbar->output(m_percentage));
-    } else if (tag == TAG_RAMP) {
+    } else if (tag == TAG_ID(TAG_RAMP)) {
       builder->node(m_ramp->get_by_percentage(m_percentage));
-    } else if (tag == TAG_LABEL) {
+    } else if (tag == TAG_ID(TAG_LABEL)) {
       builder->node(m_label);
     } else {
       return false;
@@ -113,6 +198,11 @@ namespace modules {
     return true;
   }
 
+  /**
+   * Change the target brightness, it is written by a worker
+   *
+   * Scrolling faster than the writes are done adds up to a single write.
+   */
   bool backlight_module::input(const string& action, const string&) {
     double value_mod{0.0};
 
@@ -126,19 +216,58 @@ namespace modules {
 
     m_log.info("%s: Changing value by %f%", name(), value_mod);
 
-    try {
-      int rounded = math_util::cap<double>(m_percentage + value_mod, 0.0, 100.0) + 0.5;
-      int value = math_util::percentage_to_value<int>(rounded, m_max_brightness);
-      file_util::write_contents(m_path_backlight + "/brightness", to_string(value));
-    } catch (const exception& err) {
-      m_log.err(
-          "%s: Unable to change backlight value. Your system may require additional "
-          "configuration. Please read the module documentation.\n(reason: %s)",
-          name(), err.what());
+    std::lock_guard<std::mutex> guard(m_writelock);
+    // Checked under the lock, so that teardown() waits for the write queued here
+    if (!running()) {
+      return false;
+    }
+
+    int current = m_target != -1 ? m_target : m_percentage.load();
+    m_target = math_util::cap<double>(current + value_mod, 0.0, 100.0) + 0.5;
+
+    if (!m_write_queued) {
+      m_write_queued = true;
+      scheduler::make().submit([this] { write_brightness(); });
     }
 
     return true;
   }
+
+  /**
+   * Write the target brightness until it stops changing
+   *
+   * The write stays queued meanwhile, so that changes made during a slow
+   * write are picked up by the next round instead of another worker.
+   */
+  void backlight_module::write_brightness() {
+    std::unique_lock<std::mutex> guard(m_writelock);
+    int written{-1};
+
+    while (m_target != written) {
+      written = m_target;
+      auto contents = to_string(math_util::percentage_to_value<int>(written, m_max_brightness));
+      guard.unlock();
+
+      try {
+        if (!m_brightness) {
+          m_brightness = file_util::make_file_descriptor(m_path_backlight + "/brightness", O_WRONLY | O_CLOEXEC);
+        }
+        if (pwrite(*m_brightness, contents.c_str(), contents.size(), 0) == -1) {
+          throw system_error("Failed to write brightness");
+        }
+      } catch (const exception& err) {
+        m_log.err(
+            "%s: Unable to change backlight value. Your system may require additional "
+            "configuration. Please read the module documentation.\n(reason: %s)",
+            name(), err.what());
+      }
+
+      guard.lock();
+    }
+
+    m_write_queued = false;
+    m_written.notify_all();
+  }
 }  // namespace modules
 
 POLYBAR_NS_END
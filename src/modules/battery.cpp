@@ -1,4 +1,13 @@
 #include "modules/battery.hpp"
+
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
 #include "drawtypes/animation.hpp"
 #include "drawtypes/label.hpp"
 #include "drawtypes/progressbar.hpp"
@@ -20,85 +29,128 @@ namespace modules {
     return reader.read();
   }
 
+  namespace {
+    unsigned long read_number(const reread_file& file) {
+      return std::strtoul(file.contents(), nullptr, 10);
+    }
+
+    unique_ptr<file_descriptor> make_timer() {
+      int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      if (fd == -1) {
+        throw module_error("Failed to create timer: "s + strerror(errno));
+      }
+      return file_util::make_file_descriptor(fd);
+    }
+
+    /**
+     * Let the timer expire every `interval`, or never if it is zero
+     */
+    template <typename Duration>
+    void set_timer(const file_descriptor& timer, Duration interval) {
+      auto ns = chrono::duration_cast<chrono::nanoseconds>(interval).count();
+      itimerspec spec{};
+      spec.it_interval.tv_sec = ns / 1000000000;
+      spec.it_interval.tv_nsec = ns % 1000000000;
+      spec.it_value = spec.it_interval;
+      timerfd_settime(timer, 0, &spec, nullptr);
+    }
+
+    /**
+     * Consume the expirations of the timer
+     *
+     * \returns false if it didn't expire since the last call
+     */
+    bool expired(const unique_ptr<file_descriptor>& timer) {
+      uint64_t expirations;
+      return timer && ::read(*timer, &expirations, sizeof(expirations)) == sizeof(expirations);
+    }
+  }  // namespace
+
   /**
    * Bootstrap module by setting up required components
    */
   battery_module::battery_module(const bar_settings& bar, string name_)
-      : inotify_module<battery_module>(bar, move(name_)) {
+      : event_module<battery_module>(bar, move(name_)) {
     // Load configuration values
     m_fullat = math_util::min(m_conf.get(name(), "full-at", m_fullat), 100);
     m_lowat = math_util::max(m_conf.get(name(), "low-at", m_lowat), 0);
     m_interval = m_conf.get<decltype(m_interval)>(name(), "poll-interval", 5s);
-    m_lastpoll = chrono::system_clock::now();
 
-    auto path_adapter = string_util::replace(PATH_ADAPTER, "%adapter%", m_conf.get(name(), "adapter", "ADP1"s)) + "/";
-    auto path_battery = string_util::replace(PATH_BATTERY, "%battery%", m_conf.get(name(), "battery", "BAT0"s)) + "/";
-
-    // Make state reader
-    if (file_util::exists((m_fstate = path_adapter + "online"))) {
-      m_state_reader = make_unique<state_reader>([=] { return file_util::contents(m_fstate).compare(0, 1, "1") == 0; });
-    } else if (file_util::exists((m_fstate = path_battery + "status"))) {
-      m_state_reader =
-          make_unique<state_reader>([=] { return file_util::contents(m_fstate).compare(0, 8, "Charging") == 0; });
-    } else {
-      throw module_error("No suitable way to get current charge state");
+    m_adapter = m_conf.get(name(), "adapter", "ADP1"s);
+    auto path_adapter = string_util::replace(PATH_ADAPTER, "%adapter%", m_adapter) + "/";
+    if (file_util::exists(path_adapter + "online")) {
+      m_adapter_online = make_unique<reread_file>(path_adapter + "online");
     }
 
-    // Make capacity reader
-    if ((m_fcapnow = file_util::pick({path_battery + "charge_now", path_battery + "energy_now"})).empty()) {
-      throw module_error("No suitable way to get current capacity value");
-    } else if ((m_fcapfull = file_util::pick({path_battery + "charge_full", path_battery + "energy_full"})).empty()) {
-      throw module_error("No suitable way to get max capacity value");
-    }
+    // Either a single `battery` or a list of batteries that are shown together
+    auto batteries = m_conf.get_list<string>(name(), "battery", {m_conf.get(name(), "battery", "BAT0"s)});
 
-    m_capacity_reader = make_unique<capacity_reader>([=] {
-      auto cap_now = std::strtoul(file_util::contents(m_fcapnow).c_str(), nullptr, 10);
-      auto cap_max = std::strtoul(file_util::contents(m_fcapfull).c_str(), nullptr, 10);
-      return math_util::percentage(cap_now, 0UL, cap_max);
-    });
+    for (auto&& battery : batteries) {
+      auto path_battery = string_util::replace(PATH_BATTERY, "%battery%", battery) + "/";
+      battery_files files;
+      files.name = battery;
 
-    // Make rate reader
-    if ((m_fvoltage = file_util::pick({path_battery + "voltage_now"})).empty()) {
-      throw module_error("No suitable way to get current voltage value");
-    } else if ((m_frate = file_util::pick({path_battery + "current_now", path_battery + "power_now"})).empty()) {
-      throw module_error("No suitable way to get current charge rate value");
-    }
+      if (!m_adapter_online && file_util::exists(path_battery + "status")) {
+        files.status = make_unique<reread_file>(path_battery + "status");
+      } else if (!m_adapter_online) {
+        throw module_error("No suitable way to get current charge state of " + battery);
+      }
 
-    m_rate_reader = make_unique<rate_reader>([this] {
-      unsigned long rate{std::strtoul(file_util::contents(m_frate).c_str(), nullptr, 10)};
-      unsigned long volt{std::strtoul(file_util::contents(m_fvoltage).c_str(), nullptr, 10) / 1000UL};
-      unsigned long now{std::strtoul(file_util::contents(m_fcapnow).c_str(), nullptr, 10)};
-      unsigned long max{std::strtoul(file_util::contents(m_fcapfull).c_str(), nullptr, 10)};
-      unsigned long cap{read(*m_state_reader) ? max - now : now};
-
-      if (rate && volt && cap) {
-        auto remaining = (cap / volt);
-        auto current_rate = (rate / volt);
-
-        if (remaining && current_rate) {
-          return 3600UL * remaining / current_rate;
-        }
+      string capnow;
+      string capfull;
+      if ((capnow = file_util::pick({path_battery + "charge_now", path_battery + "energy_now"})).empty()) {
+        throw module_error("No suitable way to get current capacity value of " + battery);
+      } else if ((capfull = file_util::pick({path_battery + "charge_full", path_battery + "energy_full"})).empty()) {
+        throw module_error("No suitable way to get max capacity value of " + battery);
+      }
+      files.charge = string_util::contains(capnow, "charge_now");
+      files.capacity_now = make_unique<reread_file>(capnow);
+      files.capacity_full = make_unique<reread_file>(capfull);
+
+      string voltage;
+      string rate;
+      if ((voltage = file_util::pick({path_battery + "voltage_now"})).empty()) {
+        throw module_error("No suitable way to get current voltage value of " + battery);
+      } else if ((rate = file_util::pick({path_battery + "current_now", path_battery + "power_now"})).empty()) {
+        throw module_error("No suitable way to get current charge rate value of " + battery);
       }
+      files.current = string_util::contains(rate, "current_now");
+      files.voltage = make_unique<reread_file>(voltage);
+      files.rate = make_unique<reread_file>(rate);
 
-      return 0UL;
-    });
+      m_batteries.emplace_back(move(files));
+    }
 
-    // Make consumption reader
-    m_consumption_reader = make_unique<consumption_reader>([this] {
-      float consumption;
+    // Everything sample() reads, so that it is read in one batch
+    if (m_adapter_online) {
+      m_sampled.emplace_back(m_adapter_online.get());
+    }
+    for (auto&& battery : m_batteries) {
+      if (battery.status) {
+        m_sampled.emplace_back(battery.status.get());
+      }
+      m_sampled.emplace_back(battery.capacity_now.get());
+      m_sampled.emplace_back(battery.capacity_full.get());
+      m_sampled.emplace_back(battery.rate.get());
+      m_sampled.emplace_back(battery.voltage.get());
+    }
 
-      // if the rate we found was the current, calculate power (P = I*V)
-      if (string_util::contains(m_frate, "current_now")) {
-        unsigned long current{std::strtoul(file_util::contents(m_frate).c_str(), nullptr, 10)};
-        unsigned long voltage{std::strtoul(file_util::contents(m_fvoltage).c_str(), nullptr, 10)};
+    // The readers work on the values that sample() read for all batteries at once
+    m_state_reader = make_unique<state_reader>([this] { return m_sample.charging; });
 
-        consumption = ((voltage / 1000.0) * (current /  1000.0)) / 1e6;
-      // if it was power, just use as is
-      } else {
-        unsigned long power{std::strtoul(file_util::contents(m_frate).c_str(), nullptr, 10)};
+    m_capacity_reader = make_unique<capacity_reader>(
+        [this] { return math_util::percentage(m_sample.energy_now, 0ULL, m_sample.energy_full); });
 
-        consumption = power / 1e6;
+    m_rate_reader = make_unique<rate_reader>([this] {
+      auto remaining = m_sample.charging ? m_sample.energy_full - m_sample.energy_now : m_sample.energy_now;
+      if (m_sample.energy_now > m_sample.energy_full || !m_sample.power) {
+        return 0UL;
       }
+      return static_cast<unsigned long>(3600ULL * remaining / m_sample.power);
+    });
+
+    m_consumption_reader = make_unique<consumption_reader>([this] {
+      float consumption = m_sample.power / 1e6;
 
       // convert to string with 2 decimmal places
       string rtn(16, '\0'); // 16 should be plenty big. Cant see it needing more than 6/7..
@@ -109,6 +161,7 @@ namespace modules {
     });
 
     // Load state and capacity level
+    sample();
     m_state = current_state();
     m_percentage = current_percentage();
 
@@ -148,9 +201,22 @@ namespace modules {
       m_label_full = load_optional_label(m_conf, name(), TAG_LABEL_FULL, "%percentage%%");
     }
 
-    // Create inotify watches
-    watch(m_fcapnow, IN_ACCESS);
-    watch(m_fstate, IN_ACCESS);
+    // Receive the uevents of all power supplies, if that isn't possible they are only polled
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    struct sockaddr_nl addr {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;
+    if (fd == -1) {
+      m_log.warn("%s: Failed to listen for uevents, only polling (err: %s)", name(), strerror(errno));
+    } else if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1) {
+      m_log.warn("%s: Failed to listen for uevents, only polling (err: %s)", name(), strerror(errno));
+      close(fd);
+    } else {
+      m_uevents = file_util::make_file_descriptor(fd);
+    }
+
+    m_poll_timer = make_timer();
+    set_timer(*m_poll_timer, m_interval);
 
     // Setup time if token is used
     if ((m_label_charging && m_label_charging->has_token("%time%")) ||
@@ -163,93 +229,77 @@ namespace modules {
     }
   }
 
-  /**
-   * Dispatch the subthread used to update the
-   * charging animation when the module is started
-   */
-  void battery_module::start() {
-    this->inotify_module::start();
-    // We only start animation thread if there is at least one animation.
-    if (m_animation_charging || m_animation_discharging || m_animation_low) {
-      m_subthread = thread(&battery_module::subthread, this);
+  void battery_module::teardown() {
+    if (m_animation_id != 0) {
+      animation_clock::make().remove(m_animation_id);
+      m_animation_id = 0;
     }
   }
 
-  /**
-   * Release wake lock when stopping the module
-   */
-  void battery_module::teardown() {
-    if (m_subthread.joinable()) {
-      m_subthread.join();
+  vector<int> battery_module::event_fds() const {
+    vector<int> fds{*m_poll_timer};
+    if (m_uevents) {
+      fds.emplace_back(*m_uevents);
     }
+    return fds;
   }
 
   /**
-   * Idle between polling inotify watches for events.
-   *
-   * If the defined interval has been reached, trigger a manual
-   * poll in case the inotify events aren't fired.
-   *
-   * This fallback is needed because some systems won't
-   * report inotify events for files on sysfs.
+   * Note what has to be updated, the reactor only calls this once a descriptor is readable
    */
-  void battery_module::idle() {
-    if (m_interval.count() > 0) {
-      auto now = chrono::system_clock::now();
-      if (chrono::duration_cast<decltype(m_interval)>(now - m_lastpoll) > m_interval) {
-        m_lastpoll = now;
-        m_log.info("%s: Polling values (inotify fallback)", name());
-        read(*m_capacity_reader);
-      }
+  bool battery_module::has_event() {
+    if (receive_uevents() || expired(m_poll_timer)) {
+      m_values_due = true;
     }
-
-    this->inotify_module::idle();
+    return m_values_due;
   }
 
   /**
-   * Update values when tracked files have changed
+   * Update the values if the battery changed or has to be polled
    */
-  bool battery_module::on_event(inotify_event* event) {
-    auto state = current_state();
-    auto percentage = current_percentage();
-
-    // Reset timer to avoid unnecessary polling
-    m_lastpoll = chrono::system_clock::now();
-
-    if (event != nullptr) {
-      m_log.trace("%s: Inotify event reported for %s", name(), event->filename);
-
-      if (state == m_state && percentage == m_percentage && m_unchanged--) {
-        return false;
-      }
-
-      m_unchanged = SKIP_N_UNCHANGED;
-    }
-
-    m_state = state;
-    m_percentage = percentage;
-
-    const auto label = [this] {
-      switch (m_state) {
-        case battery_module::state::FULL: return m_label_full;
-        case battery_module::state::DISCHARGING: return m_label_discharging;
-        case battery_module::state::LOW: return m_label_low;
-        default: return m_label_charging;
-      }
-    }();
-
-    if (label) {
-      label->reset_tokens();
-      label->replace_token("%percentage%", to_string(clamp_percentage(m_percentage, m_state)));
-      label->replace_token("%percentage_raw%", to_string(m_percentage));
-      label->replace_token("%consumption%", current_consumption());
+  bool battery_module::update() {
+    bool changed{false};
+
+    if (m_values_due) {
+      m_values_due = false;
+      sample();
+      auto state = current_state();
+      auto percentage = current_percentage();
+
+      // Polling starts over after every reading
+      set_timer(*m_poll_timer, m_interval);
+
+      if (state != m_state || percentage != m_percentage || !m_unchanged--) {
+        m_unchanged = SKIP_N_UNCHANGED;
+        m_state = state;
+        m_percentage = percentage;
+
+        const auto label = [this] {
+          switch (m_state) {
+            case battery_module::state::FULL: return m_label_full;
+            case battery_module::state::DISCHARGING: return m_label_discharging;
+            case battery_module::state::LOW: return m_label_low;
+            default: return m_label_charging;
+          }
+        }();
+
+        if (label) {
+          label->reset_tokens();
+          label->replace_token("%percentage%", to_string(clamp_percentage(m_percentage, m_state)));
+          label->replace_token("%percentage_raw%", to_string(m_percentage));
+          label->replace_token("%consumption%", current_consumption());
+
+          if (m_state != battery_module::state::FULL && !m_timeformat.empty()) {
+            label->replace_token("%time%", current_time());
+          }
+        }
 
-      if (m_state != battery_module::state::FULL && !m_timeformat.empty()) {
-        label->replace_token("%time%", current_time());
+        changed = true;
       }
     }
 
-    return true;
+    update_animation();
+    return changed;
   }
 
   /**
@@ -271,24 +321,24 @@ namespace modules {
   /**
    * Generate module output using defined drawtypes
    */
-  bool battery_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_ANIMATION_CHARGING) {
+  bool battery_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_ANIMATION_CHARGING)) {
       builder->node(m_animation_charging->get());
-    } else if (tag == TAG_ANIMATION_DISCHARGING) {
+    } else if (tag == TAG_ID(TAG_ANIMATION_DISCHARGING)) {
       builder->node(m_animation_discharging->get());
-    } else if (tag == TAG_ANIMATION_LOW) {
+    } else if (tag == TAG_ID(TAG_ANIMATION_LOW)) {
       builder->node(m_animation_low->get());
-    } else if (tag == TAG_BAR_CAPACITY) {
+    } else if (tag == TAG_ID(TAG_BAR_CAPACITY)) {
       builder->node(m_bar_capacity->output(clamp_percentage(m_percentage, m_state)));
-    } else if (tag == TAG_RAMP_CAPACITY) {
+    } else if (tag == TAG_ID(TAG_RAMP_CAPACITY)) {
       builder->node(m_ramp_capacity->get_by_percentage_with_borders(m_percentage, m_lowat, m_fullat));
-    } else if (tag == TAG_LABEL_CHARGING) {
+    } else if (tag == TAG_ID(TAG_LABEL_CHARGING)) {
       builder->node(m_label_charging);
-    } else if (tag == TAG_LABEL_DISCHARGING) {
+    } else if (tag == TAG_ID(TAG_LABEL_DISCHARGING)) {
       builder->node(m_label_discharging);
-    } else if (tag == TAG_LABEL_LOW) {
+    } else if (tag == TAG_ID(TAG_LABEL_LOW)) {
       builder->node(m_label_low);
-    } else if (tag == TAG_LABEL_FULL) {
+    } else if (tag == TAG_ID(TAG_LABEL_FULL)) {
       builder->node(m_label_full);
     } else {
       return false;
@@ -297,6 +347,47 @@ namespace modules {
     return true;
   }
 
+  /**
+   * Read the values of all batteries
+   *
+   * Charges and currents are converted to energy and power, so that
+   * batteries that report different units can be added up.
+   */
+  void battery_module::sample() {
+    battery_sample sample;
+    reread_file::read_all(m_sampled);
+
+    if (m_adapter_online) {
+      sample.charging = strncmp(m_adapter_online->contents(), "1", 1) == 0;
+    }
+
+    for (auto&& battery : m_batteries) {
+      if (battery.status && strncmp(battery.status->contents(), "Charging", 8) == 0) {
+        sample.charging = true;
+      }
+
+      unsigned long long voltage{read_number(*battery.voltage)};
+      unsigned long long now{read_number(*battery.capacity_now)};
+      unsigned long long full{read_number(*battery.capacity_full)};
+      unsigned long long rate{read_number(*battery.rate)};
+
+      if (battery.charge) {
+        now = now * voltage / 1000000ULL;
+        full = full * voltage / 1000000ULL;
+      }
+      if (battery.current) {
+        // P = I*V
+        rate = rate * voltage / 1000000ULL;
+      }
+
+      sample.energy_now += now;
+      sample.energy_full += full;
+      sample.power += rate;
+    }
+
+    m_sample = sample;
+  }
+
   /**
    * Get the current battery state
    */
@@ -355,37 +446,76 @@ namespace modules {
   }
 
   /**
-   * Subthread runner that emits update events to refresh <animation-charging>
-   * or <animation-discharging> in case they are used. Note, that it is ok to
-   * use a single thread, because the two animations are never shown at the
-   * same time.
+   * Read all pending uevents
+   *
+   * \returns true if one of them is about the battery or the adapter
    */
-  void battery_module::subthread() {
-    m_log.trace("%s: Start of subthread", name());
-
-    while (running()) {
-      auto now = chrono::steady_clock::now();
-      auto framerate = 1000U;  // milliseconds
-      if (m_state == battery_module::state::CHARGING && m_animation_charging) {
-        m_animation_charging->increment();
-        broadcast();
-        framerate = m_animation_charging->framerate();
-      } else if (m_state == battery_module::state::DISCHARGING && m_animation_discharging) {
-        m_animation_discharging->increment();
-        broadcast();
-        framerate = m_animation_discharging->framerate();
-      } else if (m_state == battery_module::state::LOW && m_animation_low) {
-        m_animation_low->increment();
-        broadcast();
-        framerate = m_animation_low->framerate();
+  bool battery_module::receive_uevents() {
+    if (!m_uevents) {
+      return false;
+    }
+
+    bool relevant{false};
+    char buffer[BUFSIZ];
+    ssize_t size;
+    while ((size = recv(*m_uevents, buffer, sizeof(buffer) - 1, MSG_DONTWAIT)) > 0) {
+      buffer[size] = '\0';
+
+      // "ACTION@DEVPATH" followed by null separated KEY=VALUE pairs
+      bool power_supply{false};
+      bool ours{false};
+      for (const char* field = buffer; field < buffer + size; field += strlen(field) + 1) {
+        if (strcmp(field, "SUBSYSTEM=power_supply") == 0) {
+          power_supply = true;
+        } else if (strncmp(field, "POWER_SUPPLY_NAME=", 18) == 0) {
+          ours = field + 18 == m_adapter ||
+                 std::any_of(m_batteries.begin(), m_batteries.end(),
+                     [&](const battery_files& battery) { return field + 18 == battery.name; });
+        }
       }
+      relevant |= power_supply && ours;
+    }
 
-      // We don't count the the first part of the loop to be as close as possible to the framerate.
-      now += chrono::milliseconds(framerate);
-      this_thread::sleep_until(now);
+    if (size == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      m_log.err("%s: Failed to receive uevents (err: %s)", name(), strerror(errno));
     }
 
-    m_log.trace("%s: End of subthread", name());
+    return relevant;
+  }
+
+  /**
+   * The animation shown in the current state
+   */
+  animation_t battery_module::current_animation() const {
+    switch (m_state) {
+      case battery_module::state::CHARGING: return m_animation_charging;
+      case battery_module::state::DISCHARGING: return m_animation_discharging;
+      case battery_module::state::LOW: return m_animation_low;
+      default: return nullptr;
+    }
+  }
+
+  /**
+   * Let the animation clock advance the animation of the current state
+   *
+   * Only one animation is shown at a time, so only that one is registered.
+   */
+  void battery_module::update_animation() {
+    auto animation = current_animation();
+    if (animation == m_animated) {
+      return;
+    }
+
+    auto& clock = animation_clock::make();
+    if (m_animation_id != 0) {
+      clock.remove(m_animation_id);
+      m_animation_id = 0;
+    }
+
+    m_animated = animation;
+    if (m_animated) {
+      m_animation_id = clock.add(m_animated, [this] { broadcast(); });
+    }
   }
 }  // namespace modules
 
@@ -1,7 +1,5 @@
 #include "modules/bspwm.hpp"
 
-#include <sys/socket.h>
-
 #include "drawtypes/iconset.hpp"
 #include "drawtypes/label.hpp"
 #include "modules/meta/base.inl"
@@ -47,9 +45,6 @@ namespace modules {
       throw module_error("Could not find socket: " + (socket_path.empty() ? "<empty>" : socket_path));
     }
 
-    // Create ipc subscriber
-    m_subscriber = bspwm_util::make_subscriber();
-
     // Load configuration values
     m_pinworkspaces = m_conf.get(name(), "pin-workspaces", m_pinworkspaces);
     m_click = m_conf.get(name(), "enable-click", m_click);
@@ -136,59 +131,33 @@ namespace modules {
         m_icons->add(vec[0], factory_util::shared<label>(vec[1]));
       }
     }
+
+    m_events = bspwm_util::hub::make().subscribe();
+    m_report = m_events->take();
   }
 
-  void bspwm_module::stop() {
-    if (m_subscriber) {
-      m_log.info("%s: Disconnecting from socket", name());
-      m_subscriber->disconnect();
-    }
-    event_module::stop();
+  int bspwm_module::event_fd() const {
+    return m_events ? m_events->fd() : -1;
   }
 
   bool bspwm_module::has_event() {
-    if (m_subscriber->poll(POLLHUP, 0)) {
-      m_log.notice("%s: Reconnecting to socket...", name());
-      m_subscriber = bspwm_util::make_subscriber();
+    auto latest = m_events->take();
+    if (!latest || latest == m_report) {
+      return false;
     }
-    return m_subscriber->peek(1);
+    m_report = move(latest);
+    return true;
   }
 
   bool bspwm_module::update() {
-    if (!m_subscriber) {
-      return false;
-    }
-
-    string data{m_subscriber->receive(BUFSIZ)};
-    bool result = false;
-
-    for (auto&& status_line : string_util::split(data, '\n')) {
-      // Need to return true if ANY of the handle_status calls
-      // return true
-      result = this->handle_status(status_line) || result;
-    }
-
-    return result;
+    return m_report && handle_status(*m_report);
   }
 
-  bool bspwm_module::handle_status(string& data) {
-    if (data.empty()) {
-      return false;
-    }
-
+  /**
+   * Parse a report, the hub only passes on valid reports that changed
+   */
+  bool bspwm_module::handle_status(string data) {
     size_t prefix_len{strlen(BSPWM_STATUS_PREFIX)};
-    if (data.compare(0, prefix_len, BSPWM_STATUS_PREFIX) != 0) {
-      m_log.err("%s: Unknown status '%s'", name(), data);
-      return false;
-    }
-
-    string_util::hash_type hash;
-    if ((hash = string_util::hash(data)) == m_hash) {
-      return false;
-    }
-
-    m_hash = hash;
-
     size_t pos;
 
     // Extract the string for the defined monitor
@@ -219,11 +188,31 @@ namespace modules {
 
     m_log.info("%s: Parsing socket data: %s", name(), data);
 
-    m_monitors.clear();
+    // Labels of the last report are reused for monitors, workspaces and modes that didn't change
+    vector<unique_ptr<bspwm_monitor>> previous;
+    std::swap(previous, m_monitors);
+    const bspwm_monitor* last{nullptr};
+
+    const auto add_mode = [&](mode flag) {
+      auto& modes = m_monitors.back()->modes;
+      if (last && modes.size() < last->modes.size() && last->modes[modes.size()].first == flag) {
+        modes.emplace_back(last->modes[modes.size()]);
+      } else {
+        modes.emplace_back(flag, m_modelabels.find(flag)->second->clone());
+      }
+    };
 
     size_t workspace_n{0U};
 
-    for (auto&& tag : string_util::split(data, ':')) {
+    for (size_t start = 0U, end = 0U; start < data.size(); start = end + 1) {
+      if ((end = data.find(':', start)) == string::npos) {
+        end = data.size();
+      }
+      if (end == start) {
+        continue;
+      }
+
+      auto tag = data.substr(start, end - start);
       auto value = tag.substr(1);
       auto mode_flag = mode::NONE;
       unsigned int workspace_mask{0U};
@@ -232,7 +221,17 @@ namespace modules {
         m_monitors.emplace_back(factory_util::unique<bspwm_monitor>());
         m_monitors.back()->name = value;
 
-        if (m_monitorlabel) {
+        last = nullptr;
+        for (auto&& mon : previous) {
+          if (mon->name == value) {
+            last = mon.get();
+            break;
+          }
+        }
+
+        if (last && last->label) {
+          m_monitors.back()->label = last->label;
+        } else if (m_monitorlabel) {
           m_monitors.back()->label = m_monitorlabel->clone();
           m_monitors.back()->label->replace_token("%name%", value);
         }
@@ -324,7 +323,7 @@ namespace modules {
             }
 
             if (mode_flag != mode::NONE && !m_modelabels.empty()) {
-              m_monitors.back()->modes.emplace_back(m_modelabels.find(mode_flag)->second->clone());
+              add_mode(mode_flag);
             }
           }
           continue;
@@ -334,49 +333,75 @@ namespace modules {
           continue;
       }
 
-      if (!m_monitors.back()) {
+      if (m_monitors.empty()) {
         m_log.warn("%s: No monitor created", name());
         continue;
       }
 
       if (workspace_mask && m_formatter->has(TAG_LABEL_STATE)) {
-        auto icon = m_icons->get(value, DEFAULT_ICON, m_fuzzy_match);
-        auto label = m_statelabels.at(workspace_mask)->clone();
+        auto& workspaces = m_monitors.back()->workspaces;
+        bspwm_workspace ws{workspace_mask, nullptr, value, ++workspace_n, !m_monitors.back()->focused};
 
-        if (!m_monitors.back()->focused) {
-          if (m_statelabels[make_mask(state::DIMMED)]) {
-            label->replace_defined_values(m_statelabels[make_mask(state::DIMMED)]);
-          }
-          if (workspace_mask & make_mask(state::EMPTY)) {
-            label->replace_defined_values(m_statelabels[make_mask(state::DIMMED, state::EMPTY)]);
-          }
-          if (workspace_mask & make_mask(state::OCCUPIED)) {
-            label->replace_defined_values(m_statelabels[make_mask(state::DIMMED, state::OCCUPIED)]);
-          }
-          if (workspace_mask & make_mask(state::FOCUSED)) {
-            label->replace_defined_values(m_statelabels[make_mask(state::DIMMED, state::FOCUSED)]);
-          }
-          if (workspace_mask & make_mask(state::URGENT)) {
-            label->replace_defined_values(m_statelabels[make_mask(state::DIMMED, state::URGENT)]);
+        if (last && workspaces.size() < last->workspaces.size()) {
+          const auto& prev = last->workspaces[workspaces.size()];
+          if (prev.mask == ws.mask && prev.name == ws.name && prev.index == ws.index && prev.dimmed == ws.dimmed) {
+            ws.label = prev.label;
           }
         }
 
-        label->reset_tokens();
-        label->replace_token("%name%", value);
-        label->replace_token("%icon%", icon->get());
-        label->replace_token("%index%", to_string(++workspace_n));
+        if (!ws.label) {
+          ws.label = make_workspace_label(ws.mask, ws.name, ws.index, ws.dimmed);
+        }
 
-        m_monitors.back()->workspaces.emplace_back(workspace_mask, move(label));
+        workspaces.emplace_back(move(ws));
       }
 
       if (mode_flag != mode::NONE && !m_modelabels.empty()) {
-        m_monitors.back()->modes.emplace_back(m_modelabels.find(mode_flag)->second->clone());
+        add_mode(mode_flag);
       }
     }
 
     return true;
   }
 
+  /**
+   * Create the label of a workspace with the given state
+   */
+  label_t bspwm_module::make_workspace_label(unsigned int mask, const string& name, size_t index, bool dimmed) const {
+    auto icon = m_icons->get(name, DEFAULT_ICON, m_fuzzy_match);
+    auto label = m_statelabels.at(mask)->clone();
+
+    if (dimmed) {
+      const auto dim = [&](unsigned int dimmed_mask) {
+        auto it = m_statelabels.find(dimmed_mask);
+        if (it != m_statelabels.end() && it->second) {
+          label->replace_defined_values(it->second);
+        }
+      };
+
+      dim(make_mask(state::DIMMED));
+      if (mask & make_mask(state::EMPTY)) {
+        dim(make_mask(state::DIMMED, state::EMPTY));
+      }
+      if (mask & make_mask(state::OCCUPIED)) {
+        dim(make_mask(state::DIMMED, state::OCCUPIED));
+      }
+      if (mask & make_mask(state::FOCUSED)) {
+        dim(make_mask(state::DIMMED, state::FOCUSED));
+      }
+      if (mask & make_mask(state::URGENT)) {
+        dim(make_mask(state::DIMMED, state::URGENT));
+      }
+    }
+
+    label->reset_tokens();
+    label->replace_token("%name%", name);
+    label->replace_token("%icon%", icon->get());
+    label->replace_token("%index%", to_string(index));
+
+    return label;
+  }
+
   string bspwm_module::get_output() {
     string output;
     for (m_index = 0U; m_index < m_monitors.size(); m_index++) {
@@ -388,11 +413,11 @@ namespace modules {
     return output;
   }
 
-  bool bspwm_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL_MONITOR) {
+  bool bspwm_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL_MONITOR)) {
       builder->node(m_monitors[m_index]->label);
       return true;
-    } else if (tag == TAG_LABEL_STATE && !m_monitors[m_index]->workspaces.empty()) {
+    } else if (tag == TAG_ID(TAG_LABEL_STATE) && !m_monitors[m_index]->workspaces.empty()) {
       size_t workspace_n{0U};
 
       if (m_scroll) {
@@ -401,7 +426,7 @@ namespace modules {
       }
 
       for (auto&& ws : m_monitors[m_index]->workspaces) {
-        if (ws.second.get()) {
+        if (ws.label.get()) {
           if (workspace_n != 0 && *m_labelseparator) {
             builder->node(m_labelseparator);
           }
@@ -409,14 +434,14 @@ namespace modules {
           workspace_n++;
 
           if (m_click) {
-            builder->action(mousebtn::LEFT, *this, EVENT_FOCUS, sstream() << m_index << "+" << workspace_n, ws.second);
+            builder->action(mousebtn::LEFT, *this, EVENT_FOCUS, sstream() << m_index << "+" << workspace_n, ws.label);
           } else {
-            builder->node(ws.second);
+            builder->node(ws.label);
           }
 
-          if (m_inlinemode && m_monitors[m_index]->focused && check_mask(ws.first, bspwm_state::FOCUSED)) {
+          if (m_inlinemode && m_monitors[m_index]->focused && check_mask(ws.mask, bspwm_state::FOCUSED)) {
             for (auto&& mode : m_monitors[m_index]->modes) {
-              builder->node(mode);
+              builder->node(mode.second);
             }
           }
         }
@@ -428,13 +453,13 @@ namespace modules {
       }
 
       return workspace_n > 0;
-    } else if (tag == TAG_LABEL_MODE && !m_inlinemode && m_monitors[m_index]->focused &&
+    } else if (tag == TAG_ID(TAG_LABEL_MODE) && !m_inlinemode && m_monitors[m_index]->focused &&
                !m_monitors[m_index]->modes.empty()) {
       int modes_n = 0;
 
       for (auto&& mode : m_monitors[m_index]->modes) {
-        if (mode && *mode) {
-          builder->node(mode);
+        if (mode.second && *mode.second) {
+          builder->node(mode.second);
           modes_n++;
         }
       }
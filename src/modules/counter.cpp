@@ -18,8 +18,8 @@ namespace modules {
     return true;
   }
 
-  bool counter_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_COUNTER) {
+  bool counter_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_COUNTER)) {
       builder->node(to_string(m_counter));
       return true;
     }
@@ -1,12 +1,17 @@
-#include <fstream>
-#include <istream>
-
 #include "modules/cpu.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+
+#include "components/data_source.hpp"
 #include "drawtypes/label.hpp"
 #include "drawtypes/progressbar.hpp"
 #include "drawtypes/ramp.hpp"
+#include "utils/file.hpp"
 #include "utils/math.hpp"
+#include "utils/string.hpp"
 
 #include "modules/meta/base.inl"
 
@@ -15,13 +20,74 @@ POLYBAR_NS
 namespace modules {
   template class module<cpu_module>;
 
+  namespace {
+    /**
+     * Parse the number at `pos`, skipping the spaces in front of it
+     *
+     * Missing fields at the end of a line are read as 0.
+     */
+    unsigned long long parse_field(const char*& pos) {
+      while (*pos == ' ') {
+        pos++;
+      }
+      unsigned long long value{0};
+      while (*pos >= '0' && *pos <= '9') {
+        value = value * 10 + static_cast<unsigned long long>(*pos++ - '0');
+      }
+      return value;
+    }
+
+    /**
+     * Parse a list of cpus like "0-3,8,10-11"
+     */
+    vector<unsigned long> parse_cpulist(const string& list) {
+      vector<unsigned long> cpus;
+      for (auto&& range : string_util::split(string_util::trim(string{list}, '\n'), ',')) {
+        auto dash = range.find('-');
+        auto first = std::strtoul(range.c_str(), nullptr, 10);
+        auto last = dash == string::npos ? first : std::strtoul(range.c_str() + dash + 1, nullptr, 10);
+        for (auto cpu = first; cpu <= last; cpu++) {
+          cpus.emplace_back(cpu);
+        }
+      }
+      return cpus;
+    }
+
+    /**
+     * Id at the end of a sysfs path like ".../node1" or ".../cpu12"
+     */
+    unsigned long path_id(const string& path) {
+      auto pos = path.find_last_not_of("0123456789");
+      return std::strtoul(path.c_str() + pos + 1, nullptr, 10);
+    }
+  }  // namespace
+
   cpu_module::cpu_module(const bar_settings& bar, string name_) : timer_module<cpu_module>(bar, move(name_)) {
     set_interval(1s);
     m_totalwarn = m_conf.get(name(), "warn-percentage", m_totalwarn);
     m_ramp_padding = m_conf.get<decltype(m_ramp_padding)>(name(), "ramp-coreload-spacing", 1);
+    m_top = m_conf.get(name(), "ramp-coreload-top", m_top);
+    m_histogram = m_conf.get(name(), "ramp-coreload-histogram", m_histogram);
+
+    auto grouping = m_conf.get(name(), "ramp-coreload-group", string{"core"});
+    if (grouping == "node") {
+      m_grouping = coreload_group::NODE;
+    } else if (grouping == "package") {
+      m_grouping = coreload_group::PACKAGE;
+    } else if (grouping != "core") {
+      throw module_error("Invalid ramp-coreload-group \"" + grouping + "\", expected core, node or package");
+    }
+
+    m_formatter->add(
+        DEFAULT_FORMAT, TAG_LABEL, {TAG_LABEL, TAG_BAR_LOAD, TAG_RAMP_LOAD, TAG_RAMP_LOAD_PER_CORE, TAG_GRAPH_LOAD});
+    m_formatter->add_optional(
+        FORMAT_WARN, {TAG_LABEL_WARN, TAG_BAR_LOAD, TAG_RAMP_LOAD, TAG_RAMP_LOAD_PER_CORE, TAG_GRAPH_LOAD});
 
-    m_formatter->add(DEFAULT_FORMAT, TAG_LABEL, {TAG_LABEL, TAG_BAR_LOAD, TAG_RAMP_LOAD, TAG_RAMP_LOAD_PER_CORE});
-    m_formatter->add_optional(FORMAT_WARN, {TAG_LABEL_WARN, TAG_BAR_LOAD, TAG_RAMP_LOAD, TAG_RAMP_LOAD_PER_CORE});
+    try {
+      m_stat = make_unique<reread_file>(PATH_CPU_INFO);
+    } catch (const system_error& e) {
+      m_log.err("%s: Failed to open %s (what: %s)", name(), PATH_CPU_INFO, e.what());
+    }
 
     // warmup cpu times
     read_values();
@@ -41,6 +107,20 @@ namespace modules {
     }
     if (m_formatter->has(TAG_RAMP_LOAD_PER_CORE)) {
       m_rampload_core = load_ramp(m_conf, name(), TAG_RAMP_LOAD_PER_CORE);
+      read_topology();
+    }
+    if (m_formatter->has(TAG_GRAPH_LOAD)) {
+      m_graph_width = m_conf.get(name(), "graph-load-width", m_graph_width);
+    }
+
+    bool history = m_formatter->has(TAG_GRAPH_LOAD);
+    for (auto&& label : {m_label, m_labelwarn}) {
+      for (auto&& token : {"%percentage-avg%", "%percentage-min%", "%percentage-max%"}) {
+        history |= label && label->has_token(token);
+      }
+    }
+    if (history) {
+      m_history.resize(history_size());
     }
   }
 
@@ -52,7 +132,7 @@ namespace modules {
     m_total = 0.0f;
     m_load.clear();
 
-    auto cores_n = m_cputimes.size();
+    auto cores_n = m_cputimes->size();
     if (!cores_n) {
       return false;
     }
@@ -69,12 +149,16 @@ namespace modules {
     }
 
     m_total = m_total / static_cast<float>(cores_n);
+    m_history.push(m_total);
 
     const auto replace_tokens = [&](label_t& label) {
       label->reset_tokens();
       label->replace_token("%percentage%", to_string(static_cast<int>(m_total + 0.5)));
       label->replace_token("%percentage-sum%", to_string(static_cast<int>(m_total * static_cast<float>(cores_n) + 0.5)));
       label->replace_token("%percentage-cores%", string_util::join(percentage_cores, "% ") + "%");
+      label->replace_token("%percentage-avg%", to_string(static_cast<int>(m_history.mean() + 0.5)));
+      label->replace_token("%percentage-min%", to_string(static_cast<int>(m_history.min() + 0.5f)));
+      label->replace_token("%percentage-max%", to_string(static_cast<int>(m_history.max() + 0.5f)));
 
       for (size_t i = 0; i < percentage_cores.size(); i++) {
         label->replace_token("%percentage-core" + to_string(i + 1) + "%", percentage_cores[i]);
@@ -87,6 +171,9 @@ namespace modules {
     if (m_labelwarn) {
       replace_tokens(m_labelwarn);
     }
+    if (m_rampload_core) {
+      update_coreloads();
+    }
 
     return true;
   }
@@ -100,76 +187,105 @@ namespace modules {
   }
 
 
-  bool cpu_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL) {
+  bool cpu_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL)) {
       builder->node(m_label);
-    } else if (tag == TAG_LABEL_WARN) {
+    } else if (tag == TAG_ID(TAG_LABEL_WARN)) {
       builder->node(m_labelwarn);
-    } else if (tag == TAG_BAR_LOAD) {
+    } else if (tag == TAG_ID(TAG_BAR_LOAD)) {
       builder->node(m_barload->output(m_total));
-    } else if (tag == TAG_RAMP_LOAD) {
+    } else if (tag == TAG_ID(TAG_RAMP_LOAD)) {
       builder->node(m_rampload->get_by_percentage_with_borders(m_total, 0.0f, m_totalwarn));
-    } else if (tag == TAG_RAMP_LOAD_PER_CORE) {
+    } else if (tag == TAG_ID(TAG_RAMP_LOAD_PER_CORE)) {
       auto i = 0;
-      for (auto&& load : m_load) {
+      for (auto&& load : m_coreloads) {
         if (i++ > 0) {
           builder->space(m_ramp_padding);
         }
-        builder->node(m_rampload_core->get_by_percentage_with_borders(load, 0.0f, m_totalwarn));
+        if (m_histogram) {
+          builder->node(m_rampload_core->get_by_percentage(load));
+        } else {
+          builder->node(m_rampload_core->get_by_percentage_with_borders(load, 0.0f, m_totalwarn));
+        }
       }
       builder->node(builder->flush());
+    } else if (tag == TAG_ID(TAG_GRAPH_LOAD)) {
+      builder->graph(tags::graph_type::SPARKLINE, m_graph_width, m_history.values());
     } else {
       return false;
     }
     return true;
   }
 
+  /**
+   * Take the next cpu times, modules that update at about the same time share them
+   */
   bool cpu_module::read_values() {
-    m_cputimes_prev.swap(m_cputimes);
-    m_cputimes.clear();
+    auto max_age = chrono::duration_cast<data_source<cpu_times>::clock::duration>(m_interval / 2);
+    auto times = data_source<cpu_times>::make().get(PATH_CPU_INFO, max_age, [this] {
+      cpu_times result;
+      if (!m_stat) {
+        return result;
+      }
+      result.reserve(m_cores);
 
-    try {
-      std::ifstream in(PATH_CPU_INFO);
-      string str;
+      try {
+        const char* pos = m_stat->read();
 
-      while (std::getline(in, str) && str.compare(0, 3, "cpu") == 0) {
-        // skip line with accumulated value
-        if (str.compare(0, 4, "cpu ") == 0) {
-          continue;
-        }
+        while (strncmp(pos, "cpu", 3) == 0) {
+          pos += 3;
+
+          // skip line with accumulated value
+          if (*pos != ' ') {
+            // Offline cpus have no line, so the cpu id doesn't have to match the index
+            auto id = static_cast<unsigned int>(parse_field(pos));
 
-        auto values = string_util::split(str, ' ');
+            // user nice system idle iowait irq softirq steal
+            unsigned long long fields[8];
+            for (auto&& field : fields) {
+              field = parse_field(pos);
+            }
 
-        m_cputimes.emplace_back(new cpu_time);
-        m_cputimes.back()->user = std::stoull(values[1], nullptr, 10);
-        m_cputimes.back()->nice = std::stoull(values[2], nullptr, 10);
-        m_cputimes.back()->system = std::stoull(values[3], nullptr, 10);
-        m_cputimes.back()->idle = std::stoull(values[4], nullptr, 10);
-        m_cputimes.back()->steal = std::stoull(values[8], nullptr, 10);
-        m_cputimes.back()->total = m_cputimes.back()->user + m_cputimes.back()->nice + m_cputimes.back()->system +
-                                   m_cputimes.back()->idle + m_cputimes.back()->steal;
+            result.emplace_back(cpu_time{fields[0], fields[1], fields[2], fields[3], fields[7],
+                fields[0] + fields[1] + fields[2] + fields[3] + fields[7], id});
+          }
+
+          if ((pos = strchr(pos, '\n')) == nullptr) {
+            break;
+          }
+          pos++;
+        }
+      } catch (const system_error& e) {
+        m_log.err("Failed to read CPU values (what: %s)", e.what());
       }
-    } catch (const std::ios_base::failure& e) {
-      m_log.err("Failed to read CPU values (what: %s)", e.what());
+
+      m_cores = result.size();
+      return result;
+    });
+
+    // An update right after the last one gets the same reading again, comparing it to itself would show no load
+    if (times != m_cputimes) {
+      m_cputimes_prev = move(m_cputimes);
+      m_cputimes = move(times);
     }
 
-    return !m_cputimes.empty();
+    return !m_cputimes->empty();
   }
 
   float cpu_module::get_load(size_t core) const {
-    if (m_cputimes.empty() || m_cputimes_prev.empty()) {
+    if (!m_cputimes || !m_cputimes_prev) {
       return 0;
-    } else if (core >= m_cputimes.size() || core >= m_cputimes_prev.size()) {
+    } else if (core >= m_cputimes->size() || core >= m_cputimes_prev->size()) {
       return 0;
     }
 
-    auto& last = m_cputimes[core];
-    auto& prev = m_cputimes_prev[core];
+    auto& last = (*m_cputimes)[core];
+    auto& prev = (*m_cputimes_prev)[core];
 
-    auto last_idle = last->idle;
-    auto prev_idle = prev->idle;
+    auto last_idle = last.idle;
+    auto prev_idle = prev.idle;
 
-    auto diff = last->total - prev->total;
+    auto diff = last.total - prev.total;
 
     if (diff == 0) {
       return 0;
@@ -179,6 +295,100 @@ namespace modules {
 
     return math_util::cap<float>(percentage, 0, 100);
   }
+
+  /**
+   * Map each cpu to its NUMA node or package for the grouped <ramp-coreload>
+   *
+   * Cpus whose group is unknown are put into the first group. Falls back to
+   * one ramp per core if the topology can't be read.
+   */
+  void cpu_module::read_topology() {
+    if (m_grouping == coreload_group::CORE) {
+      return;
+    }
+
+    // Group ids aren't necessarily contiguous, they are numbered in order
+    std::map<unsigned long, vector<unsigned long>> groups;
+
+    if (m_grouping == coreload_group::NODE) {
+      for (auto&& node : file_util::glob("/sys/devices/system/node/node[0-9]*")) {
+        groups[path_id(node)] = parse_cpulist(file_util::contents(node + "/cpulist"));
+      }
+    } else {
+      for (auto&& cpu : file_util::glob("/sys/devices/system/cpu/cpu[0-9]*")) {
+        auto package = file_util::contents(cpu + "/topology/physical_package_id");
+        if (!package.empty()) {
+          groups[std::strtoul(package.c_str(), nullptr, 10)].emplace_back(path_id(cpu));
+        }
+      }
+    }
+
+    if (groups.empty()) {
+      m_log.warn("%s: Failed to read the cpu topology, showing the load of every core", name());
+      m_grouping = coreload_group::CORE;
+      return;
+    }
+
+    m_cpu_group.clear();
+    m_groups = 0;
+    for (auto&& group : groups) {
+      for (auto&& cpu : group.second) {
+        if (cpu >= m_cpu_group.size()) {
+          m_cpu_group.resize(cpu + 1, 0);
+        }
+        m_cpu_group[cpu] = m_groups;
+      }
+      m_groups++;
+    }
+  }
+
+  /**
+   * Compute the values shown by <ramp-coreload> from the load of every core
+   *
+   * The cores are averaged per group, then either the busiest ones are kept
+   * or the groups are counted into load buckets. Either way the amount of
+   * ramps doesn't depend on the core count.
+   */
+  void cpu_module::update_coreloads() {
+    if (m_grouping == coreload_group::CORE) {
+      m_coreloads.assign(m_load.begin(), m_load.end());
+    } else {
+      m_coreloads.assign(m_groups, 0.0f);
+      m_group_cores.assign(m_groups, 0);
+
+      for (size_t i = 0; i < m_load.size(); i++) {
+        auto id = (*m_cputimes)[i].id;
+        auto group = id < m_cpu_group.size() ? m_cpu_group[id] : 0;
+        m_coreloads[group] += m_load[i];
+        m_group_cores[group]++;
+      }
+
+      // Groups without online cores are dropped
+      size_t groups{0};
+      for (size_t i = 0; i < m_groups; i++) {
+        if (m_group_cores[i]) {
+          m_coreloads[groups++] = m_coreloads[i] / static_cast<float>(m_group_cores[i]);
+        }
+      }
+      m_coreloads.resize(groups);
+    }
+
+    if (m_histogram && !m_coreloads.empty()) {
+      // Share of the groups per load bucket, from idle to busy
+      m_buckets.assign(m_histogram, 0.0f);
+      for (auto&& load : m_coreloads) {
+        auto bucket = std::min(static_cast<size_t>(load / 100.0f * static_cast<float>(m_histogram)), m_histogram - 1);
+        m_buckets[bucket]++;
+      }
+      for (auto&& bucket : m_buckets) {
+        bucket = 100.0f * bucket / static_cast<float>(m_coreloads.size());
+      }
+      std::swap(m_coreloads, m_buckets);
+    } else if (m_top && m_top < m_coreloads.size()) {
+      std::partial_sort(m_coreloads.begin(), m_coreloads.begin() + m_top, m_coreloads.end(), std::greater<float>());
+      m_coreloads.resize(m_top);
+    }
+  }
 }
 
 POLYBAR_NS_END
@@ -1,5 +1,12 @@
 #include "modules/date.hpp"
 
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
 #include "drawtypes/label.hpp"
 #include "modules/meta/base.inl"
 
@@ -8,9 +15,115 @@ POLYBAR_NS
 namespace modules {
   template class module<date_module>;
 
-  date_module::date_module(const bar_settings& bar, string name_) : timer_module<date_module>(bar, move(name_)) {
+  namespace {
+    constexpr std::time_t SECOND{1};
+    constexpr std::time_t MINUTE{60};
+    constexpr std::time_t HOUR{3600};
+    constexpr std::time_t DAY{86400};
+
+    /**
+     * Length of the finest unit of time the strftime format shows
+     *
+     * Unknown conversions are assumed to show seconds
+     */
+    std::time_t resolution(const string& fmt) {
+      std::time_t finest{DAY};
+
+      for (size_t i = 0; i < fmt.size(); i++) {
+        if (fmt[i] != '%') {
+          continue;
+        }
+
+        // Skip the flags, field width and modifiers of the GNU extensions
+        do {
+          i++;
+        } while (i < fmt.size() && strchr("_-0^#123456789EO", fmt[i]) != nullptr);
+
+        if (i == fmt.size()) {
+          break;
+        }
+
+        switch (fmt[i]) {
+          case '%':
+          case 'n':
+          case 't':
+          case 'a':
+          case 'A':
+          case 'b':
+          case 'B':
+          case 'h':
+          case 'C':
+          case 'd':
+          case 'D':
+          case 'e':
+          case 'F':
+          case 'g':
+          case 'G':
+          case 'j':
+          case 'm':
+          case 'u':
+          case 'U':
+          case 'V':
+          case 'w':
+          case 'W':
+          case 'x':
+          case 'y':
+          case 'Y':
+            break;
+          case 'H':
+          case 'I':
+          case 'k':
+          case 'l':
+          case 'p':
+          case 'P':
+          // The offset and name of the timezone change with daylight saving time
+          case 'z':
+          case 'Z':
+            finest = std::min(finest, HOUR);
+            break;
+          case 'M':
+          case 'R':
+            finest = std::min(finest, MINUTE);
+            break;
+          default:
+            return SECOND;
+        }
+      }
+
+      return finest;
+    }
+
+    /**
+     * First time after `now` at which a unit of length `res` starts in local time
+     */
+    std::time_t next_boundary(std::time_t now, std::time_t res) {
+      std::tm tm{};
+      localtime_r(&now, &tm);
+
+      if (res == SECOND) {
+        return now + 1;
+      } else if (res == MINUTE) {
+        return now - tm.tm_sec + MINUTE;
+      } else if (res == HOUR) {
+        return now - tm.tm_min * MINUTE - tm.tm_sec + HOUR;
+      }
+
+      // Days don't have a fixed length in local time
+      tm.tm_mday++;
+      tm.tm_hour = 0;
+      tm.tm_min = 0;
+      tm.tm_sec = 0;
+      tm.tm_isdst = -1;
+      return std::mktime(&tm);
+    }
+  }  // namespace
+
+  date_module::date_module(const bar_settings& bar, string name_) : event_module<date_module>(bar, move(name_)) {
     if (!m_bar.locale.empty()) {
-      datetime_stream.imbue(std::locale(m_bar.locale.c_str()));
+      m_locale = newlocale(LC_TIME_MASK, m_bar.locale.c_str(), static_cast<locale_t>(0));
+      if (m_locale == static_cast<locale_t>(0)) {
+        throw module_error("Invalid locale '" + m_bar.locale + "'");
+      }
     }
 
     m_dateformat = m_conf.get(name(), "date", ""s);
@@ -22,7 +135,25 @@ namespace modules {
       throw module_error("No date or time format specified");
     }
 
-    set_interval(1s);
+    auto interval = m_conf.get<chrono::duration<double>>(name(), "interval", 1s);
+    if (interval <= 0s) {
+      throw module_error(name() + ": 'interval' must be larger than 0 (got '" + to_string(interval.count()) + "s')");
+    }
+    // The formats can't show anything finer than seconds
+    m_interval = std::max(SECOND, static_cast<std::time_t>(std::ceil(interval.count())));
+
+    m_resolution = std::min(resolution(m_dateformat), resolution(m_timeformat));
+    m_resolution_alt = std::min(resolution(m_dateformat_alt), resolution(m_timeformat_alt));
+    m_log.info("%s: Updating every %lis, %lis while toggled", name(), std::max(m_interval, m_resolution),
+        std::max(m_interval, m_resolution_alt));
+
+    int fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+      throw module_error("Failed to create timer: "s + strerror(errno));
+    }
+    m_timer = file_util::make_file_descriptor(fd);
+
+    m_buffer.resize(64);
 
     m_formatter->add(DEFAULT_FORMAT, TAG_LABEL, {TAG_LABEL, TAG_DATE});
 
@@ -38,39 +169,66 @@ namespace modules {
     }
   }
 
+  date_module::~date_module() {
+    if (m_locale != static_cast<locale_t>(0)) {
+      freelocale(m_locale);
+    }
+  }
+
+  int date_module::event_fd() const {
+    return *m_timer;
+  }
+
+  /**
+   * Consume the expiration of the timer
+   *
+   * A change of the system clock cancels the timer, which also needs an update
+   */
+  bool date_module::has_event() {
+    uint64_t expirations;
+    if (::read(*m_timer, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+      return true;
+    }
+    return errno == ECANCELED;
+  }
+
   bool date_module::update() {
-    auto time = std::time(nullptr);
+    // time() may still return the previous second right after the timer expired
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
 
-    auto date_format = m_toggled ? m_dateformat_alt : m_dateformat;
-    // Clear stream contents
-    datetime_stream.str("");
-    datetime_stream << std::put_time(localtime(&time), date_format.c_str());
-    auto date_string = datetime_stream.str();
+    std::tm tm{};
+    localtime_r(&now.tv_sec, &tm);
 
-    auto time_format = m_toggled ? m_timeformat_alt : m_timeformat;
-    // Clear stream contents
-    datetime_stream.str("");
-    datetime_stream << std::put_time(localtime(&time), time_format.c_str());
-    auto time_string = datetime_stream.str();
+    bool toggled = m_toggled;
+    auto resolution = toggled ? m_resolution_alt : m_resolution;
+    arm(next_boundary(now.tv_sec + std::max(m_interval, resolution) - 1, resolution));
 
-    if (m_date == date_string && m_time == time_string) {
-      return false;
+    bool changed{false};
+
+    const auto& date_string = format(toggled ? m_dateformat_alt : m_dateformat, tm);
+    if (m_date != date_string) {
+      m_date = date_string;
+      changed = true;
     }
 
-    m_date = date_string;
-    m_time = time_string;
+    const auto& time_string = format(toggled ? m_timeformat_alt : m_timeformat, tm);
+    if (m_time != time_string) {
+      m_time = time_string;
+      changed = true;
+    }
 
-    if (m_label) {
+    if (changed && m_label) {
       m_label->reset_tokens();
       m_label->replace_token("%date%", m_date);
       m_label->replace_token("%time%", m_time);
     }
 
-    return true;
+    return changed;
   }
 
-  bool date_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL) {
+  bool date_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL)) {
       if (!m_dateformat_alt.empty() || !m_timeformat_alt.empty()) {
         builder->action(mousebtn::LEFT, *this, EVENT_TOGGLE, "", m_label);
       } else {
@@ -87,10 +245,46 @@ namespace modules {
     if (action != EVENT_TOGGLE) {
       return false;
     }
+
+    std::lock_guard<std::mutex> guard(m_updatelock);
     m_toggled = !m_toggled;
-    wakeup();
+    // Any time in the past lets the timer expire right away
+    arm(1);
     return true;
   }
+
+  /**
+   * Format the time with strftime into the reused buffer
+   */
+  const string& date_module::format(const string& fmt, const std::tm& tm) {
+    m_formatted.clear();
+    if (fmt.empty()) {
+      return m_formatted;
+    }
+
+    // strftime returns 0 if the result doesn't fit, but also if it is empty
+    size_t len{0};
+    while ((len = m_locale != static_cast<locale_t>(0)
+                      ? strftime_l(m_buffer.data(), m_buffer.size(), fmt.c_str(), &tm, m_locale)
+                      : strftime(m_buffer.data(), m_buffer.size(), fmt.c_str(), &tm)) == 0 &&
+           m_buffer.size() < 64 * fmt.size() + 64) {
+      m_buffer.resize(m_buffer.size() * 2);
+    }
+
+    m_formatted.assign(m_buffer.data(), len);
+    return m_formatted;
+  }
+
+  /**
+   * Let the timer expire once the realtime clock reaches `deadline`
+   *
+   * The timer is cancelled if the clock is set before that
+   */
+  void date_module::arm(std::time_t deadline) {
+    itimerspec spec{};
+    spec.it_value.tv_sec = deadline;
+    timerfd_settime(*m_timer, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr);
+  }
 }  // namespace modules
 
 POLYBAR_NS_END
@@ -1,5 +1,7 @@
-#include <sys/statvfs.h>
-#include <fstream>
+#include <poll.h>
+
+#include <cstring>
+#include <thread>
 
 #include "drawtypes/label.hpp"
 #include "drawtypes/progressbar.hpp"
@@ -15,12 +17,30 @@ POLYBAR_NS
 
 // Columns in /proc/self/mountinfo
 #define MOUNTINFO_DIR 4
-#define MOUNTINFO_TYPE 7
-#define MOUNTINFO_FSNAME 8
 
 namespace modules {
   template class module<fs_module>;
 
+  namespace {
+    /**
+     * Start and length of the given space separated column of the line at `line`
+     *
+     * \returns false if the line has less columns
+     */
+    bool find_column(const char* line, size_t column, const char*& start, size_t& length) {
+      for (size_t i = 0; i < column; i++) {
+        line += strcspn(line, " \n");
+        if (*line != ' ') {
+          return false;
+        }
+        line++;
+      }
+      start = line;
+      length = strcspn(line, " \n");
+      return true;
+    }
+  }  // namespace
+
   /**
    * Bootstrap the module by reading config values and
    * setting up required components
@@ -31,13 +51,21 @@ namespace modules {
     m_perc_used_warn = m_conf.get(name(), "warn-percentage", 90);
     m_fixed = m_conf.get(name(), "fixed-values", m_fixed);
     m_spacing = m_conf.get(name(), "spacing", m_spacing);
+    m_timeout = m_conf.get(name(), "timeout", m_timeout);
     set_interval(30s);
 
+    try {
+      m_mountinfo_file = make_unique<reread_file>("/proc/self/mountinfo");
+    } catch (const system_error& err) {
+      m_log.err("%s: Failed to open /proc/self/mountinfo (what: %s)", name(), err.what());
+    }
+
     // Add formats and elements
     m_formatter->add(
         FORMAT_MOUNTED, TAG_LABEL_MOUNTED, {TAG_LABEL_MOUNTED, TAG_BAR_FREE, TAG_BAR_USED, TAG_RAMP_CAPACITY});
     m_formatter->add_optional(FORMAT_WARN, {TAG_LABEL_WARN, TAG_BAR_FREE, TAG_BAR_USED, TAG_RAMP_CAPACITY});
     m_formatter->add(FORMAT_UNMOUNTED, TAG_LABEL_UNMOUNTED, {TAG_LABEL_UNMOUNTED});
+    m_formatter->add(FORMAT_UNRESPONSIVE, TAG_LABEL_UNRESPONSIVE, {TAG_LABEL_UNRESPONSIVE});
 
     if (m_formatter->has(TAG_LABEL_MOUNTED)) {
       m_labelmounted = load_optional_label(m_conf, name(), TAG_LABEL_MOUNTED, "%mountpoint% %percentage_free%%");
@@ -48,6 +76,10 @@ namespace modules {
     if (m_formatter->has(TAG_LABEL_UNMOUNTED)) {
       m_labelunmounted = load_optional_label(m_conf, name(), TAG_LABEL_UNMOUNTED, "%mountpoint% is not mounted");
     }
+    if (m_formatter->has(TAG_LABEL_UNRESPONSIVE)) {
+      m_labelunresponsive =
+          load_optional_label(m_conf, name(), TAG_LABEL_UNRESPONSIVE, "%mountpoint% is not responding");
+    }
     if (m_formatter->has(TAG_BAR_FREE)) {
       m_barfree = load_progressbar(m_bar, m_conf, name(), TAG_BAR_FREE);
     }
@@ -65,41 +97,146 @@ namespace modules {
     }
   }
 
+  /**
+   * Parse the mount table again if it changed since it was last parsed
+   *
+   * The kernel reports a change of the mount table as an exceptional
+   * condition on the mountinfo descriptor.
+   */
+  void fs_module::update_mountinfo() {
+    if (!m_mountinfo_file) {
+      m_mountinfo.clear();
+      return;
+    }
+
+    struct pollfd fds {
+      m_mountinfo_file->get_file_descriptor(), POLLPRI, 0
+    };
+    if (m_mountinfo_valid && poll(&fds, 1, 0) == 0) {
+      return;
+    }
+
+    m_mountinfo.clear();
+    m_mountinfo_valid = false;
+
+    const char* line;
+    try {
+      line = m_mountinfo_file->read();
+    } catch (const system_error& err) {
+      m_log.err("%s: Failed to read /proc/self/mountinfo (what: %s)", name(), err.what());
+      return;
+    }
+
+    // Only lines of configured mountpoints are split into their columns
+    for (const char* next; *line != '\0'; line = next) {
+      next = line + strcspn(line, "\n");
+      next += *next == '\n';
+
+      const char* dir;
+      size_t length;
+      if (!find_column(line, MOUNTINFO_DIR, dir, length)) {
+        continue;
+      }
+
+      for (auto&& mountpoint : m_mountpoints) {
+        if (mountpoint.size() != length || mountpoint.compare(0, length, dir, length) != 0) {
+          continue;
+        }
+
+        // The type and source follow the optional fields, whose number varies
+        const char* separator = strstr(dir, " - ");
+        const char* type;
+        const char* fsname;
+        size_t type_length;
+        size_t fsname_length;
+        if (separator != nullptr && separator < next && find_column(separator + 3, 0, type, type_length) &&
+            find_column(separator + 3, 1, fsname, fsname_length)) {
+          // A later mount on the same mountpoint hides the earlier ones
+          m_mountinfo[mountpoint] = mountinfo_entry{string{type, type_length}, string{fsname, fsname_length}};
+        }
+        break;
+      }
+    }
+
+    m_mountinfo_valid = true;
+  }
+
+  /**
+   * Start a statvfs() call for the mountpoint on its own thread
+   *
+   * If the last query for it never finished, that one is returned instead,
+   * so a hung mount only ever blocks one thread.
+   */
+  shared_ptr<fs_query> fs_module::query(const string& mountpoint) {
+    auto pending = m_queries.find(mountpoint);
+    if (pending != m_queries.end()) {
+      return pending->second;
+    }
+
+    auto result = make_shared<fs_query>();
+    std::thread([result, mountpoint] {
+      struct statvfs buffer {};
+      int error{statvfs(mountpoint.c_str(), &buffer) == -1 ? errno : 0};
+
+      std::lock_guard<std::mutex> guard(result->lock);
+      result->result = buffer;
+      result->error = error;
+      result->done = true;
+      result->finished.notify_all();
+    }).detach();
+
+    return result;
+  }
+
   /**
    * Update mountpoints
    */
   bool fs_module::update() {
     m_mounts.clear();
+    update_mountinfo();
 
-    vector<vector<string>> mountinfo;
-    std::ifstream filestream("/proc/self/mountinfo");
-    string line;
-
-    // Get details for mounted filesystems
-    while (std::getline(filestream, line)) {
-      auto cols = string_util::split(line, ' ');
-      if (std::find(m_mountpoints.begin(), m_mountpoints.end(), cols[MOUNTINFO_DIR]) != m_mountpoints.end()) {
-        mountinfo.emplace_back(move(cols));
-      }
+    // Query all mounted filesystems at once, they share the timeout
+    vector<shared_ptr<fs_query>> queries;
+    for (auto&& mountpoint : m_mountpoints) {
+      auto details = m_mountinfo.find(mountpoint);
+      m_mounts.emplace_back(new fs_mount{mountpoint, details != m_mountinfo.end()});
+      queries.emplace_back(m_mounts.back()->mounted ? query(mountpoint) : nullptr);
     }
 
+    auto deadline = chrono::steady_clock::now() + m_timeout;
+
     // Get data for defined mountpoints
-    for (auto&& mountpoint : m_mountpoints) {
-      auto details = std::find_if(mountinfo.begin(), mountinfo.end(), [&](const vector<string>& m) { return m.size() > 4 && m[MOUNTINFO_DIR] == mountpoint; });
+    for (size_t i = 0; i < m_mounts.size(); i++) {
+      auto& mount = m_mounts[i];
+      auto& query = queries[i];
+
+      if (!mount->mounted) {
+        m_log.warn("%s: Mountpoint %s is not mounted", name(), mount->mountpoint);
+        continue;
+      }
+
+      const auto& details = m_mountinfo[mount->mountpoint];
+      mount->type = details.type;
+      mount->fsname = details.fsname;
 
-      m_mounts.emplace_back(new fs_mount{mountpoint, details != mountinfo.end()});
       struct statvfs buffer {};
+      int error{0};
+      {
+        std::unique_lock<std::mutex> guard(query->lock);
+        if (!query->finished.wait_until(guard, deadline, [&] { return query->done; })) {
+          m_log.warn("%s: Mountpoint %s is not responding", name(), mount->mountpoint);
+          mount->responsive = false;
+          m_queries.emplace(mount->mountpoint, query);
+          continue;
+        }
+        buffer = query->result;
+        error = query->error;
+      }
+      m_queries.erase(mount->mountpoint);
 
-      if (!m_mounts.back()->mounted) {
-        m_log.warn("%s: Mountpoint %s is not mounted", name(), mountpoint);
-      } else if (statvfs(mountpoint.c_str(), &buffer) == -1) {
-        m_log.err("%s: Failed to query filesystem (statvfs() error: %s)", name(), strerror(errno));
+      if (error != 0) {
+        m_log.err("%s: Failed to query filesystem (statvfs() error: %s)", name(), strerror(error));
       } else {
-        auto& mount = m_mounts.back();
-        mount->mountpoint = details->at(MOUNTINFO_DIR);
-        mount->type = details->at(MOUNTINFO_TYPE);
-        mount->fsname = details->at(MOUNTINFO_FSNAME);
-
         // see: https://en.cppreference.com/w/cpp/filesystem/space
         mount->bytes_total = static_cast<uint64_t>(buffer.f_frsize) * static_cast<uint64_t>(buffer.f_blocks);
         mount->bytes_free = static_cast<uint64_t>(buffer.f_frsize) * static_cast<uint64_t>(buffer.f_bfree);
@@ -148,6 +285,9 @@ namespace modules {
     if (!m_mounts[m_index]->mounted) {
       return FORMAT_UNMOUNTED;
     }
+    if (!m_mounts[m_index]->responsive) {
+      return FORMAT_UNRESPONSIVE;
+    }
     if (m_mounts[m_index]->percentage_used >= m_perc_used_warn && m_formatter->has_format(FORMAT_WARN)) {
       return FORMAT_WARN;
     }
@@ -157,7 +297,7 @@ namespace modules {
   /**
    * Output content using configured format tags
    */
-  bool fs_module::build(builder* builder, const string& tag) const {
+  bool fs_module::build(builder* builder, const module_tag& tag) const {
     auto& mount = m_mounts[m_index];
 
     auto replace_tokens = [&](const label_t& label) {
@@ -175,22 +315,28 @@ namespace modules {
           "%used%", string_util::filesize(mount->bytes_used, m_fixed ? 2 : 0, m_fixed, m_bar.locale));
     };
 
-    if (tag == TAG_BAR_FREE) {
+    if (tag == TAG_ID(TAG_BAR_FREE)) {
       builder->node(m_barfree->output(mount->percentage_free));
-    } else if (tag == TAG_BAR_USED) {
+    } else if (tag == TAG_ID(TAG_BAR_USED)) {
       builder->node(m_barused->output(mount->percentage_used));
-    } else if (tag == TAG_RAMP_CAPACITY) {
+    } else if (tag == TAG_ID(TAG_RAMP_CAPACITY)) {
       builder->node(m_rampcapacity->get_by_percentage_with_borders(mount->percentage_free, 0, m_perc_used_warn));
-    } else if (tag == TAG_LABEL_MOUNTED) {
+    } else if (tag == TAG_ID(TAG_LABEL_MOUNTED)) {
       replace_tokens(m_labelmounted);
       builder->node(m_labelmounted);
-    } else if (tag == TAG_LABEL_WARN) {
+    } else if (tag == TAG_ID(TAG_LABEL_WARN)) {
       replace_tokens(m_labelwarn);
       builder->node(m_labelwarn);
-    } else if (tag == TAG_LABEL_UNMOUNTED) {
+    } else if (tag == TAG_ID(TAG_LABEL_UNMOUNTED)) {
       m_labelunmounted->reset_tokens();
       m_labelunmounted->replace_token("%mountpoint%", mount->mountpoint);
       builder->node(m_labelunmounted);
+    } else if (tag == TAG_ID(TAG_LABEL_UNRESPONSIVE)) {
+      m_labelunresponsive->reset_tokens();
+      m_labelunresponsive->replace_token("%mountpoint%", mount->mountpoint);
+      m_labelunresponsive->replace_token("%type%", mount->type);
+      m_labelunresponsive->replace_token("%fsname%", mount->fsname);
+      builder->node(m_labelunresponsive);
     } else {
       return false;
     }
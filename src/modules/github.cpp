@@ -1,6 +1,9 @@
 #include "modules/github.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 
 #include "drawtypes/label.hpp"
 #include "modules/meta/base.inl"
@@ -9,13 +12,91 @@
 POLYBAR_NS
 
 namespace modules {
+  namespace {
+    /**
+     * Counts the elements of a top-level json array while it streams in
+     *
+     * Nothing but the nesting depth and whether a string is open is kept,
+     * the elements themselves are never stored.
+     */
+    struct element_counter {
+      size_t count{0};
+      int depth{0};
+      bool in_string{false};
+      bool escaped{false};
+      bool expecting{false};
+
+      void feed(const char* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+          char c = data[i];
+          if (in_string) {
+            if (escaped) {
+              escaped = false;
+            } else if (c == '\\') {
+              escaped = true;
+            } else if (c == '"') {
+              in_string = false;
+            }
+            continue;
+          }
+          if (isspace(c)) {
+            continue;
+          }
+          if (depth == 1 && expecting && c != ']') {
+            count++;
+            expecting = false;
+          }
+          switch (c) {
+            case '"':
+              in_string = true;
+              break;
+            case '[':
+            case '{':
+              expecting = ++depth == 1;
+              break;
+            case ']':
+            case '}':
+              depth--;
+              break;
+            case ',':
+              expecting = depth == 1;
+              break;
+          }
+        }
+      }
+    };
+
+    /**
+     * Number of the last page in a Link header, 0 if there is none
+     */
+    size_t last_page(const string& link) {
+      auto rel = link.find("rel=\"last\"");
+      if (rel == string::npos) {
+        return 0;
+      }
+      auto end = link.rfind('>', rel);
+      auto begin = end == string::npos ? string::npos : link.rfind('<', end);
+      if (begin == string::npos) {
+        return 0;
+      }
+      auto url = link.substr(begin + 1, end - begin - 1);
+      for (auto&& param : {"?page=", "&page="}) {
+        auto pos = url.find(param);
+        if (pos != string::npos) {
+          return strtoul(url.c_str() + pos + strlen(param), nullptr, 10);
+        }
+      }
+      return 0;
+    }
+  }  // namespace
+
   template class module<github_module>;
 
   /**
    * Construct module
    */
   github_module::github_module(const bar_settings& bar, string name_)
-      : timer_module<github_module>(bar, move(name_)), m_http(http_util::make_downloader()) {
+      : timer_module<github_module>(bar, move(name_)) {
     m_accesstoken = m_conf.get(name(), "token");
     m_user = m_conf.get(name(), "user", ""s);
     m_api_url = m_conf.get(name(), "api-url", "https://api.github.com/"s);
@@ -42,61 +123,114 @@ namespace modules {
   }
 
   /**
-   * Update module contents
+   * Cancel the request that is still on its way
    */
-  bool github_module::update() {
-    auto notification = get_number_of_notification();
-
-    update_label(notification);
-
-    return true;
+  github_module::~github_module() {
+    http_client::transfer_id transfer;
+    {
+      std::lock_guard<std::mutex> guard(m_updatelock);
+      transfer = m_transfer;
+    }
+    if (transfer != 0) {
+      http_client::make().cancel(transfer);
+    }
   }
 
-  string github_module::request() {
-    string content;
+  /**
+   * Start a request, the module is updated once the response arrives
+   *
+   * The request runs on the shared http client, so a slow server doesn't
+   * block any thread. Only one notification per page is requested, the
+   * count is then the number of the last page in the Link header. Without
+   * one, the elements of the body are counted while it streams in.
+   */
+  bool github_module::update() {
+    // Ticks may come in slightly early, so allow for some tolerance
+    if (m_transfer != 0 || chrono::steady_clock::now() + 1s < m_next_poll) {
+      return false;
+    }
+
+    http_request request;
     if (m_user.empty()) {
-      content = m_http->get(m_api_url + "notifications?access_token=" + m_accesstoken);
+      request.url = m_api_url + "notifications?per_page=1&access_token=" + m_accesstoken;
     } else {
-      content = m_http->get(m_api_url + "notifications", m_user, m_accesstoken);
+      request.url = m_api_url + "notifications?per_page=1";
+      request.user = m_user;
+      request.password = m_accesstoken;
     }
-
-    long response_code{m_http->response_code()};
-    switch (response_code) {
-      case 200:
-        break;
-      case 401:
-        throw module_error("Bad credentials");
-      case 403:
-        throw module_error("Maximum number of login attempts exceeded");
-      default:
-        throw module_error("Unspecified error (" + to_string(response_code) + ")");
+    if (!m_last_modified.empty()) {
+      request.headers.emplace_back("If-Modified-Since: " + m_last_modified);
     }
+    request.timeout = std::max(5L, static_cast<long>(m_interval.count()));
 
-    return content;
-  }
+    auto counter = make_shared<element_counter>();
+    request.on_body = [counter](const char* data, size_t size) { counter->feed(data, size); };
 
-  int github_module::get_number_of_notification() {
-    string content;
+    m_next_poll = chrono::steady_clock::now();
     try {
-      content = request();
-    } catch (application_error& e) {
-      if (!m_offline) {
-        m_log.info("%s: cannot complete the request to github: %s", name(), e.what());
-      }
-      m_offline = true;
-      return -1;
+      m_transfer = http_client::make().get(request, [this, counter](http_response&& response) {
+        auto pages = last_page(response.header("Link"));
+        on_response(move(response), pages != 0 ? pages : counter->count);
+      });
+    } catch (const application_error& e) {
+      m_log.err("%s: Failed to start request (%s)", name(), e.what());
     }
 
-    m_offline = false;
+    return false;
+  }
 
-    size_t pos{0};
-    size_t notifications{0};
+  /**
+   * Called on the reactor's thread once the request is done
+   */
+  void github_module::on_response(http_response&& response, size_t notifications) {
+    string error;
+    {
+      std::lock_guard<std::mutex> guard(m_updatelock);
+      m_transfer = 0;
+      if (!running()) {
+        return;
+      }
+
+      // The next request is counted from the start of this one
+      auto poll_interval = response.header("X-Poll-Interval");
+      if (!poll_interval.empty()) {
+        m_next_poll += chrono::seconds(strtol(poll_interval.c_str(), nullptr, 10));
+      }
 
-    while ((pos = content.find("\"unread\":true", pos + 1)) != string::npos) {
-      notifications++;
+      if (!response.error.empty()) {
+        if (!m_offline) {
+          m_log.info("%s: cannot complete the request to github: %s", name(), response.error);
+        }
+        m_offline = true;
+      } else {
+        switch (response.code) {
+          case 200:
+            m_offline = false;
+            m_last_modified = response.header("Last-Modified");
+            update_label(static_cast<int>(notifications));
+            break;
+          case 304:
+            // Nothing changed since the last response
+            m_offline = false;
+            break;
+          case 401:
+            error = "Bad credentials";
+            break;
+          case 403:
+            error = "Maximum number of login attempts exceeded";
+            break;
+          default:
+            error = "Unspecified error (" + to_string(response.code) + ")";
+            break;
+        }
+      }
     }
 
-    return notifications;
+    if (!error.empty()) {
+      halt(error);
+    } else {
+      broadcast();
+    }
   }
 
   string github_module::get_format() const {
@@ -119,11 +253,11 @@ namespace modules {
   /**
    * Build module content
    */
-  bool github_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL) {
+  bool github_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL)) {
       builder->node(m_label);
       return true;
-    } else if (tag == TAG_LABEL_OFFLINE) {
+    } else if (tag == TAG_ID(TAG_LABEL_OFFLINE)) {
       builder->node(m_label_offline);
       return true;
     }
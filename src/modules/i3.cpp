@@ -1,7 +1,5 @@
 #include "modules/i3.hpp"
 
-#include <sys/socket.h>
-
 #include "drawtypes/iconset.hpp"
 #include "drawtypes/label.hpp"
 #include "modules/meta/base.inl"
@@ -20,8 +18,6 @@ namespace modules {
       throw module_error("Could not find socket: " + (socket_path.empty() ? "<empty>" : socket_path));
     }
 
-    m_ipc = factory_util::unique<i3ipc::connection>();
-
     // Load configuration values
     m_click = m_conf.get(name(), "enable-click", m_click);
     m_scroll = m_conf.get(name(), "enable-scroll", m_scroll);
@@ -65,16 +61,8 @@ namespace modules {
     }
 
     try {
-      if (m_modelabel) {
-        m_ipc->on_mode_event = [this](const i3ipc::mode_t& mode) {
-          m_modeactive = (mode.change != DEFAULT_MODE);
-          if (m_modeactive) {
-            m_modelabel->reset_tokens();
-            m_modelabel->replace_token("%mode%", mode.change);
-          }
-        };
-      }
-      m_ipc->subscribe(i3ipc::ET_WORKSPACE | i3ipc::ET_MODE);
+      m_events = i3_util::hub::make().subscribe();
+      m_state = m_events->take();
     } catch (const exception& err) {
       throw module_error(err.what());
     }
@@ -84,36 +72,28 @@ namespace modules {
     return label && *label;
   }
 
-  void i3_module::stop() {
-    try {
-      if (m_ipc) {
-        m_log.info("%s: Disconnecting from socket", name());
-        shutdown(m_ipc->get_event_socket_fd(), SHUT_RDWR);
-        shutdown(m_ipc->get_main_socket_fd(), SHUT_RDWR);
-      }
-    } catch (...) {
-    }
-
-    event_module::stop();
+  int i3_module::event_fd() const {
+    return m_events ? m_events->fd() : -1;
   }
 
   bool i3_module::has_event() {
-    try {
-      m_ipc->handle_event();
-      return true;
-    } catch (const exception& err) {
-      try {
-        m_log.warn("%s: Attempting to reconnect socket (reason: %s)", name(), err.what());
-        m_ipc->connect_event_socket(true);
-        m_log.info("%s: Reconnecting socket succeeded", name());
-      } catch (const exception& err) {
-        m_log.err("%s: Failed to reconnect socket (reason: %s)", name(), err.what());
-      }
+    auto latest = m_events->take();
+    if (!latest || latest == m_state) {
       return false;
     }
+    m_state = move(latest);
+    return true;
   }
 
   bool i3_module::update() {
+    if (m_modelabel) {
+      m_modeactive = m_state->mode != DEFAULT_MODE;
+      if (m_modeactive) {
+        m_modelabel->reset_tokens();
+        m_modelabel->replace_token("%mode%", m_state->mode);
+      }
+    }
+
     /*
      * update only populates m_workspaces and those are only needed when
      * <label-state> appears in the format
@@ -122,15 +102,14 @@ namespace modules {
       return true;
     }
     m_workspaces.clear();
-    i3_util::connection_t ipc;
 
     try {
-      vector<shared_ptr<i3_util::workspace_t>> workspaces;
+      vector<shared_ptr<const i3_util::workspace_t>> workspaces;
 
-      if (m_pinworkspaces) {
-        workspaces = i3_util::workspaces(ipc, m_bar.monitor->name);
-      } else {
-        workspaces = i3_util::workspaces(ipc);
+      for (auto&& ws : m_state->workspaces) {
+        if (!m_pinworkspaces || ws->output == m_bar.monitor->name) {
+          workspaces.emplace_back(ws);
+        }
       }
 
       if (m_indexsort) {
@@ -178,10 +157,10 @@ namespace modules {
     }
   }
 
-  bool i3_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL_MODE && m_modeactive) {
+  bool i3_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL_MODE) && m_modeactive) {
       builder->node(m_modelabel);
-    } else if (tag == TAG_LABEL_STATE && !m_workspaces.empty()) {
+    } else if (tag == TAG_ID(TAG_LABEL_STATE) && !m_workspaces.empty()) {
       if (m_scroll) {
         builder->action(mousebtn::SCROLL_DOWN, *this, m_revscroll ? EVENT_NEXT : EVENT_PREV, "");
         builder->action(mousebtn::SCROLL_UP, *this, m_revscroll ? EVENT_PREV : EVENT_NEXT, "");
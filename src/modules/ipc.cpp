@@ -8,6 +8,20 @@ POLYBAR_NS
 namespace modules {
   template class module<ipc_module>;
 
+  namespace {
+    /**
+     * Remove all formatting tags, including an unterminated one at the end
+     */
+    string strip_tags(string text) {
+      size_t start;
+      while ((start = text.find("%{")) != string::npos) {
+        auto end = text.find('}', start);
+        text.erase(start, end == string::npos ? string::npos : end - start + 1);
+      }
+      return text;
+    }
+  }  // namespace
+
   /**
    * Load user-defined ipc hooks and
    * create formatting tags
@@ -15,13 +29,12 @@ namespace modules {
   ipc_module::ipc_module(const bar_settings& bar, string name_) : static_module<ipc_module>(bar, move(name_)) {
     size_t index = 0;
 
-    for (auto&& command : m_conf.get_list<string>(name(), "hook")) {
+    for (auto&& command : m_conf.get_list<string>(name(), "hook", {})) {
       m_hooks.emplace_back(new hook{name() + to_string(++index), command});
     }
 
-    if (m_hooks.empty()) {
-      throw module_error("No hooks defined");
-    }
+    // Content received over ipc may come from any local user, it could run commands through action tags
+    m_content_tags = m_conf.get(name(), "content-format-tags", false);
 
     if ((m_initial = m_conf.get(name(), "initial", 0_z)) && m_initial > m_hooks.size()) {
       throw module_error("Initial hook out of bounds (defined: " + to_string(m_hooks.size()) + ")");
@@ -89,8 +102,8 @@ namespace modules {
   /**
    * Output content retrieved from hook commands
    */
-  bool ipc_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_OUTPUT) {
+  bool ipc_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_OUTPUT)) {
       builder->node(m_output);
       return true;
     } else {
@@ -125,6 +138,15 @@ namespace modules {
       broadcast();
     }
   }
+
+  /**
+   * Replace the output with content received over ipc
+   */
+  void ipc_module::on_content(string content) {
+    m_log.info("%s: Received content", name());
+    m_output = m_content_tags ? move(content) : strip_tags(move(content));
+    broadcast();
+  }
 }  // namespace modules
 
 POLYBAR_NS_END
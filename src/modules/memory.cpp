@@ -1,12 +1,13 @@
-#include <fstream>
-#include <iomanip>
-#include <istream>
+#include <cstdlib>
+#include <cstring>
 
+#include "components/data_source.hpp"
 #include "drawtypes/label.hpp"
 #include "drawtypes/progressbar.hpp"
 #include "drawtypes/ramp.hpp"
 #include "modules/memory.hpp"
 #include "utils/math.hpp"
+#include "utils/memory.hpp"
 
 #include "modules/meta/base.inl"
 
@@ -15,14 +16,79 @@ POLYBAR_NS
 namespace modules {
   template class module<memory_module>;
 
+  namespace {
+    struct meminfo_field {
+      const char* key;
+      size_t length;
+      unsigned long long meminfo_t::*value;
+    };
+
+    /**
+     * The lines of /proc/meminfo that are used, matched by their prefix
+     */
+    const meminfo_field MEMINFO_FIELDS[]{
+        {"MemTotal:", 9, &meminfo_t::total},
+        {"MemFree:", 8, &meminfo_t::free},
+        {"MemAvailable:", 13, &meminfo_t::available},
+        {"Buffers:", 8, &meminfo_t::buffers},
+        {"Cached:", 7, &meminfo_t::cached},
+        {"SwapTotal:", 10, &meminfo_t::swap_total},
+        {"SwapFree:", 9, &meminfo_t::swap_free},
+        {"Shmem:", 6, &meminfo_t::shmem},
+        {"SReclaimable:", 13, &meminfo_t::sreclaimable},
+    };
+
+    /**
+     * Parse the meminfo lines, stops as soon as all fields were found
+     */
+    meminfo_t parse_meminfo(const char* pos) {
+      meminfo_t result;
+      size_t found{0};
+
+      while (found < memory_util::countof(MEMINFO_FIELDS)) {
+        for (const auto& field : MEMINFO_FIELDS) {
+          if (strncmp(pos, field.key, field.length) == 0) {
+            result.*field.value = std::strtoull(pos + field.length, nullptr, 10);
+            result.has_available |= field.value == &meminfo_t::available;
+            found++;
+            break;
+          }
+        }
+
+        if ((pos = strchr(pos, '\n')) == nullptr) {
+          break;
+        }
+        pos++;
+      }
+
+      return result;
+    }
+
+    /**
+     * Parse the avg10 value of the "some" and "full" lines of a PSI file
+     */
+    mempressure_t parse_pressure(const char* contents) {
+      mempressure_t result;
+      if (const char* some = strstr(contents, "some avg10=")) {
+        result.some = std::strtof(some + 11, nullptr);
+      }
+      if (const char* full = strstr(contents, "full avg10=")) {
+        result.full = std::strtof(full + 11, nullptr);
+      }
+      return result;
+    }
+  }  // namespace
+
   memory_module::memory_module(const bar_settings& bar, string name_) : timer_module<memory_module>(bar, move(name_)) {
     set_interval(1s);
     m_perc_memused_warn = m_conf.get(name(), "warn-percentage", 90);
 
     m_formatter->add(DEFAULT_FORMAT, TAG_LABEL, {TAG_LABEL, TAG_BAR_USED, TAG_BAR_FREE, TAG_RAMP_USED, TAG_RAMP_FREE,
-                                                 TAG_BAR_SWAP_USED, TAG_BAR_SWAP_FREE, TAG_RAMP_SWAP_USED, TAG_RAMP_SWAP_FREE});
+                                                 TAG_BAR_SWAP_USED, TAG_BAR_SWAP_FREE, TAG_RAMP_SWAP_USED, TAG_RAMP_SWAP_FREE,
+                                                 TAG_GRAPH_USED});
     m_formatter->add_optional(FORMAT_WARN, {TAG_LABEL_WARN, TAG_BAR_USED, TAG_BAR_FREE, TAG_RAMP_USED, TAG_RAMP_FREE,
-                                                 TAG_BAR_SWAP_USED, TAG_BAR_SWAP_FREE, TAG_RAMP_SWAP_USED, TAG_RAMP_SWAP_FREE});
+                                                 TAG_BAR_SWAP_USED, TAG_BAR_SWAP_FREE, TAG_RAMP_SWAP_USED, TAG_RAMP_SWAP_FREE,
+                                                 TAG_GRAPH_USED});
 
     if (m_formatter->has(TAG_LABEL)) {
       m_label = load_optional_label(m_conf, name(), TAG_LABEL, "%percentage_used%%");
@@ -54,6 +120,56 @@ namespace modules {
     if(m_formatter->has(TAG_RAMP_SWAP_FREE)) {
       m_ramp_swapfree = load_ramp(m_conf, name(), TAG_RAMP_SWAP_FREE);
     }
+    if (m_formatter->has(TAG_GRAPH_USED)) {
+      m_graph_width = m_conf.get(name(), "graph-used-width", m_graph_width);
+    }
+
+    bool history = m_formatter->has(TAG_GRAPH_USED);
+    for (auto&& label : {m_label, m_labelwarn}) {
+      for (auto&& token : {"%percentage_used_avg%", "%percentage_used_min%", "%percentage_used_max%"}) {
+        history |= label && label->has_token(token);
+      }
+    }
+    if (history) {
+      m_history.resize(history_size());
+    }
+
+    try {
+      m_meminfo = make_unique<reread_file>(PATH_MEMORY_INFO);
+    } catch (const system_error& err) {
+      m_log.err("%s: Failed to open %s (what: %s)", name(), PATH_MEMORY_INFO, err.what());
+    }
+
+    // Pressure stall information is only read if it is shown and the kernel has it
+    for (auto&& label : {m_label, m_labelwarn}) {
+      if (!m_pressure && label && (label->has_token("%pressure_some%") || label->has_token("%pressure_full%"))) {
+        try {
+          m_pressure = make_unique<reread_file>(PATH_MEMORY_PRESSURE);
+        } catch (const system_error& err) {
+          m_log.warn("%s: Memory pressure isn't available (what: %s)", name(), err.what());
+          break;
+        }
+      }
+    }
+  }
+
+  /**
+   * Read the memory fields, modules that update at about the same time share them
+   */
+  meminfo_t memory_module::read_meminfo() {
+    auto max_age = chrono::duration_cast<data_source<meminfo_t>::clock::duration>(m_interval / 2);
+    return *data_source<meminfo_t>::make().get(PATH_MEMORY_INFO, max_age, [this] {
+      return m_meminfo ? parse_meminfo(m_meminfo->read()) : meminfo_t{};
+    });
+  }
+
+  mempressure_t memory_module::read_pressure() {
+    if (!m_pressure) {
+      return mempressure_t{};
+    }
+    auto max_age = chrono::duration_cast<data_source<mempressure_t>::clock::duration>(m_interval / 2);
+    return *data_source<mempressure_t>::make().get(
+        PATH_MEMORY_PRESSURE, max_age, [this] { return parse_pressure(m_pressure->read()); });
   }
 
   bool memory_module::update() {
@@ -62,35 +178,25 @@ namespace modules {
     unsigned long long kb_swap_total{0ULL};
     unsigned long long kb_swap_free{0ULL};
 
-    try {
-      std::ifstream meminfo(PATH_MEMORY_INFO);
-      std::map<std::string, unsigned long long int> parsed;
-
-      std::string line;
-      while (std::getline(meminfo, line)) {
-        size_t sep_off = line.find(':');
-        size_t value_off = line.find_first_of("123456789", sep_off);
-
-        if (sep_off == std::string::npos || value_off == std::string::npos) continue;
+    mempressure_t pressure;
 
-        std::string id = line.substr(0, sep_off);
-        unsigned long long int value = std::strtoull(&line[value_off], nullptr, 10);
-        parsed[id] = value;
-      }
-
-      kb_total = parsed["MemTotal"];
-      kb_swap_total = parsed["SwapTotal"];
-      kb_swap_free = parsed["SwapFree"];
+    try {
+      auto info = read_meminfo();
+      kb_total = info.total;
+      kb_swap_total = info.swap_total;
+      kb_swap_free = info.swap_free;
 
       // newer kernels (3.4+) have an accurate available memory field,
       // see https://git.kernel.org/cgit/linux/kernel/git/torvalds/linux.git/commit/?id=34e431b0ae398fc54ea69ff85ec700722c9da773
       // for details
-      if (parsed.count("MemAvailable")) {
-        kb_avail = parsed["MemAvailable"];
+      if (info.has_available) {
+        kb_avail = info.available;
       } else {
         // old kernel; give a best-effort approximation of available memory
-        kb_avail = parsed["MemFree"] + parsed["Buffers"] + parsed["Cached"] + parsed["SReclaimable"] - parsed["Shmem"];
+        kb_avail = info.free + info.buffers + info.cached + info.sreclaimable - info.shmem;
       }
+
+      pressure = read_pressure();
     } catch (const std::exception& err) {
       m_log.err("Failed to read memory values (what: %s)", err.what());
     }
@@ -99,6 +205,7 @@ namespace modules {
     m_perc_memused = 100 - m_perc_memfree;
     m_perc_swap_free = math_util::percentage(kb_swap_free, kb_swap_total);
     m_perc_swap_used = 100 - m_perc_swap_free;
+    m_history.push(m_perc_memused);
 
     // replace tokens
     const auto replace_tokens = [&](label_t& label) {
@@ -111,6 +218,9 @@ namespace modules {
       label->replace_token("%mb_total%", string_util::filesize_mib(kb_total, 0, m_bar.locale));
       label->replace_token("%percentage_used%", to_string(m_perc_memused));
       label->replace_token("%percentage_free%", to_string(m_perc_memfree));
+      label->replace_token("%percentage_used_avg%", to_string(static_cast<int>(m_history.mean() + 0.5)));
+      label->replace_token("%percentage_used_min%", to_string(m_history.min()));
+      label->replace_token("%percentage_used_max%", to_string(m_history.max()));
       label->replace_token("%percentage_swap_used%", to_string(m_perc_swap_used));
       label->replace_token("%percentage_swap_free%", to_string(m_perc_swap_free));
       label->replace_token("%mb_swap_total%", string_util::filesize_mib(kb_swap_total, 0, m_bar.locale));
@@ -119,6 +229,8 @@ namespace modules {
       label->replace_token("%gb_swap_total%", string_util::filesize_gib(kb_swap_total, 2, m_bar.locale));
       label->replace_token("%gb_swap_free%", string_util::filesize_gib(kb_swap_free, 2, m_bar.locale));
       label->replace_token("%gb_swap_used%", string_util::filesize_gib(kb_swap_total - kb_swap_free, 2, m_bar.locale));
+      label->replace_token("%pressure_some%", string_util::floating_point(pressure.some, 2, true, m_bar.locale));
+      label->replace_token("%pressure_full%", string_util::floating_point(pressure.full, 2, true, m_bar.locale));
     };
 
     if (m_label) {
@@ -140,27 +252,29 @@ namespace modules {
     }
   }
 
-  bool memory_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_BAR_USED) {
+  bool memory_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_BAR_USED)) {
       builder->node(m_bar_memused->output(m_perc_memused));
-    } else if (tag == TAG_BAR_FREE) {
+    } else if (tag == TAG_ID(TAG_BAR_FREE)) {
       builder->node(m_bar_memfree->output(m_perc_memfree));
-    } else if (tag == TAG_LABEL) {
+    } else if (tag == TAG_ID(TAG_LABEL)) {
       builder->node(m_label);
-    } else if (tag == TAG_LABEL_WARN) {
+    } else if (tag == TAG_ID(TAG_LABEL_WARN)) {
       builder->node(m_labelwarn);
-    } else if (tag == TAG_RAMP_FREE) {
+    } else if (tag == TAG_ID(TAG_RAMP_FREE)) {
       builder->node(m_ramp_memfree->get_by_percentage_with_borders(m_perc_memfree, 0, m_perc_memused_warn));
-    } else if (tag == TAG_RAMP_USED) {
+    } else if (tag == TAG_ID(TAG_RAMP_USED)) {
       builder->node(m_ramp_memused->get_by_percentage_with_borders(m_perc_memused, 0, m_perc_memused_warn));
-    } else if (tag == TAG_BAR_SWAP_USED) {
+    } else if (tag == TAG_ID(TAG_BAR_SWAP_USED)) {
       builder->node(m_bar_swapused->output(m_perc_swap_used));
-    } else if (tag == TAG_BAR_SWAP_FREE) {
+    } else if (tag == TAG_ID(TAG_BAR_SWAP_FREE)) {
       builder->node(m_bar_swapfree->output(m_perc_swap_free));
-    } else if (tag == TAG_RAMP_SWAP_FREE) {
+    } else if (tag == TAG_ID(TAG_RAMP_SWAP_FREE)) {
       builder->node(m_ramp_swapfree->get_by_percentage_with_borders(m_perc_swap_free, 0, m_perc_memused_warn));
-    } else if (tag == TAG_RAMP_SWAP_USED) {
+    } else if (tag == TAG_ID(TAG_RAMP_SWAP_USED)) {
       builder->node(m_ramp_swapused->get_by_percentage_with_borders(m_perc_swap_used, 0, m_perc_memused_warn));
+    } else if (tag == TAG_ID(TAG_GRAPH_USED)) {
+      builder->graph(tags::graph_type::SPARKLINE, m_graph_width, m_history.values());
     } else {
       return false;
     }
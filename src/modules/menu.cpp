@@ -35,6 +35,7 @@ namespace modules {
     m_labelseparator = load_optional_label(m_conf, name(), "label-separator", "");
 
     if (!m_formatter->has(TAG_MENU)) {
+      m_outputs.resize(1);
       return;
     }
 
@@ -62,26 +63,50 @@ namespace modules {
         m_levels.back()->items.emplace_back(move(item));
       }
     }
+
+    m_outputs.resize(m_levels.size() + 1);
+  }
+
+  string menu_module::get_output() {
+    m_build_level = m_level;
+    if (m_build_level >= static_cast<int>(m_levels.size())) {
+      m_build_level = -1;
+    }
+
+    auto& cached = m_outputs[m_build_level + 1];
+    if (cached.output.empty()) {
+      cached.output = module::get_output();
+    }
+    return cached.output;
+  }
+
+  shared_ptr<const tags::format_string> menu_module::parse_output(const string& output) {
+    auto& cached = m_outputs[m_build_level + 1];
+    if (!cached.elements || cached.published != output) {
+      cached.published = output;
+      cached.elements = module::parse_output(output);
+    }
+    return cached.elements;
   }
 
-  bool menu_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL_TOGGLE && m_level == -1) {
+  bool menu_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL_TOGGLE) && m_build_level == -1) {
       builder->action(mousebtn::LEFT, *this, string(EVENT_OPEN), "0", m_labelopen);
-    } else if (tag == TAG_LABEL_TOGGLE && m_level > -1) {
+    } else if (tag == TAG_ID(TAG_LABEL_TOGGLE) && m_build_level > -1) {
       builder->action(mousebtn::LEFT, *this, EVENT_CLOSE, "", m_labelclose);
-    } else if (tag == TAG_MENU && m_level > -1) {
+    } else if (tag == TAG_ID(TAG_MENU) && m_build_level > -1) {
       auto spacing = m_formatter->get(get_format())->spacing;
       //Insert separator after menu-toggle and before menu-items for expand-right=true
       if (m_expand_right && *m_labelseparator) {
         builder->node(m_labelseparator);
         builder->space(spacing);
       }
-      auto&& items = m_levels[m_level]->items;
+      auto&& items = m_levels[m_build_level]->items;
       for (size_t i = 0; i < items.size(); i++) {
         auto&& item = items[i];
         builder->action(
-            mousebtn::LEFT, *this, string(EVENT_EXEC), to_string(m_level) + "-" + to_string(i), item->label);
-        if (item != m_levels[m_level]->items.back()) {
+            mousebtn::LEFT, *this, string(EVENT_EXEC), to_string(m_build_level) + "-" + to_string(i), item->label);
+        if (item != m_levels[m_build_level]->items.back()) {
           builder->space(spacing);
           if (*m_labelseparator) {
             builder->node(m_labelseparator);
@@ -3,6 +3,7 @@
 #include <utility>
 
 #include "components/builder.hpp"
+#include "components/config.hpp"
 #include "drawtypes/label.hpp"
 
 POLYBAR_NS
@@ -83,6 +84,34 @@ namespace modules {
     return builder->flush();
   }
 
+  /**
+   * Split the format value into text and tag segments
+   */
+  void module_format::compile() {
+    segments.clear();
+
+    size_t pos{0};
+    size_t start, end;
+    while ((start = value.find('<', pos)) != string::npos && (end = value.find('>', start)) != string::npos) {
+      if (start > pos) {
+        segment text{};
+        text.value = value.substr(pos, start - pos);
+        text.trimmed = string_util::ltrim(string{text.value}, ' ');
+        segments.emplace_back(move(text));
+      }
+
+      segment tag{};
+      tag.is_tag = true;
+      tag.tag.name = value.substr(start, end - start + 1);
+      tag.tag.id = make_tag_id(tag.tag.name.c_str());
+      segments.emplace_back(move(tag));
+
+      pos = end + 1;
+    }
+
+    trailer = value.substr(pos);
+  }
+
   // }}}
   // module_formatter {{{
 
@@ -92,6 +121,7 @@ namespace modules {
 
     auto format = make_unique<module_format>();
     format->value = move(value);
+    format->compile();
     format->fg = m_conf.get(m_modname, name + "-foreground", formatdef("foreground", format->fg));
     format->bg = m_conf.get(m_modname, name + "-background", formatdef("background", format->bg));
     format->ul = m_conf.get(m_modname, name + "-underline", formatdef("underline", format->ul));
@@ -105,16 +135,12 @@ namespace modules {
     format->font = m_conf.get(m_modname, name + "-font", formatdef("font", format->font));
     format->tags.swap(tags);
 
-    try {
+    if (m_conf.has(m_modname, name + "-prefix")) {
       format->prefix = load_label(m_conf, m_modname, name + "-prefix");
-    } catch (const key_error& err) {
-      // prefix not defined
     }
 
-    try {
+    if (m_conf.has(m_modname, name + "-suffix")) {
       format->suffix = load_label(m_conf, m_modname, name + "-suffix");
-    } catch (const key_error& err) {
-      // suffix not defined
     }
 
     vector<string> tag_collection;
@@ -122,6 +148,14 @@ namespace modules {
     tag_collection.insert(tag_collection.end(), format->tags.begin(), format->tags.end());
     tag_collection.insert(tag_collection.end(), whitelist.begin(), whitelist.end());
 
+    // build() only sees the tag ids, so different tags of a module must never share one
+    for (auto&& tag : tag_collection) {
+      auto it = m_tag_ids.emplace(make_tag_id(tag.c_str()), tag).first;
+      if (it->second != tag) {
+        throw module_error("Tags " + it->second + " and " + tag + " of \"" + name + "\" have the same id");
+      }
+    }
+
     size_t start, end;
     while ((start = value.find('<')) != string::npos && (end = value.find('>', start)) != string::npos) {
       if (start > 0) {
@@ -180,6 +214,43 @@ namespace modules {
     return format->second;
   }
 
+  // }}}
+  // reserved width {{{
+
+  /**
+   * Width reserved for a module with `fixed-width` or `min-width`
+   *
+   * Values are in pixels, or in characters of the bar's first font with the
+   * suffix `ch` (e.g. `min-width = 4ch`). A fixed width takes precedence.
+   */
+  tags::reserved_width load_reserved_width(const config& conf, const string& section) {
+    tags::reserved_width width{};
+    string value;
+
+    if (conf.has(section, "fixed-width")) {
+      value = conf.get(section, "fixed-width");
+      width.fixed = true;
+    } else if (conf.has(section, "min-width")) {
+      value = conf.get(section, "min-width");
+    } else {
+      return width;
+    }
+
+    if (value.size() > 2 && value.compare(value.size() - 2, 2, "ch") == 0) {
+      value.erase(value.size() - 2);
+      width.chars = true;
+    }
+
+    char* end;
+    long parsed = strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || parsed <= 0 || parsed > 10000) {
+      throw value_error("Invalid width for " + section + ": \"" + value + "\", expected pixels or characters (e.g. 4ch)");
+    }
+
+    width.width = static_cast<int>(parsed);
+    return width;
+  }
+
   // }}}
 }  // namespace modules
 
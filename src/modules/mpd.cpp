@@ -1,6 +1,12 @@
 #include "modules/mpd.hpp"
 
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <csignal>
+#include <cstring>
 
 #include "drawtypes/iconset.hpp"
 #include "drawtypes/label.hpp"
@@ -13,7 +19,22 @@ POLYBAR_NS
 namespace modules {
   template class module<mpd_module>;
 
-  mpd_module::mpd_module(const bar_settings& bar, string name_) : event_module<mpd_module>(bar, move(name_)) {
+  namespace {
+    /**
+     * Bounds of the delay between failed connection attempts
+     */
+    constexpr chrono::milliseconds RECONNECT_MIN{500};
+    constexpr chrono::milliseconds RECONNECT_MAX{30000};
+  }  // namespace
+
+  mpd_module::mpd_module(const bar_settings& bar, string name_)
+      : event_module<mpd_module>(bar, move(name_))
+      , m_reconnect_delay(RECONNECT_MIN)
+      , m_wakeupfd(eventfd(0, EFD_CLOEXEC)) {
+    if (!m_wakeupfd) {
+      throw module_error("Failed to create wakeup fd");
+    }
+
     m_host = m_conf.get(name(), "host", m_host);
     m_port = m_conf.get(name(), "port", m_port);
     m_pass = m_conf.get(name(), "password", m_pass);
@@ -41,20 +62,19 @@ namespace modules {
       mod_format->offset = m_conf.get(name(), FORMAT_ONLINE + "-offset"s, mod_format->offset);
       mod_format->font = m_conf.get(name(), FORMAT_ONLINE + "-font"s, mod_format->font);
 
-      try {
+      if (m_conf.has(name(), FORMAT_ONLINE + "-prefix"s)) {
         mod_format->prefix = load_label(m_conf, name(), FORMAT_ONLINE + "-prefix"s);
-      } catch (const key_error& err) {
-        // format-online-prefix not defined
       }
 
-      try {
+      if (m_conf.has(name(), FORMAT_ONLINE + "-suffix"s)) {
         mod_format->suffix = load_label(m_conf, name(), FORMAT_ONLINE + "-suffix"s);
-      } catch (const key_error& err) {
-        // format-online-suffix not defined
       }
     }
 
     m_formatter->add(FORMAT_OFFLINE, "", {TAG_LABEL_OFFLINE});
+    // Looks the same as offline unless configured otherwise
+    m_formatter->add(FORMAT_CONNECTING, m_conf.get(name(), FORMAT_OFFLINE, ""s),
+        {TAG_LABEL_CONNECTING, TAG_LABEL_OFFLINE});
 
     m_icons = factory_util::shared<iconset>();
 
@@ -110,25 +130,33 @@ namespace modules {
       m_toggle_on_color = m_conf.get(name(), "toggle-on-foreground", rgba{});
       m_toggle_off_color = m_conf.get(name(), "toggle-off-foreground", rgba{});
     }
-    if (m_formatter->has(TAG_LABEL_OFFLINE, FORMAT_OFFLINE)) {
+    if (m_formatter->has(TAG_LABEL_OFFLINE, FORMAT_OFFLINE) || m_formatter->has(TAG_LABEL_OFFLINE, FORMAT_CONNECTING)) {
       m_label_offline = load_label(m_conf, name(), TAG_LABEL_OFFLINE);
     }
+    if (m_formatter->has(TAG_LABEL_CONNECTING, FORMAT_CONNECTING)) {
+      m_label_connecting = load_optional_label(m_conf, name(), TAG_LABEL_CONNECTING, "connecting...");
+    }
     if (m_formatter->has(TAG_BAR_PROGRESS)) {
       m_bar_progress = load_progressbar(m_bar, m_conf, name(), TAG_BAR_PROGRESS);
     }
 
     // }}}
 
-    m_lastsync = chrono::system_clock::now();
+    // Connecting is left to the module thread, so that a dead server doesn't block the bar
+    m_mpd = factory_util::unique<mpdconnection>(m_log, m_host, m_port, m_pass);
+  }
 
-    try {
-      m_mpd = factory_util::unique<mpdconnection>(m_log, m_host, m_port, m_pass);
-      m_mpd->connect();
-      m_status = m_mpd->get_status();
-    } catch (const mpd_exception& err) {
-      m_log.err("%s: %s", name(), err.what());
-      m_mpd.reset();
-    }
+  /**
+   * Interrupt a pending wait in has_event() before stopping the module
+   *
+   * The fd is never reset, so every wait after this returns immediately
+   */
+  void mpd_module::stop() {
+    uint64_t one{1};
+    if (write(m_wakeupfd, &one, sizeof(one)) == -1) {
+      m_log.err("%s: Failed to interrupt wait (%s)", name(), strerror(errno));
+    }
+    event_module<mpd_module>::stop();
   }
 
   void mpd_module::teardown() {
@@ -140,49 +168,42 @@ namespace modules {
   }
 
   void mpd_module::idle() {
-    if (connected()) {
-      m_quick_attempts = 0;
-      sleep(80ms);
-    } else {
-      sleep(m_quick_attempts++ < 5 ? 0.5s : 2s);
-    }
+    // has_event() blocks until there is something to do, also while connecting or waiting to reconnect
   }
 
   bool mpd_module::has_event() {
-    bool def = false;
-
-    if (!connected() && m_statebroadcasted == mpd::connection_state::CONNECTED) {
-      def = true;
-    } else if (connected() && m_statebroadcasted == mpd::connection_state::DISCONNECTED) {
-      def = true;
-    }
-
-    try {
-      if (!m_mpd) {
-        m_mpd = factory_util::unique<mpdconnection>(m_log, m_host, m_port, m_pass);
-      }
-      if (!connected()) {
-        m_mpd->connect();
-      }
-    } catch (const mpd_exception& err) {
-      m_log.err("%s: %s", name(), err.what());
-      m_mpd.reset();
-      return def;
-    }
-
     if (!connected()) {
-      return def;
+      return reconnect();
     }
 
+    bool def = m_statebroadcasted != mpd::connection_state::CONNECTED;
+
     if (!m_status) {
       m_status = m_mpd->get_status_safe();
     }
 
     try {
+      // Stays idle across ticks of the elapsed time, mpd is only asked again once it reports a change
       m_mpd->idle();
 
+      // Wait for mpd to report changes, the next second of the elapsed time or stop()
+      struct pollfd fds[2]{};
+      fds[0].fd = m_mpd->get_fd();
+      fds[0].events = POLLIN;
+      fds[1].fd = m_wakeupfd;
+      fds[1].events = POLLIN;
+      int ready = ::poll(fds, 2, wait_timeout());
+      if (ready == -1 && errno != EINTR) {
+        throw mpd_exception("Failed to wait for events ("s + strerror(errno) + ")");
+      }
+
+      if (ready == 0) {
+        m_elapsed_only = true;
+        return true;
+      }
+
       int idle_flags = 0;
-      if ((idle_flags = m_mpd->noidle()) != 0) {
+      if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) && (idle_flags = m_mpd->noidle()) != 0) {
         // Update status on every event
         m_status->update(idle_flags, m_mpd.get());
         return true;
@@ -193,26 +214,104 @@ namespace modules {
       return def;
     }
 
-    if ((m_label_time || m_bar_progress) && m_status->match_state(mpdstate::PLAYING)) {
-      auto now = chrono::system_clock::now();
-      auto diff = now - m_lastsync;
+    return def;
+  }
 
-      if (chrono::duration_cast<chrono::milliseconds>(diff).count() > m_synctime * 1000) {
-        m_lastsync = now;
-        return true;
+  /**
+   * Continue connecting to mpd without blocking for longer than one step
+   *
+   * Failed attempts are repeated with an exponential backoff. The
+   * connecting format is only shown for attempts that don't finish quickly.
+   *
+   * \returns true if the shown connection state has to change
+   */
+  bool mpd_module::reconnect() {
+    if (!m_mpd) {
+      m_mpd = factory_util::unique<mpdconnection>(m_log, m_host, m_port, m_pass);
+    }
+
+    auto now = chrono::steady_clock::now();
+    if (!m_mpd->connecting()) {
+      if (now < m_next_attempt) {
+        wait_for(-1, 0, chrono::duration_cast<chrono::milliseconds>(m_next_attempt - now).count() + 1);
+        return m_statebroadcasted != mpd::connection_state::DISCONNECTED;
       }
+      m_attempt_start = now;
     }
 
-    return def;
+    try {
+      while (!m_mpd->connect_async()) {
+        if (!running()) {
+          return false;
+        }
+
+        int timeout = m_mpd->connect_timeout();
+        if (m_statebroadcasted != mpd::connection_state::CONNECTING) {
+          auto grace = m_attempt_start + 100ms - chrono::steady_clock::now();
+          if (grace <= 0ms) {
+            return true;
+          }
+          timeout = std::min<int>(timeout, chrono::duration_cast<chrono::milliseconds>(grace).count() + 1);
+        }
+        wait_for(m_mpd->get_fd(), m_mpd->connect_events(), timeout);
+      }
+
+      m_status = m_mpd->get_status();
+    } catch (const mpd_exception& err) {
+      m_log.err("%s: %s, trying again in %ims", name(), err.what(), static_cast<int>(m_reconnect_delay.count()));
+      m_mpd->disconnect();
+      m_status.reset();
+      m_next_attempt = chrono::steady_clock::now() + m_reconnect_delay;
+      m_reconnect_delay = std::min(m_reconnect_delay * 2, RECONNECT_MAX);
+      return m_statebroadcasted != mpd::connection_state::DISCONNECTED;
+    }
+
+    m_log.info("%s: Connected to %s", name(), m_host);
+    m_reconnect_delay = RECONNECT_MIN;
+    return true;
+  }
+
+  /**
+   * Wait until the fd has one of the events, the timeout passed or stop() was called
+   */
+  void mpd_module::wait_for(int fd, short events, int timeout) {
+    struct pollfd fds[2]{};
+    fds[0].fd = m_wakeupfd;
+    fds[0].events = POLLIN;
+    fds[1].fd = fd;
+    fds[1].events = events;
+    if (::poll(fds, fd == -1 ? 1 : 2, timeout) == -1 && errno != EINTR) {
+      throw mpd_exception("Failed to wait for events ("s + strerror(errno) + ")");
+    }
+  }
+
+  /**
+   * Milliseconds until the shown elapsed time changes, -1 if the shown state
+   * only changes through mpd events
+   *
+   * The elapsed time is extrapolated from the last status, so this needs no
+   * round-trip to mpd
+   */
+  int mpd_module::wait_timeout() const {
+    if (!(m_label_time || m_bar_progress) || !m_status || !m_status->match_state(mpdstate::PLAYING)) {
+      return -1;
+    }
+
+    // With an interval of more than a second, whole seconds are skipped
+    auto skipped = chrono::seconds{std::max(1, static_cast<int>(m_synctime)) - 1};
+    return chrono::duration_cast<chrono::milliseconds>(m_status->get_next_second() + skipped).count() + 1;
   }
 
   bool mpd_module::update() {
     if (connected()) {
       m_statebroadcasted = mpd::connection_state::CONNECTED;
-    } else if (!connected() && m_statebroadcasted != mpd::connection_state::DISCONNECTED) {
-      m_statebroadcasted = mpd::connection_state::DISCONNECTED;
-    } else if (!connected()) {
-      return false;
+    } else {
+      auto state = m_mpd && m_mpd->connecting() ? mpd::connection_state::CONNECTING
+                                                : mpd::connection_state::DISCONNECTED;
+      if (m_statebroadcasted == state) {
+        return false;
+      }
+      m_statebroadcasted = state;
     }
 
     if (!m_status) {
@@ -221,9 +320,15 @@ namespace modules {
       }
     }
 
-    if (m_status && m_status->match_state(mpdstate::PLAYING)) {
-      // Always update the status while playing
-      m_status->update(-1, m_mpd.get());
+    if (m_elapsed_only) {
+      // Only the elapsed time moved on, there is nothing new to ask mpd for
+      m_elapsed_only = false;
+      if (m_label_time && m_status) {
+        m_label_time->reset_tokens();
+        m_label_time->replace_token("%elapsed%", m_status->get_formatted_elapsed());
+        m_label_time->replace_token("%total%", m_status->get_formatted_total());
+      }
+      return true;
     }
 
     string artist;
@@ -288,7 +393,9 @@ namespace modules {
   }
 
   string mpd_module::get_format() const {
-    if (!connected()) {
+    if (m_statebroadcasted == mpd::connection_state::CONNECTING) {
+      return FORMAT_CONNECTING;
+    } else if (!connected()) {
       return FORMAT_OFFLINE;
     } else if (m_status->match_state(mpdstate::PLAYING)) {
       return FORMAT_PLAYING;
@@ -308,40 +415,43 @@ namespace modules {
     }
   }
 
-  bool mpd_module::build(builder* builder, const string& tag) const {
+  bool mpd_module::build(builder* builder, const module_tag& tag) const {
     bool is_playing = m_status && m_status->match_state(mpdstate::PLAYING);
     bool is_paused = m_status && m_status->match_state(mpdstate::PAUSED);
     bool is_stopped = m_status && m_status->match_state(mpdstate::STOPPED);
 
-    if (tag == TAG_LABEL_SONG && !is_stopped) {
+    if (tag == TAG_ID(TAG_LABEL_SONG) && !is_stopped) {
       builder->node(m_label_song);
-    } else if (tag == TAG_LABEL_TIME && !is_stopped) {
+    } else if (tag == TAG_ID(TAG_LABEL_TIME) && !is_stopped) {
       builder->node(m_label_time);
-    } else if (tag == TAG_BAR_PROGRESS && !is_stopped) {
+    } else if (tag == TAG_ID(TAG_BAR_PROGRESS) && !is_stopped) {
       builder->node(m_bar_progress->output(!m_status ? 0 : m_status->get_elapsed_percentage()));
-    } else if (tag == TAG_LABEL_OFFLINE) {
+    } else if (tag == TAG_ID(TAG_LABEL_OFFLINE)) {
       builder->node(m_label_offline);
-    } else if (tag == TAG_ICON_RANDOM) {
+    } else if (tag == TAG_ID(TAG_LABEL_CONNECTING)) {
+      builder->node(m_label_connecting);
+    } else if (tag == TAG_ID(TAG_ICON_RANDOM)) {
       builder->action(mousebtn::LEFT, *this, EVENT_RANDOM, "", m_icons->get("random"));
-    } else if (tag == TAG_ICON_REPEAT) {
+    } else if (tag == TAG_ID(TAG_ICON_REPEAT)) {
       builder->action(mousebtn::LEFT, *this, EVENT_REPEAT, "", m_icons->get("repeat"));
-    } else if (tag == TAG_ICON_REPEAT_ONE || tag == TAG_ICON_SINGLE) {
+    } else if (tag == TAG_ID(TAG_ICON_REPEAT_ONE) || tag == TAG_ID(TAG_ICON_SINGLE)) {
       builder->action(mousebtn::LEFT, *this, EVENT_SINGLE, "", m_icons->get("single"));
-    } else if (tag == TAG_ICON_CONSUME) {
+    } else if (tag == TAG_ID(TAG_ICON_CONSUME)) {
       builder->action(mousebtn::LEFT, *this, EVENT_CONSUME, "", m_icons->get("consume"));
-    } else if (tag == TAG_ICON_PREV) {
+    } else if (tag == TAG_ID(TAG_ICON_PREV)) {
       builder->action(mousebtn::LEFT, *this, EVENT_PREV, "", m_icons->get("prev"));
-    } else if ((tag == TAG_ICON_STOP || tag == TAG_TOGGLE_STOP) && (is_playing || is_paused)) {
+    } else if ((tag == TAG_ID(TAG_ICON_STOP) || tag == TAG_ID(TAG_TOGGLE_STOP)) && (is_playing || is_paused)) {
       builder->action(mousebtn::LEFT, *this, EVENT_STOP, "", m_icons->get("stop"));
-    } else if ((tag == TAG_ICON_PAUSE || tag == TAG_TOGGLE) && is_playing) {
+    } else if ((tag == TAG_ID(TAG_ICON_PAUSE) || tag == TAG_ID(TAG_TOGGLE)) && is_playing) {
       builder->action(mousebtn::LEFT, *this, EVENT_PAUSE, "", m_icons->get("pause"));
-    } else if ((tag == TAG_ICON_PLAY || tag == TAG_TOGGLE || tag == TAG_TOGGLE_STOP) && !is_playing) {
+    } else if ((tag == TAG_ID(TAG_ICON_PLAY) || tag == TAG_ID(TAG_TOGGLE) || tag == TAG_ID(TAG_TOGGLE_STOP)) &&
+               !is_playing) {
       builder->action(mousebtn::LEFT, *this, EVENT_PLAY, "", m_icons->get("play"));
-    } else if (tag == TAG_ICON_NEXT) {
+    } else if (tag == TAG_ID(TAG_ICON_NEXT)) {
       builder->action(mousebtn::LEFT, *this, EVENT_NEXT, "", m_icons->get("next"));
-    } else if (tag == TAG_ICON_SEEKB) {
+    } else if (tag == TAG_ID(TAG_ICON_SEEKB)) {
       builder->action(mousebtn::LEFT, *this, EVENT_SEEK, "-5"s, m_icons->get("seekb"));
-    } else if (tag == TAG_ICON_SEEKF) {
+    } else if (tag == TAG_ID(TAG_ICON_SEEKF)) {
       builder->action(mousebtn::LEFT, *this, EVENT_SEEK, "+5"s, m_icons->get("seekf"));
     } else {
       return false;
@@ -353,6 +463,12 @@ namespace modules {
   bool mpd_module::input(const string& action, const string& data) {
     m_log.info("%s: event: %s", name(), action);
 
+    if (m_statebroadcasted != mpd::connection_state::CONNECTED) {
+      // Connecting for the action would block until the server answers or the timeout expires
+      m_log.warn("%s: Not connected to mpd, ignoring %s", name(), action);
+      return true;
+    }
+
     try {
       auto mpd = factory_util::unique<mpdconnection>(m_log, m_host, m_port, m_pass);
       mpd->connect();
@@ -1,5 +1,6 @@
 #include "modules/network.hpp"
 
+#include "components/config_schema.hpp"
 #include "drawtypes/animation.hpp"
 #include "drawtypes/label.hpp"
 #include "drawtypes/ramp.hpp"
@@ -15,18 +16,22 @@ namespace modules {
   network_module::network_module(const bar_settings& bar, string name_)
       : timer_module<network_module>(bar, move(name_)) {
     // Load configuration values
-    m_interface = m_conf.get(name(), "interface", m_interface);
-    m_ping_nth_update = m_conf.get(name(), "ping-interval", m_ping_nth_update);
-    m_udspeed_minwidth = m_conf.get(name(), "udspeed-minwidth", m_udspeed_minwidth);
-    m_accumulate = m_conf.get(name(), "accumulate-stats", m_accumulate);
+    config_schema{m_log, m_conf, name()}
+        .optional("interface", m_interface)
+        .optional("ping-interval", m_ping_nth_update)
+        .optional("ping-target", m_ping_target)
+        .optional("udspeed-minwidth", m_udspeed_minwidth)
+        .optional("accumulate-stats", m_accumulate)
+        .optional("unknown-as-up", m_unknown_up)
+        .optional("speed-unit", m_udspeed_unit)
+        .load();
     set_interval(1s);
-    m_unknown_up = m_conf.get<bool>(name(), "unknown-as-up", false);
-    m_udspeed_unit = m_conf.get<string>(name(), "speed-unit", m_udspeed_unit);
 
     m_conf.warn_deprecated(name(), "udspeed-minwidth", "%downspeed:min:max% and %upspeed:min:max%");
 
     // Add formats
-    m_formatter->add(FORMAT_CONNECTED, TAG_LABEL_CONNECTED, {TAG_RAMP_SIGNAL, TAG_RAMP_QUALITY, TAG_LABEL_CONNECTED});
+    m_formatter->add(FORMAT_CONNECTED, TAG_LABEL_CONNECTED,
+        {TAG_RAMP_SIGNAL, TAG_RAMP_QUALITY, TAG_LABEL_CONNECTED, TAG_GRAPH_DOWNSPEED, TAG_GRAPH_UPSPEED});
     m_formatter->add(FORMAT_DISCONNECTED, TAG_LABEL_DISCONNECTED, {TAG_LABEL_DISCONNECTED});
 
     // Create elements for format-connected
@@ -51,7 +56,7 @@ namespace modules {
     // Create elements for format-packetloss if we are told to test connectivity
     if (m_ping_nth_update > 0) {
       m_formatter->add(FORMAT_PACKETLOSS, TAG_LABEL_CONNECTED,
-          {TAG_ANIMATION_PACKETLOSS, TAG_LABEL_PACKETLOSS, TAG_LABEL_CONNECTED});
+          {TAG_ANIMATION_PACKETLOSS, TAG_LABEL_PACKETLOSS, TAG_LABEL_CONNECTED, TAG_GRAPH_DOWNSPEED, TAG_GRAPH_UPSPEED});
 
       if (m_formatter->has(TAG_LABEL_PACKETLOSS, FORMAT_PACKETLOSS)) {
         m_label[connection_state::PACKETLOSS] = load_optional_label(m_conf, name(), TAG_LABEL_PACKETLOSS, "");
@@ -61,6 +66,16 @@ namespace modules {
       }
     }
 
+    // The graphs are shown in format-connected and format-packetloss
+    if (m_formatter->has(TAG_GRAPH_DOWNSPEED)) {
+      m_graph_downspeed_width = m_conf.get(name(), "graph-downspeed-width", m_graph_downspeed_width);
+      m_downspeeds.resize(history_size());
+    }
+    if (m_formatter->has(TAG_GRAPH_UPSPEED)) {
+      m_graph_upspeed_width = m_conf.get(name(), "graph-upspeed-width", m_graph_upspeed_width);
+      m_upspeeds.resize(history_size());
+    }
+
     // Get an intstance of the network interface
     if (net::is_wireless_interface(m_interface)) {
       m_wireless = factory_util::unique<net::wireless_network>(m_interface);
@@ -70,13 +85,17 @@ namespace modules {
       m_wired->set_unknown_up(m_unknown_up);
     };
 
-    // We only need to start the subthread if the packetloss animation is used
-    if (m_animation_packetloss) {
-      m_threads.emplace_back(thread(&network_module::subthread_routine, this));
+    if (m_ping_nth_update > 0) {
+      m_probe = factory_util::unique<net::connectivity_probe>(m_ping_target, m_interface);
     }
   }
 
   void network_module::teardown() {
+    if (m_animation_id != 0) {
+      animation_clock::make().remove(m_animation_id);
+      m_animation_id = 0;
+    }
+    m_probe.reset();
     m_wireless.reset();
     m_wired.reset();
   }
@@ -88,6 +107,7 @@ namespace modules {
     if (!network->query(m_accumulate)) {
       m_log.warn("%s: Failed to query interface '%s'", name(), m_interface);
       m_connected = false;
+      update_animation();
       return false;
     }
 
@@ -106,12 +126,24 @@ namespace modules {
     if (m_counter == -1) {
       m_counter = 0;
     } else if (m_ping_nth_update > 0 && m_connected && (++m_counter % m_ping_nth_update) == 0) {
-      m_packetloss = !network->ping();
+      m_probe->start();
       m_counter = 0;
     }
 
+    // The result of the probe is collected on one of the following updates
+    if (m_probe && m_probe->running()) {
+      auto result = m_probe->poll();
+      if (result != net::connectivity_probe::result::PENDING) {
+        m_packetloss = result == net::connectivity_probe::result::UNREACHABLE;
+      }
+    }
+
+    update_animation();
+
     auto upspeed = network->upspeed(m_udspeed_minwidth, m_udspeed_unit);
     auto downspeed = network->downspeed(m_udspeed_minwidth, m_udspeed_unit);
+    m_downspeeds.push(network->downrate());
+    m_upspeeds.push(network->uprate());
 
     // Update label contents
     const auto replace_tokens = [&](label_t& label) {
@@ -154,40 +186,45 @@ namespace modules {
     }
   }
 
-  bool network_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL_CONNECTED) {
+  bool network_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL_CONNECTED)) {
       builder->node(m_label.at(connection_state::CONNECTED));
-    } else if (tag == TAG_LABEL_DISCONNECTED) {
+    } else if (tag == TAG_ID(TAG_LABEL_DISCONNECTED)) {
       builder->node(m_label.at(connection_state::DISCONNECTED));
-    } else if (tag == TAG_LABEL_PACKETLOSS) {
+    } else if (tag == TAG_ID(TAG_LABEL_PACKETLOSS)) {
       builder->node(m_label.at(connection_state::PACKETLOSS));
-    } else if (tag == TAG_ANIMATION_PACKETLOSS) {
+    } else if (tag == TAG_ID(TAG_ANIMATION_PACKETLOSS)) {
       builder->node(m_animation_packetloss->get());
-    } else if (tag == TAG_RAMP_SIGNAL) {
+    } else if (tag == TAG_ID(TAG_RAMP_SIGNAL)) {
       builder->node(m_ramp_signal->get_by_percentage(m_signal));
-    } else if (tag == TAG_RAMP_QUALITY) {
+    } else if (tag == TAG_ID(TAG_RAMP_QUALITY)) {
       builder->node(m_ramp_quality->get_by_percentage(m_quality));
+    } else if (tag == TAG_ID(TAG_GRAPH_DOWNSPEED)) {
+      // Scaled to the highest speed in the history
+      auto peak = m_downspeeds.max();
+      builder->graph(tags::graph_type::SPARKLINE, m_graph_downspeed_width,
+          m_downspeeds.values(peak > 0.0f ? 100.0 / peak : 0.0));
+    } else if (tag == TAG_ID(TAG_GRAPH_UPSPEED)) {
+      auto peak = m_upspeeds.max();
+      builder->graph(
+          tags::graph_type::SPARKLINE, m_graph_upspeed_width, m_upspeeds.values(peak > 0.0f ? 100.0 / peak : 0.0));
     } else {
       return false;
     }
     return true;
   }
 
-  void network_module::subthread_routine() {
-    const chrono::milliseconds framerate{m_animation_packetloss->framerate()};
-
-    while (running()) {
-      auto now = chrono::steady_clock::now();
-      if (m_connected && m_packetloss) {
-        m_animation_packetloss->increment();
-        broadcast();
-      }
-
-      now += framerate;
-      this_thread::sleep_until(now);
+  /**
+   * Let the animation clock advance the packetloss animation while it is shown
+   */
+  void network_module::update_animation() {
+    bool shown = m_animation_packetloss && m_connected && m_packetloss;
+    if (shown && m_animation_id == 0) {
+      m_animation_id = animation_clock::make().add(m_animation_packetloss, [this] { broadcast(); });
+    } else if (!shown && m_animation_id != 0) {
+      animation_clock::make().remove(m_animation_id);
+      m_animation_id = 0;
     }
-
-    m_log.trace("%s: Reached end of network subthread", name());
   }
 }
 
@@ -19,10 +19,20 @@ namespace modules {
     m_interval = m_conf.get(name(), "interval", m_interval);
 
     auto sink_name = m_conf.get(name(), "sink", ""s);
+    auto source_name = m_conf.get(name(), "source", ""s);
     bool m_max_volume = m_conf.get(name(), "use-ui-max", true);
 
+    if (!sink_name.empty() && !source_name.empty()) {
+      throw module_error("Only one of sink and source can be set");
+    }
+
+    // All modules share the same connection to the server
     try {
-      m_pulseaudio = factory_util::unique<pulseaudio>(m_log, move(sink_name), m_max_volume);
+      if (source_name.empty()) {
+        m_pulseaudio = factory_util::unique<pulseaudio>(m_log, pulseaudio::kind::SINK, move(sink_name), m_max_volume);
+      } else {
+        m_pulseaudio = factory_util::unique<pulseaudio>(m_log, pulseaudio::kind::SOURCE, move(source_name), m_max_volume);
+      }
     } catch (const pulseaudio_error& err) {
       throw module_error(err.what());
     }
@@ -49,6 +59,10 @@ namespace modules {
     m_pulseaudio.reset();
   }
 
+  int pulseaudio_module::event_fd() const {
+    return m_pulseaudio ? m_pulseaudio->get_event_fd() : -1;
+  }
+
   bool pulseaudio_module::has_event() {
     // Poll for mixer and control events
     try {
@@ -127,14 +141,14 @@ namespace modules {
     return m_builder->flush();
   }
 
-  bool pulseaudio_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_BAR_VOLUME) {
+  bool pulseaudio_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_BAR_VOLUME)) {
       builder->node(m_bar_volume->output(m_volume));
-    } else if (tag == TAG_RAMP_VOLUME) {
+    } else if (tag == TAG_ID(TAG_RAMP_VOLUME)) {
       builder->node(m_ramp_volume->get_by_percentage(m_volume));
-    } else if (tag == TAG_LABEL_VOLUME) {
+    } else if (tag == TAG_ID(TAG_LABEL_VOLUME)) {
       builder->node(m_label_volume);
-    } else if (tag == TAG_LABEL_MUTED) {
+    } else if (tag == TAG_ID(TAG_LABEL_MUTED)) {
       builder->node(m_label_muted);
     } else {
       return false;
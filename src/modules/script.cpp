@@ -1,4 +1,15 @@
 #include "modules/script.hpp"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <ctime>
+
+#include "components/reactor.hpp"
+#include "components/scheduler.hpp"
+#include "components/thread_policy.hpp"
 #include "drawtypes/label.hpp"
 #include "modules/meta/base.inl"
 
@@ -7,6 +18,31 @@ POLYBAR_NS
 namespace modules {
   template class module<script_module>;
 
+  namespace {
+    /**
+     * Write to a non-blocking pipe without raising SIGPIPE if the reader is gone
+     */
+    bool write_pipe(int fd, const string& data) {
+      sigset_t pipe_mask;
+      sigset_t old_mask;
+      sigemptyset(&pipe_mask);
+      sigaddset(&pipe_mask, SIGPIPE);
+      pthread_sigmask(SIG_BLOCK, &pipe_mask, &old_mask);
+
+      ssize_t written = write(fd, data.c_str(), data.size());
+      int error{errno};
+      if (written == -1 && error == EPIPE) {
+        // Consume the SIGPIPE that is now pending for this thread
+        struct timespec zero {};
+        sigtimedwait(&pipe_mask, nullptr, &zero);
+      }
+
+      pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+      errno = error;
+      return written == static_cast<ssize_t>(data.size());
+    }
+  }  // namespace
+
   /**
    * Construct script module by loading configuration values
    * and setting up formatting objects
@@ -32,13 +68,22 @@ namespace modules {
               }
             }
 
+            // The output is read by the reactor, this thread only waits until it's closed
             int fd = m_command->get_stdout(PIPE_READ);
-            while (!m_stopping && fd != -1 && m_command->is_running() && !io_util::poll(fd, POLLHUP, 0)) {
-              if (!io_util::poll_read(fd, 25)) {
-                continue;
-              } else if ((m_output = m_command->readline()) != m_prev) {
-                m_prev = m_output;
-                broadcast();
+            if (fd != -1 && m_command->is_running()) {
+              {
+                std::lock_guard<std::mutex> guard(m_taillock);
+                m_tail_closed = false;
+                m_tail_buffer.clear();
+              }
+
+              fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+              if (watch_fd(fd, EPOLLIN, [this](int ready) { receive_tail(ready); })) {
+                std::unique_lock<std::mutex> guard(m_taillock);
+                m_tailhandler.wait(guard, [&] { return m_tail_closed || m_stopping; });
+                guard.unlock();
+
+                unwatch_fd(fd);
               }
             }
 
@@ -53,37 +98,20 @@ namespace modules {
         }
 
         // }}}
-        // Handler for basic shell commands {{{
-
-        return [&] {
-          try {
-            auto exec = string_util::replace_all(m_exec, "%counter%", to_string(++m_counter));
-            m_log.info("%s: Invoking shell command: \"%s\"", name(), exec);
-            m_command = command_util::make_command<output_policy::REDIRECTED>(exec);
-            m_command->exec(true);
-          } catch (const exception& err) {
-            m_log.err("%s: %s", name(), err.what());
-            throw module_error("Failed to execute command, stopping module...");
-          }
-
-          int fd = m_command->get_stdout(PIPE_READ);
-          if (fd != -1 && io_util::poll_read(fd) && (m_output = m_command->readline()) != m_prev) {
-            broadcast();
-            m_prev = m_output;
-          } else if (m_command->get_exit_status() != 0) {
-            m_output.clear();
-            m_prev.clear();
-            broadcast();
-          }
-
-          return std::max(m_command->get_exit_status() == 0 ? m_interval : 1s, m_interval);
-        };
 
-        // }}}
+        // Basic shell commands are run by the script runner, see start()
+        return {};
       }()) {
     // Load configuration values
     m_exec = m_conf.get(name(), "exec", m_exec);
     m_exec_if = m_conf.get(name(), "exec-if", m_exec_if);
+    m_exec_if_interval = m_conf.get<decltype(m_exec_if_interval)>(name(), "exec-if-interval", 0s);
+    m_persistent = m_conf.get(name(), "exec-persistent", false);
+
+    if (m_persistent && m_tail) {
+      throw module_error("'exec-persistent' and 'tail' can't be used together");
+    }
+
     m_interval = m_conf.get<decltype(m_interval)>(name(), "interval", m_tail ? 0s : 5s);
 
     // Load configured click handlers
@@ -107,7 +135,21 @@ namespace modules {
    * Start the module worker
    */
   void script_module::start() {
-    m_mainthread = thread([&] {
+    if (m_persistent) {
+      m_task = scheduler::make().add(name(), chrono::duration_cast<scheduler::duration>(m_interval),
+          [this] { tick_persistent(); }, scheduler::duration::zero(), scheduler::duration::zero(),
+          scheduler::SUSPENDABLE | scheduler::STRETCHABLE | scheduler::BACKGROUND);
+      return;
+    } else if (!m_tail) {
+      m_script = script_runner::make().add(m_exec_if,
+          [this] { return string_util::replace_all(m_exec, "%counter%", to_string(++m_counter)); },
+          [this](const script_runner::result& result) { return process_result(result); },
+          chrono::duration_cast<script_runner::duration>(m_interval),
+          chrono::duration_cast<script_runner::duration>(m_exec_if_interval));
+      return;
+    }
+
+    m_mainthread = thread_policy::spawn(thread_policy::role::WORKER, [&] {
       try {
         while (running() && !m_stopping) {
           if (check_condition()) {
@@ -128,11 +170,27 @@ namespace modules {
    * Stop the module worker by terminating any running commands
    */
   void script_module::stop() {
-    m_stopping = true;
+    {
+      std::lock_guard<std::mutex> guard(m_taillock);
+      m_stopping = true;
+    }
+    m_tailhandler.notify_all();
+
+    if (m_script != 0) {
+      script_runner::make().remove(m_script);
+      m_script = 0;
+    }
+    if (m_task != 0) {
+      scheduler::make().remove(m_task);
+      m_task = 0;
+    }
     wakeup();
 
     std::lock_guard<decltype(m_handler)> guard(m_handler);
 
+    if (m_persistent && m_command) {
+      unwatch_fd(m_command->get_stdout(PIPE_READ));
+    }
     m_command.reset();
     module::stop();
   }
@@ -143,7 +201,16 @@ namespace modules {
   bool script_module::check_condition() {
     if (m_exec_if.empty()) {
       return true;
-    } else if (command_util::make_command<output_policy::IGNORED>(m_exec_if)->exec(true) == 0) {
+    }
+
+    // The result is reused for `exec-if-interval`
+    auto now = chrono::steady_clock::now();
+    if (now >= m_exec_if_until) {
+      m_exec_if_met = command_util::make_command<output_policy::IGNORED>(m_exec_if)->exec(true) == 0;
+      m_exec_if_until = now + chrono::duration_cast<chrono::steady_clock::duration>(m_exec_if_interval);
+    }
+
+    if (m_exec_if_met) {
       return true;
     } else if (!m_output.empty()) {
       broadcast();
@@ -153,6 +220,136 @@ namespace modules {
     return false;
   }
 
+  /**
+   * Write the counter to the input of the persistent command, which answers
+   * with a line on its output
+   *
+   * The command is started on the first tick and started again once it exited.
+   * Its answers are read by the reactor, like the output of tailed commands.
+   */
+  void script_module::tick_persistent() {
+    if (!check_condition()) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_taillock);
+    if (m_stopping) {
+      return;
+    }
+
+    string counter{to_string(++m_counter)};
+
+    if (!m_command || m_tail_closed || !m_command->is_running()) {
+      if (m_command) {
+        unwatch_fd(m_command->get_stdout(PIPE_READ));
+      }
+
+      string exec{string_util::replace_all(m_exec, "%counter%", counter)};
+      m_log.info("%s: Starting persistent shell command: \"%s\"", name(), exec);
+
+      try {
+        m_command = command_util::make_command<output_policy::REDIRECTED>(exec);
+        m_command->exec(false);
+      } catch (const exception& err) {
+        m_log.err("%s: Failed to start persistent command (%s)", name(), err.what());
+        m_command.reset();
+        return;
+      }
+
+      int out = m_command->get_stdout(PIPE_READ);
+      int in = m_command->get_stdin(PIPE_WRITE);
+      fcntl(out, F_SETFL, fcntl(out, F_GETFL) | O_NONBLOCK);
+      fcntl(in, F_SETFL, fcntl(in, F_GETFL) | O_NONBLOCK);
+
+      m_tail_closed = false;
+      m_tail_buffer.clear();
+      watch_fd(out, EPOLLIN, [this](int ready) { receive_tail(ready); });
+    }
+
+    if (!write_pipe(m_command->get_stdin(PIPE_WRITE), counter + "\n")) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        m_log.warn("%s: Persistent command doesn't read its input, skipping tick", name());
+      } else {
+        // It is started again on the next tick
+        m_log.warn("%s: Failed to write to persistent command (err: %s)", name(), strerror(errno));
+        m_tail_closed = true;
+      }
+    }
+  }
+
+  /**
+   * Read everything the tailed command wrote so far, only the last complete
+   * line is shown
+   *
+   * Called by the reactor on the main thread
+   */
+  void script_module::receive_tail(int fd) {
+    std::lock_guard<std::mutex> guard(m_taillock);
+
+    char buffer[BUFSIZ];
+    bool closed{false};
+    while (true) {
+      ssize_t bytes = read(fd, buffer, sizeof(buffer));
+      if (bytes > 0) {
+        m_tail_buffer.append(buffer, bytes);
+      } else if (bytes == -1 && errno == EINTR) {
+        continue;
+      } else {
+        closed = bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+        break;
+      }
+    }
+
+    auto end = m_tail_buffer.rfind('\n');
+    if (end != string::npos) {
+      auto begin = end == 0 ? string::npos : m_tail_buffer.rfind('\n', end - 1);
+      begin = begin == string::npos ? 0 : begin + 1;
+      string line{m_tail_buffer.substr(begin, end - begin)};
+      m_tail_buffer.erase(0, end + 1);
+
+      if ((m_output = move(line)) != m_prev) {
+        m_prev = m_output;
+        broadcast();
+      }
+    }
+
+    if (closed) {
+      unwatch_fd(fd);
+      m_tail_closed = true;
+      m_tailhandler.notify_all();
+    }
+  }
+
+  /**
+   * Take over the output of a basic shell command
+   *
+   * \returns Time until the next run
+   */
+  script_runner::duration script_module::process_result(const script_runner::result& result) {
+    chrono::duration<double> delay;
+
+    if (!result.ran) {
+      if (!m_output.empty()) {
+        broadcast();
+        m_output.clear();
+        m_prev.clear();
+      }
+      delay = m_interval > 1s ? m_interval : 1s;
+    } else {
+      if (!result.output.empty() && (m_output = result.output.substr(0, result.output.find('\n'))) != m_prev) {
+        broadcast();
+        m_prev = m_output;
+      } else if (result.status != 0 && !(m_output.empty() && m_prev.empty())) {
+        m_output.clear();
+        m_prev.clear();
+        broadcast();
+      }
+      delay = std::max(result.status == 0 ? m_interval : 1s, m_interval);
+    }
+
+    return chrono::duration_cast<script_runner::duration>(delay);
+  }
+
   /**
    * Process mutex wrapped script handler
    */
@@ -185,16 +382,16 @@ namespace modules {
       auto action = m_actions[btn];
 
       if (!action.empty()) {
-        auto action_replaced = string_util::replace_all(action, "%counter%", cnt);
+        string_util::replace_all_inplace(action, "%counter%", cnt);
 
         /*
-         * The pid token is only for tailed commands.
+         * The pid token is only for tailed and persistent commands.
          * If the command is not specified or running, replacement is unnecessary as well
          */
-        if(m_tail && m_command && m_command->is_running()) {
-          action_replaced = string_util::replace_all(action_replaced, "%pid%", to_string(m_command->get_pid()));
+        if((m_tail || m_persistent) && m_command && m_command->is_running()) {
+          string_util::replace_all_inplace(action, "%pid%", to_string(m_command->get_pid()));
         }
-        m_builder->action(btn, action_replaced);
+        m_builder->action(btn, action);
       }
     }
 
@@ -206,8 +403,8 @@ namespace modules {
   /**
    * Output format tags
    */
-  bool script_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL) {
+  bool script_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL)) {
       builder->node(m_label);
     } else {
       return false;
@@ -39,10 +39,10 @@ namespace modules {
   /**
    * Build output
    */
-  bool systray_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL_TOGGLE) {
+  bool systray_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL_TOGGLE)) {
       builder->action(mousebtn::LEFT, *this, EVENT_TOGGLE, "", m_label);
-    } else if (tag == TAG_TRAY_CLIENTS && !m_hidden) {
+    } else if (tag == TAG_ID(TAG_TRAY_CLIENTS) && !m_hidden) {
       builder->append(TRAY_PLACEHOLDER);
     } else {
       return false;
@@ -1,10 +1,13 @@
 #include "modules/temperature.hpp"
 
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+
 #include "drawtypes/label.hpp"
 #include "drawtypes/ramp.hpp"
 #include "utils/file.hpp"
 #include "utils/math.hpp"
-#include <cmath>
 
 #include "modules/meta/base.inl"
 
@@ -13,25 +16,65 @@ POLYBAR_NS
 namespace modules {
   template class module<temperature_module>;
 
+  namespace {
+    /**
+     * Files matching the given pattern
+     *
+     * The hwmon numbering is only stable while the system is up, so patterns
+     * are expanded once and shared by all modules that use the same one.
+     */
+    vector<string> discover(const string& pattern) {
+      static std::mutex lock;
+      static std::unordered_map<string, vector<string>> cache;
+
+      std::lock_guard<std::mutex> guard(lock);
+      auto it = cache.find(pattern);
+      if (it == cache.end()) {
+        it = cache.emplace(pattern, file_util::glob(pattern)).first;
+      }
+      return it->second;
+    }
+  }  // namespace
+
   temperature_module::temperature_module(const bar_settings& bar, string name_)
       : timer_module<temperature_module>(bar, move(name_)) {
-    m_zone = m_conf.get(name(), "thermal-zone", 0);
-    m_path = m_conf.get(name(), "hwmon-path", ""s);
     m_tempbase = m_conf.get(name(), "base-temperature", 0);
     m_tempwarn = m_conf.get(name(), "warn-temperature", 80);
     set_interval(1s);
     m_units = m_conf.get(name(), "units", m_units);
 
-    if (m_path.empty()) {
-      m_path = string_util::replace(PATH_TEMPERATURE_INFO, "%zone%", to_string(m_zone));
+    // Either a single sensor or lists of them, hwmon paths may be glob patterns
+    vector<string> patterns;
+    auto paths = m_conf.get_list(name(), "hwmon-path", vector<string>{});
+    auto zones = m_conf.get_list(name(), "thermal-zone", vector<int>{});
+    if (paths.empty() && zones.empty()) {
+      auto path = m_conf.get(name(), "hwmon-path", ""s);
+      if (!path.empty()) {
+        paths.emplace_back(move(path));
+      } else {
+        zones.emplace_back(m_conf.get(name(), "thermal-zone", 0));
+      }
+    }
+    for (auto&& path : paths) {
+      patterns.emplace_back(move(path));
+    }
+    for (auto zone : zones) {
+      patterns.emplace_back(string_util::replace(PATH_TEMPERATURE_INFO, "%zone%", to_string(zone)));
     }
 
-    if (!file_util::exists(m_path)) {
-      throw module_error("The file '" + m_path + "' does not exist");
+    for (auto&& pattern : patterns) {
+      auto matches = discover(pattern);
+      if (matches.empty()) {
+        throw module_error("The file '" + pattern + "' does not exist");
+      }
+      for (auto&& path : matches) {
+        m_sensors.emplace_back(make_unique<reread_file>(path));
+        m_sensor_files.emplace_back(m_sensors.back().get());
+      }
     }
 
-    m_formatter->add(DEFAULT_FORMAT, TAG_LABEL, {TAG_LABEL, TAG_RAMP});
-    m_formatter->add(FORMAT_WARN, TAG_LABEL_WARN, {TAG_LABEL_WARN, TAG_RAMP});
+    m_formatter->add(DEFAULT_FORMAT, TAG_LABEL, {TAG_LABEL, TAG_RAMP, TAG_GRAPH});
+    m_formatter->add(FORMAT_WARN, TAG_LABEL_WARN, {TAG_LABEL_WARN, TAG_RAMP, TAG_GRAPH});
 
     if (m_formatter->has(TAG_LABEL)) {
       m_label[temp_state::NORMAL] = load_optional_label(m_conf, name(), TAG_LABEL, "%temperature-c%");
@@ -42,6 +85,10 @@ namespace modules {
     if (m_formatter->has(TAG_RAMP)) {
       m_ramp = load_ramp(m_conf, name(), TAG_RAMP);
     }
+    if (m_formatter->has(TAG_GRAPH)) {
+      m_graph_width = m_conf.get(name(), "graph-width", m_graph_width);
+      m_history.resize(history_size());
+    }
 
     // Deprecation warning for the %temperature% token
     if((m_label[temp_state::NORMAL] && m_label[temp_state::NORMAL]->has_token("%temperature%")) ||
@@ -51,22 +98,46 @@ namespace modules {
   }
 
   bool temperature_module::update() {
-    m_temp = std::strtol(file_util::contents(m_path).c_str(), nullptr, 10) / 1000.0f + 0.5f;
-    int temp_f = floor(((1.8 * m_temp) + 32) + 0.5);
-
-    string temp_c_string = to_string(m_temp);
-    string temp_f_string = to_string(temp_f);
-
-    // Add units if `units = true` in config
-    if(m_units) {
-      temp_c_string += "°C";
-      temp_f_string += "°F";
+    m_max = 0;
+    long sum{0};
+    reread_file::read_all(m_sensor_files);
+    for (size_t i = 0; i < m_sensors.size(); i++) {
+      int temp = std::strtol(m_sensors[i]->contents(), nullptr, 10) / 1000.0f + 0.5f;
+      if (i == 0 || temp > m_max) {
+        m_max = temp;
+      }
+      if (i == 0) {
+        m_temp = temp;
+      }
+      sum += temp;
     }
+    m_avg = std::lround(static_cast<double>(sum) / m_sensors.size());
+    m_history.push(math_util::percentage<float, float>(m_max, m_tempbase, m_tempwarn));
+
+    const auto format = [&](int temp_c, string& celsius, string& fahrenheit) {
+      celsius = to_string(temp_c);
+      fahrenheit = to_string(static_cast<int>(floor(((1.8 * temp_c) + 32) + 0.5)));
+
+      // Add units if `units = true` in config
+      if (m_units) {
+        celsius += "°C";
+        fahrenheit += "°F";
+      }
+    };
+
+    string temp_c_string, temp_f_string, max_c_string, max_f_string, avg_c_string, avg_f_string;
+    format(m_temp, temp_c_string, temp_f_string);
+    format(m_max, max_c_string, max_f_string);
+    format(m_avg, avg_c_string, avg_f_string);
 
     const auto replace_tokens = [&](label_t& label) {
       label->reset_tokens();
       label->replace_token("%temperature-f%", temp_f_string);
       label->replace_token("%temperature-c%", temp_c_string);
+      label->replace_token("%max-f%", max_f_string);
+      label->replace_token("%max-c%", max_c_string);
+      label->replace_token("%avg-f%", avg_f_string);
+      label->replace_token("%avg-c%", avg_c_string);
 
       // DEPRECATED: Will be removed in later release
       label->replace_token("%temperature%", temp_c_string);
@@ -83,20 +154,22 @@ namespace modules {
   }
 
   string temperature_module::get_format() const {
-    if (m_temp >= m_tempwarn) {
+    if (m_max >= m_tempwarn) {
       return FORMAT_WARN;
     } else {
       return DEFAULT_FORMAT;
     }
   }
 
-  bool temperature_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL) {
+  bool temperature_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL)) {
       builder->node(m_label.at(temp_state::NORMAL));
-    } else if (tag == TAG_LABEL_WARN) {
+    } else if (tag == TAG_ID(TAG_LABEL_WARN)) {
       builder->node(m_label.at(temp_state::WARN));
-    } else if (tag == TAG_RAMP) {
-      builder->node(m_ramp->get_by_percentage_with_borders(m_temp, m_tempbase, m_tempwarn));
+    } else if (tag == TAG_ID(TAG_RAMP)) {
+      builder->node(m_ramp->get_by_percentage_with_borders(m_max, m_tempbase, m_tempwarn));
+    } else if (tag == TAG_ID(TAG_GRAPH)) {
+      builder->graph(tags::graph_type::SPARKLINE, m_graph_width, m_history.values());
     } else {
       return false;
     }
@@ -131,12 +131,12 @@ namespace modules {
   /**
    * Output content as defined in the config
    */
-  bool xbacklight_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_BAR) {
+  bool xbacklight_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_BAR)) {
       builder->node(m_progressbar->output(m_percentage));
-    } else if (tag == TAG_RAMP) {
+    } else if (tag == TAG_ID(TAG_RAMP)) {
       builder->node(m_ramp->get_by_percentage(m_percentage));
-    } else if (tag == TAG_LABEL) {
+    } else if (tag == TAG_ID(TAG_LABEL)) {
       builder->node(m_label);
     } else {
       return false;
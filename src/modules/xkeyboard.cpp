@@ -25,15 +25,27 @@ namespace modules {
    */
   xkeyboard_module::xkeyboard_module(const bar_settings& bar, string name_)
       : static_module<xkeyboard_module>(bar, move(name_)), m_connection(connection::make()) {
-    // Setup extension
+    // Setup extension, state notifications are only selected for group changes. Selecting all of them would send an
+    // event for every modifier key that is pressed while typing
+    const unsigned int names{
+        XCB_XKB_NAME_DETAIL_GROUP_NAMES | XCB_XKB_NAME_DETAIL_SYMBOLS | XCB_XKB_NAME_DETAIL_INDICATOR_NAMES};
+
+    xcb_xkb_select_events_details_t details{};
+    details.affectNewKeyboard = XCB_XKB_NKN_DETAIL_KEYCODES;
+    details.newKeyboardDetails = XCB_XKB_NKN_DETAIL_KEYCODES;
+    details.affectState = XCB_XKB_STATE_PART_GROUP_STATE;
+    details.stateDetails = XCB_XKB_STATE_PART_GROUP_STATE;
+    details.affectIndicatorState = 0xFFFFFFFF;
+    details.indicatorStateDetails = 0xFFFFFFFF;
+    details.affectNames = names;
+    details.namesDetails = names;
+
     // clang-format off
-    m_connection.xkb().select_events_checked(XCB_XKB_ID_USE_CORE_KBD,
-      XCB_XKB_EVENT_TYPE_NEW_KEYBOARD_NOTIFY |
-      XCB_XKB_EVENT_TYPE_STATE_NOTIFY |
-      XCB_XKB_EVENT_TYPE_INDICATOR_STATE_NOTIFY, 0,
+    xcb_xkb_select_events_aux_checked(m_connection, XCB_XKB_ID_USE_CORE_KBD,
       XCB_XKB_EVENT_TYPE_NEW_KEYBOARD_NOTIFY |
+      XCB_XKB_EVENT_TYPE_NAMES_NOTIFY |
       XCB_XKB_EVENT_TYPE_STATE_NOTIFY |
-      XCB_XKB_EVENT_TYPE_INDICATOR_STATE_NOTIFY, 0, 0, nullptr);
+      XCB_XKB_EVENT_TYPE_INDICATOR_STATE_NOTIFY, 0, 0, 0, 0, &details);
     // clang-format on
 
     // Create keyboard object
@@ -184,10 +196,10 @@ namespace modules {
   /**
    * Map format tags to content
    */
-  bool xkeyboard_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL_LAYOUT) {
+  bool xkeyboard_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL_LAYOUT)) {
       builder->node(m_layout);
-    } else if (tag == TAG_LABEL_INDICATOR && !m_indicators.empty()) {
+    } else if (tag == TAG_ID(TAG_LABEL_INDICATOR) && !m_indicators.empty()) {
       size_t n{0};
       for (auto&& indicator : m_indicators) {
         if (*indicator.second) {
@@ -221,7 +233,7 @@ namespace modules {
 
     xkb_util::switch_layout(m_connection, XCB_XKB_ID_USE_CORE_KBD, current_group);
     m_keyboard->current(current_group);
-    m_connection.flush();
+    m_connection.request_flush();
 
     update();
 
@@ -261,9 +273,18 @@ namespace modules {
    * Handler for XCB_XKB_NEW_KEYBOARD_NOTIFY events
    */
   void xkeyboard_module::handle(const evt::xkb_new_keyboard_notify& evt) {
-    if (evt->changed & XCB_XKB_NKN_DETAIL_KEYCODES && m_xkb_newkb_notify.allow(evt->time)) {
-      query_keyboard();
-      update();
+    if (evt->changed & XCB_XKB_NKN_DETAIL_KEYCODES) {
+      m_keyboard_changed = true;
+    }
+  }
+
+  /**
+   * Handler for XCB_XKB_NAMES_NOTIFY events
+   */
+  void xkeyboard_module::handle(const evt::xkb_names_notify& evt) {
+    if (evt->changed &
+        (XCB_XKB_NAME_DETAIL_GROUP_NAMES | XCB_XKB_NAME_DETAIL_SYMBOLS | XCB_XKB_NAME_DETAIL_INDICATOR_NAMES)) {
+      m_keyboard_changed = true;
     }
   }
 
@@ -271,18 +292,41 @@ namespace modules {
    * Handler for XCB_XKB_STATE_NOTIFY events
    */
   void xkeyboard_module::handle(const evt::xkb_state_notify& evt) {
-    if (m_keyboard && evt->changed & XCB_XKB_STATE_PART_GROUP_STATE && m_xkb_state_notify.allow(evt->time)) {
+    if (m_keyboard && evt->changed & XCB_XKB_STATE_PART_GROUP_STATE && evt->group != m_keyboard->current()) {
       m_keyboard->current(evt->group);
-      update();
+      m_group_changed = true;
     }
   }
 
   /**
    * Handler for XCB_XKB_INDICATOR_STATE_NOTIFY events
    */
-  void xkeyboard_module::handle(const evt::xkb_indicator_state_notify& evt) {
-    if (m_keyboard && m_xkb_indicator_notify.allow(evt->time)) {
-      m_keyboard->set(m_connection.xkb().get_state(XCB_XKB_ID_USE_CORE_KBD)->lockedMods);
+  void xkeyboard_module::handle(const evt::xkb_indicator_state_notify&) {
+    m_indicators_changed = true;
+  }
+
+  /**
+   * Update once for the whole burst of XKB events, if anything that is shown changed
+   */
+  void xkeyboard_module::events_handled() {
+    if (!m_keyboard_changed && !m_indicators_changed && !m_group_changed) {
+      return;
+    }
+
+    bool changed{m_group_changed};
+
+    if (m_keyboard_changed) {
+      query_keyboard();
+      changed = true;
+    } else if (m_indicators_changed && m_keyboard) {
+      changed = m_keyboard->set(m_connection.xkb().get_state(XCB_XKB_ID_USE_CORE_KBD)->lockedMods) || changed;
+    }
+
+    m_keyboard_changed = false;
+    m_indicators_changed = false;
+    m_group_changed = false;
+
+    if (changed) {
       update();
     }
   }
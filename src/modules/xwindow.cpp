@@ -1,4 +1,5 @@
 #include "modules/xwindow.hpp"
+#include "components/thread_policy.hpp"
 #include "drawtypes/label.hpp"
 #include "utils/factory.hpp"
 #include "x11/atoms.hpp"
@@ -15,10 +16,10 @@ namespace modules {
    * Wrapper used to update the event mask of the
    * currently active to enable title tracking
    */
-  active_window::active_window(xcb_connection_t* conn, xcb_window_t win) : m_connection(conn), m_window(win) {
+  active_window::active_window(connection& conn, xcb_window_t win) : m_connection(conn), m_window(win) {
     if (m_window != XCB_NONE) {
-      const unsigned int mask{XCB_EVENT_MASK_PROPERTY_CHANGE};
-      xcb_change_window_attributes(m_connection, m_window, XCB_CW_EVENT_MASK, &mask);
+      // Also lets the connection cache the title until it changes, a window that is already gone is skipped
+      m_connection.ensure_event_mask(vector<xcb_window_t>{m_window}, XCB_EVENT_MASK_PROPERTY_CHANGE);
     }
   }
 
@@ -27,8 +28,7 @@ namespace modules {
    */
   active_window::~active_window() {
     if (m_window != XCB_NONE) {
-      const unsigned int mask{XCB_EVENT_MASK_NO_EVENT};
-      xcb_change_window_attributes(m_connection, m_window, XCB_CW_EVENT_MASK, &mask);
+      m_connection.clear_event_mask(m_window);
     }
   }
 
@@ -39,6 +39,13 @@ namespace modules {
     return m_window == win;
   }
 
+  /**
+   * Get the id of the window
+   */
+  xcb_window_t active_window::window() const {
+    return m_window;
+  }
+
   /**
    * Get the title by returning the first non-empty value of:
    *  _NET_WM_NAME
@@ -80,25 +87,71 @@ namespace modules {
       m_statelabels.emplace(state::ACTIVE, load_optional_label(m_conf, name(), "label", "%title%"));
       m_statelabels.emplace(state::EMPTY, load_optional_label(m_conf, name(), "label-empty", ""));
     }
+
+    m_title_interval = chrono::duration_cast<chrono::microseconds>(chrono::seconds{1}) / m_bar.max_fps;
+  }
+
+  /**
+   * Show the initial title, then apply title changes as they come in
+   *
+   * A title change that arrives less than a frame after the previous one is
+   * held back until the frame is over, changes in the meantime replace it
+   */
+  void xwindow_module::start() {
+    m_mainthread = thread_policy::spawn(thread_policy::role::WORKER, [&] {
+      m_log.trace("%s: Thread id = %i", name(), concurrency_util::thread_id(this_thread::get_id()));
+      {
+        update_timer timer{*this};
+        update(true);
+      }
+      broadcast();
+
+      std::unique_lock<std::mutex> lck(m_sleeplock);
+      while (running()) {
+        m_sleephandler.wait(lck, [&] { return m_title_pending || !running(); });
+        m_sleephandler.wait_until(lck, m_title_time + m_title_interval, [&] { return !running(); });
+
+        if (!running()) {
+          break;
+        }
+
+        m_title_pending = false;
+        lck.unlock();
+        update();
+        broadcast();
+        lck.lock();
+      }
+    });
+  }
+
+  vector<xcb_atom_t> xwindow_module::property_atoms() const {
+    return {_NET_ACTIVE_WINDOW, _NET_CURRENT_DESKTOP, _NET_WM_VISIBLE_NAME, _NET_WM_NAME};
+  }
+
+  /**
+   * Wake up the thread while holding the lock, so that it can't miss the stop
+   */
+  void xwindow_module::teardown() {
+    std::lock_guard<std::mutex> guard(m_sleeplock);
+    m_sleephandler.notify_all();
   }
 
   /**
    * Handler for XCB_PROPERTY_NOTIFY events
    */
   void xwindow_module::handle(const evt::property_notify& evt) {
-    if (evt->atom == _NET_ACTIVE_WINDOW) {
-      update(true);
-    } else if (evt->atom == _NET_CURRENT_DESKTOP) {
+    if (evt->atom == _NET_ACTIVE_WINDOW || evt->atom == _NET_CURRENT_DESKTOP) {
       update(true);
-    } else if (evt->atom == _NET_WM_VISIBLE_NAME) {
-      update();
-    } else if (evt->atom == _NET_WM_NAME) {
-      update();
-    } else {
-      return;
+      broadcast();
+    } else if (evt->atom == _NET_WM_VISIBLE_NAME || evt->atom == _NET_WM_NAME) {
+      if (evt->window != m_window) {
+        return;
+      }
+
+      std::lock_guard<std::mutex> guard(m_sleeplock);
+      m_title_pending = true;
+      m_sleephandler.notify_all();
     }
-
-    broadcast();
   }
 
   /**
@@ -119,20 +172,34 @@ namespace modules {
       m_active = make_unique<active_window>(m_connection, win);
     }
 
+    m_window = m_active ? m_active->window() : XCB_NONE;
+
+    {
+      std::lock_guard<std::mutex> guard(m_sleeplock);
+      m_title_time = chrono::steady_clock::now();
+    }
+
     if (m_active) {
-      m_label = m_statelabels.at(state::ACTIVE)->clone();
+      string title = m_active->title();
+      if (m_label && m_label == m_statelabels.at(state::ACTIVE) && title == m_title) {
+        return;
+      }
+
+      // The label is reused, so that it keeps the truncated titles it has seen
+      m_title = move(title);
+      m_label = m_statelabels.at(state::ACTIVE);
       m_label->reset_tokens();
-      m_label->replace_token("%title%", m_active->title());
+      m_label->replace_token("%title%", m_title);
     } else {
-      m_label = m_statelabels.at(state::EMPTY)->clone();
+      m_label = m_statelabels.at(state::EMPTY);
     }
   }
 
   /**
    * Output content as defined in the config
    */
-  bool xwindow_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL && m_label && m_label.get()) {
+  bool xwindow_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL) && m_label && m_label.get()) {
       builder->node(m_label);
       return true;
     }
@@ -100,54 +100,156 @@ namespace modules {
     rebuild_desktop_states();
   }
 
+  vector<xcb_atom_t> xworkspaces_module::property_atoms() const {
+    return {m_ewmh->_NET_CLIENT_LIST, m_ewmh->_NET_WM_DESKTOP, m_ewmh->_NET_DESKTOP_NAMES,
+        m_ewmh->_NET_NUMBER_OF_DESKTOPS, m_ewmh->_NET_CURRENT_DESKTOP, WM_HINTS};
+  }
+
   /**
    * Handler for XCB_PROPERTY_NOTIFY events
    */
   void xworkspaces_module::handle(const evt::property_notify& evt) {
     std::lock_guard<std::mutex> lock(m_workspace_mutex);
 
-    if (evt->atom == m_ewmh->_NET_CLIENT_LIST || evt->atom == m_ewmh->_NET_WM_DESKTOP) {
-      rebuild_clientlist();
-      rebuild_desktop_states();
+    // Only noted here, closing many windows at once must not rebuild everything for each of them
+    if (evt->atom == m_ewmh->_NET_CLIENT_LIST) {
+      m_clients_changed = true;
+    } else if (evt->atom == m_ewmh->_NET_WM_DESKTOP) {
+      m_desktops_changed.emplace(evt->window);
     } else if (evt->atom == m_ewmh->_NET_DESKTOP_NAMES || evt->atom == m_ewmh->_NET_NUMBER_OF_DESKTOPS) {
+      m_names_changed = true;
+    } else if (evt->atom == m_ewmh->_NET_CURRENT_DESKTOP) {
+      m_current_changed = true;
+    } else if (evt->atom == WM_HINTS) {
+      m_hints_changed.emplace(evt->window);
+    }
+  }
+
+  /**
+   * Rebuild what changed during the last burst of X events
+   */
+  void xworkspaces_module::events_handled() {
+    std::lock_guard<std::mutex> lock(m_workspace_mutex);
+
+    if (!m_names_changed && !m_clients_changed && !m_current_changed && m_desktops_changed.empty() &&
+        m_hints_changed.empty()) {
+      return;
+    }
+
+    bool states_changed{m_names_changed || m_clients_changed || m_current_changed || !m_desktops_changed.empty()};
+
+    if (m_names_changed) {
       m_desktop_names = get_desktop_names();
       rebuild_desktops();
+    }
+    if (m_clients_changed) {
       rebuild_clientlist();
-      rebuild_desktop_states();
-    } else if (evt->atom == m_ewmh->_NET_CURRENT_DESKTOP) {
+    }
+    if (!m_desktops_changed.empty()) {
+      update_client_desktops(m_desktops_changed);
+    }
+    if (m_current_changed) {
       m_current_desktop = ewmh_util::get_current_desktop();
       m_current_desktop_name = m_desktop_names[m_current_desktop];
+    }
+    if (states_changed) {
       rebuild_desktop_states();
-    } else if (evt->atom == WM_HINTS) {
-      if (icccm_util::get_wm_urgency(m_connection, evt->window)) {
-        set_desktop_urgent(evt->window);
+    }
+
+    // After rebuilding the states, which would reset the urgent desktops again
+    for (auto window : m_hints_changed) {
+      if (icccm_util::get_wm_urgency(m_connection, window)) {
+        set_desktop_urgent(window);
       }
-    } else {
-      return;
     }
 
+    m_names_changed = false;
+    m_clients_changed = false;
+    m_desktops_changed.clear();
+    m_current_changed = false;
+    m_hints_changed.clear();
+
     broadcast();
   }
 
   /**
-   * Rebuild the list of managed clients
+   * Update the list of managed clients from _NET_CLIENT_LIST
+   *
+   * Only the desktops of new clients are queried, changes of the desktop of a
+   * known client are reported by PropertyNotify events on the client itself.
    */
   void xworkspaces_module::rebuild_clientlist() {
     vector<xcb_window_t> newclients = ewmh_util::get_client_list();
     std::sort(newclients.begin(), newclients.end());
 
+    // Both are sorted by window
+    vector<xcb_window_t> removed;
+    vector<xcb_window_t> added;
+    auto known = m_clients.begin();
     for (auto&& client : newclients) {
-      if (m_clients.count(client) == 0) {
-        // new client: listen for changes (wm_hint or desktop)
-        m_connection.ensure_event_mask(client, XCB_EVENT_MASK_PROPERTY_CHANGE);
+      for (; known != m_clients.end() && known->first < client; ++known) {
+        removed.emplace_back(known->first);
+      }
+      if (known != m_clients.end() && known->first == client) {
+        ++known;
+      } else {
+        added.emplace_back(client);
       }
     }
+    for (; known != m_clients.end(); ++known) {
+      removed.emplace_back(known->first);
+    }
 
-    // rebuild entire mapping of clients to desktops
-    m_clients.clear();
-    for (auto&& client : newclients) {
-      m_clients[client] = ewmh_util::get_desktop_from_window(client);
+    for (auto&& client : removed) {
+      remove_client(client);
+    }
+
+    if (!added.empty()) {
+      // new clients: listen for changes (wm_hint or desktop)
+      m_connection.ensure_event_mask(added, XCB_EVENT_MASK_PROPERTY_CHANGE);
+
+      auto desktops = ewmh_util::get_desktops_from_windows(added);
+      for (size_t i = 0; i < added.size(); i++) {
+        add_client(added[i], desktops[i]);
+      }
+    }
+  }
+
+  /**
+   * Query the desktops of the given clients again
+   */
+  void xworkspaces_module::update_client_desktops(const std::set<xcb_window_t>& windows) {
+    vector<xcb_window_t> clients;
+    for (auto&& window : windows) {
+      // Also reported for windows that were just removed from the client list
+      if (m_clients.count(window) > 0) {
+        clients.emplace_back(window);
+      }
+    }
+
+    auto desktops = ewmh_util::get_desktops_from_windows(clients);
+    for (size_t i = 0; i < clients.size(); i++) {
+      remove_client(clients[i]);
+      add_client(clients[i], desktops[i]);
+    }
+  }
+
+  void xworkspaces_module::add_client(xcb_window_t window, unsigned int desktop) {
+    m_clients[window] = desktop;
+    m_occupancy[desktop]++;
+  }
+
+  void xworkspaces_module::remove_client(xcb_window_t window) {
+    auto client = m_clients.find(window);
+    if (client == m_clients.end()) {
+      return;
     }
+
+    auto count = m_occupancy.find(client->second);
+    if (count != m_occupancy.end() && --count->second == 0) {
+      m_occupancy.erase(count);
+    }
+    m_clients.erase(client);
   }
 
   /**
@@ -236,16 +338,11 @@ namespace modules {
    * Update active state of current desktops
    */
   void xworkspaces_module::rebuild_desktop_states() {
-    std::set<unsigned int> occupied_desks;
-    for (auto&& c : m_clients) {
-      occupied_desks.insert(c.second);
-    }
-
     for (auto&& v : m_viewports) {
       for (auto&& d : v->desktops) {
         if (d->index == m_current_desktop) {
           d->state = desktop_state::ACTIVE;
-        } else if (occupied_desks.count(d->index) > 0) {
+        } else if (m_occupancy.count(d->index) > 0) {
           d->state = desktop_state::OCCUPIED;
         } else {
           d->state = desktop_state::EMPTY;
@@ -261,8 +358,9 @@ namespace modules {
   }
 
   vector<string> xworkspaces_module::get_desktop_names() {
-    vector<string> names = ewmh_util::get_desktop_names();
-    unsigned int desktops_number = ewmh_util::get_number_of_desktops();
+    auto desktops = ewmh_util::get_desktop_list();
+    vector<string> names = move(desktops.names);
+    unsigned int desktops_number = desktops.count;
     if (desktops_number == names.size()) {
       return names;
     } else if (desktops_number < names.size()) {
@@ -279,7 +377,8 @@ namespace modules {
    * Find window and set corresponding desktop to urgent
    */
   void xworkspaces_module::set_desktop_urgent(xcb_window_t window) {
-    auto desk = ewmh_util::get_desktop_from_window(window);
+    auto client = m_clients.find(window);
+    auto desk = client != m_clients.end() ? client->second : ewmh_util::get_desktop_from_window(window);
     if (desk == m_current_desktop)
       // ignore if current desktop is urgent
       return;
@@ -337,15 +436,15 @@ namespace modules {
   /**
    * Output content as defined in the config
    */
-  bool xworkspaces_module::build(builder* builder, const string& tag) const {
-    if (tag == TAG_LABEL_MONITOR) {
+  bool xworkspaces_module::build(builder* builder, const module_tag& tag) const {
+    if (tag == TAG_ID(TAG_LABEL_MONITOR)) {
       if (m_viewports[m_index]->state != viewport_state::NONE) {
         builder->node(m_viewports[m_index]->label);
         return true;
       } else {
         return false;
       }
-    } else if (tag == TAG_LABEL_STATE) {
+    } else if (tag == TAG_ID(TAG_LABEL_STATE)) {
       unsigned int added_states = 0;
       for (auto&& desktop : m_viewports[m_index]->desktops) {
         if (desktop->label.get()) {
@@ -2,8 +2,10 @@
 
 #include <algorithm>
 
-#include "events/signal.hpp"
-#include "events/signal_emitter.hpp"
+#include "components/alloc_stats.hpp"
+#include "components/logger.hpp"
+#include "components/renderer_interface.hpp"
+#include "components/tracer.hpp"
 #include "settings.hpp"
 #include "tags/parser.hpp"
 #include "utils/color.hpp"
@@ -11,8 +13,6 @@
 
 POLYBAR_NS
 
-using namespace signals::parser;
-
 namespace tags {
   static rgba get_color(tags::color_value c, rgba fallback) {
     if (c.type == tags::color_type::RESET) {
@@ -26,28 +26,61 @@ namespace tags {
    * Create instance
    */
   dispatch::make_type dispatch::make() {
-    return factory_util::unique<dispatch>(signal_emitter::make(), logger::make());
+    return factory_util::unique<dispatch>(logger::make());
   }
 
   /**
    * Construct parser instance
    */
-  dispatch::dispatch(signal_emitter& emitter, const logger& logger) : m_sig(emitter), m_log(logger) {}
+  dispatch::dispatch(const logger& logger) : m_log(logger) {}
 
   /**
-   * Process input string
+   * Parse the given formatting string into its elements
    */
-  void dispatch::parse(const bar_settings& bar, string data) {
+  format_string tokenize(const logger& log, const string& data) {
+    static const alloc_tag parser_tag{alloc_stats::tag("parser")};
+    scoped_alloc_tag tag{parser_tag};
+    POLYBAR_TRACE("tags.tokenize");
+
     tags::parser p;
-    p.set(std::move(data));
+    p.set_borrowed(data);
+
+    format_string elements;
 
     while (p.has_next_element()) {
-      tags::element el;
       try {
-        el = p.next_element();
+        elements.emplace_back(p.next_element());
       } catch (const tags::error& e) {
-        m_log.err("Parser error (reason: %s)", e.what());
-        continue;
+        log.err("Parser error (reason: %s)", e.what());
+      }
+    }
+
+    return elements;
+  }
+
+  /**
+   * Process input string
+   */
+  void dispatch::parse(const bar_settings& bar, renderer_interface& renderer, string data) {
+    parse(bar, renderer, tokenize(m_log, data));
+  }
+
+  /**
+   * Process parsed input
+   */
+  void dispatch::parse(const bar_settings& bar, renderer_interface& renderer, const format_string& elements,
+      const block_filter& skip_block) {
+    m_actions.clear();
+
+    for (auto it = elements.begin(); it != elements.end(); ++it) {
+      const auto& el = *it;
+
+      if (skip_block && is_alignment(el)) {
+        auto next = std::find_if(std::next(it), elements.end(), is_alignment);
+        if (skip_block(it, next)) {
+          it = std::prev(next);
+          continue;
+        }
       }
 
       if (el.is_tag) {
@@ -55,40 +88,43 @@ namespace tags {
           case tags::tag_type::FORMAT:
             switch (el.tag_data.subtype.format) {
               case tags::syntaxtag::A:
-                handle_action(el.tag_data.action.btn, el.tag_data.action.closing, std::move(el.data));
+                handle_action(renderer, el.tag_data.action.btn, el.tag_data.action.closing, el.data);
                 break;
               case tags::syntaxtag::B:
-                m_sig.emit(change_background{get_color(el.tag_data.color, bar.background)});
+                renderer.change_background(get_color(el.tag_data.color, bar.background));
                 break;
               case tags::syntaxtag::F:
-                m_sig.emit(change_foreground{get_color(el.tag_data.color, bar.foreground)});
+                renderer.change_foreground(get_color(el.tag_data.color, bar.foreground));
                 break;
               case tags::syntaxtag::T:
-                m_sig.emit(change_font{el.tag_data.font});
+                renderer.change_font(el.tag_data.font);
                 break;
               case tags::syntaxtag::O:
-                m_sig.emit(offset_pixel{el.tag_data.offset});
+                renderer.offset_pixel(el.tag_data.offset);
                 break;
               case tags::syntaxtag::R:
-                m_sig.emit(reverse_colors{});
+                renderer.reverse_colors();
                 break;
               case tags::syntaxtag::o:
-                m_sig.emit(change_overline{get_color(el.tag_data.color, bar.overline.color)});
+                renderer.change_overline(get_color(el.tag_data.color, bar.overline.color));
                 break;
               case tags::syntaxtag::u:
-                m_sig.emit(change_underline{get_color(el.tag_data.color, bar.underline.color)});
+                renderer.change_underline(get_color(el.tag_data.color, bar.underline.color));
                 break;
               case tags::syntaxtag::P:
-                m_sig.emit(control{el.tag_data.ctrl});
+                control(renderer, el.tag_data.ctrl, el.data);
                 break;
               case tags::syntaxtag::l:
-                m_sig.emit(change_alignment{alignment::LEFT});
+                renderer.change_alignment(alignment::LEFT);
                 break;
               case tags::syntaxtag::r:
-                m_sig.emit(change_alignment{alignment::RIGHT});
+                renderer.change_alignment(alignment::RIGHT);
                 break;
               case tags::syntaxtag::c:
-                m_sig.emit(change_alignment{alignment::CENTER});
+                renderer.change_alignment(alignment::CENTER);
+                break;
+              case tags::syntaxtag::G:
+                graph(renderer, el.tag_data.graph, el.data);
                 break;
               default:
                 throw runtime_error(
@@ -99,13 +135,13 @@ namespace tags {
             tags::attribute act = el.tag_data.attr;
             switch (el.tag_data.subtype.activation) {
               case tags::attr_activation::ON:
-                m_sig.emit(attribute_set{act});
+                renderer.attribute_set(act);
                 break;
               case tags::attr_activation::OFF:
-                m_sig.emit(attribute_unset{act});
+                renderer.attribute_unset(act);
                 break;
               case tags::attr_activation::TOGGLE:
-                m_sig.emit(attribute_toggle{act});
+                renderer.attribute_toggle(act);
                 break;
               default:
                 throw runtime_error("Unrecognized attribute activation: " +
@@ -114,7 +150,7 @@ namespace tags {
             break;
         }
       } else {
-        text(std::move(el.data));
+        text(renderer, el.data);
       }
     }
 
@@ -126,18 +162,54 @@ namespace tags {
   /**
    * Process text contents
    */
-  void dispatch::text(string&& data) {
+  void dispatch::text(renderer_interface& renderer, const string& data) {
 #ifdef DEBUG_WHITESPACE
+    string text{data};
     string::size_type p;
-    while ((p = data.find(' ')) != string::npos) {
-      data.replace(p, 1, "-"s);
+    while ((p = text.find(' ')) != string::npos) {
+      text.replace(p, 1, "-"s);
     }
+    renderer.render_text(text);
+#else
+    renderer.render_text(data);
 #endif
+  }
+
+  /**
+   * Process graph contents
+   *
+   * The values were validated by the parser, they are passed on as fractions.
+   */
+  void dispatch::graph(renderer_interface& renderer, const graph_value& graph, const string& values) {
+    m_graph_values.clear();
+
+    const char* p = values.c_str();
+    while (*p != '\0') {
+      char* end;
+      m_graph_values.push_back(strtol(p, &end, 10) / 100.0);
+      p = *end == ',' ? end + 1 : end;
+    }
+
+    renderer.draw_graph(graph.type, graph.width, m_graph_values);
+  }
+
+  /**
+   * Process control tags, the width of W and F tags was validated by the parser
+   */
+  void dispatch::control(renderer_interface& renderer, controltag ctrl, const string& data) {
+    if (ctrl != controltag::W && ctrl != controltag::F) {
+      renderer.control(ctrl);
+      return;
+    }
 
-    m_sig.emit(signals::parser::text{std::move(data)});
+    reserved_width width{};
+    width.width = strtol(data.c_str(), nullptr, 10);
+    width.chars = !data.empty() && data.back() == 'c';
+    width.fixed = ctrl == controltag::F;
+    renderer.reserve_width(width);
   }
 
-  void dispatch::handle_action(mousebtn btn, bool closing, const string&& cmd) {
+  void dispatch::handle_action(renderer_interface& renderer, mousebtn btn, bool closing, const string& cmd) {
     if (closing) {
       if (btn == mousebtn::NONE) {
         if (!m_actions.empty()) {
@@ -160,10 +232,10 @@ namespace tags {
           m_actions.erase(std::next(it).base());
         }
       }
-      m_sig.emit(action_end{btn});
+      renderer.action_end(btn);
     } else {
       m_actions.push_back(btn);
-      m_sig.emit(action_begin{action{btn, std::move(cmd)}});
+      renderer.action_begin(btn, cmd);
     }
   }
 }  // namespace tags
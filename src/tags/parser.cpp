@@ -1,7 +1,7 @@
 #include "tags/parser.hpp"
 
-#include <cassert>
 #include <cctype>
+#include <cstring>
 
 POLYBAR_NS
 
@@ -21,10 +21,10 @@ namespace tags {
     }
 
     if (buf_pos >= buf.size()) {
-      throw std::runtime_error("tag parser: No next element. THIS IS A BUG. (Context: '" + input + "')");
+      throw std::runtime_error("tag parser: No next element. THIS IS A BUG. (Context: '" + slice(0, size) + "')");
     }
 
-    element e = buf[buf_pos];
+    element e = std::move(buf[buf_pos]);
     buf_pos++;
 
     if (buf_pos == buf.size()) {
@@ -50,56 +50,81 @@ namespace tags {
    *
    * This means it will parse text until the next tag is reached or it will
    * parse an entire %{...} tag.
+   *
+   * Text is added as a single element, the end of it is found with memchr
+   * instead of looking at every character.
    */
   void parser::parse_step() {
-    char c;
-
-    /*
-     * If we have already parsed text, we can stop if we reach a tag.
-     */
-    bool text_parsed = false;
-
     size_t start_pos = pos;
 
     try {
-      while ((c = next())) {
-        // TODO here we could think about how to escape an action tag
-        if (c == '%' && has_next() && peek() == '{') {
-          /*
-           * If we have already parsed text, encountering a tag opening means
-           * we can stop parsing now because we parsed at least one entire
-           * element (the text up to the beginning of the tag).
-           */
-          if (text_parsed) {
-            // Put back the '%'
-            revert();
-            break;
-          }
+      // TODO here we could think about how to escape an action tag
+      size_t end = find_tag(pos);
 
-          consume('{');
-          consume_space();
-          parse_tag();
-          break;
-        } else {
-          push_char(c);
-          text_parsed = true;
-        }
+      const void* null = memchr(input + pos, EOL, end - pos);
+      if (null != nullptr) {
+        end = static_cast<const char*>(null) - input;
+      }
+
+      if (end > pos) {
+        push_text(pos, end - pos);
+        pos = end;
+      }
+
+      if (pos < size && input[pos] == EOL) {
+        // Null characters end the text and are dropped
+        pos++;
+      } else if (end == start_pos && has_next()) {
+        consume('%');
+        consume('{');
+        consume_space();
+        parse_tag();
       }
     } catch (error& e) {
-      e.set_context(input.substr(start_pos, pos - start_pos));
+      e.set_context(slice(start_pos, pos));
       throw;
     }
   }
 
-  void parser::set(const string&& input) {
-    this->input = std::move(input);
+  void parser::set(string&& input) {
+    owned = std::move(input);
+    set_borrowed(owned);
+  }
+
+  void parser::set(const string& input) {
+    owned = input;
+    set_borrowed(owned);
+  }
+
+  void parser::set_borrowed(const string& input) {
+    this->input = input.data();
+    size = input.size();
     pos = 0;
     buf.clear();
     buf_pos = 0;
   }
 
+  /**
+   * Position of the next "%{" at or after `from`, the end of the input if there is none
+   *
+   * Any '%' not followed by '{' is plain text.
+   */
+  size_t parser::find_tag(size_t from) const {
+    const char* end = input + size;
+    const char* p = input + from;
+
+    while ((p = static_cast<const char*>(memchr(p, '%', end - p))) != nullptr) {
+      if (p + 1 < end && p[1] == '{') {
+        return p - input;
+      }
+      p++;
+    }
+
+    return size;
+  }
+
   bool parser::has_next() const {
-    return pos < input.size();
+    return pos < size;
   }
 
   char parser::next() {
@@ -116,14 +141,6 @@ namespace tags {
     return input[pos];
   }
 
-  /**
-   * Puts back a single character in the input string.
-   */
-  void parser::revert() {
-    assert(pos > 0);
-    pos--;
-  }
-
   void parser::consume(char c) {
     char n = next();
     if (n != c) {
@@ -219,6 +236,7 @@ namespace tags {
       case 'l': sub.format = syntaxtag::l; break;
       case 'c': sub.format = syntaxtag::c; break;
       case 'r': sub.format = syntaxtag::r; break;
+      case 'G': sub.format = syntaxtag::G; break;
 
       case '+': sub.activation = attr_activation::ON; break;
       case '-': sub.activation = attr_activation::OFF; break;
@@ -243,6 +261,7 @@ namespace tags {
       case 'l':
       case 'c':
       case 'r':
+      case 'G':
         type = tag_type::FORMAT;
         break;
 
@@ -277,11 +296,14 @@ namespace tags {
         tag_data.offset = parse_offset();
         break;
       case 'P':
-        tag_data.ctrl = parse_control();
+        std::tie(tag_data.ctrl, e.data) = parse_control();
         break;
       case 'A':
         std::tie(tag_data.action, e.data) = parse_action();
         break;
+      case 'G':
+        std::tie(tag_data.graph, e.data) = parse_graph();
+        break;
 
       case '+':
       case '-':
@@ -295,17 +317,20 @@ namespace tags {
   }
 
   color_value parser::parse_color() {
-    string s = get_tag_value();
+    size_t start = pos;
+    skip_tag_value();
+    size_t len = pos - start;
 
     color_value ret;
 
-    if (s.empty() || s == "-") {
+    if (len == 0 || (len == 1 && input[start] == '-')) {
       ret.type = color_type::RESET;
     } else {
-      rgba c{s};
+      // Decoded in place, colors are by far the most common tag values
+      rgba c{input + start, len};
 
       if (!c.has_color()) {
-        throw color_error(s);
+        throw color_error(slice(start, pos));
       }
 
       ret.type = color_type::COLOR;
@@ -362,7 +387,12 @@ namespace tags {
     return 0;
   }
 
-  controltag parser::parse_control() {
+  /**
+   * Parses the contents of a control tag: %{P<tag>[<width>[c]]}
+   *
+   * Returns the tag and the width of W and F tags as it appears in the tag.
+   */
+  std::pair<controltag, string> parser::parse_control() {
     string s = get_tag_value();
 
     if (s.empty()) {
@@ -375,7 +405,24 @@ namespace tags {
           throw control_error(s, "Control tag R has extra data");
         }
 
-        return controltag::R;
+        return {controltag::R, ""};
+      case 'W':
+      case 'F': {
+        size_t end = s.back() == 'c' ? s.size() - 1 : s.size();
+        int width = 0;
+        for (size_t i = 1; i < end; i++) {
+          if (!isdigit(s[i]) || width > 10000) {
+            throw control_error(s, "Reserved width is not a number");
+          }
+          width = width * 10 + (s[i] - '0');
+        }
+
+        if (width == 0) {
+          throw control_error(s, "Reserved width is zero");
+        }
+
+        return {s[0] == 'W' ? controltag::W : controltag::F, s.substr(1)};
+      }
       default:
         throw control_error(s);
     }
@@ -435,25 +482,25 @@ namespace tags {
 
     string s;
 
-    char prev = EOL;
+    // Start of the part of the command that wasn't added to s yet
+    size_t start = pos;
 
     while (has_next()) {
       char c = next();
 
       if (c == ':') {
-        if (prev == '\\') {
-          s.pop_back();
+        if (pos - 1 > start && input[pos - 2] == '\\') {
+          s.append(input + start, pos - 2 - start);
           s.push_back(c);
+          start = pos;
         } else {
-          break;
+          s.append(input + start, pos - 1 - start);
+          return s;
         }
-      } else {
-        s.push_back(c);
       }
-
-      prev = c;
     }
 
+    s.append(input + start, pos - start);
     return s;
   }
 
@@ -469,26 +516,105 @@ namespace tags {
     }
   }
 
-  void parser::push_char(char c) {
-    if (!buf.empty() && buf_pos < buf.size() && !buf.back().is_tag) {
-      buf.back().data += c;
-    } else {
-      buf.emplace_back(string{c});
+  /**
+   * Parses the contents of a graph tag: %{G<type><width>:<values>}
+   *
+   * The type is either 'b' (bar) or 's' (sparkline), the values are comma
+   * separated percentages. A bar uses only a single value.
+   *
+   * Returns the graph and the values as they appear in the tag.
+   */
+  std::pair<graph_value, string> parser::parse_graph() {
+    string s = get_tag_value();
+
+    graph_value ret{};
+
+    if (s.empty()) {
+      throw graph_error(s, "Graph tag is empty");
+    }
+
+    switch (s[0]) {
+      case 'b':
+        ret.type = graph_type::BAR;
+        break;
+      case 's':
+        ret.type = graph_type::SPARKLINE;
+        break;
+      default:
+        throw graph_error(s, "Unknown graph type");
+    }
+
+    size_t colon = s.find(':');
+    if (colon == string::npos) {
+      throw graph_error(s, "Graph has no values");
+    }
+
+    ret.width = 0;
+    for (size_t i = 1; i < colon; i++) {
+      if (!isdigit(s[i]) || ret.width > 10000) {
+        throw graph_error(s, "Graph width is not a number");
+      }
+      ret.width = ret.width * 10 + (s[i] - '0');
+    }
+
+    if (ret.width == 0) {
+      throw graph_error(s, "Graph width is zero");
     }
+
+    string values = s.substr(colon + 1);
+    int value = -1;
+    size_t count = 0;
+
+    for (char c : values) {
+      if (c == ',') {
+        if (value == -1) {
+          throw graph_error(s, "Empty graph value");
+        }
+        value = -1;
+        count++;
+      } else if (isdigit(c)) {
+        value = (value == -1 ? 0 : value * 10) + (c - '0');
+        if (value > 100) {
+          throw graph_error(s, "Graph value is not a percentage");
+        }
+      } else {
+        throw graph_error(s, "Graph value is not a number");
+      }
+    }
+
+    if (value == -1) {
+      throw graph_error(s, "Empty graph value");
+    }
+
+    if (ret.type == graph_type::BAR && count != 0) {
+      throw graph_error(s, "Bar graph has more than one value");
+    }
+
+    return {ret, values};
   }
 
-  void parser::push_text(string&& text) {
-    if (text.empty()) {
+  /**
+   * Add input[start, start + length) as text
+   */
+  void parser::push_text(size_t start, size_t length) {
+    if (length == 0) {
       return;
     }
 
     if (!buf.empty() && buf_pos < buf.size() && !buf.back().is_tag) {
-      buf.back().data += text;
+      buf.back().data.append(input + start, length);
     } else {
-      buf.emplace_back(std::move(text));
+      buf.emplace_back(string(input + start, length));
     }
   }
 
+  /**
+   * Copy of input[start, end)
+   */
+  string parser::slice(size_t start, size_t end) const {
+    return string(input + start, end - start);
+  }
+
   /**
    * Will read up until the end of the tag value.
    *
@@ -500,13 +626,18 @@ namespace tags {
    * characters (e.g. action tags).
    */
   string parser::get_tag_value() {
-    string s;
+    size_t start = pos;
+    skip_tag_value();
+    return slice(start, pos);
+  }
 
+  /**
+   * Same as get_tag_value(), but without copying the value
+   */
+  void parser::skip_tag_value() {
     while (has_next() && peek() != ' ' && peek() != '}') {
-      s.push_back(next());
+      next();
     }
-
-    return s;
   }
 }  // namespace tags
 
@@ -0,0 +1,219 @@
+#include "tags/types.hpp"
+
+#include <cstring>
+
+POLYBAR_NS
+
+namespace tags {
+  bool operator==(const color_value& a, const color_value& b) {
+    return a.type == b.type && (a.type == color_type::RESET || a.val == b.val);
+  }
+
+  /**
+   * Compares only the union member that is in use for the tag
+   */
+  bool operator==(const tag& a, const tag& b) {
+    if (a.type != b.type) {
+      return false;
+    }
+
+    if (a.type == tag_type::ATTR) {
+      return a.subtype.activation == b.subtype.activation && a.attr == b.attr;
+    }
+
+    if (a.subtype.format != b.subtype.format) {
+      return false;
+    }
+
+    switch (a.subtype.format) {
+      case syntaxtag::A:
+        return a.action.btn == b.action.btn && a.action.closing == b.action.closing;
+      case syntaxtag::B:
+      case syntaxtag::F:
+      case syntaxtag::o:
+      case syntaxtag::u:
+        return a.color == b.color;
+      case syntaxtag::T:
+        return a.font == b.font;
+      case syntaxtag::O:
+        return a.offset == b.offset;
+      case syntaxtag::P:
+        return a.ctrl == b.ctrl;
+      case syntaxtag::G:
+        return a.graph.type == b.graph.type && a.graph.width == b.graph.width;
+      default:
+        return true;
+    }
+  }
+
+  bool operator==(const element& a, const element& b) {
+    return a.is_tag == b.is_tag && a.data == b.data && (!a.is_tag || a.tag_data == b.tag_data);
+  }
+
+  bool operator!=(const element& a, const element& b) {
+    return !(a == b);
+  }
+
+  /**
+   * Check if the element is one of the %{l}, %{c} or %{r} tags
+   */
+  bool is_alignment(const element& el) {
+    if (!el.is_tag || el.tag_data.type != tag_type::FORMAT) {
+      return false;
+    }
+
+    auto format = el.tag_data.subtype.format;
+    return format == syntaxtag::l || format == syntaxtag::c || format == syntaxtag::r;
+  }
+
+  /**
+   * Alignment set by an alignment tag, NONE for all other elements
+   */
+  alignment get_alignment(const element& el) {
+    if (!is_alignment(el)) {
+      return alignment::NONE;
+    }
+
+    switch (el.tag_data.subtype.format) {
+      case syntaxtag::l:
+        return alignment::LEFT;
+      case syntaxtag::c:
+        return alignment::CENTER;
+      default:
+        return alignment::RIGHT;
+    }
+  }
+
+  namespace {
+    /**
+     * Check if `next` undoes everything `el` does, in which case `el` can be dropped
+     *
+     * This is the case for two color or font tags of the same kind (e.g.
+     * `%{F-}%{F#...}`), attribute activations that are followed by an explicit
+     * activation of the same attribute and everything the reset tag `%{PR}`
+     * resets.
+     */
+    bool overridden(const element& el, const element& next) {
+      if (!el.is_tag || !next.is_tag) {
+        return false;
+      }
+
+      const auto& a = el.tag_data;
+      const auto& b = next.tag_data;
+
+      if (b.type == tag_type::FORMAT && b.subtype.format == syntaxtag::P && b.ctrl == controltag::R) {
+        if (a.type == tag_type::ATTR) {
+          return true;
+        }
+
+        switch (a.subtype.format) {
+          case syntaxtag::B:
+          case syntaxtag::F:
+          case syntaxtag::o:
+          case syntaxtag::u:
+          case syntaxtag::T:
+          case syntaxtag::R:
+            return true;
+          case syntaxtag::P:
+            return a.ctrl == controltag::R;
+          default:
+            return false;
+        }
+      }
+
+      if (a.type != b.type) {
+        return false;
+      }
+
+      if (a.type == tag_type::ATTR) {
+        return a.attr == b.attr && b.subtype.activation != attr_activation::TOGGLE;
+      }
+
+      if (a.subtype.format != b.subtype.format) {
+        return false;
+      }
+
+      switch (a.subtype.format) {
+        case syntaxtag::B:
+        case syntaxtag::F:
+        case syntaxtag::o:
+        case syntaxtag::u:
+        case syntaxtag::T:
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    /**
+     * Tags whose reset is dropped if it is followed by a new value
+     */
+    constexpr const char* RESETTABLE{"TBFUuo"};
+  }  // namespace
+
+  /**
+   * Append a single element
+   *
+   * Works like a peephole optimizer: adjacent text is joined into a single
+   * element and tags that the new element undoes right away are dropped. The
+   * result is drawn exactly like the unoptimized elements.
+   */
+  void append(format_string& dst, element el) {
+    if (!dst.empty() && !dst.back().is_tag && !el.is_tag) {
+      dst.back().data += el.data;
+      return;
+    }
+
+    // Dropping a tag can never make two text elements adjacent, the new element is a tag
+    while (!dst.empty() && overridden(dst.back(), el)) {
+      dst.pop_back();
+    }
+
+    dst.emplace_back(move(el));
+  }
+
+  void append(format_string& dst, const format_string& src) {
+    for (const auto& el : src) {
+      append(dst, el);
+    }
+  }
+
+  /**
+   * Strip resets that are followed by a new value and join consecutive tags
+   *
+   * `%{F-}%{F#f00}` becomes `%{F#f00}` and `%{F#f00}%{B#000}` becomes
+   * `%{F#f00 B#000}`. Done in a single pass over the formatting string.
+   */
+  string compact(const string& contents) {
+    string result;
+    result.reserve(contents.size());
+
+    size_t i = 0;
+    while (i < contents.size()) {
+      if (contents.compare(i, 3, "}%{") != 0) {
+        result += contents[i++];
+        continue;
+      }
+
+      size_t len = result.size();
+      // The reset has to be a tag of its own, e.g. `%{T-` or ` T-` of joined tags
+      bool reset = len >= 3 && result[len - 1] == '-' && strchr(RESETTABLE, result[len - 2]) != nullptr &&
+                   (result[len - 3] == '{' || result[len - 3] == ' ');
+      char tag = reset ? result[len - 2] : '\0';
+
+      if (reset && i + 3 < contents.size() && contents[i + 3] == tag &&
+          (tag == 'T' || (i + 4 < contents.size() && contents[i + 4] == '#'))) {
+        // Continue with the value of the new tag
+        result.pop_back();
+        i += 4;
+      } else {
+        result += ' ';
+        i += 3;
+      }
+    }
+
+    return result;
+  }
+}  // namespace tags
+
+POLYBAR_NS_END
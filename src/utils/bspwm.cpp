@@ -1,8 +1,13 @@
 #include <sys/un.h>
 
+#include <cstring>
+
+#include "components/logger.hpp"
+#include "components/reactor.hpp"
 #include "errors.hpp"
 #include "utils/bspwm.hpp"
 #include "utils/env.hpp"
+#include "utils/factory.hpp"
 #include "x11/connection.hpp"
 
 POLYBAR_NS
@@ -54,7 +59,7 @@ namespace bspwm_util {
       const unsigned int value_list[2]{root, XCB_STACK_MODE_ABOVE};
 
       conn.configure_window_checked(win, value_mask, value_list);
-      conn.flush();
+      conn.request_flush();
 
       return true;
     }
@@ -146,6 +151,110 @@ namespace bspwm_util {
     }
     return conn;
   }
+
+  /**
+   * Create instance
+   */
+  hub::make_type hub::make() {
+    return static_cast<hub&>(*factory_util::singleton<hub>());
+  }
+
+  /**
+   * Subscribe to the reports
+   *
+   * bspwm sends the current report right away, it is published once read.
+   */
+  hub::model hub::connect() {
+    std::lock_guard<std::mutex> guard(m_subscriber_lock);
+    m_subscriber = make_subscriber();
+    m_partial.clear();
+    m_report.reset();
+    watch();
+    return nullptr;
+  }
+
+  void hub::disconnect() {
+    std::lock_guard<std::mutex> guard(m_subscriber_lock);
+    if (m_fd != -1) {
+      reactor::make().remove(m_fd);
+      m_fd = -1;
+    }
+    if (m_subscriber) {
+      logger::make().info("bspwm: Disconnecting from socket");
+      m_subscriber->disconnect();
+      m_subscriber.reset();
+    }
+  }
+
+  void hub::watch() {
+    m_fd = m_subscriber->get_file_descriptor();
+    reactor::make().add(m_fd, EPOLLIN, [this](int, unsigned int) { on_event(); });
+  }
+
+  /**
+   * Read what was sent and publish the last complete report if it changed
+   */
+  void hub::on_event() {
+    shared_ptr<const string> changed;
+    {
+      std::lock_guard<std::mutex> guard(m_subscriber_lock);
+      if (!m_subscriber) {
+        return;
+      }
+
+      const logger& log{logger::make()};
+      ssize_t bytes{0};
+      string data;
+
+      if (!m_subscriber->poll(POLLHUP, 0)) {
+        try {
+          data = m_subscriber->receive(BUFSIZ - 1, &bytes);
+        } catch (const system_error& err) {
+          log.err("bspwm: %s", err.what());
+        }
+      }
+
+      if (bytes <= 0) {
+        log.notice("bspwm: Reconnecting to socket...");
+        reactor::make().remove(m_fd);
+        m_fd = -1;
+        m_partial.clear();
+        try {
+          m_subscriber = make_subscriber();
+          watch();
+        } catch (const exception& err) {
+          log.err("bspwm: Failed to reconnect socket, workspaces are no longer updated (reason: %s)", err.what());
+          m_subscriber.reset();
+        }
+        return;
+      }
+
+      m_partial += data;
+      auto end = m_partial.rfind('\n');
+      if (end == string::npos) {
+        return;
+      }
+
+      string report;
+      for (auto&& line : string_util::split(m_partial.substr(0, end), '\n')) {
+        if (line.compare(0, strlen(BSPWM_STATUS_PREFIX), BSPWM_STATUS_PREFIX) == 0) {
+          report = move(line);
+        } else if (!line.empty()) {
+          log.err("bspwm: Unknown status '%s'", line);
+        }
+      }
+      m_partial.erase(0, end + 1);
+
+      if (!report.empty() && (!m_report || *m_report != report)) {
+        m_report = make_shared<const string>(move(report));
+        changed = m_report;
+      }
+    }
+
+    if (changed) {
+      publish(move(changed));
+    }
+  }
 }
 
 POLYBAR_NS_END
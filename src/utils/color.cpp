@@ -1,11 +1,34 @@
 #include "utils/color.hpp"
 
-#include <algorithm>
+#include <cctype>
+#include <cstdio>
 
 POLYBAR_NS
 
+namespace {
+  /**
+   * Value of a single hex digit, -1 for any other character
+   */
+  int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+    }
+    return -1;
+  }
+}  // namespace
+
+rgba::rgba() : m_value(0), m_type(type::NONE) {}
+rgba::rgba(uint32_t value, enum type type) : m_value(value), m_type(type) {}
+rgba::rgba(string hex) : rgba(hex.data(), hex.size()) {}
+
 /**
- * Takes a hex string as input and brings it into a normalized form
+ * Decodes a hex color without allocating
  *
  * The input can either be only an alpha channel #AA
  * or any of these forms: #RGB, #ARGB, #RRGGBB, #AARRGGBB
@@ -13,66 +36,56 @@ POLYBAR_NS
  * Colors without alpha channel will get an alpha channel of FF
  * The input does not have to start with '#'
  *
- * \returns Empty string for malformed input, either AA for the alpha only
- * input or an 8 character string of the expanded form AARRGGBB
+ * Malformed input results in a color of type NONE
  */
-static string normalize_hex(string hex) {
-  if (hex.length() == 0) {
-    return "";
-  }
-
-  // We remove the hash because it makes processing easier
-  if (hex[0] == '#') {
-    hex.erase(0, 1);
-  }
-
-  // Check that only valid characters are used
-  if (!std::all_of(hex.cbegin(), hex.cend(), isxdigit)) {
-    return "";
+rgba::rgba(const char* hex, size_t len) : m_value(0), m_type(type::NONE) {
+  if (len > 0 && hex[0] == '#') {
+    hex++;
+    len--;
   }
 
-  if (hex.length() == 2) {
-    // We only have an alpha channel
-    return hex;
+  if (len > 8) {
+    return;
   }
 
-  if (hex.length() == 3) {
-    // RGB -> FRGB
-    hex.insert(0, 1, 'f');
-  }
-
-  if (hex.length() == 4) {
-    // ARGB -> AARRGGBB
-    hex = {hex[0], hex[0], hex[1], hex[1], hex[2], hex[2], hex[3], hex[3]};
-  }
-
-  if (hex.length() == 6) {
-    // RRGGBB -> FFRRGGBB
-    hex.insert(0, 2, 'f');
+  uint32_t value{0};
+  for (size_t i = 0; i < len; i++) {
+    int digit = hex_value(hex[i]);
+    if (digit < 0) {
+      return;
+    }
+    value = (value << 4) | static_cast<uint32_t>(digit);
   }
 
-  if (hex.length() != 8) {
-    return "";
+  switch (len) {
+    case 2:
+      m_value = value << 24;
+      m_type = type::ALPHA_ONLY;
+      return;
+    case 3:
+      // RGB -> FRGB
+      value |= 0xF000;
+      // fallthrough
+    case 4:
+      // ARGB -> AARRGGBB
+      m_value = 0;
+      for (int shift = 12; shift >= 0; shift -= 4) {
+        uint32_t digit = (value >> shift) & 0xF;
+        m_value = (m_value << 8) | (digit << 4) | digit;
+      }
+      break;
+    case 6:
+      // RRGGBB -> FFRRGGBB
+      m_value = 0xFF000000 | value;
+      break;
+    case 8:
+      m_value = value;
+      break;
+    default:
+      return;
   }
 
-  return hex;
-}
-
-rgba::rgba() : m_value(0), m_type(type::NONE) {}
-rgba::rgba(uint32_t value, enum type type) : m_value(value), m_type(type) {}
-rgba::rgba(string hex) {
-  hex = normalize_hex(hex);
-
-  if (hex.length() == 0) {
-    m_value = 0;
-    m_type = type::NONE;
-  } else if (hex.length() == 2) {
-    m_value = std::strtoul(hex.c_str(), nullptr, 16) << 24;
-    m_type = type::ALPHA_ONLY;
-  } else {
-    m_value = std::strtoul(hex.c_str(), nullptr, 16);
-    m_type = type::ARGB;
-  }
+  m_type = type::ARGB;
 }
 
 rgba::operator string() const {
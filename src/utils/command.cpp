@@ -1,5 +1,6 @@
 #include "utils/command.hpp"
 
+#include <fcntl.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -33,7 +34,7 @@ command<output_policy::IGNORED>::~command() {
  * Execute the command
  */
 int command<output_policy::IGNORED>::exec(bool wait_for_completion) {
-  m_forkpid = process_util::spawn_async([m_cmd = m_cmd] { process_util::exec_sh(m_cmd.c_str()); });
+  m_forkpid = process_util::spawn_sh(m_cmd);
   if (wait_for_completion) {
     auto status = wait();
     m_forkpid = -1;
@@ -102,12 +103,14 @@ int command<output_policy::IGNORED>::get_exit_status() {
 
 command<output_policy::REDIRECTED>::command(const polybar::logger& logger, std::string cmd)
     : command<output_policy::IGNORED>(logger, move(cmd)) {
-  if (pipe(m_stdin) != 0) {
+  // Close-on-exec, the child only gets them as its standard streams
+  if (pipe2(m_stdin, O_CLOEXEC) != 0) {
     throw command_error("Failed to allocate input stream");
   }
-  if (pipe(m_stdout) != 0) {
+  if (pipe2(m_stdout, O_CLOEXEC) != 0) {
     throw command_error("Failed to allocate output stream");
   }
+  m_reader = make_unique<line_reader>(m_stdout[PIPE_READ]);
 }
 
 command<output_policy::REDIRECTED>::~command() {
@@ -129,51 +132,20 @@ command<output_policy::REDIRECTED>::~command() {
  * Execute the command
  */
 int command<output_policy::REDIRECTED>::exec(bool wait_for_completion) {
-  if ((m_forkpid = fork()) == -1) {
-    throw system_error("Failed to fork process");
-  }
+  m_forkpid = process_util::spawn_sh(m_cmd, m_stdin[PIPE_READ], m_stdout[PIPE_WRITE], m_stdout[PIPE_WRITE], false);
 
-  if (process_util::in_forked_process(m_forkpid)) {
-    if (dup2(m_stdin[PIPE_READ], STDIN_FILENO) == -1) {
-      throw command_error("Failed to redirect stdin in child process");
-    }
-    if (dup2(m_stdout[PIPE_WRITE], STDOUT_FILENO) == -1) {
-      throw command_error("Failed to redirect stdout in child process");
-    }
-    if (dup2(m_stdout[PIPE_WRITE], STDERR_FILENO) == -1) {
-      throw command_error("Failed to redirect stderr in child process");
-    }
-
-    // Close file descriptors that won't be used by the child
-    if ((m_stdin[PIPE_READ] = close(m_stdin[PIPE_READ])) == -1) {
-      throw command_error("Failed to close fd");
-    }
-    if ((m_stdin[PIPE_WRITE] = close(m_stdin[PIPE_WRITE])) == -1) {
-      throw command_error("Failed to close fd");
-    }
-    if ((m_stdout[PIPE_READ] = close(m_stdout[PIPE_READ])) == -1) {
-      throw command_error("Failed to close fd");
-    }
-    if ((m_stdout[PIPE_WRITE] = close(m_stdout[PIPE_WRITE])) == -1) {
-      throw command_error("Failed to close fd");
-    }
-
-    setpgid(m_forkpid, 0);
-    process_util::exec_sh(m_cmd.c_str());
-  } else {
-    // Close file descriptors that won't be used by the parent
-    if ((m_stdin[PIPE_READ] = close(m_stdin[PIPE_READ])) == -1) {
-      throw command_error("Failed to close fd");
-    }
-    if ((m_stdout[PIPE_WRITE] = close(m_stdout[PIPE_WRITE])) == -1) {
-      throw command_error("Failed to close fd");
-    }
+  // Close file descriptors that won't be used by the parent
+  if ((m_stdin[PIPE_READ] = close(m_stdin[PIPE_READ])) == -1) {
+    throw command_error("Failed to close fd");
+  }
+  if ((m_stdout[PIPE_WRITE] = close(m_stdout[PIPE_WRITE])) == -1) {
+    throw command_error("Failed to close fd");
+  }
 
-    if (wait_for_completion) {
-      auto status = wait();
-      m_forkpid = -1;
-      return status;
-    }
+  if (wait_for_completion) {
+    auto status = wait();
+    m_forkpid = -1;
+    return status;
   }
 
   return EXIT_SUCCESS;
@@ -186,7 +158,10 @@ int command<output_policy::REDIRECTED>::exec(bool wait_for_completion) {
  * end until the stream is closed
  */
 void command<output_policy::REDIRECTED>::tail(callback<string> cb) {
-  io_util::tail(m_stdout[PIPE_READ], cb);
+  string line;
+  while (m_reader->readline(line)) {
+    cb(move(line));
+  }
 }
 
 /**
@@ -202,7 +177,19 @@ int command<output_policy::REDIRECTED>::writeline(string data) {
  */
 string command<output_policy::REDIRECTED>::readline() {
   std::lock_guard<std::mutex> lck(m_pipelock);
-  return io_util::readline(m_stdout[PIPE_READ]);
+  string line;
+  m_reader->readline(line);
+  return line;
+}
+
+/**
+ * Pass the lines that the command wrote so far to the callback, without blocking
+ *
+ * \returns false once the output stream is closed
+ */
+bool command<output_policy::REDIRECTED>::drain_lines(callback<string> cb) {
+  std::lock_guard<std::mutex> lck(m_pipelock);
+  return m_reader->drain_lines([&](string&& line) { cb(move(line)); });
 }
 
 /**
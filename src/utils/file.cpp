@@ -4,6 +4,7 @@
 #include <fcntl.h>
 #include <glob.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <cstdio>
 #include <cstdlib>
@@ -13,6 +14,7 @@
 #include "errors.hpp"
 #include "utils/env.hpp"
 #include "utils/string.hpp"
+#include "utils/uring.hpp"
 
 POLYBAR_NS
 
@@ -104,6 +106,107 @@ void file_descriptor::close() {
   m_fd = -1;
 }
 
+// }}}
+// implementation of reread_file {{{
+
+reread_file::reread_file(const string& path) : m_fd(path, O_RDONLY | O_CLOEXEC), m_buffer(BUFSIZ, '\0') {}
+
+/**
+ * Read all files again, with a single syscall if io_uring is available
+ *
+ * Afterwards the contents of each file are returned by contents().
+ *
+ * \throws system_error if a file can't be read
+ */
+void reread_file::read_all(const vector<reread_file*>& files) {
+  auto ring = files.size() > 1 ? uring::local() : nullptr;
+  if (ring == nullptr) {
+    for (auto&& file : files) {
+      file->read();
+    }
+    return;
+  }
+
+  vector<uring::request> requests;
+  requests.reserve(files.size());
+  for (auto&& file : files) {
+    requests.emplace_back(uring::request{file->m_fd, &file->m_buffer[0], file->m_buffer.size() - 1, -EIO});
+  }
+
+  try {
+    ring->read(requests);
+  } catch (const system_error&) {
+    // Completions of the failed batch would otherwise show up in the next one
+    uring::discard();
+    for (auto&& r : requests) {
+      r.result = -EIO;
+    }
+  }
+
+  for (size_t i = 0; i < files.size(); i++) {
+    files[i]->complete(requests[i].result);
+  }
+}
+
+/**
+ * Read the whole file again
+ *
+ * \returns The contents followed by a null byte, they are overwritten by the
+ *          next call
+ * \throws system_error if the file can't be read
+ */
+const char* reread_file::read() {
+  while (true) {
+    // A single read returns a consistent snapshot, so it is retried with a larger buffer if it didn't fit
+    ssize_t bytes = pread(m_fd, &m_buffer[0], m_buffer.size() - 1, 0);
+    if (bytes == -1 && errno == EINTR) {
+      continue;
+    } else if (bytes == -1) {
+      throw system_error("Failed to read file");
+    } else if (static_cast<size_t>(bytes) == m_buffer.size() - 1) {
+      m_buffer.resize(m_buffer.size() * 2);
+      continue;
+    }
+
+    m_size = bytes;
+    m_buffer[m_size] = '\0';
+    return m_buffer.c_str();
+  }
+}
+
+/**
+ * Contents of the last read, followed by a null byte
+ */
+const char* reread_file::contents() const {
+  return m_buffer.c_str();
+}
+
+/**
+ * Size of the contents returned by the last read
+ */
+size_t reread_file::size() const {
+  return m_size;
+}
+
+int reread_file::get_file_descriptor() const {
+  return m_fd;
+}
+
+/**
+ * Take over the result of a batched read
+ *
+ * Failed reads and reads that filled the whole buffer are done again with
+ * read(), which reports the error or grows the buffer.
+ */
+void reread_file::complete(int result) {
+  if (result < 0 || static_cast<size_t>(result) == m_buffer.size() - 1) {
+    read();
+    return;
+  }
+  m_size = result;
+  m_buffer[m_size] = '\0';
+}
+
 // }}}
 // implementation of file_streambuf {{{
 
@@ -324,6 +427,37 @@ namespace file_util {
     return "";
   }
 
+  /**
+   * Directory for polybar's cache files, empty if neither XDG_CACHE_HOME nor HOME is set
+   */
+  string get_cache_path() {
+    if (env_util::has("XDG_CACHE_HOME") && !env_util::get("XDG_CACHE_HOME").empty()) {
+      return env_util::get("XDG_CACHE_HOME") + "/polybar";
+    }
+
+    if (env_util::has("HOME")) {
+      return env_util::get("HOME") + "/.cache/polybar";
+    }
+
+    return "";
+  }
+
+  /**
+   * Create the directory and all missing parents
+   */
+  void create_directories(const string& path) {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+      string dir = path.substr(0, pos);
+      if (!dir.empty() && mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST) {
+        throw system_error("Failed to create directory " + dir);
+      }
+
+      if (pos == string::npos) {
+        break;
+      }
+    }
+  }
+
   /**
    * Return a list of file names in a directory.
    */
@@ -2,23 +2,101 @@
 
 #include <curl/curl.h>
 #include <curl/easy.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
-#include <sstream>
-
+#include "components/reactor.hpp"
 #include "errors.hpp"
 #include "settings.hpp"
+#include "utils/string.hpp"
 
 POLYBAR_NS
 
+namespace {
+  size_t write_body(char* p, size_t size, size_t bytes, void* userdata) {
+    static_cast<string*>(userdata)->append(p, size * bytes);
+    return size * bytes;
+  }
+
+  size_t stream_body(char* p, size_t size, size_t bytes, void* userdata) {
+    (*static_cast<const http_request::body_handler*>(userdata))(p, size * bytes);
+    return size * bytes;
+  }
+
+  size_t write_header(char* p, size_t size, size_t bytes, void* userdata) {
+    auto* response = static_cast<http_response*>(userdata);
+    string line{p, size * bytes};
+
+    // A status line starts the headers of the next response, e.g. after a redirect
+    if (line.compare(0, 5, "HTTP/") == 0) {
+      response->headers.clear();
+    } else {
+      auto colon = line.find(':');
+      if (colon != string::npos) {
+        auto space = [](char c) { return isspace(c) != 0; };
+        auto name = string_util::lower(string_util::trim(line.substr(0, colon), space));
+        response->headers[name] = string_util::trim(line.substr(colon + 1), space);
+      }
+    }
+
+    return size * bytes;
+  }
+
+  /**
+   * Options shared by every transfer
+   */
+  void setup(CURL* curl, int connection_timeout) {
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "deflate");
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, connection_timeout);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, true);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, true);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, ("polybar/" + string{APP_VERSION}).c_str());
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_header);
+  }
+
+  /**
+   * Set the options of a single request
+   *
+   * The request has to outlive the transfer if it has a body handler.
+   *
+   * \returns The list of additional headers, it has to be freed once the transfer is done
+   */
+  curl_slist* prepare(CURL* curl, const http_request& request, http_response& response) {
+    curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+    if (request.on_body) {
+      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_body);
+      curl_easy_setopt(curl, CURLOPT_WRITEDATA, &request.on_body);
+    } else {
+      curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_body);
+      curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response.body);
+    }
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response);
+    curl_easy_setopt(curl, CURLOPT_USERNAME, request.user.empty() ? nullptr : request.user.c_str());
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, request.password.empty() ? nullptr : request.password.c_str());
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, request.timeout);
+
+    curl_slist* headers{nullptr};
+    for (auto&& header : request.headers) {
+      headers = curl_slist_append(headers, header.c_str());
+    }
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    return headers;
+  }
+}  // namespace
+
+/**
+ * Get the value of a response header, the name is case insensitive
+ */
+string http_response::header(const string& name) const {
+  auto it = headers.find(string_util::lower(name));
+  return it != headers.end() ? it->second : "";
+}
+
 http_downloader::http_downloader(int connection_timeout) {
   m_curl = curl_easy_init();
-  curl_easy_setopt(m_curl, CURLOPT_ACCEPT_ENCODING, "deflate");
-  curl_easy_setopt(m_curl, CURLOPT_CONNECTTIMEOUT, connection_timeout);
-  curl_easy_setopt(m_curl, CURLOPT_FOLLOWLOCATION, true);
-  curl_easy_setopt(m_curl, CURLOPT_NOSIGNAL, true);
-  curl_easy_setopt(m_curl, CURLOPT_USERAGENT, ("polybar/" + string{APP_VERSION}).c_str());
-  curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, http_downloader::write);
-  curl_easy_setopt(m_curl, CURLOPT_FORBID_REUSE, true);
+  setup(m_curl, connection_timeout);
 }
 
 http_downloader::~http_downloader() {
@@ -26,34 +104,284 @@ http_downloader::~http_downloader() {
 }
 
 string http_downloader::get(const string& url, const string& user, const string& password) {
-  std::stringstream out{};
-  curl_easy_setopt(m_curl, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &out);
-  if (!user.empty()) {
-    curl_easy_setopt(m_curl, CURLOPT_USERNAME, user.c_str());
-  }
-  if (!password.empty()) {
-    curl_easy_setopt(m_curl, CURLOPT_PASSWORD, password.c_str());
-  }
+  return get(http_request{url, user, password});
+}
+
+string http_downloader::get(const http_request& request) {
+  m_response = http_response{};
+  auto* headers = prepare(m_curl, request, m_response);
 
   auto res = curl_easy_perform(m_curl);
+  curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, nullptr);
+  curl_slist_free_all(headers);
+
   if (res != CURLE_OK) {
     throw application_error(curl_easy_strerror(res), res);
   }
 
-  return out.str();
+  curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &m_response.code);
+  return m_response.body;
 }
 
 long http_downloader::response_code() {
-  long code{0};
-  curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &code);
-  return code;
+  return m_response.code;
+}
+
+string http_downloader::response_header(const string& name) const {
+  return m_response.header(name);
+}
+
+struct http_client::transfer {
+  transfer_id id{0};
+  CURL* easy{nullptr};
+  curl_slist* headers{nullptr};
+  http_request request;
+  callback fn;
+  http_response response;
+
+  ~transfer() {
+    curl_easy_cleanup(easy);
+    curl_slist_free_all(headers);
+  }
+};
+
+/**
+ * Create instance
+ */
+http_client::make_type http_client::make() {
+  return static_cast<http_client&>(*factory_util::singleton<http_client>());
+}
+
+/**
+ * Construct client
+ */
+http_client::http_client(int connection_timeout) : m_connection_timeout(connection_timeout) {
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+
+  if ((m_multi = curl_multi_init()) == nullptr) {
+    throw application_error("Failed to create curl multi handle");
+  }
+
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd == -1) {
+    throw system_error("Failed to create timer");
+  }
+  m_timer = file_util::make_file_descriptor(fd);
+
+  curl_multi_setopt(m_multi, CURLMOPT_SOCKETFUNCTION, socket_callback);
+  curl_multi_setopt(m_multi, CURLMOPT_SOCKETDATA, this);
+  curl_multi_setopt(m_multi, CURLMOPT_TIMERFUNCTION, timer_callback);
+  curl_multi_setopt(m_multi, CURLMOPT_TIMERDATA, this);
+
+  reactor::make().add(*m_timer, EPOLLIN, [this](int, unsigned int) { on_timeout(); });
+}
+
+/**
+ * Deconstruct client, transfers that are still running are dropped
+ */
+http_client::~http_client() {
+  reactor::make().remove(*m_timer);
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  for (auto&& t : m_transfers) {
+    curl_multi_remove_handle(m_multi, t.second->easy);
+  }
+  m_transfers.clear();
+  curl_multi_cleanup(m_multi);
+  curl_global_cleanup();
+}
+
+/**
+ * Start a GET request
+ *
+ * The callback is invoked on the reactor's thread once the transfer is done,
+ * it must not throw.
+ */
+http_client::transfer_id http_client::get(const http_request& request, callback fn) {
+  auto t = make_unique<transfer>();
+  if ((t->easy = curl_easy_init()) == nullptr) {
+    throw application_error("Failed to create curl handle");
+  }
+
+  setup(t->easy, m_connection_timeout);
+  t->request = request;
+  t->headers = prepare(t->easy, t->request, t->response);
+  t->fn = move(fn);
+  curl_easy_setopt(t->easy, CURLOPT_PRIVATE, t.get());
+
+  std::lock_guard<std::mutex> guard(m_lock);
+  t->id = m_next_id++;
+  if (m_next_id == 0) {
+    m_next_id = 1;
+  }
+
+  auto res = curl_multi_add_handle(m_multi, t->easy);
+  if (res != CURLM_OK) {
+    throw application_error(curl_multi_strerror(res), res);
+  }
+
+  auto id = t->id;
+  m_transfers.emplace(id, move(t));
+  return id;
+}
+
+/**
+ * Abort a transfer, its callback is never invoked afterwards
+ *
+ * If the callback is running on another thread, this waits for it to
+ * return. It must therefore not be called while holding a lock that the
+ * callback takes.
+ */
+void http_client::cancel(transfer_id id) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_transfers.find(id);
+    if (it != m_transfers.end()) {
+      curl_multi_remove_handle(m_multi, it->second->easy);
+      m_transfers.erase(it);
+    }
+  }
+
+  if (m_dispatcher.load() != std::this_thread::get_id()) {
+    std::lock_guard<std::mutex> guard(m_dispatchlock);
+  }
+}
+
+/**
+ * Called by curl whenever it wants the events watched for a socket to change
+ */
+int http_client::socket_callback(void*, int fd, int what, void* userp, void*) {
+  auto* This = static_cast<http_client*>(userp);
+
+  try {
+    if (what == CURL_POLL_REMOVE) {
+      reactor::make().remove(fd);
+      return 0;
+    }
+
+    unsigned int events{0};
+    if (what & CURL_POLL_IN) {
+      events |= EPOLLIN;
+    }
+    if (what & CURL_POLL_OUT) {
+      events |= EPOLLOUT;
+    }
+    reactor::make().add(fd, events, [This](int ready, unsigned int revents) { This->on_ready(ready, revents); });
+  } catch (const exception&) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Called by curl whenever its timeout changes, -1 disables it
+ *
+ * curl functions must not be called from here, a timeout of 0 therefore
+ * lets the timer expire right away instead.
+ */
+int http_client::timer_callback(void*, long timeout_ms, void* userp) {
+  auto* This = static_cast<http_client*>(userp);
+
+  struct itimerspec spec {};
+  if (timeout_ms == 0) {
+    spec.it_value.tv_nsec = 1;
+  } else if (timeout_ms > 0) {
+    spec.it_value.tv_sec = timeout_ms / 1000;
+    spec.it_value.tv_nsec = (timeout_ms % 1000) * 1000000;
+  }
+
+  return timerfd_settime(*This->m_timer, 0, &spec, nullptr);
+}
+
+/**
+ * Called by the reactor whenever one of curl's sockets is ready
+ */
+void http_client::on_ready(int fd, unsigned int events) {
+  int action{0};
+  if (events & EPOLLIN) {
+    action |= CURL_CSELECT_IN;
+  }
+  if (events & EPOLLOUT) {
+    action |= CURL_CSELECT_OUT;
+  }
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    action |= CURL_CSELECT_ERR;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    int running{0};
+    curl_multi_socket_action(m_multi, fd, action, &running);
+  }
+
+  dispatch();
+}
+
+/**
+ * Called by the reactor once curl's timeout expired
+ */
+void http_client::on_timeout() {
+  uint64_t expirations;
+  if (read(*m_timer, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    int running{0};
+    curl_multi_socket_action(m_multi, CURL_SOCKET_TIMEOUT, 0, &running);
+  }
+
+  dispatch();
 }
 
-size_t http_downloader::write(void* p, size_t size, size_t bytes, void* stream) {
-  string data{static_cast<const char*>(p), size * bytes};
-  *(static_cast<std::stringstream*>(stream)) << data << '\n';
-  return size * bytes;
+/**
+ * Hand the finished transfers to their callbacks
+ *
+ * The callbacks are invoked without holding m_lock, so they can start new
+ * transfers right away.
+ */
+void http_client::dispatch() {
+  std::lock_guard<std::mutex> dispatching(m_dispatchlock);
+
+  vector<unique_ptr<transfer>> done;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    CURLMsg* msg{nullptr};
+    int queued{0};
+
+    while ((msg = curl_multi_info_read(m_multi, &queued)) != nullptr) {
+      if (msg->msg != CURLMSG_DONE) {
+        continue;
+      }
+
+      CURL* easy = msg->easy_handle;
+      auto result = msg->data.result;
+      transfer* t{nullptr};
+      curl_easy_getinfo(easy, CURLINFO_PRIVATE, &t);
+
+      if (result != CURLE_OK) {
+        t->response.error = curl_easy_strerror(result);
+      } else {
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &t->response.code);
+      }
+
+      curl_multi_remove_handle(m_multi, easy);
+
+      auto it = m_transfers.find(t->id);
+      if (it != m_transfers.end()) {
+        done.emplace_back(move(it->second));
+        m_transfers.erase(it);
+      }
+    }
+  }
+
+  m_dispatcher = std::this_thread::get_id();
+  for (auto&& t : done) {
+    t->fn(move(t->response));
+  }
+  m_dispatcher = std::thread::id{};
 }
 
 POLYBAR_NS_END
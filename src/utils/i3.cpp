@@ -1,8 +1,12 @@
+#include <algorithm>
 #include <xcb/xcb.h>
 #include <i3ipc++/ipc.hpp>
 
 #include "common.hpp"
+#include "components/logger.hpp"
+#include "components/reactor.hpp"
 #include "settings.hpp"
+#include "utils/factory.hpp"
 #include "utils/i3.hpp"
 #include "utils/socket.hpp"
 #include "utils/string.hpp"
@@ -78,6 +82,176 @@ namespace i3_util {
     }
     return false;
   }
+
+  /**
+   * Create instance
+   */
+  hub::make_type hub::make() {
+    return static_cast<hub&>(*factory_util::singleton<hub>());
+  }
+
+  /**
+   * Subscribe to workspace and mode events and fetch the workspaces
+   */
+  hub::model hub::connect() {
+    std::lock_guard<std::mutex> guard(m_ipc_lock);
+    m_ipc = factory_util::unique<connection_t>();
+
+    m_ipc->on_workspace_event = [this](const i3ipc::workspace_event_t& event) {
+      if (m_stale) {
+        return;
+      }
+      auto next = make_shared<state>(*m_state);
+      if (apply(event, *next)) {
+        m_state = move(next);
+      } else {
+        logger::make().trace("i3: Fetching workspaces again after workspace event");
+        m_stale = true;
+      }
+    };
+    m_ipc->on_mode_event = [this](const i3ipc::mode_t& mode) {
+      auto next = make_shared<state>(*m_state);
+      next->mode = mode.change;
+      m_state = move(next);
+    };
+    m_ipc->subscribe(i3ipc::ET_WORKSPACE | i3ipc::ET_MODE);
+
+    auto initial = make_shared<state>();
+    auto workspaces = m_ipc->get_workspaces();
+    initial->workspaces.assign(workspaces.begin(), workspaces.end());
+    m_state = move(initial);
+    m_stale = false;
+
+    watch();
+    return m_state;
+  }
+
+  void hub::disconnect() {
+    std::lock_guard<std::mutex> guard(m_ipc_lock);
+    if (m_fd != -1) {
+      reactor::make().remove(m_fd);
+      m_fd = -1;
+    }
+    logger::make().info("i3: Disconnecting from socket");
+    m_ipc.reset();
+    m_state.reset();
+  }
+
+  void hub::watch() {
+    m_fd = m_ipc->get_event_socket_fd();
+    reactor::make().add(m_fd, EPOLLIN, [this](int, unsigned int) { on_event(); });
+  }
+
+  /**
+   * Read the pending event and publish the state if it changed
+   */
+  void hub::on_event() {
+    shared_ptr<const state> changed;
+    {
+      std::lock_guard<std::mutex> guard(m_ipc_lock);
+      if (!m_ipc) {
+        return;
+      }
+
+      auto before = m_state;
+      try {
+        m_ipc->handle_event();
+      } catch (const exception& err) {
+        const logger& log{logger::make()};
+        log.warn("i3: Attempting to reconnect socket (reason: %s)", err.what());
+        reactor::make().remove(m_fd);
+        m_fd = -1;
+
+        try {
+          m_ipc->connect_event_socket(true);
+          watch();
+          log.info("i3: Reconnecting socket succeeded");
+          // Events may have been missed in the meantime
+          m_stale = true;
+        } catch (const exception& err) {
+          log.err("i3: Failed to reconnect socket, workspaces are no longer updated (reason: %s)", err.what());
+          return;
+        }
+      }
+
+      if (m_stale) {
+        try {
+          auto next = make_shared<state>(*m_state);
+          auto workspaces = m_ipc->get_workspaces();
+          next->workspaces.assign(workspaces.begin(), workspaces.end());
+          m_state = move(next);
+          m_stale = false;
+        } catch (const exception& err) {
+          logger::make().err("i3: Failed to fetch workspaces (reason: %s)", err.what());
+        }
+      }
+
+      if (m_state != before) {
+        changed = m_state;
+      }
+    }
+
+    if (changed) {
+      publish(move(changed));
+    }
+  }
+
+  /**
+   * Apply a workspace event to the workspaces of the next state
+   *
+   * Focus changes, urgency hints and removed workspaces are applied directly.
+   * Other events don't carry the output or the number of the workspace.
+   * Workspaces are shared with earlier states, so changed ones are copied.
+   *
+   * \returns false if the event couldn't be applied
+   */
+  bool hub::apply(const i3ipc::workspace_event_t& event, state& next) {
+    if (!event.current) {
+      return false;
+    }
+
+    auto& workspaces = next.workspaces;
+    auto current = std::find_if(workspaces.begin(), workspaces.end(),
+        [&](const shared_ptr<const workspace_t>& ws) { return ws->name == event.current->name; });
+
+    if (current == workspaces.end()) {
+      return false;
+    }
+
+    const auto modify = [](shared_ptr<const workspace_t>& ws) -> workspace_t& {
+      auto copy = make_shared<workspace_t>(*ws);
+      ws = copy;
+      return *copy;
+    };
+
+    switch (event.type) {
+      case i3ipc::WorkspaceEventType::FOCUS: {
+        auto output = (*current)->output;
+        for (auto&& ws : workspaces) {
+          // Only one workspace per output is visible, those on other outputs stay visible
+          bool visible = ws->visible && ws->output != output;
+          if (ws->focused || ws->visible != visible) {
+            auto& copy = modify(ws);
+            copy.focused = false;
+            copy.visible = visible;
+          }
+        }
+        auto& focused = modify(*current);
+        focused.focused = true;
+        focused.visible = true;
+        focused.urgent = event.current->urgent;
+        return true;
+      }
+      case i3ipc::WorkspaceEventType::URGENT:
+        modify(*current).urgent = event.current->urgent;
+        return true;
+      case i3ipc::WorkspaceEventType::EMPTY:
+        workspaces.erase(current);
+        return true;
+      default:
+        return false;
+    }
+  }
 }
 
 POLYBAR_NS_END
@@ -1,5 +1,7 @@
 #include <unistd.h>
+#include <algorithm>
 
+#include "components/reactor.hpp"
 #include "errors.hpp"
 #include "utils/inotify.hpp"
 #include "utils/memory.hpp"
@@ -117,4 +119,142 @@ int inotify_watch::get_file_descriptor() const {
   return m_fd;
 }
 
+/**
+ * Create instance
+ */
+inotify_multiplexer::make_type inotify_multiplexer::make() {
+  return static_cast<inotify_multiplexer&>(*factory_util::singleton<inotify_multiplexer>(reactor::make()));
+}
+
+/**
+ * Construct multiplexer and register its fd with the reactor
+ */
+inotify_multiplexer::inotify_multiplexer(reactor& reactor) : m_reactor(reactor) {
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd == -1) {
+    throw system_error("Failed to allocate inotify fd");
+  }
+  m_fd = file_util::make_file_descriptor(fd);
+
+  m_reactor.add(*m_fd, EPOLLIN, [this](int, unsigned int) { on_ready(); });
+}
+
+/**
+ * Deconstruct multiplexer, closing the fd drops all watches
+ */
+inotify_multiplexer::~inotify_multiplexer() {
+  m_reactor.remove(*m_fd);
+}
+
+/**
+ * Watch a path for the events in `mask`
+ *
+ * \throws system_error If the path can't be watched
+ */
+inotify_multiplexer::watch_id inotify_multiplexer::add(const string& path, int mask, callback fn) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  // Watches of the same path share the watch descriptor, its mask is the union of theirs
+  int wd = inotify_add_watch(*m_fd, path.c_str(), mask | IN_MASK_ADD);
+  if (wd == -1) {
+    throw system_error("Failed to attach inotify watch");
+  }
+
+  auto id = m_next_id++;
+  if (m_next_id == 0) {
+    m_next_id = 1;
+  }
+
+  m_watches.emplace(id, watch{path, wd, mask, move(fn)});
+  return id;
+}
+
+/**
+ * Remove a watch, its callback is never invoked afterwards
+ *
+ * If the callback is running on another thread, this waits for it to
+ * return. It must therefore not be called while holding a lock that the
+ * callback takes.
+ */
+void inotify_multiplexer::remove(watch_id id) {
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_watches.find(id);
+    if (it == m_watches.end()) {
+      return;
+    }
+
+    int wd = it->second.wd;
+    m_watches.erase(it);
+
+    auto shared = std::find_if(
+        m_watches.begin(), m_watches.end(), [wd](const std::pair<const watch_id, watch>& w) { return w.second.wd == wd; });
+    if (wd != -1 && shared == m_watches.end()) {
+      inotify_rm_watch(*m_fd, wd);
+    }
+  }
+
+  if (m_dispatcher.load() != std::this_thread::get_id()) {
+    std::lock_guard<std::mutex> guard(m_dispatchlock);
+  }
+}
+
+/**
+ * Called by the reactor once the inotify fd is readable
+ *
+ * All pending events are read and merged per watch, each callback is then
+ * invoked once without holding m_lock.
+ */
+void inotify_multiplexer::on_ready() {
+  std::lock_guard<std::mutex> dispatching(m_dispatchlock);
+
+  vector<std::pair<callback, inotify_event>> pending;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    std::map<watch_id, inotify_event> events;
+
+    alignas(struct ::inotify_event) char buffer[4096];
+    ssize_t bytes;
+
+    while ((bytes = read(*m_fd, buffer, sizeof(buffer))) > 0) {
+      for (ssize_t len = 0; len < bytes;) {
+        const auto* e = reinterpret_cast<const ::inotify_event*>(&buffer[len]);
+        len += sizeof(*e) + e->len;
+
+        for (auto&& entry : m_watches) {
+          auto& w = entry.second;
+
+          // An overflowed queue lost events of every watch
+          bool overflow = e->mask & IN_Q_OVERFLOW;
+          if (!overflow && (w.wd != e->wd || !(e->mask & (w.mask | IN_IGNORED)))) {
+            continue;
+          }
+
+          auto& event = events[entry.first];
+          event.filename = e->len ? e->name : w.path;
+          event.is_dir = e->mask & IN_ISDIR;
+          event.wd = e->wd;
+          event.cookie = e->cookie;
+          event.mask |= e->mask;
+
+          // The kernel dropped the watch descriptor and may hand it out again
+          if (e->mask & IN_IGNORED) {
+            w.wd = -1;
+          }
+        }
+      }
+    }
+
+    for (auto&& event : events) {
+      pending.emplace_back(m_watches.at(event.first).fn, move(event.second));
+    }
+  }
+
+  m_dispatcher = std::this_thread::get_id();
+  for (auto&& p : pending) {
+    p.first(p.second);
+  }
+  m_dispatcher = std::thread::id{};
+}
+
 POLYBAR_NS_END
@@ -0,0 +1,121 @@
+#include "utils/line_reader.hpp"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include "errors.hpp"
+#include "utils/io.hpp"
+
+POLYBAR_NS
+
+constexpr size_t line_reader::CHUNK;
+
+/**
+ * Construct reader, the descriptor stays owned by the caller
+ */
+line_reader::line_reader(int fd) : m_fd(fd) {}
+
+/**
+ * Read the next line, blocks until it is complete or the stream is closed
+ *
+ * The line terminator isn't part of the line.
+ *
+ * \returns false once the stream is closed and all lines were read
+ */
+bool line_reader::readline(string& line) {
+  while (!take_line(line)) {
+    if (m_eof) {
+      return false;
+    }
+    if (fill() == -1) {
+      io_util::poll(m_fd, POLLIN | POLLHUP, -1);
+    }
+  }
+  return true;
+}
+
+/**
+ * Pass all lines that can be read without blocking to the callback
+ *
+ * \returns false once the stream is closed
+ */
+bool line_reader::drain_lines(const function<void(string&&)>& callback) {
+  while (!m_eof && io_util::poll(m_fd, POLLIN | POLLHUP, 0) && fill() > 0) {
+  }
+
+  string line;
+  while (take_line(line)) {
+    callback(move(line));
+  }
+
+  return !m_eof;
+}
+
+bool line_reader::eof() const {
+  return m_eof;
+}
+
+/**
+ * Number of bytes that were read but not returned yet
+ */
+size_t line_reader::buffered() const {
+  return m_buffer.size() - m_begin;
+}
+
+/**
+ * Read the next chunk
+ *
+ * \returns the number of bytes read, 0 at the end of the stream and -1 if
+ *          the descriptor is non-blocking and nothing is available
+ */
+ssize_t line_reader::fill() {
+  if (m_begin > 0 && m_begin >= m_buffer.size() / 2) {
+    m_buffer.erase(0, m_begin);
+    m_begin = 0;
+  }
+
+  auto size = m_buffer.size();
+  m_buffer.resize(size + CHUNK);
+
+  ssize_t bytes;
+  while ((bytes = ::read(m_fd, &m_buffer[size], CHUNK)) == -1 && errno == EINTR) {
+  }
+
+  m_buffer.resize(size + std::max<ssize_t>(bytes, 0));
+
+  if (bytes == 0) {
+    m_eof = true;
+  } else if (bytes == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+    throw system_error("Failed to read from fd " + to_string(m_fd));
+  }
+
+  return bytes;
+}
+
+/**
+ * Take the next complete line out of the buffer
+ *
+ * After the end of the stream, the rest of the buffer counts as a line.
+ */
+bool line_reader::take_line(string& line) {
+  auto end = m_buffer.find('\n', m_begin);
+  if (end == string::npos) {
+    if (!m_eof || m_begin == m_buffer.size()) {
+      return false;
+    }
+    end = m_buffer.size();
+  }
+
+  line.assign(m_buffer, m_begin, end - m_begin);
+  m_begin = std::min(end + 1, m_buffer.size());
+  if (m_begin == m_buffer.size()) {
+    m_buffer.clear();
+    m_begin = 0;
+  }
+  return true;
+}
+
+POLYBAR_NS_END
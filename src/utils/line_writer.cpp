@@ -0,0 +1,172 @@
+#include "utils/line_writer.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+
+#include "components/reactor.hpp"
+#include "errors.hpp"
+
+POLYBAR_NS
+
+/**
+ * Construct writer
+ */
+line_writer::line_writer(reactor& r, int fd, size_t max_pending)
+    : m_reactor(r), m_fd(fd), m_max_pending(max_pending) {
+  struct stat st {};
+  if (fstat(m_fd, &st) == -1) {
+    throw system_error("Failed to stat output");
+  }
+
+  m_pipe = S_ISFIFO(st.st_mode);
+  m_socket = S_ISSOCK(st.st_mode);
+}
+
+/**
+ * Deconstruct writer
+ *
+ * Makes one last attempt to write what is pending, output that the reader
+ * doesn't take right away is lost.
+ */
+line_writer::~line_writer() {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  if (m_watching) {
+    m_reactor.remove(m_fd);
+  }
+
+  try {
+    flush();
+  } catch (const system_error&) {
+  }
+}
+
+/**
+ * Queue a line, the line terminator is added here
+ *
+ * \returns false if earlier lines were dropped because the reader fell
+ *          behind, the given line is queued nonetheless
+ * \throws system_error if the output can't be written to anymore
+ */
+bool line_writer::write(const string& line) {
+  std::lock_guard<std::mutex> guard(m_lock);
+  bool kept{true};
+
+  if (m_buffer.size() + line.size() + 1 > m_max_pending) {
+    // The line that is partially written has to be finished
+    size_t keep = m_partial ? m_buffer.find('\n') + 1 : 0;
+
+    if (keep < m_buffer.size()) {
+      m_buffer.erase(keep);
+      kept = false;
+    }
+  }
+
+  m_buffer += line;
+  m_buffer += '\n';
+  flush();
+
+  return kept;
+}
+
+/**
+ * Number of bytes that were queued but not written yet
+ */
+size_t line_writer::pending() const {
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_buffer.size();
+}
+
+/**
+ * Write the start of the data without blocking
+ *
+ * \returns the number of bytes written, -1 with errno set to EAGAIN if the
+ *          descriptor doesn't take anything right now
+ */
+ssize_t line_writer::write_some(const char* data, size_t len) {
+  if (m_socket) {
+    return ::send(m_fd, data, len, MSG_DONTWAIT);
+  } else if (m_pipe) {
+    struct pollfd pfd {
+      m_fd, POLLOUT, 0
+    };
+    if (::poll(&pfd, 1, 0) == 0) {
+      errno = EAGAIN;
+      return -1;
+    }
+    // A write of up to PIPE_BUF bytes doesn't block if the pipe is writable
+    return ::write(m_fd, data, std::min<size_t>(len, PIPE_BUF));
+  }
+  return ::write(m_fd, data, len);
+}
+
+/**
+ * Write as much as the descriptor takes and watch it if anything is left
+ *
+ * Has to be called with m_lock held.
+ */
+void line_writer::flush() {
+  size_t written{0};
+  while (written < m_buffer.size()) {
+    ssize_t bytes = write_some(m_buffer.data() + written, m_buffer.size() - written);
+
+    if (bytes == -1) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+
+      m_buffer.clear();
+      m_partial = false;
+      if (m_watching) {
+        m_reactor.remove(m_fd);
+        m_watching = false;
+      }
+      throw system_error("Failed to write output");
+    }
+
+    written += bytes;
+  }
+
+  if (written > 0) {
+    m_partial = m_buffer[written - 1] != '\n';
+    // Erased instead of reassigned so that the buffer keeps its capacity
+    m_buffer.erase(0, written);
+  }
+
+  bool pending = !m_buffer.empty();
+  if (pending && !m_watching) {
+    m_reactor.add(m_fd, EPOLLOUT, [this](int fd, unsigned int events) { on_ready(fd, events); });
+    m_watching = true;
+  } else if (!pending && m_watching) {
+    m_reactor.remove(m_fd);
+    m_watching = false;
+  }
+}
+
+/**
+ * Called by the reactor once the descriptor is writable again
+ */
+void line_writer::on_ready(int, unsigned int events) {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    // The reader is gone
+    m_buffer.clear();
+    m_partial = false;
+  }
+
+  try {
+    flush();
+  } catch (const system_error&) {
+  }
+}
+
+POLYBAR_NS_END
@@ -1,6 +1,8 @@
 #include "utils/process.hpp"
 
 #include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -10,9 +12,27 @@
 #include "utils/env.hpp"
 #include "utils/string.hpp"
 
+extern char** environ;
+
 POLYBAR_NS
 
 namespace process_util {
+  namespace {
+    const string& shell() {
+      static const string shell{env_util::get("POLYBAR_SHELL", "/bin/sh")};
+      return shell;
+    }
+
+    /**
+     * The bar blocks some signals in all threads, children must not inherit that
+     */
+    void unblock_signals() {
+      sigset_t mask;
+      sigemptyset(&mask);
+      sigprocmask(SIG_SETMASK, &mask, nullptr);
+    }
+  }  // namespace
+
   /**
    * Check if currently in main process
    */
@@ -58,6 +78,7 @@ namespace process_util {
         // Child
         setsid();
         umask(0);
+        unblock_signals();
         redirect_stdio_to_dev_null();
         lambda();
         _Exit(0);
@@ -96,6 +117,7 @@ namespace process_util {
           case 0:
             // Child
             umask(0);
+            unblock_signals();
             redirect_stdio_to_dev_null();
             lambda();
             _Exit(0);
@@ -111,6 +133,87 @@ namespace process_util {
     }
   }
 
+  /**
+   * Run the command through the shell with posix_spawn
+   *
+   * Unlike fork(), posix_spawn doesn't copy the page tables of the bar, so
+   * its cost doesn't grow with the memory the bar uses.
+   *
+   * `in`, `out` and `err` become the standard streams of the child, -1 for
+   * /dev/null. The child runs in a new session if `new_session` is set and in
+   * a new process group otherwise. Other file descriptors are inherited unless
+   * they were opened with O_CLOEXEC.
+   *
+   * Processes spawned this way need to be waited on by the caller.
+   */
+  pid_t spawn_sh(const string& cmd, int in, int out, int err, bool new_session) {
+    const char* argv[]{shell().c_str(), "-c", cmd.c_str(), nullptr};
+    return spawn(argv, in, out, err, new_session);
+  }
+
+  /**
+   * Spawn the command and forget about it
+   *
+   * Instead of a double fork, the shell that is spawned starts the command
+   * in the background and exits right away, so the command is reparented to
+   * the init process.
+   */
+  void spawn_detached(const string& cmd) {
+    const char* argv[]{shell().c_str(), "-c", "\"$0\" -c \"$1\" &", shell().c_str(), cmd.c_str(), nullptr};
+    wait(spawn(argv, -1, -1, -1, true));
+  }
+
+  /**
+   * Spawn the program in `argv[0]` (searched in PATH) with the given arguments
+   *
+   * \see spawn_sh
+   */
+  pid_t spawn(const char* const* argv, int in, int out, int err, bool new_session) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    const auto redirect = [&](int fd, int target) {
+      if (fd == -1) {
+        posix_spawn_file_actions_addopen(&actions, target, "/dev/null", target == STDIN_FILENO ? O_RDONLY : O_WRONLY, 0);
+      } else if (fd != target) {
+        posix_spawn_file_actions_adddup2(&actions, fd, target);
+      }
+    };
+    redirect(in, STDIN_FILENO);
+    redirect(out, STDOUT_FILENO);
+    redirect(err, STDERR_FILENO);
+
+    // Signals blocked by the spawning thread are not passed on
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+
+    short flags{POSIX_SPAWN_SETSIGMASK};
+#ifdef POSIX_SPAWN_SETSID
+    flags |= new_session ? POSIX_SPAWN_SETSID : POSIX_SPAWN_SETPGROUP;
+#else
+    (void)new_session;
+    flags |= POSIX_SPAWN_SETPGROUP;
+#endif
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, flags);
+
+    pid_t pid;
+    int result = posix_spawnp(&pid, argv[0], &actions, &attr, const_cast<char* const*>(argv), environ);
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (result != 0) {
+      errno = result;
+      throw system_error("Failed to spawn process");
+    }
+
+    return pid;
+  }
+
   /**
    * Execute command
    */
@@ -126,8 +229,7 @@ namespace process_util {
    */
   void exec_sh(const char* cmd) {
     if (cmd != nullptr) {
-      static const string shell{env_util::get("POLYBAR_SHELL", "/bin/sh")};
-      execlp(shell.c_str(), shell.c_str(), "-c", cmd, nullptr);
+      execlp(shell().c_str(), shell().c_str(), "-c", cmd, nullptr);
       throw system_error("execlp() failed");
     }
   }
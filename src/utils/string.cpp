@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <iomanip>
+#include <map>
 #include <sstream>
 #include <utility>
 
@@ -7,6 +8,29 @@
 
 POLYBAR_NS
 
+namespace {
+  /**
+   * Empty stream imbued with the given locale, the classic one if empty
+   *
+   * Constructing a named locale is expensive, so every thread keeps one
+   * stream per locale and reuses it between calls
+   */
+  std::ostringstream& number_stream(const string& locale) {
+    thread_local std::map<string, unique_ptr<std::ostringstream>> streams;
+
+    auto& stream = streams[locale];
+    if (!stream) {
+      auto created = make_unique<std::ostringstream>();
+      created->imbue(!locale.empty() ? std::locale(locale.c_str()) : std::locale::classic());
+      stream = move(created);
+    }
+
+    stream->str(string{});
+    stream->clear();
+    return *stream;
+  }
+}  // namespace
+
 namespace string_util {
   /**
    * Check if haystack contains needle
@@ -19,29 +43,42 @@ namespace string_util {
    * Convert string to uppercase
    */
   string upper(const string& s) {
-    string str(s);
-    for (auto& c : str) {
+    return upper(string{s});
+  }
+
+  /**
+   * Convert string to uppercase, reusing its buffer
+   */
+  string upper(string&& s) {
+    for (auto& c : s) {
       c = toupper(c);
     }
-    return str;
+    return move(s);
   }
 
   /**
    * Convert string to lowercase
    */
   string lower(const string& s) {
-    string str(s);
-    for (auto& c : str) {
+    return lower(string{s});
+  }
+
+  /**
+   * Convert string to lowercase, reusing its buffer
+   */
+  string lower(string&& s) {
+    for (auto& c : s) {
       c = tolower(c);
     }
-    return str;
+    return move(s);
   }
 
   /**
    * Test lower case equality
    */
   bool compare(const string& s1, const string& s2) {
-    return lower(s1) == lower(s2);
+    auto equal = [](char a, char b) { return tolower(a) == tolower(b); };
+    return s1.size() == s2.size() && std::equal(s1.begin(), s1.end(), s2.begin(), equal);
   }
 
   /**
@@ -49,30 +86,54 @@ namespace string_util {
    */
   string replace(const string& haystack, const string& needle, const string& replacement, size_t start, size_t end) {
     string str(haystack);
+    replace_inplace(str, needle, replacement, start, end);
+    return str;
+  }
+
+  /**
+   * Replace all occurences of needle in haystack
+   */
+  string replace_all(
+      const string& haystack, const string& needle, const string& replacement, size_t start, size_t end) {
+    string result{haystack};
+    replace_all_inplace(result, needle, replacement, start, end);
+    return result;
+  }
+
+  /**
+   * Replace first occurence of needle in haystack, modifying haystack
+   *
+   * \returns true if needle was replaced
+   */
+  bool replace_inplace(string& haystack, const string& needle, const string& replacement, size_t start, size_t end) {
     string::size_type pos;
 
-    if (needle != replacement && (pos = str.find(needle, start)) != string::npos) {
+    if (needle != replacement && (pos = haystack.find(needle, start)) != string::npos) {
       if (end == string::npos || pos < end) {
-        str = str.replace(pos, needle.length(), replacement);
+        haystack.replace(pos, needle.length(), replacement);
+        return true;
       }
     }
 
-    return str;
+    return false;
   }
 
   /**
-   * Replace all occurences of needle in haystack
+   * Replace all occurences of needle in haystack, modifying haystack
+   *
+   * \returns The number of replacements
    */
-  string replace_all(
-      const string& haystack, const string& needle, const string& replacement, size_t start, size_t end) {
-    string result{haystack};
+  size_t replace_all_inplace(
+      string& haystack, const string& needle, const string& replacement, size_t start, size_t end) {
+    size_t count{0};
     string::size_type pos;
-    while ((pos = result.find(needle, start)) != string::npos && pos < result.length() &&
+    while ((pos = haystack.find(needle, start)) != string::npos && pos < haystack.length() &&
            (end == string::npos || pos + needle.length() <= end)) {
-      result.replace(pos, needle.length(), replacement);
+      haystack.replace(pos, needle.length(), replacement);
       start = pos + replacement.length();
+      count++;
     }
-    return result;
+    return count;
   }
 
   /**
@@ -80,9 +141,8 @@ namespace string_util {
    */
   string squeeze(const string& haystack, char needle) {
     string result = haystack;
-    while (result.find({needle, needle}) != string::npos) {
-      result = replace_all(result, {needle, needle}, {needle});
-    }
+    auto repeated = [needle](char a, char b) { return a == needle && b == needle; };
+    result.erase(std::unique(result.begin(), result.end(), repeated), result.end());
     return result;
   }
 
@@ -91,10 +151,7 @@ namespace string_util {
    */
   string strip(const string& haystack, char needle) {
     string str(haystack);
-    string::size_type pos;
-    while ((pos = str.find(needle)) != string::npos) {
-      str.erase(pos, 1);
-    }
+    str.erase(std::remove(str.begin(), str.end(), needle), str.end());
     return str;
   }
 
@@ -103,69 +160,34 @@ namespace string_util {
    */
   string strip_trailing_newline(const string& haystack) {
     string str(haystack);
-    if (str[str.length() - 1] == '\n') {
-      str.erase(str.length() - 1, 1);
+    if (!str.empty() && str.back() == '\n') {
+      str.pop_back();
     }
     return str;
   }
 
-  /**
-   * Trims all characters that match pred from the left
-   */
-  string ltrim(string value, function<bool(char)> pred) {
-    value.erase(value.begin(), find_if(value.begin(), value.end(), not1(pred)));
-    return value;
-  }
-
-  /**
-   * Trims all characters that match pred from the right
-   */
-  string rtrim(string value, function<bool(char)> pred) {
-    value.erase(find_if(value.rbegin(), value.rend(), not1(pred)).base(), value.end());
-    return value;
-  }
-
-  /**
-   * Trims all characters that match pred from both sides
-   */
-  string trim(string value, function<bool(char)> pred) {
-    return ltrim(rtrim(move(value), pred), pred);
-  }
-
   /**
    * Remove needle from the start of the string
    */
   string ltrim(string&& value, const char& needle) {
-    if (value.empty()) {
-      return "";
-    }
-    while (*value.begin() == needle) {
-      value.erase(0, 1);
-    }
-    return forward<string>(value);
+    value.erase(0, value.find_first_not_of(needle));
+    return move(value);
   }
 
   /**
    * Remove needle from the end of the string
    */
   string rtrim(string&& value, const char& needle) {
-    if (value.empty()) {
-      return "";
-    }
-    while (*(value.end() - 1) == needle) {
-      value.erase(value.length() - 1, 1);
-    }
-    return forward<string>(value);
+    auto pos = value.find_last_not_of(needle);
+    value.erase(pos == string::npos ? 0 : pos + 1);
+    return move(value);
   }
 
   /**
    * Remove needle from the start and end of the string
    */
   string trim(string&& value, const char& needle) {
-    if (value.empty()) {
-      return "";
-    }
-    return rtrim(ltrim(forward<string>(value), needle), needle);
+    return rtrim(ltrim(move(value), needle), needle);
   }
 
   /**
@@ -210,6 +232,41 @@ namespace string_util {
     return forward<string>(value);
   }
 
+  /**
+   * Append the given value to `dst` as a quoted JSON string
+   */
+  void append_json(string& dst, const string& value) {
+    static constexpr char hex[]{"0123456789abcdef"};
+
+    dst.reserve(dst.size() + value.size() + 2);
+    dst += '"';
+    for (char c : value) {
+      switch (c) {
+        case '"':
+          dst += "\\\"";
+          break;
+        case '\\':
+          dst += "\\\\";
+          break;
+        case '\n':
+          dst += "\\n";
+          break;
+        case '\t':
+          dst += "\\t";
+          break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            dst += "\\u00";
+            dst += hex[c >> 4];
+            dst += hex[c & 0xf];
+          } else {
+            dst += c;
+          }
+      }
+    }
+    dst += '"';
+  }
+
   /**
    * Join all strings in vector into a single string separated by delim
    */
@@ -271,10 +328,14 @@ namespace string_util {
    * Create a floating point string
    */
   string floating_point(double value, size_t precision, bool fixed, const string& locale) {
-    std::stringstream ss;
-    ss.imbue(!locale.empty() ? std::locale(locale.c_str()) : std::locale::classic());
+    auto& ss = number_stream(locale);
     ss << std::fixed << std::setprecision(precision) << value;
-    return fixed ? ss.str() : replace(ss.str(), ".00", "");
+
+    string result{ss.str()};
+    if (!fixed) {
+      replace_inplace(result, ".00", "");
+    }
+    return result;
   }
 
   /**
@@ -295,15 +356,18 @@ namespace string_util {
    * Create a filesize string by converting given bytes to highest unit possible
    */
   string filesize(unsigned long long bytes, size_t precision, bool fixed, const string& locale) {
-    vector<string> suffixes{"TB", "GB", "MB", "KB"};
-    string suffix{"B"};
+    static const char* const suffixes[]{"B", "KB", "MB", "GB", "TB"};
+    size_t suffix{0};
     double value = bytes;
-    while (!suffixes.empty() && value >= 1024.0) {
-      suffix = suffixes.back();
-      suffixes.pop_back();
+    while (suffix + 1 < sizeof(suffixes) / sizeof(*suffixes) && value >= 1024.0) {
+      suffix++;
       value /= 1024.0;
     }
-    return floating_point(value, precision, fixed, locale) + " " + suffix;
+
+    string result{floating_point(value, precision, fixed, locale)};
+    result += ' ';
+    result += suffixes[suffix];
+    return result;
   }
 
   /**
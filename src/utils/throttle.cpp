@@ -31,6 +31,61 @@ namespace throttle_util {
       return true;
     }
   }
+
+  budget::budget(limit max_events, timewindow max_busy, timewindow window)
+      : m_max_events(max_events), m_max_busy(max_busy), m_window(window) {}
+
+  /**
+   * Count an event
+   */
+  void budget::event() {
+    if (m_max_events == 0) {
+      return;
+    }
+    m_events.emplace_back(timepoint_clock::now());
+    // Only the most recent events matter for the limit, which bounds the queue when flooded
+    while (m_events.size() > m_max_events + 1) {
+      m_events.pop_front();
+    }
+  }
+
+  /**
+   * Count time spent on an event
+   */
+  void budget::spend(timewindow busy) {
+    if (m_max_busy <= timewindow::zero()) {
+      return;
+    }
+    m_busy.emplace_back(timepoint_clock::now(), busy);
+    m_busy_sum += busy;
+  }
+
+  /**
+   * Check if more events happened or more time was spent within the window than allowed
+   */
+  bool budget::exceeded() {
+    expire(timepoint_clock::now());
+    return (m_max_events != 0 && m_events.size() > m_max_events) ||
+           (m_max_busy > timewindow::zero() && m_busy_sum > m_max_busy);
+  }
+
+  limit budget::max_events() const {
+    return m_max_events;
+  }
+
+  timewindow budget::max_busy() const {
+    return m_max_busy;
+  }
+
+  void budget::expire(timepoint now) {
+    while (!m_events.empty() && now - m_events.front() >= m_window) {
+      m_events.pop_front();
+    }
+    while (!m_busy.empty() && now - m_busy.front().first >= m_window) {
+      m_busy_sum -= m_busy.front().second;
+      m_busy.pop_front();
+    }
+  }
 }
 
 POLYBAR_NS_END
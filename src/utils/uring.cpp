@@ -0,0 +1,263 @@
+#include "utils/uring.hpp"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include "errors.hpp"
+
+#if WITH_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+POLYBAR_NS
+
+constexpr unsigned uring::ENTRIES;
+
+namespace {
+  // Cleared once setting up a ring failed, e.g. because io_uring is disabled
+  std::atomic<bool> g_available{WITH_IO_URING != 0};
+
+  thread_local unique_ptr<uring> t_ring;
+
+#if WITH_IO_URING
+  template <typename T>
+  T* at(void* base, unsigned offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+  }
+
+  unsigned load_acquire(const unsigned* p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+  }
+
+  void store_release(unsigned* p, unsigned value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+  }
+#endif
+}  // namespace
+
+/**
+ * Ring of the calling thread, created on first use
+ *
+ * \returns nullptr if io_uring can't be used
+ */
+uring* uring::local() {
+  if (!t_ring && g_available) {
+    try {
+      t_ring = make_unique<uring>();
+    } catch (const system_error&) {
+      g_available = false;
+    }
+  }
+  return t_ring.get();
+}
+
+/**
+ * Drop the ring of the calling thread, the next call to local() sets up a new one
+ *
+ * Reads that failed may have left requests in the ring that were never
+ * submitted or completed.
+ */
+void uring::discard() {
+  t_ring.reset();
+}
+
+/**
+ * Set up the ring
+ *
+ * \throws system_error if io_uring isn't available
+ */
+uring::uring() {
+#if WITH_IO_URING
+  io_uring_params params{};
+  m_fd = syscall(__NR_io_uring_setup, ENTRIES, &params);
+  if (m_fd == -1) {
+    throw system_error("Failed to set up io_uring");
+  }
+
+  m_entries = params.sq_entries;
+  m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+  // Both rings share a mapping with IORING_FEAT_SINGLE_MMAP
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single) {
+    m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+  }
+
+  m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+  if (m_sq_ring == MAP_FAILED) {
+    m_sq_ring = nullptr;
+    close(m_fd);
+    throw system_error("Failed to map io_uring");
+  }
+
+  if (single) {
+    m_cq_ring = m_sq_ring;
+  } else {
+    m_cq_ring =
+        mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+  }
+
+  m_sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+
+  if (m_cq_ring == MAP_FAILED || m_sqes == MAP_FAILED) {
+    if (m_cq_ring == MAP_FAILED) {
+      m_cq_ring = nullptr;
+    }
+    if (m_sqes == MAP_FAILED) {
+      m_sqes = nullptr;
+    }
+    release();
+    throw system_error("Failed to map io_uring");
+  }
+
+  m_sq_head = at<unsigned>(m_sq_ring, params.sq_off.head);
+  m_sq_tail = at<unsigned>(m_sq_ring, params.sq_off.tail);
+  m_sq_mask = at<unsigned>(m_sq_ring, params.sq_off.ring_mask);
+  m_sq_array = at<unsigned>(m_sq_ring, params.sq_off.array);
+  m_cq_head = at<unsigned>(m_cq_ring, params.cq_off.head);
+  m_cq_tail = at<unsigned>(m_cq_ring, params.cq_off.tail);
+  m_cq_mask = at<unsigned>(m_cq_ring, params.cq_off.ring_mask);
+  m_cqes = at<void>(m_cq_ring, params.cq_off.cqes);
+#else
+  throw system_error("Not built with io_uring support");
+#endif
+}
+
+uring::~uring() {
+  release();
+}
+
+void uring::release() {
+  if (m_sqes != nullptr) {
+    munmap(m_sqes, m_sqes_size);
+    m_sqes = nullptr;
+  }
+  if (m_cq_ring != nullptr && m_cq_ring != m_sq_ring) {
+    munmap(m_cq_ring, m_cq_ring_size);
+  }
+  m_cq_ring = nullptr;
+  if (m_sq_ring != nullptr) {
+    munmap(m_sq_ring, m_sq_ring_size);
+    m_sq_ring = nullptr;
+  }
+  if (m_fd != -1) {
+    close(m_fd);
+    m_fd = -1;
+  }
+}
+
+/**
+ * Read all requests from offset 0 and wait until they are done
+ *
+ * Up to ENTRIES requests are submitted together. The results are stored in
+ * the requests.
+ *
+ * \throws system_error if io_uring_enter fails, the ring can't be used
+ *         anymore then and has to be discarded
+ */
+void uring::read(vector<request>& requests) {
+  for (size_t i = 0; i < requests.size(); i += m_entries) {
+    submit(&requests[i], std::min<size_t>(m_entries, requests.size() - i));
+  }
+}
+
+void uring::submit(request* requests, size_t count) {
+#if WITH_IO_URING
+  vector<iovec> iovecs(count);
+  auto sqes = static_cast<io_uring_sqe*>(m_sqes);
+
+  unsigned tail = *m_sq_tail;
+  for (size_t i = 0; i < count; i++) {
+    iovecs[i].iov_base = requests[i].buffer;
+    iovecs[i].iov_len = requests[i].size;
+
+    unsigned index = tail & *m_sq_mask;
+    auto& sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    // READV instead of READ, it is available since the first kernel with io_uring
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = requests[i].fd;
+    sqe.addr = reinterpret_cast<uint64_t>(&iovecs[i]);
+    sqe.len = 1;
+    sqe.off = 0;
+    sqe.user_data = i;
+
+    m_sq_array[index] = index;
+    tail++;
+  }
+  store_release(m_sq_tail, tail);
+
+  size_t pending = count;
+  unsigned to_submit = count;
+  while (pending > 0) {
+    int ret = syscall(__NR_io_uring_enter, m_fd, to_submit, pending, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (ret == -1 && errno == EINTR) {
+      continue;
+    } else if (ret == -1 && (errno == EAGAIN || errno == EBUSY) && pending > to_submit) {
+      // Out of resources or the completion queue is full, retried once reads in flight completed
+      if (reap(requests, count, pending) == 0) {
+        syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        reap(requests, count, pending);
+      }
+      continue;
+    } else if (ret == -1) {
+      int err = errno;
+      // The kernel may still write into the buffers of the reads it accepted
+      while (pending > to_submit) {
+        if (syscall(__NR_io_uring_enter, m_fd, 0, pending - to_submit, IORING_ENTER_GETEVENTS, nullptr, 0) == -1 &&
+            errno != EINTR) {
+          break;
+        }
+        reap(requests, count, pending);
+      }
+      errno = err;
+      throw system_error("Failed to submit io_uring reads");
+    }
+    to_submit -= std::min<unsigned>(to_submit, ret);
+    reap(requests, count, pending);
+  }
+#else
+  (void)requests;
+  (void)count;
+#endif
+}
+
+/**
+ * Store the results of all completions that are ready
+ *
+ * \returns the number of completions
+ */
+size_t uring::reap(request* requests, size_t count, size_t& pending) {
+#if WITH_IO_URING
+  auto cqes = static_cast<io_uring_cqe*>(m_cqes);
+  size_t reaped{0};
+
+  unsigned head = *m_cq_head;
+  while (head != load_acquire(m_cq_tail)) {
+    const auto& cqe = cqes[head & *m_cq_mask];
+    if (cqe.user_data < count) {
+      requests[cqe.user_data].result = cqe.res;
+      pending--;
+      reaped++;
+    }
+    head++;
+  }
+  store_release(m_cq_head, head);
+  return reaped;
+#else
+  (void)requests;
+  (void)count;
+  (void)pending;
+  return 0;
+#endif
+}
+
+POLYBAR_NS_END
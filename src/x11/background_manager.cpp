@@ -1,34 +1,57 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
 #include "cairo/surface.hpp"
 #include "cairo/context.hpp"
 #include "events/signal.hpp"
 #include "components/config.hpp"
 #include "components/logger.hpp"
+#include "components/reactor.hpp"
 #include "x11/atoms.hpp"
 #include "x11/connection.hpp"
 #include "x11/background_manager.hpp"
 #include "utils/factory.hpp"
+#include "utils/file.hpp"
 #include "utils/math.hpp"
 
 POLYBAR_NS
 
 background_manager& background_manager::make() {
-  return *factory_util::singleton<background_manager>(connection::make(), signal_emitter::make(), logger::make());
+  return *factory_util::singleton<background_manager>(
+      connection::make(), signal_emitter::make(), config::make(), logger::make(), reactor::make());
 }
 
 background_manager::background_manager(
-    connection& conn, signal_emitter& sig, const logger& log)
+    connection& conn, signal_emitter& sig, const config& conf, const logger& log, reactor& reactor)
   : m_connection(conn)
   , m_sig(sig)
-  , m_log(log) {
+  , m_log(log)
+  , m_reactor(reactor) {
+  m_debounce = conf.get("settings", "pseudo-transparency-debounce", m_debounce);
   m_sig.attach(this);
 }
 
 background_manager::~background_manager() {
   m_sig.detach(this);
+  if (m_timer) {
+    m_reactor.remove(*m_timer);
+  }
   free_resources();
 }
 
 std::shared_ptr<bg_slice> background_manager::observe(xcb_rectangle_t rect, xcb_window_t window) {
+  // share the cache of a slice that already covers the area
+  int x{0};
+  int y{0};
+  auto source = find_covering_slice(rect, window, x, y);
+  if (source) {
+    m_log.trace("background_manager: Sharing slice %dx%d+%d+%d", rect.width, rect.height, x, y);
+    return std::shared_ptr<bg_slice>(new bg_slice(m_connection, rect, window, move(source), x, y));
+  }
+
   // allocate a slice
   activate();
   auto slice = std::shared_ptr<bg_slice>(new bg_slice(m_connection, m_log, rect, window, m_visual));
@@ -36,8 +59,8 @@ std::shared_ptr<bg_slice> background_manager::observe(xcb_rectangle_t rect, xcb_
   // make sure that we receive a notification when the background changes
   if(!m_attached) {
     m_connection.ensure_event_mask(m_connection.root(), XCB_EVENT_MASK_PROPERTY_CHANGE);
-    m_connection.flush();
-    m_connection.attach_sink(this, SINK_PRIORITY_SCREEN);
+    m_connection.request_flush();
+    m_connection.attach_sink(this, SINK_PRIORITY_SCREEN, {_XROOTPMAP_ID, _XSETROOT_ID, ESETROOT_PMAP_ID});
     m_attached = true;
   }
 
@@ -47,15 +70,54 @@ std::shared_ptr<bg_slice> background_manager::observe(xcb_rectangle_t rect, xcb_
   }
 
   m_slices.push_back(slice);
-  fetch_root_pixmap();
+  if (m_root_pixmap != XCB_NONE || update_root_pixmap()) {
+    copy_root_pixmap({slice});
+  }
   return slice;
 }
 
+/**
+ * Find an observed slice that contains the given area
+ *
+ * \param x,y Set to the position of the area inside the returned slice
+ */
+std::shared_ptr<bg_slice> background_manager::find_covering_slice(
+    xcb_rectangle_t rect, xcb_window_t window, int& x, int& y) {
+  if (m_slices.empty() || rect.width == 0 || rect.height == 0) {
+    return nullptr;
+  }
+
+  try {
+    auto root = m_connection.screen()->root;
+    auto pos = m_connection.translate_coordinates(window, root, rect.x, rect.y);
+
+    for (auto&& weak : m_slices) {
+      auto slice = weak.lock();
+      if (!slice) {
+        continue;
+      }
+
+      auto origin = m_connection.translate_coordinates(slice->m_window, root, slice->m_rect.x, slice->m_rect.y);
+      x = pos->dst_x - origin->dst_x;
+      y = pos->dst_y - origin->dst_y;
+
+      if (x >= 0 && y >= 0 && x + rect.width <= slice->m_rect.width && y + rect.height <= slice->m_rect.height) {
+        return slice;
+      }
+    }
+  } catch (const exception& err) {
+    m_log.trace("background_manager: Failed to compare slices (%s)", err.what());
+  }
+
+  return nullptr;
+}
+
 void background_manager::deactivate() {
   if(m_attached) {
     m_connection.detach_sink(this, SINK_PRIORITY_SCREEN);
     m_attached = false;
   }
+  m_root_pixmap = XCB_NONE;
   free_resources();
 }
 
@@ -72,54 +134,150 @@ void background_manager::free_resources() {
   m_visual = nullptr;
 }
 
-void background_manager::fetch_root_pixmap() {
-  m_log.trace("background_manager: Fetching pixmap");
+/**
+ * Look up the current root pixmap
+ *
+ * \returns false if there is none that can be used
+ */
+bool background_manager::update_root_pixmap() {
+  m_root_pixmap = XCB_NONE;
 
-  int pixmap_depth;
+  int depth;
   xcb_pixmap_t pixmap;
-  xcb_rectangle_t pixmap_geom;
+  xcb_rectangle_t geom;
 
-  try {
-    if (!m_connection.root_pixmap(&pixmap, &pixmap_depth, &pixmap_geom)) {
-      return m_log.warn("background_manager: Failed to get root pixmap, default to black (is there a wallpaper?)");
-    };
-    m_log.trace("background_manager: root pixmap (%d:%d) %dx%d+%d+%d", pixmap, pixmap_depth,
-                pixmap_geom.width, pixmap_geom.height, pixmap_geom.x, pixmap_geom.y);
-
-    if (pixmap_depth == 1 && pixmap_geom.width == 1 && pixmap_geom.height == 1) {
-      return m_log.err("background_manager: Cannot find root pixmap, try a different tool to set the desktop background");
+  if (!m_connection.root_pixmap(&pixmap, &depth, &geom)) {
+    m_log.warn("background_manager: Failed to get root pixmap, default to black (is there a wallpaper?)");
+    return false;
+  }
+  m_log.trace("background_manager: root pixmap (%d:%d) %dx%d+%d+%d", pixmap, depth, geom.width, geom.height, geom.x,
+      geom.y);
+
+  if (depth == 1 && geom.width == 1 && geom.height == 1) {
+    m_log.err("background_manager: Cannot find root pixmap, try a different tool to set the desktop background");
+    return false;
+  }
+
+  m_root_pixmap = pixmap;
+  m_root_depth = depth;
+  m_root_geom = geom;
+  return true;
+}
+
+/**
+ * Fill the given slices from the root pixmap
+ *
+ * The positions of all slices are requested before waiting for the first
+ * reply and the copies aren't checked, so this takes a single round trip
+ * however many slices there are.
+ */
+void background_manager::copy_root_pixmap(const std::vector<std::shared_ptr<bg_slice>>& slices) {
+  if (m_root_pixmap == XCB_NONE || slices.empty()) {
+    return;
+  }
+
+  auto root = m_connection.screen()->root;
+  std::vector<xcb_translate_coordinates_cookie_t> cookies;
+  cookies.reserve(slices.size());
+  for (auto&& slice : slices) {
+    cookies.emplace_back(
+        xcb_translate_coordinates(m_connection, slice->m_window, root, slice->m_rect.x, slice->m_rect.y));
+  }
+
+  const auto& geom = m_root_geom;
+  for (size_t i = 0; i < slices.size(); i++) {
+    const auto& slice = slices[i];
+    auto translated = xcb_translate_coordinates_reply(m_connection, cookies[i], nullptr);
+    if (translated == nullptr) {
+      m_log.err("background_manager: Failed to get position of slice");
+      continue;
     }
 
-    for (auto it = m_slices.begin(); it != m_slices.end(); ) {
-      auto slice = it->lock();
-      if (!slice) {
-        it = m_slices.erase(it);
-        continue;
-      }
+    auto src_x = math_util::cap(translated->dst_x, geom.x, int16_t(geom.x + geom.width));
+    auto src_y = math_util::cap(translated->dst_y, geom.y, int16_t(geom.y + geom.height));
+    free(translated);
+
+    auto w = math_util::cap(slice->m_rect.width, uint16_t(0), uint16_t(geom.width - (src_x - geom.x)));
+    auto h = math_util::cap(slice->m_rect.height, uint16_t(0), uint16_t(geom.height - (src_y - geom.y)));
+    m_log.trace("background_manager: Copying from root pixmap (%d:%d) %dx%d+%d+%d", m_root_pixmap, m_root_depth, w, h,
+        src_x, src_y);
+    m_connection.copy_area(m_root_pixmap, slice->m_pixmap, slice->m_gcontext, src_x, src_y, 0, 0, w, h);
+  }
 
-      // fill the slice
-      auto translated = m_connection.translate_coordinates(slice->m_window, m_connection.screen()->root, slice->m_rect.x, slice->m_rect.y);
-      auto src_x = math_util::cap(translated->dst_x, pixmap_geom.x, int16_t(pixmap_geom.x + pixmap_geom.width));
-      auto src_y = math_util::cap(translated->dst_y, pixmap_geom.y, int16_t(pixmap_geom.y + pixmap_geom.height));
-      auto w = math_util::cap(slice->m_rect.width, uint16_t(0), uint16_t(pixmap_geom.width - (src_x - pixmap_geom.x)));
-      auto h = math_util::cap(slice->m_rect.height, uint16_t(0), uint16_t(pixmap_geom.height - (src_y - pixmap_geom.y)));
-      m_log.trace("background_manager: Copying from root pixmap (%d:%d) %dx%d+%d+%d", pixmap, pixmap_depth, w, h, src_x, src_y);
-      m_connection.copy_area_checked(pixmap, slice->m_pixmap, slice->m_gcontext, src_x, src_y, 0, 0, w, h);
+  m_connection.request_flush();
+  m_last_copy = std::chrono::steady_clock::now();
+}
 
+/**
+ * Slices that are still observed, deactivates if there are none
+ */
+std::vector<std::shared_ptr<bg_slice>> background_manager::live_slices() {
+  std::vector<std::shared_ptr<bg_slice>> slices;
+  for (auto it = m_slices.begin(); it != m_slices.end();) {
+    auto slice = it->lock();
+    if (!slice) {
+      it = m_slices.erase(it);
+    } else {
+      slices.emplace_back(move(slice));
       it++;
     }
+  }
 
-    // if there are no active slices, deactivate
-    if (m_slices.empty()) {
-      m_log.trace("background_manager: deactivating because there are no slices to observe");
-      deactivate();
+  // if there are no active slices, deactivate
+  if (slices.empty()) {
+    m_log.trace("background_manager: deactivating because there are no slices to observe");
+    deactivate();
+  }
+
+  return slices;
+}
+
+/**
+ * Fill all observed slices from the current root pixmap
+ */
+void background_manager::fetch_root_pixmap() {
+  m_log.trace("background_manager: Fetching pixmap");
+
+  auto slices = live_slices();
+  if (!slices.empty() && update_root_pixmap()) {
+    copy_root_pixmap(slices);
+  }
+}
+
+/**
+ * Fetch the root pixmap and announce the change once the given delay passed
+ */
+void background_manager::schedule_fetch(std::chrono::milliseconds delay) {
+  if (!m_timer) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+      m_log.err("background_manager: Failed to create timer (%s), not delaying", strerror(errno));
+      fetch_root_pixmap();
+      m_sig.emit(signals::ui::update_background());
+      return;
     }
 
-  } catch(const exception& err) {
-    m_log.err("background_manager: Failed to copy slice of root pixmap (%s)", err.what());
-    throw;
+    m_timer = file_util::make_file_descriptor(fd);
+    m_reactor.add(*m_timer, EPOLLIN, [this](int fd, unsigned int) {
+      uint64_t expirations;
+      if (read(fd, &expirations, sizeof(expirations)) == -1) {
+        return;
+      }
+      m_timer_armed = false;
+      if (!m_slices.empty()) {
+        fetch_root_pixmap();
+        m_sig.emit(signals::ui::update_background());
+      }
+    });
   }
 
+  itimerspec spec{};
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count();
+  spec.it_value.tv_sec = ns / 1000000000;
+  // A zero value would disarm the timer
+  spec.it_value.tv_nsec = std::max<long>(ns % 1000000000, 1);
+  timerfd_settime(*m_timer, 0, &spec, nullptr);
+  m_timer_armed = true;
 }
 
 void background_manager::handle(const evt::property_notify& evt) {
@@ -128,10 +286,31 @@ void background_manager::handle(const evt::property_notify& evt) {
     return;
   }
 
-  if (evt->atom == _XROOTPMAP_ID || evt->atom == _XSETROOT_ID || evt->atom == ESETROOT_PMAP_ID) {
-    fetch_root_pixmap();
-    m_sig.emit(signals::ui::update_background());
+  if (evt->atom != _XROOTPMAP_ID && evt->atom != _XSETROOT_ID && evt->atom != ESETROOT_PMAP_ID) {
+    return;
+  }
+
+  // the pending fetch picks up this change as well
+  if (m_timer_armed) {
+    return;
+  }
+
+  // setting the root pixmap changes up to three properties, only the first one needs to be handled
+  auto previous = m_root_pixmap;
+  if (!update_root_pixmap() || m_root_pixmap == previous) {
+    m_log.trace("background_manager: Root pixmap unchanged, skipping");
+    return;
+  }
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_last_copy);
+  if (elapsed < m_debounce) {
+    m_log.trace("background_manager: Delaying root pixmap change by %ims", (m_debounce - elapsed).count());
+    schedule_fetch(m_debounce - elapsed);
+    return;
   }
+
+  copy_root_pixmap(live_slices());
+  m_sig.emit(signals::ui::update_background());
 }
 
 bool background_manager::on(const signals::ui::update_geometry&) {
@@ -158,7 +337,20 @@ bg_slice::bg_slice(connection& conn, const logger& log, xcb_rectangle_t rect, xc
   }
 }
 
+bg_slice::bg_slice(
+    connection& conn, xcb_rectangle_t rect, xcb_window_t window, std::shared_ptr<bg_slice> source, int x, int y)
+  : m_connection(conn)
+  , m_rect(rect)
+  , m_window(window)
+  , m_source(move(source)) {
+  m_surface = make_unique<cairo::sub_surface>(*m_source->m_surface, x, y, m_rect.width, m_rect.height);
+}
+
 bg_slice::~bg_slice() {
+  // drop the reference to the source surface before the source can go away
+  if (m_source) {
+    m_surface.reset();
+  }
   free_resources();
 }
 
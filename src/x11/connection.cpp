@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <iomanip>
+#include <limits>
 
 #include "errors.hpp"
 #include "utils/factory.hpp"
@@ -7,9 +8,22 @@
 #include "utils/string.hpp"
 #include "x11/atoms.hpp"
 #include "x11/connection.hpp"
+#include "x11/ewmh.hpp"
 
 POLYBAR_NS
 
+namespace {
+  /**
+   * Number of open frames of this thread
+   */
+  thread_local unsigned int g_frames{0};
+
+  /**
+   * Whether the current frame of this thread has output to flush
+   */
+  thread_local bool g_flush_requested{false};
+}  // namespace
+
 /**
  * Create instance
  */
@@ -28,6 +42,9 @@ connection::connection(xcb_connection_t* c, int default_screen) : base_type(c, d
     cookies[i] = xcb_intern_atom_unchecked(*this, false, ATOMS[i].len, ATOMS[i].name);
   }
 
+  // The EWMH atoms are interned in the same round trip
+  ewmh_util::request_atoms(*this);
+
   for (size_t i = 0; i < cookies.size(); i++) {
     if ((reply = xcb_intern_atom_reply(*this, cookies[i], nullptr)) != nullptr) {
       *ATOMS[i].atom = reply->atom;
@@ -36,6 +53,8 @@ connection::connection(xcb_connection_t* c, int default_screen) : base_type(c, d
     free(reply);
   }
 
+  ewmh_util::initialize();
+
 // }}}
 // Query for X extensions {{{
 #if WITH_XRANDR
@@ -54,6 +73,31 @@ connection::~connection() {
   disconnect();
 }
 
+connection::frame::frame(connection& conn) : m_connection(conn) {
+  g_frames++;
+}
+
+connection::frame::~frame() {
+  if (--g_frames == 0 && g_flush_requested) {
+    g_flush_requested = false;
+    m_connection.flush();
+  }
+}
+
+/**
+ * Flush the output buffer, at the end of the current frame if one is open
+ *
+ * Paths that wait for an answer without a reply, or that are latency
+ * critical, have to call flush() instead.
+ */
+void connection::request_flush() {
+  if (g_frames > 0) {
+    g_flush_requested = true;
+  } else {
+    flush();
+  }
+}
+
 void connection::pack_values(unsigned int mask, const unsigned int* src, unsigned int* dest) {
   for (; mask; mask >>= 1, src++) {
     if (mask & 1) {
@@ -95,6 +139,41 @@ void connection::ensure_event_mask(xcb_window_t win, unsigned int event) {
   auto attributes = get_window_attributes(win);
   attributes->your_event_mask = attributes->your_event_mask | event;
   change_window_attributes(win, XCB_CW_EVENT_MASK, &attributes->your_event_mask);
+
+  if (event & XCB_EVENT_MASK_PROPERTY_CHANGE) {
+    watch_properties(win);
+  }
+}
+
+/**
+ * Add given event to the event mask of all windows unless already added
+ *
+ * The current masks are queried in one round trip, windows that no longer
+ * exist are skipped.
+ */
+void connection::ensure_event_mask(const vector<xcb_window_t>& windows, unsigned int event) {
+  vector<xcb_get_window_attributes_cookie_t> cookies(windows.size());
+
+  for (size_t i = 0; i < cookies.size(); i++) {
+    cookies[i] = xcb_get_window_attributes(*this, windows[i]);
+  }
+
+  for (size_t i = 0; i < cookies.size(); i++) {
+    xcb_generic_error_t* error{nullptr};
+    xcb_get_window_attributes_reply_t* reply{xcb_get_window_attributes_reply(*this, cookies[i], &error)};
+
+    if (reply != nullptr) {
+      unsigned int mask{reply->your_event_mask | event};
+      xcb_change_window_attributes(*this, windows[i], XCB_CW_EVENT_MASK, &mask);
+
+      if (event & XCB_EVENT_MASK_PROPERTY_CHANGE) {
+        watch_properties(windows[i]);
+      }
+    }
+
+    free(reply);
+    free(error);
+  }
 }
 
 /**
@@ -102,7 +181,183 @@ void connection::ensure_event_mask(xcb_window_t win, unsigned int event) {
  */
 void connection::clear_event_mask(xcb_window_t win) {
   unsigned int mask{XCB_EVENT_MASK_NO_EVENT};
-  change_window_attributes(win, XCB_CW_EVENT_MASK, &mask);
+  xcb_change_window_attributes(*this, win, XCB_CW_EVENT_MASK, &mask);
+
+  // Changes of the window are no longer reported, so none of its properties can stay cached
+  std::lock_guard<std::mutex> guard(m_property_lock);
+  m_property_windows.erase(win);
+  auto first = m_properties.lower_bound(std::make_tuple(win, xcb_atom_t{0}, xcb_atom_t{0}));
+  auto last = first;
+  while (last != m_properties.end() && std::get<0>(last->first) == win) {
+    ++last;
+  }
+  m_properties.erase(first, last);
+  m_property_generation++;
+}
+
+/**
+ * Get a property of the window, the value is shared with all callers that ask
+ * for the same property until it changes
+ *
+ * \returns nullptr if the window doesn't exist
+ */
+connection::property_t connection::cached_property(xcb_window_t win, xcb_atom_t atom, xcb_atom_t type) const {
+  return cached_properties({win}, atom, type).front();
+}
+
+/**
+ * Get the same property of all given windows
+ *
+ * Properties that are not cached are requested in one round trip.
+ */
+vector<connection::property_t> connection::cached_properties(
+    const vector<xcb_window_t>& windows, xcb_atom_t atom, xcb_atom_t type) const {
+  vector<property_t> properties(windows.size());
+  vector<xcb_get_property_cookie_t> cookies(windows.size());
+  size_t generation;
+
+  {
+    std::lock_guard<std::mutex> guard(m_property_lock);
+    generation = m_property_generation;
+    for (size_t i = 0; i < windows.size(); i++) {
+      auto it = m_properties.find(std::make_tuple(windows[i], atom, type));
+      if (it != m_properties.end()) {
+        properties[i] = it->second;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < windows.size(); i++) {
+    if (!properties[i]) {
+      cookies[i] = xcb_get_property(*this, false, windows[i], atom, type, 0, std::numeric_limits<uint32_t>::max());
+    }
+  }
+
+  for (size_t i = 0; i < windows.size(); i++) {
+    if (properties[i]) {
+      continue;
+    }
+
+    xcb_generic_error_t* error{nullptr};
+    xcb_get_property_reply_t* reply{xcb_get_property_reply(*this, cookies[i], &error)};
+    free(error);
+
+    if (reply == nullptr) {
+      continue;
+    }
+
+    properties[i] = property_t{reply, free};
+
+    std::lock_guard<std::mutex> guard(m_property_lock);
+    if (generation == m_property_generation && m_property_windows.count(windows[i])) {
+      if (m_properties.size() >= MAX_CACHED_PROPERTIES) {
+        m_properties.clear();
+      }
+      m_properties.emplace(std::make_tuple(windows[i], atom, type), properties[i]);
+    }
+  }
+
+  return properties;
+}
+
+/**
+ * Cache the properties of the window from now on
+ */
+void connection::watch_properties(xcb_window_t win) {
+  std::lock_guard<std::mutex> guard(m_property_lock);
+  // Windows are never removed once they are destroyed, forgetting them only means their properties aren't cached
+  if (m_property_windows.size() >= MAX_CACHED_PROPERTIES) {
+    m_property_windows.clear();
+    m_property_windows.emplace(root());
+  }
+  m_property_windows.emplace(win);
+}
+
+/**
+ * Replace the property atoms handled by the sink
+ */
+void connection::watch_atoms(const void* sink, vector<xcb_atom_t> atoms) {
+  std::lock_guard<std::mutex> guard(m_atoms_lock);
+
+  auto it = m_sink_atoms.find(sink);
+  if (it != m_sink_atoms.end()) {
+    for (auto atom : it->second) {
+      if (--m_watched_atoms[atom] == 0) {
+        m_watched_atoms.erase(atom);
+      }
+    }
+    m_sink_atoms.erase(it);
+  }
+
+  std::sort(atoms.begin(), atoms.end());
+  atoms.erase(std::unique(atoms.begin(), atoms.end()), atoms.end());
+  if (atoms.empty()) {
+    return;
+  }
+
+  for (auto atom : atoms) {
+    m_watched_atoms[atom]++;
+  }
+  m_sink_atoms.emplace(sink, move(atoms));
+}
+
+/**
+ * Check if any sink handles the event
+ *
+ * Only PropertyNotify events are filtered, there are too many of them for
+ * properties nobody looks at.
+ */
+bool connection::wanted(const xcb_generic_event_t& evt) const {
+  if ((evt.response_type & ~0x80) != XCB_PROPERTY_NOTIFY) {
+    return true;
+  }
+
+  const auto& notify = reinterpret_cast<const xcb_property_notify_event_t&>(evt);
+  std::lock_guard<std::mutex> guard(m_atoms_lock);
+  return m_watched_atoms.find(notify.atom) != m_watched_atoms.end();
+}
+
+/**
+ * Drop the cached values of a property that changed
+ *
+ * All properties of a window are dropped once it is unmapped or destroyed,
+ * destroyed windows are also no longer watched because their id can be
+ * reused for a window we don't get PropertyNotify events for.
+ */
+void connection::invalidate_properties(const xcb_generic_event_t& evt) const {
+  xcb_window_t win;
+  bool whole_window{true};
+  xcb_atom_t atom{XCB_NONE};
+
+  switch (evt.response_type & ~0x80) {
+    case XCB_PROPERTY_NOTIFY:
+      win = reinterpret_cast<const xcb_property_notify_event_t&>(evt).window;
+      atom = reinterpret_cast<const xcb_property_notify_event_t&>(evt).atom;
+      whole_window = false;
+      break;
+    case XCB_UNMAP_NOTIFY:
+      win = reinterpret_cast<const xcb_unmap_notify_event_t&>(evt).window;
+      break;
+    case XCB_DESTROY_NOTIFY:
+      win = reinterpret_cast<const xcb_destroy_notify_event_t&>(evt).window;
+      break;
+    default:
+      return;
+  }
+
+  std::lock_guard<std::mutex> guard(m_property_lock);
+  auto first = m_properties.lower_bound(std::make_tuple(win, atom, xcb_atom_t{0}));
+  auto last = first;
+  while (last != m_properties.end() && std::get<0>(last->first) == win &&
+         (whole_window || std::get<1>(last->first) == atom)) {
+    ++last;
+  }
+  m_properties.erase(first, last);
+  m_property_generation++;
+
+  if ((evt.response_type & ~0x80) == XCB_DESTROY_NOTIFY && win != root()) {
+    m_property_windows.erase(win);
+  }
 }
 
 /**
@@ -132,7 +387,7 @@ shared_ptr<xcb_client_message_event_t> connection::make_client_message(xcb_atom_
 void connection::send_client_message(const shared_ptr<xcb_client_message_event_t>& message, xcb_window_t target,
     unsigned int event_mask, bool propagate) const {
   send_event(propagate, target, event_mask, reinterpret_cast<const char*>(&*message));
-  flush();
+  request_flush();
 }
 
 /**
@@ -236,11 +491,28 @@ string connection::error_str(int error_code) {
   }
 }
 
+/**
+ * Next queued event, nullptr if there is none
+ */
+connection::event_ptr connection::poll_event() const {
+  return event_ptr{xcb_poll_for_event(*this)};
+}
+
 /**
  * Dispatch event through the registry
+ *
+ * The registry needs a shared pointer, it is only created for events that
+ * have a sink and its control block is taken from a pool. Property changes
+ * nobody watches therefore don't allocate anything besides the event itself.
  */
-void connection::dispatch_event(const shared_ptr<xcb_generic_event_t>& evt) const {
-  m_registry.dispatch(evt);
+void connection::dispatch_event(event_ptr&& evt) const {
+  // Dropped before the handlers run, so that they already get the new values
+  invalidate_properties(*evt);
+
+  if (wanted(*evt)) {
+    m_registry.dispatch(shared_ptr<xcb_generic_event_t>(
+        evt.release(), memory_util::free_deleter{}, memory_util::pool_allocator<xcb_generic_event_t>{}));
+  }
 }
 
 POLYBAR_NS_END
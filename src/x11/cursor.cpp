@@ -1,26 +1,65 @@
 #include "x11/cursor.hpp"
 
+#include <mutex>
+
 POLYBAR_NS
 
 namespace cursor_util {
+  namespace {
+    /**
+     * Cursor context of the connection and the cursors loaded with it
+     *
+     * Loading a cursor looks it up in the cursor theme on disk, so every
+     * cursor is only loaded the first time it is set.
+     */
+    struct cursor_cache {
+      std::mutex lock;
+      xcb_connection_t* connection{nullptr};
+      xcb_cursor_context_t* context{nullptr};
+      std::map<string, xcb_cursor_t> loaded;
+    };
+
+    cursor_cache& cache() {
+      static cursor_cache instance;
+      return instance;
+    }
+  }  // namespace
+
   bool valid(string name) {
     return (cursors.find(name) != cursors.end());
   }
 
   bool set_cursor(xcb_connection_t *c, xcb_screen_t *screen, xcb_window_t w, string name) {
-    xcb_cursor_t cursor = XCB_CURSOR_NONE;
-    xcb_cursor_context_t *ctx;
+    auto& cached = cache();
+    std::lock_guard<std::mutex> guard(cached.lock);
 
-    if (xcb_cursor_context_new(c, screen, &ctx) < 0) {
+    if (cached.connection != c) {
+      // The cursors belong to the connection they were created on
+      if (cached.context != nullptr) {
+        xcb_cursor_context_free(cached.context);
+        cached.context = nullptr;
+      }
+      cached.loaded.clear();
+      cached.connection = c;
+    }
+
+    if (cached.context == nullptr && xcb_cursor_context_new(c, screen, &cached.context) < 0) {
+      cached.context = nullptr;
       return false;
     }
-    for (auto&& cursor_name : cursors.at(name)) {
-      cursor = xcb_cursor_load_cursor(ctx, cursor_name.c_str());
-      if (cursor != XCB_CURSOR_NONE)
-        break;
+
+    auto it = cached.loaded.find(name);
+    if (it == cached.loaded.end()) {
+      xcb_cursor_t cursor = XCB_CURSOR_NONE;
+      for (auto&& cursor_name : cursors.at(name)) {
+        cursor = xcb_cursor_load_cursor(cached.context, cursor_name.c_str());
+        if (cursor != XCB_CURSOR_NONE)
+          break;
+      }
+      it = cached.loaded.emplace(name, cursor).first;
     }
-    xcb_change_window_attributes(c, w, XCB_CW_CURSOR, &cursor);
-    xcb_cursor_context_free(ctx);
+
+    xcb_change_window_attributes(c, w, XCB_CW_CURSOR, &it->second);
     return true;
   }
 }
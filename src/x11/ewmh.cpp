@@ -1,5 +1,10 @@
 #include <unistd.h>
 
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+
 #include "components/types.hpp"
 #include "utils/string.hpp"
 #include "x11/atoms.hpp"
@@ -9,47 +14,117 @@
 POLYBAR_NS
 
 namespace ewmh_util {
+  namespace {
+    std::mutex g_supported_lock;
+    // The reply the set was built from, the cached reply is replaced once the property changes
+    connection::property_t g_supported_reply;
+    std::unordered_set<xcb_atom_t> g_supported;
+
+    /**
+     * Parse a cached reply with one of the xcb_ewmh parsers that take ownership of the reply
+     */
+    template <typename Parser>
+    bool parse_copy(const connection::property_t& reply, Parser&& parse) {
+      if (!reply) {
+        return false;
+      }
+
+      size_t size{sizeof(xcb_get_property_reply_t) + reply->length * 4};
+      auto* copy = static_cast<xcb_get_property_reply_t*>(malloc(size));
+      memcpy(copy, reply.get(), size);
+      if (!parse(copy)) {
+        free(copy);
+        return false;
+      }
+      return true;
+    }
+
+    connection::property_t get_root_property(
+        xcb_ewmh_connection_t* conn, int screen, xcb_atom_t atom, xcb_atom_t type) {
+      return connection::make().cached_property(conn->screens[screen]->root, atom, type);
+    }
+
+    unsigned int get_root_cardinal(xcb_ewmh_connection_t* conn, int screen, xcb_atom_t atom) {
+      unsigned int value = XCB_NONE;
+      auto reply = get_root_property(conn, screen, atom, XCB_ATOM_CARDINAL);
+      if (reply) {
+        xcb_ewmh_get_cardinal_from_reply(&value, reply.get());
+      }
+      return value;
+    }
+
+    string get_utf8_property(xcb_ewmh_connection_t* conn, xcb_window_t win, xcb_atom_t atom) {
+      xcb_ewmh_get_utf8_strings_reply_t utf8_reply{};
+      auto reply = connection::make().cached_property(win, atom, conn->UTF8_STRING);
+      if (parse_copy(reply, [&](xcb_get_property_reply_t* r) {
+            return xcb_ewmh_get_utf8_strings_from_reply(conn, &utf8_reply, r);
+          })) {
+        return get_reply_string(&utf8_reply);
+      }
+      return "";
+    }
+  }  // namespace
+
   ewmh_connection_t g_connection{nullptr};
-  ewmh_connection_t initialize() {
+  xcb_intern_atom_cookie_t* g_cookies{nullptr};
+
+  /**
+   * Send the requests for the EWMH atoms, their replies are read by initialize()
+   *
+   * Called while the connection interns its own atoms, so that all of them
+   * are answered in the same round trip.
+   */
+  void request_atoms(xcb_connection_t* conn) {
     if (!g_connection) {
       g_connection = memory_util::make_malloc_ptr<xcb_ewmh_connection_t>(
           [=](xcb_ewmh_connection_t* c) { xcb_ewmh_connection_wipe(c); });
-      xcb_ewmh_init_atoms_replies(&*g_connection, xcb_ewmh_init_atoms(connection::make(), &*g_connection), nullptr);
+      g_cookies = xcb_ewmh_init_atoms(conn, &*g_connection);
+    }
+  }
+
+  ewmh_connection_t initialize() {
+    if (!g_connection) {
+      request_atoms(connection::make());
+    }
+    if (g_cookies != nullptr) {
+      // Frees the cookies
+      xcb_ewmh_init_atoms_replies(&*g_connection, g_cookies, nullptr);
+      g_cookies = nullptr;
     }
     return g_connection;
   }
 
+  /**
+   * Check if the window manager lists the atom in _NET_SUPPORTED
+   *
+   * The list is kept in a set, which is only rebuilt once the cached
+   * property was dropped because the window manager changed it.
+   */
   bool supports(xcb_atom_t atom, int screen) {
     auto conn = initialize().get();
-    xcb_ewmh_get_atoms_reply_t reply{};
-    if (xcb_ewmh_get_supported_reply(conn, xcb_ewmh_get_supported(conn, screen), &reply, nullptr)) {
-      for (size_t n = 0; n < reply.atoms_len; n++) {
-        if (reply.atoms[n] == atom) {
-          xcb_ewmh_get_atoms_reply_wipe(&reply);
-          return true;
-        }
+    auto reply = get_root_property(conn, screen, conn->_NET_SUPPORTED, XCB_ATOM_ATOM);
+
+    std::lock_guard<std::mutex> guard(g_supported_lock);
+    if (reply != g_supported_reply) {
+      g_supported.clear();
+      if (reply) {
+        auto atoms = static_cast<const xcb_atom_t*>(xcb_get_property_value(reply.get()));
+        auto count = xcb_get_property_value_length(reply.get()) / sizeof(xcb_atom_t);
+        g_supported.insert(atoms, atoms + count);
       }
-      xcb_ewmh_get_atoms_reply_wipe(&reply);
+      g_supported_reply = reply;
     }
-    return false;
+    return g_supported.count(atom) > 0;
   }
 
   string get_wm_name(xcb_window_t win) {
     auto conn = initialize().get();
-    xcb_ewmh_get_utf8_strings_reply_t utf8_reply{};
-    if (xcb_ewmh_get_wm_name_reply(conn, xcb_ewmh_get_wm_name(conn, win), &utf8_reply, nullptr)) {
-      return get_reply_string(&utf8_reply);
-    }
-    return "";
+    return get_utf8_property(conn, win, conn->_NET_WM_NAME);
   }
 
   string get_visible_name(xcb_window_t win) {
     auto conn = initialize().get();
-    xcb_ewmh_get_utf8_strings_reply_t utf8_reply{};
-    if (xcb_ewmh_get_wm_visible_name_reply(conn, xcb_ewmh_get_wm_visible_name(conn, win), &utf8_reply, nullptr)) {
-      return get_reply_string(&utf8_reply);
-    }
-    return "";
+    return get_utf8_property(conn, win, conn->_NET_WM_VISIBLE_NAME);
   }
 
   string get_icon_name(xcb_window_t win) {
@@ -72,44 +147,52 @@ namespace ewmh_util {
 
   unsigned int get_current_desktop(int screen) {
     auto conn = initialize().get();
-    unsigned int desktop = XCB_NONE;
-    xcb_ewmh_get_current_desktop_reply(conn, xcb_ewmh_get_current_desktop(conn, screen), &desktop, nullptr);
-    return desktop;
+    return get_root_cardinal(conn, screen, conn->_NET_CURRENT_DESKTOP);
   }
 
   unsigned int get_number_of_desktops(int screen) {
     auto conn = initialize().get();
-    unsigned int desktops = XCB_NONE;
-    xcb_ewmh_get_number_of_desktops_reply(conn, xcb_ewmh_get_number_of_desktops(conn, screen), &desktops, nullptr);
-    return desktops;
+    return get_root_cardinal(conn, screen, conn->_NET_NUMBER_OF_DESKTOPS);
   }
 
   vector<position> get_desktop_viewports(int screen) {
     auto conn = initialize().get();
     vector<position> viewports;
     xcb_ewmh_get_desktop_viewport_reply_t reply{};
-    if (xcb_ewmh_get_desktop_viewport_reply(conn, xcb_ewmh_get_desktop_viewport(conn, screen), &reply, nullptr)) {
+    auto property = get_root_property(conn, screen, conn->_NET_DESKTOP_VIEWPORT, XCB_ATOM_CARDINAL);
+    if (parse_copy(property, [&](xcb_get_property_reply_t* r) {
+          return xcb_ewmh_get_desktop_viewport_from_reply(&reply, r);
+        })) {
       for (size_t n = 0; n < reply.desktop_viewport_len; n++) {
         viewports.emplace_back(position{
             static_cast<short int>(reply.desktop_viewport[n].x), static_cast<short int>(reply.desktop_viewport[n].y)});
       }
+      xcb_ewmh_get_desktop_viewport_reply_wipe(&reply);
     }
     return viewports;
   }
 
   vector<string> get_desktop_names(int screen) {
     auto conn = initialize().get();
-    xcb_ewmh_get_utf8_strings_reply_t reply{};
-    if (xcb_ewmh_get_desktop_names_reply(conn, xcb_ewmh_get_desktop_names(conn, screen), &reply, nullptr)) {
-      return string_util::split(string(reply.strings, reply.strings_len), '\0');
-    }
-    return {};
+    return string_util::split(get_utf8_property(conn, conn->screens[screen]->root, conn->_NET_DESKTOP_NAMES), '\0');
+  }
+
+  /**
+   * Names and number of desktops
+   *
+   * Both are cached, so after a change only the property that changed is requested again.
+   */
+  desktop_list get_desktop_list(int screen) {
+    return desktop_list{get_desktop_names(screen), get_number_of_desktops(screen)};
   }
 
   xcb_window_t get_active_window(int screen) {
     auto conn = initialize().get();
-    unsigned int win = XCB_NONE;
-    xcb_ewmh_get_active_window_reply(conn, xcb_ewmh_get_active_window(conn, screen), &win, nullptr);
+    xcb_window_t win = XCB_NONE;
+    auto reply = get_root_property(conn, screen, conn->_NET_ACTIVE_WINDOW, XCB_ATOM_WINDOW);
+    if (reply) {
+      xcb_ewmh_get_window_from_reply(&win, reply.get());
+    }
     return win;
   }
 
@@ -120,10 +203,25 @@ namespace ewmh_util {
   }
 
   unsigned int get_desktop_from_window(xcb_window_t window) {
+    return get_desktops_from_windows({window}).front();
+  }
+
+  /**
+   * Desktops of all given windows, XCB_NONE for windows without desktop
+   *
+   * The ones that aren't cached are requested in one round trip.
+   */
+  vector<unsigned int> get_desktops_from_windows(const vector<xcb_window_t>& windows) {
     auto conn = initialize().get();
-    unsigned int desktop = XCB_NONE;
-    xcb_ewmh_get_wm_desktop_reply(conn, xcb_ewmh_get_wm_desktop(conn, window), &desktop, nullptr);
-    return desktop;
+    auto replies = connection::make().cached_properties(windows, conn->_NET_WM_DESKTOP, XCB_ATOM_CARDINAL);
+
+    vector<unsigned int> desktops(windows.size(), XCB_NONE);
+    for (size_t i = 0; i < replies.size(); i++) {
+      if (replies[i]) {
+        xcb_ewmh_get_cardinal_from_reply(&desktops[i], replies[i].get());
+      }
+    }
+    return desktops;
   }
 
   void set_wm_window_type(xcb_window_t win, vector<xcb_atom_t> types) {
@@ -174,11 +272,14 @@ namespace ewmh_util {
 
   vector<xcb_window_t> get_client_list(int screen) {
     auto conn = initialize().get();
-    xcb_ewmh_get_windows_reply_t reply;
-    if (xcb_ewmh_get_client_list_reply(conn, xcb_ewmh_get_client_list(conn, screen), &reply, nullptr)) {
-      return {reply.windows, reply.windows + reply.windows_len};
+    vector<xcb_window_t> windows;
+    xcb_ewmh_get_windows_reply_t reply{};
+    auto property = get_root_property(conn, screen, conn->_NET_CLIENT_LIST, XCB_ATOM_WINDOW);
+    if (parse_copy(property, [&](xcb_get_property_reply_t* r) { return xcb_ewmh_get_windows_from_reply(&reply, r); })) {
+      windows.assign(reply.windows, reply.windows + reply.windows_len);
+      xcb_ewmh_get_windows_reply_wipe(&reply);
     }
-    return {};
+    return windows;
   }
 }
 
@@ -0,0 +1,121 @@
+#include "x11/extensions/present.hpp"
+
+#include "errors.hpp"
+#include "x11/connection.hpp"
+
+POLYBAR_NS
+
+namespace present_util {
+  /**
+   * Query for the Present extension
+   *
+   * Like MIT-SHM this is optional, so this doesn't throw
+   */
+  bool query_extension(connection& conn) {
+    auto reply = xcb_present_query_version_reply(
+        conn, xcb_present_query_version(conn, XCB_PRESENT_MAJOR_VERSION, XCB_PRESENT_MINOR_VERSION), nullptr);
+    bool present = reply != nullptr;
+    free(reply);
+    return present;
+  }
+}  // namespace present_util
+
+/**
+ * Allocate both pixmaps and ask for IdleNotify events on the window
+ *
+ * The events are delivered to a queue of their own, so that they don't go
+ * through the regular event loop.
+ */
+present_buffers::present_buffers(connection& conn, xcb_window_t window, uint8_t depth, uint16_t width, uint16_t height)
+    : m_connection(conn), m_window(window) {
+  for (auto& pixmap : m_pixmaps) {
+    pixmap = m_connection.generate_id();
+    m_connection.create_pixmap(depth, pixmap, m_window, width, height);
+  }
+
+  m_eid = m_connection.generate_id();
+  auto err = xcb_request_check(
+      m_connection, xcb_present_select_input_checked(m_connection, m_eid, m_window, XCB_PRESENT_EVENT_MASK_IDLE_NOTIFY));
+
+  if (err != nullptr) {
+    free(err);
+    for (auto&& pixmap : m_pixmaps) {
+      m_connection.free_pixmap(pixmap);
+    }
+    throw application_error("Failed to select Present events");
+  }
+
+  m_events = xcb_register_for_special_xge(m_connection, &xcb_present_id, m_eid, nullptr);
+}
+
+present_buffers::~present_buffers() {
+  xcb_present_select_input(m_connection, m_eid, m_window, XCB_PRESENT_EVENT_MASK_NO_EVENT);
+  xcb_unregister_for_special_event(m_connection, m_events);
+  for (auto&& pixmap : m_pixmaps) {
+    m_connection.free_pixmap(pixmap);
+  }
+  m_connection.flush();
+}
+
+/**
+ * Pixmap to draw the next frame into
+ *
+ * Never the pixmap that is shown, blocks until the server no longer reads
+ * from the returned one.
+ */
+xcb_pixmap_t present_buffers::acquire() {
+  m_current = 1 - m_shown;
+  process_events(false);
+  while (m_busy[m_current] > 0) {
+    process_events(true);
+  }
+  return m_pixmaps[m_current];
+}
+
+/**
+ * Show the pixmap that was drawn last, presenting it again is allowed (e.g.
+ * when the window is exposed)
+ */
+void present_buffers::present() {
+  xcb_present_pixmap(m_connection, m_window, m_pixmaps[m_current], ++m_serial, XCB_NONE, XCB_NONE, 0, 0, XCB_NONE,
+      XCB_NONE, XCB_NONE, XCB_PRESENT_OPTION_NONE, 0, 0, 0, 0, nullptr);
+  m_busy[m_current]++;
+  m_shown = m_current;
+}
+
+/**
+ * Handle the received IdleNotify events
+ *
+ * \param wait Block until at least one event was received
+ */
+void present_buffers::process_events(bool wait) {
+  xcb_generic_event_t* evt{nullptr};
+
+  if (wait) {
+    m_connection.flush();
+    evt = xcb_wait_for_special_event(m_connection, m_events);
+    if (evt == nullptr) {
+      // The connection is broken, nothing will be read from the pixmaps anymore
+      m_busy[0] = m_busy[1] = 0;
+      return;
+    }
+  } else {
+    evt = xcb_poll_for_special_event(m_connection, m_events);
+  }
+
+  while (evt != nullptr) {
+    auto generic = reinterpret_cast<xcb_present_generic_event_t*>(evt);
+    if (generic->evtype == XCB_PRESENT_EVENT_IDLE_NOTIFY) {
+      auto idle = reinterpret_cast<xcb_present_idle_notify_event_t*>(evt);
+      for (size_t i = 0; i < 2; i++) {
+        if (idle->pixmap == m_pixmaps[i] && m_busy[i] > 0) {
+          m_busy[i]--;
+        }
+      }
+    }
+    free(evt);
+    evt = xcb_poll_for_special_event(m_connection, m_events);
+  }
+}
+
+POLYBAR_NS_END
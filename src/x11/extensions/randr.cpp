@@ -1,11 +1,13 @@
 #include "x11/extensions/randr.hpp"
 
 #include <algorithm>
+#include <mutex>
 #include <utility>
 
 #include "components/types.hpp"
 #include "errors.hpp"
 #include "settings.hpp"
+#include "utils/memory.hpp"
 #include "utils/string.hpp"
 #include "x11/atoms.hpp"
 #include "x11/connection.hpp"
@@ -102,62 +104,178 @@ namespace randr_util {
     return mon;
   }
 
+  namespace {
+    /**
+     * Output as reported by the server, kept until the RandR configuration changes
+     */
+    struct output_info {
+      xcb_randr_output_t output;
+      string name;
+      bool connected;
+      bool active;
+      short int x{0};
+      short int y{0};
+      unsigned short int w{0U};
+      unsigned short int h{0U};
+    };
+
+    struct output_cache {
+      xcb_timestamp_t timestamp{XCB_CURRENT_TIME};
+      xcb_timestamp_t config_timestamp{XCB_CURRENT_TIME};
+      bool valid{false};
+      vector<output_info> outputs;
+    };
+
+    std::mutex g_cache_lock;
+    output_cache g_output_cache;
+
+    template <typename T>
+    malloc_ptr_t<T> own(T* reply) {
+      return malloc_ptr_t<T>(reply, free);
+    }
+
+    /**
+     * Query all outputs of the screen and the CRTCs they are shown on
+     *
+     * The requests for all outputs are sent before waiting for the first
+     * reply, then the same for the CRTCs.
+     */
+    vector<output_info> query_outputs(connection& conn, const xcb_randr_get_screen_resources_current_reply_t* res) {
+      auto outputs = xcb_randr_get_screen_resources_current_outputs(res);
+      auto count = xcb_randr_get_screen_resources_current_outputs_length(res);
+
+      vector<xcb_randr_get_output_info_cookie_t> info_cookies;
+      info_cookies.reserve(count);
+      for (int i = 0; i < count; i++) {
+        info_cookies.emplace_back(xcb_randr_get_output_info(conn, outputs[i], res->config_timestamp));
+      }
+
+      vector<output_info> result;
+      vector<xcb_randr_get_crtc_info_cookie_t> crtc_cookies;
+      for (int i = 0; i < count; i++) {
+        auto info = own(xcb_randr_get_output_info_reply(conn, info_cookies[i], nullptr));
+        if (!info) {
+          continue;
+        }
+
+        auto name = reinterpret_cast<const char*>(xcb_randr_get_output_info_name(info.get()));
+        auto length = xcb_randr_get_output_info_name_length(info.get());
+        bool active{info->crtc != XCB_NONE};
+        result.emplace_back(output_info{outputs[i], string{name, static_cast<size_t>(length)},
+            info->connection == XCB_RANDR_CONNECTION_CONNECTED, active});
+
+        if (active) {
+          crtc_cookies.emplace_back(xcb_randr_get_crtc_info(conn, info->crtc, res->config_timestamp));
+        }
+      }
+
+      auto cookie = crtc_cookies.begin();
+      for (auto&& output : result) {
+        if (!output.active) {
+          continue;
+        }
+
+        auto crtc = own(xcb_randr_get_crtc_info_reply(conn, *cookie++, nullptr));
+        if (!crtc) {
+          output.active = false;
+          continue;
+        }
+
+        output.x = crtc->x;
+        output.y = crtc->y;
+        output.w = crtc->width;
+        output.h = crtc->height;
+      }
+
+      return result;
+    }
+  }  // namespace
+
   /**
    * Create a list of all available randr outputs
+   *
+   * Independent requests are sent before waiting for any of their replies.
+   * The outputs are only queried again once the server reports a different
+   * output configuration, the screen resources are read without probing the
+   * hardware for new outputs.
    */
   vector<monitor_t> get_monitors(connection& conn, xcb_window_t root, bool connected_only, bool purge_clones) {
     vector<monitor_t> monitors;
 
+    auto primary_cookie = xcb_randr_get_output_primary(conn, root);
+    auto resources_cookie = xcb_randr_get_screen_resources_current(conn, root);
+
 #if WITH_XRANDR_MONITORS
     if (check_monitor_support()) {
-      for (auto&& mon : conn.get_monitors(root, true).monitors()) {
-        try {
-          auto name = conn.get_atom_name(mon.name).name();
-          monitors.emplace_back(make_monitor(XCB_NONE, move(name), mon.width, mon.height, mon.x, mon.y, mon.primary));
-        } catch (const exception&) {
-          // silently ignore output
+      auto reply = own(xcb_randr_get_monitors_reply(conn, xcb_randr_get_monitors(conn, root, true), nullptr));
+      if (reply) {
+        vector<pair<xcb_randr_monitor_info_t, xcb_get_atom_name_cookie_t>> infos;
+        for (auto it = xcb_randr_get_monitors_monitors_iterator(reply.get()); it.rem; xcb_randr_monitor_info_next(&it)) {
+          infos.emplace_back(*it.data, xcb_get_atom_name(conn, it.data->name));
+        }
+
+        for (auto&& info : infos) {
+          auto name = own(xcb_get_atom_name_reply(conn, info.second, nullptr));
+          if (!name) {
+            // silently ignore output
+            continue;
+          }
+
+          const auto& mon = info.first;
+          string monitor_name{xcb_get_atom_name_name(name.get()),
+              static_cast<size_t>(xcb_get_atom_name_name_length(name.get()))};
+          monitors.emplace_back(
+              make_monitor(XCB_NONE, move(monitor_name), mon.width, mon.height, mon.x, mon.y, mon.primary));
         }
       }
     }
 #endif
-    auto primary_output = conn.get_output_primary(root).output();
-    string primary_name{};
 
-    if (primary_output != XCB_NONE) {
-      auto primary_info = conn.get_output_info(primary_output);
-      auto name_iter = primary_info.name();
-      primary_name = {name_iter.begin(), name_iter.end()};
+    xcb_randr_output_t primary_output{XCB_NONE};
+    auto primary = own(xcb_randr_get_output_primary_reply(conn, primary_cookie, nullptr));
+    if (primary) {
+      primary_output = primary->output;
     }
 
-    for (auto&& output : conn.get_screen_resources(root).outputs()) {
-      try {
-        auto info = conn.get_output_info(output);
-        if (info->crtc == XCB_NONE) {
-          continue;
-        } else if (connected_only && info->connection != XCB_RANDR_CONNECTION_CONNECTED) {
-          continue;
-        }
+    auto resources = own(xcb_randr_get_screen_resources_current_reply(conn, resources_cookie, nullptr));
+    if (!resources) {
+      throw application_error("Failed to query RandR screen resources");
+    }
+
+    vector<output_info> outputs;
+    {
+      std::lock_guard<std::mutex> guard(g_cache_lock);
+      auto& cache = g_output_cache;
+      if (!cache.valid || cache.timestamp != resources->timestamp ||
+          cache.config_timestamp != resources->config_timestamp) {
+        cache.outputs = query_outputs(conn, resources.get());
+        cache.timestamp = resources->timestamp;
+        cache.config_timestamp = resources->config_timestamp;
+        cache.valid = true;
+      }
+      outputs = cache.outputs;
+    }
 
-        auto name_iter = info.name();
-        string name{name_iter.begin(), name_iter.end()};
+    for (auto&& output : outputs) {
+      if (!output.active) {
+        continue;
+      } else if (connected_only && !output.connected) {
+        continue;
+      }
 
 #if WITH_XRANDR_MONITORS
-        if (check_monitor_support()) {
-          auto mon = std::find_if(
-              monitors.begin(), monitors.end(), [&name](const monitor_t& mon) { return mon->name == name; });
-          if (mon != monitors.end()) {
-            (*mon)->output = output;
-            continue;
-          }
+      if (check_monitor_support()) {
+        auto mon = std::find_if(
+            monitors.begin(), monitors.end(), [&output](const monitor_t& mon) { return mon->name == output.name; });
+        if (mon != monitors.end()) {
+          (*mon)->output = output.output;
+          continue;
         }
+      }
 #endif
 
-        auto crtc = conn.get_crtc_info(info->crtc);
-        auto primary = (primary_name == name);
-        monitors.emplace_back(make_monitor(output, move(name), crtc->width, crtc->height, crtc->x, crtc->y, primary));
-      } catch (const exception&) {
-        // silently ignore output
-      }
+      monitors.emplace_back(make_monitor(
+          output.output, output.name, output.w, output.h, output.x, output.y, output.output == primary_output));
     }
 
     if (purge_clones) {
@@ -193,6 +311,49 @@ namespace randr_util {
     return monitors;
   }
 
+  /**
+   * Get the refresh rate (in Hz) of the mode currently used by the monitor
+   *
+   * Returns 0 if the rate cannot be determined
+   */
+  double get_refresh_rate(connection& conn, const monitor_t& mon) {
+    if (!mon || mon->output == XCB_NONE) {
+      return 0.0;
+    }
+
+    try {
+      auto info = conn.get_output_info(mon->output);
+      if (info->crtc == XCB_NONE) {
+        return 0.0;
+      }
+
+      auto mode = conn.get_crtc_info(info->crtc)->mode;
+
+      for (auto&& m : conn.get_screen_resources(conn.root()).modes()) {
+        if (m.id != mode) {
+          continue;
+        } else if (m.htotal == 0 || m.vtotal == 0) {
+          return 0.0;
+        }
+
+        double vtotal = m.vtotal;
+
+        if (m.mode_flags & XCB_RANDR_MODE_FLAG_DOUBLE_SCAN) {
+          vtotal *= 2;
+        }
+        if (m.mode_flags & XCB_RANDR_MODE_FLAG_INTERLACE) {
+          vtotal /= 2;
+        }
+
+        return m.dot_clock / (m.htotal * vtotal);
+      }
+    } catch (const exception&) {
+      // fall through and let the caller decide on a default
+    }
+
+    return 0.0;
+  }
+
   /**
    * Searches for a monitor with name in monitors
    *
@@ -0,0 +1,90 @@
+#include "x11/extensions/shm.hpp"
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include "errors.hpp"
+#include "x11/connection.hpp"
+
+POLYBAR_NS
+
+namespace shm_util {
+  /**
+   * Query for the MIT-SHM extension
+   *
+   * Unlike the other extensions MIT-SHM is optional, so this doesn't throw
+   */
+  bool query_extension(connection& conn) {
+    auto reply = xcb_shm_query_version_reply(conn, xcb_shm_query_version(conn), nullptr);
+    bool present = reply != nullptr;
+    free(reply);
+    return present;
+  }
+}  // namespace shm_util
+
+/**
+ * Allocate a shared memory segment for the image and attach it to the server
+ */
+shm_image::shm_image(connection& conn, uint8_t depth, uint16_t width, uint16_t height)
+    : m_connection(conn), m_depth(depth), m_width(width), m_height(height) {
+  if ((m_shmid = shmget(IPC_PRIVATE, static_cast<size_t>(stride()) * m_height, IPC_CREAT | 0600)) == -1) {
+    throw system_error("Failed to allocate shared memory segment");
+  }
+
+  void* data = shmat(m_shmid, nullptr, 0);
+  if (data == reinterpret_cast<void*>(-1)) {
+    shmctl(m_shmid, IPC_RMID, nullptr);
+    throw system_error("Failed to map shared memory segment");
+  }
+  m_data = static_cast<unsigned char*>(data);
+
+  m_seg = m_connection.generate_id();
+  auto err = xcb_request_check(m_connection, xcb_shm_attach_checked(m_connection, m_seg, m_shmid, false));
+
+  // Removal is deferred by the kernel until both sides have detached
+  shmctl(m_shmid, IPC_RMID, nullptr);
+
+  if (err != nullptr) {
+    free(err);
+    shmdt(m_data);
+    throw application_error("Failed to attach shared memory segment (remote X server?)");
+  }
+}
+
+shm_image::~shm_image() {
+  sync();
+  xcb_shm_detach(m_connection, m_seg);
+  m_connection.flush();
+  shmdt(m_data);
+}
+
+unsigned char* shm_image::data() const {
+  return m_data;
+}
+
+int shm_image::stride() const {
+  return m_width * 4;
+}
+
+/**
+ * Put the given area of the image at the same position onto dst
+ *
+ * The image must not be modified before calling sync()
+ */
+void shm_image::put(xcb_drawable_t dst, xcb_gcontext_t gc, const xcb_rectangle_t& area) {
+  xcb_shm_put_image(m_connection, dst, gc, m_width, m_height, area.x, area.y, area.width, area.height, area.x, area.y,
+      m_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, false, m_seg, 0);
+  m_pending = true;
+}
+
+/**
+ * Wait until the server has processed all previous put requests
+ */
+void shm_image::sync() {
+  if (m_pending) {
+    free(xcb_get_input_focus_reply(m_connection, xcb_get_input_focus(m_connection), nullptr));
+    m_pending = false;
+  }
+}
+
+POLYBAR_NS_END
@@ -15,12 +15,16 @@ const keyboard::indicator& keyboard::get(const indicator::type& i) const {
 }
 
 /**
- * Update indicator states
+ * Update indicator states, returns false if none of them changed
  */
-void keyboard::set(unsigned int state) {
+bool keyboard::set(unsigned int state) {
+  bool changed{false};
   for (auto& i : indicators) {
-    i.second.enabled = state & i.second.mask;
+    bool enabled = state & i.second.mask;
+    changed = changed || enabled != i.second.enabled;
+    i.second.enabled = enabled;
   }
+  return changed;
 }
 
 /**
@@ -72,19 +72,32 @@ xembed_data* tray_client::xembed() const {
 
 /**
  * Make sure that the window mapping state is correct
+ *
+ * The request isn't waited for, its cookie is added to `requests` and has to
+ * be checked by the caller
  */
-void tray_client::ensure_state() const {
+void tray_client::ensure_state(vector<xcb_void_cookie_t>& requests) const {
   if (!mapped() && ((xembed()->flags & XEMBED_MAPPED) == XEMBED_MAPPED)) {
-    m_connection.map_window_checked(window());
+    requests.emplace_back(xcb_map_window_checked(m_connection, window()));
   } else if (mapped() && ((xembed()->flags & XEMBED_MAPPED) != XEMBED_MAPPED)) {
-    m_connection.unmap_window_checked(window());
+    requests.emplace_back(xcb_unmap_window_checked(m_connection, window()));
   }
 }
 
 /**
- * Configure window size
+ * Configure window size and position
+ *
+ * The position is remembered, so moving the window to the same position again
+ * doesn't send anything. Like ensure_state(), the cookie of the request is
+ * added to `requests`.
+ *
+ * \returns false if the window already was at the given position
  */
-void tray_client::reconfigure(int x, int y) const {
+bool tray_client::reconfigure(int x, int y, vector<xcb_void_cookie_t>& requests) {
+  if (m_configured && m_x == x && m_y == y) {
+    return false;
+  }
+
   unsigned int configure_mask = 0;
   unsigned int configure_values[7];
   xcb_params_configure_window_t configure_params{};
@@ -95,7 +108,12 @@ void tray_client::reconfigure(int x, int y) const {
   XCB_AUX_ADD_PARAM(&configure_mask, &configure_params, y, y);
 
   connection::pack_values(configure_mask, &configure_params, configure_values);
-  m_connection.configure_window_checked(window(), configure_mask, configure_values);
+  requests.emplace_back(xcb_configure_window_checked(m_connection, window(), configure_mask, configure_values));
+
+  m_configured = true;
+  m_x = x;
+  m_y = y;
+  return true;
 }
 
 /**
@@ -48,7 +48,7 @@ tray_manager::make_type tray_manager::make() {
 
 tray_manager::tray_manager(connection& conn, signal_emitter& emitter, const logger& logger, background_manager& back)
     : m_connection(conn), m_sig(emitter), m_log(logger), m_background_manager(back) {
-  m_connection.attach_sink(this, SINK_PRIORITY_TRAY);
+  m_connection.attach_sink(this, SINK_PRIORITY_TRAY, {_XEMBED_INFO});
 }
 
 tray_manager::~tray_manager() {
@@ -174,6 +174,19 @@ void tray_manager::setup(const bar_settings& bar_opts) {
   activate();
 }
 
+/**
+ * Move the tray along with the bar
+ */
+void tray_manager::move(int dx, int dy) {
+  m_opts.orig_x += dx;
+  m_opts.orig_y += dy;
+
+  if (m_activated) {
+    reconfigure_window();
+    m_connection.request_flush();
+  }
+}
+
 /**
  * Get the settings container
  */
@@ -248,6 +261,7 @@ void tray_manager::deactivate(bool clear_selection) {
 
   m_log.trace("tray: Unembed clients");
   m_clients.clear();
+  m_pending_docks.clear();
 
   if (m_tray) {
     m_log.trace("tray: Destroy window");
@@ -275,13 +289,16 @@ void tray_manager::deactivate(bool clear_selection) {
   m_acquired_selection = false;
   m_mapped = false;
 
-  m_connection.flush();
+  m_connection.request_flush();
 
   m_sig.emit(signals::eventqueue::notify_forcechange{});
 }
 
 /**
  * Reconfigure tray
+ *
+ * The background is only redrawn if the width of the tray changed, otherwise
+ * only the clients that were moved are repainted
  */
 void tray_manager::reconfigure() {
   if (!m_tray) {
@@ -289,26 +306,38 @@ void tray_manager::reconfigure() {
   } else if (m_mtx.try_lock()) {
     std::unique_lock<mutex> guard(m_mtx, std::adopt_lock);
 
+    vector<shared_ptr<tray_client>> moved;
+    bool resized{false};
+
     try {
-      reconfigure_clients();
+      moved = reconfigure_clients();
     } catch (const exception& err) {
       m_log.err("Failed to reconfigure tray clients (%s)", err.what());
     }
     try {
-      reconfigure_window();
+      resized = reconfigure_window();
     } catch (const exception& err) {
       m_log.err("Failed to reconfigure tray window (%s)", err.what());
     }
-    try {
-      reconfigure_bg();
-    } catch (const exception& err) {
-      m_log.err("Failed to reconfigure tray background (%s)", err.what());
+    if (resized) {
+      try {
+        reconfigure_bg(true);
+      } catch (const exception& err) {
+        m_log.err("Failed to reconfigure tray background (%s)", err.what());
+      }
     }
 
     m_opts.configured_slots = mapped_clients();
     guard.unlock();
-    refresh_window();
-    m_connection.flush();
+
+    if (resized) {
+      refresh_window();
+    } else {
+      for (auto&& client : moved) {
+        client->clear_window();
+      }
+    }
+    m_connection.request_flush();
   }
 
   m_sig.emit(signals::eventqueue::notify_forcechange{});
@@ -316,12 +345,14 @@ void tray_manager::reconfigure() {
 
 /**
  * Reconfigure container window
+ *
+ * \returns true if the width of the window changed
  */
-void tray_manager::reconfigure_window() {
+bool tray_manager::reconfigure_window() {
   m_log.trace("tray: Reconfigure window (mapped=%i, clients=%i)", static_cast<bool>(m_mapped), m_clients.size());
 
   if (!m_tray) {
-    return;
+    return false;
   }
 
   auto clients = mapped_clients();
@@ -334,15 +365,18 @@ void tray_manager::reconfigure_window() {
   }
 
   auto width = calculate_w();
+  auto height = calculate_h();
   auto x = calculate_x(width);
   auto y = calculate_y();
+  bool resized{width != m_prevwidth || height != m_prevheight};
 
-  if (m_opts.transparent) {
-    xcb_rectangle_t rect{0, 0, calculate_w(), calculate_h()};
+  // Observing a new slice copies the root pixmap, only needed if the size changed
+  if (m_opts.transparent && (resized || !m_bg_slice)) {
+    xcb_rectangle_t rect{0, 0, width, height};
     m_bg_slice = m_background_manager.observe(rect, m_tray);
   }
 
-  if (width > 0) {
+  if (width > 0 && (resized || x != m_opts.configured_x || y != m_opts.configured_y)) {
     m_log.trace("tray: New window values, width=%d, x=%d", width, x);
 
     unsigned int mask = 0;
@@ -356,31 +390,48 @@ void tray_manager::reconfigure_window() {
     m_connection.configure_window_checked(m_tray, mask, values);
   }
 
+  m_prevwidth = width;
+  m_prevheight = height;
   m_opts.configured_w = width;
   m_opts.configured_x = x;
   m_opts.configured_y = y;
+
+  return resized;
 }
 
 /**
  * Reconfigure clients
+ *
+ * \returns the clients that were moved
  */
-void tray_manager::reconfigure_clients() {
+vector<shared_ptr<tray_client>> tray_manager::reconfigure_clients() {
   m_log.trace("tray: Reconfigure clients");
 
+  vector<shared_ptr<tray_client>> moved;
+  vector<pair<shared_ptr<tray_client>, vector<xcb_void_cookie_t>>> requests;
   int x = m_opts.spacing;
 
+  // The requests of all clients are sent before any of them is checked
   for (auto it = m_clients.rbegin(); it != m_clients.rend(); it++) {
-    auto client = *it;
+    requests.emplace_back(*it, vector<xcb_void_cookie_t>{});
+    auto& client = requests.back().first;
 
-    try {
-      client->ensure_state();
-      client->reconfigure(x, calculate_client_y());
+    client->ensure_state(requests.back().second);
+    if (client->reconfigure(x, calculate_client_y(), requests.back().second)) {
+      moved.emplace_back(client);
+    }
 
-      x += m_opts.width + m_opts.spacing;
-    } catch (const xpp::x::error::window& err) {
-      remove_client(client, false);
+    x += m_opts.width + m_opts.spacing;
+  }
+
+  for (auto&& request : requests) {
+    if (!check_requests(request.second)) {
+      moved.erase(std::remove(moved.begin(), moved.end(), request.first), moved.end());
+      remove_client(request.first, false);
     }
   }
+
+  return moved;
 }
 
 /**
@@ -439,7 +490,7 @@ void tray_manager::refresh_window() {
     client->clear_window();
   }
 
-  m_connection.flush();
+  m_connection.request_flush();
 
   if (!mapped_clients()) {
     m_opts.configured_w = 0;
@@ -754,54 +805,102 @@ void tray_manager::track_selection_owner(xcb_window_t owner) {
 }
 
 /**
- * Process client docking request
+ * Dock the clients that requested it during the last burst of events
  */
-void tray_manager::process_docking_request(xcb_window_t win) {
-  m_log.info("Processing docking request from %s", m_connection.id(win));
-
-  m_clients.emplace_back(factory_util::shared<tray_client>(m_connection, win, m_opts.width, m_opts.height));
-  auto& client = m_clients.back();
-
-  try {
-    m_log.trace("tray: Get client _XEMBED_INFO");
-    xembed::query(m_connection, win, client->xembed());
-  } catch (const application_error& err) {
-    m_log.err(err.what());
-  } catch (const xpp::x::error::window& err) {
-    m_log.err("Failed to query _XEMBED_INFO, removing client... (%s)", err.what());
-    remove_client(win, true);
-    return;
+void tray_manager::events_handled() {
+  if (!m_pending_docks.empty()) {
+    process_docking_requests();
   }
+}
 
-  try {
-    const unsigned int mask{XCB_CW_BACK_PIXMAP | XCB_CW_EVENT_MASK};
-    const unsigned int values[]{
-        XCB_BACK_PIXMAP_PARENT_RELATIVE, XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY};
+/**
+ * Process the pending docking requests
+ *
+ * All requests for all clients are sent before any reply is read. Docking
+ * any number of clients therefore takes two round trips, one for their
+ * _XEMBED_INFO and one to check that setting them up worked.
+ */
+void tray_manager::process_docking_requests() {
+  vector<xcb_window_t> windows;
+  std::swap(windows, m_pending_docks);
+
+  vector<xcb_get_property_cookie_t> infos;
+  infos.reserve(windows.size());
+  for (auto win : windows) {
+    m_log.info("Processing docking request from %s", m_connection.id(win));
+    infos.emplace_back(xcb_get_property(m_connection, false, win, _XEMBED_INFO, XCB_GET_PROPERTY_TYPE_ANY, 0, 2));
+  }
+
+  vector<pair<shared_ptr<tray_client>, vector<xcb_void_cookie_t>>> requests;
+  for (size_t i = 0; i < windows.size(); i++) {
+    auto win = windows[i];
+    xcb_generic_error_t* error{nullptr};
+    auto reply = xcb_get_property_reply(m_connection, infos[i], &error);
+
+    if (error != nullptr) {
+      m_log.err("Failed to query _XEMBED_INFO of %s, ignoring docking request", m_connection.id(win));
+      free(error);
+      continue;
+    }
 
-    m_log.trace("tray: Update client window");
-    m_connection.change_window_attributes_checked(client->window(), mask, values);
+    auto client = factory_util::shared<tray_client>(m_connection, win, m_opts.width, m_opts.height);
+    if (!xembed::parse_info(reply, client->xembed())) {
+      m_log.err("Invalid _XEMBED_INFO for window %s", m_connection.id(win));
+    }
+    free(reply);
 
-    m_log.trace("tray: Configure client size");
-    client->reconfigure(0, 0);
+    m_clients.emplace_back(client);
+    requests.emplace_back(client, vector<xcb_void_cookie_t>{});
+  }
 
-    m_log.trace("tray: Add client window to the save set");
-    m_connection.change_save_set_checked(XCB_SET_MODE_INSERT, client->window());
+  const unsigned int mask{XCB_CW_BACK_PIXMAP | XCB_CW_EVENT_MASK};
+  const unsigned int values[]{
+      XCB_BACK_PIXMAP_PARENT_RELATIVE, XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY};
 
-    m_log.trace("tray: Reparent client");
-    m_connection.reparent_window_checked(
-        client->window(), m_tray, calculate_client_x(client->window()), calculate_client_y());
+  for (auto&& request : requests) {
+    auto& client = request.first;
+    auto& cookies = request.second;
+    auto win = client->window();
 
-    m_log.trace("tray: Send embbeded notification to client");
-    xembed::notify_embedded(m_connection, client->window(), m_tray, client->xembed()->version);
+    m_log.trace("tray: Set up client %s", m_connection.id(win));
+    cookies.emplace_back(xcb_change_window_attributes_checked(m_connection, win, mask, values));
+    client->reconfigure(0, 0, cookies);
+    cookies.emplace_back(xcb_change_save_set_checked(m_connection, XCB_SET_MODE_INSERT, win));
+    cookies.emplace_back(
+        xcb_reparent_window_checked(m_connection, win, m_tray, calculate_client_x(win), calculate_client_y()));
+    xembed::notify_embedded(m_connection, win, m_tray, client->xembed()->version);
 
     if (client->xembed()->flags & XEMBED_MAPPED) {
-      m_log.trace("tray: Map client");
-      m_connection.map_window_checked(client->window());
+      cookies.emplace_back(xcb_map_window_checked(m_connection, win));
+    }
+  }
+
+  for (auto&& request : requests) {
+    if (!check_requests(request.second)) {
+      m_log.err("Failed to setup tray client %s, removing...", m_connection.id(request.first->window()));
+      remove_client(request.first, false);
+    }
+  }
+}
+
+/**
+ * Wait for the given requests
+ *
+ * Every request is checked, even after one failed, so that xcb can drop
+ * their errors.
+ *
+ * \returns true if none of them failed
+ */
+bool tray_manager::check_requests(const vector<xcb_void_cookie_t>& requests) {
+  bool ok{true};
+  for (auto cookie : requests) {
+    auto error = xcb_request_check(m_connection, cookie);
+    if (error != nullptr) {
+      ok = false;
+      free(error);
     }
-  } catch (const xpp::x::error::window& err) {
-    m_log.err("Failed to setup tray client, removing... (%s)", err.what());
-    remove_client(win, false);
   }
+  return ok;
 }
 
 /**
@@ -934,7 +1033,9 @@ void tray_manager::handle(const evt::expose& evt) {
 void tray_manager::handle(const evt::visibility_notify& evt) {
   if (m_activated && !m_clients.empty()) {
     m_log.trace("tray: Received visibility_notify for %s", m_connection.id(evt->window));
-    reconfigure_window();
+    if (reconfigure_window()) {
+      redraw_window(true);
+    }
   }
 }
 
@@ -952,8 +1053,11 @@ void tray_manager::handle(const evt::client_message& evt) {
     m_log.trace("tray: Received client_message");
 
     if (SYSTEM_TRAY_REQUEST_DOCK == evt->data.data32[1]) {
-      if (!is_embedded(evt->data.data32[2])) {
-        process_docking_request(evt->data.data32[2]);
+      auto win = evt->data.data32[2];
+      if (!is_embedded(win) &&
+          std::find(m_pending_docks.begin(), m_pending_docks.end(), win) == m_pending_docks.end()) {
+        // Docked together with the other requests once the burst of events is handled
+        m_pending_docks.emplace_back(win);
       } else {
         auto win = evt->data.data32[2];
         m_log.warn("Tray client %s already embedded, ignoring request...", m_connection.id(win));
@@ -1026,13 +1130,8 @@ void tray_manager::handle(const evt::selection_clear& evt) {
 void tray_manager::handle(const evt::property_notify& evt) {
   if (!m_activated) {
     return;
-  } else if (evt->atom == _XROOTPMAP_ID) {
-    redraw_window(true);
-  } else if (evt->atom == _XSETROOT_ID) {
-    redraw_window(true);
-  } else if (evt->atom == ESETROOT_PMAP_ID) {
-    redraw_window(true);
   } else if (evt->atom != _XEMBED_INFO) {
+    // Root pixmap changes are redrawn once the background manager announces them
     return;
   }
 
@@ -1092,7 +1191,6 @@ void tray_manager::handle(const evt::destroy_notify& evt) {
   } else if (m_activated && is_embedded(evt->window)) {
     m_log.trace("tray: Received destroy_notify for client, remove...");
     remove_client(evt->window);
-    redraw_window();
   }
 }
 
@@ -1157,7 +1255,7 @@ bool tray_manager::on(const signals::ui::visibility_change& evt) {
     redraw_window();
   }
 
-  m_connection.flush();
+  m_connection.request_flush();
 
   return true;
 }
@@ -27,6 +27,28 @@ namespace xembed {
     return data;
   }
 
+  /**
+   * Fill in the data from a _XEMBED_INFO reply that was requested separately
+   *
+   * \returns false if the reply holds no info
+   */
+  bool parse_info(const xcb_get_property_reply_t* reply, xembed_data* data) {
+    if (reply == nullptr || xcb_get_property_value_length(reply) < 2 * 4) {
+      return false;
+    }
+
+    auto info = static_cast<const uint32_t*>(xcb_get_property_value(reply));
+
+    data->xembed = _XEMBED;
+    data->xembed_info = _XEMBED_INFO;
+
+    data->time = XCB_CURRENT_TIME;
+    data->flags = info[1];
+    data->version = info[0];
+
+    return true;
+  }
+
   /**
    * Send _XEMBED messages
    */
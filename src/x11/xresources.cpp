@@ -1,7 +1,35 @@
 #include "x11/xresources.hpp"
 
+#include <cstdlib>
+
 POLYBAR_NS
 
+/**
+ * Value of the given resource
+ *
+ * \throws xresource_error if there is no such resource
+ */
+string xresource_manager::lookup(const string& name) const {
+  std::lock_guard<std::mutex> guard(m_lock);
+
+  auto it = m_results.find(name);
+  if (it == m_results.end()) {
+    char* value{nullptr};
+    result entry{false, ""};
+    if (xcb_xrm_resource_get_string(m_xrm, string_util::replace(name, "*", ".").c_str(), nullptr, &value) == 0 &&
+        value != nullptr) {
+      entry = result{true, value};
+    }
+    free(value);
+    it = m_results.emplace(name, move(entry)).first;
+  }
+
+  if (!it->second.found) {
+    throw xresource_error(sstream() << "X resource \"" << name << "\" not found");
+  }
+  return it->second.value;
+}
+
 template <>
 string xresource_manager::convert(string&& value) const {
   return forward<string>(value);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Sets environment variables for the lifetime of the object and restores
+ * their previous values afterwards, so that tests don't depend on the
+ * environment of whoever runs them
+ */
+class scoped_env {
+ public:
+  scoped_env() = default;
+  scoped_env(const scoped_env&) = delete;
+  scoped_env& operator=(const scoped_env&) = delete;
+
+  ~scoped_env() {
+    for (auto it = m_saved.rbegin(); it != m_saved.rend(); ++it) {
+      if (it->second.first) {
+        setenv(it->first.c_str(), it->second.second.c_str(), 1);
+      } else {
+        unsetenv(it->first.c_str());
+      }
+    }
+  }
+
+  void set(const std::string& name, const std::string& value) {
+    save(name);
+    setenv(name.c_str(), value.c_str(), 1);
+  }
+
+  void unset(const std::string& name) {
+    save(name);
+    unsetenv(name.c_str());
+  }
+
+ private:
+  void save(const std::string& name) {
+    const char* value = getenv(name.c_str());
+    m_saved.emplace_back(name, std::make_pair(value != nullptr, std::string{value != nullptr ? value : ""}));
+  }
+
+  std::vector<std::pair<std::string, std::pair<bool, std::string>>> m_saved;
+};
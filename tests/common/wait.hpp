@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+/**
+ * Polls the predicate until it holds, but at most for the given time
+ *
+ * Tests of code that runs on other threads wait for the outcome with this
+ * instead of sleeping for a fixed time, which is either slow or flaky.
+ *
+ * \returns whether the predicate holds in the end
+ */
+template <typename Pred>
+bool wait_for(Pred pred, std::chrono::milliseconds timeout = std::chrono::seconds(1)) {
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!pred() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return pred();
+}
@@ -0,0 +1,96 @@
+#include "cairo/font_cache.hpp"
+
+#include <unistd.h>
+
+#include "common/env.hpp"
+#include "common/test.hpp"
+#include "components/logger.hpp"
+#include "utils/file.hpp"
+
+using namespace polybar;
+
+class FontCache : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/polybar-testXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    m_dir = dir;
+    m_path = m_dir + "/cache/fonts.cache";
+
+    // The cache records the state of fontconfig's user directories, which must not be the real ones
+    m_env.set("HOME", m_dir);
+    m_env.set("XDG_CACHE_HOME", m_dir + "/cache");
+    m_env.set("XDG_CONFIG_HOME", m_dir + "/config");
+    m_env.set("XDG_DATA_HOME", m_dir + "/data");
+    FcInit();
+
+    // Stands in for a font file, only its existence is checked
+    m_font = m_dir + "/font.ttf";
+    file_util::write_contents(m_font, "");
+  }
+
+  void TearDown() override {
+    unlink(m_path.c_str());
+    unlink(m_font.c_str());
+    rmdir((m_dir + "/cache").c_str());
+    rmdir(m_dir.c_str());
+  }
+
+  FcPattern* make_match() const {
+    FcPattern* match = FcPatternCreate();
+    FcPatternAddString(match, FC_FAMILY, reinterpret_cast<const FcChar8*>("Test"));
+    FcPatternAddString(match, FC_FILE, reinterpret_cast<const FcChar8*>(m_font.c_str()));
+    FcPatternAddDouble(match, FC_PIXEL_SIZE, 12.5);
+    return match;
+  }
+
+  scoped_env m_env;
+  string m_dir;
+  string m_path;
+  string m_font;
+};
+
+TEST_F(FontCache, roundTrip) {
+  {
+    cairo::font_cache cache(logger::make(), m_path);
+    EXPECT_EQ(nullptr, cache.lookup("Test:size=10"));
+
+    FcPattern* match = make_match();
+    cache.store("Test:size=10", match);
+    FcPatternDestroy(match);
+    cache.save();
+  }
+
+  cairo::font_cache cache(logger::make(), m_path);
+  FcPattern* match = cache.lookup("Test:size=10");
+  ASSERT_NE(nullptr, match);
+
+  FcChar8* file{nullptr};
+  double pixelsize{0.0};
+  EXPECT_EQ(FcResultMatch, FcPatternGetString(match, FC_FILE, 0, &file));
+  EXPECT_EQ(m_font, reinterpret_cast<const char*>(file));
+  EXPECT_EQ(FcResultMatch, FcPatternGetDouble(match, FC_PIXEL_SIZE, 0, &pixelsize));
+  EXPECT_DOUBLE_EQ(12.5, pixelsize);
+  FcPatternDestroy(match);
+
+  EXPECT_EQ(nullptr, cache.lookup("Other"));
+}
+
+TEST_F(FontCache, missingFile) {
+  cairo::font_cache cache(logger::make(), m_path);
+
+  FcPattern* match = make_match();
+  cache.store("Test", match);
+  FcPatternDestroy(match);
+
+  unlink(m_font.c_str());
+  EXPECT_EQ(nullptr, cache.lookup("Test"));
+}
+
+TEST_F(FontCache, outdated) {
+  file_util::create_directories(m_dir + "/cache");
+  file_util::write_contents(m_path, "polybar-font-cache 1 0:0\nTest\tTest:file=" + m_font + "\n");
+
+  cairo::font_cache cache(logger::make(), m_path);
+  EXPECT_EQ(nullptr, cache.lookup("Test"));
+}
@@ -0,0 +1,60 @@
+#include "cairo/utils.hpp"
+
+#include "common/test.hpp"
+
+using namespace polybar;
+using namespace cairo;
+
+TEST(Utf8ToUcs4, ascii) {
+  string text{"The quick brown fox jumps over the lazy dog"};
+  utils::unicode_charlist chars;
+
+  EXPECT_TRUE(utils::utf8_to_ucs4(reinterpret_cast<const unsigned char*>(text.c_str()), chars));
+  ASSERT_EQ(text.size(), chars.size());
+
+  for (size_t i = 0; i < text.size(); i++) {
+    EXPECT_EQ(static_cast<unsigned long>(text[i]), chars[i].codepoint);
+    EXPECT_EQ(static_cast<int>(i), chars[i].offset);
+    EXPECT_EQ(1, chars[i].length);
+  }
+}
+
+TEST(Utf8ToUcs4, multibyte) {
+  // Long enough for the ASCII runs to span multiple 16 byte blocks
+  string text{"0123456789abcdefghé€0123456789abcdefgh\U0001f600"};
+  utils::unicode_charlist chars;
+
+  EXPECT_TRUE(utils::utf8_to_ucs4(reinterpret_cast<const unsigned char*>(text.c_str()), chars));
+  ASSERT_EQ(39, chars.size());
+
+  EXPECT_EQ('h', chars[17].codepoint);
+  EXPECT_EQ(0xe9, chars[18].codepoint);
+  EXPECT_EQ(18, chars[18].offset);
+  EXPECT_EQ(2, chars[18].length);
+  EXPECT_EQ(0x20ac, chars[19].codepoint);
+  EXPECT_EQ(20, chars[19].offset);
+  EXPECT_EQ(3, chars[19].length);
+  EXPECT_EQ('0', chars[20].codepoint);
+  EXPECT_EQ(23, chars[20].offset);
+  EXPECT_EQ(0x1f600, chars[38].codepoint);
+  EXPECT_EQ(41, chars[38].offset);
+  EXPECT_EQ(4, chars[38].length);
+}
+
+TEST(Utf8ToUcs4, length) {
+  string text{"abcédef"};
+  utils::unicode_charlist chars;
+
+  EXPECT_TRUE(utils::utf8_to_ucs4(reinterpret_cast<const unsigned char*>(text.data()), 5, chars));
+  ASSERT_EQ(4, chars.size());
+  EXPECT_EQ(0xe9, chars[3].codepoint);
+}
+
+TEST(Utf8ToUcs4, invalid) {
+  string text{"abc\x80"
+              "def"};
+  utils::unicode_charlist chars;
+
+  EXPECT_FALSE(utils::utf8_to_ucs4(reinterpret_cast<const unsigned char*>(text.c_str()), chars));
+  EXPECT_EQ(3, chars.size());
+}
@@ -0,0 +1,96 @@
+#include "components/action_index.hpp"
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+namespace {
+  action_block make_action(mousebtn btn, double start_x, double end_x, string cmd, bool active = false) {
+    action_block a{};
+    a.button = btn;
+    a.command = move(cmd);
+    a.start_x = start_x;
+    a.end_x = end_x;
+    a.active = active;
+    return a;
+  }
+}  // namespace
+
+TEST(ActionIndex, empty) {
+  action_index index;
+
+  EXPECT_TRUE(index.at(0).empty());
+  EXPECT_EQ(nullptr, index.find(0, mousebtn::LEFT));
+}
+
+TEST(ActionIndex, bounds) {
+  action_index index{{make_action(mousebtn::LEFT, 10, 20, "a")}};
+
+  EXPECT_EQ(nullptr, index.find(9, mousebtn::LEFT));
+  ASSERT_NE(nullptr, index.find(10, mousebtn::LEFT));
+  EXPECT_EQ("a", index.find(10, mousebtn::LEFT)->command);
+  ASSERT_NE(nullptr, index.find(19, mousebtn::LEFT));
+  EXPECT_EQ(nullptr, index.find(20, mousebtn::LEFT));
+  EXPECT_EQ(nullptr, index.find(15, mousebtn::RIGHT));
+}
+
+TEST(ActionIndex, nested) {
+  action_index index{{
+      make_action(mousebtn::LEFT, 0, 100, "outer"),
+      make_action(mousebtn::SCROLL_UP, 0, 100, "scroll"),
+      make_action(mousebtn::LEFT, 20, 40, "inner"),
+      make_action(mousebtn::LEFT, 60, 80, "other"),
+  }};
+
+  EXPECT_EQ("outer", index.find(10, mousebtn::LEFT)->command);
+  EXPECT_EQ("inner", index.find(30, mousebtn::LEFT)->command);
+  EXPECT_EQ("outer", index.find(50, mousebtn::LEFT)->command);
+  EXPECT_EQ("other", index.find(70, mousebtn::LEFT)->command);
+  EXPECT_EQ("scroll", index.find(70, mousebtn::SCROLL_UP)->command);
+
+  vector<string> commands;
+  for (const auto* a : index.at(30)) {
+    commands.emplace_back(a->command);
+  }
+  EXPECT_EQ((vector<string>{"inner", "scroll", "outer"}), commands);
+}
+
+TEST(ActionIndex, unclosed) {
+  action_index index{{make_action(mousebtn::LEFT, 0, 50, "open", true)}};
+
+  EXPECT_FALSE(index.at(10).empty());
+  EXPECT_EQ(nullptr, index.find(10, mousebtn::LEFT));
+}
+
+/**
+ * Has to give the same result as testing every action in reverse order
+ */
+TEST(ActionIndex, matchesLinearSearch) {
+  vector<action_block> actions;
+  for (int i = 0; i < 20; i++) {
+    double start = (i * 37) % 200;
+    actions.emplace_back(make_action(i % 2 ? mousebtn::LEFT : mousebtn::RIGHT, start, start + 5 + (i * 13) % 60,
+        to_string(i)));
+  }
+  action_index index{actions};
+
+  for (int x = -5; x < 300; x++) {
+    for (auto btn : {mousebtn::LEFT, mousebtn::RIGHT}) {
+      const action_block* expected{nullptr};
+      for (auto a = actions.rbegin(); a != actions.rend(); a++) {
+        if (a->button == btn && a->test(x)) {
+          expected = &*a;
+          break;
+        }
+      }
+
+      const auto* result = index.find(x, btn);
+      if (expected == nullptr) {
+        EXPECT_EQ(nullptr, result) << x;
+      } else {
+        ASSERT_NE(nullptr, result) << x;
+        EXPECT_EQ(expected->command, result->command) << x;
+      }
+    }
+  }
+}
@@ -0,0 +1,79 @@
+#include "components/action_table.hpp"
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+TEST(ActionTable, internsActions) {
+  action_table table;
+  action_table::scope scope(table);
+
+  auto id = scope.intern("date", "toggle", "");
+  EXPECT_EQ("#0", id);
+  EXPECT_EQ(id, scope.intern("date", "toggle", ""));
+  EXPECT_EQ("#1", scope.intern("date", "toggle", "1"));
+
+  actions_util::action action;
+  ASSERT_TRUE(table.resolve("#1", action));
+  EXPECT_EQ("date", std::get<0>(action));
+  EXPECT_EQ("toggle", std::get<1>(action));
+  EXPECT_EQ("1", std::get<2>(action));
+}
+
+TEST(ActionTable, keepsOtherStrings) {
+  action_table table;
+  action_table::scope scope(table);
+
+  EXPECT_EQ("#date.", scope.intern("date", "", ""));
+
+  actions_util::action action;
+  EXPECT_FALSE(table.resolve("#0", action));
+  EXPECT_FALSE(table.resolve("#", action));
+  EXPECT_FALSE(table.resolve("#date.toggle", action));
+  EXPECT_FALSE(table.resolve("#1a", action));
+}
+
+TEST(ActionTable, dropsIdsOfScope) {
+  action_table table;
+  actions_util::action action;
+
+  {
+    action_table::scope scope(table);
+    EXPECT_EQ("#0", scope.intern("menu", "open", "1"));
+    ASSERT_TRUE(table.resolve("#0", action));
+  }
+
+  EXPECT_FALSE(table.resolve("#0", action));
+
+  // Ids of dropped scopes aren't handed out again
+  action_table::scope scope(table);
+  EXPECT_EQ("#1", scope.intern("menu", "open", "1"));
+}
+
+TEST(ActionTable, fallsBackWhenFull) {
+  action_table table;
+  action_table::scope scope(table);
+
+  for (size_t i = 0; i < action_table::MAX_ENTRIES; i++) {
+    scope.intern("module", "action", to_string(i));
+  }
+
+  EXPECT_EQ("#module.action.new", scope.intern("module", "action", "new"));
+  EXPECT_EQ("#0", scope.intern("module", "action", "0"));
+
+  // Other scopes have their own limit
+  action_table::scope other(table);
+  EXPECT_EQ("#" + to_string(action_table::MAX_ENTRIES), other.intern("module", "action", "new"));
+}
+
+TEST(ActionTable, disabled) {
+  action_table table;
+  action_table::scope scope(table);
+  table.disable();
+
+  EXPECT_EQ("#date.toggle", scope.intern("date", "toggle", ""));
+  EXPECT_EQ("#menu.open.1", scope.intern("menu", "open", "1"));
+
+  actions_util::action action;
+  EXPECT_FALSE(table.resolve("#0", action));
+}
@@ -0,0 +1,45 @@
+#include "components/alloc_stats.hpp"
+
+#include <algorithm>
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+TEST(AllocStats, tags) {
+  auto first = alloc_stats::tag("test/first");
+  auto second = alloc_stats::tag("test/second");
+
+  EXPECT_NE(0, first);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(first, alloc_stats::tag("test/first"));
+}
+
+TEST(AllocStats, scopedTag) {
+  auto tag = alloc_stats::tag("test/scoped");
+  {
+    scoped_alloc_tag scope{tag};
+    EXPECT_EQ(alloc_stats::enabled() ? tag : 0, alloc_stats::current());
+  }
+  EXPECT_EQ(0, alloc_stats::current());
+}
+
+TEST(AllocStats, report) {
+  alloc_stats::reset();
+  {
+    scoped_alloc_tag scope{alloc_stats::tag("test/report")};
+    auto block = make_unique<char[]>(100);
+  }
+
+  auto report = alloc_stats::report();
+  if (!alloc_stats::enabled()) {
+    EXPECT_TRUE(report.empty());
+    return;
+  }
+
+  auto line = std::find_if(report.begin(), report.end(), [](const string& l) { return l.find("test/report") == 0; });
+  ASSERT_NE(report.end(), line);
+  EXPECT_NE(string::npos, line->find("allocs=1 "));
+  EXPECT_NE(string::npos, line->find("allocated=100B"));
+  EXPECT_NE(string::npos, line->find("live=0B"));
+}
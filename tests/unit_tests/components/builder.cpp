@@ -0,0 +1,66 @@
+#include "components/builder.hpp"
+
+#include "common/test.hpp"
+#include "drawtypes/label.hpp"
+
+using namespace polybar;
+
+class Builder : public ::testing::Test {
+ protected:
+  bar_settings m_bar{};
+  builder m_builder{m_bar};
+};
+
+TEST_F(Builder, tags) {
+  m_builder.font(2);
+  m_builder.node("a");
+  m_builder.font_close();
+  m_builder.offset(-3);
+  m_builder.control(tags::controltag::R);
+  EXPECT_EQ("%{T2}a%{T-}%{O-3}%{PR}", m_builder.flush());
+}
+
+TEST_F(Builder, graph) {
+  m_builder.graph(tags::graph_type::BAR, 40, {10.0, 75.4});
+  m_builder.graph(tags::graph_type::SPARKLINE, 20, {0.0, 49.5, 120.0});
+  m_builder.graph(tags::graph_type::SPARKLINE, 20, {});
+  EXPECT_EQ("%{Gb40:75}%{Gs20:0,50,100}", m_builder.flush());
+}
+
+TEST_F(Builder, reserve) {
+  m_builder.reserve(tags::reserved_width{60, false, false});
+  m_builder.reserve(tags::reserved_width{4, true, true});
+  m_builder.reserve(tags::reserved_width{});
+  EXPECT_EQ("%{PW60}%{PF4c}", m_builder.flush());
+}
+
+TEST_F(Builder, flushClosesTags) {
+  m_builder.font(3);
+  m_builder.action(mousebtn::LEFT, "cmd");
+  m_builder.node("x");
+  EXPECT_EQ("%{T3}%{A1:cmd:}x%{T-}%{A}", m_builder.flush());
+
+  // The state is reset by the flush
+  m_builder.node("y");
+  EXPECT_EQ("y", m_builder.flush());
+}
+
+TEST_F(Builder, removeTrailingSpace) {
+  m_builder.node("a");
+  m_builder.space(2);
+  m_builder.remove_trailing_space(3);
+  m_builder.remove_trailing_space(2);
+  EXPECT_EQ("a", m_builder.flush());
+
+  m_builder.node("a ");
+  m_builder.node("b");
+  m_builder.remove_trailing_space(2);
+  EXPECT_EQ("a b", m_builder.flush());
+}
+
+TEST_F(Builder, label) {
+  auto label = make_shared<drawtypes::label>("text", 2);
+  label->m_padding = side_values{1U, 2U};
+  m_builder.node(label);
+  EXPECT_EQ(" %{T2}text%{T-}  ", m_builder.flush());
+}
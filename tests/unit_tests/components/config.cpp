@@ -0,0 +1,212 @@
+#include "components/config.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "common/test.hpp"
+#include "components/logger.hpp"
+#include "utils/color.hpp"
+
+using namespace polybar;
+using namespace std;
+
+/**
+ * \brief Fixture class
+ */
+class Config : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    current.set_sections(base_sections());
+  }
+
+  static sectionmap_t base_sections() {
+    sectionmap_t sections;
+    sections["bar/TEST"] = {{"modules-left", "date cpu"}, {"background", "${colors.background}"}};
+    sections["colors"] = {{"background", "#222"}, {"primary", "#f90"}};
+    sections["module/base"] = {{"interval", "2"}};
+    sections["module/date"] = {{"type", "internal/date"}, {"format-foreground", "${colors.primary}"}};
+    sections["module/cpu"] = {{"type", "internal/cpu"}, {"inherit", "module/base"}};
+    return sections;
+  }
+
+  logger log{loglevel::NONE};
+  config current{log, "/dev/zero", "TEST"};
+  config next{log, "/dev/zero", "TEST"};
+};
+
+TEST_F(Config, changedSectionsUnchanged) {
+  next.set_sections(base_sections());
+  EXPECT_TRUE(current.changed_sections(next).empty());
+}
+
+TEST_F(Config, changedSectionsModule) {
+  auto sections = base_sections();
+  sections["module/date"]["label"] = "%date%";
+  next.set_sections(move(sections));
+
+  EXPECT_EQ(set<string>{"module/date"}, current.changed_sections(next));
+}
+
+TEST_F(Config, changedSectionsReferenced) {
+  auto sections = base_sections();
+  sections["colors"]["primary"] = "#0f9";
+  next.set_sections(move(sections));
+
+  EXPECT_EQ((set<string>{"colors", "module/date"}), current.changed_sections(next));
+
+  sections = base_sections();
+  sections["colors"]["background"] = "#000";
+  next.set_sections(move(sections));
+
+  EXPECT_EQ((set<string>{"colors", "bar/TEST"}), current.changed_sections(next));
+}
+
+TEST_F(Config, changedSectionsInherited) {
+  auto sections = base_sections();
+  sections["module/base"]["interval"] = "5";
+  next.set_sections(move(sections));
+
+  EXPECT_EQ((set<string>{"module/base", "module/cpu"}), current.changed_sections(next));
+}
+
+TEST_F(Config, changedSectionsRemoved) {
+  auto sections = base_sections();
+  sections.erase("module/cpu");
+  next.set_sections(move(sections));
+
+  EXPECT_EQ(set<string>{"module/cpu"}, current.changed_sections(next));
+}
+
+TEST_F(Config, getDefault) {
+  EXPECT_EQ("date cpu", current.get("bar/TEST", "modules-left", string{}));
+  EXPECT_EQ("fallback", current.get("bar/TEST", "modules-right", string{"fallback"}));
+  EXPECT_EQ("fallback", current.get("bar/MISSING", "modules-left", string{"fallback"}));
+  EXPECT_EQ(2, current.get("module/base", "interval", 1));
+  EXPECT_EQ(1, current.get("module/base", "missing", 1));
+}
+
+TEST_F(Config, getDefaultReference) {
+  EXPECT_EQ(rgba{"#222"}, current.get("bar/TEST", "background", rgba{}));
+  EXPECT_EQ("#f90", current.get("module/date", "format-foreground", string{}));
+
+  current.set("module/date", "format-background", "${colors.missing}");
+  EXPECT_EQ("default", current.get("module/date", "format-background", string{"default"}));
+
+  current.set("module/date", "format-underline", "${colors.missing:#fff}");
+  EXPECT_EQ("#fff", current.get("module/date", "format-underline", string{}));
+}
+
+TEST_F(Config, getList) {
+  current.set("module/date", "ramp-0", "a");
+  current.set("module/date", "ramp-1", "${colors.primary}");
+
+  EXPECT_EQ((vector<string>{"a", "#f90"}), current.get_list<string>("module/date", "ramp"));
+  EXPECT_EQ((vector<string>{"x"}), current.get_list<string>("module/date", "missing", {"x"}));
+  EXPECT_THROW(current.get_list<string>("module/date", "missing"), key_error);
+}
+
+TEST_F(Config, deprecated) {
+  EXPECT_EQ(2, current.deprecated("module/base", "interval", "update-interval", 1));
+  EXPECT_EQ(1, current.deprecated("module/base", "old-interval", "update-interval", 1));
+}
+
+TEST_F(Config, find) {
+  for (int i = 0; i < 100; i++) {
+    current.set("module/many", "key-" + to_string(i), to_string(i));
+  }
+
+  for (int i = 0; i < 100; i++) {
+    const string* value = current.find("module/many", "key-" + to_string(i));
+    ASSERT_NE(nullptr, value);
+    EXPECT_EQ(to_string(i), *value);
+  }
+
+  EXPECT_EQ(nullptr, current.find("module/many", "key-100"));
+  EXPECT_EQ(nullptr, current.find("module/few", "key-0"));
+  EXPECT_EQ("2", *current.find("module/cpu", "interval"));
+}
+
+TEST_F(Config, referenceCycle) {
+  current.set("module/a", "x", "${module/b.y}");
+  current.set("module/b", "y", "${module/a.x}");
+  current.set("module/a", "self", "${self.self}");
+
+  EXPECT_EQ("default", current.get("module/a", "x", string{"default"}));
+  EXPECT_EQ("default", current.get("module/a", "self", string{"default"}));
+  EXPECT_THROW(current.get("module/b", "y"), value_error);
+}
+
+TEST_F(Config, referenceResolvedOnce) {
+  char path[] = "/tmp/polybar_config_test_referenceXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(-1, fd);
+  close(fd);
+  file_util::write_contents(path, "first");
+  current.set("module/a", "x", "${file:"s + path + "}");
+
+  EXPECT_EQ("first", current.get("module/a", "x", string{}));
+  file_util::write_contents(path, "second");
+  EXPECT_EQ("first", current.get("module/a", "x", string{}));
+
+  // Adding parameters can change what references resolve to
+  current.set("module/a", "y", "");
+  EXPECT_EQ("second", current.get("module/a", "x", string{}));
+  unlink(path);
+}
+
+TEST_F(Config, changedSectionsExternalReference) {
+  char path[] = "/tmp/polybar_config_test_externalXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(-1, fd);
+  close(fd);
+  file_util::write_contents(path, "first");
+
+  auto sections = base_sections();
+  sections["colors"]["file"] = "${file:"s + path + "}";
+  current.set_sections(sections);
+  next.set_sections(sections);
+  EXPECT_EQ("first", current.get("colors", "file"));
+  EXPECT_TRUE(current.changed_sections(next).empty());
+
+  // The reloaded config resolves the reference again
+  file_util::write_contents(path, "second");
+  next.set_sections(sections);
+  EXPECT_EQ("first", current.get("colors", "file"));
+  EXPECT_EQ(set<string>{"colors"}, current.changed_sections(next));
+
+  current.assign(next);
+  EXPECT_EQ("second", current.get("colors", "file"));
+  unlink(path);
+}
+
+TEST_F(Config, assignWhileReading) {
+  auto sections = base_sections();
+  sections["colors"]["primary"] = "#0f9";
+  next.set_sections(move(sections));
+
+  config other{log, "/dev/zero", "TEST"};
+  other.set_sections(base_sections());
+
+  std::atomic<bool> done{false};
+  std::atomic<int> invalid{0};
+  std::thread reader([&] {
+    while (!done) {
+      auto value = current.get("module/date", "format-foreground", string{});
+      if (value != "#f90" && value != "#0f9") {
+        invalid++;
+      }
+    }
+  });
+
+  // Readers keep the parameters they started with while the config is reloaded
+  for (int i = 0; i < 200; i++) {
+    current.assign(i % 2 == 0 ? next : other);
+  }
+  done = true;
+  reader.join();
+
+  EXPECT_EQ(0, invalid);
+  EXPECT_EQ("#f90", current.get("module/date", "format-foreground"));
+}
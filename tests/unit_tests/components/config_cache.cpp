@@ -0,0 +1,104 @@
+#include "components/config_cache.hpp"
+
+#include <unistd.h>
+
+#include "common/test.hpp"
+#include "components/logger.hpp"
+#include "utils/file.hpp"
+
+using namespace polybar;
+using namespace std;
+
+class ConfigCache : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/polybar-testXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    m_dir = dir;
+    m_path = m_dir + "/cache/config.cache";
+    m_config = m_dir + "/config.ini";
+    m_include = m_dir + "/modules";
+    file_util::write_contents(m_config, "[bar/TEST]\n");
+    file_util::create_directories(m_include);
+  }
+
+  void TearDown() override {
+    unlink(m_path.c_str());
+    unlink(m_config.c_str());
+    rmdir(m_include.c_str());
+    rmdir((m_dir + "/cache").c_str());
+    rmdir(m_dir.c_str());
+  }
+
+  config_cache::snapshot make_snapshot() const {
+    config_cache::snapshot data;
+    data.files = {m_config};
+    data.directories = {m_include};
+    data.sections["bar/TEST"] = {{"width", "100%"}, {"tabs", "a\tb"}, {"empty", ""}};
+    data.sections["colors"] = {{"fg", "${xrdb:fg}"}};
+    data.use_xrm = true;
+    data.parsed = chrono::system_clock::now() + chrono::seconds{5};
+    return data;
+  }
+
+  logger m_log{loglevel::NONE};
+  string m_dir;
+  string m_path;
+  string m_config;
+  string m_include;
+};
+
+TEST_F(ConfigCache, roundTrip) {
+  config_cache cache{m_log, m_path};
+  config_cache::snapshot loaded;
+  EXPECT_FALSE(cache.load(m_config, loaded));
+
+  auto data = make_snapshot();
+  ASSERT_TRUE(cache.save(data));
+  ASSERT_TRUE(cache.load(m_config, loaded));
+
+  EXPECT_EQ(data.files, loaded.files);
+  EXPECT_EQ(data.directories, loaded.directories);
+  EXPECT_EQ(data.sections, loaded.sections);
+  EXPECT_TRUE(loaded.use_xrm);
+}
+
+TEST_F(ConfigCache, outdated) {
+  config_cache cache{m_log, m_path};
+  config_cache::snapshot loaded;
+  ASSERT_TRUE(cache.save(make_snapshot()));
+
+  EXPECT_FALSE(cache.load(m_dir + "/other.ini", loaded));
+
+  file_util::write_contents(m_config, "[bar/TEST]\nwidth = 50%\n");
+  EXPECT_FALSE(cache.load(m_config, loaded));
+
+  // Files added to included directories
+  ASSERT_TRUE(cache.save(make_snapshot()));
+  ASSERT_TRUE(cache.load(m_config, loaded));
+  file_util::write_contents(m_include + "/new.ini", "");
+  EXPECT_FALSE(cache.load(m_config, loaded));
+  unlink((m_include + "/new.ini").c_str());
+}
+
+TEST_F(ConfigCache, broken) {
+  config_cache cache{m_log, m_path};
+  config_cache::snapshot loaded;
+  ASSERT_TRUE(cache.save(make_snapshot()));
+
+  auto contents = file_util::contents(m_path);
+  file_util::write_contents(m_path, contents.substr(0, contents.size() / 2));
+  EXPECT_FALSE(cache.load(m_config, loaded));
+}
+
+/**
+ * Files that were modified after the parser started may not match the parsed values
+ */
+TEST_F(ConfigCache, modifiedWhileParsing) {
+  config_cache cache{m_log, m_path};
+  auto data = make_snapshot();
+  data.parsed = chrono::system_clock::now() - chrono::seconds{5};
+
+  EXPECT_FALSE(cache.save(data));
+  EXPECT_FALSE(file_util::exists(m_path));
+}
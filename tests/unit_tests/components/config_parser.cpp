@@ -2,6 +2,7 @@
 
 #include "common/test.hpp"
 #include "components/logger.hpp"
+#include "utils/file.hpp"
 
 using namespace polybar;
 using namespace std;
@@ -236,3 +237,46 @@ TEST_F(ParseHeaderTest, throwsSyntaxError) {
   EXPECT_THROW(parser->parse_header("[root]"), syntax_error);
 }
 // }}}
+
+// ParseFileTest {{{
+
+class ParseFileTest : public ConfigParser {
+ protected:
+  void TearDown() override {
+    unlink(main_file.c_str());
+    unlink(include_file.c_str());
+  }
+
+  string main_file{"/tmp/polybar_config_parser_test_main.ini"};
+  string include_file{"/tmp/polybar_config_parser_test_include.ini"};
+  logger log{loglevel::NONE};
+};
+
+/**
+ * Line endings, included files and a missing newline at the end of the file
+ */
+TEST_F(ParseFileTest, parse) {
+  file_util::write_contents(
+      main_file, "[bar/TEST]\r\nwidth = 100%\r\n\r\ninclude-file = " + include_file + "\n[colors]\nfg = #fff");
+  file_util::write_contents(include_file, "; comment\nheight = 20\n");
+
+  config conf{log, string{main_file}, "TEST"};
+  config_parser{log, string{main_file}, "TEST"}.parse(conf);
+
+  EXPECT_EQ("100%", conf.get("bar/TEST", "width"));
+  EXPECT_EQ("20", conf.get("bar/TEST", "height"));
+  EXPECT_EQ("#fff", conf.get("colors", "fg"));
+}
+
+TEST_F(ParseFileTest, duplicateKey) {
+  file_util::write_contents(main_file, "[bar/TEST]\n\nwidth = 100%\nwidth = 50%\n");
+
+  config conf{log, string{main_file}, "TEST"};
+  try {
+    config_parser{log, string{main_file}, "TEST"}.parse(conf);
+    FAIL() << "No syntax_error thrown";
+  } catch (const syntax_error& err) {
+    EXPECT_EQ(main_file + ":4: Duplicate key name \"width\" defined in section \"bar/TEST\"", err.what());
+  }
+}
+// }}}
@@ -0,0 +1,89 @@
+#include "components/config_schema.hpp"
+
+#include "common/test.hpp"
+#include "components/logger.hpp"
+#include "utils/color.hpp"
+
+using namespace polybar;
+using namespace std;
+
+class ConfigSchema : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    sectionmap_t sections;
+    sections["module/test"] = {{"interval", "5"}, {"label", "%output%"}, {"color", "#f00"}, {"bad-color", "nope"},
+        {"bad-ref", "${colors.missing}"}, {"maxlen", "10"}};
+    conf.set_sections(move(sections));
+  }
+
+  logger log{loglevel::NONE};
+  config conf{log, "/dev/zero", "TEST"};
+};
+
+TEST_F(ConfigSchema, load) {
+  int interval{1};
+  string label;
+  rgba color;
+  bool enabled{true};
+
+  config_schema{log, conf, "module/test"}
+      .optional("interval", interval)
+      .required("label", label)
+      .optional("color", color)
+      .optional("enabled", enabled)
+      .load();
+
+  EXPECT_EQ(5, interval);
+  EXPECT_EQ("%output%", label);
+  EXPECT_EQ(rgba{"#f00"}, color);
+  EXPECT_TRUE(enabled);
+}
+
+TEST_F(ConfigSchema, invalidOptional) {
+  rgba color{"#0f0"};
+  string ref{"default"};
+  int interval{1};
+
+  config_schema{log, conf, "module/test"}
+      .optional("bad-color", color)
+      .optional("bad-ref", ref)
+      .optional("interval", interval)
+      .load();
+
+  EXPECT_EQ(rgba{"#0f0"}, color);
+  EXPECT_EQ("default", ref);
+  EXPECT_EQ(5, interval);
+}
+
+TEST_F(ConfigSchema, reportsAllErrors) {
+  string exec;
+  string ref;
+  rgba color;
+
+  try {
+    config_schema{log, conf, "module/test"}
+        .required("exec", exec)
+        .optional("bad-color", color)
+        .required("bad-ref", ref)
+        .load();
+    FAIL() << "Expected value_error";
+  } catch (const value_error& err) {
+    string message{err.what()};
+    EXPECT_NE(string::npos, message.find("\"exec\" is missing"));
+    EXPECT_NE(string::npos, message.find("\"bad-color\" is invalid"));
+    EXPECT_NE(string::npos, message.find("\"bad-ref\" is invalid"));
+  }
+}
+
+TEST_F(ConfigSchema, renamed) {
+  size_t maxlen{0};
+  size_t width{3};
+
+  config_schema{log, conf, "module/test"}
+      .renamed("maxlen", "label-maxlen", maxlen)
+      .renamed("minwidth", "label-minwidth", width)
+      .load();
+
+  EXPECT_EQ(10, maxlen);
+  EXPECT_EQ(3, width);
+}
@@ -0,0 +1,58 @@
+#include "components/data_source.hpp"
+
+#include <stdexcept>
+#include <thread>
+
+#include "common/test.hpp"
+
+using namespace polybar;
+using namespace std;
+
+using source = data_source<int>;
+
+TEST(DataSource, sharesRecentReading) {
+  source sources;
+  int reads{0};
+  auto read = [&] { return ++reads; };
+
+  auto first = sources.get("a", chrono::hours{1}, read);
+  auto second = sources.get("a", chrono::hours{1}, read);
+
+  EXPECT_EQ(1, reads);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(1, *second);
+}
+
+TEST(DataSource, readsAgainWhenOutdated) {
+  source sources;
+  int reads{0};
+  auto read = [&] { return ++reads; };
+
+  auto first = sources.get("a", chrono::hours{1}, read);
+  this_thread::sleep_for(chrono::milliseconds{1});
+  auto second = sources.get("a", source::clock::duration::zero(), read);
+  this_thread::sleep_for(chrono::milliseconds{1});
+  auto third = sources.get("a", source::clock::duration::zero(), read);
+
+  EXPECT_EQ(1, *first);
+  EXPECT_EQ(2, *second);
+  EXPECT_EQ(3, *third);
+  EXPECT_NE(second, third);
+}
+
+TEST(DataSource, separateKeys) {
+  source sources;
+  int reads{0};
+  auto read = [&] { return ++reads; };
+
+  EXPECT_EQ(1, *sources.get("a", chrono::hours{1}, read));
+  EXPECT_EQ(2, *sources.get("b", chrono::hours{1}, read));
+  EXPECT_EQ(1, *sources.get("a", chrono::hours{1}, read));
+}
+
+TEST(DataSource, failedReadIsNotStored) {
+  source sources;
+
+  EXPECT_THROW(sources.get("a", chrono::hours{1}, []() -> int { throw runtime_error("failed"); }), runtime_error);
+  EXPECT_EQ(5, *sources.get("a", chrono::hours{1}, [] { return 5; }));
+}
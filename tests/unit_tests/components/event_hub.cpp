@@ -0,0 +1,74 @@
+#include "components/event_hub.hpp"
+
+#include <poll.h>
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+class counting_hub : public event_hub<int> {
+ public:
+  using event_hub<int>::publish;
+
+  int connects{0};
+  int disconnects{0};
+
+ protected:
+  model connect() override {
+    connects++;
+    return make_shared<const int>(0);
+  }
+
+  void disconnect() override {
+    disconnects++;
+  }
+};
+
+static bool readable(int fd) {
+  struct pollfd fds[1]{};
+  fds[0].fd = fd;
+  fds[0].events = POLLIN;
+  return poll(fds, 1, 0) == 1;
+}
+
+TEST(EventHub, connectsForFirstSubscriber) {
+  counting_hub hub;
+  {
+    auto first = hub.subscribe();
+    auto second = hub.subscribe();
+
+    EXPECT_EQ(1, hub.connects);
+    EXPECT_EQ(0, *first->take());
+    EXPECT_FALSE(readable(first->fd()));
+
+    first.reset();
+    EXPECT_EQ(0, hub.disconnects);
+  }
+  EXPECT_EQ(1, hub.disconnects);
+  EXPECT_EQ(nullptr, hub.latest());
+
+  auto again = hub.subscribe();
+  EXPECT_EQ(2, hub.connects);
+}
+
+TEST(EventHub, notifiesAllSubscribers) {
+  counting_hub hub;
+  auto first = hub.subscribe();
+  auto second = hub.subscribe();
+
+  hub.publish(make_shared<const int>(1));
+  EXPECT_TRUE(readable(first->fd()));
+  EXPECT_TRUE(readable(second->fd()));
+
+  EXPECT_EQ(1, *first->take());
+  EXPECT_FALSE(readable(first->fd()));
+  EXPECT_TRUE(readable(second->fd()));
+
+  // Subscribers that fall behind only see the latest model
+  hub.publish(make_shared<const int>(2));
+  hub.publish(make_shared<const int>(3));
+  auto model = second->take();
+  EXPECT_EQ(3, *model);
+  EXPECT_EQ(model, first->take());
+  EXPECT_FALSE(readable(second->fd()));
+}
@@ -0,0 +1,321 @@
+#include "components/ipc.hpp"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <cstddef>
+#include <cstring>
+
+#include "common/test.hpp"
+#include "components/logger.hpp"
+#include "components/reactor.hpp"
+#include "events/signal.hpp"
+#include "events/signal_emitter.hpp"
+#include "events/signal_receiver.hpp"
+#include "utils/file.hpp"
+#include "utils/string.hpp"
+
+using namespace polybar;
+using namespace std;
+
+namespace {
+  class receiver : public signal_receiver<0, signals::ipc::command, signals::ipc::hook, signals::ipc::action,
+                       signals::ipc::content> {
+   public:
+    bool on(const signals::ipc::command& evt) override {
+      messages.emplace_back("cmd:" + evt.cast());
+      return true;
+    }
+    bool on(const signals::ipc::hook& evt) override {
+      messages.emplace_back("hook:" + evt.cast());
+      return true;
+    }
+    bool on(const signals::ipc::action& evt) override {
+      messages.emplace_back("action:" + evt.cast());
+      return true;
+    }
+    bool on(const signals::ipc::content& evt) override {
+      messages.emplace_back("content:" + evt.cast());
+      return true;
+    }
+
+    vector<string> messages;
+  };
+}  // namespace
+
+class Ipc : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    m_sig.attach(&m_receiver);
+    m_ipc = make_unique<ipc>(m_sig, m_log, m_reactor);
+  }
+
+  void TearDown() override {
+    m_ipc.reset();
+    m_sig.detach(&m_receiver);
+  }
+
+  int connect_socket() const {
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    auto path = string_util::replace(PATH_MESSAGING_SOCKET, "%pid%", to_string(getpid()));
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+
+    int fd{socket(AF_UNIX, SOCK_SEQPACKET, 0)};
+    EXPECT_NE(-1, fd);
+    EXPECT_EQ(0, connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)));
+    return fd;
+  }
+
+  int connect_broker(const string& name) const {
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path + 1, name.data(), name.size());
+
+    int fd{socket(AF_UNIX, SOCK_SEQPACKET, 0)};
+    EXPECT_NE(-1, fd);
+    EXPECT_EQ(0, connect(fd, reinterpret_cast<struct sockaddr*>(&addr), offsetof(sockaddr_un, sun_path) + 1 + name.size()));
+    return fd;
+  }
+
+  void send(int fd, const string& data) const {
+    ASSERT_EQ(static_cast<ssize_t>(data.size()), ::send(fd, data.c_str(), data.size(), 0));
+  }
+
+  /**
+   * Serve all ready descriptors until nothing happens for a bit
+   */
+  void poll() {
+    while (m_reactor.poll(50) > 0) {
+    }
+  }
+
+  logger m_log{loglevel::NONE};
+  signal_emitter m_sig{};
+  reactor m_reactor{};
+  receiver m_receiver{};
+  unique_ptr<ipc> m_ipc;
+};
+
+TEST_F(Ipc, process) {
+  m_ipc->process("cmd:quit\nhook:module/test1\r\n\naction:#date.toggle\nunknown\ncontent:test 42 %\n"
+                 "cmd:restart");
+  EXPECT_EQ((vector<string>{"cmd:quit", "hook:module/test1", "action:#date.toggle", "content:test 42 %", "cmd:restart"}),
+      m_receiver.messages);
+}
+
+TEST_F(Ipc, socketBatches) {
+  int fd{connect_socket()};
+  send(fd, "hook:module/a1\nhook:module/a2\n");
+  poll();
+  send(fd, "cmd:hide\n");
+  poll();
+
+  int other{connect_socket()};
+  send(other, "action:#b.next\n");
+  close(other);
+  poll();
+  close(fd);
+  poll();
+
+  EXPECT_EQ((vector<string>{"hook:module/a1", "hook:module/a2", "cmd:hide", "action:#b.next"}), m_receiver.messages);
+}
+
+TEST_F(Ipc, fifo) {
+  auto path = string_util::replace(PATH_MESSAGING_FIFO, "%pid%", to_string(getpid()));
+
+  // The fifo keeps working after every writer closed it
+  for (const auto& message : {"cmd:show\n"s, "hook:module/c1"s}) {
+    file_descriptor fd{path, O_WRONLY | O_NONBLOCK};
+    ASSERT_EQ(static_cast<ssize_t>(message.size()), write(fd, message.c_str(), message.size()));
+  }
+  poll();
+
+  EXPECT_EQ((vector<string>{"cmd:show", "hook:module/c1"}), m_receiver.messages);
+}
+
+TEST_F(Ipc, snapshotOnlyFromSocket) {
+  auto path = string_util::replace(PATH_MESSAGING_FIFO, "%pid%", to_string(getpid()));
+  {
+    file_descriptor fd{path, O_WRONLY | O_NONBLOCK};
+    string message{"cmd:module:date snapshot=/tmp/a.png\ncmd:module:date pause\n"};
+    ASSERT_EQ(static_cast<ssize_t>(message.size()), write(fd, message.c_str(), message.size()));
+  }
+  poll();
+
+  int fd{connect_socket()};
+  send(fd, "cmd:module:date snapshot=/tmp/b.png\n");
+  close(fd);
+  poll();
+
+  EXPECT_EQ((vector<string>{"cmd:module:date pause", "cmd:module:date snapshot=/tmp/b.png"}), m_receiver.messages);
+}
+
+TEST_F(Ipc, fifoPartialLines) {
+  auto path = string_util::replace(PATH_MESSAGING_FIFO, "%pid%", to_string(getpid()));
+
+  {
+    // A message without a newline ends when its writer is done
+    file_descriptor fd{path, O_WRONLY | O_NONBLOCK};
+    ASSERT_EQ(14, write(fd, "hook:module/c1", 14));
+  }
+  poll();
+
+  {
+    // Lines are only complete once the newline was written
+    file_descriptor fd{path, O_WRONLY | O_NONBLOCK};
+    ASSERT_EQ(12, write(fd, "cmd:show\nhoo", 12));
+    poll();
+    EXPECT_EQ((vector<string>{"hook:module/c1", "cmd:show"}), m_receiver.messages);
+    ASSERT_EQ(11, write(fd, "k:module/c2", 11));
+    poll();
+    EXPECT_EQ(2, m_receiver.messages.size());
+    ASSERT_EQ(1, write(fd, "\n", 1));
+    poll();
+  }
+  poll();
+
+  EXPECT_EQ((vector<string>{"hook:module/c1", "cmd:show", "hook:module/c2"}), m_receiver.messages);
+}
+
+TEST_F(Ipc, subscribe) {
+  int all{connect_socket()};
+  int redraws{connect_socket()};
+  send(all, "subscribe:\n");
+  send(redraws, "subscribe:redraw, module-stop\n");
+  poll();
+
+  m_ipc->publish("visibility", "0");
+  m_ipc->publish("redraw", "1200");
+  m_ipc->publish("command", "notify-send\nhi");
+
+  char buffer[256];
+  ssize_t size = recv(all, buffer, sizeof(buffer), MSG_DONTWAIT);
+  ASSERT_GT(size, 0);
+  EXPECT_EQ("visibility 0\n", string(buffer, size));
+  size = recv(all, buffer, sizeof(buffer), MSG_DONTWAIT);
+  ASSERT_GT(size, 0);
+  EXPECT_EQ("redraw 1200\n", string(buffer, size));
+  size = recv(all, buffer, sizeof(buffer), MSG_DONTWAIT);
+  ASSERT_GT(size, 0);
+  EXPECT_EQ("command notify-send hi\n", string(buffer, size));
+
+  size = recv(redraws, buffer, sizeof(buffer), MSG_DONTWAIT);
+  ASSERT_GT(size, 0);
+  EXPECT_EQ("redraw 1200\n", string(buffer, size));
+  EXPECT_EQ(-1, recv(redraws, buffer, sizeof(buffer), MSG_DONTWAIT));
+
+  close(all);
+  close(redraws);
+  poll();
+  m_ipc->publish("redraw", "1");
+}
+
+TEST_F(Ipc, query) {
+  m_ipc->set_query_handler([](const string& module, string& output, string& text) {
+    if (module != "date") {
+      return false;
+    }
+    output = "%{F#f00}12:00%{F-}";
+    text = "12:00";
+    return true;
+  });
+
+  int fd{connect_socket()};
+  char buffer[256];
+  const auto ask = [&](const string& query) {
+    send(fd, query);
+    poll();
+    ssize_t size = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    return size > 0 ? string(buffer, size) : string{};
+  };
+
+  EXPECT_EQ("ok %{F#f00}12:00%{F-}\n", ask("get:date\n"));
+  EXPECT_EQ("ok 12:00\n", ask("get:date text\n"));
+  EXPECT_EQ("ok {\"module\":\"date\",\"output\":\"%{F#f00}12:00%{F-}\",\"text\":\"12:00\"}\n", ask("get:date json\n"));
+  EXPECT_EQ("error No module named \"cpu\"\n", ask("get:cpu\n"));
+  EXPECT_EQ("error Unknown format \"xml\"\n", ask("get:date xml\n"));
+  close(fd);
+}
+
+TEST_F(Ipc, queryStats) {
+  int fd{connect_socket()};
+  char buffer[256];
+  const auto ask = [&]() {
+    send(fd, "get-stats\n");
+    poll();
+    ssize_t size = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    return size > 0 ? string(buffer, size) : string{};
+  };
+
+  EXPECT_EQ("error No statistics\n", ask());
+  m_ipc->set_stats_handler([] { return vector<string>{"Redraw timings:", "  flush p50 1.0ms"}; });
+  EXPECT_EQ("ok Redraw timings:\n  flush p50 1.0ms\n", ask());
+  close(fd);
+}
+
+TEST_F(Ipc, broker) {
+  auto name = "polybar_test_broker." + to_string(getpid());
+  auto broker = make_unique<ipc>(m_sig, m_log, m_reactor);
+  broker->join_broker("top", "DP-1", name);
+  m_ipc->join_broker("bottom", "HDMI-1", name);
+
+  // Another bar, as the broker sees it
+  int bar{connect_broker(name)};
+  send(bar, "register:side DP-1\n");
+  poll();
+
+  int fd{connect_broker(name)};
+  send(fd, "to:all cmd:hide\nto:bar:bottom hook:module/a1\nto:monitor:DP-1 cmd:show\nto:bar:none cmd:quit\n");
+  send(fd, "to:all get:date\nto:everyone cmd:quit\n");
+  close(fd);
+  poll();
+
+  // Both bars emit to the same receiver, the broker handles its messages first
+  EXPECT_EQ((vector<string>{"cmd:hide", "cmd:show", "cmd:hide", "hook:module/a1"}), m_receiver.messages);
+
+  char buffer[256];
+  vector<string> received;
+  ssize_t size;
+  while ((size = recv(bar, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+    received.emplace_back(buffer, size);
+  }
+  EXPECT_EQ((vector<string>{"cmd:hide\n", "cmd:show\n"}), received);
+
+  // The remaining bar takes over once the broker is gone
+  broker.reset();
+  poll();
+  m_receiver.messages.clear();
+
+  fd = connect_broker(name);
+  send(fd, "to:bar:bottom cmd:restart\n");
+  close(fd);
+  poll();
+
+  EXPECT_EQ((vector<string>{"cmd:restart"}), m_receiver.messages);
+  close(bar);
+}
+
+TEST_F(Ipc, brokerRetry) {
+  auto name = "polybar_test_broker." + to_string(getpid());
+
+  // Holds the name, but doesn't listen yet
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path + 1, name.data(), name.size());
+  int pending{socket(AF_UNIX, SOCK_SEQPACKET, 0)};
+  ASSERT_EQ(0, bind(pending, reinterpret_cast<struct sockaddr*>(&addr), offsetof(sockaddr_un, sun_path) + 1 + name.size()));
+
+  // Returns right away, the election is retried from the reactor
+  m_ipc->join_broker("bottom", "HDMI-1", name);
+  close(pending);
+  poll();
+
+  int fd{connect_broker(name)};
+  send(fd, "to:bar:bottom cmd:restart\n");
+  close(fd);
+  poll();
+
+  EXPECT_EQ((vector<string>{"cmd:restart"}), m_receiver.messages);
+}
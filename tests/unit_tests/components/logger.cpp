@@ -0,0 +1,99 @@
+#include "components/logger.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+class Logger : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(0, pipe2(m_fds, O_NONBLOCK | O_CLOEXEC));
+  }
+
+  void TearDown() override {
+    close(m_fds[0]);
+    close(m_fds[1]);
+  }
+
+  string output() {
+    string result;
+    char buffer[4096];
+    ssize_t bytes;
+    while ((bytes = read(m_fds[0], buffer, sizeof(buffer))) > 0) {
+      result.append(buffer, bytes);
+    }
+    return result;
+  }
+
+  int m_fds[2];
+};
+
+TEST_F(Logger, formatsMessages) {
+  logger log{loglevel::INFO, m_fds[1]};
+  log.info("%s has %d items", string{"queue"}, 3);
+  log.err("failed");
+  log.flush();
+
+  EXPECT_EQ("polybar|info:  queue has 3 items\npolybar|error: failed\n", output());
+}
+
+TEST_F(Logger, skipsDisabledLevels) {
+  logger log{loglevel::WARNING, m_fds[1]};
+  log.info("hidden");
+  log.notice("hidden");
+  log.warn("shown");
+  log.flush();
+
+  EXPECT_EQ("polybar|warn:  shown\n", output());
+}
+
+TEST_F(Logger, longMessages) {
+  logger log{loglevel::INFO, m_fds[1]};
+  string message(1000, 'x');
+  log.info("%s", message);
+  log.flush();
+
+  EXPECT_EQ("polybar|info:  " + message + "\n", output());
+}
+
+TEST_F(Logger, destructorWritesQueuedMessages) {
+  {
+    logger log{loglevel::INFO, m_fds[1]};
+    log.info("first");
+    log.info("second");
+  }
+
+  EXPECT_EQ("polybar|info:  first\npolybar|info:  second\n", output());
+}
+
+TEST_F(Logger, keepsOrderPerThread) {
+  logger log{loglevel::INFO, m_fds[1]};
+  vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&log, t] {
+      for (int i = 0; i < 100; i++) {
+        log.info("%d %d", t, i);
+      }
+    });
+  }
+  for (auto&& thread : threads) {
+    thread.join();
+  }
+  log.flush();
+
+  vector<int> next(4, 0);
+  auto lines = output();
+  size_t count{0};
+  size_t pos{0};
+  while ((pos = lines.find("polybar|info:  ", pos)) != string::npos) {
+    int t, i;
+    ASSERT_EQ(2, sscanf(lines.c_str() + pos, "polybar|info:  %d %d", &t, &i));
+    EXPECT_EQ(next[t]++, i);
+    count++;
+    pos++;
+  }
+  EXPECT_EQ(400, count);
+}
@@ -0,0 +1,70 @@
+#include "components/offscreen_renderer.hpp"
+
+#include "common/test.hpp"
+#include "components/logger.hpp"
+
+using namespace polybar;
+
+TEST(OffscreenRenderer, drawsBlocks) {
+  bar_settings bar{};
+  bar.background = rgba{0xFF000000};
+  bar.foreground = rgba{0xFFFFFFFF};
+
+  offscreen_renderer renderer(logger::make(), bar, 100, 20, {});
+  renderer.begin();
+  renderer.change_alignment(alignment::RIGHT);
+  renderer.draw_graph(tags::graph_type::BAR, 40, {1.0});
+  renderer.end();
+
+  EXPECT_EQ(0xFF000000, renderer.pixel(10, 10));
+  EXPECT_EQ(0xFFFFFFFF, renderer.pixel(80, 10));
+  // The graph takes the middle half of the height
+  EXPECT_EQ(0xFF000000, renderer.pixel(80, 2));
+
+  // Every frame starts from the background
+  renderer.begin();
+  renderer.end();
+  EXPECT_EQ(0xFF000000, renderer.pixel(80, 10));
+}
+
+TEST(OffscreenRenderer, reservesWidth) {
+  bar_settings bar{};
+  bar.background = rgba{0xFF000000};
+  bar.foreground = rgba{0xFFFFFFFF};
+
+  offscreen_renderer renderer(logger::make(), bar, 100, 20, {});
+  renderer.begin();
+  renderer.change_alignment(alignment::LEFT);
+  // Cut off at the fixed width
+  renderer.reserve_width(tags::reserved_width{10, false, true});
+  renderer.draw_graph(tags::graph_type::BAR, 40, {1.0});
+  renderer.control(tags::controltag::R);
+  renderer.change_alignment(alignment::RIGHT);
+  // Padded up to the minimum width, the graph starts at its left edge
+  renderer.reserve_width(tags::reserved_width{60, false, false});
+  renderer.draw_graph(tags::graph_type::BAR, 20, {1.0});
+  renderer.control(tags::controltag::R);
+  renderer.end();
+
+  EXPECT_EQ(0xFFFFFFFF, renderer.pixel(5, 10));
+  EXPECT_EQ(0xFF000000, renderer.pixel(20, 10));
+  EXPECT_EQ(0xFFFFFFFF, renderer.pixel(50, 10));
+  EXPECT_EQ(0xFF000000, renderer.pixel(80, 10));
+}
+
+TEST(OffscreenRenderer, contentWidth) {
+  bar_settings bar{};
+  offscreen_renderer renderer(logger::make(), bar, 100, 20, {});
+  renderer.begin();
+  renderer.change_alignment(alignment::LEFT);
+  renderer.reserve_width(tags::reserved_width{30, false, false});
+  renderer.draw_graph(tags::graph_type::BAR, 20, {1.0});
+  renderer.control(tags::controltag::R);
+  renderer.draw_graph(tags::graph_type::BAR, 5, {1.0});
+  renderer.end();
+  EXPECT_EQ(35, renderer.content_width());
+
+  renderer.begin();
+  renderer.end();
+  EXPECT_EQ(0, renderer.content_width());
+}
@@ -0,0 +1,95 @@
+#include "components/power_policy.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+
+#include "common/test.hpp"
+#include "common/wait.hpp"
+#include "components/logger.hpp"
+#include "utils/file.hpp"
+
+using namespace polybar;
+using namespace std;
+
+class PowerPolicy : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/polybar-testXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    m_dir = dir;
+  }
+
+  void TearDown() override {
+    for (auto&& supply : m_supplies) {
+      unlink((supply + "/online").c_str());
+      rmdir(supply.c_str());
+    }
+    rmdir(m_dir.c_str());
+  }
+
+  void supply(const string& name, const string& online) {
+    auto path = m_dir + "/" + name;
+    file_util::create_directories(path);
+    file_util::write_contents(path + "/online", online + "\n");
+    m_supplies.emplace_back(path);
+  }
+
+  string m_dir;
+  vector<string> m_supplies;
+};
+
+TEST_F(PowerPolicy, noSupplies) {
+  EXPECT_FALSE(power_policy::on_battery(m_dir));
+}
+
+TEST_F(PowerPolicy, online) {
+  supply("AC", "1");
+  EXPECT_FALSE(power_policy::on_battery(m_dir));
+}
+
+TEST_F(PowerPolicy, offline) {
+  supply("AC", "0");
+  EXPECT_TRUE(power_policy::on_battery(m_dir));
+}
+
+TEST_F(PowerPolicy, anyOnline) {
+  supply("AC", "0");
+  supply("ucsi-source-psy-USBC000:001", "1");
+  EXPECT_FALSE(power_policy::on_battery(m_dir));
+}
+
+TEST_F(PowerPolicy, lowPowerStretchesIntervals) {
+  using namespace std::chrono_literals;
+  scheduler s{logger::make(), 1};
+  std::atomic<int> count{0};
+  std::atomic<int> kept{0};
+  auto id = s.add("test", 10ms, [&] { count++; }, 0ms, 0ms, scheduler::STRETCHABLE);
+  auto kept_id = s.add("test.kept", 10ms, [&] { kept++; });
+
+  {
+    power_policy policy{logger::make(), s, 1.0, 1000.0, m_dir};
+    EXPECT_TRUE(wait_for([&] { return count >= 2; }));
+    policy.set_low_power(true);
+
+    // The task runs at most once more at its current deadline, the next one
+    // is 10s from now
+    int stretched_at = count;
+    int kept_at = kept;
+    EXPECT_TRUE(wait_for([&] { return kept >= kept_at + 10; }));
+    EXPECT_LE(count, stretched_at + 1);
+
+    policy.set_low_power(false);
+    stretched_at = count;
+    EXPECT_TRUE(wait_for([&] { return count >= stretched_at + 3; }));
+
+    policy.set_low_power(true);
+  }
+
+  // Destroying the policy restores the intervals
+  int at = count;
+  EXPECT_TRUE(wait_for([&] { return count >= at + 3; }));
+
+  s.remove(id);
+  s.remove(kept_id);
+}
@@ -0,0 +1,220 @@
+#include "components/scheduler.hpp"
+
+#include <atomic>
+
+#include "common/test.hpp"
+#include "common/wait.hpp"
+#include "components/logger.hpp"
+
+using namespace polybar;
+using namespace std::chrono_literals;
+
+class Scheduler : public ::testing::Test {
+ protected:
+  scheduler s{logger::make(), 2};
+};
+
+TEST_F(Scheduler, runsImmediately) {
+  std::atomic<int> count{0};
+  auto id = s.add("test", 1h, [&] { count++; });
+
+  EXPECT_NE(0, id);
+  EXPECT_TRUE(wait_for([&] { return count == 1; }));
+
+  s.remove(id);
+}
+
+TEST_F(Scheduler, interval) {
+  std::atomic<int> count{0};
+  auto id = s.add("test", 10ms, [&] { count++; });
+
+  EXPECT_TRUE(wait_for([&] { return count >= 3; }));
+
+  s.remove(id);
+  int removed_at = count;
+  std::this_thread::sleep_for(50ms);
+  EXPECT_EQ(removed_at, count);
+}
+
+TEST_F(Scheduler, submit) {
+  std::atomic<int> count{0};
+  s.submit([&] { count++; });
+
+  EXPECT_TRUE(wait_for([&] { return count == 1; }));
+}
+
+TEST_F(Scheduler, trigger) {
+  std::atomic<int> count{0};
+  auto id = s.add("test", 1h, [&] { count++; });
+
+  EXPECT_TRUE(wait_for([&] { return count == 1; }));
+  s.trigger(id);
+  EXPECT_TRUE(wait_for([&] { return count == 2; }));
+
+  s.remove(id);
+}
+
+TEST_F(Scheduler, removeFromCallback) {
+  std::atomic<int> count{0};
+  scheduler::task_id id{0};
+  std::atomic<bool> added{false};
+
+  id = s.add("test", 1ms, [&] {
+    while (!added) {
+      std::this_thread::yield();
+    }
+    count++;
+    s.remove(id);
+  });
+  added = true;
+
+  EXPECT_TRUE(wait_for([&] { return count == 1; }));
+  std::this_thread::sleep_for(20ms);
+  EXPECT_EQ(1, count);
+}
+
+TEST_F(Scheduler, slackBatchesWakeups) {
+  using clock = scheduler::clock;
+  std::mutex lock;
+  vector<clock::time_point> b;
+
+  // b becomes due 40ms after a, but may wait until a's next run 60ms later
+  std::atomic<int> a{0};
+  auto id_a = s.add("test.a", 100ms, [&] { a++; });
+  auto id_b = s.add(
+      "test.b", 100ms,
+      [&] {
+        std::lock_guard<std::mutex> guard(lock);
+        b.emplace_back(clock::now());
+      },
+      40ms, 80ms);
+
+  EXPECT_TRUE(wait_for([&] {
+    std::lock_guard<std::mutex> guard(lock);
+    return a >= 3 && b.size() >= 3;
+  }));
+
+  s.remove(id_a);
+  s.remove(id_b);
+
+  // The first run of both happens right away and is not aligned. Every other
+  // run of b waits for the wakeup of a, which is never before the multiple of
+  // the interval following b's own deadline. Being late doesn't matter here.
+  for (size_t i = 1; i < b.size(); i++) {
+    auto since_epoch = b[i - 1].time_since_epoch();
+    auto boundary = b[i - 1] + (100ms - since_epoch % clock::duration(100ms));
+    EXPECT_GE(b[i], boundary + 100ms);
+  }
+}
+
+TEST_F(Scheduler, deferRunsOnceAfterDelay) {
+  using clock = scheduler::clock;
+  std::atomic<int> count{0};
+  auto start = clock::now();
+  std::atomic<clock::time_point::rep> ran{0};
+
+  s.defer(50ms, [&] {
+    ran = (clock::now() - start).count();
+    count++;
+  });
+
+  EXPECT_TRUE(wait_for([&] { return count == 1; }));
+  EXPECT_GE(ran, clock::duration(50ms).count());
+
+  std::this_thread::sleep_for(100ms);
+  EXPECT_EQ(1, count);
+}
+
+TEST_F(Scheduler, suspendParksTasks) {
+  std::atomic<int> count{0};
+  std::atomic<int> kept{0};
+  auto id = s.add("test", 10ms, [&] { count++; });
+  auto kept_id = s.add("test.kept", 10ms, [&] { kept++; }, 0ms, 0ms, 0);
+
+  EXPECT_TRUE(wait_for([&] { return count >= 2; }));
+  s.suspend(true);
+
+  // Each task runs once more at its current deadline
+  std::this_thread::sleep_for(30ms);
+  int suspended_at = count;
+  int kept_at = kept;
+  std::this_thread::sleep_for(50ms);
+  EXPECT_EQ(suspended_at, count);
+  EXPECT_GT(kept, kept_at);
+
+  // Parked tasks run right away once resumed
+  s.suspend(false);
+  EXPECT_TRUE(wait_for([&] { return count > suspended_at; }));
+
+  s.remove(id);
+  s.remove(kept_id);
+}
+
+TEST_F(Scheduler, intervalFactorStretchesTasks) {
+  std::atomic<int> stretched{0};
+  std::atomic<int> kept{0};
+  auto id = s.add("test", 20ms, [&] { stretched++; }, 0ms, 0ms, scheduler::STRETCHABLE);
+  auto kept_id = s.add("test.kept", 20ms, [&] { kept++; });
+
+  EXPECT_TRUE(wait_for([&] { return stretched >= 1 && kept >= 1; }));
+  s.set_interval_factor(100);
+
+  // The stretched task waits for its new deadline, 2s from now at the latest
+  int stretched_at = stretched;
+  int kept_at = kept;
+  std::this_thread::sleep_for(200ms);
+  EXPECT_LE(stretched, stretched_at + 1);
+  EXPECT_GE(kept, kept_at + 5);
+
+  s.set_interval_factor(1);
+  EXPECT_TRUE(wait_for([&] { return stretched >= stretched_at + 2; }));
+
+  s.remove(id);
+  s.remove(kept_id);
+}
+
+TEST_F(Scheduler, setInterval) {
+  std::atomic<int> count{0};
+  auto id = s.add("test", 1h, [&] { count++; });
+
+  EXPECT_TRUE(wait_for([&] { return count == 1; }));
+
+  // The waiting task gets a new deadline right away
+  s.set_interval(id, 10ms);
+  EXPECT_TRUE(wait_for([&] { return count >= 3; }));
+
+  s.remove(id);
+}
+
+TEST_F(Scheduler, pauseParksTask) {
+  std::atomic<int> count{0};
+  std::atomic<int> other{0};
+  auto id = s.add("test", 10ms, [&] { count++; });
+  auto other_id = s.add("test.other", 10ms, [&] { other++; });
+
+  EXPECT_TRUE(wait_for([&] { return count >= 2; }));
+  s.pause(id, true);
+
+  // A run that was already due may still finish while the other task runs twice
+  int other_at = other;
+  EXPECT_TRUE(wait_for([&] { return other >= other_at + 2; }));
+  int paused_at = count;
+  other_at = other;
+  EXPECT_TRUE(wait_for([&] { return other >= other_at + 5; }));
+  EXPECT_EQ(paused_at, count);
+
+  // Triggering runs it once, resuming the scheduler doesn't resume it
+  s.trigger(id);
+  EXPECT_TRUE(wait_for([&] { return count == paused_at + 1; }));
+  s.suspend(true);
+  s.suspend(false);
+  other_at = other;
+  EXPECT_TRUE(wait_for([&] { return other >= other_at + 5; }));
+  EXPECT_EQ(paused_at + 1, count);
+
+  s.pause(id, false);
+  EXPECT_TRUE(wait_for([&] { return count >= paused_at + 3; }));
+
+  s.remove(id);
+  s.remove(other_id);
+}
@@ -0,0 +1,162 @@
+#include "components/script_runner.hpp"
+
+#include <atomic>
+
+#include "common/test.hpp"
+#include "common/wait.hpp"
+#include "components/logger.hpp"
+#include "utils/file.hpp"
+
+using namespace polybar;
+using namespace std::chrono_literals;
+
+class ScriptRunner : public ::testing::Test {
+ protected:
+  script_runner r{logger::make(), 2};
+};
+
+TEST_F(ScriptRunner, collectsOutput) {
+  std::mutex lock;
+  script_runner::result result;
+  std::atomic<bool> done{false};
+
+  auto id = r.add(
+      "", [] { return "echo polybar; exit 3"s; },
+      [&](const script_runner::result& res) {
+        std::lock_guard<std::mutex> guard(lock);
+        result = res;
+        done = true;
+        return script_runner::duration(1h);
+      },
+      1h);
+
+  EXPECT_NE(0, id);
+  ASSERT_TRUE(wait_for([&] { return done.load(); }, 2s));
+
+  std::lock_guard<std::mutex> guard(lock);
+  EXPECT_TRUE(result.ran);
+  EXPECT_EQ(3, result.status);
+  EXPECT_EQ("polybar\n", result.output);
+
+  r.remove(id);
+}
+
+TEST_F(ScriptRunner, condition) {
+  std::atomic<int> commands{0};
+  std::atomic<bool> ran{true};
+  std::atomic<bool> done{false};
+
+  auto id = r.add(
+      "exit 1",
+      [&] {
+        commands++;
+        return "true"s;
+      },
+      [&](const script_runner::result& res) {
+        ran = res.ran;
+        done = true;
+        return script_runner::duration(1h);
+      },
+      1h);
+
+  ASSERT_TRUE(wait_for([&] { return done.load(); }, 2s));
+  EXPECT_FALSE(ran);
+  EXPECT_EQ(0, commands);
+
+  r.remove(id);
+}
+
+TEST_F(ScriptRunner, concurrencyCap) {
+  std::atomic<int> running{0};
+  std::atomic<int> peak{0};
+  std::atomic<int> finished{0};
+  vector<script_runner::script_id> ids;
+
+  for (int i = 0; i < 5; i++) {
+    ids.emplace_back(r.add(
+        "",
+        [&] {
+          int now = ++running;
+          int expected = peak;
+          while (now > expected && !peak.compare_exchange_weak(expected, now)) {
+          }
+          return "sleep 0.05"s;
+        },
+        [&](const script_runner::result&) {
+          running--;
+          finished++;
+          return script_runner::duration(1h);
+        },
+        1h));
+  }
+
+  EXPECT_TRUE(wait_for([&] { return finished == 5; }, 2s));
+  EXPECT_LE(peak, 2);
+
+  for (auto id : ids) {
+    r.remove(id);
+  }
+}
+
+TEST_F(ScriptRunner, removeTerminates) {
+  std::atomic<bool> done{false};
+  auto id = r.add(
+      "", [] { return "sleep 10"s; },
+      [&](const script_runner::result&) {
+        done = true;
+        return script_runner::duration(1h);
+      },
+      1h);
+
+  std::this_thread::sleep_for(50ms);
+  auto start = std::chrono::steady_clock::now();
+  r.remove(id);
+
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+  EXPECT_FALSE(done);
+}
+
+TEST_F(ScriptRunner, removeKillsIgnoredTerm) {
+  char path[] = "/tmp/polybar-testXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(fd, -1);
+  close(fd);
+
+  auto id = r.add(
+      "", [&] { return "echo $$ > "s + path + "; trap '' TERM; sleep 10"; },
+      [](const script_runner::result&) { return script_runner::duration(1h); }, 1h);
+
+  pid_t pid{0};
+  ASSERT_TRUE(wait_for([&] { return (pid = atoi(file_util::contents(path).c_str())) > 0; }, 2s));
+
+  auto start = std::chrono::steady_clock::now();
+  r.remove(id);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 100ms);
+
+  // Gone once it was killed and reaped
+  EXPECT_TRUE(wait_for([&] { return kill(pid, 0) == -1; }, 2s));
+  unlink(path);
+}
+
+TEST_F(ScriptRunner, memoizesCondition) {
+  char path[] = "/tmp/polybar-testXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(-1, fd);
+  close(fd);
+
+  std::atomic<int> runs{0};
+  auto id = r.add(
+      "echo >> "s + path, [] { return "true"s; },
+      [&](const script_runner::result& res) {
+        EXPECT_TRUE(res.ran);
+        runs++;
+        return script_runner::duration(1ms);
+      },
+      1ms, 1h);
+
+  EXPECT_TRUE(wait_for([&] { return runs >= 3; }, 2s));
+  r.remove(id);
+
+  EXPECT_EQ("\n", file_util::contents(path));
+  unlink(path);
+}
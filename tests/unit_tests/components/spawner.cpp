@@ -0,0 +1,63 @@
+#include "components/spawner.hpp"
+
+#include <unistd.h>
+
+#include <thread>
+
+#include "common/test.hpp"
+#include "utils/file.hpp"
+
+using namespace polybar;
+using namespace std;
+
+namespace {
+  bool wait_for_file(const string& path) {
+    for (int i = 0; i < 200 && !file_util::exists(path); i++) {
+      this_thread::sleep_for(chrono::milliseconds{10});
+    }
+    return file_util::exists(path);
+  }
+}  // namespace
+
+class Spawner : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/polybar-testXXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    m_dir = dir;
+  }
+
+  void TearDown() override {
+    unlink((m_dir + "/first").c_str());
+    unlink((m_dir + "/second").c_str());
+    rmdir(m_dir.c_str());
+  }
+
+  string m_dir;
+};
+
+TEST_F(Spawner, runsCommands) {
+  spawner s;
+  ASSERT_TRUE(s.start());
+  EXPECT_TRUE(s.running());
+
+  s.spawn("touch " + m_dir + "/first");
+  s.spawn("touch " + m_dir + "/second");
+
+  EXPECT_TRUE(wait_for_file(m_dir + "/first"));
+  EXPECT_TRUE(wait_for_file(m_dir + "/second"));
+
+  s.stop();
+  EXPECT_FALSE(s.running());
+}
+
+/**
+ * Commands are forked from the calling process if there is no helper
+ */
+TEST_F(Spawner, withoutHelper) {
+  spawner s;
+  EXPECT_FALSE(s.running());
+
+  s.spawn("touch " + m_dir + "/first");
+  EXPECT_TRUE(wait_for_file(m_dir + "/first"));
+}
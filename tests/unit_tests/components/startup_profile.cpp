@@ -0,0 +1,69 @@
+#include "components/startup_profile.hpp"
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+TEST(StartupProfile, disabled) {
+  startup_profile profile;
+  auto now = startup_profile::clock::now();
+  profile.record("config", now, now + chrono::milliseconds{5});
+  profile.mark("frame");
+
+  EXPECT_TRUE(profile.report().empty());
+}
+
+TEST(StartupProfile, report) {
+  startup_profile profile;
+  profile.enable("");
+  auto now = startup_profile::clock::now();
+
+  // Ordered by start time, not by the time they were added
+  profile.record("bar", now + chrono::milliseconds{10}, now + chrono::milliseconds{30});
+  profile.record("config", now, now + chrono::milliseconds{5});
+  profile.mark("frame");
+
+  auto lines = profile.report();
+  ASSERT_EQ(3, lines.size());
+  EXPECT_NE(string::npos, lines[0].find("+     5.0  [")) << lines[0];
+  EXPECT_NE(string::npos, lines[0].find("] config"));
+  EXPECT_NE(string::npos, lines[1].find("] frame"));
+  EXPECT_NE(string::npos, lines[2].find("+    20.0  [")) << lines[2];
+  EXPECT_NE(string::npos, lines[2].find("] bar"));
+}
+
+TEST(StartupProfile, trace) {
+  startup_profile profile;
+  profile.enable("");
+  auto now = startup_profile::clock::now();
+
+  profile.record("module/\"quoted\"", now, now + chrono::microseconds{1500});
+  profile.mark("frame");
+
+  auto trace = profile.trace();
+  EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+  EXPECT_NE(string::npos, trace.find("\"name\":\"module/\\\"quoted\\\"\""));
+  EXPECT_NE(string::npos, trace.find("\"ph\":\"X\",\"dur\":1500}"));
+  EXPECT_NE(string::npos, trace.find("\"name\":\"frame\""));
+  EXPECT_NE(string::npos, trace.find("\"ph\":\"i\""));
+}
+
+TEST(StartupProfile, phase) {
+  auto& profile = startup_profile::make();
+  profile.enable("");
+  { startup_profile::phase phase{"scope"}; }
+
+  auto lines = profile.report();
+  ASSERT_EQ(1, lines.size());
+  EXPECT_NE(string::npos, lines[0].find("] scope"));
+
+  testing::internal::CaptureStderr();
+  profile.finish();
+  auto output = testing::internal::GetCapturedStderr();
+  EXPECT_EQ(0, output.find("Startup profile"));
+
+  // Nothing is recorded after the profile is finished
+  EXPECT_FALSE(profile.enabled());
+  { startup_profile::phase phase{"after"}; }
+  EXPECT_EQ(1, profile.report().size());
+}
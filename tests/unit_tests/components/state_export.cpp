@@ -0,0 +1,94 @@
+#include "components/state_export.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "common/test.hpp"
+#include "drawtypes/label.hpp"
+
+using namespace polybar;
+
+/**
+ * Reads the values the way an external program would
+ */
+static string read_state(const string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat st {};
+  fstat(fd, &st);
+  auto map = static_cast<const char*>(mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0));
+  close(fd);
+
+  string json;
+  while (true) {
+    uint64_t before = __atomic_load_n(reinterpret_cast<const uint64_t*>(map + 16), __ATOMIC_ACQUIRE);
+    uint64_t length = __atomic_load_n(reinterpret_cast<const uint64_t*>(map + 24), __ATOMIC_RELAXED);
+    json.assign(map + state_export::HEADER_SIZE, length);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t after = __atomic_load_n(reinterpret_cast<const uint64_t*>(map + 16), __ATOMIC_RELAXED);
+    if (before == after && before % 2 == 0) {
+      break;
+    }
+  }
+
+  EXPECT_EQ(0, memcmp(map, "PLYSTATE", 8));
+  munmap(const_cast<char*>(map), st.st_size);
+  return json;
+}
+
+class StateExport : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char path[] = "/tmp/polybar-testXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_NE(-1, fd);
+    close(fd);
+    m_path = path;
+    state_export::make().open(m_path);
+  }
+
+  void TearDown() override {
+    state_export::make().close();
+    unlink(m_path.c_str());
+  }
+
+  string m_path;
+};
+
+TEST_F(StateExport, capturesReplacedTokens) {
+  drawtypes::label label{"%percentage%%"};
+
+  state_export::values values;
+  {
+    state_export::capture capture;
+    label.replace_token("%percentage%", "42");
+    label.replace_token("%unused%", "x");
+    values = capture.take();
+
+    // Tokens replaced after take() aren't captured
+    label.replace_token("%percentage%", "43");
+  }
+
+  state_export::values expected{{"%percentage%", "42"}, {"%unused%", "x"}};
+  EXPECT_EQ(expected, values);
+}
+
+TEST_F(StateExport, publishesValues) {
+  EXPECT_EQ("{}", read_state(m_path));
+
+  state_export::make().update("cpu", {{"percentage", "42"}});
+  state_export::make().update("date", {{"date", "\"today\""}, {"time", "12:00"}});
+  EXPECT_EQ(R"({"cpu":{"percentage":"42"},"date":{"date":"\"today\"","time":"12:00"}})", read_state(m_path));
+
+  state_export::make().remove("cpu");
+  EXPECT_EQ(R"({"date":{"date":"\"today\"","time":"12:00"}})", read_state(m_path));
+}
+
+TEST_F(StateExport, growsFile) {
+  string large(2 * state_export::INITIAL_SIZE, 'x');
+  state_export::make().update("text", {{"text", large}});
+  EXPECT_EQ(R"({"text":{"text":")" + large + R"("}})", read_state(m_path));
+}
@@ -0,0 +1,103 @@
+#include "components/stats.hpp"
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+TEST(Histogram, empty) {
+  histogram h;
+  auto summary = h.summarize();
+
+  EXPECT_EQ(0, summary.count);
+  EXPECT_EQ(0, summary.total);
+  EXPECT_DOUBLE_EQ(0.0, summary.max);
+}
+
+TEST(Histogram, summarize) {
+  histogram h;
+
+  for (int i = 1; i <= 100; i++) {
+    h.record(chrono::milliseconds(i));
+  }
+
+  auto summary = h.summarize();
+
+  EXPECT_EQ(100, summary.count);
+  EXPECT_EQ(100, summary.total);
+  EXPECT_DOUBLE_EQ(5050.0, summary.sum);
+  EXPECT_DOUBLE_EQ(50.5, summary.avg);
+  EXPECT_DOUBLE_EQ(50.0, summary.p50);
+  EXPECT_DOUBLE_EQ(95.0, summary.p95);
+  EXPECT_DOUBLE_EQ(100.0, summary.max);
+}
+
+TEST(Histogram, rolling) {
+  histogram h;
+
+  h.record(chrono::seconds(1));
+
+  for (size_t i = 0; i < histogram::WINDOW; i++) {
+    h.record(chrono::milliseconds(2));
+  }
+
+  auto summary = h.summarize();
+
+  EXPECT_EQ(histogram::WINDOW, summary.count);
+  EXPECT_EQ(histogram::WINDOW + 1, summary.total);
+  EXPECT_DOUBLE_EQ(2.0, summary.max);
+
+  h.reset();
+  EXPECT_EQ(0, h.summarize().count);
+}
+
+TEST(HitCounter, rate) {
+  hit_counter c;
+  EXPECT_DOUBLE_EQ(0.0, c.rate());
+
+  c.hit();
+  c.hit();
+  c.hit();
+  c.miss();
+
+  EXPECT_EQ(3, c.hits());
+  EXPECT_EQ(1, c.misses());
+  EXPECT_DOUBLE_EQ(0.75, c.rate());
+
+  c.reset();
+  EXPECT_EQ(0, c.hits());
+  EXPECT_EQ(0, c.misses());
+}
+
+TEST(Stats, report) {
+  auto& registry = stats::make();
+
+  EXPECT_EQ(&registry.get("test.a"), &registry.get("test.a"));
+  EXPECT_TRUE(registry.report().empty());
+
+  registry.get("test.b").record(chrono::milliseconds(1));
+  auto report = registry.report();
+
+  ASSERT_EQ(1, report.size());
+  EXPECT_EQ(0, report[0].find("test.b "));
+
+  registry.reset();
+  EXPECT_TRUE(registry.report().empty());
+}
+
+TEST(Stats, counterReport) {
+  auto& registry = stats::make();
+
+  EXPECT_EQ(&registry.counter("test.cache"), &registry.counter("test.cache"));
+  EXPECT_TRUE(registry.report().empty());
+
+  registry.counter("test.cache").hit();
+  registry.counter("test.cache").miss();
+  auto report = registry.report();
+
+  ASSERT_EQ(1, report.size());
+  EXPECT_EQ(0, report[0].find("test.cache "));
+  EXPECT_NE(string::npos, report[0].find("rate=50.0%"));
+
+  registry.reset();
+  EXPECT_TRUE(registry.report().empty());
+}
@@ -0,0 +1,72 @@
+#include "components/taskqueue.hpp"
+
+#include <atomic>
+
+#include "common/test.hpp"
+#include "common/wait.hpp"
+
+using namespace polybar;
+using namespace std::chrono_literals;
+
+class Taskqueue : public ::testing::Test {
+ protected:
+  taskqueue q;
+};
+
+TEST_F(Taskqueue, repeats) {
+  std::atomic<int> count{0};
+  std::atomic<size_t> remaining{10};
+  q.defer("a", 5ms, [&](size_t r) {
+    count++;
+    remaining = r;
+  }, 0ms, 3);
+
+  EXPECT_TRUE(wait_for([&] { return !q.exist("a"); }));
+  EXPECT_EQ(3, count);
+  EXPECT_EQ(0, remaining);
+}
+
+TEST_F(Taskqueue, order) {
+  std::mutex lock;
+  string order;
+  const auto append = [&](char c) {
+    return [&, c](size_t) {
+      std::lock_guard<std::mutex> guard(lock);
+      order += c;
+    };
+  };
+
+  q.defer("c", 60ms, append('c'));
+  q.defer("a", 20ms, append('a'));
+  q.defer("b", 40ms, append('b'));
+
+  EXPECT_TRUE(wait_for([&] {
+    std::lock_guard<std::mutex> guard(lock);
+    return order.size() == 3;
+  }));
+  EXPECT_EQ("abc", order);
+}
+
+TEST_F(Taskqueue, unique) {
+  std::atomic<int> value{0};
+  q.defer("a", 20ms, [&](size_t) { value += 1; });
+  q.defer("a", 20ms, [&](size_t) { value += 10; });
+  q.defer_unique("a", 20ms, [&](size_t) { value += 100; });
+
+  EXPECT_TRUE(wait_for([&] { return !q.exist("a"); }));
+  EXPECT_EQ(100, value);
+}
+
+TEST_F(Taskqueue, purge) {
+  std::atomic<bool> called{false};
+  q.defer("a", 50ms, [&](size_t) { called = true; });
+  q.defer("b", 50ms, [&](size_t) {});
+
+  EXPECT_TRUE(q.purge("a"));
+  EXPECT_FALSE(q.purge("a"));
+  EXPECT_FALSE(q.exist("a"));
+  EXPECT_TRUE(q.exist("b"));
+
+  std::this_thread::sleep_for(100ms);
+  EXPECT_FALSE(called);
+}
@@ -0,0 +1,51 @@
+#include "components/thread_policy.hpp"
+
+#include "common/test.hpp"
+#include "components/config.hpp"
+
+using namespace polybar;
+
+TEST(ThreadPolicy, parsePriority) {
+  auto idle = thread_policy::parse_priority("idle");
+  EXPECT_TRUE(idle.idle);
+
+  auto nice = thread_policy::parse_priority("-5");
+  EXPECT_FALSE(nice.idle);
+  EXPECT_EQ(-5, nice.nice);
+
+  EXPECT_EQ(19, thread_policy::parse_priority("19").nice);
+
+  EXPECT_THROW(thread_policy::parse_priority("20"), value_error);
+  EXPECT_THROW(thread_policy::parse_priority("-21"), value_error);
+  EXPECT_THROW(thread_policy::parse_priority("low"), value_error);
+  EXPECT_THROW(thread_policy::parse_priority("5x"), value_error);
+}
+
+TEST(ThreadPolicy, parseCpus) {
+  EXPECT_EQ((vector<int>{0}), thread_policy::parse_cpus("0"));
+  EXPECT_EQ((vector<int>{0, 1, 2, 3, 6}), thread_policy::parse_cpus("0-3,6"));
+  EXPECT_EQ((vector<int>{1, 4, 5}), thread_policy::parse_cpus("1, 4-5"));
+
+  EXPECT_THROW(thread_policy::parse_cpus(""), value_error);
+  EXPECT_THROW(thread_policy::parse_cpus("3-1"), value_error);
+  EXPECT_THROW(thread_policy::parse_cpus("-1"), value_error);
+  EXPECT_THROW(thread_policy::parse_cpus("a"), value_error);
+}
+
+TEST(ThreadPolicy, roles) {
+  auto& policy = thread_policy::make();
+  thread_policy::role inside{}, scoped{}, after{};
+
+  thread_policy::spawn(thread_policy::role::NORMAL, [&] {
+    inside = policy.current();
+    {
+      thread_policy::scoped_role role(thread_policy::role::WORKER);
+      scoped = policy.current();
+    }
+    after = policy.current();
+  }).join();
+
+  EXPECT_EQ(thread_policy::role::NORMAL, inside);
+  EXPECT_EQ(thread_policy::role::WORKER, scoped);
+  EXPECT_EQ(thread_policy::role::NORMAL, after);
+}
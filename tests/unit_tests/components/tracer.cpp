@@ -0,0 +1,123 @@
+#include "components/tracer.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <future>
+#include <thread>
+
+#include "common/env.hpp"
+#include "common/test.hpp"
+#include "utils/file.hpp"
+
+using namespace polybar;
+
+static size_t count(const string& haystack, const string& needle) {
+  size_t n{0};
+  for (size_t pos = haystack.find(needle); pos != string::npos; pos = haystack.find(needle, pos + 1)) {
+    n++;
+  }
+  return n;
+}
+
+TEST(Tracer, disabled) {
+  auto& t = tracer::make();
+  t.stop();
+  { POLYBAR_TRACE("tracer.test.disabled"); }
+
+  EXPECT_EQ(string::npos, t.dump().find("tracer.test.disabled"));
+}
+
+TEST(Tracer, spans) {
+  auto& t = tracer::make();
+  t.start();
+
+  { POLYBAR_TRACE("tracer.test.main"); }
+
+  std::promise<void> recorded;
+  std::promise<void> dumped;
+  std::thread worker([&] {
+    {
+      POLYBAR_TRACE(t.intern("tracer.test." + string("worker")));
+      POLYBAR_TRACE("tracer.test.nested");
+    }
+    recorded.set_value();
+    dumped.get_future().wait();
+  });
+  recorded.get_future().wait();
+
+  t.stop();
+  { POLYBAR_TRACE("tracer.test.stopped"); }
+
+  auto dump = t.dump();
+  dumped.set_value();
+  worker.join();
+
+  EXPECT_EQ(0, dump.find("{\"traceEvents\":["));
+  EXPECT_EQ(1, count(dump, "\"name\":\"tracer.test.main\""));
+  EXPECT_EQ(1, count(dump, "\"name\":\"tracer.test.worker\""));
+  EXPECT_EQ(1, count(dump, "\"name\":\"tracer.test.nested\""));
+  EXPECT_EQ(0, count(dump, "tracer.test.stopped"));
+  EXPECT_EQ(3, count(dump, "\"ph\":\"X\""));
+}
+
+TEST(Tracer, exitedThread) {
+  auto& t = tracer::make();
+  t.start();
+  std::thread([] { POLYBAR_TRACE("tracer.test.exited"); }).join();
+  t.stop();
+
+  // The buffer was freed with the thread
+  EXPECT_EQ(string::npos, t.dump().find("tracer.test.exited"));
+}
+
+TEST(Tracer, write) {
+  char dir[] = "/tmp/polybar-testXXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+  scoped_env env;
+  env.set("XDG_RUNTIME_DIR", dir);
+
+  auto& t = tracer::make();
+  auto first = t.write();
+  auto second = t.write();
+
+  EXPECT_EQ(0, first.find(string(dir) + "/polybar-trace-"));
+  EXPECT_NE(first, second);
+  EXPECT_EQ(t.dump(), file_util::contents(second));
+
+  struct stat st {};
+  ASSERT_EQ(0, stat(first.c_str(), &st));
+  EXPECT_EQ(0600, st.st_mode & 0777);
+
+  unlink(first.c_str());
+  unlink(second.c_str());
+  rmdir(dir);
+}
+
+TEST(Tracer, restart) {
+  auto& t = tracer::make();
+  t.start();
+  { POLYBAR_TRACE("tracer.test.before"); }
+  t.start();
+  { POLYBAR_TRACE("tracer.test.after"); }
+  t.stop();
+
+  auto dump = t.dump();
+  EXPECT_EQ(string::npos, dump.find("tracer.test.before"));
+  EXPECT_NE(string::npos, dump.find("tracer.test.after"));
+}
+
+TEST(Tracer, ring) {
+  auto& t = tracer::make();
+  t.start();
+
+  auto now = tracer::clock::now();
+  for (size_t i = 0; i < tracer::CAPACITY + 10; i++) {
+    t.record(i < 10 ? "tracer.test.old" : "tracer.test.new", now, now);
+  }
+  t.stop();
+
+  auto dump = t.dump();
+  EXPECT_EQ(0, count(dump, "tracer.test.old"));
+  EXPECT_EQ(tracer::CAPACITY, count(dump, "tracer.test.new"));
+}
@@ -0,0 +1,54 @@
+#include "components/worker_pool.hpp"
+
+#include <atomic>
+
+#include "common/test.hpp"
+#include "common/wait.hpp"
+#include "components/logger.hpp"
+
+using namespace polybar;
+using namespace std::chrono_literals;
+
+TEST(WorkerPool, runsAllJobs) {
+  worker_pool pool(logger::make(), 4);
+  std::atomic<int> count{0};
+
+  for (int i = 0; i < 100; i++) {
+    pool.submit([&] { count++; });
+  }
+
+  EXPECT_TRUE(wait_for([&] { return count == 100; }));
+}
+
+TEST(WorkerPool, slowJobDoesNotBlock) {
+  worker_pool pool(logger::make(), 2);
+  std::atomic<bool> release{false};
+  std::atomic<int> count{0};
+
+  // Round-robin puts every other job behind the slow one, those have to be stolen
+  pool.submit([&] {
+    while (!release) {
+      std::this_thread::sleep_for(1ms);
+    }
+  });
+
+  for (int i = 0; i < 10; i++) {
+    pool.submit([&] { count++; });
+  }
+
+  EXPECT_TRUE(wait_for([&] { return count == 10; }));
+  release = true;
+}
+
+TEST(WorkerPool, latency) {
+  histogram latency;
+
+  {
+    worker_pool pool(logger::make(), 1);
+    std::atomic<bool> done{false};
+    pool.submit([&] { done = true; }, &latency);
+    EXPECT_TRUE(wait_for([&] { return done.load(); }));
+  }
+
+  EXPECT_EQ(1, latency.summarize().count);
+}
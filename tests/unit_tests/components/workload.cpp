@@ -0,0 +1,95 @@
+#include "components/workload.hpp"
+
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "common/test.hpp"
+#include "components/action_table.hpp"
+#include "errors.hpp"
+
+using namespace polybar;
+
+TEST(WorkloadReplay, combinesUpdatesOfTheSameTime) {
+  std::istringstream in{
+      "0 layout left a b\n"
+      "0 layout right c\n"
+      "10 update a A1\n"
+      "10 update b B1\n"
+      "20 input #a.toggle\n"
+      "30 update a A2\n"
+      "30 update a A3\n"
+      "40 input legacy-command\n"
+      "50 update c C1\n"};
+
+  workload_replay replay{in};
+  EXPECT_EQ(9, replay.size());
+
+  vector<string> frames;
+  auto result = replay.run(0.0, [&](const string& frame) { frames.emplace_back(frame); });
+
+  EXPECT_EQ((vector<string>{"%{l}A1B1", "%{l}A3B1", "%{l}A3B1%{r}C1"}), frames);
+  EXPECT_EQ(9, result.events);
+  EXPECT_EQ(5, result.updates);
+  EXPECT_EQ(1, result.dropped);
+  EXPECT_EQ(3, result.frames);
+  EXPECT_EQ(2, result.inputs);
+  // Only the action was followed by an update of its module
+  EXPECT_EQ(1, result.latencies);
+}
+
+TEST(WorkloadReplay, rejectsInvalidEvents) {
+  std::istringstream timestamp{"abc update a A1\n"};
+  EXPECT_THROW(workload_replay{timestamp}, application_error);
+  std::istringstream type{"0 redraw\n"};
+  EXPECT_THROW(workload_replay{type}, application_error);
+}
+
+TEST(WorkloadRecorder, recordsReplayableEvents) {
+  auto path = "/tmp/polybar_workload_test." + to_string(getpid());
+  auto& recorder = workload_recorder::make();
+  recorder.open(path);
+  EXPECT_TRUE(workload_recorder::enabled());
+  recorder.layout("center", {"date"});
+  recorder.update("date", "%{F#f00}12:00\n%{F-}");
+  recorder.input("#date.toggle");
+  recorder.close();
+  EXPECT_FALSE(workload_recorder::enabled());
+
+  std::ifstream in{path};
+  workload_replay replay{in};
+  unlink(path.c_str());
+
+  vector<string> frames;
+  auto result = replay.run(0.0, [&](const string& frame) { frames.emplace_back(frame); });
+  EXPECT_EQ((vector<string>{"%{c}%{F#f00}12:00 %{F-}"}), frames);
+  EXPECT_EQ(1, result.inputs);
+}
+
+TEST(WorkloadRecorder, recordsInternedActions) {
+  auto path = "/tmp/polybar_workload_test." + to_string(getpid());
+  action_table::scope scope(action_table::make());
+  auto id = scope.intern("date", "toggle", "1");
+  ASSERT_NE("#date.toggle.1", id);
+
+  auto& recorder = workload_recorder::make();
+  recorder.open(path);
+  recorder.layout("center", {"date"});
+  recorder.input(id);
+  recorder.update("date", "12:00");
+  recorder.close();
+
+  std::ifstream in{path};
+  string contents{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+  EXPECT_NE(string::npos, contents.find(" input #date.toggle.1\n"));
+
+  // The input counts towards the latency of the module
+  in.clear();
+  in.seekg(0);
+  workload_replay replay{in};
+  unlink(path.c_str());
+  auto result = replay.run(0.0, [](const string&) {});
+  EXPECT_EQ(1, result.latencies);
+}
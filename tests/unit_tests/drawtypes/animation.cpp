@@ -0,0 +1,79 @@
+#include "drawtypes/animation.hpp"
+
+#include <atomic>
+
+#include "common/test.hpp"
+#include "common/wait.hpp"
+#include "components/logger.hpp"
+#include "utils/factory.hpp"
+
+using namespace polybar::drawtypes;
+using namespace polybar;
+using namespace std::chrono_literals;
+
+class AnimationClock : public ::testing::Test {
+ protected:
+  animation_t make_animation(int framerate) {
+    vector<label_t> frames;
+    frames.emplace_back(factory_util::shared<label>("frame0", 0));
+    frames.emplace_back(factory_util::shared<label>("frame1", 0));
+    return factory_util::shared<animation>(move(frames), framerate);
+  }
+
+  scheduler s{logger::make(), 2};
+  animation_clock clock{s};
+};
+
+TEST(Animation, increment) {
+  vector<label_t> frames;
+  frames.emplace_back(factory_util::shared<label>("frame0", 0));
+  frames.emplace_back(factory_util::shared<label>("frame1", 0));
+  animation a{move(frames), 100};
+
+  // Starts with the last frame, so the first increment shows the first one
+  EXPECT_EQ("frame1", a.get()->get());
+  a.increment();
+  EXPECT_EQ("frame0", a.get()->get());
+  a.increment();
+  EXPECT_EQ("frame1", a.get()->get());
+}
+
+TEST_F(AnimationClock, advances) {
+  auto a = make_animation(10);
+  std::atomic<int> frames{0};
+  auto id = clock.add(a, [&] { frames++; });
+
+  EXPECT_NE(0, id);
+  EXPECT_TRUE(wait_for([&] { return frames >= 3; }));
+
+  clock.remove(id);
+}
+
+TEST_F(AnimationClock, noCallbackAfterRemove) {
+  auto a = make_animation(5);
+  std::atomic<int> frames{0};
+  auto id = clock.add(a, [&] { frames++; });
+  EXPECT_TRUE(wait_for([&] { return frames >= 1; }));
+
+  clock.remove(id);
+  int seen = frames;
+  std::this_thread::sleep_for(30ms);
+  EXPECT_EQ(seen, frames);
+}
+
+TEST_F(AnimationClock, sameFramerateSharesFrames) {
+  auto a = make_animation(20);
+  auto b = make_animation(20);
+  std::atomic<int> frames_a{0};
+  std::atomic<int> frames_b{0};
+
+  auto id_a = clock.add(a, [&] { frames_a++; });
+  auto id_b = clock.add(b, [&] { frames_b++; });
+  EXPECT_TRUE(wait_for([&] { return frames_a >= 3; }));
+
+  // Both are advanced by the same ticks, unless one came in between adding them
+  clock.remove(id_a);
+  clock.remove(id_b);
+  EXPECT_LE(frames_a - frames_b, 1);
+  EXPECT_GE(frames_a - frames_b, 0);
+}
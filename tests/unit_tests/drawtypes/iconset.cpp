@@ -16,3 +16,20 @@ TEST(IconSet, fuzzyMatchExactMatchFirst) {
 
   EXPECT_EQ("10", ret->get());
 }
+
+TEST(IconSet, fuzzyMatchRemembersResult) {
+  iconset_t icons = make_shared<iconset>();
+
+  icons->add("fallback", make_shared<label>("fallback"));
+  icons->add("web", make_shared<label>("web"));
+
+  EXPECT_EQ("web", icons->get("1:web", "fallback", true)->get());
+  EXPECT_EQ("web", icons->get("1:web", "fallback", true)->get());
+  EXPECT_EQ("fallback", icons->get("2:mail", "fallback", true)->get());
+  EXPECT_EQ("fallback", icons->get("2:mail", "fallback", true)->get());
+
+  // Results are forgotten when an icon is added
+  icons->add("mail", make_shared<label>("mail"));
+  EXPECT_EQ("mail", icons->get("2:mail", "fallback", true)->get());
+  EXPECT_EQ("web", icons->get("1:web", "fallback", true)->get());
+}
@@ -107,3 +107,108 @@ TEST_P(GetTest, soundness) {
   EXPECT_TRUE(m_label->m_maxlen == 0 || actual.length() <= m_label->m_maxlen) << "Returned text is longer than maxlen";
   EXPECT_GE(actual.length(), m_label->m_minlen) << "Returned text is shorter than minlen";
 }
+
+unique_ptr<label> create_token_test_label(string text, vector<token>&& tokens) {
+  return make_unique<label>(move(text), rgba{}, rgba{}, rgba{}, rgba{}, 0, side_values{0U, 0U}, side_values{0U, 0U}, 0,
+      0_z, alignment::LEFT, true, move(tokens));
+}
+
+TEST(ReplaceToken, replacesSlots) {
+  auto test_label = create_token_test_label("%a% - %b%!", {token{"%a%"}, token{"%b%"}});
+
+  test_label->replace_token("%b%", "two");
+  test_label->replace_token("%a%", "one");
+  EXPECT_EQ("one - two!", test_label->get());
+}
+
+TEST(ReplaceToken, unreplacedTokensStay) {
+  auto test_label = create_token_test_label("x %a% y", {token{"%a%"}});
+
+  EXPECT_EQ("x %a% y", test_label->get());
+  EXPECT_TRUE(test_label->has_token("%a%"));
+  test_label->replace_token("%b%", "nope");
+  EXPECT_EQ("x %a% y", test_label->get());
+}
+
+TEST(ReplaceToken, repeatedToken) {
+  auto test_label = create_token_test_label("%a%%a%", {token{"%a%"}, token{"%a%", 3_z}});
+
+  test_label->replace_token("%a%", "1");
+  EXPECT_EQ("1  1", test_label->get());
+
+  // Already replaced slots are kept until the tokens are reset
+  test_label->replace_token("%a%", "2");
+  EXPECT_EQ("1  1", test_label->get());
+}
+
+TEST(ReplaceToken, minMax) {
+  auto test_label = create_token_test_label(
+      "%a%|%b%|%c%", {token{"%a%", 3_z, 0_z, "", true}, token{"%b%", 0_z, 2_z, "~"}, token{"%c%", 2_z}});
+
+  test_label->replace_token("%a%", "7");
+  test_label->replace_token("%b%", "long");
+  test_label->replace_token("%c%", "x");
+  EXPECT_EQ("007|lo~| x", test_label->get());
+}
+
+TEST(ReplaceToken, reset) {
+  auto test_label = create_token_test_label("[%a%]", {token{"%a%"}});
+
+  test_label->replace_token("%a%", "first");
+  EXPECT_EQ("[first]", test_label->get());
+
+  test_label->reset_tokens();
+  EXPECT_EQ("[%a%]", test_label->get());
+  test_label->replace_token("%a%", "second");
+  EXPECT_EQ("[second]", test_label->get());
+}
+
+TEST(ReplaceToken, clear) {
+  auto test_label = create_token_test_label("[%a%]", {token{"%a%"}});
+
+  test_label->clear();
+  test_label->replace_token("%a%", "value");
+  EXPECT_FALSE(static_cast<bool>(*test_label));
+  EXPECT_EQ("", test_label->get());
+
+  test_label->reset_tokens();
+  EXPECT_TRUE(static_cast<bool>(*test_label));
+}
+
+TEST(Clone, independentReplacements) {
+  auto original = make_shared<label>("<%a%>", rgba{0xFF112233}, rgba{}, rgba{}, rgba{}, 2, side_values{1U, 1U},
+      side_values{0U, 0U}, 0, 0_z, alignment::LEFT, true, vector<token>{token{"%a%"}});
+  original->replace_token("%a%", "original");
+
+  auto copy = original->clone();
+  EXPECT_EQ("<%a%>", copy->get());
+  EXPECT_EQ(original->m_foreground, copy->m_foreground);
+  EXPECT_EQ(2, copy->m_font);
+  EXPECT_EQ(1U, copy->m_padding.left);
+
+  copy->replace_token("%a%", "copy");
+  EXPECT_EQ("<copy>", copy->get());
+  EXPECT_EQ("<original>", original->get());
+
+  original->reset_tokens();
+  EXPECT_EQ("<%a%>", original->get());
+  EXPECT_EQ("<copy>", copy->get());
+}
+
+TEST(Truncate, cyclingValues) {
+  auto test_label = create_token_test_label("%a%", {token{"%a%"}});
+  test_label->m_maxlen = 6_z;
+
+  // More values than the cache holds, so entries are evicted and computed again
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 10; i++) {
+      test_label->reset_tokens();
+      test_label->replace_token("%a%", to_string(i) + " loading");
+      EXPECT_EQ(to_string(i) + " l...", test_label->get());
+    }
+  }
+
+  test_label->reset_tokens();
+  test_label->replace_token("%a%", "short");
+  EXPECT_EQ("short", test_label->get());
+}
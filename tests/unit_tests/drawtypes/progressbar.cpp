@@ -0,0 +1,47 @@
+#include "drawtypes/progressbar.hpp"
+
+#include "common/test.hpp"
+#include "drawtypes/label.hpp"
+#include "utils/factory.hpp"
+
+using namespace polybar::drawtypes;
+using namespace polybar;
+
+class Progressbar : public ::testing::Test {
+ protected:
+  progressbar_t make(int width) {
+    auto pbar = factory_util::shared<progressbar>(m_bar, width, "%fill%%indicator%%empty%");
+    pbar->set_fill(factory_util::shared<label>("#", 0));
+    pbar->set_empty(factory_util::shared<label>("-", 0));
+    pbar->set_indicator(factory_util::shared<label>("|", 0));
+    return pbar;
+  }
+
+  bar_settings m_bar{};
+};
+
+TEST_F(Progressbar, output) {
+  auto pbar = make(5);
+  EXPECT_EQ("|----", pbar->output(0));
+  EXPECT_EQ("##|--", pbar->output(50));
+  EXPECT_EQ("####|", pbar->output(100));
+}
+
+TEST_F(Progressbar, cachedOutputUnchanged) {
+  auto pbar = make(5);
+  auto first = pbar->output(50);
+  pbar->output(0);
+  EXPECT_EQ(first, pbar->output(50));
+  // Same number of filled segments
+  EXPECT_EQ(first, pbar->output(55));
+}
+
+TEST_F(Progressbar, colorByPercentage) {
+  auto pbar = make(3);
+  pbar->set_gradient(false);
+  pbar->set_colors({rgba{0xffff0000}, rgba{0xff00ff00}});
+
+  EXPECT_EQ("%{F#f00}#%{F-}|-", pbar->output(40));
+  EXPECT_EQ("%{F#0f0}##%{F-}|", pbar->output(100));
+  EXPECT_EQ("%{F#f00}#%{F-}|-", pbar->output(40));
+}
@@ -0,0 +1,93 @@
+#include "events/signal_emitter.hpp"
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+namespace {
+  struct first_signal {
+    int value;
+  };
+  struct second_signal {};
+
+  vector<string> g_calls;
+
+  template <int Priority>
+  class test_receiver : public signal_receiver<Priority, first_signal, second_signal> {
+   public:
+    explicit test_receiver(string name, bool handles = false) : m_name(move(name)), m_handles(handles) {}
+
+    bool on(const first_signal& sig) override {
+      g_calls.emplace_back(m_name + to_string(sig.value));
+      return m_handles;
+    }
+
+    bool on(const second_signal&) override {
+      g_calls.emplace_back(m_name);
+      return false;
+    }
+
+   private:
+    string m_name;
+    bool m_handles;
+  };
+}  // namespace
+
+class SignalEmitter : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    g_calls.clear();
+  }
+
+  signal_emitter emitter;
+};
+
+TEST_F(SignalEmitter, priority) {
+  test_receiver<2> late{"late"};
+  test_receiver<1> early{"early"};
+  test_receiver<2> later{"later"};
+
+  emitter.attach(&late);
+  emitter.attach(&early);
+  emitter.attach(&later);
+
+  EXPECT_FALSE(emitter.emit(first_signal{1}));
+  EXPECT_EQ((vector<string>{"early1", "late1", "later1"}), g_calls);
+
+  emitter.detach(&late);
+  emitter.detach(&early);
+  emitter.detach(&later);
+}
+
+TEST_F(SignalEmitter, handled) {
+  test_receiver<1> first{"first", true};
+  test_receiver<2> second{"second"};
+
+  emitter.attach(&first);
+  emitter.attach(&second);
+
+  EXPECT_TRUE(emitter.emit(first_signal{1}));
+  EXPECT_FALSE(emitter.emit(second_signal{}));
+  EXPECT_EQ((vector<string>{"first1", "first", "second"}), g_calls);
+
+  emitter.detach(&first);
+  emitter.detach(&second);
+}
+
+TEST_F(SignalEmitter, detach) {
+  test_receiver<1> a{"a"};
+  test_receiver<1> b{"b"};
+
+  emitter.attach(&a);
+  emitter.attach(&b);
+  emitter.detach(&a);
+
+  EXPECT_FALSE(emitter.emit(first_signal{1}));
+  EXPECT_FALSE(emitter.emit(second_signal{}));
+  EXPECT_EQ((vector<string>{"b1", "b"}), g_calls);
+
+  emitter.detach(&b);
+  g_calls.clear();
+  EXPECT_FALSE(emitter.emit(first_signal{2}));
+  EXPECT_TRUE(g_calls.empty());
+}
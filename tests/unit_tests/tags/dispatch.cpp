@@ -0,0 +1,118 @@
+#include "tags/dispatch.hpp"
+
+#include "common/test.hpp"
+#include "components/logger.hpp"
+#include "components/renderer_interface.hpp"
+
+using namespace polybar;
+using namespace tags;
+
+/**
+ * \brief Renderer that records the calls it receives
+ */
+class RecordingRenderer : public renderer_interface {
+ public:
+  void change_background(const rgba& color) override {
+    calls.emplace_back("B" + static_cast<string>(color));
+  }
+  void change_foreground(const rgba& color) override {
+    calls.emplace_back("F" + static_cast<string>(color));
+  }
+  void change_underline(const rgba& color) override {
+    calls.emplace_back("u" + static_cast<string>(color));
+  }
+  void change_overline(const rgba& color) override {
+    calls.emplace_back("o" + static_cast<string>(color));
+  }
+  void change_font(int font) override {
+    calls.emplace_back("T" + to_string(font));
+  }
+  void change_alignment(alignment align) override {
+    calls.emplace_back("align" + to_string(static_cast<int>(align)));
+  }
+  void reverse_colors() override {
+    calls.emplace_back("R");
+  }
+  void offset_pixel(int offset) override {
+    calls.emplace_back("O" + to_string(offset));
+  }
+  void attribute_set(tags::attribute attr) override {
+    calls.emplace_back("+" + to_string(static_cast<int>(attr)));
+  }
+  void attribute_unset(tags::attribute attr) override {
+    calls.emplace_back("-" + to_string(static_cast<int>(attr)));
+  }
+  void attribute_toggle(tags::attribute attr) override {
+    calls.emplace_back("!" + to_string(static_cast<int>(attr)));
+  }
+  void action_begin(mousebtn btn, const string& command) override {
+    calls.emplace_back("A" + to_string(static_cast<int>(btn)) + ":" + command);
+  }
+  void action_end(mousebtn btn) override {
+    calls.emplace_back("A" + to_string(static_cast<int>(btn)));
+  }
+  void render_text(const string& text) override {
+    calls.emplace_back("text:" + text);
+  }
+  void draw_graph(tags::graph_type type, int width, const vector<double>& values) override {
+    string call = "G" + to_string(static_cast<int>(type)) + "/" + to_string(width) + ":";
+    for (auto value : values) {
+      call += to_string(static_cast<int>(value * 100)) + ";";
+    }
+    calls.emplace_back(call);
+  }
+  void control(tags::controltag ctrl) override {
+    calls.emplace_back("P" + to_string(static_cast<int>(ctrl)));
+  }
+  void reserve_width(const tags::reserved_width& width) override {
+    calls.emplace_back(string{width.fixed ? "fixed" : "min"} + to_string(width.width) + (width.chars ? "c" : ""));
+  }
+
+  vector<string> calls;
+};
+
+class DispatchTest : public ::testing::Test {
+ protected:
+  logger log{loglevel::NONE};
+  dispatch d{log};
+  bar_settings bar{};
+  RecordingRenderer r;
+};
+
+TEST_F(DispatchTest, formatting) {
+  bar.foreground = rgba{"#ffffff"};
+  d.parse(bar, r, "%{l}%{F#f00}abc%{F-}%{T2}%{O-3}%{R}%{+u}%{!o}%{PR}def");
+
+  vector<string> expected{"align" + to_string(static_cast<int>(alignment::LEFT)), "F#ffff0000", "text:abc", "F#ffffffff", "T2",
+      "O-3", "R", "+" + to_string(static_cast<int>(attribute::UNDERLINE)),
+      "!" + to_string(static_cast<int>(attribute::OVERLINE)), "P" + to_string(static_cast<int>(controltag::R)),
+      "text:def"};
+  EXPECT_EQ(expected, r.calls);
+}
+
+TEST_F(DispatchTest, actions) {
+  d.parse(bar, r, "%{A1:a:}%{A3:b:}x%{A}%{A1}");
+
+  vector<string> expected{"A1:a", "A3:b", "text:x", "A3", "A1"};
+  EXPECT_EQ(expected, r.calls);
+}
+
+TEST_F(DispatchTest, unclosedAction) {
+  EXPECT_THROW(d.parse(bar, r, "%{A1:a:}x"), std::runtime_error);
+}
+
+TEST_F(DispatchTest, graph) {
+  d.parse(bar, r, "%{Gb20:25}%{Gs8:0,50,100}");
+
+  vector<string> expected{"G" + to_string(static_cast<int>(graph_type::BAR)) + "/20:25;",
+      "G" + to_string(static_cast<int>(graph_type::SPARKLINE)) + "/8:0;50;100;"};
+  EXPECT_EQ(expected, r.calls);
+}
+
+TEST_F(DispatchTest, reservedWidth) {
+  d.parse(bar, r, "%{PW60}a%{PR}%{PF4c}b%{PR}");
+
+  vector<string> expected{"min60", "text:a", "P" + to_string(static_cast<int>(controltag::R)), "fixed4c", "text:b",
+      "P" + to_string(static_cast<int>(controltag::R))};
+  EXPECT_EQ(expected, r.calls);
+}
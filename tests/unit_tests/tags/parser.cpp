@@ -81,10 +81,11 @@ class TestableTagParser : public parser {
     EXPECT_EQ(exp, current.tag_data.offset);
   }
 
-  void expect_ctrl(controltag exp) {
+  void expect_ctrl(controltag exp, const string& data = "") {
     set_current();
     assert_format(syntaxtag::P);
     EXPECT_EQ(exp, current.tag_data.ctrl);
+    EXPECT_EQ(data, current.data);
   }
 
   void expect_alignment(syntaxtag exp) {
@@ -104,6 +105,14 @@ class TestableTagParser : public parser {
     assert_format(syntaxtag::R);
   }
 
+  void expect_graph(graph_type type, int width, const string& values) {
+    set_current();
+    assert_format(syntaxtag::G);
+    EXPECT_EQ(type, current.tag_data.graph.type);
+    EXPECT_EQ(width, current.tag_data.graph.width);
+    EXPECT_EQ(values, current.data);
+  }
+
  private:
   void assert_format(syntaxtag exp) {
     assert_type(tag_type::FORMAT);
@@ -342,6 +351,23 @@ TEST_F(TagParserTest, ctrl) {
   p.setup_parser_test("%{PR}");
   p.expect_ctrl(controltag::R);
   p.expect_done();
+
+  p.setup_parser_test("%{PW60}%{PF4c}");
+  p.expect_ctrl(controltag::W, "60");
+  p.expect_ctrl(controltag::F, "4c");
+  p.expect_done();
+}
+
+TEST_F(TagParserTest, graph) {
+  p.setup_parser_test("%{Gb40:75}");
+  p.expect_graph(graph_type::BAR, 40, "75");
+  p.expect_done();
+
+  p.setup_parser_test("%{Gs100:0,50,100 F-}x");
+  p.expect_graph(graph_type::SPARKLINE, 100, "0,50,100");
+  p.expect_color_reset(syntaxtag::F);
+  p.expect_text("x");
+  p.expect_done();
 }
 
 /**
@@ -387,7 +413,7 @@ TEST_F(TagParserTest, combinations) {
  *
  * Since we can't directly pass typenames, we go through this enum.
  */
-enum class exc { ERR, TOKEN, TAG, TAG_END, COLOR, ATTR, FONT, CTRL, OFFSET, BTN };
+enum class exc { ERR, TOKEN, TAG, TAG_END, COLOR, ATTR, FONT, CTRL, OFFSET, BTN, GRAPH };
 
 using exception_test = pair<string, enum exc>;
 class ParseErrorTest : public TagParserTest, public ::testing::WithParamInterface<exception_test> {};
@@ -407,10 +433,25 @@ vector<exception_test> parse_error_test = {
     {"%{PRabc}", exc::CTRL},
     {"%{P}", exc::CTRL},
     {"%{PA}", exc::CTRL},
+    {"%{PW}", exc::CTRL},
+    {"%{PW0}", exc::CTRL},
+    {"%{PWc}", exc::CTRL},
+    {"%{PF6x}", exc::CTRL},
+    {"%{PW-6}", exc::CTRL},
     {"%{Oabc}", exc::OFFSET},
     {"%{A2:cmd:cmd:}", exc::TAG_END},
     {"%{A9}", exc::BTN},
     {"%{rQ}", exc::TAG_END},
+    {"%{G}", exc::GRAPH},
+    {"%{Gx10:5}", exc::GRAPH},
+    {"%{Gb10}", exc::GRAPH},
+    {"%{Gb:5}", exc::GRAPH},
+    {"%{Gb0:5}", exc::GRAPH},
+    {"%{Gb10:101}", exc::GRAPH},
+    {"%{Gb10:5,6}", exc::GRAPH},
+    {"%{Gs10:5,,6}", exc::GRAPH},
+    {"%{Gs10:5,}", exc::GRAPH},
+    {"%{Gs10:-5}", exc::GRAPH},
 };
 
 INSTANTIATE_TEST_SUITE_P(Inst, ParseErrorTest, ::testing::ValuesIn(parse_error_test));
@@ -454,7 +495,81 @@ TEST_P(ParseErrorTest, correctness) {
     case exc::BTN:
       ASSERT_THROW(p.next_element(), tags::btn_error);
       break;
+    case exc::GRAPH:
+      ASSERT_THROW(p.next_element(), tags::graph_error);
+      break;
     default:
       FAIL();
   }
 }
+
+TEST(TagParserBorrowedTest, equivalent) {
+  const string input{"abc%{F#f00}%{A1:a\\:b:}def%%{B-}ghi"};
+
+  parser owned;
+  owned.set(input);
+
+  parser borrowed;
+  borrowed.set_borrowed(input);
+
+  auto elements = borrowed.parse();
+  EXPECT_EQ(owned.parse(), elements);
+  ASSERT_EQ(6, elements.size());
+  EXPECT_EQ("abc", elements[0].data);
+  EXPECT_EQ("a:b", elements[2].data);
+  EXPECT_EQ("def%", elements[3].data);
+  EXPECT_EQ("ghi", elements[5].data);
+}
+
+TEST(TagParserBorrowedTest, longText) {
+  string text;
+  for (int i = 0; i < 200; i++) {
+    text += "50% of {text} ";
+  }
+
+  parser p;
+  p.set(text + "%{F-}" + text + "%");
+
+  auto elements = p.parse();
+  ASSERT_EQ(3, elements.size());
+  EXPECT_EQ(text, elements[0].data);
+  EXPECT_TRUE(elements[1].is_tag);
+  EXPECT_EQ(text + "%", elements[2].data);
+}
+
+// Equality {{{
+
+static format_string parse_all(const string&& input) {
+  parser p;
+  p.set(std::move(input));
+  return p.parse();
+}
+
+TEST(TagElementTest, equality) {
+  EXPECT_EQ(parse_all("%{l}%{F#f00}a%{A1:cmd:}b%{A}%{+u}%{T2}%{O3}%{PR}"),
+      parse_all("%{l}%{F#f00}a%{A1:cmd:}b%{A}%{+u}%{T2}%{O3}%{PR}"));
+  EXPECT_EQ(parse_all("%{B-}"), parse_all("%{B-}"));
+
+  EXPECT_NE(parse_all("a"), parse_all("b"));
+  EXPECT_NE(parse_all("%{F#f00}"), parse_all("%{F#0f0}"));
+  EXPECT_NE(parse_all("%{F#f00}"), parse_all("%{B#f00}"));
+  EXPECT_NE(parse_all("%{F-}"), parse_all("%{F#f00}"));
+  EXPECT_NE(parse_all("%{A1:cmd:}"), parse_all("%{A3:cmd:}"));
+  EXPECT_NE(parse_all("%{A1:cmd:}"), parse_all("%{A1:other:}"));
+  EXPECT_NE(parse_all("%{+u}"), parse_all("%{-u}"));
+  EXPECT_NE(parse_all("%{T1}"), parse_all("%{T2}"));
+  EXPECT_NE(parse_all("%{l}"), parse_all("%{r}"));
+}
+
+TEST(TagElementTest, alignment) {
+  auto elements = parse_all("%{l}a%{c}%{r}%{F-}");
+  ASSERT_EQ(5, elements.size());
+
+  EXPECT_EQ(alignment::LEFT, get_alignment(elements[0]));
+  EXPECT_EQ(alignment::NONE, get_alignment(elements[1]));
+  EXPECT_EQ(alignment::CENTER, get_alignment(elements[2]));
+  EXPECT_EQ(alignment::RIGHT, get_alignment(elements[3]));
+  EXPECT_FALSE(is_alignment(elements[4]));
+}
+
+// }}}
@@ -0,0 +1,75 @@
+#include "tags/types.hpp"
+
+#include "common/test.hpp"
+#include "components/logger.hpp"
+#include "tags/dispatch.hpp"
+
+using namespace polybar;
+using namespace tags;
+
+class AppendTest : public ::testing::TestWithParam<pair<string, string>> {
+ protected:
+  logger log{loglevel::NONE};
+};
+
+/**
+ * Pairs of formatting strings and the same formatting without redundant tags
+ */
+vector<pair<string, string>> append_list = {
+    {"abc%{F-}def", "abc%{F-}def"},
+    {"abc%{F-}%{F#f00}def", "abc%{F#f00}def"},
+    {"abc%{F#f00}%{F-}def", "abc%{F-}def"},
+    {"%{T-}%{T2}abc", "%{T2}abc"},
+    {"%{B-}%{F#f00}abc", "%{B-}%{F#f00}abc"},
+    {"%{u-}%{u#f00}%{+u}abc", "%{u#f00}%{+u}abc"},
+    {"%{+u}%{-u}abc", "%{-u}abc"},
+    {"%{+u}%{!u}abc", "%{+u}%{!u}abc"},
+    {"%{+u}%{-o}abc", "%{+u}%{-o}abc"},
+    {"abc%{F#f00}%{B#000}%{T2}%{R}%{+u}%{PR}", "abc%{PR}"},
+    {"abc%{O10}%{A1:cmd:}%{PR}", "abc%{O10}%{A1:cmd:}%{PR}"},
+    {"%{F#f00}%{l}abc", "%{F#f00}%{l}abc"},
+};
+
+INSTANTIATE_TEST_SUITE_P(Inst, AppendTest, ::testing::ValuesIn(append_list));
+
+TEST_P(AppendTest, optimized) {
+  format_string elements;
+  append(elements, tokenize(log, GetParam().first));
+
+  EXPECT_EQ(tokenize(log, GetParam().second), elements);
+}
+
+/**
+ * Splitting the input in two gives the same result
+ */
+TEST_P(AppendTest, split) {
+  const auto& input = GetParam().first;
+  auto expected = tokenize(log, GetParam().second);
+
+  for (size_t i = 0; i <= input.size(); i++) {
+    if (i != 0 && i != input.size() && (input[i] != '%' || input[i - 1] == '%')) {
+      continue;
+    }
+    format_string elements;
+    append(elements, tokenize(log, input.substr(0, i)));
+    append(elements, tokenize(log, input.substr(i)));
+    EXPECT_EQ(expected, elements) << i;
+  }
+}
+
+TEST(Compact, resets) {
+  EXPECT_EQ("%{T2}abc", compact("%{T-}%{T2}abc"));
+  EXPECT_EQ("%{B#000}abc", compact("%{B-}%{B#000}abc"));
+  EXPECT_EQ("%{F#fff B#000}abc", compact("%{F#fff}%{B-}%{B#000}abc"));
+  EXPECT_EQ("%{u#f00 o#f00}", compact("%{u-}%{u#f00}%{o-}%{o#f00}"));
+  EXPECT_EQ("%{U#f00}", compact("%{U-}%{U#f00}"));
+}
+
+TEST(Compact, kept) {
+  EXPECT_EQ("", compact(""));
+  EXPECT_EQ("abc", compact("abc"));
+  EXPECT_EQ("%{F- B#000}", compact("%{F-}%{B#000}"));
+  EXPECT_EQ("%{F- F-}", compact("%{F-}%{F-}"));
+  EXPECT_EQ("%{A1:T-: T2}", compact("%{A1:T-:}%{T2}"));
+  EXPECT_EQ("abc T-%{T2}", compact("abc T-%{T2}"));
+}
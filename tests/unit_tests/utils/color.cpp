@@ -126,3 +126,14 @@ TEST(ColorUtil, simplify) {
   EXPECT_EQ("#234567", color_util::simplify_hex("#ff234567"));
   EXPECT_EQ("#00223344", color_util::simplify_hex("#00223344"));
 }
+
+TEST(Rgba, buffer) {
+  const char* hex = "#ff0000}";
+  EXPECT_EQ(0xffff0000, rgba(hex, 7).value());
+  EXPECT_EQ(0xffff0000, rgba(hex + 1, 6).value());
+  EXPECT_EQ(rgba::type::ALPHA_ONLY, rgba(hex, 3).type());
+  EXPECT_FALSE(rgba(hex, 8).has_color());
+  EXPECT_FALSE(rgba(hex, 0).has_color());
+  EXPECT_FALSE(rgba("#", 1).has_color());
+  EXPECT_FALSE(rgba("#123456789", 10).has_color());
+}
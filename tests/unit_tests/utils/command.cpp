@@ -55,3 +55,16 @@ TEST(Command, readline) {
 
   EXPECT_EQ(str, "polybar");
 }
+
+TEST(Command, readlineKeepsBufferedOutput) {
+  auto cmd = command_util::make_command<output_policy::REDIRECTED>("printf 'a\\nb\\nc\\n'");
+  cmd->exec(false);
+
+  EXPECT_EQ("a", cmd->readline());
+
+  vector<string> lines;
+  cmd->tail([&lines](string&& line) { lines.emplace_back(move(line)); });
+  cmd->wait();
+
+  EXPECT_EQ((vector<string>{"b", "c"}), lines);
+}
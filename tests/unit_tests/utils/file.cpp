@@ -1,6 +1,7 @@
 #include <iomanip>
 #include <iostream>
 
+#include "common/env.hpp"
 #include "common/test.hpp"
 #include "utils/command.hpp"
 #include "utils/file.hpp"
@@ -14,3 +15,95 @@ TEST(File, expand) {
       EXPECT_EQ(home + "/test", file_util::expand("~/test"));
       });
 }
+
+TEST(File, cachePath) {
+  scoped_env env;
+  env.set("XDG_CACHE_HOME", "/xdg/cache");
+  EXPECT_EQ("/xdg/cache/polybar", file_util::get_cache_path());
+
+  env.unset("XDG_CACHE_HOME");
+  env.set("HOME", "/home/user");
+  EXPECT_EQ("/home/user/.cache/polybar", file_util::get_cache_path());
+
+  env.unset("HOME");
+  EXPECT_EQ("", file_util::get_cache_path());
+}
+
+TEST(File, createDirectories) {
+  char dir[] = "/tmp/polybar-testXXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(dir));
+
+  string path = string{dir} + "/a/b/c";
+  file_util::create_directories(path);
+  EXPECT_TRUE(file_util::exists(path));
+
+  // Existing directories are fine
+  file_util::create_directories(path);
+
+  rmdir(path.c_str());
+  rmdir((string{dir} + "/a/b").c_str());
+  rmdir((string{dir} + "/a").c_str());
+  rmdir(dir);
+}
+
+TEST(File, rereadFile) {
+  char path[] = "/tmp/polybar-testXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_NE(-1, fd);
+  close(fd);
+
+  file_util::write_contents(path, "first");
+  reread_file file{path};
+  EXPECT_STREQ("first", file.read());
+  EXPECT_EQ(5, file.size());
+
+  // Larger than the initial buffer
+  string large(3 * BUFSIZ, 'x');
+  file_util::write_contents(path, large);
+  EXPECT_EQ(large, file.read());
+  EXPECT_EQ(large.size(), file.size());
+
+  file_util::write_contents(path, "second");
+  EXPECT_STREQ("second", file.read());
+  EXPECT_EQ(6, file.size());
+
+  unlink(path);
+}
+
+TEST(File, rereadFileReadAll) {
+  vector<string> paths;
+  vector<unique_ptr<reread_file>> files;
+  vector<reread_file*> batch;
+
+  // More files than a single submission holds
+  for (int i = 0; i < 40; i++) {
+    char path[] = "/tmp/polybar-testXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_NE(-1, fd);
+    close(fd);
+
+    file_util::write_contents(path, to_string(i));
+    paths.emplace_back(path);
+    files.emplace_back(make_unique<reread_file>(path));
+    batch.emplace_back(files.back().get());
+  }
+
+  reread_file::read_all(batch);
+  for (size_t i = 0; i < files.size(); i++) {
+    EXPECT_EQ(to_string(i), files[i]->contents());
+    EXPECT_EQ(to_string(i).size(), files[i]->size());
+  }
+
+  // Files that grew past the buffer are read again
+  string large(3 * BUFSIZ, 'x');
+  file_util::write_contents(paths[1], large);
+  file_util::write_contents(paths[2], "changed");
+  reread_file::read_all(batch);
+  EXPECT_STREQ("0", files[0]->contents());
+  EXPECT_EQ(large, files[1]->contents());
+  EXPECT_STREQ("changed", files[2]->contents());
+
+  for (auto&& path : paths) {
+    unlink(path.c_str());
+  }
+}
@@ -0,0 +1,66 @@
+#include "utils/history.hpp"
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+TEST(SampleHistory, empty) {
+  sample_history<int> h{3};
+  EXPECT_TRUE(h.empty());
+  EXPECT_EQ(3, h.capacity());
+  EXPECT_EQ(0.0, h.mean());
+  EXPECT_TRUE(h.values().empty());
+}
+
+TEST(SampleHistory, noCapacity) {
+  sample_history<int> h;
+  h.push(1);
+  EXPECT_TRUE(h.empty());
+}
+
+TEST(SampleHistory, wrapsAround) {
+  sample_history<int> h{3};
+  for (int i = 1; i <= 5; i++) {
+    h.push(i);
+  }
+
+  EXPECT_EQ(3, h.size());
+  EXPECT_EQ(3, h[0]);
+  EXPECT_EQ(5, h.back());
+  EXPECT_EQ(3, h.min());
+  EXPECT_EQ(5, h.max());
+  EXPECT_DOUBLE_EQ(4.0, h.mean());
+  EXPECT_DOUBLE_EQ(4.5, h.mean(2));
+}
+
+TEST(SampleHistory, evictExtremes) {
+  sample_history<float> h{3};
+  h.push(10.0f);
+  h.push(1.0f);
+  h.push(5.0f);
+  EXPECT_EQ(1.0f, h.min());
+  EXPECT_EQ(10.0f, h.max());
+
+  // Evicts the maximum
+  h.push(4.0f);
+  EXPECT_EQ(1.0f, h.min());
+  EXPECT_EQ(5.0f, h.max());
+
+  // Evicts the minimum
+  h.push(6.0f);
+  EXPECT_EQ(4.0f, h.min());
+  EXPECT_EQ(6.0f, h.max());
+  EXPECT_DOUBLE_EQ(5.0, h.mean());
+}
+
+TEST(SampleHistory, values) {
+  sample_history<int> h{4};
+  h.push(2);
+  h.push(4);
+
+  vector<double> expected{2.0, 2.0, 2.0, 4.0};
+  EXPECT_EQ(expected, h.values());
+
+  expected = {1.0, 1.0, 1.0, 2.0};
+  EXPECT_EQ(expected, h.values(0.5));
+}
@@ -0,0 +1,91 @@
+#include "utils/inotify.hpp"
+
+#include <fstream>
+
+#include "common/test.hpp"
+#include "components/reactor.hpp"
+#include "errors.hpp"
+
+using namespace polybar;
+
+class InotifyMultiplexer : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/polybar-inotify-XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    m_dir = dir;
+    m_path = m_dir + "/file";
+    std::ofstream{m_path} << "content";
+  }
+
+  void TearDown() override {
+    unlink(m_path.c_str());
+    rmdir(m_dir.c_str());
+  }
+
+  void append(const string& text) {
+    std::ofstream{m_path, std::ios::app} << text;
+  }
+
+  reactor m_reactor;
+  inotify_multiplexer m_inotify{m_reactor};
+  string m_dir;
+  string m_path;
+};
+
+TEST_F(InotifyMultiplexer, deliversEvents) {
+  vector<polybar::inotify_event> events;
+  m_inotify.add(m_path, IN_MODIFY, [&](const polybar::inotify_event& event) { events.emplace_back(event); });
+
+  append("more");
+  EXPECT_EQ(1, m_reactor.poll(1000));
+
+  ASSERT_EQ(1, events.size());
+  EXPECT_EQ(m_path, events[0].filename);
+  EXPECT_TRUE(events[0].mask & IN_MODIFY);
+}
+
+TEST_F(InotifyMultiplexer, sharedPath) {
+  int modified{0};
+  int opened{0};
+  m_inotify.add(m_path, IN_MODIFY, [&](const polybar::inotify_event&) { modified++; });
+  auto id = m_inotify.add(m_path, IN_CLOSE_WRITE, [&](const polybar::inotify_event&) { opened++; });
+
+  append("more");
+  EXPECT_EQ(1, m_reactor.poll(1000));
+  EXPECT_EQ(1, modified);
+  EXPECT_EQ(1, opened);
+
+  // The other watch keeps receiving events
+  m_inotify.remove(id);
+  append("more");
+  EXPECT_EQ(1, m_reactor.poll(1000));
+  EXPECT_EQ(2, modified);
+  EXPECT_EQ(1, opened);
+}
+
+TEST_F(InotifyMultiplexer, remove) {
+  int count{0};
+  auto id = m_inotify.add(m_path, IN_MODIFY, [&](const polybar::inotify_event&) { count++; });
+  m_inotify.remove(id);
+
+  append("more");
+  m_reactor.poll(100);
+  EXPECT_EQ(0, count);
+}
+
+TEST_F(InotifyMultiplexer, ignoredOnDelete) {
+  int mask{0};
+  m_inotify.add(m_path, IN_DELETE_SELF, [&](const polybar::inotify_event& event) { mask |= event.mask; });
+
+  unlink(m_path.c_str());
+  while (!(mask & IN_IGNORED) && m_reactor.poll(1000) > 0) {
+  }
+
+  EXPECT_TRUE(mask & IN_DELETE_SELF);
+  EXPECT_TRUE(mask & IN_IGNORED);
+}
+
+TEST_F(InotifyMultiplexer, missingPath) {
+  EXPECT_THROW(m_inotify.add(m_dir + "/missing", IN_MODIFY, [](const polybar::inotify_event&) {}), system_error);
+}
@@ -0,0 +1,87 @@
+#include "utils/line_reader.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/test.hpp"
+
+using namespace polybar;
+
+class LineReader : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_EQ(0, pipe(m_pipe));
+  }
+
+  void TearDown() override {
+    close(m_pipe[0]);
+    if (m_pipe[1] != -1) {
+      close(m_pipe[1]);
+    }
+  }
+
+  void write_pipe(const string& data) {
+    ASSERT_EQ(static_cast<ssize_t>(data.size()), write(m_pipe[1], data.data(), data.size()));
+  }
+
+  void close_pipe() {
+    close(m_pipe[1]);
+    m_pipe[1] = -1;
+  }
+
+  int m_pipe[2]{-1, -1};
+};
+
+TEST_F(LineReader, keepsDataAfterLine) {
+  line_reader reader{m_pipe[0]};
+  write_pipe("first\nsecond\nthi");
+
+  string line;
+  ASSERT_TRUE(reader.readline(line));
+  EXPECT_EQ("first", line);
+  EXPECT_EQ(10, reader.buffered());
+
+  ASSERT_TRUE(reader.readline(line));
+  EXPECT_EQ("second", line);
+
+  write_pipe("rd\n");
+  ASSERT_TRUE(reader.readline(line));
+  EXPECT_EQ("third", line);
+  EXPECT_EQ(0, reader.buffered());
+}
+
+TEST_F(LineReader, lastLineWithoutTerminator) {
+  line_reader reader{m_pipe[0]};
+  write_pipe("a\n\nb");
+  close_pipe();
+
+  string line;
+  ASSERT_TRUE(reader.readline(line));
+  EXPECT_EQ("a", line);
+  ASSERT_TRUE(reader.readline(line));
+  EXPECT_EQ("", line);
+  ASSERT_TRUE(reader.readline(line));
+  EXPECT_EQ("b", line);
+  EXPECT_FALSE(reader.readline(line));
+  EXPECT_TRUE(reader.eof());
+}
+
+TEST_F(LineReader, drainLines) {
+  line_reader reader{m_pipe[0]};
+  vector<string> lines;
+  auto collect = [&](string&& line) { lines.emplace_back(move(line)); };
+
+  EXPECT_TRUE(reader.drain_lines(collect));
+  EXPECT_TRUE(lines.empty());
+
+  write_pipe("1\n2\n3");
+  EXPECT_TRUE(reader.drain_lines(collect));
+  EXPECT_EQ((vector<string>{"1", "2"}), lines);
+
+  // Larger than a single chunk
+  string big(line_reader::CHUNK + 10, 'x');
+  write_pipe("\n" + big + "\n");
+  close_pipe();
+  EXPECT_FALSE(reader.drain_lines(collect));
+  EXPECT_EQ((vector<string>{"1", "2", "3", big}), lines);
+}
@@ -0,0 +1,92 @@
+#include "utils/line_writer.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/test.hpp"
+#include "components/reactor.hpp"
+
+using namespace polybar;
+
+class LineWriter : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // Only the read end is non-blocking, the writer must not block on its own
+    ASSERT_EQ(0, pipe(m_pipe));
+    fcntl(m_pipe[0], F_SETFL, O_NONBLOCK);
+  }
+
+  void TearDown() override {
+    close(m_pipe[0]);
+    close(m_pipe[1]);
+  }
+
+  string read_all() {
+    string result;
+    char buffer[4096];
+    ssize_t bytes;
+    while ((bytes = read(m_pipe[0], buffer, sizeof(buffer))) > 0) {
+      result.append(buffer, bytes);
+    }
+    return result;
+  }
+
+  reactor m_reactor;
+  int m_pipe[2];
+};
+
+TEST_F(LineWriter, writesLines) {
+  line_writer writer{m_reactor, m_pipe[1]};
+  EXPECT_TRUE(writer.write("first"));
+  EXPECT_TRUE(writer.write("second"));
+  EXPECT_EQ(0, writer.pending());
+  EXPECT_EQ("first\nsecond\n", read_all());
+}
+
+TEST_F(LineWriter, keepsDescriptorFlags) {
+  {
+    line_writer writer{m_reactor, m_pipe[1]};
+    EXPECT_TRUE(writer.write("line"));
+    EXPECT_EQ(0, fcntl(m_pipe[1], F_GETFL) & O_NONBLOCK);
+  }
+  EXPECT_EQ(0, fcntl(m_pipe[1], F_GETFL) & O_NONBLOCK);
+}
+
+TEST_F(LineWriter, queuesWhileFull) {
+  int pipe_size = fcntl(m_pipe[1], F_GETPIPE_SZ);
+  ASSERT_GT(pipe_size, 0);
+  size_t capacity = pipe_size;
+
+  line_writer writer{m_reactor, m_pipe[1], 4 * capacity};
+  string line(capacity - 1, 'a');
+  EXPECT_TRUE(writer.write(line));
+  EXPECT_TRUE(writer.write("b"));
+  EXPECT_EQ(2, writer.pending());
+
+  // The reactor writes the rest once the reader made room
+  EXPECT_EQ(line + "\n", read_all());
+  EXPECT_EQ(1, m_reactor.poll(1000));
+  EXPECT_EQ(0, writer.pending());
+  EXPECT_EQ("b\n", read_all());
+}
+
+TEST_F(LineWriter, dropsQueuedLines) {
+  int pipe_size = fcntl(m_pipe[1], F_GETPIPE_SZ);
+  ASSERT_GT(pipe_size, 0);
+  size_t capacity = pipe_size;
+
+  line_writer writer{m_reactor, m_pipe[1], capacity};
+  // Only part of this line fits into the pipe
+  string line(capacity + 10, 'a');
+  EXPECT_TRUE(writer.write(line));
+  EXPECT_EQ(11, writer.pending());
+  EXPECT_TRUE(writer.write("b"));
+
+  // The started line is finished, the queued one is dropped
+  EXPECT_FALSE(writer.write(string(capacity - 12, 'c')));
+  EXPECT_EQ(11 + capacity - 11, writer.pending());
+
+  EXPECT_EQ(string(capacity, 'a'), read_all());
+  EXPECT_EQ(1, m_reactor.poll(1000));
+  EXPECT_EQ(string(10, 'a') + "\n" + string(capacity - 12, 'c') + "\n", read_all());
+}
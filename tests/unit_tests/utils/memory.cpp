@@ -21,3 +21,27 @@ TEST(Memory, countof) {
   EXPECT_EQ(memory_util::countof(A), size_t{3});
   EXPECT_EQ(memory_util::countof(B), size_t{8});
 }
+
+TEST(Memory, poolAllocatorReusesBlocks) {
+  memory_util::pool_allocator<mytype, 2> alloc;
+
+  auto* a = alloc.allocate(1);
+  auto* b = alloc.allocate(1);
+  alloc.deallocate(a, 1);
+  alloc.deallocate(b, 1);
+
+  // Freed blocks are handed out again, the latest first
+  EXPECT_EQ(b, alloc.allocate(1));
+  EXPECT_EQ(a, alloc.allocate(1));
+
+  alloc.deallocate(a, 1);
+  alloc.deallocate(b, 1);
+}
+
+TEST(Memory, poolAllocatorSharedPtr) {
+  auto* value = static_cast<mytype*>(calloc(1, sizeof(mytype)));
+  shared_ptr<mytype> ptr(value, memory_util::free_deleter{}, memory_util::pool_allocator<mytype>{});
+  auto copy = ptr;
+  ptr.reset();
+  EXPECT_EQ(value, copy.get());
+}
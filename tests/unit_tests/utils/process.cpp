@@ -32,3 +32,28 @@ TEST(SpawnAsync, exit_code) {
 
   EXPECT_EQ(WEXITSTATUS(status), 42);
 }
+
+TEST(SpawnSh, exit_code) {
+  pid_t pid = spawn_sh("exit 42");
+  int status = 0;
+  pid_t res = waitpid(pid, &status, 0);
+
+  EXPECT_EQ(res, pid);
+
+  EXPECT_EQ(WEXITSTATUS(status), 42);
+}
+
+TEST(SpawnSh, redirect) {
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  pid_t pid = spawn_sh("echo polybar", -1, fds[1], -1, false);
+  close(fds[1]);
+
+  char buffer[16]{};
+  EXPECT_EQ(read(fds[0], buffer, sizeof(buffer) - 1), 8);
+  EXPECT_STREQ(buffer, "polybar\n");
+  close(fds[0]);
+
+  EXPECT_EQ(process_util::wait(pid), 0);
+}
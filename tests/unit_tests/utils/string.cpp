@@ -18,6 +18,7 @@ TEST(String, compare) {
   EXPECT_TRUE(string_util::compare("foo", "foo"));
   EXPECT_TRUE(string_util::compare("foo", "Foo"));
   EXPECT_FALSE(string_util::compare("foo", "bar"));
+  EXPECT_FALSE(string_util::compare("foo", "fooo"));
 }
 
 TEST(String, replace) {
@@ -38,6 +39,18 @@ TEST(String, replaceAll) {
   EXPECT_EQ("113113113", string_util::replace_all("131313", "3", "13"));
 }
 
+TEST(String, replaceInplace) {
+  string s{"hehehe"};
+  EXPECT_TRUE(string_util::replace_inplace(s, "he", "ho", 1));
+  EXPECT_EQ("hehohe", s);
+  EXPECT_FALSE(string_util::replace_inplace(s, "x", "y"));
+  EXPECT_EQ("hehohe", s);
+
+  EXPECT_EQ(2, string_util::replace_all_inplace(s, "he", "a"));
+  EXPECT_EQ("ahoa", s);
+  EXPECT_EQ(0, string_util::replace_all_inplace(s, "he", "a"));
+}
+
 TEST(String, squeeze) {
   EXPECT_EQ("Squeze", string_util::squeeze("Squeeeeeze", 'e'));
   EXPECT_EQ("bar baz foobar", string_util::squeeze("bar  baz   foobar", ' '));
@@ -53,17 +66,25 @@ TEST(String, trim) {
   EXPECT_EQ("testxx", string_util::ltrim("xxtestxx", 'x'));
   EXPECT_EQ("xxtest", string_util::rtrim("xxtestxx", 'x'));
   EXPECT_EQ("test", string_util::trim("xxtestxx", 'x'));
+  EXPECT_EQ("", string_util::trim("xxxx", 'x'));
 }
 
 TEST(String, trimPredicate) {
   EXPECT_EQ("x\t x", string_util::trim("\t  x\t x   ", isspace));
   EXPECT_EQ("x\t x", string_util::trim("x\t x   ", isspace));
+  EXPECT_EQ("b", string_util::trim("aba", [](char c) { return c == 'a'; }));
 }
 
 TEST(String, join) {
   EXPECT_EQ("A, B, C", string_util::join({"A", "B", "C"}, ", "));
 }
 
+TEST(String, appendJson) {
+  string json{"["};
+  string_util::append_json(json, "a \"b\" \\c\n\x01");
+  EXPECT_EQ("[\"a \\\"b\\\" \\\\c\\n\\u0001\"", json);
+}
+
 TEST(String, split) {
   {
     vector<string> strings = string_util::split("A,B,C", ',');
@@ -121,6 +142,10 @@ TEST(String, floatingPoint) {
   EXPECT_EQ("1.26", string_util::floating_point(1.2599, 2));
   EXPECT_EQ("2", string_util::floating_point(1.7, 0));
   EXPECT_EQ("1.7770000000", string_util::floating_point(1.777, 10));
+  EXPECT_EQ("3", string_util::floating_point(3.0, 2));
+  EXPECT_EQ("3.00", string_util::floating_point(3.0, 2, true));
+  // The stream of the locale is reused
+  EXPECT_EQ("0.5", string_util::floating_point(0.5, 1));
 }
 
 TEST(String, filesize) {
@@ -136,6 +161,7 @@ TEST(String, filesize) {
   EXPECT_EQ("3 MB", string_util::filesize(3 * 1024 * 1024));
   EXPECT_EQ("3 GB", string_util::filesize((unsigned long long)3 * 1024 * 1024 * 1024));
   EXPECT_EQ("3 TB", string_util::filesize((unsigned long long)3 * 1024 * 1024 * 1024 * 1024));
+  EXPECT_EQ("3072 TB", string_util::filesize((unsigned long long)3 * 1024 * 1024 * 1024 * 1024 * 1024));
 }
 
 TEST(String, operators) {
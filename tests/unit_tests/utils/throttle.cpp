@@ -0,0 +1,46 @@
+#include "utils/throttle.hpp"
+
+#include <thread>
+
+#include "common/test.hpp"
+
+using namespace polybar;
+using namespace std::chrono_literals;
+using throttle_util::budget;
+
+TEST(Budget, events) {
+  budget b{3, 0ms, 50ms};
+
+  for (int i = 0; i < 3; i++) {
+    b.event();
+    EXPECT_FALSE(b.exceeded());
+  }
+
+  b.event();
+  EXPECT_TRUE(b.exceeded());
+
+  std::this_thread::sleep_for(60ms);
+  EXPECT_FALSE(b.exceeded());
+}
+
+TEST(Budget, busy) {
+  budget b{0, 10ms, 50ms};
+
+  b.spend(6ms);
+  EXPECT_FALSE(b.exceeded());
+  b.spend(6ms);
+  EXPECT_TRUE(b.exceeded());
+
+  std::this_thread::sleep_for(60ms);
+  EXPECT_FALSE(b.exceeded());
+}
+
+TEST(Budget, disabled) {
+  budget b{0, 0ms};
+
+  for (int i = 0; i < 1000; i++) {
+    b.event();
+    b.spend(1s);
+  }
+  EXPECT_FALSE(b.exceeded());
+}